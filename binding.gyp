@@ -8,7 +8,23 @@
         "sources": [ "src/pcan.c",
                      "src/pcan_helper.c",
                      "src/napi_helper.c",
-                     "src/common_helper.c" ],
+                     "src/common_helper.c",
+                     "src/pcan_thread.c",
+                     "src/pcan_frame.c",
+                     "src/pcan_receive.c",
+                     "src/pcan_capture.c",
+                     "src/pcan_reader.c",
+                     "src/pcan_trc.c",
+                     "src/pcan_pcapng.c",
+                     "src/pcan_mdf4.c",
+                     "src/pcan_arrow.c",
+                     "src/pcan_replay.c",
+                     "src/pcan_transmit.c",
+                     "src/pcan_cyclic.c",
+                     "src/pcan_timed.c",
+                     "src/pcan_request.c",
+                     "src/pcan_timing.c",
+                     "src/pcan_detect.c" ],
         "conditions": [
             [ "OS=='win'", {
                 "sources": [ "src/pcan_event_win32.c" ],
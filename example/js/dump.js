@@ -1,5 +1,8 @@
 // Example that listens to all PGNs and dump them
 // to the console.
+// If a file name is given on the command line (e.g. node dump.js log.trc),
+// frames are instead written to a PEAK trace file by the native capture
+// thread, which keeps up with a fully loaded bus.
 // CTRL-C stops the example
 
 const Can = require('../..');
@@ -38,17 +41,38 @@ board.list()
       // the USB cable
       ports = ports.slice(-1);
 
-      // Event handler for each incoming message
-      board.on('data', function(msg) {
+      let logFile = process.argv[2];
 
-        console.log('Msg: ', msg.id.toString(16), msg.buf);
+      if (!logFile) {
+        // Event handler for each incoming message
+        board.on('data', function(msg) {
 
-      });
+          console.log('Msg: ', msg.id.toString(16), msg.buf);
+
+        });
+      }
 
       console.log('Opening ', ports[0].path);
 
       // Open the COM port and initialize the USBCAN device...
-      return board.open(ports[0].path);
+      return board.open(ports[0].path)
+        .then(function() {
+          if (logFile) {
+            process.on('SIGINT', function() {
+              board.stopCapture()
+                .then(function(stats) {
+                  console.log('Captured', stats);
+                  return board.close();
+                })
+                .then(function() {
+                  process.exit(0);
+                });
+            });
+
+            console.log('Logging to', logFile);
+            return board.startCapture(logFile, { passthrough: false });
+          }
+        });
     } else {
       console.error('No CAN-USB-COM Devices found');
     }
@@ -7,13 +7,105 @@ interface Filter {
   mask?: number;
 }
 
+interface FdPhaseTiming {
+  brp: number;
+  tseg1: number;
+  tseg2: number;
+  sjw?: number;
+}
+
+interface FdTiming {
+  clockMhz?: number;
+  nominal: FdPhaseTiming;
+  data: FdPhaseTiming;
+}
+
 interface Options {
   canRate?: number;
+  samplePoint?: number;
+  fd?: boolean;
+  fdDataRate?: number;
+  fdSamplePoint?: number;
+  fdBitrate?: string | FdTiming;
   loopback?: boolean;
   filters?: Array<Filter>
+  txQueueSize?: number;
+  txPriority?: boolean;
+  txCoalesce?: boolean;
+  /** Bus load cap, in percent, for transmit queue traffic only (write() and send()) */
+  txMaxLoad?: number;
+  txConfirm?: boolean;
+  txConfirmTimeoutMs?: number;
+  txSources?: { [name: string]: { weight?: number; rate?: number; burst?: number } };
+  txHighWaterMark?: number;
+  drainTimeoutMs?: number;
+}
+
+interface CaptureQuery {
+  ids?: Array<number>;
+  from?: number;
+  to?: number;
+  batchSize?: number;
+}
+
+interface RequestOptions {
+  matchId?: number;
+  matchMask?: number;
+  matchExt?: boolean;
+  dataPrefix?: Array<number> | Buffer;
+  timeoutMs?: number;
+}
+
+declare class CaptureReader {
+  constructor(path: string, options?: { index?: 'auto' | 'build' | 'memory' });
+  info: any;
+  query(query?: CaptureQuery): IterableIterator<Buffer>;
+  frames(batch: Buffer): IterableIterator<any>;
+  close(): void;
 }
 
+declare class TrcReader {
+  constructor(path: string);
+  readonly info: { version: number; startTime: number; lines: number; skipped: number };
+  batches(batchSize?: number): IterableIterator<Buffer>;
+  frames(batch: Buffer): IterableIterator<any>;
+  close(): void;
+}
+
+interface CyclicScheduler {
+  add: Function;
+  update: Function;
+  remove: Function;
+  stats: Function;
+}
+
+interface BitTimingOptions {
+  bitrate: number;
+  samplePoint?: number;
+  dataBitrate?: number;
+  dataSamplePoint?: number;
+  clockMhz?: number;
+  max?: number;
+}
+
+interface DetectOptions {
+  candidates?: Array<number>;
+  timeoutMs?: number;
+  dwellMs?: number;
+  minFrames?: number;
+  rejectErrors?: number;
+}
+
+/**
+ * Methods returning a promise also emit each rejection as an 'error' event,
+ * other than for messages discarded by cancel(), cancelTimed(), or a ttl or
+ * deadline passing, which only reject.
+ */
 declare class Can {
+  static CaptureReader: typeof CaptureReader;
+  static TrcReader: typeof TrcReader;
+  static bitTiming(options: BitTimingOptions): Array<any>;
+
   constructor(options: Options);
   addListener: Function;
   removeListener: Function;
@@ -21,9 +113,29 @@ declare class Can {
   setOptions: Function;
   list: Function;
   open: Function;
+  detectBitrate(port: number, options?: DetectOptions): Promise<any>;
   close: Function;
   write: Function;
+  send(msg: any): Promise<any>;
+  writeBatch: Function;
+  cancel: Function;
+  transmitStats: Function;
+  transmitLatency: Function;
+  setSource: Function;
+  sourceStats: Function;
+  cyclic: CyclicScheduler;
+  hostTime: Function;
+  writeAt: Function;
+  writeAfter: Function;
+  cancelTimed: Function;
+  request(msg: any, options?: RequestOptions): Promise<{ msg: any; rttUs: number }>;
   status: Function;
+  startCapture: Function;
+  stopCapture: Function;
+  captureStats: Function;
+  replay: Function;
+  stopReplay: Function;
+  replayStats: Function;
   isOpen: Function;
   isConnected: Function;
   emit: Function;
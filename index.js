@@ -1,23 +1,119 @@
 'use strict';
 
-// const binary = require('node-pre-gyp');
-// const path = require('path');
-// const pcan_path = binary.find(path.resolve(path.join(__dirname,'./package.json')));
-// const pcan = require(pcan_path);
-const pcan = require('./binding/Release/node-v93-win32-x64/cs_pcan_usb.node');
+const pcan = require('./lib/binding');
 
 const { Duplex } = require('stream');
 const tpcan = require('./lib/tpcan');
+const { CaptureReader, captureFormat } = require('./lib/capture');
+const { TrcReader } = require('./lib/trc');
+const { OfflineSource } = require('./lib/offline');
+const { CyclicScheduler } = require('./lib/cyclic');
 
 // Default configuration used unless overridden by caller
 const DEFAULT_OPTIONS = {
   canRate: 250000,
+  samplePoint: undefined,
+  fd: false,
+  fdDataRate: 2000000,
+  fdSamplePoint: 0.75,
+  fdBitrate: undefined,
   filters: [],
   loopback: false,
+  txQueueSize: 4096,
+  txPriority: false,
+  txCoalesce: false,
+  txSources: {},
+  txMaxLoad: 0,
+  txConfirm: false,
+  txConfirmTimeoutMs: 1000,
+  txHighWaterMark: 1024,
+  drainTimeoutMs: 1000,
 };
 
+// Largest deviation from the bit rate asked for that a computed bit timing
+// may have
+const BIT_TIMING_MAX_ERROR = 0.005;
+
+// Bit rates tried by detectBitrate() unless others are given, most common
+// first
+const DETECT_CANDIDATES = [500000, 250000, 125000, 1000000, 800000, 100000, 50000, 20000,
+                           10000];
+
 const PCAN_RECEIVE_STATUS = 0x0F;
 const PCAN_LISTEN_ONLY = 0x08;
+const PCAN_ALLOW_ECHO_FRAMES = 0x2C;
+
+// Size and field offsets of the packed results returned by TransmitResults
+// (see pcan_transmit.h)
+const TRANSMIT_RESULT_SIZE = 24;
+const TRANSMIT_RESULT_SEQ = 0;
+const TRANSMIT_RESULT_STATUS = 8;
+const TRANSMIT_RESULT_LATENCY = 12;
+const TRANSMIT_RESULT_TIMESTAMP = 16;
+
+// Result statuses of messages that were never written: cancelled, replaced
+// by a newer value for the same ID, or past their time to live; and of
+// messages written with txConfirm whose echo never came back
+const TRANSMIT_STATUS_CANCELLED = 0x80000000;
+const TRANSMIT_STATUS_REPLACED = 0x80000001;
+const TRANSMIT_STATUS_EXPIRED = 0x80000002;
+const TRANSMIT_STATUS_UNCONFIRMED = 0x80000003;
+
+// Size and field offsets of the packed results returned by TimedResults
+// (see pcan_timed.h)
+const TIMED_RESULT_SIZE = 24;
+const TIMED_RESULT_ID = 0;
+const TIMED_RESULT_STATUS = 4;
+const TIMED_RESULT_DEADLINE = 8;
+const TIMED_RESULT_WRITTEN = 16;
+
+// Size and field offsets of the packed results returned by RequestResults
+// (see pcan_request.h)
+const REQUEST_RESULT_SIZE = 40;
+const REQUEST_RESULT_ID = 0;
+const REQUEST_RESULT_RTT = 8;
+const REQUEST_RESULT_REPLY = 16;
+
+// Number of transmit sources, including the default one (see pcan_transmit.h)
+const TRANSMIT_SOURCES_MAX = 16;
+
+
+// Returns the error a send() is rejected with for a transmit result status
+function transmitError(status) {
+  let err;
+
+  if (status == TRANSMIT_STATUS_CANCELLED) {
+    err = new Error("Cancelled before the message was written");
+  } else if (status == TRANSMIT_STATUS_EXPIRED) {
+    err = new Error("Expired before the message was written");
+  } else if (status == TRANSMIT_STATUS_UNCONFIRMED) {
+    err = new Error("No confirmation that the message was sent on the bus");
+  } else {
+    err = new Error(pcan.GetErrorText(status, 0));
+  }
+
+  err.status = status;
+  return err;
+}
+
+// Returns true for errors from messages that were discarded as asked, by
+// cancel() or a time to live, rather than failing; they are not emitted as
+// 'error' events
+function isDiscarded(err) {
+  return (err.status === TRANSMIT_STATUS_CANCELLED) || (err.status === TRANSMIT_STATUS_EXPIRED);
+}
+
+
+// A message written through the promise API, carrying the functions that
+// settle its promise through the Writable stream machinery
+class TransmitRequest {
+  constructor(msg, resolve, reject) {
+    this.msg = msg;
+    this.resolve = resolve;
+    this.reject = reject;
+  }
+}
+
 
 module.exports = class PcanUsb extends Duplex {
 
@@ -31,6 +127,9 @@ module.exports = class PcanUsb extends Duplex {
     this.port = null;
     this.isReady = false;
 
+    // Periodic messages, sent from a native thread (see lib/cyclic.js)
+    this.cyclic = new CyclicScheduler(this);
+
     this.status = {
       code: undefined,
       string: "",
@@ -62,10 +161,23 @@ module.exports = class PcanUsb extends Duplex {
     }
   }
 
+  // Returns the bit timings closest to a bit rate and sample point, best
+  // first, as found by the native solver. options:
+  //   bitrate          nominal bit rate, in bit/s
+  //   samplePoint      as a fraction of the bit (0.875, or 0.8 for CAN FD)
+  //   dataBitrate      bit rate of the CAN FD data phase, for CAN FD timings
+  //   dataSamplePoint  sample point of the data phase (0.75)
+  //   clockMhz         the only CAN FD clock to try
+  //   max              most timings to return (8)
+  static bitTiming(options) {
+    return pcan.BitTiming(options);
+  }
+
   // Sets (or re-sets) the configuration options
   setOptions(options) {
-    // Save for later use
-    this.options = Object.assign(DEFAULT_OPTIONS, options);
+    // Save for later use, on top of this port's own copy of the defaults so
+    // that ports on other channels never share options
+    this.options = Object.assign({}, DEFAULT_OPTIONS, this.options, options);
   }
 
   // Returns a promise that resolves to a list of available CAN ports
@@ -125,9 +237,22 @@ module.exports = class PcanUsb extends Duplex {
       });
   }
 
-  open(port) {
+  // Opens a CAN port, or a capture file in place of one. When port is the path
+  // of a native or trc capture, its frames are pushed into the stream with
+  // their recorded timestamps instead of being received from a bus, and the
+  // stream ends at the end of the file; writes go nowhere. opts (all optional)
+  // apply only to capture files:
+  //   speed   playback speed factor relative to the recorded timing, or 0
+  //           (default) to deliver frames as fast as they are consumed
+  //   ids     array of CAN IDs to deliver; others are skipped
+  //   format  'native' or 'trc'; by default, taken from the extension of path
+  open(port, opts = {}) {
     let me = this;
 
+    if (typeof port === 'string') {
+      return me._openOffline(port, opts);
+    }
+
     return new Promise(function(resolve, reject) {
 
       try {
@@ -141,11 +266,36 @@ module.exports = class PcanUsb extends Duplex {
           pcan.SetValue(port, PCAN_RECEIVE_STATUS, Buffer.from([0]));
         }
 
-        // Initialize CAN port (aka "channel")
-        pcan.Initialize(port, pcan.TranslateBaud(me.options.canRate));
+        // Initialize CAN port (aka "channel"), for CAN FD if asked to
+        if (me.options.fd) {
+          pcan.InitializeFD(port, me._fdBitrate());
+        } else {
+          pcan.Initialize(port, me._btr0btr1());
+        }
+
+        // Have the driver echo each frame once it is sent on the bus, so that
+        // writes can be confirmed and looped back in order with received
+        // frames. Without echoes, loopback falls back to copies pushed as
+        // messages are written.
+        me._softLoopback = false;
+        if (me.options.txConfirm) {
+          pcan.SetValue(port, PCAN_ALLOW_ECHO_FRAMES, Buffer.from([1]));
+        } else if (me.options.loopback) {
+          try {
+            pcan.SetValue(port, PCAN_ALLOW_ECHO_FRAMES, Buffer.from([1]));
+          } catch(err) {
+            me._softLoopback = true;
+          }
+        }
 
+        // The native transmit queue writes classic frames, so a CAN FD
+        // channel writes straight to the driver instead
         me.port = port;
+        me._fd = !!me.options.fd;
         me._configure();
+        if (!me._fd) {
+          me._startTransmit();
+        }
         me.isReady = true;
         me.emit('open');
 
@@ -184,16 +334,69 @@ module.exports = class PcanUsb extends Duplex {
       });
   }
 
-  close() {
+  // Opens a capture file in place of a CAN port
+  _openOffline(path, opts) {
     let me = this;
 
     return new Promise(function(resolve, reject) {
+      try {
+        me._offline = new OfflineSource(path, opts);
+        me.port = path;
+        me.isReady = true;
+        me.emit('open');
+        resolve();
+      } catch(err) {
+        reject(err);
+      }
+    })
+      .then(function() {
+        // Close event handler
+        me.on('close', function() {
+          me.close();
+        });
+
+        // Start delivering frames if the stream is already being read
+        me._read();
+      })
+      .catch(function(err) {
+        me.emit('error', err);
+        throw err;
+      });
+  }
+
+  // Closes the port, once queued messages have been written or
+  // options.drainTimeoutMs has passed; any left are rejected
+  close() {
+    let me = this;
+
+    return me._drainTransmit().then(function() {
+      if (me._txPending) {
+        me._stopTransmit();
+      }
+      if (me._timedPending) {
+        me._stopTimed();
+      }
+      if (me._requestPending) {
+        me._stopRequests();
+      }
+      if (me._fdBacklog) {
+        me._stopFD();
+      }
+    })
+    .then(() => new Promise(function(resolve, reject) {
       if (me.port === undefined) {
         reject(new Error("CAN port is undefined"));
       } else {
         // Remove listeners
         me.removeAllListeners();
-        if (me.isOpen()) {
+        if (me._offline) {
+          me._offline.close();
+          me._offline = undefined;
+        } else if (me.isOpen()) {
+          if (me._replay) {
+            me._finishReplay();
+          }
+          pcan.CyclicStop(me.port);
           pcan.DisableEvent(me.port);
           pcan.Reset(me.port);
           pcan.Uninitialize(me.port);
@@ -202,10 +405,11 @@ module.exports = class PcanUsb extends Duplex {
         me.emit('close');
         resolve();
       }
-    })
+    }))
       .then(function() {
         me.port = undefined;
         me.isReady = false;
+        me._fd = false;
         me.push(null);
       })
       .catch(function(err) {
@@ -214,34 +418,65 @@ module.exports = class PcanUsb extends Duplex {
       });
   }
 
-  write(msg) {
+  // Writes a message, and returns a promise that resolves once the driver
+  // accepts it. A message may carry a ttl, in milliseconds, or a deadline, as
+  // a Date.now() time; if it is still waiting when that passes, it is
+  // discarded, an 'expired' event is emitted, and the promise is rejected.
+  // Any other rejection is also emitted as an 'error' event.
+  // write() is the standard Writable method, which queues the same way but
+  // returns false when the writer should wait for 'drain'.
+  send(msg) {
     let me = this;
 
     return new Promise(function(resolve, reject) {
       if (me.port === undefined) {
         reject(new Error("CAN port is undefined"));
+      } else if (msg.buf.length > me._maxLength(msg)) {
+        reject(new Error("Tried to send invalid CAN data"));
       } else {
-        if (msg.buf.length <= 8) {
-          let tpcan_buffer = tpcan.toTPCANMsg(msg);
+        me.write(new TransmitRequest(msg, resolve, reject));
+      }
+    })
+    .catch(function(err) {
+      if (!isDiscarded(err)) {
+        me.emit('error', err);
+      }
+      throw err;
+    });
+  }
 
-          // Write message to bus
-          try {
-            pcan.Write(me.port, tpcan_buffer);
-          } catch(err) {
-            reject(err);
-          }
+  // Writes an array of messages with a single native call, in order, until
+  // the driver's transmit queue is full. Resolves with the number of
+  // messages accepted; the rest should be retried later. This bypasses the
+  // transmit queue used by write() and send(), so they should not be mixed
+  // when ordering matters.
+  writeBatch(msgs) {
+    let me = this;
 
-          me.emit('write', msg);
+    return new Promise(function(resolve, reject) {
+      if (me.port === undefined) {
+        reject(new Error("CAN port is undefined"));
+      } else if (msgs.some((msg) => msg.buf.length > me._maxLength(msg))) {
+        reject(new Error("Tried to send invalid CAN data"));
+      } else {
+        let written = msgs.length;
 
-          // If loopback is enabled, push message back into receive stream
-          if (me.options.loopback) {
-            me.push(tpcan.toMsg(tpcan_buffer));
-          }
+        if (me._fd) {
+          written = pcan.WriteBatchFD(me.port, tpcan.toFramesFD(msgs), msgs.length);
+        } else if (!me._offline) {
+          written = pcan.WriteBatch(me.port, tpcan.toFrames(msgs), msgs.length);
+        }
 
-          resolve();
-        } else {
-          reject(new Error("Tried to send invalid CAN data"));
+        for (let i = 0; i < written; i++) {
+          me.emit('write', msgs[i]);
+
+          // If loopback is done here, push message back into receive stream
+          if (me._loopsBack()) {
+            me.push({ id: msgs[i].id, ext: msgs[i].ext, buf: Buffer.from(msgs[i].buf), tx: true });
+          }
         }
+
+        resolve(written);
       }
     })
     .catch(function(err) {
@@ -267,6 +502,391 @@ module.exports = class PcanUsb extends Duplex {
     });
   }
 
+  // Starts capturing all received frames to a file, formatted and written by
+  // a native thread so that capture keeps up with a fully loaded bus.
+  // opts (all optional):
+  //   format        'native' (binary), 'trc' (PEAK trace, version 2.1),
+  //                 'pcapng' (Wireshark), 'mdf4' (ASAM MDF 4.10), 'arrow'
+  //                 (Arrow IPC file), or 'arrows' (Arrow IPC stream); by
+  //                 default, taken from the extension of path (.trc, .pcapng,
+  //                 .mf4, .arrow, or .arrows), or else 'native'
+  //   compress      deflate level (1-9), or true for the default, for 'mdf4'
+  //   bufferSize    size of each of the two write buffers, in bytes
+  //   flushMs       maximum time frames are held in memory before being written
+  //   rotateBytes   start a new file once the current one reaches this size
+  //   rotateSeconds start a new file once the current one is this old
+  //   passthrough   set to false to stop emitting captured frames as 'data'
+  // path may also be a named pipe (FIFO), for streaming to a live viewer; it is
+  // opened once something reads from it, and is never rotated.
+  startCapture(path, opts = {}) {
+    let me = this;
+
+    return new Promise(function(resolve, reject) {
+      if (!me.isOpen()) {
+        reject(new Error("CAN port is not open"));
+      } else if (me._offline) {
+        reject(new Error("Not available when reading from a capture file"));
+      } else {
+        let options = Object.assign({ bitrate: me.options.canRate }, opts);
+        options.format = captureFormat(path, opts.format);
+        pcan.StartCapture(me.port, path, options);
+        resolve();
+      }
+    })
+    .catch(function(err) {
+      me.emit('error', err);
+      throw err;
+    });
+  }
+
+  // Stops the capture in progress, and resolves with its statistics
+  // { frames, dropped, bytes, files, error } once all frames are on disk
+  stopCapture() {
+    let me = this;
+
+    return new Promise(function(resolve, reject) {
+      if (!me.isOpen()) {
+        reject(new Error("CAN port is not open"));
+      } else {
+        resolve(pcan.StopCapture(me.port));
+      }
+    })
+    .catch(function(err) {
+      me.emit('error', err);
+      throw err;
+    });
+  }
+
+  // Cancels the messages with an ID that are waiting to be written, and
+  // returns how many were cancelled; their send() promises are rejected. A
+  // message already being handed to the driver cannot be cancelled.
+  cancel(id, ext = false) {
+    let cancelled = 0;
+
+    if (!this._txPending) {
+      throw new Error("CAN port is not open");
+    }
+
+    if (this._txBacklog) {
+      let backlog = this._txBacklog.filter((request) =>
+        (request.msg.id !== id) || (!!request.msg.ext !== !!ext));
+
+      for (let request of this._txBacklog) {
+        if (!backlog.includes(request)) {
+          request.reject(transmitError(TRANSMIT_STATUS_CANCELLED));
+          cancelled++;
+        }
+      }
+      this._txBacklog = (backlog.length > 0) ? backlog : undefined;
+      this._resumeTransmit();
+    }
+
+    return cancelled + pcan.TransmitCancel(this.port, id, !!ext);
+  }
+
+  // Returns the time on the host's monotonic clock, in microseconds, as used
+  // by writeAt()
+  hostTime() {
+    return pcan.HostTime();
+  }
+
+  // Writes a message at a time on the host's monotonic clock (see hostTime()),
+  // or at once if that has passed, from a native timing thread. Bypasses the
+  // transmit queue. Resolves with { deadlineUs, writtenUs, lateUs } once the
+  // driver accepts the message.
+  writeAt(msg, hostTimeUs) {
+    let me = this;
+
+    return me._timed(msg, (frame) => pcan.TimedAt(me.port, frame, hostTimeUs));
+  }
+
+  // Writes a message delayUs microseconds after the next received message that
+  // matches trigger { id, mask, ext }: its ID must equal id in the bits set
+  // in mask (by default, all of them), and it must be extended if ext is set.
+  // The trigger is matched, and the message written, natively, so the delay
+  // does not depend on the event loop; it counts from when the trigger was
+  // read from the driver. Resolves as for writeAt().
+  writeAfter(trigger, delayUs, msg) {
+    let me = this;
+
+    return me._timed(msg, (frame) => pcan.TimedAfter(me.port, frame, trigger, delayUs));
+  }
+
+  // Cancels every message waiting to be written by writeAt() or writeAfter(),
+  // and returns how many there were; their promises are rejected
+  cancelTimed() {
+    let cancelled = 0;
+
+    if (this._timedPending) {
+      for (let handle of this._timedPending.keys()) {
+        if (pcan.TimedCancel(this.port, handle)) {
+          cancelled++;
+        }
+      }
+    }
+
+    return cancelled;
+  }
+
+  // Writes a request message and waits for the next received message that
+  // answers it, as given by options { matchId, matchMask, matchExt,
+  // dataPrefix, timeoutMs }: its ID must equal matchId in the bits set in
+  // matchMask (by default, all of them), it must be extended if matchExt is
+  // set (by default, if the request is), and its data must start with the
+  // bytes of dataPrefix, if given. The reply is matched natively as it is
+  // drained from the driver, so the matcher is in place before the request
+  // is written. Bypasses the transmit queue. Resolves with { msg, rttUs },
+  // the reply and the microseconds from writing the request to reading the
+  // reply, or rejects if none arrives within timeoutMs (default 1000). As
+  // for send(), a rejection is also emitted as an 'error' event. The reply is
+  // also received as usual.
+  request(msg, options = {}) {
+    let me = this;
+    let timeoutMs = (options.timeoutMs !== undefined) ? options.timeoutMs : 1000;
+    let match = {
+      id: options.matchId,
+      mask: options.matchMask,
+      ext: (options.matchExt !== undefined) ? !!options.matchExt : !!msg.ext,
+      prefix: (options.dataPrefix !== undefined) ? Buffer.from(options.dataPrefix) : undefined
+    };
+
+    return new Promise(function(resolve, reject) {
+      if (!me.isOpen()) {
+        reject(new Error("CAN port is not open"));
+      } else if (me._offline) {
+        reject(new Error("Not available when reading from a capture file"));
+      } else if (me._fd) {
+        reject(new Error("Not available on a CAN FD channel"));
+      } else if (msg.buf.length > 8) {
+        reject(new Error("Tried to send invalid CAN data"));
+      } else {
+        if (!me._requestPending) {
+          pcan.RequestStart(me.port, function() {
+            me._onRequest();
+          });
+          me._requestPending = new Map();
+        }
+
+        let handle = pcan.RequestSend(me.port, tpcan.toFrames([msg]), match);
+        let request = new TransmitRequest(msg, resolve, reject);
+
+        // If the reply is already being recorded, cancelling fails and it
+        // settles the request instead
+        request.timer = setTimeout(function() {
+          if (pcan.RequestCancel(me.port, handle)) {
+            me._requestPending.delete(handle);
+            let err = new Error("No reply to the request within " + timeoutMs + " ms");
+            err.code = 'ETIMEDOUT';
+            reject(err);
+          }
+        }, timeoutMs);
+
+        me._requestPending.set(handle, request);
+        me._onWrite(msg);
+      }
+    })
+    .catch(function(err) {
+      me.emit('error', err);
+      throw err;
+    });
+  }
+
+  // Returns statistics for the transmit queue:
+  // { queued, sent, errors, cancelled, replaced, expired, retries, busOffs,
+  // paced, confirmed, unconfirmed, discarded, pending, unsent, busOff, load,
+  // lastError }
+  // load is the percentage of bus time taken by the messages written over the
+  // last 100 ms, counting worst-case bit stuffing. With txConfirm, unsent
+  // counts messages handed to the driver and waiting to be sent on the bus.
+  transmitStats() {
+    return pcan.TransmitStats(this.port);
+  }
+
+  // Returns the distribution of the time messages written with txConfirm took
+  // from being queued to being sent on the bus:
+  // { count, meanUs, maxUs, p50Us, p90Us, p99Us, buckets }
+  // buckets[0] counts times under 1 us, and buckets[n] those from 2^(n-1) up
+  // to 2^n us; percentiles are rounded up to the end of their bucket.
+  transmitLatency() {
+    return pcan.TransmitLatency(this.port);
+  }
+
+  // Creates a named transmit source, or changes its settings. Messages name
+  // their source in msg.source; those that name none come from 'default'.
+  // Sources share the bus by deficit round-robin, in proportion to their
+  // weights, so that one source with a deep queue cannot starve the others.
+  // A source first named by a message is created with a weight of 1.
+  // opts (all optional):
+  //   weight  share of the bus relative to the other sources (default 1)
+  //   rate    most messages per second the source may send (default 0, no
+  //           limit)
+  //   burst   messages the source may send back to back within its rate
+  //           (default 1)
+  setSource(name, opts = {}) {
+    if (!this._txPending) {
+      throw new Error("CAN port is not open");
+    }
+
+    let index = this._sourceIndex(name);
+    if (index === undefined) {
+      throw new Error("Too many transmit sources");
+    }
+
+    pcan.TransmitSource(this.port, index, opts);
+  }
+
+  // Returns statistics for a transmit source:
+  // { queued, sent, throttled, pending, meanLatencyUs, maxLatencyUs }
+  // Latency runs from a message being queued natively to being written, and
+  // throttled counts the times the source reached its rate limit and had to
+  // wait.
+  // Without a name, returns an object with the statistics of every source.
+  sourceStats(name) {
+    if (!this._txPending) {
+      throw new Error("CAN port is not open");
+    }
+
+    if (name !== undefined) {
+      if (!this._txSources.has(name)) {
+        throw new Error("Unknown transmit source");
+      }
+      return pcan.TransmitSourceStats(this.port, this._txSources.get(name));
+    }
+
+    let stats = {};
+    for (let [source, index] of this._txSources) {
+      stats[source] = pcan.TransmitSourceStats(this.port, index);
+    }
+    return stats;
+  }
+
+  // Returns statistics for the capture in progress
+  captureStats() {
+    return pcan.CaptureStats(this.port);
+  }
+
+  // Replays a native or trc capture file to the bus, with its recorded
+  // timing, from a native thread. Resolves with the replay statistics
+  // { frames, errors, late, loops, meanLateUs, maxLateUs, p50LateUs,
+  // p99LateUs, p999LateUs, lastError, finished, error } once the replay has
+  // run to its end or been stopped.
+  // opts (all optional):
+  //   format  'native' or 'trc'; by default, taken from the extension of path
+  //   speed   playback speed factor, e.g. 2 for twice as fast (default 1)
+  //   loop    number of passes over the file, or true to repeat until stopped
+  //   ids     array of CAN IDs to replay; others are skipped
+  //   spinUs  time spent busy-waiting before each frame (default 200)
+  //   lateUs  lateness above which a frame is counted as late (default 1000)
+  replay(path, opts = {}) {
+    let me = this;
+
+    return new Promise(function(resolve, reject) {
+      if (!me.isOpen()) {
+        reject(new Error("CAN port is not open"));
+      } else if (me._offline) {
+        reject(new Error("Not available when reading from a capture file"));
+      } else if (me._fd) {
+        reject(new Error("Not available on a CAN FD channel"));
+      } else {
+        let options = Object.assign({}, opts);
+        options.format = captureFormat(path, opts.format);
+
+        // The native callback may arrive after the replay was stopped, or
+        // after another one was started; only finish the one it belongs to
+        let replay = { resolve };
+        pcan.ReplayStart(me.port, path, options, function() {
+          if (me._replay === replay) {
+            me._finishReplay();
+          }
+        });
+        me._replay = replay;
+      }
+    })
+    .catch(function(err) {
+      me.emit('error', err);
+      throw err;
+    });
+  }
+
+  // Stops the replay in progress, and resolves with its statistics
+  stopReplay() {
+    let me = this;
+
+    return new Promise(function(resolve, reject) {
+      if (!me._replay) {
+        reject(new Error("No replay is in progress"));
+      } else {
+        resolve(me._finishReplay());
+      }
+    })
+    .catch(function(err) {
+      me.emit('error', err);
+      throw err;
+    });
+  }
+
+  // Returns statistics for the replay in progress
+  replayStats() {
+    return pcan.ReplayStats(this.port);
+  }
+
+  // Detects the bit rate of the bus a port that is not open is connected to,
+  // and resolves with { canRate, confident, elapsedMs, candidates }. The port
+  // listens in listen-only mode, so as never to disturb the bus, at each
+  // candidate rate in turn: a wrong rate is given up after a couple of
+  // errors, and the right one settled after a few valid frames, so that on an
+  // active bus the scan takes a few milliseconds per rate. Should no rate be
+  // settled, the one with the largest share of valid frames is taken
+  // (confident is then false). The rate found becomes options.canRate, for a
+  // following open(port). opts (all optional):
+  //   candidates    bit rates to try, in order (the standard rates, most
+  //                 common first)
+  //   timeoutMs     longest time the whole scan may take (default 1000)
+  //   dwellMs       longest time spent at a rate in each pass (default 50)
+  //   minFrames     valid frames, and as many for every error, that settle a
+  //                 rate (default 4)
+  //   rejectErrors  errors without a valid frame that give up a rate
+  //                 (default 2)
+  detectBitrate(port, opts = {}) {
+    let me = this;
+
+    return new Promise(function(resolve, reject) {
+      if (me.isOpen()) {
+        reject(new Error("Close the port before detecting its bit rate"));
+        return;
+      }
+
+      let candidates = opts.candidates || DETECT_CANDIDATES;
+      let btr0btr1 = candidates.map((rate) => me._btr0btr1(rate));
+
+      pcan.DetectStart(port, btr0btr1, opts, function() {
+        let result = pcan.DetectStop(port);
+        let detected = {
+          canRate: candidates[result.index],
+          confident: result.confident,
+          elapsedMs: result.elapsedMs,
+          candidates: result.candidates.map(function(score, i) {
+            return Object.assign({ canRate: candidates[i] }, score);
+          })
+        };
+
+        if (result.index < 0) {
+          let err = new Error("No bit rate detected within " + Math.round(result.elapsedMs) +
+                              " ms");
+          err.candidates = detected.candidates;
+          reject(err);
+        } else {
+          me.options.canRate = detected.canRate;
+          resolve(detected);
+        }
+      });
+    })
+    .catch(function(err) {
+      me.emit('error', err);
+      throw err;
+    });
+  }
+
   // Required function for cs-modbus GenericConnection
   isOpen() {
     return this.port && this.isReady;
@@ -285,30 +905,507 @@ module.exports = class PcanUsb extends Duplex {
       me.emit('error', err);
       throw err;
     } else {
+      // Frames are drained from the driver by the native worker thread;
+      // collect them in batches until none are left
       while (true) {
-        try {
-          let read_obj = pcan.Read(me.port);
-          me.push(tpcan.toMsg(read_obj.message)); // Emits 'data' event
-        } catch(err) {
-          if (err.code != "PCAN_ERROR_QRCVEMPTY") {
-            console.debug(err.code);
-          }
+        let frames = pcan.ReadBatch(me.port);
+        if (frames.length == 0) {
           break;
         }
+        for (let msg of (me._fd ? tpcan.fromFramesFD(frames) : tpcan.fromFrames(frames))) {
+          me.push(msg); // Emits 'data' event
+        }
       }
       // If status changed, the following will emit a 'status' event
       this.status.statusCode = pcan.GetStatus(me.port);
     }
   }
 
-  // Required for a readable stream; we don't need to do anything
-  _read() {}
+  // Starts the native transmit queue for the port. Each queued message is
+  // numbered in order, so results can be matched to send() promises.
+  _startTransmit() {
+    let me = this;
+
+    let options = {
+      queueSize: me.options.txQueueSize,
+      priority: me.options.txPriority,
+      bitrate: me.options.canRate,
+      maxLoad: me.options.txMaxLoad,
+      confirm: me.options.txConfirm,
+      confirmTimeoutMs: me.options.txConfirmTimeoutMs,
+    };
+
+    pcan.TransmitStart(me.port, options, function() {
+      me._onTransmit();
+    });
+
+    me._txSeq = 0;
+    me._txPending = new Map();
+    me._txSources = new Map([['default', 0]]);
+
+    for (let name of Object.keys(me.options.txSources)) {
+      me.setSource(name, me.options.txSources[name]);
+    }
+  }
+
+  // Returns the index of a named transmit source, assigning the next one to
+  // a new name, with a weight of 1, or undefined if there are no more
+  _sourceIndex(name) {
+    if (!this._txSources.has(name)) {
+      if (this._txSources.size >= TRANSMIT_SOURCES_MAX) {
+        return undefined;
+      }
+      this._txSources.set(name, this._txSources.size);
+      pcan.TransmitSource(this.port, this._txSources.get(name), {});
+    }
+
+    return this._txSources.get(name);
+  }
+
+  // Settles the send() promises of messages the writer thread is done with
+  _onTransmit() {
+    // Results may still arrive after the queue was stopped
+    if (!this._txPending) {
+      return;
+    }
+
+    while (true) {
+      let results = pcan.TransmitResults(this.port);
+      if (results.length == 0) {
+        break;
+      }
+
+      for (let offset = 0; offset < results.length; offset += TRANSMIT_RESULT_SIZE) {
+        let seq = Number(results.readBigUInt64LE(offset + TRANSMIT_RESULT_SEQ));
+        let status = results.readUInt32LE(offset + TRANSMIT_RESULT_STATUS);
+        let request = this._txPending.get(seq);
+
+        if (request) {
+          this._txPending.delete(seq);
+          if ((status == 0) && this.options.txConfirm) {
+            request.resolve({
+              timestamp: Number(results.readBigUInt64LE(offset + TRANSMIT_RESULT_TIMESTAMP)),
+              latencyUs: results.readUInt32LE(offset + TRANSMIT_RESULT_LATENCY),
+            });
+          } else if ((status == 0) || (status == TRANSMIT_STATUS_REPLACED)) {
+            request.resolve();
+          } else {
+            if (status == TRANSMIT_STATUS_EXPIRED) {
+              this.emit('expired', request.msg);
+            }
+            request.reject(transmitError(status));
+          }
+        }
+      }
+    }
+
+    // Queue any backlog that did not fit, and release the stream if it was
+    // held above the high-water mark
+    this._resumeTransmit();
+
+    if ((this._txPending.size == 0) && !this._txBacklog && this._txDrained) {
+      this._txDrained();
+    }
+  }
+
+  // Resolves once every queued message has been written, or after
+  // options.drainTimeoutMs, whichever comes first
+  _drainTransmit() {
+    let me = this;
+
+    return new Promise(function(resolve) {
+      if (!me._txPending || ((me._txPending.size == 0) && !me._txBacklog)) {
+        resolve();
+        return;
+      }
+
+      let timer = setTimeout(done, me.options.drainTimeoutMs);
+
+      function done() {
+        clearTimeout(timer);
+        me._txDrained = undefined;
+        resolve();
+      }
+
+      me._txDrained = done;
+    });
+  }
+
+  // Stops the transmit queue, and rejects the messages it never wrote
+  _stopTransmit() {
+    let pending = [...this._txPending.values()].concat(this._txBacklog || []);
+    let callback = this._txCallback;
+
+    this._txPending = undefined;
+    this._txBacklog = undefined;
+    this._txCallback = undefined;
+
+    let stats = pcan.TransmitStop(this.port);
+
+    for (let request of pending) {
+      request.reject(new Error("Port closed before the message was written"));
+    }
+
+    // Let the stream move on; anything written from now on is rejected
+    if (callback) {
+      callback();
+    }
+
+    return stats;
+  }
+
+  // Schedules a message with add(frame), which returns its native handle, and
+  // returns a promise settled when its result arrives
+  _timed(msg, add) {
+    let me = this;
+
+    return new Promise(function(resolve, reject) {
+      if (!me.isOpen()) {
+        reject(new Error("CAN port is not open"));
+      } else if (me._offline) {
+        reject(new Error("Not available when reading from a capture file"));
+      } else if (me._fd) {
+        reject(new Error("Not available on a CAN FD channel"));
+      } else if (msg.buf.length > 8) {
+        reject(new Error("Tried to send invalid CAN data"));
+      } else {
+        if (!me._timedPending) {
+          pcan.TimedStart(me.port, function() {
+            me._onTimed();
+          });
+          me._timedPending = new Map();
+        }
+
+        let handle = add(tpcan.toFrames([msg]));
+        me._timedPending.set(handle, new TransmitRequest(msg, resolve, reject));
+      }
+    })
+    .catch(function(err) {
+      if (!isDiscarded(err)) {
+        me.emit('error', err);
+      }
+      throw err;
+    });
+  }
+
+  // Settles the promises of timed messages the timing thread is done with
+  _onTimed() {
+    // Results may still arrive after timed transmission was stopped
+    if (!this._timedPending) {
+      return;
+    }
+
+    let results = pcan.TimedResults(this.port);
+
+    for (let offset = 0; offset < results.length; offset += TIMED_RESULT_SIZE) {
+      let handle = results.readUInt32LE(offset + TIMED_RESULT_ID);
+      let status = results.readUInt32LE(offset + TIMED_RESULT_STATUS);
+      let request = this._timedPending.get(handle);
+
+      if (request) {
+        this._timedPending.delete(handle);
+        if (status == 0) {
+          let deadlineUs = Number(results.readBigUInt64LE(offset + TIMED_RESULT_DEADLINE));
+          let writtenUs = Number(results.readBigUInt64LE(offset + TIMED_RESULT_WRITTEN));
+
+          this._onWrite(request.msg);
+          request.resolve({ deadlineUs, writtenUs, lateUs: writtenUs - deadlineUs });
+        } else {
+          request.reject(transmitError(status));
+        }
+      }
+    }
+  }
+
+  // Stops timed transmission, and rejects the messages it never wrote
+  _stopTimed() {
+    let pending = this._timedPending;
+
+    this._timedPending = undefined;
+    pcan.TimedStop(this.port);
+
+    for (let request of pending.values()) {
+      request.reject(new Error("Port closed before the message was written"));
+    }
+  }
+
+  // Settles the promises of requests whose replies have arrived
+  _onRequest() {
+    // Replies may still arrive after matching was stopped
+    if (!this._requestPending) {
+      return;
+    }
+
+    let results = pcan.RequestResults(this.port);
+
+    for (let offset = 0; offset < results.length; offset += REQUEST_RESULT_SIZE) {
+      let handle = results.readUInt32LE(offset + REQUEST_RESULT_ID);
+      let request = this._requestPending.get(handle);
+
+      if (request) {
+        let reply = results.subarray(offset + REQUEST_RESULT_REPLY, offset + REQUEST_RESULT_SIZE);
+
+        this._requestPending.delete(handle);
+        clearTimeout(request.timer);
+        request.resolve({
+          msg: tpcan.fromFrames(reply)[0],
+          rttUs: Number(results.readBigUInt64LE(offset + REQUEST_RESULT_RTT))
+        });
+      }
+    }
+  }
+
+  // Stops request/response matching, and rejects the requests still waiting
+  _stopRequests() {
+    let pending = this._requestPending;
+
+    this._requestPending = undefined;
+    pcan.RequestStop(this.port);
+
+    for (let request of pending.values()) {
+      clearTimeout(request.timer);
+      request.reject(new Error("Port closed before a reply was received"));
+    }
+  }
+
+  // Collects the replay thread, and resolves the promise returned by replay()
+  _finishReplay() {
+    let replay = this._replay;
+    this._replay = undefined;
+
+    let stats = pcan.ReplayStop(this.port);
+    replay.resolve(stats);
+    return stats;
+  }
+
+  // Required for a readable stream. Frames received from a bus are pushed as
+  // they arrive, but frames from a capture file are pushed only as the
+  // consumer asks for them.
+  _read() {
+    if (this._offline) {
+      this._offline.pump(this.push.bind(this));
+    }
+  }
+
+  // Required for a writable stream; queues a single message
+  _write(chunk, encoding, callback) {
+    this._writev([{ chunk: chunk }], callback);
+  }
+
+  // Queues every message buffered by the stream with a single native call.
+  // The callback is held while more than options.txHighWaterMark messages
+  // are waiting to be written, which applies backpressure to the stream.
+  _writev(chunks, callback) {
+    let me = this;
+    let requests = [];
+
+    // Messages piped in have no promise; their errors are emitted instead,
+    // other than discarding, which was asked for
+    function onError(err) {
+      if (!isDiscarded(err)) {
+        me.emit('error', err);
+      }
+    }
+
+    for (let { chunk } of chunks) {
+      let request = (chunk instanceof TransmitRequest) ?
+        chunk : new TransmitRequest(chunk, function() {}, onError);
+
+      if (!request.msg || !request.msg.buf ||
+          (request.msg.buf.length > me._maxLength(request.msg))) {
+        request.reject(new Error("Tried to send invalid CAN data"));
+      } else {
+        requests.push(request);
+      }
+    }
+
+    if (requests.length == 0) {
+      // Every message was rejected, so there is nothing to wait for
+      callback();
+    } else if (me._offline) {
+      // Nothing is written when reading from a capture file
+      for (let request of requests) {
+        me._onWrite(request.msg);
+        request.resolve();
+      }
+      callback();
+    } else if (me._fd) {
+      me._fdBacklog = requests;
+      me._fdCallback = callback;
+      me._resumeFD();
+    } else if (!me._txPending) {
+      for (let request of requests) {
+        request.reject(new Error("CAN port is not open"));
+      }
+      callback();
+    } else {
+      me._txBacklog = requests;
+      me._txCallback = callback;
+      me._resumeTransmit();
+    }
+  }
+
+  // Queues as much of the backlog from _writev as the native queue will take,
+  // and releases the stream once all of it is queued and the native queue is
+  // no longer above the high-water mark
+  _resumeTransmit() {
+    let backlog = this._txBacklog;
+
+    if (backlog && (backlog.length > 0)) {
+      // Messages naming a source beyond the last one fall back to the default
+      let frames = tpcan.toFrames(backlog.map((request) => request.msg), this.options.txCoalesce,
+        (msg) => ((msg.source === undefined) ? 0 : (this._sourceIndex(msg.source) || 0)));
+      let queued = pcan.TransmitPush(this.port, frames, backlog.length);
+
+      for (let i = 0; i < queued; i++) {
+        this._txPending.set(this._txSeq++, backlog[i]);
+        this._onWrite(backlog[i].msg);
+      }
+
+      this._txBacklog = (queued < backlog.length) ? backlog.slice(queued) : undefined;
+    }
+
+    if (this._txCallback && !this._txBacklog &&
+        (this._txPending.size <= this.options.txHighWaterMark)) {
+      let callback = this._txCallback;
+      this._txCallback = undefined;
+      callback();
+    }
+  }
+
+  // Writes as much of the backlog from _writev as the driver's transmit queue
+  // will take, on a CAN FD channel, and tries the rest again a millisecond
+  // later. The stream is released once all of it is written.
+  _resumeFD() {
+    let me = this;
+    let backlog = me._fdBacklog;
+    let written = 0;
+
+    me._fdTimer = undefined;
+
+    try {
+      written = pcan.WriteBatchFD(me.port, tpcan.toFramesFD(backlog.map((request) => request.msg)),
+        backlog.length);
+    } catch(err) {
+      // The first message failed for a reason other than a full queue
+      backlog.shift().reject(err);
+    }
+
+    for (let i = 0; i < written; i++) {
+      me._onWrite(backlog[i].msg);
+      backlog[i].resolve();
+    }
+    backlog = backlog.slice(written);
+
+    if (backlog.length > 0) {
+      me._fdBacklog = backlog;
+      me._fdTimer = setTimeout(function() {
+        me._resumeFD();
+      }, 1);
+    } else {
+      let callback = me._fdCallback;
+      me._fdBacklog = undefined;
+      me._fdCallback = undefined;
+      callback();
+    }
+  }
+
+  // Stops retrying the backlog of a CAN FD channel, and rejects the messages
+  // never written
+  _stopFD() {
+    let backlog = this._fdBacklog;
+    let callback = this._fdCallback;
+
+    clearTimeout(this._fdTimer);
+    this._fdBacklog = undefined;
+    this._fdCallback = undefined;
+    this._fdTimer = undefined;
+
+    for (let request of backlog) {
+      request.reject(new Error("Port closed before the message was written"));
+    }
+
+    callback();
+  }
+
+  // Returns the most data bytes a message may carry: 64 on a CAN FD channel,
+  // unless the message is sent as a classic frame, and otherwise 8
+  _maxLength(msg) {
+    return (this.options.fd && (msg.fd !== false)) ? tpcan.FRAME_FD_DATA_MAX : 8;
+  }
+
+  // Returns the BTR0BTR1 value a classic channel is initialized with for a
+  // bit rate (options.canRate by default): the PCAN-Basic constant for a
+  // standard rate, unless a sample point is given, or else the best timing the
+  // solver finds
+  _btr0btr1(rate = this.options.canRate) {
+
+    if (this.options.samplePoint === undefined) {
+      try {
+        return pcan.TranslateBaud(rate);
+      } catch(err) {
+        // Not a standard rate
+      }
+    }
+
+    let [timing] = pcan.BitTiming({ bitrate: rate, samplePoint: this.options.samplePoint });
+    if (!timing || (timing.error > BIT_TIMING_MAX_ERROR)) {
+      throw new Error("No bit timing within " + (BIT_TIMING_MAX_ERROR * 100) + "% of " + rate +
+                      " bit/s");
+    }
+
+    return timing.btr0btr1;
+  }
+
+  // Returns the bit rate string a CAN FD channel is initialized with: that
+  // given by options.fdBitrate, as a string or as bit timing (see
+  // lib/tpcan.js), or else the best timing the solver finds for
+  // options.canRate and options.fdDataRate
+  _fdBitrate() {
+    let timing = this.options.fdBitrate;
 
-  // Required for a writable stream; we don't need to do anything
-  _write() {}
+    if (typeof timing === 'string') {
+      return timing;
+    }
+    if (timing !== undefined) {
+      return tpcan.fdBitrate(timing);
+    }
+
+    [timing] = pcan.BitTiming({
+      bitrate: this.options.canRate,
+      samplePoint: this.options.samplePoint,
+      dataBitrate: this.options.fdDataRate,
+      dataSamplePoint: this.options.fdSamplePoint
+    });
+    if (!timing || (timing.error > BIT_TIMING_MAX_ERROR)) {
+      throw new Error("No CAN FD bit timing within " + (BIT_TIMING_MAX_ERROR * 100) + "% of " +
+                      this.options.canRate + " and " + this.options.fdDataRate + " bit/s");
+    }
+
+    return timing.bitrateFD;
+  }
+
+  // Emits a 'write' event for a queued message, and loops it back if that is
+  // not done natively
+  _onWrite(msg) {
+    this.emit('write', msg);
+
+    // If loopback is done here, push message back into receive stream
+    if (this._loopsBack()) {
+      this.push(Object.assign(tpcan.toMsg(tpcan.toTPCANMsg(msg)), { tx: true }));
+    }
+  }
+
+  // Returns true if written messages are looped back by pushing copies, as
+  // they are when reading from a capture file or the driver cannot echo
+  // frames; otherwise the native receive path delivers the echoes
+  _loopsBack() {
+    return this.options.loopback && (!!this._offline || !!this._softLoopback);
+  }
 
   _configure() {
     let me = this;
+    let native = [];
 
     // Set filters
     if (me.options.filters.length > 0) {
@@ -329,15 +1426,18 @@ module.exports = class PcanUsb extends Duplex {
           } else {
             pcan.AcceptanceFilter11Bit(me.port, filter.code, filter.mask);
           }
+          native.push({ ext: !!filter.ext, code: filter.code, mask: filter.mask });
         } else if (filter.fromID !== undefined && filter.toID !== undefined) {
           pcan.FilterMessages(me.port, filter.fromID, filter.toID, filter.ext ? 0x02 : 0x00);
+          native.push({ ext: !!filter.ext, fromId: filter.fromID, toId: filter.toID });
         } else if (filter.id !== undefined) {
 
           // Split start/stop range and convert them to acceptance code + mask
           const parts = filter.id.split(' ');
           let fromID = parseInt(parts[0], 16);
-          let toID = parseInt(parts[1], 16);
+          let toID = (parts.length > 1) ? parseInt(parts[1], 16) : fromID;
           pcan.FilterMessages(me.port, fromID, toID, filter.ext ? 0x02 : 0x00);
+          native.push({ ext: !!filter.ext, fromId: fromID, toId: toID });
         } else {
           let err = new Error("Unknown or unspecified filter format.");
           me.emit('error', err);
@@ -345,6 +1445,16 @@ module.exports = class PcanUsb extends Duplex {
         }
       }
     }
+
+    // The adapter's filters only narrow what the driver delivers (and do
+    // nothing on macOS), so the native receive path applies them exactly,
+    // to received frames and looped-back echoes alike
+    pcan.ReceiveConfigure(me.port, {
+      filters: native,
+      loopback: !!me.options.loopback && !me._softLoopback
+    });
   }
 };
 
+module.exports.CaptureReader = CaptureReader;
+module.exports.TrcReader = TrcReader;
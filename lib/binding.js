@@ -0,0 +1,12 @@
+/* Loads the native addon, shared by the modules in this package
+
+   Copyright (c) 2020 Control Solutions LLC. All rights reserved.
+*/
+
+'use strict';
+
+// const binary = require('node-pre-gyp');
+// const path = require('path');
+// const pcan_path = binary.find(path.resolve(path.join(__dirname,'../package.json')));
+// module.exports = require(pcan_path);
+module.exports = require('../binding/Release/node-v93-win32-x64/cs_pcan_usb.node');
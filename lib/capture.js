@@ -0,0 +1,137 @@
+/* Reads binary capture files written by PcanUsb.startCapture()
+
+   Files are memory-mapped by the native addon, which builds (or loads from a
+   sidecar file) an index of the blocks in which each ID appears and the time
+   range of each block, so a query only touches the parts of the file that can
+   contain matching frames.
+
+   Copyright (c) 2020 Control Solutions LLC. All rights reserved.
+*/
+
+'use strict';
+
+const pcan = require('./binding');
+
+// Index modes, matching pcanReaderIndexMode_t in pcan_reader.h
+const INDEX_MODES = {
+  auto: 0,    // load the sidecar if it is up to date, else build and save it
+  build: 1,   // always build, and save the sidecar
+  memory: 2,  // load the sidecar if it is up to date, else build without saving
+};
+
+// Default number of frames in each batch returned by a query
+const DEFAULT_BATCH_SIZE = 4096;
+
+// Capture formats implied by file extensions; anything else is native
+const FORMAT_EXTENSIONS = {
+  '.trc': 'trc',
+  '.pcapng': 'pcapng',
+  '.mf4': 'mdf4',
+  '.arrow': 'arrow',
+  '.arrows': 'arrows',
+};
+
+// Field offsets common to every record layout (see pcan_frame.h)
+const RECORD_TIMESTAMP = 0;
+const RECORD_ID = 8;
+const RECORD_MSGTYPE = 12;
+const RECORD_LEN = 13;
+const RECORD_DATA = 16;
+
+// Message types that are not data frames (see PCAN-Basic TPCANMessageType)
+const PCAN_MESSAGE_ERRFRAME = 0x40;
+const PCAN_MESSAGE_STATUS = 0x80;
+
+
+// Returns an iterator over the frames in a Buffer of packed records of the
+// given size, as objects with timestamp, id, ext, and buf properties. buf is a
+// view into the Buffer. With dataOnly set, status and error frames are
+// skipped.
+function* records(batch, size, dataOnly = false) {
+  for (let offset = 0; offset + size <= batch.length; offset += size) {
+    let len = batch[offset + RECORD_LEN];
+
+    if (dataOnly && (batch[offset + RECORD_MSGTYPE] & (PCAN_MESSAGE_STATUS | PCAN_MESSAGE_ERRFRAME))) {
+      continue;
+    }
+
+    yield {
+      timestamp: Number(batch.readBigUInt64LE(offset + RECORD_TIMESTAMP)),
+      id: batch.readUInt32LE(offset + RECORD_ID),
+      ext: ((batch[offset + RECORD_MSGTYPE] & 0x02) ? true : false),
+      buf: batch.subarray(offset + RECORD_DATA, offset + RECORD_DATA + len),
+    };
+  }
+}
+
+
+// Returns the capture format for a file, given an explicit format name or
+// else the file's extension
+function captureFormat(path, format) {
+  if (format) {
+    return format;
+  }
+
+  let dot = path.lastIndexOf('.');
+  let ext = (dot > Math.max(path.lastIndexOf('/'), path.lastIndexOf('\\'))) ?
+    path.slice(dot).toLowerCase() : '';
+
+  return FORMAT_EXTENSIONS[ext] || 'native';
+}
+
+
+class CaptureReader {
+
+  // Opens a capture file. options.index is one of 'auto' (default), 'build',
+  // or 'memory'
+  constructor(path, options = {}) {
+    let mode = INDEX_MODES[options.index || 'auto'];
+
+    if (mode === undefined) {
+      throw new Error("Unknown index mode: " + options.index);
+    }
+
+    this.path = path;
+    this._reader = pcan.ReaderOpen(path, mode);
+    this.info = pcan.ReaderInfo(this._reader);
+  }
+
+  // Returns an iterator over Buffers of packed frame records (info.recordSize
+  // bytes each) matching all of the given criteria:
+  //   ids        array of CAN IDs (default: all)
+  //   from       earliest timestamp, in microseconds (default: start of file)
+  //   to         latest timestamp, in microseconds (default: end of file)
+  //   batchSize  maximum number of frames per Buffer
+  *query({ ids = [], from = 0, to = Infinity, batchSize = DEFAULT_BATCH_SIZE } = {}) {
+    let q = pcan.ReaderQuery(this._reader, ids, from, to);
+
+    while (true) {
+      let batch = pcan.ReaderNext(q, batchSize);
+      if (batch.length == 0) {
+        return;
+      }
+      yield batch;
+    }
+  }
+
+  // Returns an iterator over the frames in a packed batch, as objects with
+  // timestamp, id, ext, and buf properties. buf is a view into the batch.
+  frames(batch) {
+    return records(batch, this.info.recordSize);
+  }
+
+  // Unmaps the file once any unfinished queries have also been released
+  close() {
+    if (this._reader) {
+      pcan.ReaderClose(this._reader);
+      this._reader = null;
+    }
+  }
+}
+
+
+module.exports = {
+  CaptureReader: CaptureReader,
+  records: records,
+  captureFormat: captureFormat,
+};
@@ -0,0 +1,82 @@
+/* Periodic messages sent by the native cyclic scheduler
+
+   PcanUsb.cyclic schedules messages such as heartbeats and status broadcasts
+   on a native thread, which writes each one at its deadline regardless of what
+   the JavaScript event loop is doing. A message's data can be replaced while
+   it is running without disturbing its period.
+
+   Copyright (c) 2020 Control Solutions LLC. All rights reserved.
+*/
+
+'use strict';
+
+const pcan = require('./binding');
+const tpcan = require('./tpcan');
+
+
+class CyclicScheduler {
+
+  constructor(can) {
+    this._can = can;
+  }
+
+  // Starts sending msg ({ id, ext, buf }) every periodUs microseconds, and
+  // returns a handle for it. options (all optional):
+  //   count  number of transmissions, after which the message stops but
+  //          keeps its statistics until removed (default 0, no limit)
+  //   phase  delay before the first transmission, in microseconds (default
+  //          0, at once); messages with the same period and different phases
+  //          stay that far apart
+  add(msg, periodUs, options = {}) {
+    return pcan.CyclicAdd(this._channel(), this._frame(msg), periodUs, options);
+  }
+
+  // Replaces the identifier and data of a running message. Its next
+  // transmission carries either the old message or the new one, never a mix,
+  // and its schedule is unchanged.
+  update(handle, msg) {
+    pcan.CyclicUpdate(this._channel(), handle, this._frame(msg));
+  }
+
+  // Stops sending a message, and returns its final statistics
+  remove(handle) {
+    return pcan.CyclicRemove(this._channel(), handle);
+  }
+
+  // Returns statistics for a message:
+  // { sent, errors, late, missed, meanLateUs, maxLateUs, lastLateUs,
+  // remaining, active, lastError }
+  // Lateness is measured from each deadline to the call to the driver; late
+  // counts transmissions more than 1 ms late, and missed counts periods
+  // skipped because the scheduler fell a whole period behind.
+  stats(handle) {
+    return pcan.CyclicStats(this._channel(), handle);
+  }
+
+  _channel() {
+    if (!this._can.isOpen()) {
+      throw new Error("CAN port is not open");
+    }
+    if (this._can._offline) {
+      throw new Error("Not available when reading from a capture file");
+    }
+    if (this._can._fd) {
+      throw new Error("Not available on a CAN FD channel");
+    }
+
+    return this._can.port;
+  }
+
+  _frame(msg) {
+    if (msg.buf.length > 8) {
+      throw new Error("Tried to send invalid CAN data");
+    }
+
+    return tpcan.toFrames([msg]);
+  }
+}
+
+
+module.exports = {
+  CyclicScheduler: CyclicScheduler
+};
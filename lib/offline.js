@@ -0,0 +1,145 @@
+/* Feeds frames from a capture file into a PcanUsb stream in place of a port
+
+   PcanUsb.open(path) reads a native capture or PEAK trace file through
+   CaptureReader or TrcReader, and pushes its data frames into the stream in
+   batches, as fast as the consumer reads them or at an accelerated rate
+   relative to the recorded timing. Each frame keeps its recorded timestamp, in
+   microseconds (offsets from the start of the file, for trace files).
+
+   Copyright (c) 2020 Control Solutions LLC. All rights reserved.
+*/
+
+'use strict';
+
+const { CaptureReader, captureFormat, records } = require('./capture');
+const { TrcReader } = require('./trc');
+
+// Size of each record in a trace file batch
+const TRC_RECORD_SIZE = 24;
+
+
+class OfflineSource {
+
+  // Opens a capture file. options (all optional):
+  //   format  'native' or 'trc'; by default, taken from the extension of path
+  //   speed   playback speed factor relative to the recorded timing, or 0
+  //           (default) to deliver frames as fast as they are consumed
+  //   ids     array of CAN IDs to deliver; others are skipped
+  //   index   index mode for native files (see CaptureReader)
+  constructor(path, options = {}) {
+    let format = captureFormat(path, options.format);
+
+    this.path = path;
+    this.speed = options.speed || 0;
+    this.frames = 0;
+    this._ids = null;
+
+    if (format == 'native') {
+      this._reader = new CaptureReader(path, { index: options.index });
+      this._batches = this._reader.query({ ids: options.ids });
+      this._recordSize = this._reader.info.recordSize;
+    } else if (format == 'trc') {
+      this._reader = new TrcReader(path);
+      this._batches = this._reader.batches();
+      this._recordSize = TRC_RECORD_SIZE;
+      this._ids = options.ids ? new Set(options.ids) : null;
+    } else {
+      throw new Error("Only native and trc captures can be opened.");
+    }
+
+    this._frames = null;
+    this._next = null;
+    this._first = undefined;
+    this._start = undefined;
+    this._timer = null;
+  }
+
+  // Pushes frames until push() returns false, the next frame is not yet due,
+  // or the file ends, in which case null is pushed
+  pump(push) {
+    if (this._timer) {
+      return;
+    }
+
+    while (true) {
+      let msg = this._peek();
+
+      if (msg === null) {
+        this.close();
+        push(null);
+        return;
+      }
+
+      if (this.speed > 0) {
+        let wait = this._due(msg.timestamp);
+        if (wait > 0) {
+          this._timer = setTimeout(() => {
+            this._timer = null;
+            this.pump(push);
+          }, wait);
+          return;
+        }
+      }
+
+      this._next = null;
+      this.frames++;
+
+      if (!push(msg)) {
+        return;
+      }
+    }
+  }
+
+  // Returns the number of milliseconds until a frame is due
+  _due(timestamp) {
+    let now = Number(process.hrtime.bigint() / 1000n);
+
+    if (this._first === undefined) {
+      this._first = timestamp;
+      this._start = now;
+    }
+
+    let deadline = this._start + (timestamp - this._first) / this.speed;
+    return Math.floor((deadline - now) / 1000);
+  }
+
+  // Returns the next data frame as a message, or null at the end of the file
+  _peek() {
+    while (this._next === null) {
+      let frame = this._frames ? this._frames.next() : { done: true };
+
+      if (frame.done) {
+        let batch = this._batches ? this._batches.next() : { done: true };
+        if (batch.done) {
+          this._batches = null;
+          return null;
+        }
+        this._frames = records(batch.value, this._recordSize, true);
+      } else if (!this._ids || this._ids.has(frame.value.id)) {
+        this._next = frame.value;
+      }
+    }
+
+    return this._next;
+  }
+
+  // Stops delivering frames and closes the file
+  close() {
+    if (this._timer) {
+      clearTimeout(this._timer);
+      this._timer = null;
+    }
+    this._batches = null;
+    this._frames = null;
+    this._next = null;
+    if (this._reader) {
+      this._reader.close();
+      this._reader = null;
+    }
+  }
+}
+
+
+module.exports = {
+  OfflineSource: OfflineSource,
+};
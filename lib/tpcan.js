@@ -75,13 +75,230 @@ function toMsg(tpcanmsg) {
   let msg = {};
 
   msg.id = tpcanmsg.id;
-  msg.ext = (tpcanmsg.msgtype === 0x02 ? true : false);
+  msg.ext = !!(tpcanmsg.msgtype & MSGTYPE_EXTENDED);
   msg.buf = Buffer.from(tpcanmsg.data);
 
   return msg;
 }
 
 
+// Size and field offsets of the packed frame records returned by ReadBatch
+// (see pcan_frame.h)
+const FRAME_SIZE = 24;
+const FRAME_TIMESTAMP = 0;
+const FRAME_ID = 8;
+const FRAME_MSGTYPE = 12;
+const FRAME_LEN = 13;
+const FRAME_FLAGS = 14;
+const FRAME_SOURCE = 15;
+const FRAME_DATA = 16;
+
+// Bit of the flags field marking a frame transmitted by this host
+const FRAME_FLAG_TX = 0x01;
+
+// Bit of the flags field marking a message whose latest value alone matters
+const FRAME_FLAG_COALESCE = 0x02;
+
+// Message type bits (see PCANBasic.h)
+const MSGTYPE_EXTENDED = 0x02;
+const MSGTYPE_FD = 0x04;
+const MSGTYPE_BRS = 0x08;
+const MSGTYPE_ESI = 0x10;
+
+
+// Convert a Buffer of packed frame records into an array of messages. Message
+// data are views into the same Buffer rather than copies. Each message also
+// carries the adapter's timestamp, in microseconds, and whether it is the
+// looped-back echo of a frame transmitted by this host (tx).
+function fromFrames(frames) {
+  let msgs = [];
+
+  for (let offset = 0; offset + FRAME_SIZE <= frames.length; offset += FRAME_SIZE) {
+    let len = frames[offset + FRAME_LEN];
+    let msg = {};
+
+    msg.id = frames.readUInt32LE(offset + FRAME_ID);
+    msg.ext = !!(frames[offset + FRAME_MSGTYPE] & MSGTYPE_EXTENDED);
+    msg.buf = frames.subarray(offset + FRAME_DATA, offset + FRAME_DATA + len);
+    msg.tx = !!(frames[offset + FRAME_FLAGS] & FRAME_FLAG_TX);
+    msg.timestamp = Number(frames.readBigUInt64LE(offset + FRAME_TIMESTAMP));
+
+    msgs.push(msg);
+  }
+
+  return msgs;
+}
+
+
+// Pack an array of messages into a Buffer of frame records, as accepted by
+// WriteBatch. Messages must carry at most 8 bytes of data. Messages with
+// coalesce set, or every message if coalesce is true, are flagged to replace
+// a pending message with the same ID in the transmit queue. A message's ttl
+// (milliseconds from now) or deadline (a Date.now() time) is packed into the
+// timestamp field as a time to live in microseconds. If sourceOf is given,
+// sourceOf(msg) is the index of the transmit source the message is queued
+// from.
+function toFrames(msgs, coalesce = false, sourceOf = undefined) {
+  let frames = Buffer.alloc(msgs.length * FRAME_SIZE);
+  let now = Date.now();
+
+  for (let i = 0; i < msgs.length; i++) {
+    let offset = i * FRAME_SIZE;
+    let msg = msgs[i];
+
+    frames.writeUInt32LE(msg.id, offset + FRAME_ID);
+    frames[offset + FRAME_MSGTYPE] = (msg.ext ? MSGTYPE_EXTENDED : 0x00);
+    frames[offset + FRAME_LEN] = msg.buf.length;
+    frames[offset + FRAME_FLAGS] = ((coalesce || msg.coalesce) ? FRAME_FLAG_COALESCE : 0);
+    if (sourceOf) {
+      frames[offset + FRAME_SOURCE] = sourceOf(msg);
+    }
+
+    let ttl = (msg.deadline !== undefined) ? msg.deadline - now : msg.ttl;
+    if (ttl !== undefined) {
+      // A deadline already past still needs a nonzero time to live
+      frames.writeBigUInt64LE(BigInt(Math.max(1, Math.round(ttl * 1000))), offset + FRAME_TIMESTAMP);
+    }
+    frames.set(msg.buf, offset + FRAME_DATA);
+  }
+
+  return frames;
+}
+
+
+// Size of the packed CAN FD frame records returned by ReadBatch on a channel
+// initialized for CAN FD, and taken by WriteBatchFD (see pcan_frame.h). The
+// fields are at the same offsets as in classic records, followed by up to 64
+// bytes of data.
+const FRAME_FD_SIZE = 80;
+const FRAME_FD_DATA_MAX = 64;
+
+// Data length, in bytes, of each DLC code of a CAN FD frame
+const DLC_LENGTHS = [0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64];
+
+
+// Returns the data length, in bytes, of a DLC code
+function dlcToLength(dlc) {
+  return DLC_LENGTHS[dlc & 0x0F];
+}
+
+
+// Returns the smallest DLC code whose data length holds len bytes. A CAN FD
+// frame whose data falls between two lengths is padded with zeros to the
+// longer one.
+function lengthToDlc(len) {
+  let dlc = 0;
+
+  while ((dlc < 15) && (DLC_LENGTHS[dlc] < len)) {
+    dlc++;
+  }
+
+  return dlc;
+}
+
+
+// Convert a Buffer of packed CAN FD frame records into an array of messages,
+// as fromFrames() does. Each message also tells whether it is a CAN FD frame
+// (fd), whether its data was sent at the data bit rate (brs), and whether
+// its sender was error passive (esi).
+function fromFramesFD(frames) {
+  let msgs = [];
+
+  for (let offset = 0; offset + FRAME_FD_SIZE <= frames.length; offset += FRAME_FD_SIZE) {
+    let msgtype = frames[offset + FRAME_MSGTYPE];
+    let len = frames[offset + FRAME_LEN];
+    let msg = {};
+
+    msg.id = frames.readUInt32LE(offset + FRAME_ID);
+    msg.ext = !!(msgtype & MSGTYPE_EXTENDED);
+    msg.fd = !!(msgtype & MSGTYPE_FD);
+    msg.brs = !!(msgtype & MSGTYPE_BRS);
+    msg.esi = !!(msgtype & MSGTYPE_ESI);
+    msg.buf = frames.subarray(offset + FRAME_DATA, offset + FRAME_DATA + len);
+    msg.tx = !!(frames[offset + FRAME_FLAGS] & FRAME_FLAG_TX);
+    msg.timestamp = Number(frames.readBigUInt64LE(offset + FRAME_TIMESTAMP));
+
+    msgs.push(msg);
+  }
+
+  return msgs;
+}
+
+
+// Pack an array of messages into a Buffer of CAN FD frame records, as
+// accepted by WriteBatchFD. Messages are sent as CAN FD frames, carrying up
+// to 64 bytes of data, unless their fd is false, and with their data at the
+// data bit rate unless their brs is false. A classic frame must carry at
+// most 8 bytes.
+function toFramesFD(msgs) {
+  let frames = Buffer.alloc(msgs.length * FRAME_FD_SIZE);
+
+  for (let i = 0; i < msgs.length; i++) {
+    let offset = i * FRAME_FD_SIZE;
+    let msg = msgs[i];
+    let msgtype = (msg.ext ? MSGTYPE_EXTENDED : 0);
+
+    if (msg.fd !== false) {
+      msgtype |= MSGTYPE_FD | ((msg.brs !== false) ? MSGTYPE_BRS : 0);
+    }
+
+    frames.writeUInt32LE(msg.id, offset + FRAME_ID);
+    frames[offset + FRAME_MSGTYPE] = msgtype;
+    frames[offset + FRAME_LEN] = msg.buf.length;
+    frames.set(msg.buf, offset + FRAME_DATA);
+  }
+
+  return frames;
+}
+
+
+// Ranges of the bit timing fields of a CAN FD bit rate string, in time
+// quanta (brp in clock periods), and the clock frequencies, in MHz, that
+// PCAN-Basic accepts
+const FD_TIMING_RANGES = {
+  nominal: { brp: [1, 1024], tseg1: [1, 256], tseg2: [1, 128], sjw: [1, 128] },
+  data: { brp: [1, 1024], tseg1: [1, 32], tseg2: [1, 16], sjw: [1, 16] },
+};
+const FD_CLOCKS_MHZ = [20, 24, 30, 40, 60, 80];
+
+
+// Returns the bit rate string taken by InitializeFD for the bit timing of
+// the nominal (arbitration) and data phases:
+//   { clockMhz, nominal: { brp, tseg1, tseg2, sjw }, data: { ... } }
+// clockMhz defaults to 80, and sjw to tseg2. Throws a RangeError if a value
+// is out of range.
+function fdBitrate(timing) {
+  let clockMhz = (timing.clockMhz !== undefined) ? timing.clockMhz : 80;
+  let fields = ['f_clock_mhz=' + clockMhz];
+
+  if (!FD_CLOCKS_MHZ.includes(clockMhz)) {
+    throw new RangeError("Unsupported CAN FD clock frequency: " + clockMhz + " MHz");
+  }
+
+  for (let phase of ['nominal', 'data']) {
+    let prefix = (phase == 'nominal') ? 'nom_' : 'data_';
+    let segments = Object.assign({}, timing[phase]);
+
+    if (segments.sjw === undefined) {
+      segments.sjw = segments.tseg2;
+    }
+
+    for (let name of ['brp', 'tseg1', 'tseg2', 'sjw']) {
+      let [min, max] = FD_TIMING_RANGES[phase][name];
+      let value = segments[name];
+
+      if (!Number.isInteger(value) || (value < min) || (value > max)) {
+        throw new RangeError("CAN FD " + phase + " " + name + " must be from " + min +
+                             " to " + max);
+      }
+      fields.push(prefix + name + '=' + value);
+    }
+  }
+
+  return fields.join(',');
+}
+
+
 module.exports = {
   TPCANMsg: TPCANMsg,
   TPCANTimestamp: TPCANTimestamp,
@@ -89,5 +306,15 @@ module.exports = {
   TPCANTimestampFD: TPCANTimestampFD,
   TPCANChannelInfo: TPCANChannelInfo,
   toTPCANMsg: toTPCANMsg,
-  toMsg: toMsg
+  toMsg: toMsg,
+  fromFrames: fromFrames,
+  toFrames: toFrames,
+  fromFramesFD: fromFramesFD,
+  toFramesFD: toFramesFD,
+  dlcToLength: dlcToLength,
+  lengthToDlc: lengthToDlc,
+  fdBitrate: fdBitrate,
+  FRAME_SIZE: FRAME_SIZE,
+  FRAME_FD_SIZE: FRAME_FD_SIZE,
+  FRAME_FD_DATA_MAX: FRAME_FD_DATA_MAX
 };
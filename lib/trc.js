@@ -0,0 +1,69 @@
+/* Reads PEAK trace (.trc) files, version 2.0 and 2.1
+
+   Lines are parsed by the native addon, which streams the file through a
+   fixed-size buffer and returns the data frames as Buffers of packed records,
+   in the same layout as CaptureReader batches. Frame timestamps are offsets
+   from the start of the file, in microseconds; info.startTime gives the wall
+   clock time of the start of the file.
+
+   Copyright (c) 2020 Control Solutions LLC. All rights reserved.
+*/
+
+'use strict';
+
+const pcan = require('./binding');
+const { records } = require('./capture');
+
+// Default number of frames in each batch
+const DEFAULT_BATCH_SIZE = 4096;
+
+// Size of each record in a batch (see pcan_frame.h)
+const RECORD_SIZE = 24;
+
+
+class TrcReader {
+
+  // Opens a trace file and reads its header
+  constructor(path) {
+    this.path = path;
+    this._reader = pcan.TrcOpen(path);
+  }
+
+  // Returns { version, startTime, lines, skipped }, where startTime is in
+  // microseconds since the Unix epoch, and lines and skipped count the
+  // message lines read so far, and those that were not data frames
+  get info() {
+    return pcan.TrcInfo(this._reader);
+  }
+
+  // Returns an iterator over Buffers of packed frame records (24 bytes each),
+  // reading through to the end of the file
+  *batches(batchSize = DEFAULT_BATCH_SIZE) {
+    while (true) {
+      let batch = pcan.TrcNext(this._reader, batchSize);
+      if (batch.length == 0) {
+        return;
+      }
+      yield batch;
+    }
+  }
+
+  // Returns an iterator over the frames in a batch, as objects with
+  // timestamp, id, ext, and buf properties. buf is a view into the batch.
+  frames(batch) {
+    return records(batch, RECORD_SIZE);
+  }
+
+  // Closes the file
+  close() {
+    if (this._reader) {
+      pcan.TrcClose(this._reader);
+      this._reader = null;
+    }
+  }
+}
+
+
+module.exports = {
+  TrcReader: TrcReader
+};
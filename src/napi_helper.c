@@ -81,6 +81,36 @@ const char napiValuetypeUnknown[] = "N-API valuetype unknown";
 // Local functions
 
 
+// Look up a named property of type expected on an object
+// Returns true if the property exists and has the expected type
+static bool napiGetTypedProperty(napi_env env, napi_value object, const char *name,
+                                 napi_valuetype expected, napi_value *property)
+{
+    napi_status status = napi_generic_failure;
+    napi_valuetype vt;
+
+    status = napi_typeof(env, object, &vt);
+    if ((status != napi_ok) || (vt != napi_object))
+    {
+        return false;
+    }
+
+    status = napi_get_named_property(env, object, name, property);
+    if (status != napi_ok)
+    {
+        return false;
+    }
+
+    status = napi_typeof(env, *property, &vt);
+    if ((status != napi_ok) || (vt != expected))
+    {
+        return false;
+    }
+
+    return true;
+}
+
+
 
 
 // ----------------------------------- // -----------------------------------
@@ -261,3 +291,50 @@ void napiDumpErrorInfo(const napi_extended_error_info *errorInfo)
 }
 
 
+
+
+bool napiGetOptionalDouble(napi_env env, napi_value object, const char *name,
+                           double *value)
+{
+    napi_value property;
+
+    if (!napiGetTypedProperty(env, object, name, napi_number, &property))
+    {
+        return false;
+    }
+
+    return (napi_get_value_double(env, property, value) == napi_ok);
+}
+
+
+
+
+bool napiGetOptionalBool(napi_env env, napi_value object, const char *name,
+                         bool *value)
+{
+    napi_value property;
+
+    if (!napiGetTypedProperty(env, object, name, napi_boolean, &property))
+    {
+        return false;
+    }
+
+    return (napi_get_value_bool(env, property, value) == napi_ok);
+}
+
+
+
+
+bool napiGetOptionalString(napi_env env, napi_value object, const char *name,
+                           char *value, size_t size)
+{
+    napi_value property;
+    size_t length = 0;
+
+    if (!napiGetTypedProperty(env, object, name, napi_string, &property))
+    {
+        return false;
+    }
+
+    return (napi_get_value_string_utf8(env, property, value, size, &length) == napi_ok);
+}
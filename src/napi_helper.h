@@ -66,6 +66,29 @@ bool napiCheck(napi_env env, napi_status status);
 void napiDumpErrorInfo(const napi_extended_error_info *errorInfo);
 
 
+// Retrieve an optional numeric property of an object. If object is not an
+// object, or the property is undefined or not a number, value is left unchanged.
+// Returns true if value was set, and false otherwise
+bool napiGetOptionalDouble(napi_env env, napi_value object, const char *name,
+                           double *value);
+
+
+// Retrieve an optional boolean property of an object. If object is not an
+// object, or the property is undefined or not a boolean, value is left
+// unchanged.
+// Returns true if value was set, and false otherwise
+bool napiGetOptionalBool(napi_env env, napi_value object, const char *name,
+                         bool *value);
+
+
+// Retrieve an optional string property of an object into a buffer of size
+// bytes. If object is not an object, or the property is undefined or not a
+// string, value is left unchanged. Longer strings are truncated.
+// Returns true if value was set, and false otherwise
+bool napiGetOptionalString(napi_env env, napi_value object, const char *name,
+                           char *value, size_t size);
+
+
 
 
 #endif // _NAPI_HELPER_H_
@@ -9,6 +9,7 @@
 
 #include <assert.h>      // provide assert
 #include <node_api.h>    // provide N-API types, constants, and functions
+#include <stddef.h>      // provide offsetof
 #include <stdio.h>       // provide printf
 #include <string.h>      // provide memcpy
 #include <stdlib.h>      // provide malloc and free
@@ -25,6 +26,18 @@
 #include "pcan.h"
 #include "pcan_helper.h" // provide pcanDLCDecode
 #include "napi_helper.h" // provide DECLARE_NAPI_METHOD
+#include "pcan_capture.h" // provide pcanCaptureStart and pcanCaptureStop
+#include "pcan_cyclic.h" // provide pcanCyclicStart and pcanCyclicAdd
+#include "pcan_detect.h" // provide pcanDetectStart and pcanDetectStop
+#include "pcan_mdf4.h"   // provide PCAN_MDF4_COMPRESS_DEFAULT
+#include "pcan_reader.h" // provide pcanReaderOpen and pcanReaderQueryNext
+#include "pcan_timed.h"  // provide pcanTimedStart and pcanTimedAt
+#include "pcan_timing.h" // provide pcanTimingSolve and pcanTimingSolveFD
+#include "pcan_receive.h" // provide pcanReceiveDrain and pcanReceivePop
+#include "pcan_replay.h" // provide pcanReplayStart and pcanReplayStop
+#include "pcan_request.h" // provide pcanRequestStart and pcanRequestSend
+#include "pcan_transmit.h" // provide pcanTransmitStart and pcanTransmitPush
+#include "pcan_trc.h"    // provide pcanTrcOpen and pcanTrcRead
 
 
 // ----------------------------------- // -----------------------------------
@@ -32,7 +45,78 @@
 
 
 // Length of N-API module descriptor list, used in Init
-enum { descriptors_len = 19 };
+enum { descriptors_len = 67 };
+
+// Maximum number of frames returned by a single call to pcan_CAN_ReadBatch
+#define PCAN_READBATCH_MAX (1024)
+
+// Maximum number of results returned by a single call to
+// pcan_CAN_TransmitResults
+#define PCAN_TRANSMITRESULTS_MAX (4096)
+
+// Maximum number of channels with native state at once
+#define PCAN_CHANNELS_MAX (16)
+
+// Maximum number of records returned by a single call to pcan_CAN_ReaderNext
+#define PCAN_READERNEXT_MAX (65536)
+
+// Maximum number of frames returned by a single call to pcan_CAN_TrcNext
+#define PCAN_TRCNEXT_MAX (65536)
+
+// Handles passed to JavaScript as externals. They can be closed explicitly,
+// after which the finalizer has nothing left to free.
+typedef struct pcanReaderHandle_s
+{
+    pcanReader_t *reader;
+} pcanReaderHandle_t;
+
+typedef struct pcanQueryHandle_s
+{
+    pcanReaderQuery_t *query;
+} pcanQueryHandle_t;
+
+typedef struct pcanTrcHandle_s
+{
+    pcanTrcReader_t *reader;
+} pcanTrcHandle_t;
+
+// Receive filters and loopback for a channel, as set by
+// pcan_CAN_ReceiveConfigure
+typedef struct pcanReceiveConfig_s
+{
+    pcanReceiveFilter_t filters[PCAN_RECEIVE_FILTERS_MAX];
+    uint32_t filterCount;
+    int loopback;
+} pcanReceiveConfig_t;
+
+// Receive path of a channel, enabled by pcan_CAN_EnableEvent: the driver's
+// receive event and the worker thread waiting on it, the ring and statistics
+// the worker thread drains the driver into, and the data read callback it
+// wakes JavaScript with. Each channel has its own, so that channels are
+// received independently.
+typedef struct pcanEventContext_s
+{
+    pcanReceive_t receive;
+    napi_threadsafe_function callback;
+    pcanEvent_t *event;
+} pcanEventContext_t;
+
+// Everything kept natively for a channel, keyed by its handle. Each part is
+// started and stopped on its own, and the entry is free again once all of
+// them are, so that there is nothing else to release.
+typedef struct pcanChannelContext_s
+{
+    TPCANHandle channel;
+    int fd;                // Initialized by pcan_CAN_InitializeFD
+    pcanReceiveConfig_t config; // Applied to a receive path enabled later
+    pcanEventContext_t *eventContext; // Set by pcan_CAN_EnableEvent
+    pcanTransmit_t *transmit; // Set by pcan_CAN_TransmitStart
+    pcanCyclic_t *cyclic;  // Set by pcan_CAN_CyclicAdd
+    pcanTimed_t *timed;    // Set by pcan_CAN_TimedStart
+    pcanRequest_t *request; // Set by pcan_CAN_RequestStart
+    pcanReplay_t *replay;  // Set by pcan_CAN_ReplayStart
+    pcanDetect_t *detect;  // Set by pcan_CAN_DetectStart
+} pcanChannelContext_t;
 
 
 
@@ -46,9 +130,10 @@ enum { descriptors_len = 19 };
 // ----------------------------------- // -----------------------------------
 // Local variables
 
-// Data read callback function, created in main thread and called from worker
-// thread
-napi_threadsafe_function pcanCallback = { 0 };
+// Native state of each channel. The notify or done context of each thread
+// started for a channel is its callback, created in main thread and called
+// from that thread.
+pcanChannelContext_t pcanChannelContexts[PCAN_CHANNELS_MAX] = { 0 };
 
 
 
@@ -82,7 +167,7 @@ napi_value Init(napi_env env, napi_value exports)
         DECLARE_NAPI_METHOD("Read", pcan_CAN_Read),
         DECLARE_NAPI_METHOD("ReadFD", pcan_CAN_ReadFD),
         DECLARE_NAPI_METHOD("Write", pcan_CAN_Write),
-        DECLARE_NAPI_METHOD("WriteFD", pcan_CAN_Write),
+        DECLARE_NAPI_METHOD("WriteFD", pcan_CAN_WriteFD),
         DECLARE_NAPI_METHOD("GetValue", pcan_CAN_GetValue),
         DECLARE_NAPI_METHOD("SetValue", pcan_CAN_SetValue),
         DECLARE_NAPI_METHOD("FilterMessages", pcan_CAN_FilterMessages),
@@ -92,8 +177,56 @@ napi_value Init(napi_env env, napi_value exports)
         DECLARE_NAPI_METHOD("DisableEvent", pcan_CAN_DisableEvent),
         DECLARE_NAPI_METHOD("AcceptanceFilter29Bit", pcan_CAN_AcceptanceFilter29Bit),
         DECLARE_NAPI_METHOD("AcceptanceFilter11Bit", pcan_CAN_AcceptanceFilter11Bit),
+        DECLARE_NAPI_METHOD("ReceiveConfigure", pcan_CAN_ReceiveConfigure),
         DECLARE_NAPI_METHOD("ChannelInfo", pcan_CAN_ChannelInfo),
         DECLARE_NAPI_METHOD("TranslateBaud", pcan_CAN_TranslateBaud),
+        DECLARE_NAPI_METHOD("BitTiming", pcan_CAN_BitTiming),
+        DECLARE_NAPI_METHOD("ReadBatch", pcan_CAN_ReadBatch),
+        DECLARE_NAPI_METHOD("WriteBatch", pcan_CAN_WriteBatch),
+        DECLARE_NAPI_METHOD("WriteBatchFD", pcan_CAN_WriteBatchFD),
+        DECLARE_NAPI_METHOD("TransmitStart", pcan_CAN_TransmitStart),
+        DECLARE_NAPI_METHOD("TransmitPush", pcan_CAN_TransmitPush),
+        DECLARE_NAPI_METHOD("TransmitCancel", pcan_CAN_TransmitCancel),
+        DECLARE_NAPI_METHOD("TransmitResults", pcan_CAN_TransmitResults),
+        DECLARE_NAPI_METHOD("TransmitStats", pcan_CAN_TransmitStats),
+        DECLARE_NAPI_METHOD("TransmitSource", pcan_CAN_TransmitSource),
+        DECLARE_NAPI_METHOD("TransmitSourceStats", pcan_CAN_TransmitSourceStats),
+        DECLARE_NAPI_METHOD("TransmitLatency", pcan_CAN_TransmitLatency),
+        DECLARE_NAPI_METHOD("TransmitStop", pcan_CAN_TransmitStop),
+        DECLARE_NAPI_METHOD("CyclicAdd", pcan_CAN_CyclicAdd),
+        DECLARE_NAPI_METHOD("CyclicUpdate", pcan_CAN_CyclicUpdate),
+        DECLARE_NAPI_METHOD("CyclicRemove", pcan_CAN_CyclicRemove),
+        DECLARE_NAPI_METHOD("CyclicStats", pcan_CAN_CyclicStats),
+        DECLARE_NAPI_METHOD("CyclicStop", pcan_CAN_CyclicStop),
+        DECLARE_NAPI_METHOD("TimedStart", pcan_CAN_TimedStart),
+        DECLARE_NAPI_METHOD("TimedAt", pcan_CAN_TimedAt),
+        DECLARE_NAPI_METHOD("TimedAfter", pcan_CAN_TimedAfter),
+        DECLARE_NAPI_METHOD("TimedCancel", pcan_CAN_TimedCancel),
+        DECLARE_NAPI_METHOD("TimedResults", pcan_CAN_TimedResults),
+        DECLARE_NAPI_METHOD("TimedStop", pcan_CAN_TimedStop),
+        DECLARE_NAPI_METHOD("RequestStart", pcan_CAN_RequestStart),
+        DECLARE_NAPI_METHOD("RequestSend", pcan_CAN_RequestSend),
+        DECLARE_NAPI_METHOD("RequestCancel", pcan_CAN_RequestCancel),
+        DECLARE_NAPI_METHOD("RequestResults", pcan_CAN_RequestResults),
+        DECLARE_NAPI_METHOD("RequestStop", pcan_CAN_RequestStop),
+        DECLARE_NAPI_METHOD("HostTime", pcan_CAN_HostTime),
+        DECLARE_NAPI_METHOD("StartCapture", pcan_CAN_StartCapture),
+        DECLARE_NAPI_METHOD("StopCapture", pcan_CAN_StopCapture),
+        DECLARE_NAPI_METHOD("CaptureStats", pcan_CAN_CaptureStats),
+        DECLARE_NAPI_METHOD("ReaderOpen", pcan_CAN_ReaderOpen),
+        DECLARE_NAPI_METHOD("ReaderInfo", pcan_CAN_ReaderInfo),
+        DECLARE_NAPI_METHOD("ReaderQuery", pcan_CAN_ReaderQuery),
+        DECLARE_NAPI_METHOD("ReaderNext", pcan_CAN_ReaderNext),
+        DECLARE_NAPI_METHOD("ReaderClose", pcan_CAN_ReaderClose),
+        DECLARE_NAPI_METHOD("TrcOpen", pcan_CAN_TrcOpen),
+        DECLARE_NAPI_METHOD("TrcInfo", pcan_CAN_TrcInfo),
+        DECLARE_NAPI_METHOD("TrcNext", pcan_CAN_TrcNext),
+        DECLARE_NAPI_METHOD("TrcClose", pcan_CAN_TrcClose),
+        DECLARE_NAPI_METHOD("ReplayStart", pcan_CAN_ReplayStart),
+        DECLARE_NAPI_METHOD("ReplayStop", pcan_CAN_ReplayStop),
+        DECLARE_NAPI_METHOD("ReplayStats", pcan_CAN_ReplayStats),
+        DECLARE_NAPI_METHOD("DetectStart", pcan_CAN_DetectStart),
+        DECLARE_NAPI_METHOD("DetectStop", pcan_CAN_DetectStop),
     };
 
     status = napi_define_properties(env, exports, descriptors_len, descriptors);
@@ -105,15 +238,23 @@ napi_value Init(napi_env env, napi_value exports)
 
 
 
-void pcan_CAN_EventCallback(int channel)
+void pcan_CAN_EventCallback(void *context)
 {
     napi_status status = napi_generic_failure;
+    pcanEventContext_t *eventContext = (pcanEventContext_t*)context;
 
 #ifdef PCAN_DEBUG
     printf("pcan_CAN_EventCallback()\n");
 #endif
 
-    status = napi_call_threadsafe_function(pcanCallback, 0, true);
+    // Read everything waiting in the driver queue, and only wake JavaScript
+    // if it is not already due to collect frames
+    if (!pcanReceiveDrain(&(eventContext->receive)))
+    {
+        return;
+    }
+
+    status = napi_call_threadsafe_function(eventContext->callback, 0, true);
     assert(status == napi_ok);
 
     return;
@@ -132,64 +273,39 @@ void pcan_CAN_EventFinalize(napi_env env, void* finalize_data, void* finalize_hi
 
 
 
-// ----------------------------------- // -----------------------------------
-// Public functions
-
-
-napi_value pcan_CAN_Initialize(napi_env env, napi_callback_info info)
+// Create an N-API object from capture statistics
+static napi_value pcanCaptureStatsValue(napi_env env, const pcanCaptureStats_t *stats)
 {
     napi_status status = napi_generic_failure;
+    napi_value result;
+    napi_value value;
 
-    // Retrieve callback info and argument list
-    size_t argc = CAN_INITIALIZE_ARGC;
-    napi_value argv[CAN_INITIALIZE_ARGC];
-
-    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
+    status = napi_create_object(env, &result);
     assert(status == napi_ok);
 
-    if (argc != CAN_INITIALIZE_ARGC)
-    {
-        napi_throw_type_error(env, 0, "Incorrect number of arguments."
-                              "This implementation of CAN_Initialize accepts Channel and "
-                              "Btr0Btr1.");
-        return 0;
-    }
+    status = napi_create_double(env, (double)stats->frames, &value);
+    assert(status == napi_ok);
+    status = napi_set_named_property(env, result, "frames", value);
+    assert(status == napi_ok);
 
-    // Retrieve arguments
-    uint32_t pcanChannel;
-    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
+    status = napi_create_double(env, (double)stats->dropped, &value);
+    assert(status == napi_ok);
+    status = napi_set_named_property(env, result, "dropped", value);
     assert(status == napi_ok);
 
-    uint32_t pcanBtr0Btr1;
-    status = napi_get_value_uint32(env, argv[1], &pcanBtr0Btr1);
+    status = napi_create_double(env, (double)stats->bytes, &value);
+    assert(status == napi_ok);
+    status = napi_set_named_property(env, result, "bytes", value);
     assert(status == napi_ok);
 
-    // Initialize CAN bus
-    TPCANStatus pcanStatus = PCAN_ERROR_UNKNOWN;
-    pcanStatus = CAN_Initialize(pcanChannel, pcanBtr0Btr1, 0, 0, 0);
-   
-    // Print results to console
-#ifdef PCAN_DEBUG
-    printf("pcan_CAN_Initialize:\n"
-           "  pcanStatus = 0x%02X (%s)\n"
-           "  pcanChannel = 0x%02X\n"
-           "  pcanBtr0Btr1 = 0x%02X\n",
-           pcanStatus, pcanStatusLookup(pcanStatus),
-           pcanChannel,
-           pcanBtr0Btr1);
-#endif
+    status = napi_create_uint32(env, stats->files, &value);
+    assert(status == napi_ok);
+    status = napi_set_named_property(env, result, "files", value);
+    assert(status == napi_ok);
 
-    // Throw error, if any
-    if (pcanStatus != PCAN_ERROR_OK)
-    {
-        napi_throw_error(env, pcanStatusLookup(pcanStatus),
-                         "pcan_CAN_Initialize: Error at CAN_Initialize.");
-        return 0;
-    }
-    
-    // Create an N-API value for the result and return it
-    napi_value result;
-    status = napi_create_uint32(env, pcanStatus, &result);
+    status = napi_get_boolean(env, stats->error != 0, &value);
+    assert(status == napi_ok);
+    status = napi_set_named_property(env, result, "error", value);
     assert(status == napi_ok);
 
     return result;
@@ -198,225 +314,4355 @@ napi_value pcan_CAN_Initialize(napi_env env, napi_callback_info info)
 
 
 
-napi_value pcan_CAN_InitializeFD(napi_env env, napi_callback_info info)
+// Return nonzero if nothing is kept for a channel context, so that it is free
+// to be taken by another channel
+static int pcanChannelContextIdle(const pcanChannelContext_t *channelContext)
 {
-    napi_status status = napi_generic_failure;
+    return !channelContext->fd &&
+        (channelContext->config.filterCount == 0) && !channelContext->config.loopback &&
+        (channelContext->eventContext == 0) && (channelContext->transmit == 0) &&
+        (channelContext->cyclic == 0) && (channelContext->timed == 0) &&
+        (channelContext->request == 0) && (channelContext->replay == 0) &&
+        (channelContext->detect == 0);
+}
 
-    // Retrieve callback info and argument list
-    size_t argc = CAN_INITIALIZEFD_ARGC;
-    napi_value argv[CAN_INITIALIZEFD_ARGC];
 
-    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
-    assert(status == napi_ok);
 
-    if (argc != CAN_INITIALIZEFD_ARGC)
+
+// Return the context of a channel. If there is none and create is nonzero, a
+// free one is taken for the channel.
+// Returns the context, or 0 if there is none, or no free one to take
+static pcanChannelContext_t *pcanChannelContextFind(TPCANHandle channel, int create)
+{
+    pcanChannelContext_t *idle = 0;
+    size_t i;
+
+    for (i = 0; i < PCAN_CHANNELS_MAX; i++)
+    {
+        if (pcanChannelContexts[i].channel == channel)
+        {
+            return &(pcanChannelContexts[i]);
+        }
+        if ((idle == 0) && pcanChannelContextIdle(&(pcanChannelContexts[i])))
+        {
+            idle = &(pcanChannelContexts[i]);
+        }
+    }
+
+    if (!create || (idle == 0))
     {
-        napi_throw_type_error(env, 0, "Incorrect number of arguments.");
         return 0;
     }
 
-    // Retrieve arguments
-    uint32_t pcanChannel;
-    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
-    assert(status == napi_ok);
+    memset(idle, 0, sizeof(*idle));
+    idle->channel = channel;
 
-    char pcanBitrateFD[256] = { 0 };
-    size_t pcanBitrateFDResult = 0;
-    status = napi_get_value_string_utf8(env, argv[1], pcanBitrateFD,
-                                        sizeof(pcanBitrateFD), &pcanBitrateFDResult);
-    assert(status == napi_ok);
+    return idle;
+}
 
-    // Initialize CAN bus, with flexible data rate capabilities
-    TPCANStatus pcanStatus = PCAN_ERROR_UNKNOWN;
-    pcanStatus = CAN_InitializeFD(pcanChannel, pcanBitrateFD);
-    
-    // Print results to console
-#ifdef PCAN_DEBUG
-    printf("pcan_CAN_InitializeFD:\n"
-           "  pcanStatus = 0x%02X (%s)\n"
-           "  pcanChannel = 0x%02X\n"
-           "  pcanBitrateFD = \"%s\"\n",
-           pcanStatus, pcanStatusLookup(pcanStatus),
-           pcanChannel,
-           pcanBitrateFD);
-#endif
 
-    // Throw error, if any
-    if (pcanStatus != PCAN_ERROR_OK)
-    {
-        napi_throw_error(env, pcanStatusLookup(pcanStatus),
-                         "pcan_CAN_InitializeFD: Error at CAN_InitializeFD.");
-        return 0;
-    }
 
-    // Create N-API value for the result and return it
-    napi_value result;
-    status = napi_create_uint32(env, pcanStatus, &result);
-    assert(status == napi_ok);
 
-    return result;
+// Return the slot in a channel's context holding its transmit queue, or 0 if
+// it has none
+static pcanTransmit_t **pcanTransmitFind(TPCANHandle channel)
+{
+    pcanChannelContext_t *channelContext = pcanChannelContextFind(channel, 0);
+
+    return ((channelContext != 0) && (channelContext->transmit != 0)) ?
+        &(channelContext->transmit) : 0;
 }
 
 
 
 
-napi_value pcan_CAN_Uninitialize(napi_env env, napi_callback_info info)
+// Return the slot in a channel's context holding its receive path, or 0 if
+// it has none
+static pcanEventContext_t **pcanEventContextFind(TPCANHandle channel)
 {
-    napi_status status = napi_generic_failure;
+    pcanChannelContext_t *channelContext = pcanChannelContextFind(channel, 0);
 
-    // Retrieve callback info and argument list
-    size_t argc = CAN_UNINITIALIZE_ARGC;
-    napi_value argv[CAN_UNINITIALIZE_ARGC];
+    return ((channelContext != 0) && (channelContext->eventContext != 0)) ?
+        &(channelContext->eventContext) : 0;
+}
 
-    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
-    assert(status == napi_ok);
 
-    if (argc != CAN_UNINITIALIZE_ARGC)
-    {
-        napi_throw_type_error(env, 0, "Incorrect number of arguments.");
-        return 0;
-    }
 
-    // Retrieve arguments
-    uint32_t pcanChannel;
-    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
-    assert(status == napi_ok);
 
-    // Uninitialize CAN bus
-    TPCANStatus pcanStatus = PCAN_ERROR_UNKNOWN;
-    pcanStatus = CAN_Uninitialize(pcanChannel);
+// Return the receive path of a channel enabled by pcan_CAN_EnableEvent, or 0
+static pcanReceive_t *pcanReceiveFind(TPCANHandle channel)
+{
+    pcanEventContext_t **slot = pcanEventContextFind(channel);
 
-    // Print result to console
-#ifdef PCAN_DEBUG
-    printf("pcan_CAN_Uninitialize: 0x%02X (%s)\n",
-           pcanStatus, pcanStatusLookup(pcanStatus));
-#endif
+    return (slot != 0) ? &((*slot)->receive) : 0;
+}
 
-    // Throw error, if any
-    if (pcanStatus != PCAN_ERROR_OK)
-    {
-        napi_throw_error(env, pcanStatusLookup(pcanStatus),
-                         "pcan_CAN_Uninitialize: Error at CAN_Uninitialize.");
-        return 0;
-    }
 
-    // Create a N-API value for the result and return it
-    napi_value result;
-    status = napi_create_uint32(env, pcanStatus, &result);
+
+
+// Called on the writer thread when transmit results become available
+static void pcanTransmitNotify(void *context)
+{
+    napi_status status = napi_generic_failure;
+
+    status = napi_call_threadsafe_function((napi_threadsafe_function)context, 0,
+                                           napi_tsfn_nonblocking);
     assert(status == napi_ok);
 
-    return result;
+    return;
 }
 
 
 
 
-napi_value pcan_CAN_Reset(napi_env env, napi_callback_info info)
+// Create an N-API object from transmit statistics
+static napi_value pcanTransmitStatsValue(napi_env env, const pcanTransmitStats_t *stats)
 {
     napi_status status = napi_generic_failure;
+    napi_value result;
+    napi_value value;
 
-    // Retrieve callback info and argument list
-    size_t argc = CAN_RESET_ARGC;
-    napi_value argv[CAN_RESET_ARGC];
-
-    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
+    status = napi_create_object(env, &result);
     assert(status == napi_ok);
 
-    if (argc != CAN_RESET_ARGC)
+    const struct
     {
-        napi_throw_type_error(env, 0, "Incorrect number of arguments.");
-        return 0;
+        const char *name;
+        uint64_t value;
+    } counts[] = {
+        { "queued", stats->queued },
+        { "sent", stats->sent },
+        { "errors", stats->errors },
+        { "cancelled", stats->cancelled },
+        { "replaced", stats->replaced },
+        { "expired", stats->expired },
+        { "retries", stats->retries },
+        { "busOffs", stats->busOffs },
+        { "paced", stats->paced },
+        { "confirmed", stats->confirmed },
+        { "unconfirmed", stats->unconfirmed },
+        { "discarded", stats->discarded },
+        { "pending", stats->pending },
+        { "unsent", stats->unsent },
+    };
+    size_t i;
+
+    for (i = 0; i < sizeof(counts) / sizeof(counts[0]); i++)
+    {
+        status = napi_create_double(env, (double)counts[i].value, &value);
+        assert(status == napi_ok);
+        status = napi_set_named_property(env, result, counts[i].name, value);
+        assert(status == napi_ok);
     }
 
-    // Retrieve arguments
-    uint32_t pcanChannel;
-    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
+    status = napi_get_boolean(env, stats->busOff != 0, &value);
+    assert(status == napi_ok);
+    status = napi_set_named_property(env, result, "busOff", value);
     assert(status == napi_ok);
 
-    // Reset CAN bus
-    TPCANStatus pcanStatus = PCAN_ERROR_UNKNOWN;
-    pcanStatus = CAN_Reset(pcanChannel);
-
-    // Print result to console
-#ifdef PCAN_DEBUG
-    printf("pcan_CAN_Reset: 0x%02X (%s)\n",
-           pcanStatus, pcanStatusLookup(pcanStatus));
-#endif
+    status = napi_create_double(env, stats->load, &value);
+    assert(status == napi_ok);
+    status = napi_set_named_property(env, result, "load", value);
+    assert(status == napi_ok);
 
-    // Throw error, if any
-    if (pcanStatus != PCAN_ERROR_OK)
+    if (stats->lastError != PCAN_ERROR_OK)
     {
-        napi_throw_error(env, pcanStatusLookup(pcanStatus),
-                         "pcan_CAN_Reset: Error at CAN_Reset.");
-        return 0;
+        status = napi_create_string_utf8(env, pcanStatusLookup(stats->lastError),
+                                         NAPI_AUTO_LENGTH, &value);
+        assert(status == napi_ok);
+        status = napi_set_named_property(env, result, "lastError", value);
+        assert(status == napi_ok);
     }
 
-    // Create a N-API value for the result and return it
-    napi_value result;
-    status = napi_create_uint32(env, pcanStatus, &result);
-    assert(status == napi_ok);
-
     return result;
 }
 
 
 
 
-napi_value pcan_CAN_GetStatus(napi_env env, napi_callback_info info)
+// Return the slot in a channel's context holding its cyclic scheduler, or 0 if
+// it has none
+static pcanCyclic_t **pcanCyclicFind(TPCANHandle channel)
 {
-    napi_status status = napi_generic_failure;
-
-    // Retrieve callback info and argument list
-    size_t argc = CAN_GETSTATUS_ARGC;
-    napi_value argv[CAN_GETSTATUS_ARGC];
-
-    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
-    assert(status == napi_ok);
+    pcanChannelContext_t *channelContext = pcanChannelContextFind(channel, 0);
 
-    if (argc != CAN_GETSTATUS_ARGC)
-    {
-        napi_throw_type_error(env, 0, "Incorrect number of arguments.");
-        return 0;
-    }
+    return ((channelContext != 0) && (channelContext->cyclic != 0)) ?
+        &(channelContext->cyclic) : 0;
+}
 
-    // Retrieve arguments
-    uint32_t pcanChannel;
-    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
-    assert(status == napi_ok);
 
-    // Get CAN status
-    TPCANStatus pcan_can_status;
-    pcan_can_status = CAN_GetStatus(pcanChannel);
 
-    // Print result to console
-#ifdef PCAN_DEBUG
-    printf("pcan_CAN_GetStatus: 0x%02X (%s)\n",
-           pcan_can_status, pcanStatusLookup(pcan_can_status));
-#endif
 
-    // Create a N-API value for the status and return it
-    napi_value can_status;
-    status = napi_create_uint32(env, pcan_can_status, &can_status);
-    assert(status == napi_ok);
+// Return the receive filters and loopback set for a channel, or 0
+static pcanReceiveConfig_t *pcanReceiveConfigFind(TPCANHandle channel)
+{
+    pcanChannelContext_t *channelContext = pcanChannelContextFind(channel, 0);
 
-    return can_status;
+    return ((channelContext != 0) &&
+            ((channelContext->config.filterCount != 0) || channelContext->config.loopback)) ?
+        &(channelContext->config) : 0;
 }
 
 
 
 
-napi_value pcan_CAN_Read(napi_env env, napi_callback_info info)
+// Record whether a channel is initialized for CAN FD. PCAN_NONEBUS stands for
+// every channel.
+static void pcanFDChannelSet(TPCANHandle channel, int fd)
 {
-    napi_status status = napi_generic_failure;
+    pcanChannelContext_t *channelContext;
+    size_t i;
 
-    // Retrieve callback info and arguments list
-    size_t argc = CAN_READ_ARGC;
-    napi_value argv[CAN_READ_ARGC];
-
-    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
-    assert(status == napi_ok);
-
-    if (argc != CAN_READ_ARGC)
+    if (channel == PCAN_NONEBUS)
+    {
+        for (i = 0; i < PCAN_CHANNELS_MAX; i++)
+        {
+            pcanChannelContexts[i].fd = 0;
+        }
+        return;
+    }
+
+    channelContext = pcanChannelContextFind(channel, fd);
+    if (channelContext != 0)
+    {
+        channelContext->fd = fd;
+    }
+
+    return;
+}
+
+
+
+
+// Forget what was kept for a channel while it was initialized: whether it is
+// CAN FD, and its receive filters and loopback. PCAN_NONEBUS stands for every
+// channel.
+static void pcanChannelContextUninitialize(TPCANHandle channel)
+{
+    pcanChannelContext_t *channelContext;
+    size_t i;
+
+    for (i = 0; i < PCAN_CHANNELS_MAX; i++)
+    {
+        channelContext = &(pcanChannelContexts[i]);
+        if ((channel == PCAN_NONEBUS) || (channelContext->channel == channel))
+        {
+            channelContext->fd = 0;
+            memset(&(channelContext->config), 0, sizeof(channelContext->config));
+        }
+    }
+
+    return;
+}
+
+
+
+
+// Return nonzero if a channel was initialized for CAN FD
+static int pcanFDChannelIs(TPCANHandle channel)
+{
+    pcanChannelContext_t *channelContext = pcanChannelContextFind(channel, 0);
+
+    return (channelContext != 0) && channelContext->fd;
+}
+
+
+
+
+// Return the slot in a channel's context holding its timed transmission, or 0 if
+// it has none
+static pcanTimed_t **pcanTimedFind(TPCANHandle channel)
+{
+    pcanChannelContext_t *channelContext = pcanChannelContextFind(channel, 0);
+
+    return ((channelContext != 0) && (channelContext->timed != 0)) ?
+        &(channelContext->timed) : 0;
+}
+
+
+
+
+// Called on the timing thread when timed transmission results become
+// available
+static void pcanTimedNotify(void *context)
+{
+    napi_status status = napi_generic_failure;
+
+    status = napi_call_threadsafe_function((napi_threadsafe_function)context, 0,
+                                           napi_tsfn_nonblocking);
+    assert(status == napi_ok);
+
+    return;
+}
+
+
+
+
+// Return the slot in a channel's context holding its request/response matching, or 0 if
+// it has none
+static pcanRequest_t **pcanRequestFind(TPCANHandle channel)
+{
+    pcanChannelContext_t *channelContext = pcanChannelContextFind(channel, 0);
+
+    return ((channelContext != 0) && (channelContext->request != 0)) ?
+        &(channelContext->request) : 0;
+}
+
+
+
+
+// Called on the worker thread when replies to requests become available
+static void pcanRequestNotify(void *context)
+{
+    napi_status status = napi_generic_failure;
+
+    status = napi_call_threadsafe_function((napi_threadsafe_function)context, 0,
+                                           napi_tsfn_nonblocking);
+    assert(status == napi_ok);
+
+    return;
+}
+
+
+
+
+// Copy the single frame record in a Buffer into aligned storage, for the
+// named function
+// Returns 0 on success, or 1 with an error thrown
+static int pcanFrameArg(napi_env env, napi_value buffer, pcanFrame_t *frame,
+                        const char *function)
+{
+    napi_status status = napi_generic_failure;
+    uint8_t *record = 0;
+    size_t recordLength = 0;
+
+    status = napi_get_buffer_info(env, buffer, (void**)&record, &recordLength);
+    if ((status != napi_ok) || (recordLength < PCAN_FRAME_SIZE))
+    {
+        napi_throw_type_error(env, 0, "FrameBuffer is not a Buffer holding a frame.");
+        return 1;
+    }
+
+    memcpy(frame, record, PCAN_FRAME_SIZE);
+    if (frame->len > PCAN_FRAME_DATA_MAX)
+    {
+        napi_throw_error(env, pcanStatusLookup(PCAN_ERROR_ILLPARAMVAL), function);
+        return 1;
+    }
+
+    return 0;
+}
+
+
+
+
+// Create an N-API object from cyclic message statistics
+static napi_value pcanCyclicStatsValue(napi_env env, const pcanCyclicStats_t *stats)
+{
+    napi_status status = napi_generic_failure;
+    napi_value result;
+    napi_value value;
+
+    status = napi_create_object(env, &result);
+    assert(status == napi_ok);
+
+    const struct
+    {
+        const char *name;
+        uint64_t value;
+    } counts[] = {
+        { "sent", stats->sent },
+        { "errors", stats->errors },
+        { "late", stats->late },
+        { "missed", stats->missed },
+        { "meanLateUs", stats->meanLateUs },
+        { "maxLateUs", stats->maxLateUs },
+        { "lastLateUs", stats->lastLateUs },
+        { "remaining", stats->remaining },
+    };
+    size_t i;
+
+    for (i = 0; i < sizeof(counts) / sizeof(counts[0]); i++)
+    {
+        status = napi_create_double(env, (double)counts[i].value, &value);
+        assert(status == napi_ok);
+        status = napi_set_named_property(env, result, counts[i].name, value);
+        assert(status == napi_ok);
+    }
+
+    status = napi_get_boolean(env, stats->active != 0, &value);
+    assert(status == napi_ok);
+    status = napi_set_named_property(env, result, "active", value);
+    assert(status == napi_ok);
+
+    if (stats->lastError != PCAN_ERROR_OK)
+    {
+        status = napi_create_string_utf8(env, pcanStatusLookup(stats->lastError),
+                                         NAPI_AUTO_LENGTH, &value);
+        assert(status == napi_ok);
+        status = napi_set_named_property(env, result, "lastError", value);
+        assert(status == napi_ok);
+    }
+
+    return result;
+}
+
+
+
+
+// Create an N-API object from a bit timing found by pcanTimingSolve
+static napi_value pcanTimingValue(napi_env env, const pcanTiming_t *timing)
+{
+    napi_status status = napi_generic_failure;
+    napi_value result;
+    napi_value value;
+
+    status = napi_create_object(env, &result);
+    assert(status == napi_ok);
+
+    const struct
+    {
+        const char *name;
+        double value;
+    } fields[] = {
+        { "clockMhz", timing->clock / 1e6 },
+        { "brp", timing->brp },
+        { "tseg1", timing->tseg1 },
+        { "tseg2", timing->tseg2 },
+        { "sjw", timing->sjw },
+        { "bitrate", timing->bitrate },
+        { "samplePoint", timing->samplePoint / 1000.0 },
+        { "error", timing->errorPpm / 1e6 },
+    };
+    size_t i;
+
+    for (i = 0; i < sizeof(fields) / sizeof(fields[0]); i++)
+    {
+        status = napi_create_double(env, fields[i].value, &value);
+        assert(status == napi_ok);
+        status = napi_set_named_property(env, result, fields[i].name, value);
+        assert(status == napi_ok);
+    }
+
+    return result;
+}
+
+
+
+
+// Create an N-API object from replay statistics
+static napi_value pcanReplayStatsValue(napi_env env, const pcanReplayStats_t *stats)
+{
+    napi_status status = napi_generic_failure;
+    napi_value result;
+    napi_value value;
+
+    status = napi_create_object(env, &result);
+    assert(status == napi_ok);
+
+    const struct
+    {
+        const char *name;
+        uint64_t value;
+    } counts[] = {
+        { "frames", stats->frames },
+        { "errors", stats->errors },
+        { "late", stats->late },
+        { "loops", stats->loops },
+        { "meanLateUs", stats->meanLateUs },
+        { "maxLateUs", stats->maxLateUs },
+        { "p50LateUs", stats->p50LateUs },
+        { "p99LateUs", stats->p99LateUs },
+        { "p999LateUs", stats->p999LateUs },
+    };
+    size_t i;
+
+    for (i = 0; i < sizeof(counts) / sizeof(counts[0]); i++)
+    {
+        status = napi_create_double(env, (double)counts[i].value, &value);
+        assert(status == napi_ok);
+        status = napi_set_named_property(env, result, counts[i].name, value);
+        assert(status == napi_ok);
+    }
+
+    if (stats->lastError != PCAN_ERROR_OK)
+    {
+        status = napi_create_string_utf8(env, pcanStatusLookup(stats->lastError),
+                                         NAPI_AUTO_LENGTH, &value);
+        assert(status == napi_ok);
+        status = napi_set_named_property(env, result, "lastError", value);
+        assert(status == napi_ok);
+    }
+
+    status = napi_get_boolean(env, stats->finished != 0, &value);
+    assert(status == napi_ok);
+    status = napi_set_named_property(env, result, "finished", value);
+    assert(status == napi_ok);
+
+    status = napi_get_boolean(env, stats->error != 0, &value);
+    assert(status == napi_ok);
+    status = napi_set_named_property(env, result, "error", value);
+    assert(status == napi_ok);
+
+    return result;
+}
+
+
+
+
+// Return the slot in a channel's context holding its replay, or 0 if
+// it has none
+static pcanReplay_t **pcanReplayFind(TPCANHandle channel)
+{
+    pcanChannelContext_t *channelContext = pcanChannelContextFind(channel, 0);
+
+    return ((channelContext != 0) && (channelContext->replay != 0)) ?
+        &(channelContext->replay) : 0;
+}
+
+
+
+
+// Called on the replay thread when a replay runs to its end
+static void pcanReplayDone(void *context)
+{
+    napi_status status = napi_generic_failure;
+
+    status = napi_call_threadsafe_function((napi_threadsafe_function)context, 0,
+                                           napi_tsfn_nonblocking);
+    assert(status == napi_ok);
+
+    return;
+}
+
+
+
+
+// Create an N-API object from the outcome of a bit rate detection
+static napi_value pcanDetectResultValue(napi_env env, const pcanDetectResult_t *result)
+{
+    napi_status status = napi_generic_failure;
+    napi_value object;
+    napi_value candidates;
+    napi_value element;
+    napi_value value;
+    uint32_t i;
+    size_t j;
+
+    status = napi_create_object(env, &object);
+    assert(status == napi_ok);
+
+    status = napi_create_int32(env, result->index, &value);
+    assert(status == napi_ok);
+    status = napi_set_named_property(env, object, "index", value);
+    assert(status == napi_ok);
+
+    status = napi_get_boolean(env, result->confident != 0, &value);
+    assert(status == napi_ok);
+    status = napi_set_named_property(env, object, "confident", value);
+    assert(status == napi_ok);
+
+    status = napi_get_boolean(env, result->stopped != 0, &value);
+    assert(status == napi_ok);
+    status = napi_set_named_property(env, object, "stopped", value);
+    assert(status == napi_ok);
+
+    status = napi_create_double(env, result->elapsedUs / 1000.0, &value);
+    assert(status == napi_ok);
+    status = napi_set_named_property(env, object, "elapsedMs", value);
+    assert(status == napi_ok);
+
+    status = napi_create_array_with_length(env, result->count, &candidates);
+    assert(status == napi_ok);
+
+    for (i = 0; i < result->count; i++)
+    {
+        const pcanDetectScore_t *score = &(result->scores[i]);
+        const struct
+        {
+            const char *name;
+            double value;
+        } fields[] = {
+            { "frames", score->frames },
+            { "errors", score->errors },
+            { "elapsedMs", score->elapsedUs / 1000.0 },
+            { "passes", score->passes },
+        };
+
+        status = napi_create_object(env, &element);
+        assert(status == napi_ok);
+
+        for (j = 0; j < sizeof(fields) / sizeof(fields[0]); j++)
+        {
+            status = napi_create_double(env, fields[j].value, &value);
+            assert(status == napi_ok);
+            status = napi_set_named_property(env, element, fields[j].name, value);
+            assert(status == napi_ok);
+        }
+
+        if (score->lastError != PCAN_ERROR_OK)
+        {
+            status = napi_create_string_utf8(env, pcanStatusLookup(score->lastError),
+                                             NAPI_AUTO_LENGTH, &value);
+            assert(status == napi_ok);
+            status = napi_set_named_property(env, element, "lastError", value);
+            assert(status == napi_ok);
+        }
+
+        status = napi_set_element(env, candidates, i, element);
+        assert(status == napi_ok);
+    }
+
+    status = napi_set_named_property(env, object, "candidates", candidates);
+    assert(status == napi_ok);
+
+    return object;
+}
+
+
+
+
+// Return the slot in a channel's context holding its bit rate detection, or 0 if
+// it has none
+static pcanDetect_t **pcanDetectFind(TPCANHandle channel)
+{
+    pcanChannelContext_t *channelContext = pcanChannelContextFind(channel, 0);
+
+    return ((channelContext != 0) && (channelContext->detect != 0)) ?
+        &(channelContext->detect) : 0;
+}
+
+
+
+
+// Called on the detection thread when a bit rate detection finishes
+static void pcanDetectDone(void *context)
+{
+    napi_status status = napi_generic_failure;
+
+    status = napi_call_threadsafe_function((napi_threadsafe_function)context, 0,
+                                           napi_tsfn_nonblocking);
+    assert(status == napi_ok);
+
+    return;
+}
+
+
+
+
+// Finalizer for reader handles created by pcan_CAN_ReaderOpen
+static void pcanReaderFinalize(napi_env env, void* finalize_data, void* finalize_hint)
+{
+    pcanReaderHandle_t *handle = (pcanReaderHandle_t*)finalize_data;
+
+    if (handle->reader != 0)
+    {
+        pcanReaderRelease(handle->reader);
+    }
+    free(handle);
+}
+
+
+
+
+// Finalizer for query handles created by pcan_CAN_ReaderQuery
+static void pcanQueryFinalize(napi_env env, void* finalize_data, void* finalize_hint)
+{
+    pcanQueryHandle_t *handle = (pcanQueryHandle_t*)finalize_data;
+
+    if (handle->query != 0)
+    {
+        pcanReaderQueryFree(handle->query);
+    }
+    free(handle);
+}
+
+
+
+
+// Finalizer for trace reader handles created by pcan_CAN_TrcOpen
+static void pcanTrcFinalize(napi_env env, void* finalize_data, void* finalize_hint)
+{
+    pcanTrcHandle_t *handle = (pcanTrcHandle_t*)finalize_data;
+
+    if (handle->reader != 0)
+    {
+        pcanTrcClose(handle->reader);
+    }
+    free(handle);
+}
+
+
+
+
+// Return the data pointer of an external value, or 0 if it is not an external
+static void *pcanGetExternal(napi_env env, napi_value value)
+{
+    napi_valuetype vt;
+    void *data = 0;
+
+    if ((napi_typeof(env, value, &vt) != napi_ok) || (vt != napi_external))
+    {
+        return 0;
+    }
+
+    if (napi_get_value_external(env, value, &data) != napi_ok)
+    {
+        return 0;
+    }
+
+    return data;
+}
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Public functions
+
+
+napi_value pcan_CAN_Initialize(napi_env env, napi_callback_info info)
+{
+    napi_status status = napi_generic_failure;
+
+    // Retrieve callback info and argument list
+    size_t argc = CAN_INITIALIZE_ARGC;
+    napi_value argv[CAN_INITIALIZE_ARGC];
+
+    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
+    assert(status == napi_ok);
+
+    if (argc != CAN_INITIALIZE_ARGC)
+    {
+        napi_throw_type_error(env, 0, "Incorrect number of arguments."
+                              "This implementation of CAN_Initialize accepts Channel and "
+                              "Btr0Btr1.");
+        return 0;
+    }
+
+    // Retrieve arguments
+    uint32_t pcanChannel;
+    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
+    assert(status == napi_ok);
+
+    uint32_t pcanBtr0Btr1;
+    status = napi_get_value_uint32(env, argv[1], &pcanBtr0Btr1);
+    assert(status == napi_ok);
+
+    // Initialize CAN bus
+    TPCANStatus pcanStatus = PCAN_ERROR_UNKNOWN;
+    pcanStatus = CAN_Initialize(pcanChannel, pcanBtr0Btr1, 0, 0, 0);
+   
+    // Print results to console
+#ifdef PCAN_DEBUG
+    printf("pcan_CAN_Initialize:\n"
+           "  pcanStatus = 0x%02X (%s)\n"
+           "  pcanChannel = 0x%02X\n"
+           "  pcanBtr0Btr1 = 0x%02X\n",
+           pcanStatus, pcanStatusLookup(pcanStatus),
+           pcanChannel,
+           pcanBtr0Btr1);
+#endif
+
+    // Throw error, if any
+    if (pcanStatus != PCAN_ERROR_OK)
+    {
+        napi_throw_error(env, pcanStatusLookup(pcanStatus),
+                         "pcan_CAN_Initialize: Error at CAN_Initialize.");
+        return 0;
+    }
+
+    pcanFDChannelSet(pcanChannel, 0);
+    
+    // Create an N-API value for the result and return it
+    napi_value result;
+    status = napi_create_uint32(env, pcanStatus, &result);
+    assert(status == napi_ok);
+
+    return result;
+}
+
+
+
+
+napi_value pcan_CAN_InitializeFD(napi_env env, napi_callback_info info)
+{
+    napi_status status = napi_generic_failure;
+
+    // Retrieve callback info and argument list
+    size_t argc = CAN_INITIALIZEFD_ARGC;
+    napi_value argv[CAN_INITIALIZEFD_ARGC];
+
+    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
+    assert(status == napi_ok);
+
+    if (argc != CAN_INITIALIZEFD_ARGC)
+    {
+        napi_throw_type_error(env, 0, "Incorrect number of arguments.");
+        return 0;
+    }
+
+    // Retrieve arguments
+    uint32_t pcanChannel;
+    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
+    assert(status == napi_ok);
+
+    char pcanBitrateFD[256] = { 0 };
+    size_t pcanBitrateFDResult = 0;
+    status = napi_get_value_string_utf8(env, argv[1], pcanBitrateFD,
+                                        sizeof(pcanBitrateFD), &pcanBitrateFDResult);
+    assert(status == napi_ok);
+
+    // Initialize CAN bus, with flexible data rate capabilities
+    TPCANStatus pcanStatus = PCAN_ERROR_UNKNOWN;
+    pcanStatus = CAN_InitializeFD(pcanChannel, pcanBitrateFD);
+    
+    // Print results to console
+#ifdef PCAN_DEBUG
+    printf("pcan_CAN_InitializeFD:\n"
+           "  pcanStatus = 0x%02X (%s)\n"
+           "  pcanChannel = 0x%02X\n"
+           "  pcanBitrateFD = \"%s\"\n",
+           pcanStatus, pcanStatusLookup(pcanStatus),
+           pcanChannel,
+           pcanBitrateFD);
+#endif
+
+    // Throw error, if any
+    if (pcanStatus != PCAN_ERROR_OK)
+    {
+        napi_throw_error(env, pcanStatusLookup(pcanStatus),
+                         "pcan_CAN_InitializeFD: Error at CAN_InitializeFD.");
+        return 0;
+    }
+
+    pcanFDChannelSet(pcanChannel, 1);
+
+    // Create N-API value for the result and return it
+    napi_value result;
+    status = napi_create_uint32(env, pcanStatus, &result);
+    assert(status == napi_ok);
+
+    return result;
+}
+
+
+
+
+napi_value pcan_CAN_Uninitialize(napi_env env, napi_callback_info info)
+{
+    napi_status status = napi_generic_failure;
+
+    // Retrieve callback info and argument list
+    size_t argc = CAN_UNINITIALIZE_ARGC;
+    napi_value argv[CAN_UNINITIALIZE_ARGC];
+
+    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
+    assert(status == napi_ok);
+
+    if (argc != CAN_UNINITIALIZE_ARGC)
+    {
+        napi_throw_type_error(env, 0, "Incorrect number of arguments.");
+        return 0;
+    }
+
+    // Retrieve arguments
+    uint32_t pcanChannel;
+    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
+    assert(status == napi_ok);
+
+    // Uninitialize CAN bus
+    TPCANStatus pcanStatus = PCAN_ERROR_UNKNOWN;
+    pcanStatus = CAN_Uninitialize(pcanChannel);
+
+    // Print result to console
+#ifdef PCAN_DEBUG
+    printf("pcan_CAN_Uninitialize: 0x%02X (%s)\n",
+           pcanStatus, pcanStatusLookup(pcanStatus));
+#endif
+
+    // Throw error, if any
+    if (pcanStatus != PCAN_ERROR_OK)
+    {
+        napi_throw_error(env, pcanStatusLookup(pcanStatus),
+                         "pcan_CAN_Uninitialize: Error at CAN_Uninitialize.");
+        return 0;
+    }
+
+    pcanChannelContextUninitialize(pcanChannel);
+
+    // Create a N-API value for the result and return it
+    napi_value result;
+    status = napi_create_uint32(env, pcanStatus, &result);
+    assert(status == napi_ok);
+
+    return result;
+}
+
+
+
+
+napi_value pcan_CAN_Reset(napi_env env, napi_callback_info info)
+{
+    napi_status status = napi_generic_failure;
+
+    // Retrieve callback info and argument list
+    size_t argc = CAN_RESET_ARGC;
+    napi_value argv[CAN_RESET_ARGC];
+
+    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
+    assert(status == napi_ok);
+
+    if (argc != CAN_RESET_ARGC)
+    {
+        napi_throw_type_error(env, 0, "Incorrect number of arguments.");
+        return 0;
+    }
+
+    // Retrieve arguments
+    uint32_t pcanChannel;
+    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
+    assert(status == napi_ok);
+
+    // Reset CAN bus
+    TPCANStatus pcanStatus = PCAN_ERROR_UNKNOWN;
+    pcanStatus = CAN_Reset(pcanChannel);
+
+    // Print result to console
+#ifdef PCAN_DEBUG
+    printf("pcan_CAN_Reset: 0x%02X (%s)\n",
+           pcanStatus, pcanStatusLookup(pcanStatus));
+#endif
+
+    // Throw error, if any
+    if (pcanStatus != PCAN_ERROR_OK)
+    {
+        napi_throw_error(env, pcanStatusLookup(pcanStatus),
+                         "pcan_CAN_Reset: Error at CAN_Reset.");
+        return 0;
+    }
+
+    // Create a N-API value for the result and return it
+    napi_value result;
+    status = napi_create_uint32(env, pcanStatus, &result);
+    assert(status == napi_ok);
+
+    return result;
+}
+
+
+
+
+napi_value pcan_CAN_GetStatus(napi_env env, napi_callback_info info)
+{
+    napi_status status = napi_generic_failure;
+
+    // Retrieve callback info and argument list
+    size_t argc = CAN_GETSTATUS_ARGC;
+    napi_value argv[CAN_GETSTATUS_ARGC];
+
+    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
+    assert(status == napi_ok);
+
+    if (argc != CAN_GETSTATUS_ARGC)
+    {
+        napi_throw_type_error(env, 0, "Incorrect number of arguments.");
+        return 0;
+    }
+
+    // Retrieve arguments
+    uint32_t pcanChannel;
+    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
+    assert(status == napi_ok);
+
+    // Get CAN status
+    TPCANStatus pcan_can_status;
+    pcan_can_status = CAN_GetStatus(pcanChannel);
+
+    // Print result to console
+#ifdef PCAN_DEBUG
+    printf("pcan_CAN_GetStatus: 0x%02X (%s)\n",
+           pcan_can_status, pcanStatusLookup(pcan_can_status));
+#endif
+
+    // Create a N-API value for the status and return it
+    napi_value can_status;
+    status = napi_create_uint32(env, pcan_can_status, &can_status);
+    assert(status == napi_ok);
+
+    return can_status;
+}
+
+
+
+
+napi_value pcan_CAN_Read(napi_env env, napi_callback_info info)
+{
+    napi_status status = napi_generic_failure;
+
+    // Retrieve callback info and arguments list
+    size_t argc = CAN_READ_ARGC;
+    napi_value argv[CAN_READ_ARGC];
+
+    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
+    assert(status == napi_ok);
+
+    if (argc != CAN_READ_ARGC)
+    {
+        napi_throw_type_error(env, 0, "Incorrect number of arguments.");
+        return 0;
+    }
+
+    // Retrieve arguments
+    // argv[0] Channel
+    uint32_t pcanChannel;
+    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
+    assert(status == napi_ok);
+
+    // Read from CAN bus
+    TPCANMsg msg = { 0 };
+    TPCANTimestamp timestamp = { 0 };
+    TPCANStatus pcanStatus = PCAN_ERROR_UNKNOWN;
+    pcanStatus = CAN_Read(pcanChannel, &msg, &timestamp);
+    
+    // Print the result to console
+#ifdef PCAN_DEBUG
+    printf("pcan_CAN_Read: 0x%02X (%s)\n", pcanStatus, pcanStatusLookup(pcanStatus));
+    pcanDumpMsg(&msg);
+    pcanDumpTimestamp(&timestamp);
+#endif
+
+    // Throw error, if any
+    if (pcanStatus != PCAN_ERROR_OK)
+    {
+        napi_throw_error(env, pcanStatusLookup(pcanStatus),
+                         "pcan_CAN_Read");
+        return 0;
+    }
+
+    // Create parent objects for read data
+    napi_value pcanMessageBuffer;
+    status = napi_create_object(env, &pcanMessageBuffer);
+    assert(status == napi_ok);
+
+    napi_value pcanTimestampBuffer;
+    status = napi_create_object(env, &pcanTimestampBuffer);
+    assert(status == napi_ok);
+
+    // Copy read values into objects passed from N-API
+    // MessageBuffer
+    napi_value pcanMessageBufferID; // uint32
+    napi_value pcanMessageBufferMsgtype; // uint32
+    napi_value pcanMessageBufferLen; // uint32
+    napi_value pcanMessageBufferData; // buffer
+    void* pcanMessageBufferDataResult;
+    
+    status = napi_create_uint32(env, msg.ID, &pcanMessageBufferID);
+    assert(status == napi_ok);
+    status = napi_set_named_property(env, pcanMessageBuffer, "id", pcanMessageBufferID);
+    assert(status == napi_ok);
+    
+    status = napi_create_uint32(env, msg.MSGTYPE, &pcanMessageBufferMsgtype);
+    assert(status == napi_ok);
+    status = napi_set_named_property(env, pcanMessageBuffer, "msgtype", pcanMessageBufferMsgtype);
+    assert(status == napi_ok);
+    
+    status = napi_create_uint32(env, msg.LEN, &pcanMessageBufferLen);
+    assert(status == napi_ok);
+    status = napi_set_named_property(env, pcanMessageBuffer, "len", pcanMessageBufferLen);
+    assert(status == napi_ok);
+
+    status = napi_create_buffer_copy(env, msg.LEN, (void*)&(msg.DATA),
+                                     (void*)&pcanMessageBufferDataResult,
+                                     &pcanMessageBufferData);
+    assert(status == napi_ok);
+    status = napi_set_named_property(env, pcanMessageBuffer, "data", pcanMessageBufferData);
+    assert(status == napi_ok);
+
+    // TimestampBuffer
+    napi_value pcanTimestampBufferMillis; // uint32
+    napi_value pcanTimestampBufferMillisOverflow; // uint32
+    napi_value pcanTimestampBufferMicros; // uint32
+
+    status = napi_create_uint32(env, timestamp.millis, &pcanTimestampBufferMillis);
+    assert(status == napi_ok);
+    status = napi_set_named_property(env, pcanTimestampBuffer, "millis",
+                                     pcanTimestampBufferMillis);
+
+    status = napi_create_uint32(env, timestamp.millis_overflow,
+                                &pcanTimestampBufferMillisOverflow);
+    assert(status == napi_ok);
+    status = napi_set_named_property(env, pcanTimestampBuffer, "millis_overflow",
+                                     pcanTimestampBufferMillisOverflow);
+
+    status = napi_create_uint32(env, timestamp.micros, &pcanTimestampBufferMicros);
+    assert(status == napi_ok);
+    status = napi_set_named_property(env, pcanTimestampBuffer, "micros",
+                                     pcanTimestampBufferMicros);
+
+    // Create a N-API value for the complete read data and return it
+    napi_value pcanReadData;
+    status = napi_create_object(env, &pcanReadData);
+    assert(status == napi_ok);
+
+    status = napi_set_named_property(env, pcanReadData, "message", pcanMessageBuffer);
+    assert(status == napi_ok);
+    status = napi_set_named_property(env, pcanReadData, "timestamp", pcanTimestampBuffer);
+    assert(status == napi_ok);
+    
+    return pcanReadData;
+}
+
+
+
+
+napi_value pcan_CAN_ReadFD(napi_env env, napi_callback_info info)
+{
+    napi_status status = napi_generic_failure;
+
+    // Retrieve callback info and argument list
+    size_t argc = CAN_READFD_ARGC;
+    napi_value argv[CAN_READFD_ARGC];
+
+    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
+    assert(status == napi_ok);
+
+    if (argc != CAN_READFD_ARGC)
+    {
+        napi_throw_type_error(env, 0, "Incorrect number of arguments.");
+        return 0;
+    }
+
+    // Retrieve arguments
+    // argv[0] Channel
+    uint32_t pcanChannel;
+    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
+    assert(status == napi_ok);
+
+    // Read from CAN bus
+    TPCANMsgFD msg = { 0 };
+    TPCANTimestampFD timestamp = 0;
+    TPCANStatus pcanStatus = PCAN_ERROR_UNKNOWN;
+
+    pcanStatus = CAN_ReadFD(pcanChannel, &msg, &timestamp);
+
+    // Dump results to console
+#ifdef PCAN_DEBUG
+    printf("pcan_CAN_ReadFD: 0x%02X (%s)\n", pcanStatus,
+           pcanStatusLookup(pcanStatus));
+    pcanDumpMsgFD(&msg);
+    pcanDumpTimestampFD(timestamp);
+#endif
+
+    // Throw error, if any
+    if (pcanStatus != PCAN_ERROR_OK)
+    {
+        napi_throw_error(env, pcanStatusLookup(pcanStatus),
+                         "pcan_CAN_ReadFD");
+        return 0;
+    }
+
+    // Create parent objects for read data
+    napi_value pcanMessageBuffer;
+    status = napi_create_object(env, &pcanMessageBuffer);
+    assert(status == napi_ok);
+
+    napi_value pcanTimestampBuffer;
+    status = napi_create_object(env, &pcanTimestampBuffer);
+    assert(status == napi_ok);
+
+    // Copy read values into objects passed from N-API
+    // argv[1] MessageBuffer
+    napi_value pcanMessageBufferID; // uint32
+    napi_value pcanMessageBufferMsgtype; // uint32
+    napi_value pcanMessageBufferDLC; // uint32
+    napi_value pcanMessageBufferData; // buffer
+    void* pcanMessageBufferDataResult;
+    
+    status = napi_create_uint32(env, msg.ID, &pcanMessageBufferID);
+    assert(status == napi_ok);
+    status = napi_set_named_property(env, pcanMessageBuffer, "id", pcanMessageBufferID);
+    assert(status == napi_ok);
+    
+    status = napi_create_uint32(env, msg.MSGTYPE, &pcanMessageBufferMsgtype);
+    assert(status == napi_ok);
+    status = napi_set_named_property(env, pcanMessageBuffer, "msgtype", pcanMessageBufferMsgtype);
+    assert(status == napi_ok);
+    
+    status = napi_create_uint32(env, msg.DLC, &pcanMessageBufferDLC);
+    assert(status == napi_ok);
+    status = napi_set_named_property(env, pcanMessageBuffer, "dlc", pcanMessageBufferDLC);
+    assert(status == napi_ok);
+
+    status = napi_create_buffer_copy(env, pcanDLCDecode(msg.DLC), (void*)&(msg.DATA), (void*)&pcanMessageBufferDataResult, &pcanMessageBufferData);
+    assert(status == napi_ok);
+    status = napi_set_named_property(env, pcanMessageBuffer, "data", pcanMessageBufferData);
+    assert(status == napi_ok);
+
+    // argv[2] TimestampFD
+    napi_value pcanTimestampFDValue; // uint64
+
+    status = napi_create_uint32(env, timestamp, &pcanTimestampFDValue);
+    assert(status == napi_ok);
+    status = napi_set_named_property(env, pcanTimestampBuffer, "timestamp", pcanTimestampFDValue);
+    assert(status == napi_ok);
+
+    // Create an N-API value for the complete read data and return it
+    napi_value pcanReadDataFD;
+    status = napi_create_object(env, &pcanReadDataFD);
+    assert(status == napi_ok);
+
+    status = napi_set_named_property(env, pcanReadDataFD, "message", pcanMessageBuffer);
+    assert(status == napi_ok);
+    status = napi_set_named_property(env, pcanReadDataFD, "timestamp", pcanTimestampBuffer);
+    assert(status == napi_ok);
+    
+    return pcanReadDataFD;
+}
+
+
+
+
+napi_value pcan_CAN_Write(napi_env env, napi_callback_info info)
+{
+    napi_status status = napi_generic_failure;
+
+    // Retrieve callback info and argument list
+    size_t argc = CAN_WRITE_ARGC;
+    napi_value argv[CAN_WRITE_ARGC];
+
+    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
+    assert(status == napi_ok);
+
+    if (argc != CAN_WRITE_ARGC)
+    {
+        napi_throw_type_error(env, 0, "Incorrect number of arguments.");
+        return 0;
+    }
+
+    // Retrieve arguments
+    // argv[0] Channel
+    uint32_t pcanChannel;
+    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
+    assert(status == napi_ok);
+
+    // argv[1] MessageBuffer
+    napi_valuetype pcanMessageBufferType;
+    status = napi_typeof(env, argv[1], &pcanMessageBufferType);
+    assert(status == napi_ok);
+
+    if (pcanMessageBufferType != napi_object)
+    {
+        napi_throw_type_error(env, 0, "Argument 1 (MessageBuffer) is not an object.");
+        return 0;
+    }
+
+    // Copy message contents from N-API object to TPCANMsg struct
+    TPCANMsg msg = { 0 };
+
+    napi_value pcanMessageBufferID;
+    status = napi_get_named_property(env, argv[1], "id", &pcanMessageBufferID);
+    assert(status == napi_ok);
+    status = napi_get_value_uint32(env, pcanMessageBufferID, &(msg.ID));
+    assert(status == napi_ok);
+
+    napi_value pcanMessageBufferMsgtype;
+    status = napi_get_named_property(env, argv[1], "msgtype", &pcanMessageBufferMsgtype);
+    assert(status == napi_ok);
+    status = napi_get_value_uint32(env, pcanMessageBufferMsgtype, (uint32_t*)&(msg.MSGTYPE));
+    assert(status == napi_ok);
+
+    napi_value pcanMessageBufferLen;
+    status = napi_get_named_property(env, argv[1], "len", &pcanMessageBufferLen);
+    assert(status == napi_ok);
+    status = napi_get_value_uint32(env, pcanMessageBufferLen, (uint32_t*)&(msg.LEN));
+    assert(status == napi_ok);
+
+    napi_value pcanMessageBufferData;
+    BYTE *msgTmpData;
+    size_t msgTmpLen = 0;
+    status = napi_get_named_property(env, argv[1], "data", &pcanMessageBufferData);
+    assert(status == napi_ok);
+    status = napi_get_buffer_info(env, pcanMessageBufferData, (void**)&msgTmpData, &msgTmpLen);
+    assert(status == napi_ok);
+
+    if (msgTmpLen != msg.LEN)
+    {
+        napi_throw_error(env, 0, "Mismatch between LEN and actual data buffer length");
+        return 0;
+    }
+
+    memcpy(msg.DATA, msgTmpData, msg.LEN);
+
+    // Write to CAN bus
+    TPCANStatus pcanStatus = PCAN_ERROR_UNKNOWN;
+    pcanStatus = CAN_Write(pcanChannel, &msg);
+
+    // Print result to console
+#ifdef PCAN_DEBUG
+    printf("pcan_CAN_Write: 0x%02X (%s)\n", pcanStatus, pcanStatusLookup(pcanStatus));
+    pcanDumpMsg(&msg);
+#endif
+
+    // Throw error, if any
+    if (pcanStatus != PCAN_ERROR_OK)
+    {
+        napi_throw_error(env, pcanStatusLookup(pcanStatus),
+                         "pcan_CAN_Write");
+        return 0;
+    }
+
+    // Create a N-API value for the result and return it
+    napi_value result;
+    status = napi_create_uint32(env, pcanStatus, &result);
+    assert(status == napi_ok);
+    
+    return result;
+}
+
+
+
+
+napi_value pcan_CAN_WriteFD(napi_env env, napi_callback_info info)
+{
+    napi_status status = napi_generic_failure;
+
+    // Get callback info and argument list
+    size_t argc = CAN_WRITEFD_ARGC;
+    napi_value argv[CAN_WRITEFD_ARGC];
+
+    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
+    assert(status == napi_ok);
+
+    if (argc != CAN_WRITEFD_ARGC)
+    {
+        napi_throw_type_error(env, 0, "Incorrect number of arguments.");
+        return 0;
+    }
+
+    // Retrieve arguments
+    // argv[0] Channel
+    uint32_t pcanChannel;
+    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
+    assert(status == napi_ok);
+
+    // argv[1] MessageBufferFD
+    napi_valuetype pcanMessageBufferType;
+    status = napi_typeof(env, argv[1], &pcanMessageBufferType);
+    assert(status == napi_ok);
+
+    if (pcanMessageBufferType != napi_object)
+    {
+        napi_throw_type_error(env, 0, "Argument 1 (MessageBufferFD) is not an object.");
+        return 0;
+    }
+
+    // Copy message contents from N-API object to TPCANMsgFD struct
+    TPCANMsgFD msg = { 0 };
+
+    napi_value pcanMessageBufferID;
+    status = napi_get_named_property(env, argv[1], "id", &pcanMessageBufferID);
+    assert(status == napi_ok);
+    status = napi_get_value_uint32(env, pcanMessageBufferID, &(msg.ID));
+    assert(status == napi_ok);
+
+    napi_value pcanMessageBufferMsgtype;
+    status = napi_get_named_property(env, argv[1], "msgtype", &pcanMessageBufferMsgtype);
+    assert(status == napi_ok);
+    status = napi_get_value_uint32(env, pcanMessageBufferMsgtype, (uint32_t*)&(msg.MSGTYPE));
+    assert(status == napi_ok);
+
+    napi_value pcanMessageBufferDLC;
+    status = napi_get_named_property(env, argv[1], "dlc", &pcanMessageBufferDLC);
+    assert(status == napi_ok);
+    status = napi_get_value_uint32(env, pcanMessageBufferDLC, (uint32_t*)&(msg.DLC));
+    assert(status == napi_ok);
+
+    napi_value pcanMessageBufferData;
+    BYTE *msgTmpData;
+    size_t msgTmpLen = 0;
+    status = napi_get_named_property(env, argv[1], "data", &pcanMessageBufferData);
+    assert(status == napi_ok);
+    status = napi_get_buffer_info(env, pcanMessageBufferData, (void**)&msgTmpData, &msgTmpLen);
+    assert(status == napi_ok);
+
+    if (msgTmpLen != pcanDLCDecode(msg.DLC))
+    {
+        napi_throw_error(env, 0, "Mismatch between DLC and actual data buffer length");
+        return 0;
+    }
+
+    memcpy(msg.DATA, msgTmpData, pcanDLCDecode(msg.DLC));
+
+    // Write to CAN bus
+    TPCANStatus pcanStatus = PCAN_ERROR_UNKNOWN;
+    pcanStatus = CAN_WriteFD(pcanChannel, &msg);
+    
+    // Print result to console
+#ifdef PCAN_DEBUG
+    printf("pcan_CAN_WriteFD: 0x%02X (%s)\n", pcanStatus, pcanStatusLookup(pcanStatus));
+    pcanDumpMsgFD(&msg);
+#endif
+
+    // Throw error, if any
+    if (pcanStatus != PCAN_ERROR_OK)
+    {
+        napi_throw_error(env, pcanStatusLookup(pcanStatus),
+                         "pcan_CAN_WriteFD");
+        return 0;
+    }
+
+    // Create a N-API value for the result and return it
+    napi_value result;
+    status = napi_create_uint32(env, pcanStatus, &result);
+    assert(status == napi_ok);
+
+    return result;
+}
+
+
+
+
+napi_value pcan_CAN_GetValue(napi_env env, napi_callback_info info)
+{
+    napi_status status = napi_generic_failure;
+
+    // Retrieve callback info and argument list
+    size_t argc = CAN_GETVALUE_ARGC;
+    napi_value argv[CAN_GETVALUE_ARGC];
+
+    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
+    assert(status == napi_ok);
+
+    if (argc != CAN_GETVALUE_ARGC)
+    {
+        napi_throw_type_error(env, 0, "Incorrect number of arguments. \n"
+                              "The N-API implementation of CAN_GetValue accepts Channel, "
+                              "Parameter, and Buffer.");
+        return 0;
+    }
+
+    // Retrieve arguments
+    // argv[0] Channel
+    uint32_t pcanChannel;
+    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
+    assert(status == napi_ok);
+
+    // argv[1] Parameter
+    uint32_t pcanParameter;
+    status = napi_get_value_uint32(env, argv[1], &pcanParameter);
+    assert(status == napi_ok);
+
+    // argv[2] Buffer
+    napi_valuetype pcanBufferType;
+    status = napi_typeof(env, argv[2], &pcanBufferType);
+    assert(status == napi_ok);
+
+    if (pcanBufferType != napi_object)
+    {
+        napi_throw_type_error(env, 0, "Argument 2 (Buffer) is not an object.");
+        return 0;
+    }
+
+    // Argument 3 - BufferLength (obtained from pcanBuffer)
+    BYTE *pcanBuffer = 0;
+    size_t pcanBufferLength = 0;
+    status = napi_get_buffer_info(env, argv[2], (void**)&pcanBuffer, &pcanBufferLength);
+    assert(status == napi_ok);
+
+    // Get requested parameter from CAN channel
+    TPCANStatus pcanStatus = PCAN_ERROR_UNKNOWN;
+    pcanStatus = CAN_GetValue(pcanChannel, pcanParameter, pcanBuffer, pcanBufferLength);
+
+    // Print result to console
+#ifdef PCAN_DEBUG
+    printf("pcan_CAN_GetValue: \n"
+           "  pcanStatus       = 0x%02X (%s)\n"
+           "  pcanChannel      = 0x%02X\n"
+           "  pcanParameter    = 0x%02X (%s)\n"
+           "  pcanBufferLength = 0x%02zX\n"
+           "  pcanBuffer       = ",
+           pcanStatus, pcanStatusLookup(pcanStatus),
+           pcanChannel,
+           pcanParameter, pcanParameterLookup(pcanParameter),
+           pcanBufferLength);
+    pcanDumpBuffer(pcanBuffer, pcanBufferLength);
+    printf("\n");
+#endif
+
+    // Throw error, if any
+    if (pcanStatus != PCAN_ERROR_OK)
+    {
+        napi_throw_error(env, pcanStatusLookup(pcanStatus),
+                         "pcan_CAN_GetValue");
+        return 0;
+    }
+
+    // Put value into the buffer object passed from N-API
+    napi_value pcanBufferValue;
+    status = napi_create_buffer(env, pcanBufferLength, (void**)&pcanBuffer, &pcanBufferValue);
+    assert(status == napi_ok);
+
+    // Create a N-API value for the result and return it
+    napi_value result;
+    status = napi_create_uint32(env, pcanStatus, &result);
+    assert(status == napi_ok);
+
+    return result;
+}
+
+
+
+
+napi_value pcan_CAN_SetValue(napi_env env, napi_callback_info info)
+{
+    napi_status status = napi_generic_failure;
+
+    // Retrieve callback info and argument list
+    size_t argc = CAN_SETVALUE_ARGC;
+    napi_value argv[CAN_SETVALUE_ARGC];
+
+    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
+    assert(status == napi_ok);
+
+    if (argc != CAN_SETVALUE_ARGC)
+    {
+        napi_throw_type_error(env, 0, "Incorrect number of arguments. \n"
+                              "The N-API implementation of CAN_SetValue accepts Channel, "
+                              "Parameter, and Buffer.");
+        return 0;
+    }
+
+    // Retrieve arguments
+    // argv[0] Channel
+    uint32_t pcanChannel;
+    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
+    assert(status == napi_ok);
+
+    // argv[1] Parameter
+    uint32_t pcanParameter;
+    status = napi_get_value_uint32(env, argv[1], &pcanParameter);
+    assert(status == napi_ok);
+
+    // argv[2] Buffer
+    napi_valuetype pcanBufferType;
+    status = napi_typeof(env, argv[2], &pcanBufferType);
+    assert(status == napi_ok);
+
+    if (pcanBufferType != napi_object)
+    {
+        napi_throw_type_error(env, 0, "Argument 2 (Buffer) is not an object.");
+        return 0;
+    }
+
+    // Argument 3 - BufferLength (obtained from pcanBuffer)
+    BYTE *pcanBuffer = 0;
+    size_t pcanBufferLength = 0;
+    
+    status = napi_get_buffer_info(env, argv[2], (void**)&pcanBuffer, &pcanBufferLength);
+    assert(status == napi_ok);
+
+    // Set value for CAN channel
+    TPCANStatus pcanStatus = PCAN_ERROR_UNKNOWN;
+    pcanStatus = CAN_SetValue(pcanChannel, pcanParameter, pcanBuffer, pcanBufferLength);
+
+    // Print result to console
+#ifdef PCAN_DEBUG
+    printf("pcan_CAN_SetValue: \n"
+           "  pcanStatus       = 0x%02X (%s)\n"
+           "  pcanChannel      = 0x%02X\n"
+           "  pcanParameter    = 0x%02X (%s)\n"
+           "  pcanBufferLength = 0x%02zX\n"
+           "  pcanBuffer       = ",
+           pcanStatus, pcanStatusLookup(pcanStatus),
+           pcanChannel,
+           pcanParameter, pcanParameterLookup(pcanParameter),
+           pcanBufferLength);
+    pcanDumpBuffer(pcanBuffer, pcanBufferLength);
+    printf("\n");
+#endif
+
+    // Throw error, if any
+    if (pcanStatus != PCAN_ERROR_OK)
+    {
+        napi_throw_error(env, pcanStatusLookup(pcanStatus),
+                         "pcan_CAN_SetValue");
+        return 0;
+    }
+
+    // Create an N-API value for the result and return it
+    napi_value result;
+    status = napi_create_uint32(env, pcanStatus, &result);
+    assert(status == napi_ok);
+
+    return result;
+}
+
+
+
+
+#if defined _WIN32
+napi_value pcan_CAN_FilterMessages(napi_env env, napi_callback_info info)
+{
+    napi_status status = napi_generic_failure;
+
+    // Retrieve callback info and argument list
+    size_t argc = CAN_FILTERMESSAGES_ARGC;
+    napi_value argv[CAN_FILTERMESSAGES_ARGC];
+    
+    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
+    assert(status == napi_ok);
+
+    if (argc != CAN_FILTERMESSAGES_ARGC)
+    {
+        napi_throw_type_error(env, 0, "Incorrect number of arguments.");
+        return 0;
+    }
+
+    // Retrieve arguments
+    // argv[0] Channel
+    uint32_t pcanChannel;
+    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
+    assert(status == napi_ok);
+
+    // argv[1] FromID
+    uint32_t pcanFromID;
+    status = napi_get_value_uint32(env, argv[1], &pcanFromID);
+    assert(status == napi_ok);
+
+    // argv[2] ToID
+    uint32_t pcanToID;
+    status = napi_get_value_uint32(env, argv[2], &pcanToID);
+    assert(status == napi_ok);
+
+    // argv[3] Mode
+    uint32_t pcanMode;
+    status = napi_get_value_uint32(env, argv[3], &pcanMode);
+    assert(status == napi_ok);
+
+    // Set or amend the CAN message filter ranges
+    TPCANStatus pcanStatus = PCAN_ERROR_UNKNOWN;
+    pcanStatus = CAN_FilterMessages(pcanChannel, pcanFromID, pcanToID, pcanMode);
+
+    // Print result to console
+#ifdef PCAN_DEBUG
+    printf("pcan_CAN_FilterMessages: \n"
+           "  pcanStatus  = 0x%02X (%s)\n"
+           "  pcanChannel = 0x%02X\n"
+           "  pcanFromID  = 0x%08X\n"
+           "  pcanToID    = 0x%08X\n"
+           "  pcanMode    = 0x%02X\n",
+           pcanStatus, pcanStatusLookup(pcanStatus),
+           pcanChannel,
+           pcanFromID,
+           pcanToID,
+           pcanMode);
+#endif
+
+    // Throw error, if any
+    if (pcanStatus != PCAN_ERROR_OK)
+    {
+        napi_throw_error(env, pcanStatusLookup(pcanStatus),
+                         "pcan_CAN_FilterMessages");
+        return 0;
+    }
+
+    // Create an N-API value for the result and return it
+    napi_value result;
+    status = napi_create_uint32(env, pcanStatus, &result);
+    assert(status == napi_ok);
+
+    return result;
+}
+
+
+#elif defined __APPLE__
+napi_value pcan_CAN_FilterMessages(napi_env env, napi_callback_info info)
+{
+    napi_status status = napi_generic_failure;
+ 
+    // Create an N-API value for the result and return it
+    napi_value result;
+    status = napi_create_uint32(env, 0, &result);
+    assert(status == napi_ok);
+
+    return result;
+}
+
+
+#endif
+
+
+
+
+napi_value pcan_CAN_GetErrorText(napi_env env, napi_callback_info info)
+{
+    napi_status status = napi_generic_failure;
+    
+    // Retrieve callback info and argument list
+    size_t argc = CAN_GETERRORTEXT_ARGC;
+    napi_value argv[CAN_GETERRORTEXT_ARGC];
+
+    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
+    assert(status == napi_ok);
+
+    if (argc != CAN_GETERRORTEXT_ARGC)
+    {
+        napi_throw_type_error(env, 0, "Incorrect number of arguments.");
+        return 0;
+    }
+
+    // Retrieve arguments
+    // argv[0] Error
+    TPCANStatus pcanError;
+    status = napi_get_value_uint32(env, argv[0], &pcanError);
+    assert(status == napi_ok);
+
+    // argv[1] Language
+    uint32_t pcanLanguage;
+    status = napi_get_value_uint32(env, argv[1], &pcanLanguage);
+    assert(status == napi_ok);
+
+    // Buffer
+    char pcanBuffer[256];
+
+    // Call API to get error text
+    TPCANStatus pcanStatus = PCAN_ERROR_UNKNOWN;
+    pcanStatus = CAN_GetErrorText(pcanError, pcanLanguage, pcanBuffer);
+
+    // Print result to console
+#ifdef PCAN_DEBUG
+    printf("pcan_CAN_GetErrorText:\n"
+           "  pcanStatus    = %i (%s)\n"
+           "  pcanError     = %i\n"
+           "  pcanLanguage  = %i\n"
+           "  pcanBuffer    = \"%s\"\n",
+           pcanStatus, pcanStatusLookup(pcanStatus),
+           pcanError,
+           pcanLanguage,
+           pcanBuffer);
+#endif
+
+    // Throw error, if any
+    if (pcanStatus != PCAN_ERROR_OK)
+    {
+        napi_throw_error(env, pcanStatusLookup(pcanStatus),
+                         "pcan_CAN_GetErrorText");
+        return 0;
+    }
+
+    // Create an N-API value for the result and return it
+    napi_value pcanBufferValue;
+    status = napi_create_string_utf8(env, pcanBuffer, NAPI_AUTO_LENGTH, &pcanBufferValue);
+    assert(status == napi_ok);
+
+    return pcanBufferValue;
+}
+
+
+
+
+napi_value pcan_CAN_EnableEvent(napi_env env, napi_callback_info info)
+{
+    napi_status status = napi_generic_failure;
+
+    // Get callback info and argument list
+    size_t argc = CAN_ENABLEEVENT_ARGC;
+    napi_value argv[CAN_ENABLEEVENT_ARGC];
+
+    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
+    assert(status == napi_ok);
+
+    if (argc != CAN_ENABLEEVENT_ARGC)
+    {
+        napi_throw_type_error(env, 0, "Incorrect number of arguments.");
+        return 0;
+    }
+
+    // Retrieve arguments
+    // argv[0] Channel
+    uint32_t pcanChannel;
+    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
+    assert(status == napi_ok);
+
+    // argv[1] Callback
+    napi_valuetype pcanCallbackType;
+    status = napi_typeof(env, argv[1], &pcanCallbackType);
+    assert(status == napi_ok);
+
+    if (pcanCallbackType != napi_function)
+    {
+        napi_throw_type_error(env, 0, "Argument 1 (Callback) is not a function.");
+        return 0;
+    }
+
+    if (pcanEventContextFind(pcanChannel) != 0)
+    {
+        napi_throw_error(env, 0, "Receive event is already enabled on this channel.");
+        return 0;
+    }
+
+    pcanChannelContext_t *channelContext = pcanChannelContextFind(pcanChannel, 1);
+    if (channelContext == 0)
+    {
+        napi_throw_error(env, 0, "Too many channels have the receive event enabled.");
+        return 0;
+    }
+    pcanEventContext_t **slot = &(channelContext->eventContext);
+
+    pcanEventContext_t *eventContext = calloc(1, sizeof(*eventContext));
+    if (eventContext == 0)
+    {
+        napi_throw_error(env, 0, "Unable to allocate receive path.");
+        return 0;
+    }
+
+    // Prepare the native receive path used by the worker thread
+    pcanReceive_t *receive = &(eventContext->receive);
+    if (pcanReceiveInit(receive, pcanChannel, 0, pcanFDChannelIs(pcanChannel)) != 0)
+    {
+        free(eventContext);
+        napi_throw_error(env, 0, "Unable to allocate receive buffer.");
+        return 0;
+    }
+
+    // Create resource name string, used below
+    napi_value asyncResourceName;
+    status = napi_create_string_utf8(env, "pcanCallback",
+                                     NAPI_AUTO_LENGTH, &asyncResourceName);
+    assert(status == napi_ok);
+
+    // Create thread-safe function to use as a callback
+    status = napi_create_threadsafe_function(env,
+                                             argv[1], // func
+                                             0, // async_resource
+                                             asyncResourceName,
+                                             0, // max_queue_size
+                                             1, // initial_thread_count
+                                             0, // thread_finalize_data
+                                             pcan_CAN_EventFinalize,
+                                             0, // context
+                                             0, // call_js_cb
+                                             &(eventContext->callback)); // result
+    assert(status == napi_ok);
+
+    // Apply filters and loopback set before the receive path
+    pcanReceiveConfig_t *config = pcanReceiveConfigFind(pcanChannel);
+    if (config != 0)
+    {
+        pcanReceiveConfigure(receive, config->filters, config->filterCount, config->loopback);
+    }
+
+    // Give echoes to a transmit queue started before the receive path
+    pcanTransmit_t **transmit = pcanTransmitFind(pcanChannel);
+    if ((transmit != 0) && (*transmit)->options.confirm)
+    {
+        pcanReceiveAttachTransmit(receive, *transmit);
+    }
+
+    // Give replies to requests started before the receive path
+    pcanRequest_t **request = pcanRequestFind(pcanChannel);
+    if (request != 0)
+    {
+        pcanReceiveAttachRequest(receive, *request);
+    }
+
+    // Enable CAN Bus receive event, with a worker thread of its own
+    int pcanStatus = PCAN_ERROR_UNKNOWN;
+    eventContext->event = pcanEventEnable(pcanChannel, pcan_CAN_EventCallback, eventContext);
+    pcanStatus = (eventContext->event != 0) ? PCAN_ERROR_OK : PCAN_ERROR_UNKNOWN;
+
+    // Print result to console
+#ifdef PCAN_DEBUG
+    printf("pcan_CAN_EnableEvent: 0x%02X\n", pcanStatus);
+#endif
+
+    // Throw error, if any
+    if (pcanStatus != PCAN_ERROR_OK)
+    {
+        status = napi_release_threadsafe_function(eventContext->callback, napi_tsfn_abort);
+        assert(status == napi_ok);
+        pcanReceiveFree(receive);
+        free(eventContext);
+        napi_throw_error(env, pcanStatusLookup(pcanStatus),
+                         "pcan_CAN_EnableEvent");
+        return 0;
+    }
+
+    *slot = eventContext;
+
+    // Create a N-API value for the result and return it
+    napi_value result;
+    status = napi_create_uint32(env, pcanStatus, &result);
+    assert(status == napi_ok);
+
+    return result;
+}
+
+
+
+
+napi_value pcan_CAN_DisableEvent(napi_env env, napi_callback_info info)
+{
+    napi_status status = napi_generic_failure;
+
+    // Get callback info and argument list
+    size_t argc = CAN_DISABLEEVENT_ARGC;
+    napi_value argv[CAN_DISABLEEVENT_ARGC];
+
+    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
+    assert(status == napi_ok);
+
+    if (argc != CAN_DISABLEEVENT_ARGC)
+    {
+        napi_throw_type_error(env, 0, "Incorrect number of arguments.");
+        return 0;
+    }
+
+    // Retrieve arguments
+    uint32_t pcanChannel;
+    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
+    assert(status == napi_ok);
+
+    pcanEventContext_t **slot = pcanEventContextFind(pcanChannel);
+    if (slot == 0)
+    {
+        napi_throw_error(env, 0, "Receive event is not enabled on this channel.");
+        return 0;
+    }
+
+    // Disable CAN Bus receive event, and wait for its worker thread to exit
+    pcanEventContext_t *eventContext = *slot;
+    int pcanStatus = PCAN_ERROR_UNKNOWN;
+    pcanStatus = (pcanEventDisable(eventContext->event) == 0) ? PCAN_ERROR_OK :
+        PCAN_ERROR_UNKNOWN;
+
+    // Print result to console
+#ifdef PCAN_DEBUG
+    printf("pcan_CAN_DisableEvent: 0x%02X\n", pcanStatus);
+#endif
+
+    // Stop any capture still in progress. It is detached under the sink lock,
+    // so this is safe even if the worker thread was not seen to exit.
+    pcanCapture_t *capture = pcanReceiveDetachCapture(&(eventContext->receive));
+    if (capture != 0)
+    {
+        pcanCaptureStop(capture, 0);
+    }
+
+    // If the worker thread was not seen to exit, it may still call back with
+    // the context, so the context, its receive path and the threadsafe
+    // function are deliberately leaked. The receive path lets go of the other
+    // sinks, which are freed when they are stopped, and the slot is cleared
+    // so that the channel can be enabled again.
+    if (pcanStatus != PCAN_ERROR_OK)
+    {
+        printf("pcan_CAN_DisableEvent: Leaking the receive path of channel 0x%02X\n",
+               pcanChannel);
+        pcanReceiveAttachTransmit(&(eventContext->receive), 0);
+        pcanReceiveAttachTimed(&(eventContext->receive), 0);
+        pcanReceiveAttachRequest(&(eventContext->receive), 0);
+        status = napi_unref_threadsafe_function(env, eventContext->callback);
+        assert(status == napi_ok);
+        *slot = 0;
+
+        napi_throw_error(env, pcanStatusLookup(pcanStatus),
+                         "pcan_CAN_DisableEvent");
+        return 0;
+    }
+
+    // Release the receive path, now that the worker thread has stopped
+    // feeding it
+    pcanReceiveFree(&(eventContext->receive));
+
+    // Try to release the threadsafe function
+    status = napi_unref_threadsafe_function(env, eventContext->callback);
+    assert(status == napi_ok);
+    status = napi_release_threadsafe_function(eventContext->callback, napi_tsfn_abort);
+    assert(status == napi_ok);
+
+    free(eventContext);
+    *slot = 0;
+
+    // Create a N-API value for the result and return it
+    napi_value result;
+    status = napi_create_uint32(env, pcanStatus, &result);
+    assert(status == napi_ok);
+
+    return result;
+}
+
+
+
+
+#if defined _WIN32
+napi_value pcan_CAN_AcceptanceFilter11Bit(napi_env env, napi_callback_info info)
+{
+    napi_status status = napi_generic_failure;
+
+    // Get callback info and argument list
+    size_t argc = CAN_ACCEPTANCEFILTER11BIT_ARGC;
+    napi_value argv[CAN_ACCEPTANCEFILTER11BIT_ARGC];
+
+    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
+    assert(status == napi_ok);
+
+    if (argc != CAN_ACCEPTANCEFILTER11BIT_ARGC)
+    {
+        napi_throw_type_error(env, 0, "Incorrect number of arguments.");
+        return 0;
+    }
+
+    // Retrieve arguments
+    // argv[0] Channel
+    uint32_t pcanChannel;
+    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
+    assert(status == napi_ok);
+
+    // argv[1] AcceptanceCode
+    uint32_t pcan_AcceptanceCode;
+    status = napi_get_value_uint32(env, argv[1], &pcan_AcceptanceCode);
+    assert(status == napi_ok);
+
+    // argv[2] AcceptanceMask
+    uint32_t pcan_AcceptanceMask;
+    status = napi_get_value_uint32(env, argv[2], &pcan_AcceptanceMask);
+    assert(status == napi_ok);
+
+    // Build 64-bit acceptance filter value
+    uint64_t pcan_AcceptanceFilter = 0;
+    pcan_AcceptanceFilter |= ((uint64_t)pcan_AcceptanceCode << 0x20);
+    pcan_AcceptanceFilter |= ((uint64_t)(~pcan_AcceptanceMask));
+    // Note that pcan_AcceptanceMask's bits are flipped from "don't care"
+    // to "do care"
+
+    // Set the acceptance filter through the API
+    TPCANStatus pcanStatus = PCAN_ERROR_UNKNOWN;
+    pcanStatus = CAN_SetValue(pcanChannel, PCAN_ACCEPTANCE_FILTER_11BIT,
+                               &pcan_AcceptanceFilter, sizeof(pcan_AcceptanceFilter));
+
+    // Print result to console
+#ifdef PCAN_DEBUG
+    printf("pcan_CAN_AcceptanceFilter11Bit:\n"
+           "  pcanStatus            = 0x%02X (%s)\n"
+           "  pcanChannel           = 0x%02X\n"
+           "  pcan_AcceptanceCode   = 0x%08X\n"
+           "  pcan_AcceptanceMask   = 0x%08X\n"
+           "  pcan_AcceptanceFilter = 0x%016llX\n",
+           pcanStatus, pcanStatusLookup(pcanStatus),
+           pcanChannel,
+           pcan_AcceptanceCode,
+           pcan_AcceptanceMask,
+           pcan_AcceptanceFilter);
+#endif
+
+    // Throw error, if any
+    if (pcanStatus != PCAN_ERROR_OK)
+    {
+        napi_throw_error(env, pcanStatusLookup(pcanStatus),
+                         "pcan_CAN_AcceptanceFilter11Bit");
+        return 0;
+    }
+
+    // Create an N-API value for the result and return it
+    napi_value result;
+    status = napi_create_uint32(env, pcanStatus, &result);
+    assert(status == napi_ok);
+
+    return result;    
+}
+
+
+#elif defined __APPLE__
+napi_value pcan_CAN_AcceptanceFilter11Bit(napi_env env, napi_callback_info info)
+{
+    napi_status status = napi_generic_failure;
+
+    // Create an N-API value for the result and return it
+    napi_value result;
+    status = napi_create_uint32(env, 0, &result);
+    assert(status == napi_ok);
+
+    return result;    
+}
+
+
+#endif
+
+
+
+
+#if defined _WIN32
+napi_value pcan_CAN_AcceptanceFilter29Bit(napi_env env, napi_callback_info info)
+{
+    napi_status status = napi_generic_failure;
+
+    // Get callback info and argument list
+    size_t argc = CAN_ACCEPTANCEFILTER29BIT_ARGC;
+    napi_value argv[CAN_ACCEPTANCEFILTER29BIT_ARGC];
+
+    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
+    assert(status == napi_ok);
+
+    if (argc != CAN_ACCEPTANCEFILTER29BIT_ARGC)
+    {
+        napi_throw_type_error(env, 0, "Incorrect number of arguments.");
+        return 0;
+    }
+
+    // Retrieve arguments
+    // argv[0] Channel
+    uint32_t pcanChannel;
+    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
+    assert(status == napi_ok);
+
+    // argv[1] AcceptanceCode
+    uint32_t pcan_AcceptanceCode;
+    status = napi_get_value_uint32(env, argv[1], &pcan_AcceptanceCode);
+    assert(status == napi_ok);
+
+    // argv[2] AcceptanceMask
+    uint32_t pcan_AcceptanceMask;
+    status = napi_get_value_uint32(env, argv[2], &pcan_AcceptanceMask);
+    assert(status == napi_ok);
+
+    // Build 64-bit acceptance filter value
+    uint64_t pcan_AcceptanceFilter = 0;
+    pcan_AcceptanceFilter |= ((uint64_t)pcan_AcceptanceCode << 0x20);
+    pcan_AcceptanceFilter |= ((uint64_t)(~pcan_AcceptanceMask));
+    // Note that pcan_AcceptanceMask's bits are flipped from "don't care"
+    // to "do care"
+
+    // Set the acceptance filter through the API
+    TPCANStatus pcanStatus = PCAN_ERROR_UNKNOWN;
+    pcanStatus = CAN_SetValue(pcanChannel, PCAN_ACCEPTANCE_FILTER_29BIT,
+                               &pcan_AcceptanceFilter, sizeof(pcan_AcceptanceFilter));
+
+    // Print result to console
+#ifdef PCAN_DEBUG
+    printf("pcan_CAN_AcceptanceFilter29Bit:\n"
+           "  pcanStatus            = 0x%02X (%s)\n"
+           "  pcanChannel           = 0x%02X\n"
+           "  pcan_AcceptanceCode   = 0x%08X\n"
+           "  pcan_AcceptanceMask   = 0x%08X\n"
+           "  pcan_AcceptanceFilter = 0x%016llX\n",
+           pcanStatus, pcanStatusLookup(pcanStatus),
+           pcanChannel,
+           pcan_AcceptanceCode,
+           pcan_AcceptanceMask,
+           pcan_AcceptanceFilter);
+#endif
+
+    // Throw error, if any
+    if (pcanStatus != PCAN_ERROR_OK)
+    {
+        napi_throw_error(env, pcanStatusLookup(pcanStatus),
+                         "pcan_CAN_AcceptanceFilter29Bit");
+        return 0;
+    }
+
+    // Create an N-API value for the result and return it
+    napi_value result;
+    status = napi_create_uint32(env, pcanStatus, &result);
+    assert(status == napi_ok);
+
+    return result;    
+}
+
+
+#elif defined __APPLE__
+napi_value pcan_CAN_AcceptanceFilter29Bit(napi_env env, napi_callback_info info)
+{
+    napi_status status = napi_generic_failure;
+
+    // Create an N-API value for the result and return it
+    napi_value result;
+    status = napi_create_uint32(env, 0, &result);
+    assert(status == napi_ok);
+
+    return result;    
+}
+
+
+#endif
+
+
+
+
+napi_value pcan_CAN_ReceiveConfigure(napi_env env, napi_callback_info info)
+{
+    napi_status status = napi_generic_failure;
+
+    // Retrieve callback info and arguments list
+    size_t argc = CAN_RECEIVECONFIGURE_ARGC;
+    napi_value argv[CAN_RECEIVECONFIGURE_ARGC];
+
+    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
+    assert(status == napi_ok);
+
+    if (argc != CAN_RECEIVECONFIGURE_ARGC)
+    {
+        napi_throw_type_error(env, 0, "Incorrect number of arguments.");
+        return 0;
+    }
+
+    // Retrieve arguments
+    // argv[0] Channel
+    uint32_t pcanChannel;
+    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
+    assert(status == napi_ok);
+
+    // argv[1] Options: filters and loopback are optional
+    pcanReceiveConfig_t config;
+    memset(&config, 0, sizeof(config));
+
+    bool loopback = false;
+    napiGetOptionalBool(env, argv[1], "loopback", &loopback);
+    config.loopback = loopback ? 1 : 0;
+
+    napi_valuetype optionsType;
+    status = napi_typeof(env, argv[1], &optionsType);
+    assert(status == napi_ok);
+
+    napi_value filtersValue;
+    bool isArray = false;
+
+    if (optionsType == napi_object)
+    {
+        status = napi_get_named_property(env, argv[1], "filters", &filtersValue);
+        assert(status == napi_ok);
+        status = napi_is_array(env, filtersValue, &isArray);
+        assert(status == napi_ok);
+    }
+
+    if (isArray)
+    {
+        status = napi_get_array_length(env, filtersValue, &(config.filterCount));
+        assert(status == napi_ok);
+
+        if (config.filterCount > PCAN_RECEIVE_FILTERS_MAX)
+        {
+            napi_throw_range_error(env, 0, "Too many receive filters.");
+            return 0;
+        }
+
+        uint32_t i;
+        napi_value element;
+        for (i = 0; i < config.filterCount; i++)
+        {
+            pcanReceiveFilter_t *filter = &(config.filters[i]);
+            bool ext = false;
+            double fromId = 0;
+            double toId = 0x1FFFFFFF;
+            double code = 0;
+            double mask = 0xFFFFFFFF;
+
+            status = napi_get_element(env, filtersValue, i, &element);
+            assert(status == napi_ok);
+
+            napiGetOptionalBool(env, element, "ext", &ext);
+            napiGetOptionalDouble(env, element, "fromId", &fromId);
+            napiGetOptionalDouble(env, element, "toId", &toId);
+            napiGetOptionalDouble(env, element, "code", &code);
+            napiGetOptionalDouble(env, element, "mask", &mask);
+
+            filter->ext = ext ? 1 : 0;
+            filter->fromId = (uint32_t)fromId;
+            filter->toId = (uint32_t)toId;
+            filter->code = (uint32_t)code;
+            filter->mask = (uint32_t)mask;
+        }
+    }
+
+    // Keep the settings for a receive path enabled later, or forget them if
+    // there is nothing to apply
+    int keep = (config.filterCount != 0) || config.loopback;
+    pcanChannelContext_t *channelContext = pcanChannelContextFind(pcanChannel, keep);
+    if (channelContext != 0)
+    {
+        memcpy(&(channelContext->config), &config, sizeof(config));
+    }
+    else if (keep)
+    {
+        napi_throw_error(env, 0, "Too many channels have receive filters.");
+        return 0;
+    }
+
+#ifdef PCAN_DEBUG
+    printf("pcan_CAN_ReceiveConfigure: 0x%02X, %u filters, loopback %d\n", pcanChannel,
+           config.filterCount, config.loopback);
+#endif
+
+    pcanReceive_t *receive = pcanReceiveFind(pcanChannel);
+    if (receive != 0)
+    {
+        pcanReceiveConfigure(receive, config.filters, config.filterCount, config.loopback);
+    }
+
+    napi_value result;
+    status = napi_get_undefined(env, &result);
+    assert(status == napi_ok);
+
+    return result;
+}
+
+
+
+
+napi_value pcan_CAN_ChannelInfo(napi_env env, napi_callback_info info)
+{
+    napi_status status = napi_generic_failure;
+    int i; // for loop variable
+
+    // Get callback info and argument list
+    size_t argc = CAN_CHANNELINFO_ARGC;
+    napi_value argv;
+
+    status = napi_get_cb_info(env, info, &argc, &argv, 0, 0);
+    assert(status == napi_ok);
+
+    if (argc != CAN_CHANNELINFO_ARGC)
+    {
+        napi_throw_type_error(env, 0, "Incorrect number of arguments.");
+        return 0;
+    }
+
+    // Get channel count
+    TPCANStatus pcanStatus = PCAN_ERROR_UNKNOWN;
+    int32_t pcanAttachedChannelsCount = 0;
+
+    pcanStatus = CAN_GetValue(PCAN_NONEBUS, PCAN_ATTACHED_CHANNELS_COUNT,
+                              &pcanAttachedChannelsCount, sizeof(pcanAttachedChannelsCount));
+    if (pcanStatus != PCAN_ERROR_OK)
+    {
+        napi_throw_error(env, pcanStatusLookup(pcanStatus),
+                         "pcan_CAN_ChannelInfo: Error at CAN_GetValue(PCAN_ATTACHED_CHANNELS_COUNT).");
+        return 0;
+    }
+    
+    // Check that there are > 0 channels available
+    if (pcanAttachedChannelsCount == 0)
+    {
+        napi_throw_error(env, "PCAN_ERROR_NOCHANNELS", "No PCAN channels available");
+        return 0;
+    }
+
+#ifdef PCAN_DEBUG
+    printf("pcan_CAN_ChannelInfo: %i channel(s) available\n", pcanAttachedChannelsCount);
+#endif
+
+    // Create empty channel list
+    // Use of malloc and free here violates CSLLC Rule 163
+    TPCANChannelInformation *pcanAttachedChannels = 0;
+    size_t pcanAttachedChannels_sz;
+    pcanAttachedChannels_sz = sizeof(TPCANChannelInformation) * pcanAttachedChannelsCount;
+    pcanAttachedChannels = malloc(pcanAttachedChannels_sz);
+
+    if (pcanAttachedChannels == 0)
+    {
+        napi_throw_error(env, 0, "Error allocating memory for TPCANChannelInformation.");
+        return 0;
+    }
+
+    memset(pcanAttachedChannels, 0, pcanAttachedChannels_sz);
+
+    // Get channel list
+    pcanStatus = CAN_GetValue(PCAN_NONEBUS, PCAN_ATTACHED_CHANNELS,
+                              pcanAttachedChannels, pcanAttachedChannels_sz);
+    if (pcanStatus != PCAN_ERROR_OK)
+    {
+        napi_throw_error(env, pcanStatusLookup(pcanStatus),
+                         "pcan_CAN_ChannelInfo: Error at CAN_GetValue(PCAN_ATTACHED_CHANNELS).");
+        return 0;
+    }
+
+    // Print result to console
+#ifdef PCAN_DEBUG
+    for (i = 0; i < pcanAttachedChannelsCount; i++)
+    {
+        pcanDumpChannelInfo(&(pcanAttachedChannels[i]));
+    }
+#endif
+
+    // Create parent N-API object for channel info array
+    napi_value channelInfo;
+    status = napi_create_array(env, &channelInfo);
+    assert(status == napi_ok);
+
+    napi_value channelInfoElement;
+    napi_value channelInfoElementChannelHandle;
+    napi_value channelInfoElementDeviceType;
+    napi_value channelInfoElementControllerNumber;
+    napi_value channelInfoElementDeviceFeatures;
+    napi_value channelInfoElementDeviceName;
+    napi_value channelInfoElementDeviceID;
+    napi_value channelInfoElementChannelCondition;
+
+    for (i = 0; i < pcanAttachedChannelsCount; i++)
+    {
+        // Create N-API object for array element
+        status = napi_create_object(env, &channelInfoElement);
+        assert(status == napi_ok);
+
+        // Assign properties
+        // - Channel handle
+        status = napi_create_uint32(env, pcanAttachedChannels[i].channel_handle,
+                                   &channelInfoElementChannelHandle);
+        assert(status == napi_ok);
+        status = napi_set_named_property(env, channelInfoElement, "channel_handle",
+                                         channelInfoElementChannelHandle);
+        assert(status == napi_ok);
+
+        // - Device type
+        status = napi_create_uint32(env, pcanAttachedChannels[i].device_type,
+                                    &channelInfoElementDeviceType);
+        assert(status == napi_ok);
+        status = napi_set_named_property(env, channelInfoElement, "device_type",
+                                         channelInfoElementDeviceType);
+        assert(status == napi_ok);
+
+        // - Controller number
+        status = napi_create_uint32(env, pcanAttachedChannels[i].controller_number,
+                                    &channelInfoElementControllerNumber);
+        assert(status == napi_ok);
+        status = napi_set_named_property(env, channelInfoElement, "controller_number",
+                                          channelInfoElementControllerNumber);
+        assert(status == napi_ok);
+
+        // - Device features
+        status = napi_create_uint32(env, pcanAttachedChannels[i].device_features,
+                                    &channelInfoElementDeviceFeatures);
+        assert(status == napi_ok);
+        status = napi_set_named_property(env, channelInfoElement, "device_features",
+                                          channelInfoElementDeviceFeatures);
+        assert(status == napi_ok);
+        
+        // - Device name
+        status = napi_create_string_utf8(env, pcanAttachedChannels[i].device_name,
+                                         NAPI_AUTO_LENGTH, &channelInfoElementDeviceName);
+        assert(status == napi_ok);
+        status = napi_set_named_property(env, channelInfoElement, "device_name",
+                                          channelInfoElementDeviceName);
+
+        // - Device ID
+        status = napi_create_uint32(env, pcanAttachedChannels[i].device_id,
+                                    &channelInfoElementDeviceID);
+        assert(status == napi_ok);
+        status = napi_set_named_property(env, channelInfoElement, "device_id",
+                                          channelInfoElementDeviceID);
+
+        // - Channel condition
+        status = napi_create_uint32(env, pcanAttachedChannels[i].channel_condition,
+                                    &channelInfoElementChannelCondition);
+        assert(status == napi_ok);
+        status = napi_set_named_property(env, channelInfoElement, "channel_condition",
+                                          channelInfoElementChannelCondition);
+
+        // Add complete element to array
+        status = napi_set_element(env, channelInfo, i, channelInfoElement);
+        assert(status == napi_ok);
+    }
+
+    // Free dynamically allocated memory
+    free(pcanAttachedChannels);
+
+    // Return the N-API object
+    return channelInfo;
+}
+
+
+
+
+napi_value pcan_CAN_TranslateBaud(napi_env env, napi_callback_info info)
+{
+    napi_status status = napi_generic_failure;
+
+    // Get callback info and argument list
+    size_t argc = CAN_TRANSLATEBAUD_ARGC;
+    napi_value argv[CAN_TRANSLATEBAUD_ARGC];
+
+    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
+    assert(status == napi_ok);
+
+    if (argc != CAN_TRANSLATEBAUD_ARGC)
+    {
+        napi_throw_type_error(env, 0, "Incorrect number of arguments.");
+        return 0;
+    }
+
+    // Retrieve arguments
+    // argv[0] Integer baud
+    uint32_t baudInt;
+    status = napi_get_value_uint32(env, argv[0], &baudInt);
+    assert(status == napi_ok);
+
+    // Translate into a PCAN-Basic constant
+    TPCANBaudrate baudAPI;
+    baudAPI = pcanTranslateBaud(baudInt);
+
+    if (baudAPI == 0)
+    {
+        napi_throw_error(env, 0, "Unknown CAN baud specified.");
+        return 0;
+    }
+
+    // Print result to console
+#ifdef PCAN_DEBUG
+    printf("pcan_CAN_TranslateBaud: baudInt = %i, baudAPI = 0x%04X\n",
+           baudInt, baudAPI);
+#endif
+
+    // Create N-API value to return
+    napi_value baudResult;
+    status = napi_create_uint32(env, baudAPI, &baudResult);
+    assert(status == napi_ok);
+
+    return baudResult;
+}
+
+
+
+
+napi_value pcan_CAN_BitTiming(napi_env env, napi_callback_info info)
+{
+    napi_status status = napi_generic_failure;
+
+    // Get callback info and argument list
+    size_t argc = CAN_BITTIMING_ARGC;
+    napi_value argv[CAN_BITTIMING_ARGC];
+
+    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
+    assert(status == napi_ok);
+
+    if (argc != CAN_BITTIMING_ARGC)
+    {
+        napi_throw_type_error(env, 0, "Incorrect number of arguments.");
+        return 0;
+    }
+
+    // Retrieve arguments
+    // argv[0] Options: bitrate is required, a data bit rate asks for CAN FD
+    // timings, and the sample points default to those recommended by CiA
+    double bitrate = 0;
+    double dataBitrate = 0;
+    double clockMhz = 0;
+    double max = 8;
+    bool fd = false;
+
+    napiGetOptionalDouble(env, argv[0], "bitrate", &bitrate);
+    fd = napiGetOptionalDouble(env, argv[0], "dataBitrate", &dataBitrate);
+    napiGetOptionalDouble(env, argv[0], "clockMhz", &clockMhz);
+    napiGetOptionalDouble(env, argv[0], "max", &max);
+
+    double samplePoint = fd ? 0.8 : 0.875;
+    double dataSamplePoint = 0.75;
+    napiGetOptionalDouble(env, argv[0], "samplePoint", &samplePoint);
+    napiGetOptionalDouble(env, argv[0], "dataSamplePoint", &dataSamplePoint);
+
+    if ((bitrate < 1) || (bitrate > 1000000) || (fd && ((dataBitrate < 1) || (dataBitrate > 12000000))))
+    {
+        napi_throw_range_error(env, 0, "Bit rate out of range.");
+        return 0;
+    }
+    if ((samplePoint <= 0) || (samplePoint >= 1) || (dataSamplePoint <= 0) ||
+        (dataSamplePoint >= 1))
+    {
+        napi_throw_range_error(env, 0, "Sample point must be between 0 and 1.");
+        return 0;
+    }
+    if (max < 1)
+    {
+        max = 1;
+    }
+
+    // Search, then return the timings found, best first
+    napi_value result;
+    napi_value element;
+    napi_value value;
+    uint32_t count = 0;
+    uint32_t i;
+
+    status = napi_create_array(env, &result);
+    assert(status == napi_ok);
+
+    if (fd)
+    {
+        pcanTimingFD_t timings[PCAN_TIMING_FD_CLOCKS];
+        char bitrateFD[256];
+
+        count = pcanTimingSolveFD((uint32_t)(clockMhz * 1e6), (uint32_t)bitrate,
+                                  (uint32_t)(samplePoint * 1000 + 0.5), (uint32_t)dataBitrate,
+                                  (uint32_t)(dataSamplePoint * 1000 + 0.5), timings,
+                                  (uint32_t)max);
+
+        for (i = 0; i < count; i++)
+        {
+            status = napi_create_object(env, &element);
+            assert(status == napi_ok);
+
+            status = napi_create_double(env, timings[i].nominal.clock / 1e6, &value);
+            assert(status == napi_ok);
+            status = napi_set_named_property(env, element, "clockMhz", value);
+            assert(status == napi_ok);
+
+            status = napi_create_double(env, timings[i].errorPpm / 1e6, &value);
+            assert(status == napi_ok);
+            status = napi_set_named_property(env, element, "error", value);
+            assert(status == napi_ok);
+
+            status = napi_set_named_property(env, element, "nominal",
+                                             pcanTimingValue(env, &(timings[i].nominal)));
+            assert(status == napi_ok);
+            status = napi_set_named_property(env, element, "data",
+                                             pcanTimingValue(env, &(timings[i].data)));
+            assert(status == napi_ok);
+
+            pcanTimingFDString(&(timings[i]), bitrateFD, sizeof(bitrateFD));
+            status = napi_create_string_utf8(env, bitrateFD, NAPI_AUTO_LENGTH, &value);
+            assert(status == napi_ok);
+            status = napi_set_named_property(env, element, "bitrateFD", value);
+            assert(status == napi_ok);
+
+            status = napi_set_element(env, result, i, element);
+            assert(status == napi_ok);
+        }
+    }
+    else
+    {
+        pcanTiming_t timings[PCAN_TIMING_RESULTS_MAX];
+
+        count = pcanTimingSolve(PCAN_TIMING_BTR_CLOCK, &pcanTimingLimitsBtr, (uint32_t)bitrate,
+                                (uint32_t)(samplePoint * 1000 + 0.5), timings, (uint32_t)max);
+
+        for (i = 0; i < count; i++)
+        {
+            element = pcanTimingValue(env, &(timings[i]));
+
+            status = napi_create_uint32(env, pcanTimingBtr0Btr1(&(timings[i])), &value);
+            assert(status == napi_ok);
+            status = napi_set_named_property(env, element, "btr0btr1", value);
+            assert(status == napi_ok);
+
+            status = napi_set_element(env, result, i, element);
+            assert(status == napi_ok);
+        }
+    }
+
+#ifdef PCAN_DEBUG
+    printf("pcan_CAN_BitTiming: %u timings for %.0f bit/s\n", count, bitrate);
+#endif
+
+    return result;
+}
+
+
+
+
+napi_value pcan_CAN_ReadBatch(napi_env env, napi_callback_info info)
+{
+    napi_status status = napi_generic_failure;
+
+    // Retrieve callback info and arguments list
+    size_t argc = CAN_READBATCH_ARGC;
+    napi_value argv[CAN_READBATCH_ARGC];
+
+    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
+    assert(status == napi_ok);
+
+    if (argc != CAN_READBATCH_ARGC)
+    {
+        napi_throw_type_error(env, 0, "Incorrect number of arguments.");
+        return 0;
+    }
+
+    // Retrieve arguments
+    // argv[0] Channel
+    uint32_t pcanChannel;
+    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
+    assert(status == napi_ok);
+
+    pcanReceive_t *receive = pcanReceiveFind(pcanChannel);
+    if (receive == 0)
+    {
+        napi_throw_error(env, 0, "Receive event is not enabled on this channel.");
+        return 0;
+    }
+
+    // Size the buffer from the frames waiting now; the worker thread only
+    // ever adds frames, so at least this many can be popped below
+    uint32_t count = pcanReceivePending(receive);
+    if (count > PCAN_READBATCH_MAX)
+    {
+        count = PCAN_READBATCH_MAX;
+    }
+
+    // Create a buffer and move frames from the receive ring into it, as
+    // pcanFrameFD_t records if the channel was initialized for CAN FD
+    napi_value pcanFrameBuffer;
+    void *pcanFrameBufferData;
+    status = napi_create_buffer(env, count * receive->recordSize,
+                                &pcanFrameBufferData, &pcanFrameBuffer);
+    assert(status == napi_ok);
+
+    count = pcanReceivePop(receive, pcanFrameBufferData, count);
+
+#ifdef PCAN_DEBUG
+    printf("pcan_CAN_ReadBatch: %u frames\n", count);
+#endif
+
+    return pcanFrameBuffer;
+}
+
+
+
+
+napi_value pcan_CAN_WriteBatch(napi_env env, napi_callback_info info)
+{
+    napi_status status = napi_generic_failure;
+
+    // Retrieve callback info and arguments list
+    size_t argc = CAN_WRITEBATCH_ARGC;
+    napi_value argv[CAN_WRITEBATCH_ARGC];
+
+    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
+    assert(status == napi_ok);
+
+    if (argc != CAN_WRITEBATCH_ARGC)
+    {
+        napi_throw_type_error(env, 0, "Incorrect number of arguments.");
+        return 0;
+    }
+
+    // Retrieve arguments
+    // argv[0] Channel
+    uint32_t pcanChannel;
+    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
+    assert(status == napi_ok);
+
+    // argv[1] FrameBuffer
+    uint8_t *records = 0;
+    size_t recordsLength = 0;
+    status = napi_get_buffer_info(env, argv[1], (void**)&records, &recordsLength);
+    if (status != napi_ok)
+    {
+        napi_throw_type_error(env, 0, "Argument 1 (FrameBuffer) is not a Buffer.");
+        return 0;
+    }
+
+    // argv[2] Count
+    uint32_t count;
+    status = napi_get_value_uint32(env, argv[2], &count);
+    assert(status == napi_ok);
+
+    if (count > recordsLength / PCAN_FRAME_SIZE)
+    {
+        napi_throw_error(env, 0, "FrameBuffer holds fewer than Count frames.");
+        return 0;
+    }
+
+    // Write frames in order until the driver stops accepting them. Records in
+    // a Buffer need not be aligned, so each is copied out before use.
+    TPCANStatus pcanStatus = PCAN_ERROR_OK;
+    pcanFrame_t frame;
+    TPCANMsg msg;
+    uint32_t written = 0;
+
+    while (written < count)
+    {
+        memcpy(&frame, records + (size_t)written * PCAN_FRAME_SIZE, PCAN_FRAME_SIZE);
+        if (frame.len > PCAN_FRAME_DATA_MAX)
+        {
+            pcanStatus = PCAN_ERROR_ILLPARAMVAL;
+            break;
+        }
+
+        pcanFrameToMsg(&frame, &msg);
+        pcanStatus = CAN_Write(pcanChannel, &msg);
+        if (pcanStatus != PCAN_ERROR_OK)
+        {
+            break;
+        }
+        written++;
+    }
+
+#ifdef PCAN_DEBUG
+    printf("pcan_CAN_WriteBatch: %u of %u frames (%s)\n", written, count,
+           pcanStatusLookup(pcanStatus));
+#endif
+
+    // A full transmit queue is not an error; the caller retries the rest. Any
+    // other error is thrown unless some frames were written, in which case it
+    // is left to be reported by the next call.
+    if ((pcanStatus != PCAN_ERROR_OK) && (pcanStatus != PCAN_ERROR_QXMTFULL) &&
+        (written == 0))
+    {
+        napi_throw_error(env, pcanStatusLookup(pcanStatus), "pcan_CAN_WriteBatch");
+        return 0;
+    }
+
+    napi_value result;
+    status = napi_create_uint32(env, written, &result);
+    assert(status == napi_ok);
+
+    return result;
+}
+
+
+
+
+napi_value pcan_CAN_WriteBatchFD(napi_env env, napi_callback_info info)
+{
+    napi_status status = napi_generic_failure;
+
+    // Retrieve callback info and arguments list
+    size_t argc = CAN_WRITEBATCHFD_ARGC;
+    napi_value argv[CAN_WRITEBATCHFD_ARGC];
+
+    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
+    assert(status == napi_ok);
+
+    if (argc != CAN_WRITEBATCHFD_ARGC)
+    {
+        napi_throw_type_error(env, 0, "Incorrect number of arguments.");
+        return 0;
+    }
+
+    // Retrieve arguments
+    // argv[0] Channel
+    uint32_t pcanChannel;
+    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
+    assert(status == napi_ok);
+
+    // argv[1] FrameBuffer
+    uint8_t *records = 0;
+    size_t recordsLength = 0;
+    status = napi_get_buffer_info(env, argv[1], (void**)&records, &recordsLength);
+    if (status != napi_ok)
+    {
+        napi_throw_type_error(env, 0, "Argument 1 (FrameBuffer) is not a Buffer.");
+        return 0;
+    }
+
+    // argv[2] Count
+    uint32_t count;
+    status = napi_get_value_uint32(env, argv[2], &count);
+    assert(status == napi_ok);
+
+    if (count > recordsLength / PCAN_FRAME_FD_SIZE)
+    {
+        napi_throw_error(env, 0, "FrameBuffer holds fewer than Count frames.");
+        return 0;
+    }
+
+    // Write frames in order until the driver stops accepting them. Records in
+    // a Buffer need not be aligned, so each is copied out before use.
+    TPCANStatus pcanStatus = PCAN_ERROR_OK;
+    pcanFrameFD_t frame;
+    TPCANMsgFD msg;
+    uint32_t written = 0;
+
+    while (written < count)
+    {
+        memcpy(&frame, records + (size_t)written * PCAN_FRAME_FD_SIZE, PCAN_FRAME_FD_SIZE);
+        if ((frame.len > PCAN_FRAME_FD_DATA_MAX) ||
+            (!(frame.msgtype & PCAN_MESSAGE_FD) && (frame.len > PCAN_FRAME_DATA_MAX)))
+        {
+            pcanStatus = PCAN_ERROR_ILLPARAMVAL;
+            break;
+        }
+
+        pcanFrameFDToMsg(&frame, &msg);
+        pcanStatus = CAN_WriteFD(pcanChannel, &msg);
+        if (pcanStatus != PCAN_ERROR_OK)
+        {
+            break;
+        }
+        written++;
+    }
+
+#ifdef PCAN_DEBUG
+    printf("pcan_CAN_WriteBatchFD: %u of %u frames (%s)\n", written, count,
+           pcanStatusLookup(pcanStatus));
+#endif
+
+    // A full transmit queue is not an error; the caller retries the rest. Any
+    // other error is thrown unless some frames were written, in which case it
+    // is left to be reported by the next call.
+    if ((pcanStatus != PCAN_ERROR_OK) && (pcanStatus != PCAN_ERROR_QXMTFULL) &&
+        (written == 0))
+    {
+        napi_throw_error(env, pcanStatusLookup(pcanStatus), "pcan_CAN_WriteBatchFD");
+        return 0;
+    }
+
+    napi_value result;
+    status = napi_create_uint32(env, written, &result);
+    assert(status == napi_ok);
+
+    return result;
+}
+
+
+
+
+napi_value pcan_CAN_TransmitStart(napi_env env, napi_callback_info info)
+{
+    napi_status status = napi_generic_failure;
+
+    // Retrieve callback info and arguments list
+    size_t argc = CAN_TRANSMITSTART_ARGC;
+    napi_value argv[CAN_TRANSMITSTART_ARGC];
+
+    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
+    assert(status == napi_ok);
+
+    if (argc != CAN_TRANSMITSTART_ARGC)
+    {
+        napi_throw_type_error(env, 0, "Incorrect number of arguments.");
+        return 0;
+    }
+
+    // Retrieve arguments
+    // argv[0] Channel
+    uint32_t pcanChannel;
+    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
+    assert(status == napi_ok);
+
+    // argv[1] Options; all properties are optional
+    pcanTransmitOptions_t options = { 0 };
+    double queueSize = 0;
+    double bitrate = 0;
+    double confirmTimeoutMs = 0;
+    bool priority = false;
+    bool confirm = false;
+    napiGetOptionalDouble(env, argv[1], "queueSize", &queueSize);
+    napiGetOptionalBool(env, argv[1], "priority", &priority);
+    napiGetOptionalDouble(env, argv[1], "bitrate", &bitrate);
+    napiGetOptionalDouble(env, argv[1], "maxLoad", &(options.maxLoad));
+    napiGetOptionalBool(env, argv[1], "confirm", &confirm);
+    napiGetOptionalDouble(env, argv[1], "confirmTimeoutMs", &confirmTimeoutMs);
+    options.capacity = (uint32_t)queueSize;
+    options.priority = priority ? 1 : 0;
+    options.bitrate = (uint32_t)bitrate;
+    options.confirm = confirm ? 1 : 0;
+    options.confirmTimeoutUs = (uint32_t)(confirmTimeoutMs * 1000);
+
+    // argv[2] Callback
+    napi_valuetype callbackType;
+    status = napi_typeof(env, argv[2], &callbackType);
+    assert(status == napi_ok);
+
+    if (callbackType != napi_function)
+    {
+        napi_throw_type_error(env, 0, "Argument 2 (Callback) is not a function.");
+        return 0;
+    }
+
+    if (pcanTransmitFind(pcanChannel) != 0)
+    {
+        napi_throw_error(env, 0, "Transmit queue is already started on this channel.");
+        return 0;
+    }
+
+    pcanChannelContext_t *channelContext = pcanChannelContextFind(pcanChannel, 1);
+    if (channelContext == 0)
+    {
+        napi_throw_error(env, 0, "Too many channels have a transmit queue.");
+        return 0;
+    }
+    pcanTransmit_t **slot = &(channelContext->transmit);
+
+    // Create thread-safe function, called when transmit results are ready
+    napi_value asyncResourceName;
+    status = napi_create_string_utf8(env, "pcanTransmitCallback",
+                                     NAPI_AUTO_LENGTH, &asyncResourceName);
+    assert(status == napi_ok);
+
+    napi_threadsafe_function callback;
+    status = napi_create_threadsafe_function(env,
+                                             argv[2], // func
+                                             0, // async_resource
+                                             asyncResourceName,
+                                             0, // max_queue_size
+                                             1, // initial_thread_count
+                                             0, // thread_finalize_data
+                                             0, // thread_finalize_cb
+                                             0, // context
+                                             0, // call_js_cb
+                                             &callback); // result
+    assert(status == napi_ok);
+
+    // Start the writer thread
+    const char *error = 0;
+    *slot = pcanTransmitStart(pcanChannel, &options, pcanTransmitNotify, callback, &error);
+
+#ifdef PCAN_DEBUG
+    printf("pcan_CAN_TransmitStart: 0x%02X (%s)\n", pcanChannel, (*slot != 0) ? "OK" : error);
+#endif
+
+    if (*slot == 0)
+    {
+        status = napi_release_threadsafe_function(callback, napi_tsfn_abort);
+        assert(status == napi_ok);
+
+        napi_throw_error(env, 0, error);
+        return 0;
+    }
+
+    // Confirmed writes need the echoes drained by the receive path; if it is
+    // not running yet, pcan_CAN_EnableEvent attaches the queue instead
+    pcanReceive_t *receive = pcanReceiveFind(pcanChannel);
+    if (options.confirm && (receive != 0))
+    {
+        pcanReceiveAttachTransmit(receive, *slot);
+    }
+
+    napi_value result;
+    status = napi_get_undefined(env, &result);
+    assert(status == napi_ok);
+
+    return result;
+}
+
+
+
+
+napi_value pcan_CAN_TransmitPush(napi_env env, napi_callback_info info)
+{
+    napi_status status = napi_generic_failure;
+
+    // Retrieve callback info and arguments list
+    size_t argc = CAN_TRANSMITPUSH_ARGC;
+    napi_value argv[CAN_TRANSMITPUSH_ARGC];
+
+    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
+    assert(status == napi_ok);
+
+    if (argc != CAN_TRANSMITPUSH_ARGC)
+    {
+        napi_throw_type_error(env, 0, "Incorrect number of arguments.");
+        return 0;
+    }
+
+    // Retrieve arguments
+    // argv[0] Channel
+    uint32_t pcanChannel;
+    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
+    assert(status == napi_ok);
+
+    // argv[1] FrameBuffer
+    uint8_t *records = 0;
+    size_t recordsLength = 0;
+    status = napi_get_buffer_info(env, argv[1], (void**)&records, &recordsLength);
+    if (status != napi_ok)
+    {
+        napi_throw_type_error(env, 0, "Argument 1 (FrameBuffer) is not a Buffer.");
+        return 0;
+    }
+
+    // argv[2] Count
+    uint32_t count;
+    status = napi_get_value_uint32(env, argv[2], &count);
+    assert(status == napi_ok);
+
+    if (count > recordsLength / PCAN_FRAME_SIZE)
+    {
+        napi_throw_error(env, 0, "FrameBuffer holds fewer than Count frames.");
+        return 0;
+    }
+
+    pcanTransmit_t **slot = pcanTransmitFind(pcanChannel);
+    if (slot == 0)
+    {
+        napi_throw_error(env, 0, "Transmit queue is not started on this channel.");
+        return 0;
+    }
+
+    // Every record is checked before any is queued, so that a bad one does
+    // not leave the frames ahead of it queued behind an error
+    uint32_t i;
+
+    for (i = 0; i < count; i++)
+    {
+        if (records[(size_t)i * PCAN_FRAME_SIZE + offsetof(pcanFrame_t, len)] > PCAN_FRAME_DATA_MAX)
+        {
+            napi_throw_error(env, pcanStatusLookup(PCAN_ERROR_ILLPARAMVAL),
+                             "pcan_CAN_TransmitPush");
+            return 0;
+        }
+    }
+
+    // Records in a Buffer need not be aligned, so they are copied into
+    // aligned storage before being queued
+    pcanFrame_t frames[64];
+    uint32_t queued = 0;
+    uint32_t batch;
+    uint32_t pushed;
+
+    while (queued < count)
+    {
+        batch = count - queued;
+        if (batch > sizeof(frames) / sizeof(frames[0]))
+        {
+            batch = sizeof(frames) / sizeof(frames[0]);
+        }
+
+        memcpy(frames, records + (size_t)queued * PCAN_FRAME_SIZE, batch * PCAN_FRAME_SIZE);
+
+        pushed = pcanTransmitPush(*slot, frames, batch);
+        queued += pushed;
+        if (pushed < batch)
+        {
+            break;
+        }
+    }
+
+    napi_value result;
+    status = napi_create_uint32(env, queued, &result);
+    assert(status == napi_ok);
+
+    return result;
+}
+
+
+
+
+napi_value pcan_CAN_TransmitCancel(napi_env env, napi_callback_info info)
+{
+    napi_status status = napi_generic_failure;
+
+    // Retrieve callback info and arguments list
+    size_t argc = CAN_TRANSMITCANCEL_ARGC;
+    napi_value argv[CAN_TRANSMITCANCEL_ARGC];
+
+    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
+    assert(status == napi_ok);
+
+    if (argc != CAN_TRANSMITCANCEL_ARGC)
+    {
+        napi_throw_type_error(env, 0, "Incorrect number of arguments.");
+        return 0;
+    }
+
+    // Retrieve arguments
+    // argv[0] Channel
+    uint32_t pcanChannel;
+    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
+    assert(status == napi_ok);
+
+    // argv[1] ID
+    uint32_t id;
+    status = napi_get_value_uint32(env, argv[1], &id);
+    assert(status == napi_ok);
+
+    // argv[2] Extended
+    bool ext = false;
+    status = napi_get_value_bool(env, argv[2], &ext);
+    if (status != napi_ok)
+    {
+        napi_throw_type_error(env, 0, "Argument 2 (Extended) is not a boolean.");
+        return 0;
+    }
+
+    pcanTransmit_t **slot = pcanTransmitFind(pcanChannel);
+    if (slot == 0)
+    {
+        napi_throw_error(env, 0, "Transmit queue is not started on this channel.");
+        return 0;
+    }
+
+    uint32_t cancelled = pcanTransmitCancel(*slot, id, ext ? 1 : 0);
+
+#ifdef PCAN_DEBUG
+    printf("pcan_CAN_TransmitCancel: 0x%X, %u frames\n", id, cancelled);
+#endif
+
+    napi_value result;
+    status = napi_create_uint32(env, cancelled, &result);
+    assert(status == napi_ok);
+
+    return result;
+}
+
+
+
+
+napi_value pcan_CAN_TransmitResults(napi_env env, napi_callback_info info)
+{
+    napi_status status = napi_generic_failure;
+
+    // Retrieve callback info and arguments list
+    size_t argc = CAN_TRANSMITRESULTS_ARGC;
+    napi_value argv[CAN_TRANSMITRESULTS_ARGC];
+
+    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
+    assert(status == napi_ok);
+
+    if (argc != CAN_TRANSMITRESULTS_ARGC)
+    {
+        napi_throw_type_error(env, 0, "Incorrect number of arguments.");
+        return 0;
+    }
+
+    // Retrieve arguments
+    // argv[0] Channel
+    uint32_t pcanChannel;
+    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
+    assert(status == napi_ok);
+
+    pcanTransmit_t **slot = pcanTransmitFind(pcanChannel);
+    if (slot == 0)
+    {
+        napi_throw_error(env, 0, "Transmit queue is not started on this channel.");
+        return 0;
+    }
+
+    // Size the buffer from the results waiting now; the writer thread only
+    // ever adds results, so at least this many can be moved below
+    uint32_t count = pcanTransmitResultsPending(*slot);
+    if (count > PCAN_TRANSMITRESULTS_MAX)
+    {
+        count = PCAN_TRANSMITRESULTS_MAX;
+    }
+
+    napi_value resultBuffer;
+    void *resultBufferData;
+    status = napi_create_buffer(env, count * PCAN_TRANSMIT_RESULT_SIZE,
+                                &resultBufferData, &resultBuffer);
+    assert(status == napi_ok);
+
+    count = pcanTransmitResults(*slot, (pcanTransmitResult_t*)resultBufferData, count);
+
+#ifdef PCAN_DEBUG
+    printf("pcan_CAN_TransmitResults: %u results\n", count);
+#endif
+
+    return resultBuffer;
+}
+
+
+
+
+napi_value pcan_CAN_TransmitStats(napi_env env, napi_callback_info info)
+{
+    napi_status status = napi_generic_failure;
+
+    // Retrieve callback info and arguments list
+    size_t argc = CAN_TRANSMITSTATS_ARGC;
+    napi_value argv[CAN_TRANSMITSTATS_ARGC];
+
+    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
+    assert(status == napi_ok);
+
+    if (argc != CAN_TRANSMITSTATS_ARGC)
+    {
+        napi_throw_type_error(env, 0, "Incorrect number of arguments.");
+        return 0;
+    }
+
+    // Retrieve arguments
+    // argv[0] Channel
+    uint32_t pcanChannel;
+    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
+    assert(status == napi_ok);
+
+    pcanTransmit_t **slot = pcanTransmitFind(pcanChannel);
+    if (slot == 0)
+    {
+        napi_throw_error(env, 0, "Transmit queue is not started on this channel.");
+        return 0;
+    }
+
+    pcanTransmitStats_t stats = { 0 };
+    pcanTransmitGetStats(*slot, &stats);
+
+    return pcanTransmitStatsValue(env, &stats);
+}
+
+
+
+
+napi_value pcan_CAN_TransmitSource(napi_env env, napi_callback_info info)
+{
+    napi_status status = napi_generic_failure;
+
+    // Retrieve callback info and arguments list
+    size_t argc = CAN_TRANSMITSOURCE_ARGC;
+    napi_value argv[CAN_TRANSMITSOURCE_ARGC];
+
+    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
+    assert(status == napi_ok);
+
+    if (argc != CAN_TRANSMITSOURCE_ARGC)
+    {
+        napi_throw_type_error(env, 0, "Incorrect number of arguments.");
+        return 0;
+    }
+
+    // Retrieve arguments
+    // argv[0] Channel
+    uint32_t pcanChannel;
+    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
+    assert(status == napi_ok);
+
+    // argv[1] Source
+    uint32_t source;
+    status = napi_get_value_uint32(env, argv[1], &source);
+    assert(status == napi_ok);
+
+    // argv[2] Options; all properties are optional
+    pcanTransmitSourceOptions_t options = { 0 };
+    double weight = 1;
+    options.burst = 1;
+    napiGetOptionalDouble(env, argv[2], "weight", &weight);
+    napiGetOptionalDouble(env, argv[2], "rate", &(options.rate));
+    napiGetOptionalDouble(env, argv[2], "burst", &(options.burst));
+    options.weight = (weight >= 1) ? (uint32_t)weight : 1;
+
+    pcanTransmit_t **slot = pcanTransmitFind(pcanChannel);
+    if (slot == 0)
+    {
+        napi_throw_error(env, 0, "Transmit queue is not started on this channel.");
+        return 0;
+    }
+
+    if (pcanTransmitSetSource(*slot, source, &options) != 0)
+    {
+        napi_throw_error(env, 0, "Invalid transmit source.");
+        return 0;
+    }
+
+#ifdef PCAN_DEBUG
+    printf("pcan_CAN_TransmitSource: %u, weight %u\n", source, options.weight);
+#endif
+
+    napi_value result;
+    status = napi_get_undefined(env, &result);
+    assert(status == napi_ok);
+
+    return result;
+}
+
+
+
+
+napi_value pcan_CAN_TransmitSourceStats(napi_env env, napi_callback_info info)
+{
+    napi_status status = napi_generic_failure;
+
+    // Retrieve callback info and arguments list
+    size_t argc = CAN_TRANSMITSOURCESTATS_ARGC;
+    napi_value argv[CAN_TRANSMITSOURCESTATS_ARGC];
+
+    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
+    assert(status == napi_ok);
+
+    if (argc != CAN_TRANSMITSOURCESTATS_ARGC)
+    {
+        napi_throw_type_error(env, 0, "Incorrect number of arguments.");
+        return 0;
+    }
+
+    // Retrieve arguments
+    // argv[0] Channel
+    uint32_t pcanChannel;
+    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
+    assert(status == napi_ok);
+
+    // argv[1] Source
+    uint32_t source;
+    status = napi_get_value_uint32(env, argv[1], &source);
+    assert(status == napi_ok);
+
+    pcanTransmit_t **slot = pcanTransmitFind(pcanChannel);
+    if (slot == 0)
+    {
+        napi_throw_error(env, 0, "Transmit queue is not started on this channel.");
+        return 0;
+    }
+
+    pcanTransmitSourceStats_t stats = { 0 };
+    if (pcanTransmitGetSourceStats(*slot, source, &stats) != 0)
+    {
+        napi_throw_error(env, 0, "Invalid transmit source.");
+        return 0;
+    }
+
+    napi_value result;
+    napi_value value;
+    status = napi_create_object(env, &result);
+    assert(status == napi_ok);
+
+    const struct
+    {
+        const char *name;
+        uint64_t value;
+    } counts[] = {
+        { "queued", stats.queued },
+        { "sent", stats.sent },
+        { "throttled", stats.throttled },
+        { "pending", stats.pending },
+        { "meanLatencyUs", stats.meanLatencyUs },
+        { "maxLatencyUs", stats.maxLatencyUs },
+    };
+    size_t i;
+
+    for (i = 0; i < sizeof(counts) / sizeof(counts[0]); i++)
+    {
+        status = napi_create_double(env, (double)counts[i].value, &value);
+        assert(status == napi_ok);
+        status = napi_set_named_property(env, result, counts[i].name, value);
+        assert(status == napi_ok);
+    }
+
+    return result;
+}
+
+
+
+
+napi_value pcan_CAN_TransmitLatency(napi_env env, napi_callback_info info)
+{
+    napi_status status = napi_generic_failure;
+
+    // Retrieve callback info and arguments list
+    size_t argc = CAN_TRANSMITLATENCY_ARGC;
+    napi_value argv[CAN_TRANSMITLATENCY_ARGC];
+
+    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
+    assert(status == napi_ok);
+
+    if (argc != CAN_TRANSMITLATENCY_ARGC)
+    {
+        napi_throw_type_error(env, 0, "Incorrect number of arguments.");
+        return 0;
+    }
+
+    // Retrieve arguments
+    // argv[0] Channel
+    uint32_t pcanChannel;
+    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
+    assert(status == napi_ok);
+
+    pcanTransmit_t **slot = pcanTransmitFind(pcanChannel);
+    if (slot == 0)
+    {
+        napi_throw_error(env, 0, "Transmit queue is not started on this channel.");
+        return 0;
+    }
+
+    pcanTransmitLatency_t latency;
+    pcanTransmitGetLatency(*slot, &latency);
+
+    // Find the bucket each percentile falls in; bucket n holds latencies
+    // below 2^n us, but none above the maximum seen
+    const double fractions[] = { 0.5, 0.9, 0.99 };
+    uint64_t percentiles[3] = { 0 };
+    uint64_t below = 0;
+    size_t p = 0;
+    size_t i;
+
+    for (i = 0; (i < PCAN_TRANSMIT_LATENCY_BUCKETS) && (latency.count > 0); i++)
+    {
+        below += latency.buckets[i];
+        while ((p < 3) && (below >= fractions[p] * latency.count))
+        {
+            percentiles[p] = ((uint64_t)1 << i) - 1;
+            if (percentiles[p] > latency.maxUs)
+            {
+                percentiles[p] = latency.maxUs;
+            }
+            p++;
+        }
+    }
+
+    napi_value result;
+    napi_value value;
+    status = napi_create_object(env, &result);
+    assert(status == napi_ok);
+
+    const struct
+    {
+        const char *name;
+        uint64_t value;
+    } counts[] = {
+        { "count", latency.count },
+        { "meanUs", (latency.count > 0) ? latency.sumUs / latency.count : 0 },
+        { "maxUs", latency.maxUs },
+        { "p50Us", percentiles[0] },
+        { "p90Us", percentiles[1] },
+        { "p99Us", percentiles[2] },
+    };
+
+    for (i = 0; i < sizeof(counts) / sizeof(counts[0]); i++)
+    {
+        status = napi_create_double(env, (double)counts[i].value, &value);
+        assert(status == napi_ok);
+        status = napi_set_named_property(env, result, counts[i].name, value);
+        assert(status == napi_ok);
+    }
+
+    napi_value buckets;
+    status = napi_create_array_with_length(env, PCAN_TRANSMIT_LATENCY_BUCKETS, &buckets);
+    assert(status == napi_ok);
+
+    for (i = 0; i < PCAN_TRANSMIT_LATENCY_BUCKETS; i++)
+    {
+        status = napi_create_double(env, (double)latency.buckets[i], &value);
+        assert(status == napi_ok);
+        status = napi_set_element(env, buckets, (uint32_t)i, value);
+        assert(status == napi_ok);
+    }
+
+    status = napi_set_named_property(env, result, "buckets", buckets);
+    assert(status == napi_ok);
+
+    return result;
+}
+
+
+
+
+napi_value pcan_CAN_TransmitStop(napi_env env, napi_callback_info info)
+{
+    napi_status status = napi_generic_failure;
+
+    // Retrieve callback info and arguments list
+    size_t argc = CAN_TRANSMITSTOP_ARGC;
+    napi_value argv[CAN_TRANSMITSTOP_ARGC];
+
+    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
+    assert(status == napi_ok);
+
+    if (argc != CAN_TRANSMITSTOP_ARGC)
+    {
+        napi_throw_type_error(env, 0, "Incorrect number of arguments.");
+        return 0;
+    }
+
+    // Retrieve arguments
+    // argv[0] Channel
+    uint32_t pcanChannel;
+    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
+    assert(status == napi_ok);
+
+    pcanTransmit_t **slot = pcanTransmitFind(pcanChannel);
+    if (slot == 0)
+    {
+        napi_throw_error(env, 0, "Transmit queue is not started on this channel.");
+        return 0;
+    }
+
+    // Once the writer thread has exited, and the receive path lets go of the
+    // queue, the callback can no longer be called
+    napi_threadsafe_function callback = (napi_threadsafe_function)(*slot)->notifyContext;
+    pcanTransmitStats_t stats = { 0 };
+
+    pcanReceive_t *receive = pcanReceiveFind(pcanChannel);
+    if ((receive != 0) && (receive->transmit == *slot))
+    {
+        pcanReceiveAttachTransmit(receive, 0);
+    }
+
+    pcanTransmitStop(*slot, &stats);
+    *slot = 0;
+
+    status = napi_release_threadsafe_function(callback, napi_tsfn_release);
+    assert(status == napi_ok);
+
+#ifdef PCAN_DEBUG
+    printf("pcan_CAN_TransmitStop: %llu sent, %llu discarded\n",
+           (unsigned long long)stats.sent, (unsigned long long)stats.discarded);
+#endif
+
+    return pcanTransmitStatsValue(env, &stats);
+}
+
+
+
+
+napi_value pcan_CAN_CyclicAdd(napi_env env, napi_callback_info info)
+{
+    napi_status status = napi_generic_failure;
+
+    // Retrieve callback info and arguments list
+    size_t argc = CAN_CYCLICADD_ARGC;
+    napi_value argv[CAN_CYCLICADD_ARGC];
+
+    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
+    assert(status == napi_ok);
+
+    if (argc != CAN_CYCLICADD_ARGC)
+    {
+        napi_throw_type_error(env, 0, "Incorrect number of arguments.");
+        return 0;
+    }
+
+    // Retrieve arguments
+    // argv[0] Channel
+    uint32_t pcanChannel;
+    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
+    assert(status == napi_ok);
+
+    // argv[1] FrameBuffer
+    pcanFrame_t frame;
+    if (pcanFrameArg(env, argv[1], &frame, "pcan_CAN_CyclicAdd") != 0)
+    {
+        return 0;
+    }
+
+    // argv[2] PeriodUs
+    double periodUs = 0;
+    status = napi_get_value_double(env, argv[2], &periodUs);
+    if ((status != napi_ok) || !(periodUs >= 1))
+    {
+        napi_throw_type_error(env, 0, "Argument 2 (PeriodUs) is not a positive number.");
+        return 0;
+    }
+
+    // argv[3] Options; all properties are optional
+    double count = 0;
+    double phase = 0;
+    napiGetOptionalDouble(env, argv[3], "count", &count);
+    napiGetOptionalDouble(env, argv[3], "phase", &phase);
+
+    pcanChannelContext_t *channelContext = pcanChannelContextFind(pcanChannel, 1);
+    if (channelContext == 0)
+    {
+        napi_throw_error(env, 0, "Too many channels have a cyclic scheduler.");
+        return 0;
+    }
+    pcanCyclic_t **slot = &(channelContext->cyclic);
+
+    // Start the scheduler thread with the channel's first message
+    if (*slot == 0)
+    {
+        const char *error = 0;
+        *slot = pcanCyclicStart(pcanChannel, &error);
+
+#ifdef PCAN_DEBUG
+        printf("pcan_CAN_CyclicAdd: 0x%02X (%s)\n", pcanChannel, (*slot != 0) ? "OK" : error);
+#endif
+
+        if (*slot == 0)
+        {
+            napi_throw_error(env, 0, error);
+            return 0;
+        }
+    }
+
+    uint32_t handle = pcanCyclicAdd(*slot, &frame, (uint64_t)periodUs,
+                                    (count > 0) ? (uint32_t)count : 0,
+                                    (phase > 0) ? (uint64_t)phase : 0);
+    if (handle == 0)
+    {
+        napi_throw_error(env, 0, "Too many cyclic messages on this channel.");
+        return 0;
+    }
+
+    napi_value result;
+    status = napi_create_uint32(env, handle, &result);
+    assert(status == napi_ok);
+
+    return result;
+}
+
+
+
+
+napi_value pcan_CAN_CyclicUpdate(napi_env env, napi_callback_info info)
+{
+    napi_status status = napi_generic_failure;
+
+    // Retrieve callback info and arguments list
+    size_t argc = CAN_CYCLICUPDATE_ARGC;
+    napi_value argv[CAN_CYCLICUPDATE_ARGC];
+
+    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
+    assert(status == napi_ok);
+
+    if (argc != CAN_CYCLICUPDATE_ARGC)
+    {
+        napi_throw_type_error(env, 0, "Incorrect number of arguments.");
+        return 0;
+    }
+
+    // Retrieve arguments
+    // argv[0] Channel
+    uint32_t pcanChannel;
+    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
+    assert(status == napi_ok);
+
+    // argv[1] Handle
+    uint32_t handle;
+    status = napi_get_value_uint32(env, argv[1], &handle);
+    assert(status == napi_ok);
+
+    // argv[2] FrameBuffer
+    pcanFrame_t frame;
+    if (pcanFrameArg(env, argv[2], &frame, "pcan_CAN_CyclicUpdate") != 0)
+    {
+        return 0;
+    }
+
+    pcanCyclic_t **slot = pcanCyclicFind(pcanChannel);
+    if ((slot == 0) || (pcanCyclicUpdate(*slot, handle, &frame) != 0))
+    {
+        napi_throw_error(env, 0, "No such cyclic message on this channel.");
+        return 0;
+    }
+
+    napi_value result;
+    status = napi_get_undefined(env, &result);
+    assert(status == napi_ok);
+
+    return result;
+}
+
+
+
+
+napi_value pcan_CAN_CyclicRemove(napi_env env, napi_callback_info info)
+{
+    napi_status status = napi_generic_failure;
+
+    // Retrieve callback info and arguments list
+    size_t argc = CAN_CYCLICREMOVE_ARGC;
+    napi_value argv[CAN_CYCLICREMOVE_ARGC];
+
+    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
+    assert(status == napi_ok);
+
+    if (argc != CAN_CYCLICREMOVE_ARGC)
+    {
+        napi_throw_type_error(env, 0, "Incorrect number of arguments.");
+        return 0;
+    }
+
+    // Retrieve arguments
+    // argv[0] Channel
+    uint32_t pcanChannel;
+    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
+    assert(status == napi_ok);
+
+    // argv[1] Handle
+    uint32_t handle;
+    status = napi_get_value_uint32(env, argv[1], &handle);
+    assert(status == napi_ok);
+
+    pcanCyclicStats_t stats = { 0 };
+    pcanCyclic_t **slot = pcanCyclicFind(pcanChannel);
+    if ((slot == 0) || (pcanCyclicRemove(*slot, handle, &stats) != 0))
+    {
+        napi_throw_error(env, 0, "No such cyclic message on this channel.");
+        return 0;
+    }
+
+    return pcanCyclicStatsValue(env, &stats);
+}
+
+
+
+
+napi_value pcan_CAN_CyclicStats(napi_env env, napi_callback_info info)
+{
+    napi_status status = napi_generic_failure;
+
+    // Retrieve callback info and arguments list
+    size_t argc = CAN_CYCLICSTATS_ARGC;
+    napi_value argv[CAN_CYCLICSTATS_ARGC];
+
+    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
+    assert(status == napi_ok);
+
+    if (argc != CAN_CYCLICSTATS_ARGC)
+    {
+        napi_throw_type_error(env, 0, "Incorrect number of arguments.");
+        return 0;
+    }
+
+    // Retrieve arguments
+    // argv[0] Channel
+    uint32_t pcanChannel;
+    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
+    assert(status == napi_ok);
+
+    // argv[1] Handle
+    uint32_t handle;
+    status = napi_get_value_uint32(env, argv[1], &handle);
+    assert(status == napi_ok);
+
+    pcanCyclicStats_t stats = { 0 };
+    pcanCyclic_t **slot = pcanCyclicFind(pcanChannel);
+    if ((slot == 0) || (pcanCyclicGetStats(*slot, handle, &stats) != 0))
+    {
+        napi_throw_error(env, 0, "No such cyclic message on this channel.");
+        return 0;
+    }
+
+    return pcanCyclicStatsValue(env, &stats);
+}
+
+
+
+
+napi_value pcan_CAN_CyclicStop(napi_env env, napi_callback_info info)
+{
+    napi_status status = napi_generic_failure;
+
+    // Retrieve callback info and arguments list
+    size_t argc = CAN_CYCLICSTOP_ARGC;
+    napi_value argv[CAN_CYCLICSTOP_ARGC];
+
+    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
+    assert(status == napi_ok);
+
+    if (argc != CAN_CYCLICSTOP_ARGC)
+    {
+        napi_throw_type_error(env, 0, "Incorrect number of arguments.");
+        return 0;
+    }
+
+    // Retrieve arguments
+    // argv[0] Channel
+    uint32_t pcanChannel;
+    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
+    assert(status == napi_ok);
+
+    pcanCyclic_t **slot = pcanCyclicFind(pcanChannel);
+    if (slot != 0)
+    {
+        pcanCyclicStop(*slot);
+        *slot = 0;
+    }
+
+#ifdef PCAN_DEBUG
+    printf("pcan_CAN_CyclicStop: 0x%02X (%s)\n", pcanChannel, (slot != 0) ? "stopped" : "not started");
+#endif
+
+    napi_value result;
+    status = napi_get_undefined(env, &result);
+    assert(status == napi_ok);
+
+    return result;
+}
+
+
+
+
+napi_value pcan_CAN_TimedStart(napi_env env, napi_callback_info info)
+{
+    napi_status status = napi_generic_failure;
+
+    // Retrieve callback info and arguments list
+    size_t argc = CAN_TIMEDSTART_ARGC;
+    napi_value argv[CAN_TIMEDSTART_ARGC];
+
+    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
+    assert(status == napi_ok);
+
+    if (argc != CAN_TIMEDSTART_ARGC)
+    {
+        napi_throw_type_error(env, 0, "Incorrect number of arguments.");
+        return 0;
+    }
+
+    // Retrieve arguments
+    // argv[0] Channel
+    uint32_t pcanChannel;
+    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
+    assert(status == napi_ok);
+
+    // argv[1] Callback
+    napi_valuetype callbackType;
+    status = napi_typeof(env, argv[1], &callbackType);
+    assert(status == napi_ok);
+
+    if (callbackType != napi_function)
+    {
+        napi_throw_type_error(env, 0, "Argument 1 (Callback) is not a function.");
+        return 0;
+    }
+
+    if (pcanTimedFind(pcanChannel) != 0)
+    {
+        napi_throw_error(env, 0, "Timed transmission is already started on this channel.");
+        return 0;
+    }
+
+    pcanChannelContext_t *channelContext = pcanChannelContextFind(pcanChannel, 1);
+    if (channelContext == 0)
+    {
+        napi_throw_error(env, 0, "Too many channels have timed transmission.");
+        return 0;
+    }
+    pcanTimed_t **slot = &(channelContext->timed);
+
+    // Create thread-safe function, called when results are ready
+    napi_value asyncResourceName;
+    status = napi_create_string_utf8(env, "pcanTimedCallback",
+                                     NAPI_AUTO_LENGTH, &asyncResourceName);
+    assert(status == napi_ok);
+
+    napi_threadsafe_function callback;
+    status = napi_create_threadsafe_function(env,
+                                             argv[1], // func
+                                             0, // async_resource
+                                             asyncResourceName,
+                                             0, // max_queue_size
+                                             1, // initial_thread_count
+                                             0, // thread_finalize_data
+                                             0, // thread_finalize_cb
+                                             0, // context
+                                             0, // call_js_cb
+                                             &callback); // result
+    assert(status == napi_ok);
+
+    // Start the timing thread, and let it see received frames for triggers
+    const char *error = 0;
+    *slot = pcanTimedStart(pcanChannel, pcanTimedNotify, callback, &error);
+
+#ifdef PCAN_DEBUG
+    printf("pcan_CAN_TimedStart: 0x%02X (%s)\n", pcanChannel, (*slot != 0) ? "OK" : error);
+#endif
+
+    if (*slot == 0)
+    {
+        status = napi_release_threadsafe_function(callback, napi_tsfn_abort);
+        assert(status == napi_ok);
+
+        napi_throw_error(env, 0, error);
+        return 0;
+    }
+
+    pcanReceive_t *receive = pcanReceiveFind(pcanChannel);
+    if (receive != 0)
+    {
+        pcanReceiveAttachTimed(receive, *slot);
+    }
+
+    napi_value result;
+    status = napi_get_undefined(env, &result);
+    assert(status == napi_ok);
+
+    return result;
+}
+
+
+
+
+napi_value pcan_CAN_TimedAt(napi_env env, napi_callback_info info)
+{
+    napi_status status = napi_generic_failure;
+
+    // Retrieve callback info and arguments list
+    size_t argc = CAN_TIMEDAT_ARGC;
+    napi_value argv[CAN_TIMEDAT_ARGC];
+
+    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
+    assert(status == napi_ok);
+
+    if (argc != CAN_TIMEDAT_ARGC)
+    {
+        napi_throw_type_error(env, 0, "Incorrect number of arguments.");
+        return 0;
+    }
+
+    // Retrieve arguments
+    // argv[0] Channel
+    uint32_t pcanChannel;
+    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
+    assert(status == napi_ok);
+
+    // argv[1] FrameBuffer
+    pcanFrame_t frame;
+    if (pcanFrameArg(env, argv[1], &frame, "pcan_CAN_TimedAt") != 0)
+    {
+        return 0;
+    }
+
+    // argv[2] HostTimeUs
+    double hostTimeUs = 0;
+    status = napi_get_value_double(env, argv[2], &hostTimeUs);
+    if ((status != napi_ok) || !(hostTimeUs >= 0))
+    {
+        napi_throw_type_error(env, 0, "Argument 2 (HostTimeUs) is not a time.");
+        return 0;
+    }
+
+    pcanTimed_t **slot = pcanTimedFind(pcanChannel);
+    if (slot == 0)
+    {
+        napi_throw_error(env, 0, "Timed transmission is not started on this channel.");
+        return 0;
+    }
+
+    uint32_t handle = pcanTimedAt(*slot, &frame, (uint64_t)hostTimeUs);
+    if (handle == 0)
+    {
+        napi_throw_error(env, 0, "Too many timed messages on this channel.");
+        return 0;
+    }
+
+    napi_value result;
+    status = napi_create_uint32(env, handle, &result);
+    assert(status == napi_ok);
+
+    return result;
+}
+
+
+
+
+napi_value pcan_CAN_TimedAfter(napi_env env, napi_callback_info info)
+{
+    napi_status status = napi_generic_failure;
+
+    // Retrieve callback info and arguments list
+    size_t argc = CAN_TIMEDAFTER_ARGC;
+    napi_value argv[CAN_TIMEDAFTER_ARGC];
+
+    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
+    assert(status == napi_ok);
+
+    if (argc != CAN_TIMEDAFTER_ARGC)
+    {
+        napi_throw_type_error(env, 0, "Incorrect number of arguments.");
+        return 0;
+    }
+
+    // Retrieve arguments
+    // argv[0] Channel
+    uint32_t pcanChannel;
+    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
+    assert(status == napi_ok);
+
+    // argv[1] FrameBuffer
+    pcanFrame_t frame;
+    if (pcanFrameArg(env, argv[1], &frame, "pcan_CAN_TimedAfter") != 0)
+    {
+        return 0;
+    }
+
+    // argv[2] Trigger: id is required, mask and ext are optional
+    double id = -1;
+    double mask = -1;
+    bool ext = false;
+    napiGetOptionalDouble(env, argv[2], "id", &id);
+    napiGetOptionalDouble(env, argv[2], "mask", &mask);
+    napiGetOptionalBool(env, argv[2], "ext", &ext);
+    if (!(id >= 0))
+    {
+        napi_throw_type_error(env, 0, "Argument 2 (Trigger) has no id.");
+        return 0;
+    }
+    if (!(mask >= 0))
+    {
+        mask = ext ? 0x1FFFFFFF : 0x7FF;
+    }
+
+    // argv[3] DelayUs
+    double delayUs = 0;
+    status = napi_get_value_double(env, argv[3], &delayUs);
+    if ((status != napi_ok) || !(delayUs >= 0))
+    {
+        napi_throw_type_error(env, 0, "Argument 3 (DelayUs) is not a positive number.");
+        return 0;
+    }
+
+    pcanTimed_t **slot = pcanTimedFind(pcanChannel);
+    if (slot == 0)
+    {
+        napi_throw_error(env, 0, "Timed transmission is not started on this channel.");
+        return 0;
+    }
+
+    pcanReceive_t *receive = pcanReceiveFind(pcanChannel);
+    if ((receive == 0) || (receive->timed != *slot))
+    {
+        napi_throw_error(env, 0, "Receive event is not enabled on this channel.");
+        return 0;
+    }
+
+    uint32_t handle = pcanTimedAfter(*slot, &frame, (uint32_t)id, (uint32_t)mask, ext ? 1 : 0,
+                                     (uint64_t)delayUs);
+    if (handle == 0)
+    {
+        napi_throw_error(env, 0, "Too many timed messages on this channel.");
+        return 0;
+    }
+
+    napi_value result;
+    status = napi_create_uint32(env, handle, &result);
+    assert(status == napi_ok);
+
+    return result;
+}
+
+
+
+
+napi_value pcan_CAN_TimedCancel(napi_env env, napi_callback_info info)
+{
+    napi_status status = napi_generic_failure;
+
+    // Retrieve callback info and arguments list
+    size_t argc = CAN_TIMEDCANCEL_ARGC;
+    napi_value argv[CAN_TIMEDCANCEL_ARGC];
+
+    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
+    assert(status == napi_ok);
+
+    if (argc != CAN_TIMEDCANCEL_ARGC)
+    {
+        napi_throw_type_error(env, 0, "Incorrect number of arguments.");
+        return 0;
+    }
+
+    // Retrieve arguments
+    // argv[0] Channel
+    uint32_t pcanChannel;
+    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
+    assert(status == napi_ok);
+
+    // argv[1] Handle
+    uint32_t handle;
+    status = napi_get_value_uint32(env, argv[1], &handle);
+    assert(status == napi_ok);
+
+    pcanTimed_t **slot = pcanTimedFind(pcanChannel);
+    if (slot == 0)
+    {
+        napi_throw_error(env, 0, "Timed transmission is not started on this channel.");
+        return 0;
+    }
+
+    napi_value result;
+    status = napi_get_boolean(env, pcanTimedCancel(*slot, handle) == 0, &result);
+    assert(status == napi_ok);
+
+    return result;
+}
+
+
+
+
+napi_value pcan_CAN_TimedResults(napi_env env, napi_callback_info info)
+{
+    napi_status status = napi_generic_failure;
+
+    // Retrieve callback info and arguments list
+    size_t argc = CAN_TIMEDRESULTS_ARGC;
+    napi_value argv[CAN_TIMEDRESULTS_ARGC];
+
+    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
+    assert(status == napi_ok);
+
+    if (argc != CAN_TIMEDRESULTS_ARGC)
+    {
+        napi_throw_type_error(env, 0, "Incorrect number of arguments.");
+        return 0;
+    }
+
+    // Retrieve arguments
+    // argv[0] Channel
+    uint32_t pcanChannel;
+    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
+    assert(status == napi_ok);
+
+    pcanTimed_t **slot = pcanTimedFind(pcanChannel);
+    if (slot == 0)
+    {
+        napi_throw_error(env, 0, "Timed transmission is not started on this channel.");
+        return 0;
+    }
+
+    // The ring never holds more than this, so one call empties it
+    pcanTimedResult_t results[PCAN_TIMED_MAX * 2];
+    uint32_t count = pcanTimedResults(*slot, results, PCAN_TIMED_MAX * 2);
+
+    napi_value resultBuffer;
+    void *resultBufferData;
+    status = napi_create_buffer_copy(env, count * PCAN_TIMED_RESULT_SIZE, results,
+                                     &resultBufferData, &resultBuffer);
+    assert(status == napi_ok);
+
+    return resultBuffer;
+}
+
+
+
+
+napi_value pcan_CAN_TimedStop(napi_env env, napi_callback_info info)
+{
+    napi_status status = napi_generic_failure;
+
+    // Retrieve callback info and arguments list
+    size_t argc = CAN_TIMEDSTOP_ARGC;
+    napi_value argv[CAN_TIMEDSTOP_ARGC];
+
+    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
+    assert(status == napi_ok);
+
+    if (argc != CAN_TIMEDSTOP_ARGC)
+    {
+        napi_throw_type_error(env, 0, "Incorrect number of arguments.");
+        return 0;
+    }
+
+    // Retrieve arguments
+    // argv[0] Channel
+    uint32_t pcanChannel;
+    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
+    assert(status == napi_ok);
+
+    pcanTimed_t **slot = pcanTimedFind(pcanChannel);
+    if (slot != 0)
+    {
+        // Once detached, the receive worker no longer checks its triggers,
+        // and once the timing thread has exited, it can no longer call the
+        // callback
+        napi_threadsafe_function callback = (napi_threadsafe_function)(*slot)->notifyContext;
+
+        pcanReceive_t *receive = pcanReceiveFind(pcanChannel);
+        if ((receive != 0) && (receive->timed == *slot))
+        {
+            pcanReceiveAttachTimed(receive, 0);
+        }
+        pcanTimedStop(*slot);
+        *slot = 0;
+
+        status = napi_release_threadsafe_function(callback, napi_tsfn_release);
+        assert(status == napi_ok);
+    }
+
+#ifdef PCAN_DEBUG
+    printf("pcan_CAN_TimedStop: 0x%02X (%s)\n", pcanChannel, (slot != 0) ? "stopped" : "not started");
+#endif
+
+    napi_value result;
+    status = napi_get_undefined(env, &result);
+    assert(status == napi_ok);
+
+    return result;
+}
+
+
+
+
+napi_value pcan_CAN_RequestStart(napi_env env, napi_callback_info info)
+{
+    napi_status status = napi_generic_failure;
+
+    // Retrieve callback info and arguments list
+    size_t argc = CAN_REQUESTSTART_ARGC;
+    napi_value argv[CAN_REQUESTSTART_ARGC];
+
+    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
+    assert(status == napi_ok);
+
+    if (argc != CAN_REQUESTSTART_ARGC)
+    {
+        napi_throw_type_error(env, 0, "Incorrect number of arguments.");
+        return 0;
+    }
+
+    // Retrieve arguments
+    // argv[0] Channel
+    uint32_t pcanChannel;
+    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
+    assert(status == napi_ok);
+
+    // argv[1] Callback
+    napi_valuetype callbackType;
+    status = napi_typeof(env, argv[1], &callbackType);
+    assert(status == napi_ok);
+
+    if (callbackType != napi_function)
+    {
+        napi_throw_type_error(env, 0, "Argument 1 (Callback) is not a function.");
+        return 0;
+    }
+
+    if (pcanRequestFind(pcanChannel) != 0)
+    {
+        napi_throw_error(env, 0, "Requests are already started on this channel.");
+        return 0;
+    }
+
+    pcanChannelContext_t *channelContext = pcanChannelContextFind(pcanChannel, 1);
+    if (channelContext == 0)
+    {
+        napi_throw_error(env, 0, "Too many channels have requests.");
+        return 0;
+    }
+    pcanRequest_t **slot = &(channelContext->request);
+
+    // Create thread-safe function, called when replies are ready
+    napi_value asyncResourceName;
+    status = napi_create_string_utf8(env, "pcanRequestCallback",
+                                     NAPI_AUTO_LENGTH, &asyncResourceName);
+    assert(status == napi_ok);
+
+    napi_threadsafe_function callback;
+    status = napi_create_threadsafe_function(env,
+                                             argv[1], // func
+                                             0, // async_resource
+                                             asyncResourceName,
+                                             0, // max_queue_size
+                                             1, // initial_thread_count
+                                             0, // thread_finalize_data
+                                             0, // thread_finalize_cb
+                                             0, // context
+                                             0, // call_js_cb
+                                             &callback); // result
+    assert(status == napi_ok);
+
+    // Start matching, and let it see received frames for replies
+    const char *error = 0;
+    *slot = pcanRequestStart(pcanChannel, pcanRequestNotify, callback, &error);
+
+#ifdef PCAN_DEBUG
+    printf("pcan_CAN_RequestStart: 0x%02X (%s)\n", pcanChannel, (*slot != 0) ? "OK" : error);
+#endif
+
+    if (*slot == 0)
+    {
+        status = napi_release_threadsafe_function(callback, napi_tsfn_abort);
+        assert(status == napi_ok);
+
+        napi_throw_error(env, 0, error);
+        return 0;
+    }
+
+    pcanReceive_t *receive = pcanReceiveFind(pcanChannel);
+    if (receive != 0)
+    {
+        pcanReceiveAttachRequest(receive, *slot);
+    }
+
+    napi_value result;
+    status = napi_get_undefined(env, &result);
+    assert(status == napi_ok);
+
+    return result;
+}
+
+
+
+
+napi_value pcan_CAN_RequestSend(napi_env env, napi_callback_info info)
+{
+    napi_status status = napi_generic_failure;
+
+    // Retrieve callback info and arguments list
+    size_t argc = CAN_REQUESTSEND_ARGC;
+    napi_value argv[CAN_REQUESTSEND_ARGC];
+
+    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
+    assert(status == napi_ok);
+
+    if (argc != CAN_REQUESTSEND_ARGC)
     {
         napi_throw_type_error(env, 0, "Incorrect number of arguments.");
         return 0;
@@ -428,115 +4674,388 @@ napi_value pcan_CAN_Read(napi_env env, napi_callback_info info)
     status = napi_get_value_uint32(env, argv[0], &pcanChannel);
     assert(status == napi_ok);
 
-    // Read from CAN bus
-    TPCANMsg msg = { 0 };
-    TPCANTimestamp timestamp = { 0 };
-    TPCANStatus pcanStatus = PCAN_ERROR_UNKNOWN;
-    pcanStatus = CAN_Read(pcanChannel, &msg, &timestamp);
-    
-    // Print the result to console
-#ifdef PCAN_DEBUG
-    printf("pcan_CAN_Read: 0x%02X (%s)\n", pcanStatus, pcanStatusLookup(pcanStatus));
-    pcanDumpMsg(&msg);
-    pcanDumpTimestamp(&timestamp);
-#endif
+    // argv[1] FrameBuffer
+    pcanFrame_t frame;
+    if (pcanFrameArg(env, argv[1], &frame, "pcan_CAN_RequestSend") != 0)
+    {
+        return 0;
+    }
 
-    // Throw error, if any
-    if (pcanStatus != PCAN_ERROR_OK)
+    // argv[2] Match: id is required, mask, ext and prefix are optional
+    double id = -1;
+    double mask = -1;
+    bool ext = false;
+    napiGetOptionalDouble(env, argv[2], "id", &id);
+    napiGetOptionalDouble(env, argv[2], "mask", &mask);
+    napiGetOptionalBool(env, argv[2], "ext", &ext);
+    if (!(id >= 0))
     {
-        napi_throw_error(env, pcanStatusLookup(pcanStatus),
-                         "pcan_CAN_Read");
+        napi_throw_type_error(env, 0, "Argument 2 (Match) has no id.");
         return 0;
     }
+    if (!(mask >= 0))
+    {
+        mask = ext ? 0x1FFFFFFF : 0x7FF;
+    }
 
-    // Create parent objects for read data
-    napi_value pcanMessageBuffer;
-    status = napi_create_object(env, &pcanMessageBuffer);
+    uint8_t *prefix = 0;
+    size_t prefixLength = 0;
+    bool hasPrefix = false;
+    status = napi_has_named_property(env, argv[2], "prefix", &hasPrefix);
     assert(status == napi_ok);
 
-    napi_value pcanTimestampBuffer;
-    status = napi_create_object(env, &pcanTimestampBuffer);
+    if (hasPrefix)
+    {
+        napi_value prefixValue;
+        status = napi_get_named_property(env, argv[2], "prefix", &prefixValue);
+        assert(status == napi_ok);
+
+        napi_valuetype prefixType;
+        status = napi_typeof(env, prefixValue, &prefixType);
+        assert(status == napi_ok);
+
+        if (prefixType != napi_undefined)
+        {
+            status = napi_get_buffer_info(env, prefixValue, (void**)&prefix, &prefixLength);
+            if ((status != napi_ok) || (prefixLength > PCAN_FRAME_DATA_MAX))
+            {
+                napi_throw_type_error(env, 0, "Argument 2 (Match) prefix is not a Buffer of up to 8 bytes.");
+                return 0;
+            }
+        }
+    }
+
+    pcanRequest_t **slot = pcanRequestFind(pcanChannel);
+    if (slot == 0)
+    {
+        napi_throw_error(env, 0, "Requests are not started on this channel.");
+        return 0;
+    }
+
+    pcanReceive_t *receive = pcanReceiveFind(pcanChannel);
+    if ((receive == 0) || (receive->request != *slot))
+    {
+        napi_throw_error(env, 0, "Receive event is not enabled on this channel.");
+        return 0;
+    }
+
+    TPCANStatus pcanStatus = PCAN_ERROR_OK;
+    uint32_t handle = pcanRequestSend(*slot, &frame, (uint32_t)id, (uint32_t)mask, ext ? 1 : 0,
+                                      prefix, (uint8_t)prefixLength, &pcanStatus);
+    if (pcanStatus != PCAN_ERROR_OK)
+    {
+        napi_throw_error(env, pcanStatusLookup(pcanStatus), "Unable to write the request.");
+        return 0;
+    }
+    if (handle == 0)
+    {
+        napi_throw_error(env, 0, "Too many requests on this channel.");
+        return 0;
+    }
+
+    napi_value result;
+    status = napi_create_uint32(env, handle, &result);
     assert(status == napi_ok);
 
-    // Copy read values into objects passed from N-API
-    // MessageBuffer
-    napi_value pcanMessageBufferID; // uint32
-    napi_value pcanMessageBufferMsgtype; // uint32
-    napi_value pcanMessageBufferLen; // uint32
-    napi_value pcanMessageBufferData; // buffer
-    void* pcanMessageBufferDataResult;
-    
-    status = napi_create_uint32(env, msg.ID, &pcanMessageBufferID);
+    return result;
+}
+
+
+
+
+napi_value pcan_CAN_RequestCancel(napi_env env, napi_callback_info info)
+{
+    napi_status status = napi_generic_failure;
+
+    // Retrieve callback info and arguments list
+    size_t argc = CAN_REQUESTCANCEL_ARGC;
+    napi_value argv[CAN_REQUESTCANCEL_ARGC];
+
+    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
     assert(status == napi_ok);
-    status = napi_set_named_property(env, pcanMessageBuffer, "id", pcanMessageBufferID);
+
+    if (argc != CAN_REQUESTCANCEL_ARGC)
+    {
+        napi_throw_type_error(env, 0, "Incorrect number of arguments.");
+        return 0;
+    }
+
+    // Retrieve arguments
+    // argv[0] Channel
+    uint32_t pcanChannel;
+    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
     assert(status == napi_ok);
-    
-    status = napi_create_uint32(env, msg.MSGTYPE, &pcanMessageBufferMsgtype);
+
+    // argv[1] Handle
+    uint32_t handle;
+    status = napi_get_value_uint32(env, argv[1], &handle);
     assert(status == napi_ok);
-    status = napi_set_named_property(env, pcanMessageBuffer, "msgtype", pcanMessageBufferMsgtype);
+
+    pcanRequest_t **slot = pcanRequestFind(pcanChannel);
+    if (slot == 0)
+    {
+        napi_throw_error(env, 0, "Requests are not started on this channel.");
+        return 0;
+    }
+
+    napi_value result;
+    status = napi_get_boolean(env, pcanRequestCancel(*slot, handle) == 0, &result);
     assert(status == napi_ok);
-    
-    status = napi_create_uint32(env, msg.LEN, &pcanMessageBufferLen);
+
+    return result;
+}
+
+
+
+
+napi_value pcan_CAN_RequestResults(napi_env env, napi_callback_info info)
+{
+    napi_status status = napi_generic_failure;
+
+    // Retrieve callback info and arguments list
+    size_t argc = CAN_REQUESTRESULTS_ARGC;
+    napi_value argv[CAN_REQUESTRESULTS_ARGC];
+
+    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
     assert(status == napi_ok);
-    status = napi_set_named_property(env, pcanMessageBuffer, "len", pcanMessageBufferLen);
+
+    if (argc != CAN_REQUESTRESULTS_ARGC)
+    {
+        napi_throw_type_error(env, 0, "Incorrect number of arguments.");
+        return 0;
+    }
+
+    // Retrieve arguments
+    // argv[0] Channel
+    uint32_t pcanChannel;
+    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
     assert(status == napi_ok);
 
-    status = napi_create_buffer_copy(env, msg.LEN, (void*)&(msg.DATA),
-                                     (void*)&pcanMessageBufferDataResult,
-                                     &pcanMessageBufferData);
+    pcanRequest_t **slot = pcanRequestFind(pcanChannel);
+    if (slot == 0)
+    {
+        napi_throw_error(env, 0, "Requests are not started on this channel.");
+        return 0;
+    }
+
+    // The ring never holds more than this, so one call empties it
+    pcanRequestResult_t results[PCAN_REQUEST_MAX];
+    uint32_t count = pcanRequestResults(*slot, results, PCAN_REQUEST_MAX);
+
+    napi_value resultBuffer;
+    void *resultBufferData;
+    status = napi_create_buffer_copy(env, count * PCAN_REQUEST_RESULT_SIZE, results,
+                                     &resultBufferData, &resultBuffer);
     assert(status == napi_ok);
-    status = napi_set_named_property(env, pcanMessageBuffer, "data", pcanMessageBufferData);
+
+    return resultBuffer;
+}
+
+
+
+
+napi_value pcan_CAN_RequestStop(napi_env env, napi_callback_info info)
+{
+    napi_status status = napi_generic_failure;
+
+    // Retrieve callback info and arguments list
+    size_t argc = CAN_REQUESTSTOP_ARGC;
+    napi_value argv[CAN_REQUESTSTOP_ARGC];
+
+    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
     assert(status == napi_ok);
 
-    // TimestampBuffer
-    napi_value pcanTimestampBufferMillis; // uint32
-    napi_value pcanTimestampBufferMillisOverflow; // uint32
-    napi_value pcanTimestampBufferMicros; // uint32
+    if (argc != CAN_REQUESTSTOP_ARGC)
+    {
+        napi_throw_type_error(env, 0, "Incorrect number of arguments.");
+        return 0;
+    }
 
-    status = napi_create_uint32(env, timestamp.millis, &pcanTimestampBufferMillis);
+    // Retrieve arguments
+    // argv[0] Channel
+    uint32_t pcanChannel;
+    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
     assert(status == napi_ok);
-    status = napi_set_named_property(env, pcanTimestampBuffer, "millis",
-                                     pcanTimestampBufferMillis);
 
-    status = napi_create_uint32(env, timestamp.millis_overflow,
-                                &pcanTimestampBufferMillisOverflow);
+    pcanRequest_t **slot = pcanRequestFind(pcanChannel);
+    if (slot != 0)
+    {
+        // Once detached, the receive worker no longer matches replies, and
+        // can no longer call the callback
+        napi_threadsafe_function callback = (napi_threadsafe_function)(*slot)->notifyContext;
+
+        pcanReceive_t *receive = pcanReceiveFind(pcanChannel);
+        if ((receive != 0) && (receive->request == *slot))
+        {
+            pcanReceiveAttachRequest(receive, 0);
+        }
+        pcanRequestStop(*slot);
+        *slot = 0;
+
+        status = napi_release_threadsafe_function(callback, napi_tsfn_release);
+        assert(status == napi_ok);
+    }
+
+#ifdef PCAN_DEBUG
+    printf("pcan_CAN_RequestStop: 0x%02X (%s)\n", pcanChannel, (slot != 0) ? "stopped" : "not started");
+#endif
+
+    napi_value result;
+    status = napi_get_undefined(env, &result);
     assert(status == napi_ok);
-    status = napi_set_named_property(env, pcanTimestampBuffer, "millis_overflow",
-                                     pcanTimestampBufferMillisOverflow);
 
-    status = napi_create_uint32(env, timestamp.micros, &pcanTimestampBufferMicros);
+    return result;
+}
+
+
+
+
+napi_value pcan_CAN_HostTime(napi_env env, napi_callback_info info)
+{
+    napi_status status = napi_generic_failure;
+
+    napi_value result;
+    status = napi_create_double(env, (double)pcanTimeMicros(), &result);
     assert(status == napi_ok);
-    status = napi_set_named_property(env, pcanTimestampBuffer, "micros",
-                                     pcanTimestampBufferMicros);
 
-    // Create a N-API value for the complete read data and return it
-    napi_value pcanReadData;
-    status = napi_create_object(env, &pcanReadData);
+    return result;
+}
+
+
+
+
+napi_value pcan_CAN_StartCapture(napi_env env, napi_callback_info info)
+{
+    napi_status status = napi_generic_failure;
+
+    // Retrieve callback info and arguments list
+    size_t argc = CAN_STARTCAPTURE_ARGC;
+    napi_value argv[CAN_STARTCAPTURE_ARGC];
+
+    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
     assert(status == napi_ok);
 
-    status = napi_set_named_property(env, pcanReadData, "message", pcanMessageBuffer);
+    if (argc != CAN_STARTCAPTURE_ARGC)
+    {
+        napi_throw_type_error(env, 0, "Incorrect number of arguments.");
+        return 0;
+    }
+
+    // Retrieve arguments
+    // argv[0] Channel
+    uint32_t pcanChannel;
+    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
     assert(status == napi_ok);
-    status = napi_set_named_property(env, pcanReadData, "timestamp", pcanTimestampBuffer);
+
+    // argv[1] Path
+    char path[PCAN_CAPTURE_PATH_MAX] = { 0 };
+    size_t pathLength = 0;
+    status = napi_get_value_string_utf8(env, argv[1], path, sizeof(path), &pathLength);
+    if (status != napi_ok)
+    {
+        napi_throw_type_error(env, 0, "Argument 1 (Path) is not a string.");
+        return 0;
+    }
+
+    // argv[2] Options; all properties are optional
+    pcanCaptureOptions_t options = { 0 };
+    double value = 0;
+    bool passthrough = true;
+
+    options.channel = pcanChannel;
+    if (napiGetOptionalDouble(env, argv[2], "bitrate", &value))
+    {
+        options.bitrate = (uint32_t)value;
+    }
+    if (napiGetOptionalDouble(env, argv[2], "bufferSize", &value))
+    {
+        options.bufferSize = (uint32_t)value;
+    }
+    if (napiGetOptionalDouble(env, argv[2], "flushMs", &value))
+    {
+        options.flushUs = (uint64_t)(value * 1000.0);
+    }
+    if (napiGetOptionalDouble(env, argv[2], "rotateBytes", &value))
+    {
+        options.rotateBytes = (uint64_t)value;
+    }
+    if (napiGetOptionalDouble(env, argv[2], "rotateSeconds", &value))
+    {
+        options.rotateUs = (uint64_t)(value * 1000000.0);
+    }
+    napiGetOptionalBool(env, argv[2], "passthrough", &passthrough);
+
+    // compress is a level, or true for the format's default level
+    bool compress = false;
+    if (napiGetOptionalDouble(env, argv[2], "compress", &value))
+    {
+        options.compress = (int)value;
+    }
+    else if (napiGetOptionalBool(env, argv[2], "compress", &compress) && compress)
+    {
+        options.compress = PCAN_MDF4_COMPRESS_DEFAULT;
+    }
+
+    char formatName[16] = "native";
+    napiGetOptionalString(env, argv[2], "format", formatName, sizeof(formatName));
+    options.format = pcanCaptureFindFormat(formatName);
+    if (options.format == 0)
+    {
+        napi_throw_error(env, 0, "Unknown capture format.");
+        return 0;
+    }
+
+    pcanReceive_t *receive = pcanReceiveFind(pcanChannel);
+    if (receive == 0)
+    {
+        napi_throw_error(env, 0, "Receive event is not enabled on this channel.");
+        return 0;
+    }
+
+    if (receive->capture != 0)
+    {
+        napi_throw_error(env, 0, "A capture is already in progress on this channel.");
+        return 0;
+    }
+
+    // Open the file and start the writer thread, then start feeding it
+    const char *error = 0;
+    pcanCapture_t *capture = pcanCaptureStart(path, &options, &error);
+
+#ifdef PCAN_DEBUG
+    printf("pcan_CAN_StartCapture: \"%s\" (%s)\n", path, (capture != 0) ? "OK" : error);
+#endif
+
+    if (capture == 0)
+    {
+        napi_throw_error(env, 0, error);
+        return 0;
+    }
+
+    pcanReceiveAttachCapture(receive, capture, passthrough ? 1 : 0);
+
+    napi_value result;
+    status = napi_get_undefined(env, &result);
     assert(status == napi_ok);
-    
-    return pcanReadData;
+
+    return result;
 }
 
 
 
 
-napi_value pcan_CAN_ReadFD(napi_env env, napi_callback_info info)
+napi_value pcan_CAN_StopCapture(napi_env env, napi_callback_info info)
 {
     napi_status status = napi_generic_failure;
 
-    // Retrieve callback info and argument list
-    size_t argc = CAN_READFD_ARGC;
-    napi_value argv[CAN_READFD_ARGC];
+    // Retrieve callback info and arguments list
+    size_t argc = CAN_STOPCAPTURE_ARGC;
+    napi_value argv[CAN_STOPCAPTURE_ARGC];
 
     status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
     assert(status == napi_ok);
 
-    if (argc != CAN_READFD_ARGC)
+    if (argc != CAN_STOPCAPTURE_ARGC)
     {
         napi_throw_type_error(env, 0, "Incorrect number of arguments.");
         return 0;
@@ -548,102 +5067,46 @@ napi_value pcan_CAN_ReadFD(napi_env env, napi_callback_info info)
     status = napi_get_value_uint32(env, argv[0], &pcanChannel);
     assert(status == napi_ok);
 
-    // Read from CAN bus
-    TPCANMsgFD msg = { 0 };
-    TPCANTimestampFD timestamp = 0;
-    TPCANStatus pcanStatus = PCAN_ERROR_UNKNOWN;
-
-    pcanStatus = CAN_ReadFD(pcanChannel, &msg, &timestamp);
-
-    // Dump results to console
-#ifdef PCAN_DEBUG
-    printf("pcan_CAN_ReadFD: 0x%02X (%s)\n", pcanStatus,
-           pcanStatusLookup(pcanStatus));
-    pcanDumpMsgFD(&msg);
-    pcanDumpTimestampFD(timestamp);
-#endif
+    pcanCapture_t *capture = 0;
+    pcanReceive_t *receive = pcanReceiveFind(pcanChannel);
+    if (receive != 0)
+    {
+        capture = pcanReceiveDetachCapture(receive);
+    }
 
-    // Throw error, if any
-    if (pcanStatus != PCAN_ERROR_OK)
+    if (capture == 0)
     {
-        napi_throw_error(env, pcanStatusLookup(pcanStatus),
-                         "pcan_CAN_ReadFD");
+        napi_throw_error(env, 0, "No capture is in progress on this channel.");
         return 0;
     }
 
-    // Create parent objects for read data
-    napi_value pcanMessageBuffer;
-    status = napi_create_object(env, &pcanMessageBuffer);
-    assert(status == napi_ok);
-
-    napi_value pcanTimestampBuffer;
-    status = napi_create_object(env, &pcanTimestampBuffer);
-    assert(status == napi_ok);
-
-    // Copy read values into objects passed from N-API
-    // argv[1] MessageBuffer
-    napi_value pcanMessageBufferID; // uint32
-    napi_value pcanMessageBufferMsgtype; // uint32
-    napi_value pcanMessageBufferDLC; // uint32
-    napi_value pcanMessageBufferData; // buffer
-    void* pcanMessageBufferDataResult;
-    
-    status = napi_create_uint32(env, msg.ID, &pcanMessageBufferID);
-    assert(status == napi_ok);
-    status = napi_set_named_property(env, pcanMessageBuffer, "id", pcanMessageBufferID);
-    assert(status == napi_ok);
-    
-    status = napi_create_uint32(env, msg.MSGTYPE, &pcanMessageBufferMsgtype);
-    assert(status == napi_ok);
-    status = napi_set_named_property(env, pcanMessageBuffer, "msgtype", pcanMessageBufferMsgtype);
-    assert(status == napi_ok);
-    
-    status = napi_create_uint32(env, msg.DLC, &pcanMessageBufferDLC);
-    assert(status == napi_ok);
-    status = napi_set_named_property(env, pcanMessageBuffer, "dlc", pcanMessageBufferDLC);
-    assert(status == napi_ok);
-
-    status = napi_create_buffer_copy(env, pcanDLCDecode(msg.DLC), (void*)&(msg.DATA), (void*)&pcanMessageBufferDataResult, &pcanMessageBufferData);
-    assert(status == napi_ok);
-    status = napi_set_named_property(env, pcanMessageBuffer, "data", pcanMessageBufferData);
-    assert(status == napi_ok);
-
-    // argv[2] TimestampFD
-    napi_value pcanTimestampFDValue; // uint64
-
-    status = napi_create_uint32(env, timestamp, &pcanTimestampFDValue);
-    assert(status == napi_ok);
-    status = napi_set_named_property(env, pcanTimestampBuffer, "timestamp", pcanTimestampFDValue);
-    assert(status == napi_ok);
+    // Flush everything still buffered and close the file
+    pcanCaptureStats_t stats = { 0 };
+    pcanCaptureStop(capture, &stats);
 
-    // Create an N-API value for the complete read data and return it
-    napi_value pcanReadDataFD;
-    status = napi_create_object(env, &pcanReadDataFD);
-    assert(status == napi_ok);
+#ifdef PCAN_DEBUG
+    printf("pcan_CAN_StopCapture: %llu frames, %llu dropped\n",
+           (unsigned long long)stats.frames, (unsigned long long)stats.dropped);
+#endif
 
-    status = napi_set_named_property(env, pcanReadDataFD, "message", pcanMessageBuffer);
-    assert(status == napi_ok);
-    status = napi_set_named_property(env, pcanReadDataFD, "timestamp", pcanTimestampBuffer);
-    assert(status == napi_ok);
-    
-    return pcanReadDataFD;
+    return pcanCaptureStatsValue(env, &stats);
 }
 
 
 
 
-napi_value pcan_CAN_Write(napi_env env, napi_callback_info info)
+napi_value pcan_CAN_CaptureStats(napi_env env, napi_callback_info info)
 {
     napi_status status = napi_generic_failure;
 
-    // Retrieve callback info and argument list
-    size_t argc = CAN_WRITE_ARGC;
-    napi_value argv[CAN_WRITE_ARGC];
+    // Retrieve callback info and arguments list
+    size_t argc = CAN_CAPTURESTATS_ARGC;
+    napi_value argv[CAN_CAPTURESTATS_ARGC];
 
     status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
     assert(status == napi_ok);
 
-    if (argc != CAN_WRITE_ARGC)
+    if (argc != CAN_CAPTURESTATS_ARGC)
     {
         napi_throw_type_error(env, 0, "Incorrect number of arguments.");
         return 0;
@@ -655,175 +5118,288 @@ napi_value pcan_CAN_Write(napi_env env, napi_callback_info info)
     status = napi_get_value_uint32(env, argv[0], &pcanChannel);
     assert(status == napi_ok);
 
-    // argv[1] MessageBuffer
-    napi_valuetype pcanMessageBufferType;
-    status = napi_typeof(env, argv[1], &pcanMessageBufferType);
-    assert(status == napi_ok);
-
-    if (pcanMessageBufferType != napi_object)
+    // The capture is only attached and detached from this (the main) thread,
+    // so it cannot be stopped while its statistics are copied
+    pcanCaptureStats_t stats = { 0 };
+    pcanReceive_t *receive = pcanReceiveFind(pcanChannel);
+    if ((receive == 0) || (receive->capture == 0))
     {
-        napi_throw_type_error(env, 0, "Argument 1 (MessageBuffer) is not an object.");
+        napi_throw_error(env, 0, "No capture is in progress on this channel.");
         return 0;
     }
 
-    // Copy message contents from N-API object to TPCANMsg struct
-    TPCANMsg msg = { 0 };
+    pcanCaptureGetStats(receive->capture, &stats);
 
-    napi_value pcanMessageBufferID;
-    status = napi_get_named_property(env, argv[1], "id", &pcanMessageBufferID);
-    assert(status == napi_ok);
-    status = napi_get_value_uint32(env, pcanMessageBufferID, &(msg.ID));
-    assert(status == napi_ok);
+    return pcanCaptureStatsValue(env, &stats);
+}
 
-    napi_value pcanMessageBufferMsgtype;
-    status = napi_get_named_property(env, argv[1], "msgtype", &pcanMessageBufferMsgtype);
-    assert(status == napi_ok);
-    status = napi_get_value_uint32(env, pcanMessageBufferMsgtype, (uint32_t*)&(msg.MSGTYPE));
-    assert(status == napi_ok);
 
-    napi_value pcanMessageBufferLen;
-    status = napi_get_named_property(env, argv[1], "len", &pcanMessageBufferLen);
-    assert(status == napi_ok);
-    status = napi_get_value_uint32(env, pcanMessageBufferLen, (uint32_t*)&(msg.LEN));
-    assert(status == napi_ok);
 
-    napi_value pcanMessageBufferData;
-    BYTE *msgTmpData;
-    size_t msgTmpLen = 0;
-    status = napi_get_named_property(env, argv[1], "data", &pcanMessageBufferData);
-    assert(status == napi_ok);
-    status = napi_get_buffer_info(env, pcanMessageBufferData, (void**)&msgTmpData, &msgTmpLen);
+
+napi_value pcan_CAN_ReaderOpen(napi_env env, napi_callback_info info)
+{
+    napi_status status = napi_generic_failure;
+
+    // Retrieve callback info and arguments list
+    size_t argc = CAN_READEROPEN_ARGC;
+    napi_value argv[CAN_READEROPEN_ARGC];
+
+    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
     assert(status == napi_ok);
 
-    if (msgTmpLen != msg.LEN)
+    if (argc != CAN_READEROPEN_ARGC)
     {
-        napi_throw_error(env, 0, "Mismatch between LEN and actual data buffer length");
+        napi_throw_type_error(env, 0, "Incorrect number of arguments.");
         return 0;
     }
 
-    memcpy(msg.DATA, msgTmpData, msg.LEN);
+    // Retrieve arguments
+    // argv[0] Path
+    char path[PCAN_CAPTURE_PATH_MAX] = { 0 };
+    size_t pathLength = 0;
+    status = napi_get_value_string_utf8(env, argv[0], path, sizeof(path), &pathLength);
+    if (status != napi_ok)
+    {
+        napi_throw_type_error(env, 0, "Argument 0 (Path) is not a string.");
+        return 0;
+    }
 
-    // Write to CAN bus
-    TPCANStatus pcanStatus = PCAN_ERROR_UNKNOWN;
-    pcanStatus = CAN_Write(pcanChannel, &msg);
+    // argv[1] Index mode (uint32, pcanReaderIndexMode_t)
+    uint32_t mode;
+    status = napi_get_value_uint32(env, argv[1], &mode);
+    assert(status == napi_ok);
+
+    pcanReaderHandle_t *handle = malloc(sizeof(*handle));
+    if (handle == 0)
+    {
+        napi_throw_error(env, 0, "Error allocating memory for reader.");
+        return 0;
+    }
+
+    // Map the file and load or build its index
+    const char *error = 0;
+    handle->reader = pcanReaderOpen(path, (pcanReaderIndexMode_t)mode, &error);
 
-    // Print result to console
 #ifdef PCAN_DEBUG
-    printf("pcan_CAN_Write: 0x%02X (%s)\n", pcanStatus, pcanStatusLookup(pcanStatus));
-    pcanDumpMsg(&msg);
+    printf("pcan_CAN_ReaderOpen: \"%s\" (%s)\n", path,
+           (handle->reader != 0) ? "OK" : error);
 #endif
 
-    // Throw error, if any
-    if (pcanStatus != PCAN_ERROR_OK)
+    if (handle->reader == 0)
     {
-        napi_throw_error(env, pcanStatusLookup(pcanStatus),
-                         "pcan_CAN_Write");
+        free(handle);
+        napi_throw_error(env, 0, error);
         return 0;
     }
 
-    // Create a N-API value for the result and return it
     napi_value result;
-    status = napi_create_uint32(env, pcanStatus, &result);
+    status = napi_create_external(env, handle, pcanReaderFinalize, 0, &result);
     assert(status == napi_ok);
-    
+
     return result;
 }
 
 
 
 
-napi_value pcan_CAN_WriteFD(napi_env env, napi_callback_info info)
+napi_value pcan_CAN_ReaderInfo(napi_env env, napi_callback_info info)
 {
     napi_status status = napi_generic_failure;
 
-    // Get callback info and argument list
-    size_t argc = CAN_WRITEFD_ARGC;
-    napi_value argv[CAN_WRITEFD_ARGC];
+    // Retrieve callback info and arguments list
+    size_t argc = CAN_READERINFO_ARGC;
+    napi_value argv[CAN_READERINFO_ARGC];
 
     status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
     assert(status == napi_ok);
 
-    if (argc != CAN_WRITEFD_ARGC)
+    if (argc != CAN_READERINFO_ARGC)
     {
         napi_throw_type_error(env, 0, "Incorrect number of arguments.");
         return 0;
     }
 
     // Retrieve arguments
-    // argv[0] Channel
-    uint32_t pcanChannel;
-    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
+    // argv[0] Reader
+    pcanReaderHandle_t *handle = pcanGetExternal(env, argv[0]);
+    if ((handle == 0) || (handle->reader == 0))
+    {
+        napi_throw_error(env, 0, "Reader is closed.");
+        return 0;
+    }
+    pcanReader_t *reader = handle->reader;
+
+    // Build an object describing the file
+    napi_value result;
+    napi_value value;
+
+    status = napi_create_object(env, &result);
     assert(status == napi_ok);
 
-    // argv[1] MessageBufferFD
-    napi_valuetype pcanMessageBufferType;
-    status = napi_typeof(env, argv[1], &pcanMessageBufferType);
+    status = napi_create_uint32(env, reader->header.channel, &value);
+    assert(status == napi_ok);
+    status = napi_set_named_property(env, result, "channel", value);
     assert(status == napi_ok);
 
-    if (pcanMessageBufferType != napi_object)
-    {
-        napi_throw_type_error(env, 0, "Argument 1 (MessageBufferFD) is not an object.");
-        return 0;
-    }
+    status = napi_create_uint32(env, reader->header.bitrate, &value);
+    assert(status == napi_ok);
+    status = napi_set_named_property(env, result, "bitrate", value);
+    assert(status == napi_ok);
 
-    // Copy message contents from N-API object to TPCANMsgFD struct
-    TPCANMsgFD msg = { 0 };
+    status = napi_create_double(env, (double)reader->header.startTime, &value);
+    assert(status == napi_ok);
+    status = napi_set_named_property(env, result, "startTime", value);
+    assert(status == napi_ok);
 
-    napi_value pcanMessageBufferID;
-    status = napi_get_named_property(env, argv[1], "id", &pcanMessageBufferID);
+    status = napi_create_uint32(env, reader->header.sequence, &value);
     assert(status == napi_ok);
-    status = napi_get_value_uint32(env, pcanMessageBufferID, &(msg.ID));
+    status = napi_set_named_property(env, result, "sequence", value);
     assert(status == napi_ok);
 
-    napi_value pcanMessageBufferMsgtype;
-    status = napi_get_named_property(env, argv[1], "msgtype", &pcanMessageBufferMsgtype);
+    status = napi_create_uint32(env, reader->recordSize, &value);
     assert(status == napi_ok);
-    status = napi_get_value_uint32(env, pcanMessageBufferMsgtype, (uint32_t*)&(msg.MSGTYPE));
+    status = napi_set_named_property(env, result, "recordSize", value);
     assert(status == napi_ok);
 
-    napi_value pcanMessageBufferDLC;
-    status = napi_get_named_property(env, argv[1], "dlc", &pcanMessageBufferDLC);
+    status = napi_create_double(env, (double)reader->recordCount, &value);
     assert(status == napi_ok);
-    status = napi_get_value_uint32(env, pcanMessageBufferDLC, (uint32_t*)&(msg.DLC));
+    status = napi_set_named_property(env, result, "frames", value);
     assert(status == napi_ok);
 
-    napi_value pcanMessageBufferData;
-    BYTE *msgTmpData;
-    size_t msgTmpLen = 0;
-    status = napi_get_named_property(env, argv[1], "data", &pcanMessageBufferData);
+    status = napi_create_double(env, (double)reader->firstTimestamp, &value);
     assert(status == napi_ok);
-    status = napi_get_buffer_info(env, pcanMessageBufferData, (void**)&msgTmpData, &msgTmpLen);
+    status = napi_set_named_property(env, result, "firstTimestamp", value);
     assert(status == napi_ok);
 
-    if (msgTmpLen != pcanDLCDecode(msg.DLC))
+    status = napi_create_double(env, (double)reader->lastTimestamp, &value);
+    assert(status == napi_ok);
+    status = napi_set_named_property(env, result, "lastTimestamp", value);
+    assert(status == napi_ok);
+
+    status = napi_get_boolean(env, reader->indexLoaded != 0, &value);
+    assert(status == napi_ok);
+    status = napi_set_named_property(env, result, "indexLoaded", value);
+    assert(status == napi_ok);
+
+    // Frame count for every ID in the file, keyed by ID
+    napi_value ids;
+    status = napi_create_object(env, &ids);
+    assert(status == napi_ok);
+
+    uint32_t i;
+    char key[16];
+    for (i = 0; i < reader->idCapacity; i++)
     {
-        napi_throw_error(env, 0, "Mismatch between DLC and actual data buffer length");
+        if (reader->ids[i].used)
+        {
+            snprintf(key, sizeof(key), "%u", reader->ids[i].id);
+            status = napi_create_uint32(env, reader->ids[i].frames, &value);
+            assert(status == napi_ok);
+            status = napi_set_named_property(env, ids, key, value);
+            assert(status == napi_ok);
+        }
+    }
+
+    status = napi_set_named_property(env, result, "ids", ids);
+    assert(status == napi_ok);
+
+    return result;
+}
+
+
+
+
+napi_value pcan_CAN_ReaderQuery(napi_env env, napi_callback_info info)
+{
+    napi_status status = napi_generic_failure;
+
+    // Retrieve callback info and arguments list
+    size_t argc = CAN_READERQUERY_ARGC;
+    napi_value argv[CAN_READERQUERY_ARGC];
+
+    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
+    assert(status == napi_ok);
+
+    if (argc != CAN_READERQUERY_ARGC)
+    {
+        napi_throw_type_error(env, 0, "Incorrect number of arguments.");
         return 0;
     }
 
-    memcpy(msg.DATA, msgTmpData, pcanDLCDecode(msg.DLC));
+    // Retrieve arguments
+    // argv[0] Reader
+    pcanReaderHandle_t *readerHandle = pcanGetExternal(env, argv[0]);
+    if ((readerHandle == 0) || (readerHandle->reader == 0))
+    {
+        napi_throw_error(env, 0, "Reader is closed.");
+        return 0;
+    }
+
+    // argv[1] IDs (array of uint32, empty to match all)
+    bool isArray = false;
+    status = napi_is_array(env, argv[1], &isArray);
+    assert(status == napi_ok);
+
+    if (!isArray)
+    {
+        napi_throw_type_error(env, 0, "Argument 1 (IDs) is not an array.");
+        return 0;
+    }
+
+    uint32_t idCount = 0;
+    status = napi_get_array_length(env, argv[1], &idCount);
+    assert(status == napi_ok);
+
+    uint32_t *ids = malloc((idCount + 1) * sizeof(uint32_t));
+    if (ids == 0)
+    {
+        napi_throw_error(env, 0, "Error allocating memory for query.");
+        return 0;
+    }
+
+    uint32_t i;
+    napi_value element;
+    for (i = 0; i < idCount; i++)
+    {
+        status = napi_get_element(env, argv[1], i, &element);
+        assert(status == napi_ok);
+        status = napi_get_value_uint32(env, element, &(ids[i]));
+        if (status != napi_ok)
+        {
+            free(ids);
+            napi_throw_type_error(env, 0, "Argument 1 (IDs) contains a non-number.");
+            return 0;
+        }
+    }
+
+    // argv[2] From, argv[3] To (timestamps in microseconds, inclusive)
+    double from;
+    status = napi_get_value_double(env, argv[2], &from);
+    assert(status == napi_ok);
+
+    double to;
+    status = napi_get_value_double(env, argv[3], &to);
+    assert(status == napi_ok);
 
-    // Write to CAN bus
-    TPCANStatus pcanStatus = PCAN_ERROR_UNKNOWN;
-    pcanStatus = CAN_WriteFD(pcanChannel, &msg);
-    
-    // Print result to console
-#ifdef PCAN_DEBUG
-    printf("pcan_CAN_WriteFD: 0x%02X (%s)\n", pcanStatus, pcanStatusLookup(pcanStatus));
-    pcanDumpMsgFD(&msg);
-#endif
+    pcanQueryHandle_t *handle = malloc(sizeof(*handle));
+    if (handle != 0)
+    {
+        handle->query = pcanReaderQueryStart(readerHandle->reader, ids, idCount,
+                                             (from <= 0) ? 0 : (uint64_t)from,
+                                             (to >= 18446744073709551615.0) ?
+                                             UINT64_MAX : (uint64_t)to);
+    }
+    free(ids);
 
-    // Throw error, if any
-    if (pcanStatus != PCAN_ERROR_OK)
+    if ((handle == 0) || (handle->query == 0))
     {
-        napi_throw_error(env, pcanStatusLookup(pcanStatus),
-                         "pcan_CAN_WriteFD");
+        free(handle);
+        napi_throw_error(env, 0, "Error allocating memory for query.");
         return 0;
     }
 
-    // Create a N-API value for the result and return it
     napi_value result;
-    status = napi_create_uint32(env, pcanStatus, &result);
+    status = napi_create_external(env, handle, pcanQueryFinalize, 0, &result);
     assert(status == napi_ok);
 
     return result;
@@ -832,176 +5408,116 @@ napi_value pcan_CAN_WriteFD(napi_env env, napi_callback_info info)
 
 
 
-napi_value pcan_CAN_GetValue(napi_env env, napi_callback_info info)
+napi_value pcan_CAN_ReaderNext(napi_env env, napi_callback_info info)
 {
     napi_status status = napi_generic_failure;
 
-    // Retrieve callback info and argument list
-    size_t argc = CAN_GETVALUE_ARGC;
-    napi_value argv[CAN_GETVALUE_ARGC];
+    // Retrieve callback info and arguments list
+    size_t argc = CAN_READERNEXT_ARGC;
+    napi_value argv[CAN_READERNEXT_ARGC];
 
     status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
     assert(status == napi_ok);
 
-    if (argc != CAN_GETVALUE_ARGC)
+    if (argc != CAN_READERNEXT_ARGC)
     {
-        napi_throw_type_error(env, 0, "Incorrect number of arguments. \n"
-                              "The N-API implementation of CAN_GetValue accepts Channel, "
-                              "Parameter, and Buffer.");
+        napi_throw_type_error(env, 0, "Incorrect number of arguments.");
         return 0;
     }
 
     // Retrieve arguments
-    // argv[0] Channel
-    uint32_t pcanChannel;
-    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
-    assert(status == napi_ok);
-
-    // argv[1] Parameter
-    uint32_t pcanParameter;
-    status = napi_get_value_uint32(env, argv[1], &pcanParameter);
-    assert(status == napi_ok);
-
-    // argv[2] Buffer
-    napi_valuetype pcanBufferType;
-    status = napi_typeof(env, argv[2], &pcanBufferType);
-    assert(status == napi_ok);
-
-    if (pcanBufferType != napi_object)
+    // argv[0] Query
+    pcanQueryHandle_t *handle = pcanGetExternal(env, argv[0]);
+    if (handle == 0)
     {
-        napi_throw_type_error(env, 0, "Argument 2 (Buffer) is not an object.");
+        napi_throw_type_error(env, 0, "Argument 0 (Query) is not a query.");
         return 0;
     }
 
-    // Argument 3 - BufferLength (obtained from pcanBuffer)
-    BYTE *pcanBuffer = 0;
-    size_t pcanBufferLength = 0;
-    status = napi_get_buffer_info(env, argv[2], (void**)&pcanBuffer, &pcanBufferLength);
+    // argv[1] Maximum number of records
+    uint32_t max;
+    status = napi_get_value_uint32(env, argv[1], &max);
     assert(status == napi_ok);
 
-    // Get requested parameter from CAN channel
-    TPCANStatus pcanStatus = PCAN_ERROR_UNKNOWN;
-    pcanStatus = CAN_GetValue(pcanChannel, pcanParameter, pcanBuffer, pcanBufferLength);
+    if ((max == 0) || (max > PCAN_READERNEXT_MAX))
+    {
+        max = PCAN_READERNEXT_MAX;
+    }
 
-    // Print result to console
-#ifdef PCAN_DEBUG
-    printf("pcan_CAN_GetValue: \n"
-           "  pcanStatus       = 0x%02X (%s)\n"
-           "  pcanChannel      = 0x%02X\n"
-           "  pcanParameter    = 0x%02X (%s)\n"
-           "  pcanBufferLength = 0x%02zX\n"
-           "  pcanBuffer       = ",
-           pcanStatus, pcanStatusLookup(pcanStatus),
-           pcanChannel,
-           pcanParameter, pcanParameterLookup(pcanParameter),
-           pcanBufferLength);
-    pcanDumpBuffer(pcanBuffer, pcanBufferLength);
-    printf("\n");
-#endif
+    // A finished query has already been freed; keep returning empty batches
+    uint32_t recordSize = (handle->query != 0) ? handle->query->reader->recordSize : 0;
+    uint8_t *records = 0;
+    uint32_t count = 0;
 
-    // Throw error, if any
-    if (pcanStatus != PCAN_ERROR_OK)
+    if (handle->query != 0)
     {
-        napi_throw_error(env, pcanStatusLookup(pcanStatus),
-                         "pcan_CAN_GetValue");
-        return 0;
+        records = malloc((size_t)max * recordSize);
+        if (records == 0)
+        {
+            napi_throw_error(env, 0, "Error allocating memory for query.");
+            return 0;
+        }
+
+        count = pcanReaderQueryNext(handle->query, records, max);
+
+        // Release the file as soon as the query is finished, rather than
+        // whenever the handle happens to be garbage collected
+        if (count == 0)
+        {
+            pcanReaderQueryFree(handle->query);
+            handle->query = 0;
+        }
     }
 
-    // Put value into the buffer object passed from N-API
-    napi_value pcanBufferValue;
-    status = napi_create_buffer(env, pcanBufferLength, (void**)&pcanBuffer, &pcanBufferValue);
-    assert(status == napi_ok);
-
-    // Create a N-API value for the result and return it
     napi_value result;
-    status = napi_create_uint32(env, pcanStatus, &result);
+    void *resultData;
+    status = napi_create_buffer_copy(env, (size_t)count * recordSize, records,
+                                     &resultData, &result);
     assert(status == napi_ok);
 
+    free(records);
+
     return result;
 }
 
 
 
 
-napi_value pcan_CAN_SetValue(napi_env env, napi_callback_info info)
+napi_value pcan_CAN_ReaderClose(napi_env env, napi_callback_info info)
 {
     napi_status status = napi_generic_failure;
 
-    // Retrieve callback info and argument list
-    size_t argc = CAN_SETVALUE_ARGC;
-    napi_value argv[CAN_SETVALUE_ARGC];
+    // Retrieve callback info and arguments list
+    size_t argc = CAN_READERCLOSE_ARGC;
+    napi_value argv[CAN_READERCLOSE_ARGC];
 
     status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
     assert(status == napi_ok);
 
-    if (argc != CAN_SETVALUE_ARGC)
+    if (argc != CAN_READERCLOSE_ARGC)
     {
-        napi_throw_type_error(env, 0, "Incorrect number of arguments. \n"
-                              "The N-API implementation of CAN_SetValue accepts Channel, "
-                              "Parameter, and Buffer.");
+        napi_throw_type_error(env, 0, "Incorrect number of arguments.");
         return 0;
     }
 
     // Retrieve arguments
-    // argv[0] Channel
-    uint32_t pcanChannel;
-    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
-    assert(status == napi_ok);
-
-    // argv[1] Parameter
-    uint32_t pcanParameter;
-    status = napi_get_value_uint32(env, argv[1], &pcanParameter);
-    assert(status == napi_ok);
-
-    // argv[2] Buffer
-    napi_valuetype pcanBufferType;
-    status = napi_typeof(env, argv[2], &pcanBufferType);
-    assert(status == napi_ok);
-
-    if (pcanBufferType != napi_object)
+    // argv[0] Reader
+    pcanReaderHandle_t *handle = pcanGetExternal(env, argv[0]);
+    if (handle == 0)
     {
-        napi_throw_type_error(env, 0, "Argument 2 (Buffer) is not an object.");
+        napi_throw_type_error(env, 0, "Argument 0 (Reader) is not a reader.");
         return 0;
     }
 
-    // Argument 3 - BufferLength (obtained from pcanBuffer)
-    BYTE *pcanBuffer = 0;
-    size_t pcanBufferLength = 0;
-    
-    status = napi_get_buffer_info(env, argv[2], (void**)&pcanBuffer, &pcanBufferLength);
-    assert(status == napi_ok);
-
-    // Set value for CAN channel
-    TPCANStatus pcanStatus = PCAN_ERROR_UNKNOWN;
-    pcanStatus = CAN_SetValue(pcanChannel, pcanParameter, pcanBuffer, pcanBufferLength);
-
-    // Print result to console
-#ifdef PCAN_DEBUG
-    printf("pcan_CAN_SetValue: \n"
-           "  pcanStatus       = 0x%02X (%s)\n"
-           "  pcanChannel      = 0x%02X\n"
-           "  pcanParameter    = 0x%02X (%s)\n"
-           "  pcanBufferLength = 0x%02zX\n"
-           "  pcanBuffer       = ",
-           pcanStatus, pcanStatusLookup(pcanStatus),
-           pcanChannel,
-           pcanParameter, pcanParameterLookup(pcanParameter),
-           pcanBufferLength);
-    pcanDumpBuffer(pcanBuffer, pcanBufferLength);
-    printf("\n");
-#endif
-
-    // Throw error, if any
-    if (pcanStatus != PCAN_ERROR_OK)
+    // The file stays mapped until any unfinished queries are also freed
+    if (handle->reader != 0)
     {
-        napi_throw_error(env, pcanStatusLookup(pcanStatus),
-                         "pcan_CAN_SetValue");
-        return 0;
+        pcanReaderRelease(handle->reader);
+        handle->reader = 0;
     }
 
-    // Create an N-API value for the result and return it
     napi_value result;
-    status = napi_create_uint32(env, pcanStatus, &result);
+    status = napi_get_undefined(env, &result);
     assert(status == napi_ok);
 
     return result;
@@ -1010,297 +5526,220 @@ napi_value pcan_CAN_SetValue(napi_env env, napi_callback_info info)
 
 
 
-#if defined _WIN32
-napi_value pcan_CAN_FilterMessages(napi_env env, napi_callback_info info)
+napi_value pcan_CAN_TrcOpen(napi_env env, napi_callback_info info)
 {
     napi_status status = napi_generic_failure;
 
-    // Retrieve callback info and argument list
-    size_t argc = CAN_FILTERMESSAGES_ARGC;
-    napi_value argv[CAN_FILTERMESSAGES_ARGC];
-    
+    // Retrieve callback info and arguments list
+    size_t argc = CAN_TRCOPEN_ARGC;
+    napi_value argv[CAN_TRCOPEN_ARGC];
+
     status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
     assert(status == napi_ok);
 
-    if (argc != CAN_FILTERMESSAGES_ARGC)
+    if (argc != CAN_TRCOPEN_ARGC)
     {
         napi_throw_type_error(env, 0, "Incorrect number of arguments.");
         return 0;
     }
 
     // Retrieve arguments
-    // argv[0] Channel
-    uint32_t pcanChannel;
-    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
-    assert(status == napi_ok);
-
-    // argv[1] FromID
-    uint32_t pcanFromID;
-    status = napi_get_value_uint32(env, argv[1], &pcanFromID);
-    assert(status == napi_ok);
-
-    // argv[2] ToID
-    uint32_t pcanToID;
-    status = napi_get_value_uint32(env, argv[2], &pcanToID);
-    assert(status == napi_ok);
+    // argv[0] Path
+    char path[PCAN_CAPTURE_PATH_MAX] = { 0 };
+    size_t pathLength = 0;
+    status = napi_get_value_string_utf8(env, argv[0], path, sizeof(path), &pathLength);
+    if (status != napi_ok)
+    {
+        napi_throw_type_error(env, 0, "Argument 0 (Path) is not a string.");
+        return 0;
+    }
 
-    // argv[3] Mode
-    uint32_t pcanMode;
-    status = napi_get_value_uint32(env, argv[3], &pcanMode);
-    assert(status == napi_ok);
+    pcanTrcHandle_t *handle = malloc(sizeof(*handle));
+    if (handle == 0)
+    {
+        napi_throw_error(env, 0, "Error allocating memory for trace reader.");
+        return 0;
+    }
 
-    // Set or amend the CAN message filter ranges
-    TPCANStatus pcanStatus = PCAN_ERROR_UNKNOWN;
-    pcanStatus = CAN_FilterMessages(pcanChannel, pcanFromID, pcanToID, pcanMode);
+    // Open the file and read its header
+    const char *error = 0;
+    handle->reader = pcanTrcOpen(path, &error);
 
-    // Print result to console
 #ifdef PCAN_DEBUG
-    printf("pcan_CAN_FilterMessages: \n"
-           "  pcanStatus  = 0x%02X (%s)\n"
-           "  pcanChannel = 0x%02X\n"
-           "  pcanFromID  = 0x%08X\n"
-           "  pcanToID    = 0x%08X\n"
-           "  pcanMode    = 0x%02X\n",
-           pcanStatus, pcanStatusLookup(pcanStatus),
-           pcanChannel,
-           pcanFromID,
-           pcanToID,
-           pcanMode);
+    printf("pcan_CAN_TrcOpen: \"%s\" (%s)\n", path,
+           (handle->reader != 0) ? "OK" : error);
 #endif
 
-    // Throw error, if any
-    if (pcanStatus != PCAN_ERROR_OK)
+    if (handle->reader == 0)
     {
-        napi_throw_error(env, pcanStatusLookup(pcanStatus),
-                         "pcan_CAN_FilterMessages");
+        free(handle);
+        napi_throw_error(env, 0, error);
         return 0;
     }
 
-    // Create an N-API value for the result and return it
-    napi_value result;
-    status = napi_create_uint32(env, pcanStatus, &result);
-    assert(status == napi_ok);
-
-    return result;
-}
-
-
-#elif defined __APPLE__
-napi_value pcan_CAN_FilterMessages(napi_env env, napi_callback_info info)
-{
-    napi_status status = napi_generic_failure;
- 
-    // Create an N-API value for the result and return it
     napi_value result;
-    status = napi_create_uint32(env, 0, &result);
+    status = napi_create_external(env, handle, pcanTrcFinalize, 0, &result);
     assert(status == napi_ok);
 
     return result;
 }
 
 
-#endif
-
-
 
 
-napi_value pcan_CAN_GetErrorText(napi_env env, napi_callback_info info)
+napi_value pcan_CAN_TrcInfo(napi_env env, napi_callback_info info)
 {
     napi_status status = napi_generic_failure;
-    
-    // Retrieve callback info and argument list
-    size_t argc = CAN_GETERRORTEXT_ARGC;
-    napi_value argv[CAN_GETERRORTEXT_ARGC];
+
+    // Retrieve callback info and arguments list
+    size_t argc = CAN_TRCINFO_ARGC;
+    napi_value argv[CAN_TRCINFO_ARGC];
 
     status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
     assert(status == napi_ok);
 
-    if (argc != CAN_GETERRORTEXT_ARGC)
+    if (argc != CAN_TRCINFO_ARGC)
     {
         napi_throw_type_error(env, 0, "Incorrect number of arguments.");
         return 0;
     }
-
-    // Retrieve arguments
-    // argv[0] Error
-    TPCANStatus pcanError;
-    status = napi_get_value_uint32(env, argv[0], &pcanError);
-    assert(status == napi_ok);
-
-    // argv[1] Language
-    uint32_t pcanLanguage;
-    status = napi_get_value_uint32(env, argv[1], &pcanLanguage);
-    assert(status == napi_ok);
-
-    // Buffer
-    char pcanBuffer[256];
-
-    // Call API to get error text
-    TPCANStatus pcanStatus = PCAN_ERROR_UNKNOWN;
-    pcanStatus = CAN_GetErrorText(pcanError, pcanLanguage, pcanBuffer);
-
-    // Print result to console
-#ifdef PCAN_DEBUG
-    printf("pcan_CAN_GetErrorText:\n"
-           "  pcanStatus    = %i (%s)\n"
-           "  pcanError     = %i\n"
-           "  pcanLanguage  = %i\n"
-           "  pcanBuffer    = \"%s\"\n",
-           pcanStatus, pcanStatusLookup(pcanStatus),
-           pcanError,
-           pcanLanguage,
-           pcanBuffer);
-#endif
-
-    // Throw error, if any
-    if (pcanStatus != PCAN_ERROR_OK)
+
+    // Retrieve arguments
+    // argv[0] Trace reader
+    pcanTrcHandle_t *handle = pcanGetExternal(env, argv[0]);
+    if ((handle == 0) || (handle->reader == 0))
     {
-        napi_throw_error(env, pcanStatusLookup(pcanStatus),
-                         "pcan_CAN_GetErrorText");
+        napi_throw_error(env, 0, "Trace reader is closed.");
         return 0;
     }
+    pcanTrcReader_t *reader = handle->reader;
 
-    // Create an N-API value for the result and return it
-    napi_value pcanBufferValue;
-    status = napi_create_string_utf8(env, pcanBuffer, NAPI_AUTO_LENGTH, &pcanBufferValue);
+    // Build an object describing the file
+    napi_value result;
+    napi_value value;
+
+    status = napi_create_object(env, &result);
     assert(status == napi_ok);
 
-    return pcanBufferValue;
+    status = napi_create_double(env, reader->version / 10.0, &value);
+    assert(status == napi_ok);
+    status = napi_set_named_property(env, result, "version", value);
+    assert(status == napi_ok);
+
+    status = napi_create_double(env, (double)reader->startTime, &value);
+    assert(status == napi_ok);
+    status = napi_set_named_property(env, result, "startTime", value);
+    assert(status == napi_ok);
+
+    status = napi_create_double(env, (double)reader->lines, &value);
+    assert(status == napi_ok);
+    status = napi_set_named_property(env, result, "lines", value);
+    assert(status == napi_ok);
+
+    status = napi_create_double(env, (double)reader->skipped, &value);
+    assert(status == napi_ok);
+    status = napi_set_named_property(env, result, "skipped", value);
+    assert(status == napi_ok);
+
+    return result;
 }
 
 
 
 
-napi_value pcan_CAN_EnableEvent(napi_env env, napi_callback_info info)
+napi_value pcan_CAN_TrcNext(napi_env env, napi_callback_info info)
 {
     napi_status status = napi_generic_failure;
 
-    // Get callback info and argument list
-    size_t argc = CAN_ENABLEEVENT_ARGC;
-    napi_value argv[CAN_ENABLEEVENT_ARGC];
+    // Retrieve callback info and arguments list
+    size_t argc = CAN_TRCNEXT_ARGC;
+    napi_value argv[CAN_TRCNEXT_ARGC];
 
     status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
     assert(status == napi_ok);
 
-    if (argc != CAN_ENABLEEVENT_ARGC)
+    if (argc != CAN_TRCNEXT_ARGC)
     {
         napi_throw_type_error(env, 0, "Incorrect number of arguments.");
         return 0;
     }
 
     // Retrieve arguments
-    // argv[0] Channel
-    uint32_t pcanChannel;
-    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
-    assert(status == napi_ok);
-
-    // argv[1] Callback
-    napi_valuetype pcanCallbackType;
-    status = napi_typeof(env, argv[1], &pcanCallbackType);
-    assert(status == napi_ok);
-
-    if (pcanCallbackType != napi_function)
+    // argv[0] Trace reader
+    pcanTrcHandle_t *handle = pcanGetExternal(env, argv[0]);
+    if ((handle == 0) || (handle->reader == 0))
     {
-        napi_throw_type_error(env, 0, "Argument 1 (Callback) is not a function.");
+        napi_throw_error(env, 0, "Trace reader is closed.");
         return 0;
     }
 
-    // Create resource name string, used below
-    napi_value asyncResourceName;
-    status = napi_create_string_utf8(env, "pcanCallback",
-                                     NAPI_AUTO_LENGTH, &asyncResourceName);
-    assert(status == napi_ok);
-
-    // Create thread-safe function to use as a callback
-    status = napi_create_threadsafe_function(env,
-                                             argv[1], // func
-                                             0, // async_resource
-                                             asyncResourceName,
-                                             0, // max_queue_size
-                                             1, // initial_thread_count
-                                             0, // thread_finalize_data
-                                             pcan_CAN_EventFinalize,
-                                             0, // context
-                                             0, // call_js_cb
-                                             &pcanCallback); // result
+    // argv[1] Maximum number of frames
+    uint32_t max;
+    status = napi_get_value_uint32(env, argv[1], &max);
     assert(status == napi_ok);
 
-    // Enable CAN Bus receive event
-    int pcanStatus = PCAN_ERROR_UNKNOWN;
-    pcanStatus = pcanEventEnable(pcanChannel, pcan_CAN_EventCallback);
-
-    // Print result to console
-#ifdef PCAN_DEBUG
-    printf("pcan_CAN_EnableEvent: 0x%02X\n", pcanStatus);
-#endif
+    if ((max == 0) || (max > PCAN_TRCNEXT_MAX))
+    {
+        max = PCAN_TRCNEXT_MAX;
+    }
 
-    // Throw error, if any
-    if (pcanStatus != PCAN_ERROR_OK)
+    pcanFrame_t *frames = malloc((size_t)max * sizeof(pcanFrame_t));
+    if (frames == 0)
     {
-        napi_throw_error(env, pcanStatusLookup(pcanStatus),
-                         "pcan_CAN_EnableEvent");
+        napi_throw_error(env, 0, "Error allocating memory for trace reader.");
         return 0;
     }
 
-    // Create a N-API value for the result and return it
+    uint32_t count = pcanTrcRead(handle->reader, frames, max);
+
     napi_value result;
-    status = napi_create_uint32(env, pcanStatus, &result);
+    void *resultData;
+    status = napi_create_buffer_copy(env, (size_t)count * sizeof(pcanFrame_t), frames,
+                                     &resultData, &result);
     assert(status == napi_ok);
 
+    free(frames);
+
     return result;
 }
 
 
 
 
-napi_value pcan_CAN_DisableEvent(napi_env env, napi_callback_info info)
+napi_value pcan_CAN_TrcClose(napi_env env, napi_callback_info info)
 {
     napi_status status = napi_generic_failure;
 
-    // Get callback info and argument list
-    size_t argc = CAN_DISABLEEVENT_ARGC;
-    napi_value argv[CAN_DISABLEEVENT_ARGC];
+    // Retrieve callback info and arguments list
+    size_t argc = CAN_TRCCLOSE_ARGC;
+    napi_value argv[CAN_TRCCLOSE_ARGC];
 
     status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
     assert(status == napi_ok);
 
-    if (argc != CAN_DISABLEEVENT_ARGC)
+    if (argc != CAN_TRCCLOSE_ARGC)
     {
         napi_throw_type_error(env, 0, "Incorrect number of arguments.");
         return 0;
     }
 
     // Retrieve arguments
-    uint32_t pcanChannel;
-    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
-    assert(status == napi_ok);
-
-    // Disable CAN Bus receive event
-    int pcanStatus = PCAN_ERROR_UNKNOWN;
-    pcanStatus = pcanEventDisable(pcanChannel);
-
-    // Print result to console
-#ifdef PCAN_DEBUG
-    printf("pcan_CAN_DisableEvent: 0x%02X\n", pcanStatus);
-#endif
-
-    // Throw error, if any
-    if (pcanStatus != PCAN_ERROR_OK)
+    // argv[0] Trace reader
+    pcanTrcHandle_t *handle = pcanGetExternal(env, argv[0]);
+    if (handle == 0)
     {
-        napi_throw_error(env, pcanStatusLookup(pcanStatus),
-                         "pcan_CAN_DisableEvent");
+        napi_throw_type_error(env, 0, "Argument 0 (Reader) is not a trace reader.");
         return 0;
     }
 
-    // Try to release the threadsafe function
-    status = napi_unref_threadsafe_function(env, pcanCallback);
-    assert(status == napi_ok);
-    status = napi_release_threadsafe_function(pcanCallback, napi_tsfn_abort);
-    assert(status == napi_ok);
+    if (handle->reader != 0)
+    {
+        pcanTrcClose(handle->reader);
+        handle->reader = 0;
+    }
 
-    // Create a N-API value for the result and return it
     napi_value result;
-    status = napi_create_uint32(env, pcanStatus, &result);
+    status = napi_get_undefined(env, &result);
     assert(status == napi_ok);
 
     return result;
@@ -1309,19 +5748,18 @@ napi_value pcan_CAN_DisableEvent(napi_env env, napi_callback_info info)
 
 
 
-#if defined _WIN32
-napi_value pcan_CAN_AcceptanceFilter11Bit(napi_env env, napi_callback_info info)
+napi_value pcan_CAN_ReplayStart(napi_env env, napi_callback_info info)
 {
     napi_status status = napi_generic_failure;
 
-    // Get callback info and argument list
-    size_t argc = CAN_ACCEPTANCEFILTER11BIT_ARGC;
-    napi_value argv[CAN_ACCEPTANCEFILTER11BIT_ARGC];
+    // Retrieve callback info and arguments list
+    size_t argc = CAN_REPLAYSTART_ARGC;
+    napi_value argv[CAN_REPLAYSTART_ARGC];
 
     status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
     assert(status == napi_ok);
 
-    if (argc != CAN_ACCEPTANCEFILTER11BIT_ARGC)
+    if (argc != CAN_REPLAYSTART_ARGC)
     {
         napi_throw_type_error(env, 0, "Incorrect number of arguments.");
         return 0;
@@ -1333,384 +5771,484 @@ napi_value pcan_CAN_AcceptanceFilter11Bit(napi_env env, napi_callback_info info)
     status = napi_get_value_uint32(env, argv[0], &pcanChannel);
     assert(status == napi_ok);
 
-    // argv[1] AcceptanceCode
-    uint32_t pcan_AcceptanceCode;
-    status = napi_get_value_uint32(env, argv[1], &pcan_AcceptanceCode);
-    assert(status == napi_ok);
+    // argv[1] Path
+    char path[PCAN_CAPTURE_PATH_MAX] = { 0 };
+    size_t pathLength = 0;
+    status = napi_get_value_string_utf8(env, argv[1], path, sizeof(path), &pathLength);
+    if (status != napi_ok)
+    {
+        napi_throw_type_error(env, 0, "Argument 1 (Path) is not a string.");
+        return 0;
+    }
 
-    // argv[2] AcceptanceMask
-    uint32_t pcan_AcceptanceMask;
-    status = napi_get_value_uint32(env, argv[2], &pcan_AcceptanceMask);
-    assert(status == napi_ok);
+    // argv[2] Options; all properties are optional
+    pcanReplayOptions_t options = { 0 };
+    double value = 0;
+    bool loop = false;
 
-    // Build 64-bit acceptance filter value
-    uint64_t pcan_AcceptanceFilter = 0;
-    pcan_AcceptanceFilter |= ((uint64_t)pcan_AcceptanceCode << 0x20);
-    pcan_AcceptanceFilter |= ((uint64_t)(~pcan_AcceptanceMask));
-    // Note that pcan_AcceptanceMask's bits are flipped from "don't care"
-    // to "do care"
+    options.speed = 1.0;
+    options.loops = 1;
+    options.spinUs = PCAN_REPLAY_SPIN_DEFAULT_US;
+    options.lateUs = PCAN_REPLAY_LATE_DEFAULT_US;
 
-    // Set the acceptance filter through the API
-    TPCANStatus pcanStatus = PCAN_ERROR_UNKNOWN;
-    pcanStatus = CAN_SetValue(pcanChannel, PCAN_ACCEPTANCE_FILTER_11BIT,
-                               &pcan_AcceptanceFilter, sizeof(pcan_AcceptanceFilter));
+    if (napiGetOptionalDouble(env, argv[2], "speed", &value))
+    {
+        if (!(value > 0))
+        {
+            napi_throw_error(env, 0, "Replay speed must be greater than zero.");
+            return 0;
+        }
+        options.speed = value;
+    }
+    if (napiGetOptionalDouble(env, argv[2], "spinUs", &value))
+    {
+        options.spinUs = (uint64_t)value;
+    }
+    if (napiGetOptionalDouble(env, argv[2], "lateUs", &value))
+    {
+        options.lateUs = (uint64_t)value;
+    }
 
-    // Print result to console
-#ifdef PCAN_DEBUG
-    printf("pcan_CAN_AcceptanceFilter11Bit:\n"
-           "  pcanStatus            = 0x%02X (%s)\n"
-           "  pcanChannel           = 0x%02X\n"
-           "  pcan_AcceptanceCode   = 0x%08X\n"
-           "  pcan_AcceptanceMask   = 0x%08X\n"
-           "  pcan_AcceptanceFilter = 0x%016llX\n",
-           pcanStatus, pcanStatusLookup(pcanStatus),
-           pcanChannel,
-           pcan_AcceptanceCode,
-           pcan_AcceptanceMask,
-           pcan_AcceptanceFilter);
-#endif
+    // loop is a number of passes, or true to repeat until stopped
+    if (napiGetOptionalDouble(env, argv[2], "loop", &value))
+    {
+        options.loops = (uint32_t)value;
+    }
+    else if (napiGetOptionalBool(env, argv[2], "loop", &loop) && loop)
+    {
+        options.loops = 0;
+    }
 
-    // Throw error, if any
-    if (pcanStatus != PCAN_ERROR_OK)
+    char formatName[16] = "native";
+    napiGetOptionalString(env, argv[2], "format", formatName, sizeof(formatName));
+    if (strcmp(formatName, "native") == 0)
     {
-        napi_throw_error(env, pcanStatusLookup(pcanStatus),
-                         "pcan_CAN_AcceptanceFilter11Bit");
+        options.source = PCAN_REPLAY_SOURCE_NATIVE;
+    }
+    else if (strcmp(formatName, "trc") == 0)
+    {
+        options.source = PCAN_REPLAY_SOURCE_TRC;
+    }
+    else
+    {
+        napi_throw_error(env, 0, "Only native and trc captures can be replayed.");
         return 0;
     }
 
-    // Create an N-API value for the result and return it
-    napi_value result;
-    status = napi_create_uint32(env, pcanStatus, &result);
-    assert(status == napi_ok);
-
-    return result;    
-}
-
-
-#elif defined __APPLE__
-napi_value pcan_CAN_AcceptanceFilter11Bit(napi_env env, napi_callback_info info)
-{
-    napi_status status = napi_generic_failure;
-
-    // Create an N-API value for the result and return it
-    napi_value result;
-    status = napi_create_uint32(env, 0, &result);
+    // ids (array of uint32, absent or empty to replay all)
+    napi_valuetype optionsType;
+    status = napi_typeof(env, argv[2], &optionsType);
     assert(status == napi_ok);
 
-    return result;    
-}
-
-
-#endif
-
-
+    uint32_t *ids = 0;
+    napi_value idsValue;
+    bool isArray = false;
 
+    if (optionsType == napi_object)
+    {
+        status = napi_get_named_property(env, argv[2], "ids", &idsValue);
+        assert(status == napi_ok);
+        status = napi_is_array(env, idsValue, &isArray);
+        assert(status == napi_ok);
+    }
 
-#if defined _WIN32
-napi_value pcan_CAN_AcceptanceFilter29Bit(napi_env env, napi_callback_info info)
-{
-    napi_status status = napi_generic_failure;
+    if (isArray)
+    {
+        status = napi_get_array_length(env, idsValue, &(options.idCount));
+        assert(status == napi_ok);
 
-    // Get callback info and argument list
-    size_t argc = CAN_ACCEPTANCEFILTER29BIT_ARGC;
-    napi_value argv[CAN_ACCEPTANCEFILTER29BIT_ARGC];
+        ids = malloc((options.idCount + 1) * sizeof(uint32_t));
+        if (ids == 0)
+        {
+            napi_throw_error(env, 0, "Error allocating memory for replay.");
+            return 0;
+        }
+
+        uint32_t i;
+        napi_value element;
+        for (i = 0; i < options.idCount; i++)
+        {
+            status = napi_get_element(env, idsValue, i, &element);
+            assert(status == napi_ok);
+            status = napi_get_value_uint32(env, element, &(ids[i]));
+            if (status != napi_ok)
+            {
+                free(ids);
+                napi_throw_type_error(env, 0, "Option ids contains a non-number.");
+                return 0;
+            }
+        }
+        options.ids = ids;
+    }
 
-    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
+    // argv[3] Callback
+    napi_valuetype callbackType;
+    status = napi_typeof(env, argv[3], &callbackType);
     assert(status == napi_ok);
 
-    if (argc != CAN_ACCEPTANCEFILTER29BIT_ARGC)
+    if (callbackType != napi_function)
     {
-        napi_throw_type_error(env, 0, "Incorrect number of arguments.");
+        free(ids);
+        napi_throw_type_error(env, 0, "Argument 3 (Callback) is not a function.");
         return 0;
     }
 
-    // Retrieve arguments
-    // argv[0] Channel
-    uint32_t pcanChannel;
-    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
-    assert(status == napi_ok);
+    if (pcanReplayFind(pcanChannel) != 0)
+    {
+        free(ids);
+        napi_throw_error(env, 0, "A replay is already in progress on this channel.");
+        return 0;
+    }
 
-    // argv[1] AcceptanceCode
-    uint32_t pcan_AcceptanceCode;
-    status = napi_get_value_uint32(env, argv[1], &pcan_AcceptanceCode);
-    assert(status == napi_ok);
+    pcanChannelContext_t *channelContext = pcanChannelContextFind(pcanChannel, 1);
+    if (channelContext == 0)
+    {
+        free(ids);
+        napi_throw_error(env, 0, "Too many channels are replaying.");
+        return 0;
+    }
+    pcanReplay_t **slot = &(channelContext->replay);
 
-    // argv[2] AcceptanceMask
-    uint32_t pcan_AcceptanceMask;
-    status = napi_get_value_uint32(env, argv[2], &pcan_AcceptanceMask);
+    // Create thread-safe function, called when the replay runs to its end
+    napi_value asyncResourceName;
+    status = napi_create_string_utf8(env, "pcanReplayCallback",
+                                     NAPI_AUTO_LENGTH, &asyncResourceName);
     assert(status == napi_ok);
 
-    // Build 64-bit acceptance filter value
-    uint64_t pcan_AcceptanceFilter = 0;
-    pcan_AcceptanceFilter |= ((uint64_t)pcan_AcceptanceCode << 0x20);
-    pcan_AcceptanceFilter |= ((uint64_t)(~pcan_AcceptanceMask));
-    // Note that pcan_AcceptanceMask's bits are flipped from "don't care"
-    // to "do care"
-
-    // Set the acceptance filter through the API
-    TPCANStatus pcanStatus = PCAN_ERROR_UNKNOWN;
-    pcanStatus = CAN_SetValue(pcanChannel, PCAN_ACCEPTANCE_FILTER_29BIT,
-                               &pcan_AcceptanceFilter, sizeof(pcan_AcceptanceFilter));
+    napi_threadsafe_function callback;
 
-    // Print result to console
-#ifdef PCAN_DEBUG
-    printf("pcan_CAN_AcceptanceFilter29Bit:\n"
-           "  pcanStatus            = 0x%02X (%s)\n"
-           "  pcanChannel           = 0x%02X\n"
-           "  pcan_AcceptanceCode   = 0x%08X\n"
-           "  pcan_AcceptanceMask   = 0x%08X\n"
-           "  pcan_AcceptanceFilter = 0x%016llX\n",
-           pcanStatus, pcanStatusLookup(pcanStatus),
-           pcanChannel,
-           pcan_AcceptanceCode,
-           pcan_AcceptanceMask,
-           pcan_AcceptanceFilter);
+    status = napi_create_threadsafe_function(env,
+                                             argv[3], // func
+                                             0, // async_resource
+                                             asyncResourceName,
+                                             0, // max_queue_size
+                                             1, // initial_thread_count
+                                             0, // thread_finalize_data
+                                             0, // thread_finalize_cb
+                                             0, // context
+                                             0, // call_js_cb
+                                             &callback); // result
+    assert(status == napi_ok);
+
+    // Open the file and start the replay thread
+    const char *error = 0;
+    *slot = pcanReplayStart(pcanChannel, path, &options, pcanReplayDone, callback, &error);
+    free(ids);
+
+#ifdef PCAN_DEBUG
+    printf("pcan_CAN_ReplayStart: \"%s\" (%s)\n", path, (*slot != 0) ? "OK" : error);
 #endif
 
-    // Throw error, if any
-    if (pcanStatus != PCAN_ERROR_OK)
+    if (*slot == 0)
     {
-        napi_throw_error(env, pcanStatusLookup(pcanStatus),
-                         "pcan_CAN_AcceptanceFilter29Bit");
+        status = napi_release_threadsafe_function(callback, napi_tsfn_abort);
+        assert(status == napi_ok);
+
+        napi_throw_error(env, 0, error);
         return 0;
     }
 
-    // Create an N-API value for the result and return it
     napi_value result;
-    status = napi_create_uint32(env, pcanStatus, &result);
+    status = napi_get_undefined(env, &result);
     assert(status == napi_ok);
 
-    return result;    
+    return result;
 }
 
 
-#elif defined __APPLE__
-napi_value pcan_CAN_AcceptanceFilter29Bit(napi_env env, napi_callback_info info)
+
+
+napi_value pcan_CAN_ReplayStop(napi_env env, napi_callback_info info)
 {
     napi_status status = napi_generic_failure;
 
-    // Create an N-API value for the result and return it
-    napi_value result;
-    status = napi_create_uint32(env, 0, &result);
+    // Retrieve callback info and arguments list
+    size_t argc = CAN_REPLAYSTOP_ARGC;
+    napi_value argv[CAN_REPLAYSTOP_ARGC];
+
+    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
     assert(status == napi_ok);
 
-    return result;    
-}
+    if (argc != CAN_REPLAYSTOP_ARGC)
+    {
+        napi_throw_type_error(env, 0, "Incorrect number of arguments.");
+        return 0;
+    }
+
+    // Retrieve arguments
+    // argv[0] Channel
+    uint32_t pcanChannel;
+    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
+    assert(status == napi_ok);
+
+    pcanReplay_t **slot = pcanReplayFind(pcanChannel);
+    if (slot == 0)
+    {
+        napi_throw_error(env, 0, "No replay is in progress on this channel.");
+        return 0;
+    }
+
+    // Wait for the replay thread to exit, after which it can no longer call
+    // the completion callback
+    napi_threadsafe_function callback = (napi_threadsafe_function)(*slot)->doneContext;
+    pcanReplayStats_t stats = { 0 };
+    pcanReplayStop(*slot, &stats);
+    *slot = 0;
 
+    status = napi_release_threadsafe_function(callback, napi_tsfn_release);
+    assert(status == napi_ok);
 
+#ifdef PCAN_DEBUG
+    printf("pcan_CAN_ReplayStop: %llu frames, %llu late\n",
+           (unsigned long long)stats.frames, (unsigned long long)stats.late);
 #endif
 
+    return pcanReplayStatsValue(env, &stats);
+}
 
 
 
-napi_value pcan_CAN_ChannelInfo(napi_env env, napi_callback_info info)
+
+napi_value pcan_CAN_ReplayStats(napi_env env, napi_callback_info info)
 {
     napi_status status = napi_generic_failure;
-    int i; // for loop variable
 
-    // Get callback info and argument list
-    size_t argc = CAN_CHANNELINFO_ARGC;
-    napi_value argv;
+    // Retrieve callback info and arguments list
+    size_t argc = CAN_REPLAYSTATS_ARGC;
+    napi_value argv[CAN_REPLAYSTATS_ARGC];
 
-    status = napi_get_cb_info(env, info, &argc, &argv, 0, 0);
+    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
     assert(status == napi_ok);
 
-    if (argc != CAN_CHANNELINFO_ARGC)
+    if (argc != CAN_REPLAYSTATS_ARGC)
     {
         napi_throw_type_error(env, 0, "Incorrect number of arguments.");
         return 0;
     }
 
-    // Get channel count
-    TPCANStatus pcanStatus = PCAN_ERROR_UNKNOWN;
-    int32_t pcanAttachedChannelsCount = 0;
+    // Retrieve arguments
+    // argv[0] Channel
+    uint32_t pcanChannel;
+    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
+    assert(status == napi_ok);
 
-    pcanStatus = CAN_GetValue(PCAN_NONEBUS, PCAN_ATTACHED_CHANNELS_COUNT,
-                              &pcanAttachedChannelsCount, sizeof(pcanAttachedChannelsCount));
-    if (pcanStatus != PCAN_ERROR_OK)
+    pcanReplay_t **slot = pcanReplayFind(pcanChannel);
+    if (slot == 0)
     {
-        napi_throw_error(env, pcanStatusLookup(pcanStatus),
-                         "pcan_CAN_ChannelInfo: Error at CAN_GetValue(PCAN_ATTACHED_CHANNELS_COUNT).");
+        napi_throw_error(env, 0, "No replay is in progress on this channel.");
         return 0;
     }
-    
-    // Check that there are > 0 channels available
-    if (pcanAttachedChannelsCount == 0)
+
+    pcanReplayStats_t stats = { 0 };
+    pcanReplayGetStats(*slot, &stats);
+
+    return pcanReplayStatsValue(env, &stats);
+}
+
+
+
+
+napi_value pcan_CAN_DetectStart(napi_env env, napi_callback_info info)
+{
+    napi_status status = napi_generic_failure;
+
+    // Retrieve callback info and arguments list
+    size_t argc = CAN_DETECTSTART_ARGC;
+    napi_value argv[CAN_DETECTSTART_ARGC];
+
+    status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
+    assert(status == napi_ok);
+
+    if (argc != CAN_DETECTSTART_ARGC)
     {
-        napi_throw_error(env, "PCAN_ERROR_NOCHANNELS", "No PCAN channels available");
+        napi_throw_type_error(env, 0, "Incorrect number of arguments.");
         return 0;
     }
 
-#ifdef PCAN_DEBUG
-    printf("pcan_CAN_ChannelInfo: %i channel(s) available\n", pcanAttachedChannelsCount);
-#endif
+    // Retrieve arguments
+    // argv[0] Channel
+    uint32_t pcanChannel;
+    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
+    assert(status == napi_ok);
 
-    // Create empty channel list
-    // Use of malloc and free here violates CSLLC Rule 163
-    TPCANChannelInformation *pcanAttachedChannels = 0;
-    size_t pcanAttachedChannels_sz;
-    pcanAttachedChannels_sz = sizeof(TPCANChannelInformation) * pcanAttachedChannelsCount;
-    pcanAttachedChannels = malloc(pcanAttachedChannels_sz);
+    // argv[1] Candidates (array of BTR0BTR1 values)
+    bool isArray = false;
+    status = napi_is_array(env, argv[1], &isArray);
+    assert(status == napi_ok);
 
-    if (pcanAttachedChannels == 0)
+    if (!isArray)
     {
-        napi_throw_error(env, 0, "Error allocating memory for TPCANChannelInformation.");
+        napi_throw_type_error(env, 0, "Argument 1 (Candidates) is not an array.");
         return 0;
     }
 
-    memset(pcanAttachedChannels, 0, pcanAttachedChannels_sz);
+    TPCANBaudrate candidates[PCAN_DETECT_CANDIDATES_MAX];
+    uint32_t count = 0;
+    uint32_t btr0btr1;
+    uint32_t i;
+    napi_value element;
 
-    // Get channel list
-    pcanStatus = CAN_GetValue(PCAN_NONEBUS, PCAN_ATTACHED_CHANNELS,
-                              pcanAttachedChannels, pcanAttachedChannels_sz);
-    if (pcanStatus != PCAN_ERROR_OK)
+    status = napi_get_array_length(env, argv[1], &count);
+    assert(status == napi_ok);
+
+    if ((count == 0) || (count > PCAN_DETECT_CANDIDATES_MAX))
     {
-        napi_throw_error(env, pcanStatusLookup(pcanStatus),
-                         "pcan_CAN_ChannelInfo: Error at CAN_GetValue(PCAN_ATTACHED_CHANNELS).");
+        napi_throw_range_error(env, 0, "Bit rate detection needs between 1 and 32 candidates.");
         return 0;
     }
 
-    // Print result to console
-#ifdef PCAN_DEBUG
-    for (i = 0; i < pcanAttachedChannelsCount; i++)
+    for (i = 0; i < count; i++)
     {
-        pcanDumpChannelInfo(&(pcanAttachedChannels[i]));
+        status = napi_get_element(env, argv[1], i, &element);
+        assert(status == napi_ok);
+        status = napi_get_value_uint32(env, element, &btr0btr1);
+        if (status != napi_ok)
+        {
+            napi_throw_type_error(env, 0, "Candidates contains a non-number.");
+            return 0;
+        }
+        candidates[i] = (TPCANBaudrate)btr0btr1;
     }
-#endif
 
-    // Create parent N-API object for channel info array
-    napi_value channelInfo;
-    status = napi_create_array(env, &channelInfo);
+    // argv[2] Options; all properties are optional, and left at 0 for the
+    // defaults in pcan_detect.h
+    pcanDetectOptions_t options = { 0 };
+    double value = 0;
+
+    if (napiGetOptionalDouble(env, argv[2], "timeoutMs", &value) && (value > 0))
+    {
+        options.timeoutUs = (uint64_t)(value * 1000);
+    }
+    if (napiGetOptionalDouble(env, argv[2], "dwellMs", &value) && (value > 0))
+    {
+        options.dwellUs = (uint64_t)(value * 1000);
+    }
+    if (napiGetOptionalDouble(env, argv[2], "minFrames", &value) && (value >= 1))
+    {
+        options.minFrames = (uint32_t)value;
+    }
+    if (napiGetOptionalDouble(env, argv[2], "rejectErrors", &value) && (value >= 1))
+    {
+        options.rejectErrors = (uint32_t)value;
+    }
+
+    // argv[3] Callback
+    napi_valuetype callbackType;
+    status = napi_typeof(env, argv[3], &callbackType);
     assert(status == napi_ok);
 
-    napi_value channelInfoElement;
-    napi_value channelInfoElementChannelHandle;
-    napi_value channelInfoElementDeviceType;
-    napi_value channelInfoElementControllerNumber;
-    napi_value channelInfoElementDeviceFeatures;
-    napi_value channelInfoElementDeviceName;
-    napi_value channelInfoElementDeviceID;
-    napi_value channelInfoElementChannelCondition;
+    if (callbackType != napi_function)
+    {
+        napi_throw_type_error(env, 0, "Argument 3 (Callback) is not a function.");
+        return 0;
+    }
 
-    for (i = 0; i < pcanAttachedChannelsCount; i++)
+    if (pcanDetectFind(pcanChannel) != 0)
     {
-        // Create N-API object for array element
-        status = napi_create_object(env, &channelInfoElement);
-        assert(status == napi_ok);
+        napi_throw_error(env, 0, "A bit rate detection is already in progress on this channel.");
+        return 0;
+    }
 
-        // Assign properties
-        // - Channel handle
-        status = napi_create_uint32(env, pcanAttachedChannels[i].channel_handle,
-                                   &channelInfoElementChannelHandle);
-        assert(status == napi_ok);
-        status = napi_set_named_property(env, channelInfoElement, "channel_handle",
-                                         channelInfoElementChannelHandle);
-        assert(status == napi_ok);
+    pcanChannelContext_t *channelContext = pcanChannelContextFind(pcanChannel, 1);
+    if (channelContext == 0)
+    {
+        napi_throw_error(env, 0, "Too many channels are detecting their bit rate.");
+        return 0;
+    }
+    pcanDetect_t **slot = &(channelContext->detect);
 
-        // - Device type
-        status = napi_create_uint32(env, pcanAttachedChannels[i].device_type,
-                                    &channelInfoElementDeviceType);
-        assert(status == napi_ok);
-        status = napi_set_named_property(env, channelInfoElement, "device_type",
-                                         channelInfoElementDeviceType);
-        assert(status == napi_ok);
+    // Create thread-safe function, called when the scan finishes
+    napi_value asyncResourceName;
+    status = napi_create_string_utf8(env, "pcanDetectCallback",
+                                     NAPI_AUTO_LENGTH, &asyncResourceName);
+    assert(status == napi_ok);
 
-        // - Controller number
-        status = napi_create_uint32(env, pcanAttachedChannels[i].controller_number,
-                                    &channelInfoElementControllerNumber);
-        assert(status == napi_ok);
-        status = napi_set_named_property(env, channelInfoElement, "controller_number",
-                                          channelInfoElementControllerNumber);
-        assert(status == napi_ok);
+    napi_threadsafe_function callback;
 
-        // - Device features
-        status = napi_create_uint32(env, pcanAttachedChannels[i].device_features,
-                                    &channelInfoElementDeviceFeatures);
-        assert(status == napi_ok);
-        status = napi_set_named_property(env, channelInfoElement, "device_features",
-                                          channelInfoElementDeviceFeatures);
-        assert(status == napi_ok);
-        
-        // - Device name
-        status = napi_create_string_utf8(env, pcanAttachedChannels[i].device_name,
-                                         NAPI_AUTO_LENGTH, &channelInfoElementDeviceName);
-        assert(status == napi_ok);
-        status = napi_set_named_property(env, channelInfoElement, "device_name",
-                                          channelInfoElementDeviceName);
+    status = napi_create_threadsafe_function(env,
+                                             argv[3], // func
+                                             0, // async_resource
+                                             asyncResourceName,
+                                             0, // max_queue_size
+                                             1, // initial_thread_count
+                                             0, // thread_finalize_data
+                                             0, // thread_finalize_cb
+                                             0, // context
+                                             0, // call_js_cb
+                                             &callback); // result
+    assert(status == napi_ok);
 
-        // - Device ID
-        status = napi_create_uint32(env, pcanAttachedChannels[i].device_id,
-                                    &channelInfoElementDeviceID);
-        assert(status == napi_ok);
-        status = napi_set_named_property(env, channelInfoElement, "device_id",
-                                          channelInfoElementDeviceID);
+    // Start the detection thread
+    const char *error = 0;
+    *slot = pcanDetectStart(pcanChannel, candidates, count, &options, pcanDetectDone, callback,
+                            &error);
 
-        // - Channel condition
-        status = napi_create_uint32(env, pcanAttachedChannels[i].channel_condition,
-                                    &channelInfoElementChannelCondition);
-        assert(status == napi_ok);
-        status = napi_set_named_property(env, channelInfoElement, "channel_condition",
-                                          channelInfoElementChannelCondition);
+#ifdef PCAN_DEBUG
+    printf("pcan_CAN_DetectStart: %u candidates (%s)\n", count, (*slot != 0) ? "OK" : error);
+#endif
 
-        // Add complete element to array
-        status = napi_set_element(env, channelInfo, i, channelInfoElement);
+    if (*slot == 0)
+    {
+        status = napi_release_threadsafe_function(callback, napi_tsfn_abort);
         assert(status == napi_ok);
+
+        napi_throw_error(env, 0, error);
+        return 0;
     }
 
-    // Free dynamically allocated memory
-    free(pcanAttachedChannels);
+    napi_value result;
+    status = napi_get_undefined(env, &result);
+    assert(status == napi_ok);
 
-    // Return the N-API object
-    return channelInfo;
+    return result;
 }
 
 
 
 
-napi_value pcan_CAN_TranslateBaud(napi_env env, napi_callback_info info)
+napi_value pcan_CAN_DetectStop(napi_env env, napi_callback_info info)
 {
     napi_status status = napi_generic_failure;
 
-    // Get callback info and argument list
-    size_t argc = CAN_TRANSLATEBAUD_ARGC;
-    napi_value argv[CAN_TRANSLATEBAUD_ARGC];
+    // Retrieve callback info and arguments list
+    size_t argc = CAN_DETECTSTOP_ARGC;
+    napi_value argv[CAN_DETECTSTOP_ARGC];
 
     status = napi_get_cb_info(env, info, &argc, argv, 0, 0);
     assert(status == napi_ok);
 
-    if (argc != CAN_TRANSLATEBAUD_ARGC)
+    if (argc != CAN_DETECTSTOP_ARGC)
     {
         napi_throw_type_error(env, 0, "Incorrect number of arguments.");
         return 0;
     }
 
     // Retrieve arguments
-    // argv[0] Integer baud
-    uint32_t baudInt;
-    status = napi_get_value_uint32(env, argv[0], &baudInt);
+    // argv[0] Channel
+    uint32_t pcanChannel;
+    status = napi_get_value_uint32(env, argv[0], &pcanChannel);
     assert(status == napi_ok);
 
-    // Translate into a PCAN-Basic constant
-    TPCANBaudrate baudAPI;
-    baudAPI = pcanTranslateBaud(baudInt);
-
-    if (baudAPI == 0)
+    pcanDetect_t **slot = pcanDetectFind(pcanChannel);
+    if (slot == 0)
     {
-        napi_throw_error(env, 0, "Unknown CAN baud specified.");
+        napi_throw_error(env, 0, "No bit rate detection is in progress on this channel.");
         return 0;
     }
 
-    // Print result to console
-#ifdef PCAN_DEBUG
-    printf("pcan_CAN_TranslateBaud: baudInt = %i, baudAPI = 0x%04X\n",
-           baudInt, baudAPI);
-#endif
+    // Wait for the detection thread to exit, after which it can no longer call
+    // the completion callback
+    napi_threadsafe_function callback = (napi_threadsafe_function)(*slot)->doneContext;
+    pcanDetectResult_t result;
+    pcanDetectStop(*slot, &result);
+    *slot = 0;
 
-    // Create N-API value to return
-    napi_value baudResult;
-    status = napi_create_uint32(env, baudAPI, &baudResult);
+    status = napi_release_threadsafe_function(callback, napi_tsfn_release);
     assert(status == napi_ok);
 
-    return baudResult;
-}
+#ifdef PCAN_DEBUG
+    printf("pcan_CAN_DetectStop: candidate %d\n", result.index);
+#endif
 
+    return pcanDetectResultValue(env, &result);
+}
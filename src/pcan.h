@@ -46,8 +46,55 @@
 #define CAN_DISABLEEVENT_ARGC (1)
 #define CAN_ACCEPTANCEFILTER11BIT_ARGC (3)
 #define CAN_ACCEPTANCEFILTER29BIT_ARGC (3)
+#define CAN_RECEIVECONFIGURE_ARGC (2)
 #define CAN_CHANNELINFO_ARGC (0)
 #define CAN_TRANSLATEBAUD_ARGC (1)
+#define CAN_BITTIMING_ARGC (1)
+#define CAN_READBATCH_ARGC (1)
+#define CAN_WRITEBATCH_ARGC (3)
+#define CAN_WRITEBATCHFD_ARGC (3)
+#define CAN_TRANSMITSTART_ARGC (3)
+#define CAN_TRANSMITPUSH_ARGC (3)
+#define CAN_TRANSMITCANCEL_ARGC (3)
+#define CAN_TRANSMITRESULTS_ARGC (1)
+#define CAN_TRANSMITSTATS_ARGC (1)
+#define CAN_TRANSMITSOURCE_ARGC (3)
+#define CAN_TRANSMITSOURCESTATS_ARGC (2)
+#define CAN_TRANSMITLATENCY_ARGC (1)
+#define CAN_TRANSMITSTOP_ARGC (1)
+#define CAN_CYCLICADD_ARGC (4)
+#define CAN_CYCLICUPDATE_ARGC (3)
+#define CAN_CYCLICREMOVE_ARGC (2)
+#define CAN_CYCLICSTATS_ARGC (2)
+#define CAN_CYCLICSTOP_ARGC (1)
+#define CAN_TIMEDSTART_ARGC (2)
+#define CAN_TIMEDAT_ARGC (3)
+#define CAN_TIMEDAFTER_ARGC (4)
+#define CAN_TIMEDCANCEL_ARGC (2)
+#define CAN_TIMEDRESULTS_ARGC (1)
+#define CAN_TIMEDSTOP_ARGC (1)
+#define CAN_REQUESTSTART_ARGC (2)
+#define CAN_REQUESTSEND_ARGC (3)
+#define CAN_REQUESTCANCEL_ARGC (2)
+#define CAN_REQUESTRESULTS_ARGC (1)
+#define CAN_REQUESTSTOP_ARGC (1)
+#define CAN_STARTCAPTURE_ARGC (3)
+#define CAN_STOPCAPTURE_ARGC (1)
+#define CAN_CAPTURESTATS_ARGC (1)
+#define CAN_READEROPEN_ARGC (2)
+#define CAN_READERINFO_ARGC (1)
+#define CAN_READERQUERY_ARGC (4)
+#define CAN_READERNEXT_ARGC (2)
+#define CAN_READERCLOSE_ARGC (1)
+#define CAN_TRCOPEN_ARGC (1)
+#define CAN_TRCINFO_ARGC (1)
+#define CAN_TRCNEXT_ARGC (2)
+#define CAN_TRCCLOSE_ARGC (1)
+#define CAN_REPLAYSTART_ARGC (4)
+#define CAN_REPLAYSTOP_ARGC (1)
+#define CAN_REPLAYSTATS_ARGC (1)
+#define CAN_DETECTSTART_ARGC (4)
+#define CAN_DETECTSTOP_ARGC (1)
 
 
 // ----------------------------------- // -----------------------------------
@@ -66,9 +113,10 @@
 // Local functions
 
 
-// Wrapper callback function that calls the napi_threadsafe_function specified
-// in pcan_CAN_EnableEvent
-void pcan_CAN_EventCallback(int channel);
+// Wrapper callback function, called on a channel's worker thread with its
+// receive path, that drains the driver and calls the napi_threadsafe_function
+// specified in pcan_CAN_EnableEvent
+void pcan_CAN_EventCallback(void *context);
 
 
 // Initialize N-API module
@@ -282,6 +330,23 @@ napi_value pcan_CAN_AcceptanceFilter29Bit(napi_env env, napi_callback_info info)
 #endif
 
 
+// Set the filters applied by the native receive path to frames on their way
+// to JavaScript, and whether frames sent on the bus are looped back among
+// them. These take effect at once if the receive event is enabled on the
+// channel, and otherwise once it is.
+// Arguments passed through N-API:
+// - TPCANHandle Channel (uint32)
+// - Options (object) { filters, loopback }, where filters is an array of up
+//   to PCAN_RECEIVE_FILTERS_MAX objects { ext, fromId, toId, code, mask } (see
+//   pcanReceiveFilter_t; by default, fromId to toId spans every identifier
+//   and mask is all ones, leaving code unchecked), and loopback (default false) delivers the driver's echo
+//   frames, which must be enabled with PCAN_ALLOW_ECHO_FRAMES
+// Returns undefined, and error is thrown upon failure.
+#ifndef PCAN_NO_NAPI
+napi_value pcan_CAN_ReceiveConfigure(napi_env env, napi_callback_info info);
+#endif
+
+
 // Return list of available PCAN channels on the system
 // Arguments passed through N-API:
 // - (none)
@@ -302,6 +367,588 @@ napi_value pcan_CAN_TranslateBaud(napi_env env, napi_callback_info info);
 #endif
 
 
+// Search for the bit timings closest to a bit rate and sample point, for
+// CAN_Initialize or, if a data bit rate is given, CAN_InitializeFD
+// Arguments passed through N-API:
+// - Options (object):
+//   - bitrate (number), nominal bit rate, in bit/s
+//   - samplePoint (number, optional), as a fraction of the bit; 0.875 by
+//     default, or 0.8 for CAN FD
+//   - dataBitrate (number, optional), bit rate of the CAN FD data phase
+//   - dataSamplePoint (number, optional), 0.75 by default
+//   - clockMhz (number, optional), the only CAN FD clock to try
+//   - max (number, optional), most timings to return; 8 by default
+// Returns an array of timings, best first. Each classic timing is
+// { clockMhz, brp, tseg1, tseg2, sjw, bitrate, samplePoint, error,
+// btr0btr1 }, where error is the deviation from the bit rate asked for, as a
+// fraction. Each CAN FD timing is { clockMhz, error, nominal, data,
+// bitrateFD }, with a classic timing (without btr0btr1) for each phase. Error
+// is thrown if a bit rate or sample point is out of range.
+#ifndef PCAN_NO_NAPI
+napi_value pcan_CAN_BitTiming(napi_env env, napi_callback_info info);
+#endif
+
+
+// Collect frames received since the last call, drained from the driver by the
+// worker thread enabled with pcan_CAN_EnableEvent.
+// Arguments passed through N-API:
+// - TPCANHandle Channel (uint32)
+// Returns a Buffer of packed pcanFrame_t records (PCAN_FRAME_SIZE bytes each),
+// or of pcanFrameFD_t records (PCAN_FRAME_FD_SIZE bytes each) if the channel
+// was initialized with pcan_CAN_InitializeFD, which is empty if no frames are
+// waiting. Error is thrown if the receive event is not enabled on the
+// channel.
+#ifndef PCAN_NO_NAPI
+napi_value pcan_CAN_ReadBatch(napi_env env, napi_callback_info info);
+#endif
+
+
+// Transmit frames from a Buffer of packed records in a single call, writing
+// them in order until the driver's transmit queue is full.
+// Arguments passed through N-API:
+// - TPCANHandle Channel (uint32)
+// - FrameBuffer (Buffer of packed pcanFrame_t records, PCAN_FRAME_SIZE bytes
+//   each; timestamp and flags are ignored)
+// - Count (uint32), number of records to write
+// Returns the number of frames accepted, which is less than Count if
+// PCAN_ERROR_QXMTFULL was returned or another error followed an accepted
+// frame. Error is thrown if the first frame fails for any other reason.
+#ifndef PCAN_NO_NAPI
+napi_value pcan_CAN_WriteBatch(napi_env env, napi_callback_info info);
+#endif
+
+
+// Transmit CAN FD frames from a Buffer of packed records in a single call, as
+// pcan_CAN_WriteBatch does, on a channel initialized with
+// pcan_CAN_InitializeFD.
+// Arguments passed through N-API:
+// - TPCANHandle Channel (uint32)
+// - FrameBuffer (Buffer of packed pcanFrameFD_t records, PCAN_FRAME_FD_SIZE
+//   bytes each; timestamp and flags are ignored, and a length between two
+//   DLC codes is padded with zeros to the next)
+// - Count (uint32), number of records to write
+// Returns the number of frames accepted, as pcan_CAN_WriteBatch does
+#ifndef PCAN_NO_NAPI
+napi_value pcan_CAN_WriteBatchFD(napi_env env, napi_callback_info info);
+#endif
+
+
+// Start a transmit queue for a channel, drained by a writer thread that
+// retries while the driver's queue is full and holds frames while the
+// controller is bus-off.
+// Arguments passed through N-API:
+// - TPCANHandle Channel (uint32)
+// - Options (object), with optional properties queueSize (number of frames),
+//   priority (true to write pending frames in arbitration order), bitrate
+//   (bits per second), maxLoad (percent of the bus that written frames
+//   may take up, or 0 for no limit; needs bitrate), confirm (true to record
+//   results only once the driver echoes frames back, which must be enabled
+//   with PCAN_ALLOW_ECHO_FRAMES), and confirmTimeoutMs (time to wait for an
+//   echo before giving up on a frame)
+// - Callback (function), called when results are waiting to be collected
+//   with pcan_CAN_TransmitResults
+// Returns undefined, and error is thrown upon failure.
+#ifndef PCAN_NO_NAPI
+napi_value pcan_CAN_TransmitStart(napi_env env, napi_callback_info info);
+#endif
+
+
+// Queue frames from a Buffer of packed records for transmission. Frames are
+// numbered consecutively from 0, in the order they are queued.
+// Arguments passed through N-API:
+// - TPCANHandle Channel (uint32)
+// - FrameBuffer (Buffer of packed pcanFrame_t records, PCAN_FRAME_SIZE bytes
+//   each; timestamp is the time to live in microseconds, or 0 for none, and
+//   of the flags, only PCAN_FRAME_FLAG_COALESCE is used)
+// - Count (uint32), number of records to queue
+// Returns the number of frames queued, which is less than Count if the queue
+// is full. Error is thrown if the queue is not started.
+#ifndef PCAN_NO_NAPI
+napi_value pcan_CAN_TransmitPush(napi_env env, napi_callback_info info);
+#endif
+
+
+// Cancel the queued frames with an identifier that are not yet being written.
+// Their results carry PCAN_TRANSMIT_STATUS_CANCELLED.
+// Arguments passed through N-API:
+// - TPCANHandle Channel (uint32)
+// - ID (uint32)
+// - Extended (boolean), true for an extended identifier
+// Returns the number of frames cancelled, and error is thrown if the queue is
+// not started.
+#ifndef PCAN_NO_NAPI
+napi_value pcan_CAN_TransmitCancel(napi_env env, napi_callback_info info);
+#endif
+
+
+// Collect the results of queued frames, in the order they were written.
+// Arguments passed through N-API:
+// - TPCANHandle Channel (uint32)
+// Returns a Buffer of packed pcanTransmitResult_t records
+// (PCAN_TRANSMIT_RESULT_SIZE bytes each), which is empty if none are waiting.
+#ifndef PCAN_NO_NAPI
+napi_value pcan_CAN_TransmitResults(napi_env env, napi_callback_info info);
+#endif
+
+
+// Get statistics for a transmit queue.
+// Arguments passed through N-API:
+// - TPCANHandle Channel (uint32)
+// Returns transmit statistics object { queued, sent, errors, cancelled,
+// replaced, expired, retries, busOffs, paced, confirmed, unconfirmed,
+// discarded, pending, unsent, busOff, load, lastError }, and error is thrown
+// if the queue is not started.
+#ifndef PCAN_NO_NAPI
+napi_value pcan_CAN_TransmitStats(napi_env env, napi_callback_info info);
+#endif
+
+
+// Create a transmit source, or change its settings. Frames carry their
+// source's index in the record's source byte.
+// Arguments passed through N-API:
+// - TPCANHandle Channel (uint32)
+// - Source (uint32), from 0 to PCAN_TRANSMIT_SOURCES_MAX - 1
+// - Options (object), all optional: { weight, rate, burst }; weight (default
+//   1) is the source's share of the bus relative to the others, rate (default
+//   0, no limit) caps its frames per second, and burst (default 1) is the
+//   number it may send back to back within that cap
+// Returns undefined, and error is thrown if the queue is not started or the
+// source is out of range.
+#ifndef PCAN_NO_NAPI
+napi_value pcan_CAN_TransmitSource(napi_env env, napi_callback_info info);
+#endif
+
+
+// Get statistics for a transmit source.
+// Arguments passed through N-API:
+// - TPCANHandle Channel (uint32)
+// - Source (uint32)
+// Returns source statistics object { queued, sent, throttled, pending,
+// meanLatencyUs, maxLatencyUs }, and error is thrown if the queue is not
+// started or the source has not been used.
+#ifndef PCAN_NO_NAPI
+napi_value pcan_CAN_TransmitSourceStats(napi_env env, napi_callback_info info);
+#endif
+
+
+// Get the histogram of the time confirmed frames took from being queued to
+// being sent on the bus.
+// Arguments passed through N-API:
+// - TPCANHandle Channel (uint32)
+// Returns latency object { count, meanUs, maxUs, p50Us, p90Us, p99Us,
+// buckets }, where buckets is an array of counts (see
+// PCAN_TRANSMIT_LATENCY_BUCKETS) and each percentile is the upper bound of
+// the bucket it falls in, and error is thrown if the queue is not started.
+#ifndef PCAN_NO_NAPI
+napi_value pcan_CAN_TransmitLatency(napi_env env, napi_callback_info info);
+#endif
+
+
+// Stop a transmit queue, discarding any frames not yet written.
+// Arguments passed through N-API:
+// - TPCANHandle Channel (uint32)
+// Returns transmit statistics object, as for pcan_CAN_TransmitStats, and error
+// is thrown if the queue is not started.
+#ifndef PCAN_NO_NAPI
+napi_value pcan_CAN_TransmitStop(napi_env env, napi_callback_info info);
+#endif
+
+
+// Send a frame periodically from the channel's cyclic scheduler thread,
+// starting the scheduler if need be.
+// Arguments passed through N-API:
+// - TPCANHandle Channel (uint32)
+// - FrameBuffer (Buffer holding one packed pcanFrame_t record; timestamp and
+//   flags are ignored)
+// - PeriodUs (number), interval between transmissions in microseconds
+// - Options (object), with optional properties count (transmissions before
+//   the message stops, or 0 for no limit) and phase (delay before the first
+//   transmission in microseconds)
+// Returns the message handle (uint32), and error is thrown upon failure.
+#ifndef PCAN_NO_NAPI
+napi_value pcan_CAN_CyclicAdd(napi_env env, napi_callback_info info);
+#endif
+
+
+// Replace the frame sent by a cyclic message, keeping its schedule.
+// Arguments passed through N-API:
+// - TPCANHandle Channel (uint32)
+// - Handle (uint32), as returned by pcan_CAN_CyclicAdd
+// - FrameBuffer (Buffer holding one packed pcanFrame_t record)
+// Returns undefined, and error is thrown if there is no such message.
+#ifndef PCAN_NO_NAPI
+napi_value pcan_CAN_CyclicUpdate(napi_env env, napi_callback_info info);
+#endif
+
+
+// Stop sending a cyclic message.
+// Arguments passed through N-API:
+// - TPCANHandle Channel (uint32)
+// - Handle (uint32), as returned by pcan_CAN_CyclicAdd
+// Returns the message's final statistics, as for pcan_CAN_CyclicStats, and
+// error is thrown if there is no such message.
+#ifndef PCAN_NO_NAPI
+napi_value pcan_CAN_CyclicRemove(napi_env env, napi_callback_info info);
+#endif
+
+
+// Get statistics for a cyclic message.
+// Arguments passed through N-API:
+// - TPCANHandle Channel (uint32)
+// - Handle (uint32), as returned by pcan_CAN_CyclicAdd
+// Returns cyclic statistics object { sent, errors, late, missed, meanLateUs,
+// maxLateUs, lastLateUs, remaining, active, lastError }, and error is thrown
+// if there is no such message.
+#ifndef PCAN_NO_NAPI
+napi_value pcan_CAN_CyclicStats(napi_env env, napi_callback_info info);
+#endif
+
+
+// Stop a channel's cyclic scheduler, and forget all of its messages.
+// Arguments passed through N-API:
+// - TPCANHandle Channel (uint32)
+// Returns undefined; nothing is done if the scheduler is not started.
+#ifndef PCAN_NO_NAPI
+napi_value pcan_CAN_CyclicStop(napi_env env, napi_callback_info info);
+#endif
+
+
+// Start timed transmission for a channel, whose thread writes single frames
+// at given times or after received triggers. Triggers are only seen if the
+// receive event is already enabled on the channel.
+// Arguments passed through N-API:
+// - TPCANHandle Channel (uint32)
+// - Callback (function), called when results are waiting to be collected
+//   with pcan_CAN_TimedResults
+// Returns undefined, and error is thrown upon failure.
+#ifndef PCAN_NO_NAPI
+napi_value pcan_CAN_TimedStart(napi_env env, napi_callback_info info);
+#endif
+
+
+// Write a frame at a time on the host's monotonic clock.
+// Arguments passed through N-API:
+// - TPCANHandle Channel (uint32)
+// - FrameBuffer (Buffer), holding one packed pcanFrame_t record
+// - HostTimeUs (number), time to write it, as returned by pcan_CAN_HostTime;
+//   a time already past writes it at once
+// Returns a handle (uint32) for the frame, and error is thrown if timed
+// transmission is not started or too many frames are waiting.
+#ifndef PCAN_NO_NAPI
+napi_value pcan_CAN_TimedAt(napi_env env, napi_callback_info info);
+#endif
+
+
+// Write a frame a delay after the next received frame that matches a
+// trigger. The delay counts from when the trigger was read from the driver.
+// Arguments passed through N-API:
+// - TPCANHandle Channel (uint32)
+// - FrameBuffer (Buffer), holding one packed pcanFrame_t record
+// - Trigger (object) { id, mask, ext }; a received frame matches if its
+//   identifier equals id in the bits set in mask (by default, all of them),
+//   and it is extended if ext is true (default false)
+// - DelayUs (number)
+// Returns a handle (uint32) for the frame, and error is thrown if timed
+// transmission is not started, the receive event is not enabled, or too many
+// frames are waiting.
+#ifndef PCAN_NO_NAPI
+napi_value pcan_CAN_TimedAfter(napi_env env, napi_callback_info info);
+#endif
+
+
+// Cancel a timed frame that is not yet being written. Its result carries
+// PCAN_TIMED_STATUS_CANCELLED.
+// Arguments passed through N-API:
+// - TPCANHandle Channel (uint32)
+// - Handle (uint32), as returned by pcan_CAN_TimedAt or pcan_CAN_TimedAfter
+// Returns true if the frame was cancelled, and error is thrown if timed
+// transmission is not started.
+#ifndef PCAN_NO_NAPI
+napi_value pcan_CAN_TimedCancel(napi_env env, napi_callback_info info);
+#endif
+
+
+// Collect the results of timed frames, in the order they were settled.
+// Arguments passed through N-API:
+// - TPCANHandle Channel (uint32)
+// Returns a Buffer of packed pcanTimedResult_t records
+// (PCAN_TIMED_RESULT_SIZE bytes each), which is empty if none are waiting.
+#ifndef PCAN_NO_NAPI
+napi_value pcan_CAN_TimedResults(napi_env env, napi_callback_info info);
+#endif
+
+
+// Stop a channel's timed transmission, discarding any frames still waiting.
+// Arguments passed through N-API:
+// - TPCANHandle Channel (uint32)
+// Returns undefined; nothing is done if it is not started.
+#ifndef PCAN_NO_NAPI
+napi_value pcan_CAN_TimedStop(napi_env env, napi_callback_info info);
+#endif
+
+
+// Start request/response matching for a channel. Replies are only seen if the
+// receive event is already enabled on the channel.
+// Arguments passed through N-API:
+// - TPCANHandle Channel (uint32)
+// - Callback (function), called when replies are waiting to be collected
+//   with pcan_CAN_RequestResults
+// Returns undefined, and error is thrown upon failure.
+#ifndef PCAN_NO_NAPI
+napi_value pcan_CAN_RequestStart(napi_env env, napi_callback_info info);
+#endif
+
+
+// Write a request frame, and wait for the next received frame that answers
+// it. The round-trip time counts from just before the request is written to
+// when the reply is read from the driver.
+// Arguments passed through N-API:
+// - TPCANHandle Channel (uint32)
+// - FrameBuffer (Buffer), holding one packed pcanFrame_t record
+// - Match (object) { id, mask, ext, prefix }; a received frame answers the
+//   request if its identifier equals id in the bits set in mask (by default,
+//   all of them), it is extended if ext is true (default false), and its data
+//   starts with the bytes of the prefix Buffer (default none)
+// Returns a handle (uint32) for the request, and error is thrown if matching
+// is not started, the receive event is not enabled, too many requests are
+// waiting, or the write fails.
+#ifndef PCAN_NO_NAPI
+napi_value pcan_CAN_RequestSend(napi_env env, napi_callback_info info);
+#endif
+
+
+// Stop waiting for the reply to a request.
+// Arguments passed through N-API:
+// - TPCANHandle Channel (uint32)
+// - Handle (uint32), as returned by pcan_CAN_RequestSend
+// Returns true if the request was cancelled, or false if its reply has
+// already been recorded, and error is thrown if matching is not started.
+#ifndef PCAN_NO_NAPI
+napi_value pcan_CAN_RequestCancel(napi_env env, napi_callback_info info);
+#endif
+
+
+// Collect replies to requests, in the order they were received.
+// Arguments passed through N-API:
+// - TPCANHandle Channel (uint32)
+// Returns a Buffer of packed pcanRequestResult_t records
+// (PCAN_REQUEST_RESULT_SIZE bytes each), which is empty if none are waiting.
+#ifndef PCAN_NO_NAPI
+napi_value pcan_CAN_RequestResults(napi_env env, napi_callback_info info);
+#endif
+
+
+// Stop a channel's request/response matching, discarding any requests still
+// waiting.
+// Arguments passed through N-API:
+// - TPCANHandle Channel (uint32)
+// Returns undefined; nothing is done if it is not started.
+#ifndef PCAN_NO_NAPI
+napi_value pcan_CAN_RequestStop(napi_env env, napi_callback_info info);
+#endif
+
+
+// Get the time on the host's monotonic clock, used by pcan_CAN_TimedAt.
+// Arguments passed through N-API: none
+// Returns the time in microseconds (number).
+#ifndef PCAN_NO_NAPI
+napi_value pcan_CAN_HostTime(napi_env env, napi_callback_info info);
+#endif
+
+
+// Start capturing every received frame to a binary file, written by a
+// dedicated thread. The receive event must be enabled on the channel.
+// Arguments passed through N-API:
+// - TPCANHandle Channel (uint32)
+// - Path (string)
+// - Options (object), with optional properties format ("native", "trc",
+//   "pcapng", "mdf4", "arrow", or "arrows"), compress (MDF4 deflate level 1-9, or true),
+//   bitrate, bufferSize, flushMs, rotateBytes, rotateSeconds, and passthrough
+// Returns undefined, and error is thrown upon failure.
+#ifndef PCAN_NO_NAPI
+napi_value pcan_CAN_StartCapture(napi_env env, napi_callback_info info);
+#endif
+
+
+// Stop the capture in progress, writing all buffered frames to disk.
+// Arguments passed through N-API:
+// - TPCANHandle Channel (uint32)
+// Returns capture statistics object { frames, dropped, bytes, files, error },
+// and error is thrown if no capture is in progress.
+#ifndef PCAN_NO_NAPI
+napi_value pcan_CAN_StopCapture(napi_env env, napi_callback_info info);
+#endif
+
+
+// Get statistics for the capture in progress.
+// Arguments passed through N-API:
+// - TPCANHandle Channel (uint32)
+// Returns capture statistics object { frames, dropped, bytes, files, error },
+// and error is thrown if no capture is in progress.
+#ifndef PCAN_NO_NAPI
+napi_value pcan_CAN_CaptureStats(napi_env env, napi_callback_info info);
+#endif
+
+
+// Memory-map a capture file and load or build its index.
+// Arguments passed through N-API:
+// - Path (string)
+// - Index mode (uint32, pcanReaderIndexMode_t)
+// Returns an external reader handle, and error is thrown upon failure.
+#ifndef PCAN_NO_NAPI
+napi_value pcan_CAN_ReaderOpen(napi_env env, napi_callback_info info);
+#endif
+
+
+// Describe an open capture file.
+// Arguments passed through N-API:
+// - Reader (external)
+// Returns object { channel, bitrate, startTime, sequence, recordSize, frames,
+// firstTimestamp, lastTimestamp, indexLoaded, ids }, where ids maps each CAN ID
+// to its number of frames. Error is thrown if the reader is closed.
+#ifndef PCAN_NO_NAPI
+napi_value pcan_CAN_ReaderInfo(napi_env env, napi_callback_info info);
+#endif
+
+
+// Start a query for frames by ID and time.
+// Arguments passed through N-API:
+// - Reader (external)
+// - IDs (array of uint32; empty to match all IDs)
+// - From (number, microseconds, inclusive)
+// - To (number, microseconds, inclusive)
+// Returns an external query handle, and error is thrown upon failure.
+#ifndef PCAN_NO_NAPI
+napi_value pcan_CAN_ReaderQuery(napi_env env, napi_callback_info info);
+#endif
+
+
+// Return the next batch of frames matching a query.
+// Arguments passed through N-API:
+// - Query (external)
+// - Max (uint32, maximum number of records; 0 for the largest batch)
+// Returns a Buffer of packed records (recordSize bytes each), which is empty
+// once the query is finished.
+#ifndef PCAN_NO_NAPI
+napi_value pcan_CAN_ReaderNext(napi_env env, napi_callback_info info);
+#endif
+
+
+// Close a reader. The file is unmapped once any unfinished queries are freed.
+// Arguments passed through N-API:
+// - Reader (external)
+// Returns undefined.
+#ifndef PCAN_NO_NAPI
+napi_value pcan_CAN_ReaderClose(napi_env env, napi_callback_info info);
+#endif
+
+
+// Open a PEAK trace (.trc) file, version 2.0 or 2.1, for streaming.
+// Arguments passed through N-API:
+// - Path (string)
+// Returns an external trace reader handle, and error is thrown upon failure.
+#ifndef PCAN_NO_NAPI
+napi_value pcan_CAN_TrcOpen(napi_env env, napi_callback_info info);
+#endif
+
+
+// Describe an open trace file.
+// Arguments passed through N-API:
+// - Trace reader (external)
+// Returns object { version, startTime, lines, skipped }, where lines and
+// skipped count the message lines read so far. Error is thrown if the reader
+// is closed.
+#ifndef PCAN_NO_NAPI
+napi_value pcan_CAN_TrcInfo(napi_env env, napi_callback_info info);
+#endif
+
+
+// Read the next batch of data frames from a trace file.
+// Arguments passed through N-API:
+// - Trace reader (external)
+// - Max (uint32, maximum number of frames; 0 for the largest batch)
+// Returns a Buffer of packed frame records, with timestamps that are offsets
+// from the start of the file in microseconds, which is empty at the end of
+// the file.
+#ifndef PCAN_NO_NAPI
+napi_value pcan_CAN_TrcNext(napi_env env, napi_callback_info info);
+#endif
+
+
+// Close a trace file.
+// Arguments passed through N-API:
+// - Trace reader (external)
+// Returns undefined.
+#ifndef PCAN_NO_NAPI
+napi_value pcan_CAN_TrcClose(napi_env env, napi_callback_info info);
+#endif
+
+
+// Start replaying a capture to a channel from a dedicated thread, with the
+// recorded timing.
+// Arguments passed through N-API:
+// - TPCANHandle Channel (uint32)
+// - Path (string)
+// - Options (object), with optional properties format ("native" or "trc"),
+//   speed (factor, 1 for recorded timing), loop (number of passes, or true to
+//   repeat until stopped), ids (array of uint32), spinUs, and lateUs
+// - Callback (function), called when the replay runs to its end
+// Returns undefined, and error is thrown upon failure.
+#ifndef PCAN_NO_NAPI
+napi_value pcan_CAN_ReplayStart(napi_env env, napi_callback_info info);
+#endif
+
+
+// Stop the replay in progress, or collect a finished one.
+// Arguments passed through N-API:
+// - TPCANHandle Channel (uint32)
+// Returns replay statistics object { frames, errors, late, loops, meanLateUs,
+// maxLateUs, p50LateUs, p99LateUs, p999LateUs, lastError, finished, error },
+// and error is thrown if no replay is in progress.
+#ifndef PCAN_NO_NAPI
+napi_value pcan_CAN_ReplayStop(napi_env env, napi_callback_info info);
+#endif
+
+
+// Get statistics for the replay in progress.
+// Arguments passed through N-API:
+// - TPCANHandle Channel (uint32)
+// Returns replay statistics object, as for pcan_CAN_ReplayStop, and error is
+// thrown if no replay is in progress.
+#ifndef PCAN_NO_NAPI
+napi_value pcan_CAN_ReplayStats(napi_env env, napi_callback_info info);
+#endif
+
+
+// Start detecting the bit rate of an uninitialized channel from a dedicated
+// thread, by listening in listen-only mode at each candidate rate in turn.
+// Arguments passed through N-API:
+// - TPCANHandle Channel (uint32)
+// - Candidates (array of BTR0BTR1 values, uint32), tried in order
+// - Options (object), with optional properties timeoutMs (longest time for
+//   the whole scan), dwellMs (longest time at a candidate in each pass),
+//   minFrames (valid frames that settle a candidate), and rejectErrors
+//   (errors that reject a candidate without valid frames)
+// - Callback (function), called when the scan finishes
+// Returns undefined, and error is thrown upon failure.
+#ifndef PCAN_NO_NAPI
+napi_value pcan_CAN_DetectStart(napi_env env, napi_callback_info info);
+#endif
+
+
+// Stop the bit rate detection in progress, or collect a finished one. The
+// channel is left uninitialized.
+// Arguments passed through N-API:
+// - TPCANHandle Channel (uint32)
+// Returns detection result object { index, confident, stopped, elapsedMs,
+// candidates }, where index is that of the candidate detected, or -1, and
+// candidates holds { frames, errors, elapsedMs, passes, lastError } for each
+// candidate; error is thrown if no detection is in progress.
+#ifndef PCAN_NO_NAPI
+napi_value pcan_CAN_DetectStop(napi_env env, napi_callback_info info);
+#endif
+
+
 
 #endif /* _PCAN_H_ */
 
@@ -0,0 +1,756 @@
+/* Apache Arrow IPC capture files
+
+   Writes captured frames as Arrow record batches, in the IPC file or
+   streaming format. The flatbuffer metadata is built front to back by a
+   minimal encoder, with tables preceded by their vtables and followed by the
+   vectors and strings they link to.
+
+   Copyright (c) 2020 Control Solutions LLC. All rights reserved.
+*/
+
+#include <stdio.h>       // provide printf and snprintf
+#include <stdlib.h>      // provide malloc, realloc, and free
+#include <string.h>      // provide memcpy, memset, and strlen
+
+#include "pcan_arrow.h"
+
+
+// ----------------------------------- // -----------------------------------
+// Definitions
+
+// IPC file magic, padded to 8 bytes at the start of the file
+#define ARROW_MAGIC      "ARROW1"
+#define ARROW_MAGIC_SIZE (6)
+
+// Marker before the length of each encapsulated message
+#define ARROW_CONTINUATION (0xFFFFFFFF)
+
+// MetadataVersion V5
+#define ARROW_METADATA_VERSION (4)
+
+// MessageHeader union types
+#define ARROW_HEADER_SCHEMA       (1)
+#define ARROW_HEADER_RECORD_BATCH (3)
+
+// Type union types, and TimeUnit values
+#define ARROW_TYPE_INT               (2)
+#define ARROW_TYPE_TIMESTAMP         (10)
+#define ARROW_TYPE_FIXED_SIZE_BINARY (15)
+#define ARROW_TIME_UNIT_MICROSECOND  (2)
+
+// Number of columns, and of buffers (validity and values) in each
+#define ARROW_COLUMNS (5)
+#define ARROW_COLUMN_BUFFERS (2)
+
+// Size of FieldNode and Buffer structs, and of the Block struct in the footer
+#define ARROW_FIELD_NODE_SIZE (16)
+#define ARROW_BUFFER_SIZE     (16)
+#define ARROW_BLOCK_SIZE      (24)
+
+// Largest table built, in fields
+#define ARROW_TABLE_FIELDS_MAX (8)
+
+// Room for a schema or record batch message, and for the footer apart from
+// its list of record batches
+#define ARROW_MESSAGE_MAX (2048)
+
+// Flatbuffer being built
+typedef struct arrowBuilder_s
+{
+    uint8_t *data;
+    uint32_t fill;
+    uint32_t size;
+    int overflow;          // Something did not fit, and was left out
+} arrowBuilder_t;
+
+// A scalar field of a table being built: size is 0 for a field left at its
+// default, and links to other objects are 4-byte fields filled in afterwards
+// with arrowLink
+typedef struct arrowField_s
+{
+    uint32_t size;
+    uint64_t value;
+} arrowField_t;
+
+// A column of the schema
+typedef struct arrowColumn_s
+{
+    const char *name;
+    uint8_t type;          // ARROW_TYPE_*
+    uint32_t width;        // Int bit width, FixedSizeBinary byte width, or
+                           // Timestamp unit
+    uint32_t size;         // Bytes per value
+} arrowColumn_t;
+
+// Location of a record batch in an IPC file
+typedef struct arrowBlock_s
+{
+    uint64_t offset;
+    uint32_t metadataLength;
+    uint64_t bodyLength;
+} arrowBlock_t;
+
+// Per-file writer state
+typedef struct arrowWriterState_s
+{
+    int ipcFile;           // Writing the file format, with magic and footer
+
+    // Column values of the record batch being collected, in one allocation
+    uint8_t *columns[ARROW_COLUMNS];
+    uint32_t rows;
+
+    // Record batches written so far (file format only)
+    arrowBlock_t *blocks;
+    uint32_t blockCount;
+    uint32_t blockCapacity;
+
+    uint8_t message[ARROW_MESSAGE_MAX];
+    int error;
+} arrowWriterState_t;
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Global variables
+
+
+// Arrow format functions, defined below
+static int arrowBegin(pcanCapture_t *capture);
+static int arrowBeginFile(pcanCapture_t *capture);
+static int arrowWrite(pcanCapture_t *capture, const pcanFrame_t *frames, uint32_t count);
+static int arrowEnd(pcanCapture_t *capture);
+static int arrowWriteBatch(pcanCapture_t *capture);
+
+const pcanCaptureFormat_t pcanCaptureFormatArrow = {
+    "arrow",
+    arrowBeginFile,
+    arrowWrite,
+    arrowEnd,
+    arrowWriteBatch, // flush
+    sizeof(arrowWriterState_t),
+    0, // seekable
+};
+
+const pcanCaptureFormat_t pcanCaptureFormatArrowStream = {
+    "arrows",
+    arrowBegin,
+    arrowWrite,
+    arrowEnd,
+    arrowWriteBatch, // flush
+    sizeof(arrowWriterState_t),
+    0, // seekable
+};
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local variables
+
+
+static const arrowColumn_t arrowColumns[ARROW_COLUMNS] = {
+    { "timestamp", ARROW_TYPE_TIMESTAMP, ARROW_TIME_UNIT_MICROSECOND, 8 },
+    { "id", ARROW_TYPE_INT, 32, 4 },
+    { "flags", ARROW_TYPE_INT, 16, 2 },
+    { "dlc", ARROW_TYPE_INT, 8, 1 },
+    { "data", ARROW_TYPE_FIXED_SIZE_BINARY, PCAN_FRAME_DATA_MAX, PCAN_FRAME_DATA_MAX },
+};
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local functions
+
+
+// Append bytes to a flatbuffer, or zeros if data is 0
+// Returns the offset they were written at
+static uint32_t arrowPut(arrowBuilder_t *builder, const void *data, uint32_t length)
+{
+    uint32_t at = builder->fill;
+
+    if (length > builder->size - builder->fill)
+    {
+        builder->overflow = 1;
+        return at;
+    }
+
+    if (data != 0)
+    {
+        memcpy(builder->data + at, data, length);
+    }
+    else
+    {
+        memset(builder->data + at, 0, length);
+    }
+    builder->fill += length;
+
+    return at;
+}
+
+
+
+
+// Pad a flatbuffer with zeros to a multiple of align bytes
+// Returns the new length
+static uint32_t arrowAlign(arrowBuilder_t *builder, uint32_t align)
+{
+    arrowPut(builder, 0, (align - builder->fill % align) % align);
+
+    return builder->fill;
+}
+
+
+
+
+// Overwrite bytes already appended to a flatbuffer
+static void arrowSet(arrowBuilder_t *builder, uint32_t at, const void *data, uint32_t length)
+{
+    if (at + length <= builder->fill)
+    {
+        memcpy(builder->data + at, data, length);
+    }
+
+    return;
+}
+
+
+
+
+// Point the link field at slot to an object appended after it
+static void arrowLink(arrowBuilder_t *builder, uint32_t slot, uint32_t target)
+{
+    uint32_t offset = target - slot;
+
+    arrowSet(builder, slot, &offset, sizeof(offset));
+
+    return;
+}
+
+
+
+
+// Append a table, preceded by its vtable. The offset of each field that is
+// not left at its default is stored in slots.
+// Returns the offset of the table
+static uint32_t arrowTable(arrowBuilder_t *builder, const arrowField_t *fields,
+                           uint32_t count, uint32_t *slots)
+{
+    uint16_t vtable[2 + ARROW_TABLE_FIELDS_MAX];
+    uint32_t vtableAt = 0;
+    uint32_t table = 0;
+    int32_t vtableOffset = 0;
+    uint32_t i;
+
+    vtableAt = arrowAlign(builder, 2);
+    arrowPut(builder, 0, (2 + count) * 2);
+
+    table = arrowAlign(builder, 4);
+    vtableOffset = (int32_t)(table - vtableAt);
+    arrowPut(builder, &vtableOffset, sizeof(vtableOffset));
+
+    vtable[0] = (uint16_t)((2 + count) * 2);
+    for (i = 0; i < count; i++)
+    {
+        slots[i] = 0;
+        vtable[2 + i] = 0;
+
+        if (fields[i].size > 0)
+        {
+            slots[i] = arrowAlign(builder, fields[i].size);
+            arrowPut(builder, &(fields[i].value), fields[i].size);
+            vtable[2 + i] = (uint16_t)(slots[i] - table);
+        }
+    }
+    vtable[1] = (uint16_t)(builder->fill - table);
+
+    arrowSet(builder, vtableAt, vtable, (2 + count) * 2);
+
+    return table;
+}
+
+
+
+
+// Append a vector of count elements, zeroed for the caller to fill in, with
+// the elements aligned to align bytes
+// Returns the offset of the vector, where its length is stored
+static uint32_t arrowVector(arrowBuilder_t *builder, uint32_t count,
+                            uint32_t elementSize, uint32_t align)
+{
+    uint32_t at = 0;
+
+    arrowAlign(builder, 4);
+    arrowPut(builder, 0, (align - (builder->fill + 4) % align) % align);
+
+    at = arrowPut(builder, &count, sizeof(count));
+    arrowPut(builder, 0, count * elementSize);
+
+    return at;
+}
+
+
+
+
+// Append a NUL-terminated string
+// Returns the offset of the string
+static uint32_t arrowString(arrowBuilder_t *builder, const char *string)
+{
+    uint32_t length = (uint32_t)strlen(string);
+    uint32_t at = arrowAlign(builder, 4);
+
+    arrowPut(builder, &length, sizeof(length));
+    arrowPut(builder, string, length + 1);
+
+    return at;
+}
+
+
+
+
+// Append the type table of a column
+// Returns the offset of the table
+static uint32_t arrowBuildType(arrowBuilder_t *builder, const arrowColumn_t *column)
+{
+    arrowField_t fields[2];
+    uint32_t slots[2];
+    uint32_t type = 0;
+
+    memset(fields, 0, sizeof(fields));
+
+    switch (column->type)
+    {
+    case ARROW_TYPE_TIMESTAMP:
+        // unit, timezone
+        fields[0].size = 2;
+        fields[0].value = column->width;
+        fields[1].size = 4;
+        type = arrowTable(builder, fields, 2, slots);
+        arrowLink(builder, slots[1], arrowString(builder, "UTC"));
+        break;
+
+    case ARROW_TYPE_INT:
+        // bitWidth, is_signed (false)
+        fields[0].size = 4;
+        fields[0].value = column->width;
+        type = arrowTable(builder, fields, 2, slots);
+        break;
+
+    default:
+        // byteWidth
+        fields[0].size = 4;
+        fields[0].value = column->width;
+        type = arrowTable(builder, fields, 1, slots);
+        break;
+    }
+
+    return type;
+}
+
+
+
+
+// Append a KeyValue table
+// Returns the offset of the table
+static uint32_t arrowBuildKeyValue(arrowBuilder_t *builder, const char *key, const char *value)
+{
+    arrowField_t fields[2] = { { 4, 0 }, { 4, 0 } };
+    uint32_t slots[2];
+    uint32_t table = arrowTable(builder, fields, 2, slots);
+
+    arrowLink(builder, slots[0], arrowString(builder, key));
+    arrowLink(builder, slots[1], arrowString(builder, value));
+
+    return table;
+}
+
+
+
+
+// Append the Schema table
+// Returns the offset of the table
+static uint32_t arrowBuildSchema(arrowBuilder_t *builder, const pcanCapture_t *capture)
+{
+    // endianness (little), fields, custom_metadata
+    arrowField_t schemaFields[3] = { { 0, 0 }, { 4, 0 }, { 4, 0 } };
+    uint32_t schemaSlots[3];
+    // name, nullable (false), type_type, type, dictionary, children
+    arrowField_t fields[6] = { { 4, 0 }, { 0, 0 }, { 1, 0 }, { 4, 0 }, { 0, 0 }, { 4, 0 } };
+    uint32_t slots[6];
+    uint32_t schema, vector, field, metadata;
+    char channel[16];
+    char bitrate[16];
+    uint32_t i;
+
+    schema = arrowTable(builder, schemaFields, 3, schemaSlots);
+
+    vector = arrowVector(builder, ARROW_COLUMNS, 4, 4);
+    arrowLink(builder, schemaSlots[1], vector);
+
+    for (i = 0; i < ARROW_COLUMNS; i++)
+    {
+        fields[2].value = arrowColumns[i].type;
+        field = arrowTable(builder, fields, 6, slots);
+        arrowLink(builder, vector + 4 + 4 * i, field);
+
+        arrowLink(builder, slots[0], arrowString(builder, arrowColumns[i].name));
+        arrowLink(builder, slots[3], arrowBuildType(builder, &(arrowColumns[i])));
+        arrowLink(builder, slots[5], arrowVector(builder, 0, 4, 4));
+    }
+
+    snprintf(channel, sizeof(channel), "0x%02X", capture->options.channel);
+    snprintf(bitrate, sizeof(bitrate), "%u", capture->options.bitrate);
+
+    metadata = arrowVector(builder, 2, 4, 4);
+    arrowLink(builder, schemaSlots[2], metadata);
+    arrowLink(builder, metadata + 4, arrowBuildKeyValue(builder, "pcan.channel", channel));
+    arrowLink(builder, metadata + 8, arrowBuildKeyValue(builder, "pcan.bitrate", bitrate));
+
+    return schema;
+}
+
+
+
+
+// Start an encapsulated message: the continuation marker, the metadata
+// length, and a Message table, whose header the caller links to headerSlot
+static void arrowBeginMessage(arrowBuilder_t *builder, uint8_t headerType,
+                              uint64_t bodyLength, uint32_t *headerSlot)
+{
+    // version, header_type, header, bodyLength
+    arrowField_t fields[4] = {
+        { 2, ARROW_METADATA_VERSION }, { 1, 0 }, { 4, 0 }, { 8, 0 }
+    };
+    uint32_t slots[4];
+    uint32_t marker = ARROW_CONTINUATION;
+    uint32_t root = 0;
+
+    fields[1].value = headerType;
+    fields[3].value = bodyLength;
+
+    builder->fill = 0;
+    builder->overflow = 0;
+
+    arrowPut(builder, &marker, sizeof(marker));
+    arrowPut(builder, 0, 4);
+
+    root = arrowPut(builder, 0, 4);
+    arrowLink(builder, root, arrowTable(builder, fields, 4, slots));
+
+    *headerSlot = slots[2];
+
+    return;
+}
+
+
+
+
+// Pad a message so that its body starts 8-byte aligned, and fill in the
+// metadata length
+// Returns 0 on success, or 1 if the message did not fit
+static int arrowEndMessage(arrowBuilder_t *builder)
+{
+    uint32_t length = arrowAlign(builder, 8) - 8;
+
+    arrowSet(builder, 4, &length, sizeof(length));
+
+    return builder->overflow;
+}
+
+
+
+
+static int arrowBegin(pcanCapture_t *capture)
+{
+    arrowWriterState_t *state = (arrowWriterState_t*)capture->formatState;
+    arrowBuilder_t builder = { state->message, 0, sizeof(state->message), 0 };
+    uint8_t magic[8] = { 0 };
+    uint32_t slot = 0;
+    size_t rowSize = 0;
+    int i;
+    int ret = 0;
+
+    for (i = 0; i < ARROW_COLUMNS; i++)
+    {
+        rowSize += arrowColumns[i].size;
+    }
+
+    state->columns[0] = malloc(rowSize * PCAN_ARROW_BATCH_ROWS);
+    if (state->columns[0] == 0)
+    {
+        state->error = 1;
+        return 1;
+    }
+    for (i = 1; i < ARROW_COLUMNS; i++)
+    {
+        state->columns[i] = state->columns[i - 1] +
+                            (size_t)arrowColumns[i - 1].size * PCAN_ARROW_BATCH_ROWS;
+    }
+
+    if (state->ipcFile)
+    {
+        memcpy(magic, ARROW_MAGIC, ARROW_MAGIC_SIZE);
+        ret |= pcanCaptureOutput(capture, magic, sizeof(magic));
+    }
+
+    arrowBeginMessage(&builder, ARROW_HEADER_SCHEMA, 0, &slot);
+    arrowLink(&builder, slot, arrowBuildSchema(&builder, capture));
+    ret |= arrowEndMessage(&builder);
+
+    ret |= pcanCaptureOutput(capture, builder.data, builder.fill);
+
+    return ret;
+}
+
+
+
+
+static int arrowBeginFile(pcanCapture_t *capture)
+{
+    arrowWriterState_t *state = (arrowWriterState_t*)capture->formatState;
+
+    state->ipcFile = 1;
+
+    return arrowBegin(capture);
+}
+
+
+
+
+// Write the rows collected so far as a record batch
+static int arrowWriteBatch(pcanCapture_t *capture)
+{
+    arrowWriterState_t *state = (arrowWriterState_t*)capture->formatState;
+    arrowBuilder_t builder = { state->message, 0, sizeof(state->message), 0 };
+    arrowField_t fields[3] = { { 8, 0 }, { 4, 0 }, { 4, 0 } }; // length, nodes, buffers
+    uint32_t slots[3];
+    arrowBlock_t *blocks = 0;
+    uint64_t node[2] = { 0, 0 };    // length, null_count
+    uint64_t buffer[2] = { 0, 0 };  // offset, length
+    uint64_t bodyLength = 0;
+    uint64_t zero = 0;
+    uint32_t slot, nodes, buffers;
+    uint32_t size;
+    int i;
+    int ret = 0;
+
+    if (state->rows == 0)
+    {
+        return 0;
+    }
+
+    for (i = 0; i < ARROW_COLUMNS; i++)
+    {
+        bodyLength += ((uint64_t)state->rows * arrowColumns[i].size + 7) & ~(uint64_t)7;
+    }
+
+    arrowBeginMessage(&builder, ARROW_HEADER_RECORD_BATCH, bodyLength, &slot);
+
+    fields[0].value = state->rows;
+    arrowLink(&builder, slot, arrowTable(&builder, fields, 3, slots));
+
+    nodes = arrowVector(&builder, ARROW_COLUMNS, ARROW_FIELD_NODE_SIZE, 8);
+    arrowLink(&builder, slots[1], nodes);
+
+    buffers = arrowVector(&builder, ARROW_COLUMNS * ARROW_COLUMN_BUFFERS, ARROW_BUFFER_SIZE, 8);
+    arrowLink(&builder, slots[2], buffers);
+
+    // Every column has an empty validity buffer, since nothing is null,
+    // followed by its values, each starting 8-byte aligned in the body
+    node[0] = state->rows;
+    for (i = 0; i < ARROW_COLUMNS; i++)
+    {
+        arrowSet(&builder, nodes + 4 + i * ARROW_FIELD_NODE_SIZE, node, sizeof(node));
+
+        buffer[1] = 0;
+        arrowSet(&builder, buffers + 4 + (2 * i) * ARROW_BUFFER_SIZE, buffer, sizeof(buffer));
+
+        buffer[1] = (uint64_t)state->rows * arrowColumns[i].size;
+        arrowSet(&builder, buffers + 4 + (2 * i + 1) * ARROW_BUFFER_SIZE, buffer, sizeof(buffer));
+
+        buffer[0] += (buffer[1] + 7) & ~(uint64_t)7;
+    }
+
+    if (arrowEndMessage(&builder))
+    {
+        state->error = 1;
+        return 1;
+    }
+
+    // The file footer indexes every record batch
+    if (state->ipcFile)
+    {
+        if (state->blockCount == state->blockCapacity)
+        {
+            state->blockCapacity = (state->blockCapacity == 0) ? 64 : 2 * state->blockCapacity;
+            blocks = realloc(state->blocks, state->blockCapacity * sizeof(*blocks));
+            if (blocks == 0)
+            {
+                state->error = 1;
+                return 1;
+            }
+            state->blocks = blocks;
+        }
+
+        state->blocks[state->blockCount].offset = pcanCaptureOutputOffset(capture);
+        state->blocks[state->blockCount].metadataLength = builder.fill;
+        state->blocks[state->blockCount].bodyLength = bodyLength;
+        state->blockCount++;
+    }
+
+    ret |= pcanCaptureOutput(capture, builder.data, builder.fill);
+
+    for (i = 0; i < ARROW_COLUMNS; i++)
+    {
+        size = state->rows * arrowColumns[i].size;
+
+        ret |= pcanCaptureOutput(capture, state->columns[i], size);
+        if (size % 8)
+        {
+            ret |= pcanCaptureOutput(capture, &zero, 8 - (size % 8));
+        }
+    }
+
+    state->rows = 0;
+
+    return ret;
+}
+
+
+
+
+static int arrowWrite(pcanCapture_t *capture, const pcanFrame_t *frames, uint32_t count)
+{
+    arrowWriterState_t *state = (arrowWriterState_t*)capture->formatState;
+    uint64_t *timestamps = (uint64_t*)state->columns[0];
+    uint32_t *ids = (uint32_t*)state->columns[1];
+    uint16_t *flags = (uint16_t*)state->columns[2];
+    uint8_t *dlcs = state->columns[3];
+    uint8_t *data = 0;
+    uint32_t row = 0;
+    uint8_t len = 0;
+    uint32_t i;
+    int ret = 0;
+
+    if (state->columns[0] == 0)
+    {
+        return 1;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        row = state->rows;
+        len = (frames[i].len > PCAN_FRAME_DATA_MAX) ? PCAN_FRAME_DATA_MAX : frames[i].len;
+        data = state->columns[4] + (size_t)row * PCAN_FRAME_DATA_MAX;
+
+        timestamps[row] = pcanCaptureWallTime(capture, frames[i].timestamp);
+        ids[row] = frames[i].id;
+        flags[row] = (uint16_t)(frames[i].msgtype | (frames[i].flags << 8));
+        dlcs[row] = len;
+        memcpy(data, frames[i].data, len);
+        memset(data + len, 0, PCAN_FRAME_DATA_MAX - len);
+
+        if (++state->rows == PCAN_ARROW_BATCH_ROWS)
+        {
+            ret |= arrowWriteBatch(capture);
+        }
+    }
+
+    return ret;
+}
+
+
+
+
+// Write the IPC file footer, which repeats the schema and lists the record
+// batches
+static int arrowWriteFooter(pcanCapture_t *capture)
+{
+    arrowWriterState_t *state = (arrowWriterState_t*)capture->formatState;
+    arrowBuilder_t builder = { 0, 0, 0, 0 };
+    // version, schema, dictionaries, recordBatches
+    arrowField_t fields[4] = { { 2, ARROW_METADATA_VERSION }, { 4, 0 }, { 4, 0 }, { 4, 0 } };
+    uint32_t slots[4];
+    uint32_t root, batches, length;
+    uint32_t i;
+    int ret = 0;
+
+    builder.size = ARROW_MESSAGE_MAX + state->blockCount * ARROW_BLOCK_SIZE;
+    builder.data = malloc(builder.size);
+    if (builder.data == 0)
+    {
+        return 1;
+    }
+
+    root = arrowPut(&builder, 0, 4);
+    arrowLink(&builder, root, arrowTable(&builder, fields, 4, slots));
+    arrowLink(&builder, slots[1], arrowBuildSchema(&builder, capture));
+    arrowLink(&builder, slots[2], arrowVector(&builder, 0, ARROW_BLOCK_SIZE, 8));
+
+    batches = arrowVector(&builder, state->blockCount, ARROW_BLOCK_SIZE, 8);
+    arrowLink(&builder, slots[3], batches);
+
+    for (i = 0; i < state->blockCount; i++)
+    {
+        arrowSet(&builder, batches + 4 + i * ARROW_BLOCK_SIZE,
+                 &(state->blocks[i].offset), 8);
+        arrowSet(&builder, batches + 4 + i * ARROW_BLOCK_SIZE + 8,
+                 &(state->blocks[i].metadataLength), 4);
+        arrowSet(&builder, batches + 4 + i * ARROW_BLOCK_SIZE + 16,
+                 &(state->blocks[i].bodyLength), 8);
+    }
+
+    length = arrowAlign(&builder, 8);
+
+    if (builder.overflow)
+    {
+        ret = 1;
+    }
+    else
+    {
+        ret |= pcanCaptureOutput(capture, builder.data, length);
+        ret |= pcanCaptureOutput(capture, &length, sizeof(length));
+        ret |= pcanCaptureOutput(capture, ARROW_MAGIC, ARROW_MAGIC_SIZE);
+    }
+
+    free(builder.data);
+
+    return ret;
+}
+
+
+
+
+// Write the last record batch and the end of the stream, then the footer of
+// an IPC file
+static int arrowEnd(pcanCapture_t *capture)
+{
+    arrowWriterState_t *state = (arrowWriterState_t*)capture->formatState;
+    uint32_t end[2] = { ARROW_CONTINUATION, 0 };
+    int ret = 0;
+
+    if (state->columns[0] != 0)
+    {
+        ret |= arrowWriteBatch(capture);
+        ret |= pcanCaptureOutput(capture, end, sizeof(end));
+
+        if (state->ipcFile && !state->error)
+        {
+            ret |= arrowWriteFooter(capture);
+        }
+    }
+
+    free(state->columns[0]);
+    free(state->blocks);
+    state->columns[0] = 0;
+    state->blocks = 0;
+
+    return ret | state->error;
+}
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Public functions
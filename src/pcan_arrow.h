@@ -0,0 +1,68 @@
+/* Apache Arrow IPC capture files
+
+   Writes captured frames as Arrow record batches, which pandas, Polars, and
+   other columnar tools load without parsing. Two variants share the same
+   encoder:
+     "arrow"   the IPC file format (.arrow), with a footer indexing the
+               record batches, for random access
+     "arrows"  the IPC streaming format (.arrows), written strictly in order,
+               so that it can also be streamed to a named pipe
+
+   Columns are built natively as frames arrive and a record batch is written
+   whenever PCAN_ARROW_BATCH_ROWS frames have been collected, on each timed
+   flush, and when the file is closed. The schema is:
+     timestamp  timestamp[us, tz=UTC]  wall clock time of the frame
+     id         uint32                 CAN identifier
+     flags      uint16                 TPCANMessageType bits (0-7) and
+                                       PCAN_FRAME_FLAG_* bits (8-15)
+     dlc        uint8                  data length, in bytes
+     data       fixed_size_binary[8]   data, zero-padded
+   with no nulls. The schema metadata records the channel and bit rate.
+
+   Copyright (c) 2020 Control Solutions LLC. All rights reserved.
+*/
+
+#ifndef _PCAN_ARROW_H_
+#define _PCAN_ARROW_H_
+
+#include "pcan_capture.h" // provide pcanCaptureFormat_t
+
+
+// ----------------------------------- // -----------------------------------
+// Definitions
+
+// Maximum number of rows in a record batch
+#define PCAN_ARROW_BATCH_ROWS (65536)
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Global variables
+
+// Arrow IPC file and stream capture formats
+extern const pcanCaptureFormat_t pcanCaptureFormatArrow;
+extern const pcanCaptureFormat_t pcanCaptureFormatArrowStream;
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local variables
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local functions
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Public functions
+
+
+
+
+#endif // _PCAN_ARROW_H_
@@ -0,0 +1,915 @@
+/* Native capture of received CAN frames
+
+   Frames drained by the receive worker thread are appended to one of two
+   large in-memory buffers. A dedicated writer thread encodes each buffer into
+   the selected file format and writes it to disk once it fills, while the
+   receive thread continues filling the other, so that formatting and file I/O
+   never stall frame reception. Capture files may be rotated by size and/or
+   age.
+
+   Copyright (c) 2020 Control Solutions LLC. All rights reserved.
+*/
+
+#include <stdio.h>       // provide printf, fopen, fwrite, and snprintf
+#include <stdlib.h>      // provide calloc, malloc, and free
+#include <string.h>      // provide memcpy, memmove, memset, strcmp, strncmp, and strrchr
+
+#if defined _WIN32
+#include <windows.h>     // provide Win32 types, constants, and functions
+#else
+#include <fcntl.h>       // provide open and fcntl
+#include <sys/stat.h>    // provide stat
+#include <sys/types.h>   // provide off_t
+#include <unistd.h>      // provide close
+#endif
+
+#include "pcan_capture.h"
+#include "pcan_arrow.h"   // provide pcanCaptureFormatArrow and pcanCaptureFormatArrowStream
+#include "pcan_mdf4.h"    // provide pcanCaptureFormatMdf4
+#include "pcan_pcapng.h"  // provide pcanCaptureFormatPcapng
+#include "pcan_trc.h"     // provide pcanCaptureFormatTrc
+
+
+// ----------------------------------- // -----------------------------------
+// Definitions
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Global variables
+
+
+// Native format functions, defined below
+static int nativeBegin(pcanCapture_t *capture);
+static int nativeWrite(pcanCapture_t *capture, const pcanFrame_t *frames, uint32_t count);
+
+const pcanCaptureFormat_t pcanCaptureFormatNative = {
+    "native",
+    nativeBegin,
+    nativeWrite,
+    0, // end
+    0, // flush
+    0, // stateSize
+    0, // seekable
+};
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local variables
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local functions
+
+
+static int nativeBegin(pcanCapture_t *capture)
+{
+    pcanCaptureHeader_t header;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, PCAN_CAPTURE_MAGIC, sizeof(PCAN_CAPTURE_MAGIC));
+    header.version = PCAN_CAPTURE_VERSION;
+    header.headerSize = PCAN_CAPTURE_HEADER_SIZE;
+    header.recordSize = PCAN_FRAME_SIZE;
+    header.channel = capture->options.channel;
+    header.bitrate = capture->options.bitrate;
+    header.startTime = capture->fileStartWallUs;
+    header.sequence = capture->sequence;
+
+    return pcanCaptureOutput(capture, &header, sizeof(header));
+}
+
+
+
+
+static int nativeWrite(pcanCapture_t *capture, const pcanFrame_t *frames, uint32_t count)
+{
+    return pcanCaptureOutput(capture, frames, (size_t)count * PCAN_FRAME_SIZE);
+}
+
+
+
+
+// Open a capture file for writing, with stdio buffering disabled since all
+// writes are already large
+static FILE *captureOpenFile(const char *name)
+{
+    FILE *file = fopen(name, "wb");
+
+    if (file != 0)
+    {
+        setvbuf(file, NULL, _IONBF, 0);
+    }
+
+    return file;
+}
+
+
+
+
+// Return nonzero if path names a pipe rather than a regular file
+static int captureIsPipe(const char *path)
+{
+#if defined _WIN32
+    return (strncmp(path, "\\\\.\\pipe\\", 9) == 0);
+#else
+    struct stat info;
+
+    return (stat(path, &info) == 0) && S_ISFIFO(info.st_mode);
+#endif
+}
+
+
+
+
+// Move to an offset from the start of a file, which may be past 2 GB
+// Returns 0 on success
+static int captureSeek(FILE *file, uint64_t offset)
+{
+#if defined _WIN32
+    return _fseeki64(file, (__int64)offset, SEEK_SET);
+#else
+    return fseeko(file, (off_t)offset, SEEK_SET);
+#endif
+}
+
+
+
+
+// Open a pipe for writing, without waiting for a reader
+// Returns the open file, or 0 if nothing is reading from the pipe yet
+static FILE *captureOpenPipe(const char *name)
+{
+    FILE *file = 0;
+
+#if defined _WIN32
+    // Fails until the reading end has created an instance of the pipe
+    file = fopen(name, "wb");
+#else
+    int fd = open(name, O_WRONLY | O_NONBLOCK);
+
+    if (fd < 0)
+    {
+        return 0;
+    }
+
+    // Once a reader is connected, writes should wait for it
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+
+    file = fdopen(fd, "wb");
+    if (file == 0)
+    {
+        close(fd);
+    }
+#endif
+
+    if (file != 0)
+    {
+        setvbuf(file, NULL, _IONBF, 0);
+    }
+
+    return file;
+}
+
+
+
+
+// Write the first length bytes of the output buffer to the file, and move
+// anything after them to the front
+// Returns 0 on success, or 1 on a write error
+static int captureWriteOut(pcanCapture_t *capture, size_t length)
+{
+    size_t written = 0;
+
+    if (length == 0)
+    {
+        return 0;
+    }
+
+    if (capture->file != 0)
+    {
+        written = fwrite(capture->out, 1, length, capture->file);
+    }
+
+    if (written != length)
+    {
+        printf("pcanCaptureThreadProc: Error writing capture file (%zu of %zu bytes)\n",
+               written, length);
+    }
+
+    memmove(capture->out, capture->out + length, capture->outFill - length);
+    capture->outFill -= length;
+    capture->fileOffset += length;
+
+    pcanMutexLock(&(capture->lock));
+    capture->stats.bytes += written;
+    if (written != length)
+    {
+        capture->stats.error = 1;
+    }
+    pcanMutexUnlock(&(capture->lock));
+
+#ifdef PCAN_CAPTURE_DEBUG
+    printf("pcanCaptureThreadProc: Wrote %zu bytes\n", written);
+#endif
+
+    return (written == length) ? 0 : 1;
+}
+
+
+
+
+// Write as much of the output as ends on a page boundary in the file
+static int captureFlushPages(pcanCapture_t *capture)
+{
+    uint64_t end = capture->fileOffset + capture->outFill;
+
+    end -= end % PCAN_CAPTURE_PAGE_SIZE;
+    if (end <= capture->fileOffset)
+    {
+        return 0;
+    }
+
+    return captureWriteOut(capture, (size_t)(end - capture->fileOffset));
+}
+
+
+
+
+// Write all of the output
+static int captureFlushAll(pcanCapture_t *capture)
+{
+    return captureWriteOut(capture, capture->outFill);
+}
+
+
+
+
+// Open the file for the current sequence number and start the format
+// Returns 0 on success, or 1 on failure
+static int captureBeginFile(pcanCapture_t *capture)
+{
+    const pcanCaptureFormat_t *format = capture->options.format;
+
+    pcanCaptureFileName(capture->path, capture->sequence,
+                        capture->fileName, sizeof(capture->fileName));
+
+    // A pipe has already been opened by captureWaitPipe
+    if (capture->file == 0)
+    {
+        capture->file = captureOpenFile(capture->fileName);
+    }
+    capture->fileOffset = 0;
+    capture->fileStartUs = pcanTimeMicros();
+    capture->fileStartWallUs = pcanWallTimeMicros();
+    capture->fileFrames = 0;
+    capture->fileFirstTimestamp = 0;
+
+    if (format->stateSize > 0)
+    {
+        memset(capture->formatState, 0, format->stateSize);
+    }
+
+    pcanMutexLock(&(capture->lock));
+    if (capture->file == 0)
+    {
+        printf("pcanCaptureThreadProc: Error opening capture file \"%s\"\n", capture->fileName);
+        capture->stats.error = 1;
+    }
+    else
+    {
+        capture->stats.files++;
+    }
+    pcanMutexUnlock(&(capture->lock));
+
+    if (capture->file == 0)
+    {
+        return 1;
+    }
+
+    return (format->begin != 0) ? format->begin(capture) : 0;
+}
+
+
+
+
+// Finish the format, write everything, and close the current file
+static void captureEndFile(pcanCapture_t *capture)
+{
+    const pcanCaptureFormat_t *format = capture->options.format;
+
+    if (capture->file == 0)
+    {
+        capture->outFill = 0;
+        return;
+    }
+
+    if (format->end != 0)
+    {
+        format->end(capture);
+    }
+
+    captureFlushAll(capture);
+
+    fclose(capture->file);
+    capture->file = 0;
+
+    return;
+}
+
+
+
+
+// Return nonzero if the current file has reached its size or age limit
+static int captureRotateDue(pcanCapture_t *capture)
+{
+    // Never rotate away from a file that holds no frames
+    if (capture->fileFrames == 0)
+    {
+        return 0;
+    }
+
+    if ((capture->options.rotateBytes != 0) &&
+        (pcanCaptureOutputOffset(capture) >= capture->options.rotateBytes))
+    {
+        return 1;
+    }
+
+    if ((capture->options.rotateUs != 0) &&
+        (pcanTimeMicros() - capture->fileStartUs >= capture->options.rotateUs))
+    {
+        return 1;
+    }
+
+    return 0;
+}
+
+
+
+
+// Close the current file and open the next one in the rotation
+static void captureNextFile(pcanCapture_t *capture)
+{
+    captureEndFile(capture);
+
+    capture->sequence++;
+    captureBeginFile(capture);
+
+    return;
+}
+
+
+
+
+// Encode frames into the current file, rotating files as needed. Called
+// without the capture lock held.
+static void captureEncode(pcanCapture_t *capture, const pcanFrame_t *frames, uint32_t count)
+{
+    const pcanCaptureFormat_t *format = capture->options.format;
+    uint32_t chunk = 0;
+
+    while (count > 0)
+    {
+        if (captureRotateDue(capture))
+        {
+            captureNextFile(capture);
+        }
+
+        chunk = (count < PCAN_CAPTURE_ROTATE_CHUNK) ? count : PCAN_CAPTURE_ROTATE_CHUNK;
+
+        if (capture->file != 0)
+        {
+            if (capture->fileFrames == 0)
+            {
+                capture->fileFirstTimestamp = frames[0].timestamp;
+            }
+
+            format->write(capture, frames, chunk);
+            capture->fileFrames += chunk;
+        }
+
+        frames += chunk;
+        count -= chunk;
+    }
+
+    return;
+}
+
+
+
+
+// Poll a pipe until something reads from it, then start the file
+// Returns 0 once the pipe is open, or 1 if the capture was stopped first
+static int captureWaitPipe(pcanCapture_t *capture)
+{
+    int stopping = 0;
+
+    while (1)
+    {
+        capture->file = captureOpenPipe(capture->path);
+        if (capture->file != 0)
+        {
+            captureBeginFile(capture);
+            return 0;
+        }
+
+        pcanMutexLock(&(capture->lock));
+        if (!capture->stop)
+        {
+            pcanCondTimedWait(&(capture->wake), &(capture->lock), PCAN_CAPTURE_PIPE_POLL_US);
+        }
+        stopping = capture->stop;
+        pcanMutexUnlock(&(capture->lock));
+
+        if (stopping)
+        {
+            return 1;
+        }
+    }
+}
+
+
+
+
+void pcanCaptureThreadProc(void *arg)
+{
+    pcanCapture_t *capture = (pcanCapture_t*)arg;
+    pcanCaptureBuffer_t *buffer = 0;
+    uint32_t from = 0;
+    uint32_t to = 0;
+    int timedOut = 0;
+    int stopping = 0;
+
+    // Frames stay in the buffers until something reads from a pipe, and are
+    // dropped if that never happens
+    if (capture->pipe && (captureWaitPipe(capture) != 0))
+    {
+        pcanMutexLock(&(capture->lock));
+        capture->stats.dropped += capture->buffers[0].fill + capture->buffers[1].fill;
+        pcanMutexUnlock(&(capture->lock));
+        return;
+    }
+
+    pcanMutexLock(&(capture->lock));
+
+    while (1)
+    {
+        // Encode a buffer the receive thread has finished with
+        if (capture->pending)
+        {
+            buffer = &(capture->buffers[capture->active ^ 1]);
+            from = buffer->flushed;
+            to = buffer->fill;
+            pcanMutexUnlock(&(capture->lock));
+
+            captureEncode(capture, buffer->frames + from, to - from);
+            captureFlushPages(capture);
+
+            pcanMutexLock(&(capture->lock));
+            buffer->fill = 0;
+            buffer->flushed = 0;
+            capture->pending = 0;
+            continue;
+        }
+
+        // Write whatever has accumulated in the active buffer, either because
+        // the capture is stopping or because it has waited long enough
+        if (!capture->stop)
+        {
+            timedOut = pcanCondTimedWait(&(capture->wake), &(capture->lock),
+                                         capture->options.flushUs);
+            if (!timedOut || capture->pending)
+            {
+                continue;
+            }
+        }
+
+        // The receive thread only appends beyond fill, so frames up to it can
+        // be encoded without the lock
+        buffer = &(capture->buffers[capture->active]);
+        from = buffer->flushed;
+        to = buffer->fill;
+        stopping = capture->stop;
+        pcanMutexUnlock(&(capture->lock));
+
+        // Rotate by age even when no frames arrive, but do not leave an empty
+        // file behind when stopping
+        captureEncode(capture, buffer->frames + from, to - from);
+        if ((capture->file != 0) && (capture->options.format->flush != 0))
+        {
+            capture->options.format->flush(capture);
+        }
+        if (!stopping && captureRotateDue(capture))
+        {
+            captureNextFile(capture);
+        }
+        captureFlushAll(capture);
+
+        pcanMutexLock(&(capture->lock));
+        buffer->flushed = to;
+
+        if (capture->stop && !capture->pending)
+        {
+            break;
+        }
+    }
+
+    pcanMutexUnlock(&(capture->lock));
+
+    captureEndFile(capture);
+
+#ifdef PCAN_CAPTURE_DEBUG
+    printf("pcanCaptureThreadProc: Exiting thread\n");
+#endif
+
+    return;
+}
+
+
+
+
+// Free a capture and everything it owns
+static void captureFree(pcanCapture_t *capture)
+{
+    free(capture->buffers[0].frames);
+    free(capture->buffers[1].frames);
+    free(capture->out);
+    free(capture->formatState);
+    free(capture);
+
+    return;
+}
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Public functions
+
+
+pcanCapture_t *pcanCaptureStart(const char *path, const pcanCaptureOptions_t *options,
+                                const char **error)
+{
+    pcanCapture_t *capture = 0;
+    int i;
+
+    if (strlen(path) >= PCAN_CAPTURE_PATH_MAX - 8)
+    {
+        *error = "Capture file path is too long.";
+        return 0;
+    }
+
+    capture = calloc(1, sizeof(*capture));
+    if (capture == 0)
+    {
+        *error = "Error allocating memory for capture.";
+        return 0;
+    }
+
+    memcpy(&(capture->options), options, sizeof(capture->options));
+    strcpy(capture->path, path);
+
+    if (capture->options.format == 0)
+    {
+        capture->options.format = &pcanCaptureFormatNative;
+    }
+
+    // A pipe is a single stream that cannot be rotated or seeked
+    capture->pipe = captureIsPipe(path);
+    if (capture->pipe)
+    {
+        if (capture->options.format->seekable)
+        {
+            free(capture);
+            *error = "This capture format cannot be written to a pipe.";
+            return 0;
+        }
+
+        capture->options.rotateBytes = 0;
+        capture->options.rotateUs = 0;
+    }
+
+    // Round the buffer size up to a whole number of blocks
+    if (capture->options.bufferSize == 0)
+    {
+        capture->options.bufferSize = PCAN_CAPTURE_BUFFER_DEFAULT;
+    }
+    if (capture->options.bufferSize > PCAN_CAPTURE_BUFFER_MAX)
+    {
+        capture->options.bufferSize = PCAN_CAPTURE_BUFFER_MAX;
+    }
+    capture->options.bufferSize = ((capture->options.bufferSize + PCAN_CAPTURE_BLOCK_SIZE - 1) /
+                                   PCAN_CAPTURE_BLOCK_SIZE) * PCAN_CAPTURE_BLOCK_SIZE;
+
+    if (capture->options.flushUs == 0)
+    {
+        capture->options.flushUs = PCAN_CAPTURE_FLUSH_DEFAULT_US;
+    }
+
+    capture->bufferFrames = capture->options.bufferSize / PCAN_FRAME_SIZE;
+    capture->outCapacity = capture->options.bufferSize;
+    capture->out = malloc(capture->outCapacity);
+
+    for (i = 0; i < 2; i++)
+    {
+        capture->buffers[i].frames = malloc(capture->options.bufferSize);
+    }
+
+    if (capture->options.format->stateSize > 0)
+    {
+        capture->formatState = malloc(capture->options.format->stateSize);
+    }
+
+    if ((capture->out == 0) || (capture->buffers[0].frames == 0) ||
+        (capture->buffers[1].frames == 0) ||
+        ((capture->options.format->stateSize > 0) && (capture->formatState == 0)))
+    {
+        captureFree(capture);
+        *error = "Error allocating memory for capture buffers.";
+        return 0;
+    }
+
+    pcanMutexInit(&(capture->lock));
+    pcanCondInit(&(capture->wake));
+
+    // Open the first file here, so that a bad path is reported to the caller.
+    // A pipe is opened by the writer thread instead, since there may be
+    // nothing reading from it yet.
+    if (!capture->pipe && (captureBeginFile(capture) != 0))
+    {
+        if (capture->file != 0)
+        {
+            fclose(capture->file);
+        }
+        pcanCondDestroy(&(capture->wake));
+        pcanMutexDestroy(&(capture->lock));
+        captureFree(capture);
+        *error = "Unable to open capture file.";
+        return 0;
+    }
+
+    if (pcanThreadCreate(&(capture->thread), pcanCaptureThreadProc, capture) != 0)
+    {
+        if (capture->file != 0)
+        {
+            fclose(capture->file);
+        }
+        pcanCondDestroy(&(capture->wake));
+        pcanMutexDestroy(&(capture->lock));
+        captureFree(capture);
+        *error = "Unable to start capture writer thread.";
+        return 0;
+    }
+
+#ifdef PCAN_CAPTURE_DEBUG
+    printf("pcanCaptureStart: \"%s\", format = %s, bufferSize = %u\n",
+           path, capture->options.format->name, capture->options.bufferSize);
+#endif
+
+    return capture;
+}
+
+
+
+
+void pcanCaptureWrite(pcanCapture_t *capture, const pcanFrame_t *frames, uint32_t count)
+{
+    pcanCaptureBuffer_t *buffer = 0;
+    uint32_t space = 0;
+    uint32_t n = 0;
+
+    if (count == 0)
+    {
+        return;
+    }
+
+    pcanMutexLock(&(capture->lock));
+
+    if (!capture->clockValid)
+    {
+        capture->clockWallUs = pcanWallTimeMicros();
+        capture->clockFrameUs = frames[0].timestamp;
+        capture->clockValid = 1;
+    }
+
+    while (count > 0)
+    {
+        buffer = &(capture->buffers[capture->active]);
+        space = capture->bufferFrames - buffer->fill;
+
+        if (space == 0)
+        {
+            if (capture->pending)
+            {
+                // Both buffers are full; the disk is not keeping up
+                capture->stats.dropped += count;
+                break;
+            }
+
+            // Hand the full buffer to the writer thread and fill the other
+            capture->pending = 1;
+            capture->active ^= 1;
+            pcanCondSignal(&(capture->wake));
+            continue;
+        }
+
+        n = (count < space) ? count : space;
+        memcpy(buffer->frames + buffer->fill, frames, (size_t)n * sizeof(pcanFrame_t));
+        buffer->fill += n;
+        capture->stats.frames += n;
+
+        frames += n;
+        count -= n;
+    }
+
+    pcanMutexUnlock(&(capture->lock));
+
+    return;
+}
+
+
+
+
+void pcanCaptureGetStats(pcanCapture_t *capture, pcanCaptureStats_t *stats)
+{
+    pcanMutexLock(&(capture->lock));
+    memcpy(stats, &(capture->stats), sizeof(*stats));
+    pcanMutexUnlock(&(capture->lock));
+
+    return;
+}
+
+
+
+
+void pcanCaptureStop(pcanCapture_t *capture, pcanCaptureStats_t *stats)
+{
+    pcanMutexLock(&(capture->lock));
+    capture->stop = 1;
+    pcanCondSignal(&(capture->wake));
+    pcanMutexUnlock(&(capture->lock));
+
+    pcanThreadJoin(capture->thread);
+
+    if (stats != 0)
+    {
+        memcpy(stats, &(capture->stats), sizeof(*stats));
+    }
+
+    pcanCondDestroy(&(capture->wake));
+    pcanMutexDestroy(&(capture->lock));
+    captureFree(capture);
+
+    return;
+}
+
+
+
+
+void pcanCaptureFileName(const char *path, uint32_t sequence, char *name, size_t nameSize)
+{
+    const char *extension = strrchr(path, '.');
+    const char *separator = strrchr(path, '/');
+    const char *separatorWin = strrchr(path, '\\');
+
+    if (sequence == 0)
+    {
+        snprintf(name, nameSize, "%s", path);
+        return;
+    }
+
+    // Ignore dots that belong to a directory name
+    if ((separatorWin != 0) && ((separator == 0) || (separatorWin > separator)))
+    {
+        separator = separatorWin;
+    }
+    if ((extension != 0) && (separator != 0) && (extension < separator))
+    {
+        extension = 0;
+    }
+
+    if (extension == 0)
+    {
+        snprintf(name, nameSize, "%s_%03u", path, sequence);
+    }
+    else
+    {
+        snprintf(name, nameSize, "%.*s_%03u%s",
+                 (int)(extension - path), path, sequence, extension);
+    }
+
+    return;
+}
+
+
+
+
+const pcanCaptureFormat_t *pcanCaptureFindFormat(const char *name)
+{
+    static const pcanCaptureFormat_t *formats[] = {
+        &pcanCaptureFormatNative,
+        &pcanCaptureFormatTrc,
+        &pcanCaptureFormatPcapng,
+        &pcanCaptureFormatMdf4,
+        &pcanCaptureFormatArrow,
+        &pcanCaptureFormatArrowStream,
+        0
+    };
+    int i;
+
+    for (i = 0; formats[i] != 0; i++)
+    {
+        if (strcmp(formats[i]->name, name) == 0)
+        {
+            return formats[i];
+        }
+    }
+
+    return 0;
+}
+
+
+
+
+int pcanCaptureOutput(pcanCapture_t *capture, const void *data, size_t length)
+{
+    const uint8_t *bytes = (const uint8_t*)data;
+    size_t space = 0;
+    size_t n = 0;
+    int ret = 0;
+
+    while (length > 0)
+    {
+        space = capture->outCapacity - capture->outFill;
+        if (space == 0)
+        {
+            ret |= captureFlushPages(capture);
+            continue;
+        }
+
+        n = (length < space) ? length : space;
+        memcpy(capture->out + capture->outFill, bytes, n);
+        capture->outFill += n;
+
+        bytes += n;
+        length -= n;
+    }
+
+    return ret;
+}
+
+
+
+
+uint64_t pcanCaptureOutputOffset(pcanCapture_t *capture)
+{
+    return capture->fileOffset + capture->outFill;
+}
+
+
+
+
+int pcanCapturePatch(pcanCapture_t *capture, uint64_t offset, const void *data, size_t length)
+{
+    int ret = 0;
+
+    // Patch in memory if the bytes have not been written yet
+    if (offset >= capture->fileOffset)
+    {
+        memcpy(capture->out + (offset - capture->fileOffset), data, length);
+        return 0;
+    }
+
+    if (captureFlushAll(capture) != 0)
+    {
+        return 1;
+    }
+
+    if ((captureSeek(capture->file, offset) != 0) ||
+        (fwrite(data, 1, length, capture->file) != length))
+    {
+        ret = 1;
+    }
+
+    fseek(capture->file, 0, SEEK_END);
+
+    return ret;
+}
+
+
+
+
+uint64_t pcanCaptureWallTime(pcanCapture_t *capture, uint64_t timestamp)
+{
+    if (!capture->clockValid)
+    {
+        return capture->fileStartWallUs;
+    }
+
+    return capture->clockWallUs + (timestamp - capture->clockFrameUs);
+}
@@ -0,0 +1,268 @@
+/* Native capture of received CAN frames
+
+   Frames drained by the receive worker thread are appended to one of two
+   large in-memory buffers. A dedicated writer thread encodes each buffer into
+   the selected file format and writes it to disk once it fills, while the
+   receive thread continues filling the other, so that formatting and file I/O
+   never stall frame reception. Capture files may be rotated by size and/or
+   age.
+
+   File formats are pluggable (see pcanCaptureFormat_t). The native format
+   defined here is:
+     pcanCaptureHeader_t (PCAN_CAPTURE_HEADER_SIZE bytes)
+     pcanFrame_t records (recordSize bytes each) until end of file
+   with all fields little-endian.
+
+   Copyright (c) 2020 Control Solutions LLC. All rights reserved.
+*/
+
+#ifndef _PCAN_CAPTURE_H_
+#define _PCAN_CAPTURE_H_
+
+#include <stddef.h>      // provide size_t
+#include <stdint.h>      // provide uintX_t
+#include <stdio.h>       // provide FILE
+
+#include "pcan_frame.h"  // provide pcanFrame_t
+#include "pcan_thread.h" // provide pcanThread_t, pcanMutex_t, and pcanCond_t
+
+
+//#define PCAN_CAPTURE_DEBUG
+// Uncomment to enable debugging messages, which may affect timing or
+// performance
+
+// ----------------------------------- // -----------------------------------
+// Definitions
+
+// Native capture file identification
+#define PCAN_CAPTURE_MAGIC       "PCANCAP"
+#define PCAN_CAPTURE_VERSION     (1)
+#define PCAN_CAPTURE_HEADER_SIZE (48)
+
+// Size of a page. Apart from timed flushes and the end of a file, the writer
+// thread only writes whole pages at page-aligned file offsets.
+#define PCAN_CAPTURE_PAGE_SIZE   (4096)
+
+// Buffers are sized in multiples of this block, which is the least common
+// multiple of the frame record size and the page size
+#define PCAN_CAPTURE_BLOCK_SIZE  (12288)
+
+// Default buffer size (64 blocks, 768 KiB) and limits
+#define PCAN_CAPTURE_BUFFER_DEFAULT (64 * PCAN_CAPTURE_BLOCK_SIZE)
+#define PCAN_CAPTURE_BUFFER_MAX     (2048 * PCAN_CAPTURE_BLOCK_SIZE)
+
+// Default interval after which buffered frames are written anyway
+#define PCAN_CAPTURE_FLUSH_DEFAULT_US (500000)
+
+// Number of frames the writer encodes between checks for file rotation
+#define PCAN_CAPTURE_ROTATE_CHUNK (256)
+
+// Interval at which the writer thread retries opening a pipe that nothing is
+// reading from yet
+#define PCAN_CAPTURE_PIPE_POLL_US (100000)
+
+// Maximum length of a capture file path
+#define PCAN_CAPTURE_PATH_MAX (1024)
+
+// Header written at the start of every native capture file
+typedef struct pcanCaptureHeader_s
+{
+    char magic[8];         // PCAN_CAPTURE_MAGIC, NUL-terminated
+    uint16_t version;      // PCAN_CAPTURE_VERSION
+    uint16_t headerSize;   // PCAN_CAPTURE_HEADER_SIZE
+    uint16_t recordSize;   // Size of each frame record
+    uint16_t flags;        // Reserved (0)
+    uint32_t channel;      // TPCANHandle the frames were received on
+    uint32_t bitrate;      // Nominal bit rate, bits per second (0 if unknown)
+    uint64_t startTime;    // Wall clock time the file was opened, microseconds
+                           // since the Unix epoch
+    uint32_t sequence;     // Index of this file within a rotated capture
+    uint8_t reserved[12];
+} pcanCaptureHeader_t;
+
+typedef char pcanCaptureHeaderSizeCheck_t[
+    (sizeof(pcanCaptureHeader_t) == PCAN_CAPTURE_HEADER_SIZE) ? 1 : -1];
+
+struct pcanCapture_s;
+
+// File format. All functions are called on the writer thread, and return 0
+// on success or 1 on failure. Output is produced with pcanCaptureOutput.
+typedef struct pcanCaptureFormat_s
+{
+    const char *name;
+
+    // Called after a file is opened, to write any file header
+    int (*begin)(struct pcanCapture_s *capture);
+
+    // Called with each run of frames to encode
+    int (*write)(struct pcanCapture_s *capture, const pcanFrame_t *frames, uint32_t count);
+
+    // Called before a file is closed, to write any trailer or fix up earlier
+    // output with pcanCapturePatch. May be 0.
+    int (*end)(struct pcanCapture_s *capture);
+
+    // Called on a timed flush, after the frames received so far have been
+    // passed to write, to output anything the format is holding back. May be
+    // 0.
+    int (*flush)(struct pcanCapture_s *capture);
+
+    // Size of the per-file state allocated for the format (may be 0), which
+    // is zeroed before begin is called
+    size_t stateSize;
+
+    // Nonzero if the format needs pcanCapturePatch, and so cannot be written
+    // to a pipe
+    int seekable;
+} pcanCaptureFormat_t;
+
+// Capture configuration
+typedef struct pcanCaptureOptions_s
+{
+    const pcanCaptureFormat_t *format; // 0 for the native format
+    uint32_t channel;      // Recorded in the file header
+    uint32_t bitrate;      // Recorded in the file header
+    uint32_t bufferSize;   // Size of each of the two buffers, in bytes
+    uint64_t flushUs;      // Maximum time data waits in memory (0 = default)
+    uint64_t rotateBytes;  // Start a new file after this many bytes (0 = off)
+    uint64_t rotateUs;     // Start a new file after this long (0 = off)
+    int compress;          // Format-specific compression (0 = off)
+} pcanCaptureOptions_t;
+
+// Capture statistics
+typedef struct pcanCaptureStats_s
+{
+    uint64_t frames;       // Frames accepted into a buffer
+    uint64_t dropped;      // Frames discarded because both buffers were full
+    uint64_t bytes;        // Bytes written to disk
+    uint32_t files;        // Files opened
+    int error;             // Nonzero if a file could not be opened or written
+} pcanCaptureStats_t;
+
+// One of the two capture buffers
+typedef struct pcanCaptureBuffer_s
+{
+    pcanFrame_t *frames;
+    uint32_t fill;         // Frames appended by the receive thread
+    uint32_t flushed;      // Frames already encoded by a timed flush
+} pcanCaptureBuffer_t;
+
+// Capture state, created by pcanCaptureStart
+typedef struct pcanCapture_s
+{
+    pcanMutex_t lock;
+    pcanCond_t wake;
+    pcanThread_t thread;
+
+    pcanCaptureOptions_t options;
+    char path[PCAN_CAPTURE_PATH_MAX];
+    int pipe;              // path is a named pipe (FIFO) rather than a file
+
+    // Frame buffers, shared by the receive and writer threads under lock
+    pcanCaptureBuffer_t buffers[2];
+    uint32_t bufferFrames; // Capacity of each buffer, in frames
+    int active;            // Buffer being filled by the receive thread
+    int pending;           // The other buffer is full and waiting to be written
+    int stop;              // Writer thread should flush everything and exit
+
+    // Correlation between frame timestamps and wall clock time, taken when
+    // the first frame arrives
+    int clockValid;
+    uint64_t clockWallUs;
+    uint64_t clockFrameUs;
+
+    // Current file, used only by the writer thread
+    FILE *file;
+    uint32_t sequence;     // Index of the file within a rotated capture
+    char fileName[PCAN_CAPTURE_PATH_MAX];
+    uint64_t fileOffset;   // Bytes written to the file so far
+    uint64_t fileStartUs;  // Monotonic time the file was opened
+    uint64_t fileStartWallUs; // Wall clock time the file was opened
+    uint64_t fileFrames;   // Frames encoded into the file
+    uint64_t fileFirstTimestamp; // Timestamp of the first frame in the file
+    void *formatState;     // Per-file format state (options.format->stateSize)
+
+    // Encoded output waiting to be written, used only by the writer thread
+    uint8_t *out;
+    size_t outFill;
+    size_t outCapacity;
+
+    pcanCaptureStats_t stats;
+} pcanCapture_t;
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Global variables
+
+// Native capture file format
+extern const pcanCaptureFormat_t pcanCaptureFormatNative;
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local variables
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local functions
+
+// Writer thread process, started by pcanCaptureStart
+void pcanCaptureThreadProc(void *arg);
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Public functions
+
+// Open the first capture file and start the writer thread. If path is a named
+// pipe, the writer thread opens it once something reads from it, and files
+// are not rotated.
+// Returns the new capture, or 0 on failure (with a reason in *error)
+pcanCapture_t *pcanCaptureStart(const char *path, const pcanCaptureOptions_t *options,
+                                const char **error);
+
+// Append frames to the capture. Called from the receive thread; never blocks
+// on file I/O. Frames that do not fit are counted as dropped.
+void pcanCaptureWrite(pcanCapture_t *capture, const pcanFrame_t *frames, uint32_t count);
+
+// Copy the current statistics
+void pcanCaptureGetStats(pcanCapture_t *capture, pcanCaptureStats_t *stats);
+
+// Write all buffered frames, close the file, stop the writer thread and free
+// the capture. The final statistics are copied to stats if it is not 0.
+void pcanCaptureStop(pcanCapture_t *capture, pcanCaptureStats_t *stats);
+
+// Build the file name for a given rotation sequence number. Sequence 0 is the
+// base path itself; later files get "_NNN" inserted before the extension.
+void pcanCaptureFileName(const char *path, uint32_t sequence, char *name, size_t nameSize);
+
+// Return the format with the given name ("native", etc.), or 0 if unknown
+const pcanCaptureFormat_t *pcanCaptureFindFormat(const char *name);
+
+// Functions for use by formats, on the writer thread:
+
+// Append encoded bytes to the output, writing whole pages to the file as the
+// output buffer fills
+// Returns 0 on success, or 1 on a write error
+int pcanCaptureOutput(pcanCapture_t *capture, const void *data, size_t length);
+
+// Return the file offset at which the next output byte will be written
+uint64_t pcanCaptureOutputOffset(pcanCapture_t *capture);
+
+// Overwrite bytes already output at a given file offset (seekable formats)
+// Returns 0 on success, or 1 on a write error
+int pcanCapturePatch(pcanCapture_t *capture, uint64_t offset, const void *data, size_t length);
+
+// Convert a frame timestamp to wall clock time, in microseconds since the
+// Unix epoch
+uint64_t pcanCaptureWallTime(pcanCapture_t *capture, uint64_t timestamp);
+
+
+
+
+#endif // _PCAN_CAPTURE_H_
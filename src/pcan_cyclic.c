@@ -0,0 +1,612 @@
+/* Native cyclic transmit scheduler
+
+   Sends periodic messages from a dedicated thread, driven by a hashed timer
+   wheel, so that their timing does not depend on the JavaScript event loop.
+
+   Copyright (c) 2020 Control Solutions LLC. All rights reserved.
+*/
+
+#include <stdio.h>       // provide printf
+#include <stdlib.h>      // provide calloc and free
+#include <string.h>      // provide memcpy and memset
+
+#include "pcan_cyclic.h"
+
+
+// ----------------------------------- // -----------------------------------
+// Definitions
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Global variables
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local variables
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local functions
+
+
+// Return the entry for a handle, or 0 if there is none. The lock must be held.
+static pcanCyclicEntry_t *cyclicFind(pcanCyclic_t *cyc, uint32_t id)
+{
+    uint32_t i;
+
+    if (id == 0)
+    {
+        return 0;
+    }
+
+    for (i = 0; i < PCAN_CYCLIC_MAX; i++)
+    {
+        if (cyc->entries[i].id == id)
+        {
+            return &(cyc->entries[i]);
+        }
+    }
+
+    return 0;
+}
+
+
+
+
+// Put an entry in the wheel slot for its deadline. The lock must be held.
+static void cyclicInsert(pcanCyclic_t *cyc, int32_t index)
+{
+    pcanCyclicEntry_t *entry = &(cyc->entries[index]);
+    uint64_t tick = entry->deadline / PCAN_CYCLIC_TICK_US;
+    uint32_t slot = (uint32_t)(tick % PCAN_CYCLIC_SLOTS);
+
+    entry->due = 0;
+    entry->next = cyc->wheel[slot];
+    cyc->wheel[slot] = index;
+
+    // The thread scans forward from the cursor, so it must not pass the entry
+    if (tick < cyc->cursor)
+    {
+        cyc->cursor = tick;
+    }
+
+    return;
+}
+
+
+
+
+// Take an entry out of its wheel slot. The lock must be held.
+static void cyclicUnlink(pcanCyclic_t *cyc, int32_t index)
+{
+    uint32_t slot = (uint32_t)((cyc->entries[index].deadline / PCAN_CYCLIC_TICK_US) % PCAN_CYCLIC_SLOTS);
+    int32_t *link = &(cyc->wheel[slot]);
+
+    while (*link >= 0)
+    {
+        if (*link == index)
+        {
+            *link = cyc->entries[index].next;
+            break;
+        }
+        link = &(cyc->entries[*link].next);
+    }
+
+    cyc->entries[index].next = -1;
+
+    return;
+}
+
+
+
+
+// Return the first tick, from the cursor on, holding an entry due in that
+// tick; or the tick a whole round after the cursor, if nothing is due before
+// then. The lock must be held.
+static uint64_t cyclicNextTick(pcanCyclic_t *cyc)
+{
+    uint64_t tick = cyc->cursor;
+    int32_t index;
+    uint32_t n;
+
+    for (n = 0; n < PCAN_CYCLIC_SLOTS; n++, tick++)
+    {
+        for (index = cyc->wheel[tick % PCAN_CYCLIC_SLOTS]; index >= 0;
+             index = cyc->entries[index].next)
+        {
+            if (cyc->entries[index].deadline / PCAN_CYCLIC_TICK_US <= tick)
+            {
+                return tick;
+            }
+        }
+    }
+
+    return tick;
+}
+
+
+
+
+// Take the entries due in a tick out of the wheel, in deadline order. The lock
+// must be held.
+// Returns the number of entries, whose indexes and handles are in due and ids
+static uint32_t cyclicCollect(pcanCyclic_t *cyc, uint64_t tick, int32_t *due, uint32_t *ids)
+{
+    pcanCyclicEntry_t *entry;
+    int32_t *link = &(cyc->wheel[tick % PCAN_CYCLIC_SLOTS]);
+    int32_t index;
+    uint32_t count = 0;
+    uint32_t i;
+
+    while (*link >= 0)
+    {
+        index = *link;
+        entry = &(cyc->entries[index]);
+
+        if (entry->deadline / PCAN_CYCLIC_TICK_US > tick)
+        {
+            // Due in a later round
+            link = &(entry->next);
+            continue;
+        }
+
+        *link = entry->next;
+        entry->next = -1;
+        entry->due = 1;
+
+        // Insertion sort; a slot holds few entries
+        for (i = count; (i > 0) && (cyc->entries[due[i - 1]].deadline > entry->deadline); i--)
+        {
+            due[i] = due[i - 1];
+            ids[i] = ids[i - 1];
+        }
+        due[i] = index;
+        ids[i] = entry->id;
+        count++;
+    }
+
+    return count;
+}
+
+
+
+
+// Wait until a deadline, on the monotonic clock. The lock must be held; it is
+// released while waiting.
+// Returns 0 at the deadline, or 1 if the schedule changed or the scheduler is
+// stopping first
+static int cyclicWait(pcanCyclic_t *cyc, uint64_t deadline)
+{
+    uint64_t now;
+    uint64_t wake;
+
+    while (!cyc->stop && !cyc->changed)
+    {
+        now = pcanTimeMicros();
+        if (now >= deadline)
+        {
+            return 0;
+        }
+
+        // Long gaps are spent on the condition variable, which changes signal
+        if (deadline > now + PCAN_CYCLIC_COARSE_US)
+        {
+            pcanCondTimedWait(&(cyc->wake), &(cyc->lock), deadline - now - PCAN_CYCLIC_COARSE_US);
+            continue;
+        }
+
+        // Then the high-resolution timer, in steps short enough to notice
+        // changes, waking early enough to spin the rest
+        pcanMutexUnlock(&(cyc->lock));
+
+        if (deadline > now + PCAN_CYCLIC_SPIN_US)
+        {
+            wake = deadline - PCAN_CYCLIC_SPIN_US;
+            pcanTimerSleepUntil(&(cyc->timer), (wake < now + PCAN_CYCLIC_POLL_US) ?
+                                               wake : now + PCAN_CYCLIC_POLL_US);
+        }
+        else
+        {
+            while (pcanTimeMicros() < deadline)
+            {
+            }
+        }
+
+        pcanMutexLock(&(cyc->lock));
+    }
+
+    return 1;
+}
+
+
+
+
+// Write an entry's frame, and schedule its next transmission. The lock must be
+// held; it is released while writing.
+static void cyclicSend(pcanCyclic_t *cyc, int32_t index)
+{
+    pcanCyclicEntry_t *entry = &(cyc->entries[index]);
+    pcanFrame_t frame;
+    TPCANMsg msg;
+    TPCANStatus status;
+    uint32_t id = entry->id;
+    uint64_t attempt;
+    uint64_t late;
+    uint64_t skipped;
+
+    // Copy under the lock, so that an update is sent whole or not at all
+    memcpy(&frame, &(entry->frame), sizeof(frame));
+    pcanMutexUnlock(&(cyc->lock));
+
+    pcanFrameToMsg(&frame, &msg);
+    attempt = pcanTimeMicros();
+    status = CAN_Write(cyc->channel, &msg);
+
+    pcanMutexLock(&(cyc->lock));
+
+    // Removed while it was being written
+    if (entry->id != id)
+    {
+        return;
+    }
+
+    late = (attempt > entry->deadline) ? attempt - entry->deadline : 0;
+
+    if (status == PCAN_ERROR_OK)
+    {
+        entry->stats.sent++;
+    }
+    else
+    {
+        entry->stats.errors++;
+        entry->stats.lastError = status;
+#ifdef PCAN_CYCLIC_DEBUG
+        printf("cyclicSend: 0x%03X: 0x%02X\n", frame.id, status);
+#endif
+    }
+
+    entry->stats.lastLateUs = late;
+    entry->lateSumUs += late;
+    entry->stats.meanLateUs = entry->lateSumUs / (entry->stats.sent + entry->stats.errors);
+    if (late > entry->stats.maxLateUs)
+    {
+        entry->stats.maxLateUs = late;
+    }
+    if (late > PCAN_CYCLIC_LATE_US)
+    {
+        entry->stats.late++;
+    }
+
+    if (entry->stats.remaining > 0)
+    {
+        entry->stats.remaining--;
+        if (entry->stats.remaining == 0)
+        {
+            entry->stats.active = 0;
+            entry->due = 0;
+            cyc->active--;
+            return;
+        }
+    }
+
+    // Keep to the original grid; a period that has already passed is skipped
+    // rather than sent in a burst
+    entry->deadline += entry->periodUs;
+    if (entry->deadline <= attempt)
+    {
+        skipped = (attempt - entry->deadline) / entry->periodUs + 1;
+        entry->stats.missed += skipped;
+        entry->deadline += skipped * entry->periodUs;
+    }
+
+    cyclicInsert(cyc, index);
+
+    return;
+}
+
+
+
+
+void pcanCyclicThreadProc(void *arg)
+{
+    pcanCyclic_t *cyc = (pcanCyclic_t*)arg;
+    int32_t due[PCAN_CYCLIC_MAX];
+    uint32_t ids[PCAN_CYCLIC_MAX];
+    uint32_t count;
+    uint32_t i;
+    uint64_t tick;
+
+#ifdef PCAN_CYCLIC_DEBUG
+    printf("pcanCyclicThreadProc: Starting thread\n");
+#endif
+
+    pcanMutexLock(&(cyc->lock));
+
+    while (!cyc->stop)
+    {
+        if (cyc->active == 0)
+        {
+            pcanCondWait(&(cyc->wake), &(cyc->lock));
+            continue;
+        }
+
+        cyc->changed = 0;
+
+        tick = cyclicNextTick(cyc);
+        if (cyclicWait(cyc, tick * PCAN_CYCLIC_TICK_US) != 0)
+        {
+            continue;
+        }
+
+        cyc->cursor = tick;
+        count = cyclicCollect(cyc, tick, due, ids);
+
+        for (i = 0; i < count; i++)
+        {
+            // Skip entries removed since they were collected
+            if (cyc->entries[due[i]].id != ids[i])
+            {
+                continue;
+            }
+
+            if (cyclicWait(cyc, cyc->entries[due[i]].deadline) != 0)
+            {
+                break;
+            }
+
+            cyclicSend(cyc, due[i]);
+        }
+
+        // Return the rest to the wheel if the schedule changed meanwhile; an
+        // earlier message may have been added
+        for (; i < count; i++)
+        {
+            if ((cyc->entries[due[i]].id == ids[i]) && cyc->entries[due[i]].due)
+            {
+                cyclicInsert(cyc, due[i]);
+            }
+        }
+    }
+
+    pcanMutexUnlock(&(cyc->lock));
+
+#ifdef PCAN_CYCLIC_DEBUG
+    printf("pcanCyclicThreadProc: Exiting thread\n");
+#endif
+
+    return;
+}
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Public functions
+
+
+pcanCyclic_t *pcanCyclicStart(TPCANHandle channel, const char **error)
+{
+    pcanCyclic_t *cyc = 0;
+    uint32_t i;
+
+    cyc = calloc(1, sizeof(*cyc));
+    if (cyc == 0)
+    {
+        *error = "Error allocating memory for cyclic scheduler.";
+        return 0;
+    }
+
+    cyc->channel = channel;
+    cyc->nextId = 1;
+    cyc->cursor = pcanTimeMicros() / PCAN_CYCLIC_TICK_US;
+
+    for (i = 0; i < PCAN_CYCLIC_SLOTS; i++)
+    {
+        cyc->wheel[i] = -1;
+    }
+    for (i = 0; i < PCAN_CYCLIC_MAX; i++)
+    {
+        cyc->entries[i].next = -1;
+    }
+
+    if (pcanTimerInit(&(cyc->timer)) != 0)
+    {
+        free(cyc);
+        *error = "Unable to create cyclic scheduler timer.";
+        return 0;
+    }
+
+    pcanMutexInit(&(cyc->lock));
+    pcanCondInit(&(cyc->wake));
+
+    if (pcanThreadCreate(&(cyc->thread), pcanCyclicThreadProc, cyc) != 0)
+    {
+        pcanCondDestroy(&(cyc->wake));
+        pcanMutexDestroy(&(cyc->lock));
+        pcanTimerDestroy(&(cyc->timer));
+        free(cyc);
+        *error = "Unable to start cyclic scheduler thread.";
+        return 0;
+    }
+
+#ifdef PCAN_CYCLIC_DEBUG
+    printf("pcanCyclicStart: Channel 0x%02X\n", channel);
+#endif
+
+    return cyc;
+}
+
+
+
+
+uint32_t pcanCyclicAdd(pcanCyclic_t *cyc, const pcanFrame_t *frame, uint64_t periodUs,
+                       uint32_t count, uint64_t phaseUs)
+{
+    pcanCyclicEntry_t *entry = 0;
+    int32_t index = -1;
+    int32_t i;
+
+    pcanMutexLock(&(cyc->lock));
+
+    // Prefer a free entry, then one that has finished
+    for (i = 0; (i < PCAN_CYCLIC_MAX) && (index < 0); i++)
+    {
+        if (cyc->entries[i].id == 0)
+        {
+            index = i;
+        }
+    }
+    for (i = 0; (i < PCAN_CYCLIC_MAX) && (index < 0); i++)
+    {
+        if (!cyc->entries[i].stats.active)
+        {
+            index = i;
+        }
+    }
+
+    if (index < 0)
+    {
+        pcanMutexUnlock(&(cyc->lock));
+        return 0;
+    }
+
+    entry = &(cyc->entries[index]);
+    memset(entry, 0, sizeof(*entry));
+
+    entry->id = cyc->nextId++;
+    if (cyc->nextId == 0)
+    {
+        cyc->nextId = 1;
+    }
+
+    memcpy(&(entry->frame), frame, sizeof(pcanFrame_t));
+    entry->periodUs = (periodUs > 0) ? periodUs : 1;
+    entry->deadline = pcanTimeMicros() + phaseUs;
+    entry->stats.remaining = count;
+    entry->stats.active = 1;
+    entry->stats.lastError = PCAN_ERROR_OK;
+
+    // An idle thread's cursor may be far behind; start it at this entry
+    if (cyc->active == 0)
+    {
+        cyc->cursor = entry->deadline / PCAN_CYCLIC_TICK_US;
+    }
+    cyc->active++;
+
+    cyclicInsert(cyc, index);
+
+    cyc->changed = 1;
+    pcanCondSignal(&(cyc->wake));
+
+    pcanMutexUnlock(&(cyc->lock));
+
+#ifdef PCAN_CYCLIC_DEBUG
+    printf("pcanCyclicAdd: %u: 0x%03X every %llu us\n", entry->id, frame->id,
+           (unsigned long long)periodUs);
+#endif
+
+    return entry->id;
+}
+
+
+
+
+int pcanCyclicUpdate(pcanCyclic_t *cyc, uint32_t id, const pcanFrame_t *frame)
+{
+    pcanCyclicEntry_t *entry;
+
+    pcanMutexLock(&(cyc->lock));
+
+    entry = cyclicFind(cyc, id);
+    if (entry != 0)
+    {
+        memcpy(&(entry->frame), frame, sizeof(pcanFrame_t));
+    }
+
+    pcanMutexUnlock(&(cyc->lock));
+
+    return (entry == 0) ? 1 : 0;
+}
+
+
+
+
+int pcanCyclicGetStats(pcanCyclic_t *cyc, uint32_t id, pcanCyclicStats_t *stats)
+{
+    pcanCyclicEntry_t *entry;
+
+    pcanMutexLock(&(cyc->lock));
+
+    entry = cyclicFind(cyc, id);
+    if (entry != 0)
+    {
+        *stats = entry->stats;
+    }
+
+    pcanMutexUnlock(&(cyc->lock));
+
+    return (entry == 0) ? 1 : 0;
+}
+
+
+
+
+int pcanCyclicRemove(pcanCyclic_t *cyc, uint32_t id, pcanCyclicStats_t *stats)
+{
+    pcanCyclicEntry_t *entry;
+
+    pcanMutexLock(&(cyc->lock));
+
+    entry = cyclicFind(cyc, id);
+    if (entry != 0)
+    {
+        if (stats != 0)
+        {
+            *stats = entry->stats;
+        }
+
+        // An entry the thread has collected is skipped once its handle is gone
+        if (entry->stats.active)
+        {
+            if (!entry->due)
+            {
+                cyclicUnlink(cyc, (int32_t)(entry - cyc->entries));
+            }
+            cyc->active--;
+        }
+
+        entry->id = 0;
+        entry->due = 0;
+        entry->stats.active = 0;
+    }
+
+    pcanMutexUnlock(&(cyc->lock));
+
+    return (entry == 0) ? 1 : 0;
+}
+
+
+
+
+void pcanCyclicStop(pcanCyclic_t *cyc)
+{
+    pcanMutexLock(&(cyc->lock));
+    cyc->stop = 1;
+    pcanCondSignal(&(cyc->wake));
+    pcanMutexUnlock(&(cyc->lock));
+
+    pcanThreadJoin(cyc->thread);
+
+    pcanCondDestroy(&(cyc->wake));
+    pcanMutexDestroy(&(cyc->lock));
+    pcanTimerDestroy(&(cyc->timer));
+    free(cyc);
+
+    return;
+}
@@ -0,0 +1,171 @@
+/* Native cyclic transmit scheduler
+
+   Sends periodic messages (heartbeats, status broadcasts, and the like) from
+   a dedicated thread, in the manner of the SocketCAN broadcast manager, so
+   their timing does not depend on the JavaScript event loop. Messages are
+   kept in a hashed timer wheel of PCAN_CYCLIC_SLOTS slots, each covering
+   PCAN_CYCLIC_TICK_US, so finding the next message due never involves more
+   than the few messages in one slot. Within a tick, each message is written
+   at its exact deadline by sleeping on a high-resolution timer and spinning
+   for the last few microseconds. A message's payload can be replaced at any
+   time without disturbing its schedule.
+
+   Copyright (c) 2020 Control Solutions LLC. All rights reserved.
+*/
+
+#ifndef _PCAN_CYCLIC_H_
+#define _PCAN_CYCLIC_H_
+
+#include <stdint.h>      // provide uintX_t
+
+#if defined _WIN32
+#include <windows.h>     // provide Win32 types, constants, and functions
+#include <PCANBasic.h>   // provide PCAN-Basic types, constants, and functions
+#elif defined __APPLE__
+#include <PCBUSB.h>      // provide PCAN-Basic types, constants, and functions
+#endif
+
+#include "pcan_frame.h"  // provide pcanFrame_t
+#include "pcan_thread.h" // provide pcanThread_t, pcanMutex_t, pcanCond_t, and pcanTimer_t
+
+
+//#define PCAN_CYCLIC_DEBUG
+// Uncomment to enable debugging messages, which may affect timing or
+// performance
+
+// ----------------------------------- // -----------------------------------
+// Definitions
+
+// Maximum number of cyclic messages on a channel
+#define PCAN_CYCLIC_MAX (256)
+
+// Timer wheel resolution and size; messages due more than
+// PCAN_CYCLIC_TICK_US * PCAN_CYCLIC_SLOTS ahead wait for later rounds
+#define PCAN_CYCLIC_TICK_US (1000)
+#define PCAN_CYCLIC_SLOTS (1024)
+
+// Time spent spinning before each deadline
+#define PCAN_CYCLIC_SPIN_US (100)
+
+// Lateness above which a transmission is counted as late
+#define PCAN_CYCLIC_LATE_US (1000)
+
+// Waits longer than this are spent on the condition variable, so that
+// changes to the schedule are seen at once; it must exceed the scheduler tick
+#define PCAN_CYCLIC_COARSE_US (20000)
+
+// Shorter waits sleep in steps of at most this long, so that changes to the
+// schedule are still seen promptly
+#define PCAN_CYCLIC_POLL_US (1000)
+
+// Statistics for one cyclic message. Lateness is the time from a deadline
+// until CAN_Write was called.
+typedef struct pcanCyclicStats_s
+{
+    uint64_t sent;         // Transmissions accepted by CAN_Write
+    uint64_t errors;       // Transmissions CAN_Write did not accept
+    uint64_t late;         // Transmissions more than PCAN_CYCLIC_LATE_US late
+    uint64_t missed;       // Periods skipped because the scheduler fell a whole period behind
+    uint64_t meanLateUs;
+    uint64_t maxLateUs;
+    uint64_t lastLateUs;
+    uint32_t remaining;    // Transmissions left, or 0 if unlimited
+    int active;            // Still scheduled, rather than having sent its count
+    TPCANStatus lastError; // Last status other than PCAN_ERROR_OK
+} pcanCyclicStats_t;
+
+// Cyclic message
+typedef struct pcanCyclicEntry_s
+{
+    uint32_t id;           // Handle returned by pcanCyclicAdd, or 0 if the entry is free
+    pcanFrame_t frame;
+    uint64_t periodUs;
+    uint64_t deadline;     // Next transmission, in pcanTimeMicros time
+    int32_t next;          // Next entry in the same wheel slot, or -1
+    int due;               // Taken out of the wheel by the thread to be sent
+    pcanCyclicStats_t stats;
+    uint64_t lateSumUs;
+} pcanCyclicEntry_t;
+
+// Scheduler state for one channel
+typedef struct pcanCyclic_s
+{
+    pcanMutex_t lock;
+    pcanCond_t wake;
+    pcanThread_t thread;
+    pcanTimer_t timer;
+
+    TPCANHandle channel;
+    uint32_t nextId;
+
+    pcanCyclicEntry_t entries[PCAN_CYCLIC_MAX];
+    uint32_t active;       // Entries in the wheel or being sent
+
+    // First entry in each slot, or -1
+    int32_t wheel[PCAN_CYCLIC_SLOTS];
+    uint64_t cursor;       // Earliest tick that may hold a due entry
+
+    int changed;           // An entry was added or removed since the thread looked
+    int stop;
+} pcanCyclic_t;
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Global variables
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local variables
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local functions
+
+// Scheduler thread process, started by pcanCyclicStart
+void pcanCyclicThreadProc(void *arg);
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Public functions
+
+// Create a scheduler for a channel, and start its thread
+// Returns the new scheduler, or 0 on failure (with a reason in *error)
+pcanCyclic_t *pcanCyclicStart(TPCANHandle channel, const char **error);
+
+// Schedule a frame every periodUs, the first phaseUs from now, count times
+// (or until removed, if count is 0). A message that has sent its count keeps
+// its statistics until it is removed, or until its entry is needed for a new
+// message.
+// Returns a handle for the message, or 0 if the scheduler is full
+uint32_t pcanCyclicAdd(pcanCyclic_t *cyc, const pcanFrame_t *frame, uint64_t periodUs,
+                       uint32_t count, uint64_t phaseUs);
+
+// Replace the identifier and payload of a message, keeping its schedule. The
+// next transmission sends either the old frame or the new one, never a mix.
+// Returns 0 on success, or 1 if there is no such message
+int pcanCyclicUpdate(pcanCyclic_t *cyc, uint32_t id, const pcanFrame_t *frame);
+
+// Copy the statistics for a message
+// Returns 0 on success, or 1 if there is no such message
+int pcanCyclicGetStats(pcanCyclic_t *cyc, uint32_t id, pcanCyclicStats_t *stats);
+
+// Stop sending a message, and forget it. Its final statistics are copied to
+// stats if it is not 0.
+// Returns 0 on success, or 1 if there is no such message
+int pcanCyclicRemove(pcanCyclic_t *cyc, uint32_t id, pcanCyclicStats_t *stats);
+
+// Stop the scheduler thread, and free the scheduler
+void pcanCyclicStop(pcanCyclic_t *cyc);
+
+
+
+
+#endif // _PCAN_CYCLIC_H_
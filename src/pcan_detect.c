@@ -0,0 +1,381 @@
+/* Automatic bit rate detection
+
+   Listens to a bus at each candidate bit rate in turn, in listen-only mode,
+   and scores each rate by the valid frames and errors received at it.
+
+   Copyright (c) 2020 Control Solutions LLC. All rights reserved.
+*/
+
+#include <stdio.h>       // provide printf
+#include <stdlib.h>      // provide calloc and free
+#include <string.h>      // provide memcpy
+
+#include "pcan_detect.h"
+
+
+// ----------------------------------- // -----------------------------------
+// Definitions
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Global variables
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local variables
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local functions
+
+
+// Return nonzero once the scan has been asked to stop
+static int detectStopping(pcanDetect_t *detect)
+{
+    int stopping;
+
+    pcanMutexLock(&(detect->lock));
+    stopping = detect->stop;
+    pcanMutexUnlock(&(detect->lock));
+
+    return stopping;
+}
+
+
+
+
+// Return nonzero if a candidate settles the scan: at least minFrames valid
+// frames, and minFrames of them for every error
+static int detectSettled(const pcanDetect_t *detect, const pcanDetectScore_t *score)
+{
+    uint32_t minFrames = detect->options.minFrames;
+
+    return (score->frames >= minFrames) &&
+        ((uint64_t)score->frames >= (uint64_t)minFrames * score->errors);
+}
+
+
+
+
+// Return nonzero if a candidate is not worth trying again: the channel could
+// not be initialized at it, or it saw rejectErrors errors and no valid frame
+static int detectRejected(const pcanDetect_t *detect, const pcanDetectScore_t *score)
+{
+    return (score->lastError != PCAN_ERROR_OK) ||
+        ((score->frames == 0) && (score->errors >= detect->options.rejectErrors));
+}
+
+
+
+
+// Read everything in the receive queue into a candidate's score
+static void detectDrain(pcanDetect_t *detect, pcanDetectScore_t *score)
+{
+    TPCANMsg msg;
+    TPCANTimestamp timestamp;
+
+    while (CAN_Read(detect->channel, &msg, &timestamp) == PCAN_ERROR_OK)
+    {
+        if (msg.MSGTYPE & PCAN_MESSAGE_ERRFRAME)
+        {
+            score->errors++;
+        }
+        else if (!(msg.MSGTYPE & PCAN_MESSAGE_STATUS))
+        {
+            score->frames++;
+        }
+    }
+
+    return;
+}
+
+
+
+
+// Listen to the bus at a candidate rate until it is settled or rejected, its
+// dwell time is up, or the scan ends
+// Returns nonzero if the scan was stopped
+static int detectListen(pcanDetect_t *detect, uint32_t index, uint64_t end)
+{
+    pcanDetectScore_t *score = &(detect->result.scores[index]);
+    uint64_t begin = pcanTimeMicros();
+    uint64_t deadline = begin + detect->options.dwellUs;
+    uint64_t now = begin;
+    uint8_t on = 1;
+    uint8_t off = 0;
+    int stopping = 0;
+    int busError = 0;
+    TPCANStatus status = PCAN_ERROR_UNKNOWN;
+
+    if (deadline > end)
+    {
+        deadline = end;
+    }
+
+    // Listen-only mode must be set before the channel is initialized
+    CAN_SetValue(detect->channel, PCAN_LISTEN_ONLY, &on, sizeof(on));
+    status = CAN_Initialize(detect->channel, detect->candidates[index], 0, 0, 0);
+    if (status != PCAN_ERROR_OK)
+    {
+        CAN_SetValue(detect->channel, PCAN_LISTEN_ONLY, &off, sizeof(off));
+        score->lastError = status;
+        return detectStopping(detect);
+    }
+
+    // Error frames make a wrong rate show at once; without them, the bus
+    // status polled below is the only sign of one
+    CAN_SetValue(detect->channel, PCAN_ALLOW_ERROR_FRAMES, &on, sizeof(on));
+    score->passes++;
+
+    for (;;)
+    {
+        detectDrain(detect, score);
+
+        // A bus error flag stays set for as long as the condition lasts, so
+        // it counts once each time it is raised rather than on every poll
+        if (CAN_GetStatus(detect->channel) & PCAN_ERROR_ANYBUSERR)
+        {
+            if (!busError)
+            {
+                score->errors++;
+            }
+            busError = 1;
+        }
+        else
+        {
+            busError = 0;
+        }
+
+        now = pcanTimeMicros();
+        if (detectSettled(detect, score))
+        {
+            detect->result.index = (int)index;
+            detect->result.confident = 1;
+            break;
+        }
+        if (detectRejected(detect, score) || (now >= deadline))
+        {
+            break;
+        }
+        if (detectStopping(detect))
+        {
+            stopping = 1;
+            break;
+        }
+
+        pcanTimerSleepUntil(&(detect->timer), now + PCAN_DETECT_POLL_US);
+    }
+
+    score->elapsedUs += now - begin;
+
+    CAN_SetValue(detect->channel, PCAN_ALLOW_ERROR_FRAMES, &off, sizeof(off));
+    CAN_Uninitialize(detect->channel);
+    CAN_SetValue(detect->channel, PCAN_LISTEN_ONLY, &off, sizeof(off));
+
+#ifdef PCAN_DETECT_DEBUG
+    printf("detectListen: 0x%04X, %u frames, %u errors\n",
+           (unsigned)detect->candidates[index], score->frames, score->errors);
+#endif
+
+    return stopping;
+}
+
+
+
+
+// Pick the candidate with the largest share of valid frames, if more than half
+// of what it saw was valid; more frames break ties
+static int detectBest(const pcanDetect_t *detect)
+{
+    const pcanDetectResult_t *result = &(detect->result);
+    const pcanDetectScore_t *score;
+    const pcanDetectScore_t *best = 0;
+    int index = -1;
+    uint32_t i;
+
+    for (i = 0; i < result->count; i++)
+    {
+        score = &(result->scores[i]);
+        if (score->frames <= score->errors)
+        {
+            continue;
+        }
+
+        // Compare frames / (frames + errors) without dividing
+        if ((best == 0) ||
+            ((uint64_t)score->frames * (best->frames + best->errors) >
+             (uint64_t)best->frames * (score->frames + score->errors)) ||
+            (((uint64_t)score->frames * (best->frames + best->errors) ==
+              (uint64_t)best->frames * (score->frames + score->errors)) &&
+             (score->frames > best->frames)))
+        {
+            best = score;
+            index = (int)i;
+        }
+    }
+
+    return index;
+}
+
+
+
+
+void pcanDetectThreadProc(void *arg)
+{
+    pcanDetect_t *detect = (pcanDetect_t*)arg;
+    pcanDetectResult_t *result = &(detect->result);
+    uint64_t start = pcanTimeMicros();
+    uint64_t end = start + detect->options.timeoutUs;
+    uint32_t i;
+    int stopping = 0;
+    int tried = 1;
+
+#ifdef PCAN_DETECT_DEBUG
+    printf("pcanDetectThreadProc: Starting thread\n");
+#endif
+
+    // Pass over the candidates still in the running until one is settled, or
+    // time runs out
+    while (!stopping && tried && (result->index < 0) && (pcanTimeMicros() < end))
+    {
+        tried = 0;
+        for (i = 0; (i < result->count) && !stopping && (result->index < 0); i++)
+        {
+            if (detectRejected(detect, &(result->scores[i])))
+            {
+                continue;
+            }
+            if (pcanTimeMicros() >= end)
+            {
+                break;
+            }
+
+            stopping = detectListen(detect, i, end);
+            tried = 1;
+        }
+    }
+
+    if (result->index < 0)
+    {
+        result->index = detectBest(detect);
+    }
+    result->stopped = stopping;
+    result->elapsedUs = pcanTimeMicros() - start;
+
+#ifdef PCAN_DETECT_DEBUG
+    printf("pcanDetectThreadProc: Exiting thread, candidate %d\n", result->index);
+#endif
+
+    if (!stopping && (detect->done != 0))
+    {
+        detect->done(detect->doneContext);
+    }
+
+    return;
+}
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Public functions
+
+
+pcanDetect_t *pcanDetectStart(TPCANHandle channel, const TPCANBaudrate *candidates,
+                              uint32_t count, const pcanDetectOptions_t *options,
+                              pcanDetectDone_t done, void *context, const char **error)
+{
+    pcanDetect_t *detect = 0;
+
+    if ((count == 0) || (count > PCAN_DETECT_CANDIDATES_MAX))
+    {
+        *error = "Bit rate detection needs between 1 and 32 candidates.";
+        return 0;
+    }
+
+    detect = calloc(1, sizeof(*detect));
+    if (detect == 0)
+    {
+        *error = "Error allocating memory for bit rate detection.";
+        return 0;
+    }
+
+    detect->channel = channel;
+    detect->options = *options;
+    detect->done = done;
+    detect->doneContext = context;
+    memcpy(detect->candidates, candidates, count * sizeof(TPCANBaudrate));
+    detect->result.index = -1;
+    detect->result.count = count;
+
+    if (detect->options.timeoutUs == 0)
+    {
+        detect->options.timeoutUs = PCAN_DETECT_TIMEOUT_DEFAULT_US;
+    }
+    if (detect->options.dwellUs == 0)
+    {
+        detect->options.dwellUs = PCAN_DETECT_DWELL_DEFAULT_US;
+    }
+    if (detect->options.minFrames == 0)
+    {
+        detect->options.minFrames = PCAN_DETECT_MIN_FRAMES_DEFAULT;
+    }
+    if (detect->options.rejectErrors == 0)
+    {
+        detect->options.rejectErrors = PCAN_DETECT_REJECT_ERRORS_DEFAULT;
+    }
+
+    if (pcanTimerInit(&(detect->timer)) != 0)
+    {
+        free(detect);
+        *error = "Unable to create bit rate detection timer.";
+        return 0;
+    }
+
+    pcanMutexInit(&(detect->lock));
+
+    if (pcanThreadCreate(&(detect->thread), pcanDetectThreadProc, detect) != 0)
+    {
+        pcanMutexDestroy(&(detect->lock));
+        pcanTimerDestroy(&(detect->timer));
+        free(detect);
+        *error = "Unable to start bit rate detection thread.";
+        return 0;
+    }
+
+#ifdef PCAN_DETECT_DEBUG
+    printf("pcanDetectStart: %u candidates, timeout = %llu us\n",
+           count, (unsigned long long)detect->options.timeoutUs);
+#endif
+
+    return detect;
+}
+
+
+
+
+void pcanDetectStop(pcanDetect_t *detect, pcanDetectResult_t *result)
+{
+    pcanMutexLock(&(detect->lock));
+    detect->stop = 1;
+    pcanMutexUnlock(&(detect->lock));
+
+    pcanThreadJoin(detect->thread);
+
+    if (result != 0)
+    {
+        *result = detect->result;
+    }
+
+    pcanMutexDestroy(&(detect->lock));
+    pcanTimerDestroy(&(detect->timer));
+    free(detect);
+
+    return;
+}
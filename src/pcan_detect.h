@@ -0,0 +1,155 @@
+/* Automatic bit rate detection
+
+   Finds the bit rate of a bus by listening to it at each candidate rate in
+   turn, on a dedicated thread. The channel is initialized in listen-only mode,
+   so that it never acknowledges frames or signals errors at a wrong rate, and
+   with error frames allowed, so that a wrong rate shows itself at once by the
+   errors the controller detects. Each candidate is scored by the valid frames
+   and errors it saw:
+
+   - minFrames valid frames, and as many for every error, settle the scan on
+     a candidate
+   - rejectErrors errors without a valid frame reject it for the rest of the
+     scan
+   - otherwise the candidate is left after dwellUs, and tried again in the
+     next pass if no candidate was settled and time remains
+
+   On an active bus a wrong rate is rejected within a couple of frames, and
+   the right one settled within minFrames, so a scan takes a few frame times
+   per candidate. Only a quiet bus makes the scan last until its timeout.
+
+   Copyright (c) 2020 Control Solutions LLC. All rights reserved.
+*/
+
+#ifndef _PCAN_DETECT_H_
+#define _PCAN_DETECT_H_
+
+#include <stdint.h>      // provide uintX_t
+
+#if defined _WIN32
+#include <windows.h>     // provide Win32 types, constants, and functions
+#include <PCANBasic.h>   // provide PCAN-Basic types, constants, and functions
+#elif defined __APPLE__
+#include <PCBUSB.h>      // provide PCAN-Basic types, constants, and functions
+#endif
+
+#include "pcan_thread.h" // provide pcanThread_t, pcanMutex_t, and pcanTimer_t
+
+
+//#define PCAN_DETECT_DEBUG
+// Uncomment to enable debugging messages
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Definitions
+
+// Most bit rates a single scan can try
+#define PCAN_DETECT_CANDIDATES_MAX (32)
+
+// Interval at which the receive queue is polled while listening
+#define PCAN_DETECT_POLL_US (500)
+
+// Defaults for pcanDetectOptions_t
+#define PCAN_DETECT_TIMEOUT_DEFAULT_US (1000000)
+#define PCAN_DETECT_DWELL_DEFAULT_US (50000)
+#define PCAN_DETECT_MIN_FRAMES_DEFAULT (4)
+#define PCAN_DETECT_REJECT_ERRORS_DEFAULT (2)
+
+// Detection configuration
+typedef struct pcanDetectOptions_s
+{
+    uint64_t timeoutUs;    // Longest time the whole scan may take
+    uint64_t dwellUs;      // Longest time spent on a candidate in each pass
+    uint32_t minFrames;    // Valid frames, without errors, that settle a candidate
+    uint32_t rejectErrors; // Errors, without valid frames, that reject a candidate
+} pcanDetectOptions_t;
+
+// Evidence collected for a candidate, over all passes
+typedef struct pcanDetectScore_s
+{
+    uint32_t frames;       // Valid frames received
+    uint32_t errors;       // Error frames received, and bus error flags raised
+    uint64_t elapsedUs;    // Time spent listening at this rate
+    uint32_t passes;       // Times the rate was tried
+    TPCANStatus lastError; // Status of a failed CAN_Initialize, if any
+} pcanDetectScore_t;
+
+// Outcome of a scan
+typedef struct pcanDetectResult_s
+{
+    int index;             // Candidate detected, or -1 if none was
+    int confident;         // The candidate was settled, rather than best scored
+    int stopped;           // The scan was stopped before it finished
+    uint64_t elapsedUs;
+    uint32_t count;
+    pcanDetectScore_t scores[PCAN_DETECT_CANDIDATES_MAX];
+} pcanDetectResult_t;
+
+// Called on the detection thread when the scan finishes on its own
+typedef void (*pcanDetectDone_t)(void *context);
+
+// Detection state, created by pcanDetectStart
+typedef struct pcanDetect_s
+{
+    pcanMutex_t lock;
+    pcanThread_t thread;
+    pcanTimer_t timer;
+    TPCANHandle channel;
+    TPCANBaudrate candidates[PCAN_DETECT_CANDIDATES_MAX];
+    pcanDetectOptions_t options;
+    pcanDetectDone_t done;
+    void *doneContext;
+
+    // Used only by the detection thread until it exits
+    pcanDetectResult_t result;
+
+    // Shared with the calling thread under lock
+    int stop;
+} pcanDetect_t;
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Global variables
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local variables
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local functions
+
+// Detection thread process, started by pcanDetectStart
+void pcanDetectThreadProc(void *arg);
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Public functions
+
+// Start scanning an uninitialized channel for the first of count BTR0BTR1
+// candidates, tried in order, at which the bus can be received. done(context)
+// is called on the detection thread when the scan finishes; it may be 0. The
+// channel is left uninitialized, with listen-only mode off.
+// Returns the new detection, or 0 on failure (with a reason in *error)
+pcanDetect_t *pcanDetectStart(TPCANHandle channel, const TPCANBaudrate *candidates,
+                              uint32_t count, const pcanDetectOptions_t *options,
+                              pcanDetectDone_t done, void *context, const char **error);
+
+// Stop the scan if it is still running, wait for the thread to exit, and free
+// the detection. The outcome is copied to result if it is not 0.
+void pcanDetectStop(pcanDetect_t *detect, pcanDetectResult_t *result);
+
+
+
+
+#endif // _PCAN_DETECT_H_
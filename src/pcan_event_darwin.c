@@ -19,30 +19,28 @@
 #include <errno.h>       // provide errno
 #include <pthread.h>     // provide pthread_create, pthread_join, and types
 #include <unistd.h>      // provide pipe
-#include <string.h>      // provide memcpy and strerror
+#include <string.h>      // provide strerror
 #include <stdlib.h>      // provide malloc and free
 #include <PCBUSB.h>      // provide PCAN-Basic types, constants, and functions
 #endif
 
-#include "pcan.h"        // provide default callback function
 #include "pcan_event_darwin.h"
 #include "pcan_helper.h" // provide pcanStatusLookup
 
 
 // Pipes are used here instead of condition variables because the PCBUSB library
 // provides event notifications via the read end of a pipe, which is expected
-// to be waited on using select(2). Both pcanPipeExit[R] and pcanPipeRead
-// (pipe read ends) can be put into an fd_set and waited on by the same
-// select(2) call. This is similar to the use of WaitForMultipleObjects in
-// the Win32 version.
+// to be waited on using select(2). Both pipeExit[R] and pipeRead (pipe read
+// ends) can be put into an fd_set and waited on by the same select(2) call.
+// This is similar to the use of WaitForMultipleObjects in the Win32 version.
 
 
 // ----------------------------------- // -----------------------------------
 // Definitions
 
-// Constants for accessing arrays of pipe file descriptors below. Following
-// convention, the read end of the pipe is first ([0]) and the write end is
-// second ([1]).
+// Constants for accessing arrays of pipe file descriptors in pcanEvent_t.
+// Following convention, the read end of the pipe is first ([0]) and the write
+// end is second ([1]).
 enum { R, W };
 
 
@@ -57,47 +55,57 @@ enum { R, W };
 // ----------------------------------- // -----------------------------------
 // Local variables
 
-// Pipe fd for CAN bus read event, signaled my main thread (PCAN-Basic API) when
-// a message has been received and waited on by worker thread
-int pcanPipeRead = 0;
 
-// Pipe file descriptors for worker thread spawn signaling,
-// signaled by worker shortly after thread starts and waited on by main thread.
-int pcanPipeSpawn[2] = { 0 };
 
-// Pipe file descriptors for worker thread exit signaling,
-// signaled by main thread during exit routine, and waited on by worker thread
-int pcanPipeExit[2] = { 0 };
 
-// Worker thread ID, populated by pcanEventEnable
-pthread_t pcanEventThread = 0;
+// ----------------------------------- // -----------------------------------
+// Local functions
 
 
+// Close the pipes of an event, and free it
+static void pcanEventFree(pcanEvent_t *event)
+{
+    int i;
+
+    for (i = R; i <= W; i++)
+    {
+        if (event->pipeSpawn[i] >= 0)
+        {
+            close(event->pipeSpawn[i]);
+        }
+        if (event->pipeExit[i] >= 0)
+        {
+            close(event->pipeExit[i]);
+        }
+    }
+
+    free(event);
+
+    return;
+}
 
 
-// ----------------------------------- // -----------------------------------
-// Local functions
 
 
 void *pcanEventThreadProc(void *lpParam)
 {
     int ret = 0;
 
-    // Copy parameters passed from the main thread
-    threadParameters_t threadParams = { 0 };
-    memcpy(&threadParams, (threadParameters_t*)lpParam, sizeof(threadParams));
+    // The event outlives the thread, which pcanEventDisable joins before
+    // freeing it
+    pcanEvent_t *event = (pcanEvent_t*)lpParam;
 
 #ifdef PCAN_EVENT_DARWIN_DEBUG
-    pcanDumpThreadParameters(&threadParams);
+    pcanDumpEvent(event);
 #endif
 
     // Signal the spawn pipe, indicating that the worker thread is running
     size_t count = 0;
     int buf = 0;
-    count = write(threadParams.pipeSpawn, &buf, sizeof(buf));
+    count = write(event->pipeSpawn[W], &buf, sizeof(buf));
     if (count != sizeof(buf))
     {
-        printf("pcanEventThreadProc: Error at write(threadParams.pipeSpawn)\n");
+        printf("pcanEventThreadProc: Error at write(pipeSpawn)\n");
         return (void*)1;
     }
 
@@ -116,26 +124,26 @@ void *pcanEventThreadProc(void *lpParam)
 
         // Set up file descriptors for select
         FD_ZERO(&readfds);
-        FD_SET(threadParams.pipeRead, &readfds);
-        FD_SET(threadParams.pipeExit, &readfds);
+        FD_SET(event->pipeRead, &readfds);
+        FD_SET(event->pipeExit[R], &readfds);
 
         // Determine greatest file descriptor
-        nfds = (threadParams.pipeRead > threadParams.pipeExit) ?
-            threadParams.pipeRead : threadParams.pipeExit;
+        nfds = (event->pipeRead > event->pipeExit[R]) ?
+            event->pipeRead : event->pipeExit[R];
 
         ret = select(nfds+1, &readfds, NULL, NULL, &timeout);
 
-        if (FD_ISSET(threadParams.pipeExit, &readfds))
+        if (FD_ISSET(event->pipeExit[R], &readfds))
         {
 #ifdef PCAN_EVENT_DARWIN_DEBUG
             printf("pcanEventThreadProc: Received exit signal.\n");
 #endif
             threadExit = 1;
         }
-        else if (FD_ISSET(threadParams.pipeRead, &readfds))
+        else if (FD_ISSET(event->pipeRead, &readfds))
         {
             // Invoke callback
-            (threadParams.callback)(threadParams.canChannel);
+            (event->callback)(event->context);
         }
         else if (ret == 0)
         {
@@ -163,72 +171,78 @@ void *pcanEventThreadProc(void *lpParam)
 // Public functions
 
 
-int pcanEventEnable(TPCANHandle pcanChannel, void *callback)
+pcanEvent_t *pcanEventEnable(TPCANHandle pcanChannel, pcanEventCallback_t callback,
+                             void *context)
 {
     int ret = 0;
 
     TPCANStatus pcanResult = 0;
 
+    pcanEvent_t *event = 0;
+    event = malloc(sizeof(*event));
+    if (event == 0)
+    {
+        printf("pcanEventEnable: Error at malloc.\n");
+        return 0;
+    }
+
+    event->channel = pcanChannel;
+    event->callback = callback;
+    event->context = context;
+    event->pipeRead = -1;
+    event->pipeSpawn[R] = event->pipeSpawn[W] = -1;
+    event->pipeExit[R] = event->pipeExit[W] = -1;
+
     // Retreive the pipe file descriptor that the PCANBasic API will use to
     // communciate CAN read events with the worker thread
     pcanResult = CAN_GetValue(pcanChannel, PCAN_RECEIVE_EVENT,
-                              &pcanPipeRead, sizeof(int));
+                              &(event->pipeRead), sizeof(int));
 
     if (pcanResult != PCAN_ERROR_OK)
     {
         printf("pcanEventEnable: Error at CAN_GetValue: 0x%02X (%s)\n",
                pcanResult, pcanStatusLookup(pcanResult));
+        pcanEventFree(event);
+        return 0;
     }
 
     // Create pipe that worker thread will use to signal it has started
-    ret = pipe(pcanPipeSpawn);
+    ret = pipe(event->pipeSpawn);
     if (ret == -1)
     {
-        printf("pcanEventEnable: Error at pipe(pcanPipeSpawn): 0x%02X\n",
+        printf("pcanEventEnable: Error at pipe(pipeSpawn): 0x%02X\n",
                ret);
-        return 1;
+        pcanEventFree(event);
+        return 0;
     }
 
-    // Create pipe that main thread will use to stop worker thread
-    ret = pipe(pcanPipeExit);
+    // Create pipe that pcanEventDisable will use to stop worker thread
+    ret = pipe(event->pipeExit);
     if (ret == -1)
     {
-        printf("pcanEventEnable: Error at pipe(pcanPipeExit): 0x%02X\n",
+        printf("pcanEventEnable: Error at pipe(pipeExit): 0x%02X\n",
                ret);
-        return 1;
-    }
-
-    // Pack parameters into struct to be passed to worker thread
-    threadParameters_t *pcanEventThreadParams = 0;
-    pcanEventThreadParams = malloc(sizeof(*pcanEventThreadParams));
-    if (pcanEventThreadParams == 0)
-    {
-        printf("pcanEventEnable: Error at malloc.\n");
-        return 1;
+        pcanEventFree(event);
+        return 0;
     }
 
-    pcanEventThreadParams->canChannel = pcanChannel;
-    pcanEventThreadParams->callback = callback;
-    pcanEventThreadParams->pipeRead = pcanPipeRead;
-    pcanEventThreadParams->pipeSpawn = pcanPipeSpawn[W];
-    pcanEventThreadParams->pipeExit = pcanPipeExit[R];
-
     // Spawn the worker thread that will monitor the event
-    ret = pthread_create(&pcanEventThread, // thread
+    ret = pthread_create(&(event->thread), // thread
                          NULL, // attr
                          &pcanEventThreadProc, // start_routine
-                         pcanEventThreadParams); // arg
+                         event); // arg
     if (ret != 0)
     {
         printf("pcanEventEnable: Error at pthread_create: 0x%02X\n",
                ret);
-        return 1;
+        pcanEventFree(event);
+        return 0;
     }
 
-    // Wait for pcanPipeSpawn to be signaled and all that...
+    // Wait for pipeSpawn to be signaled and all that...
     fd_set readfds;
     FD_ZERO(&readfds);
-    FD_SET(pcanPipeSpawn[R], &readfds);
+    FD_SET(event->pipeSpawn[R], &readfds);
 
     struct timeval timeout = { 1, 0 }; // 1 second, 0 microseconds
     
@@ -236,25 +250,23 @@ int pcanEventEnable(TPCANHandle pcanChannel, void *callback)
     printf("pcanEventEnable: Waiting for thread to start...\n");
 #endif
 
-    ret = select(pcanPipeSpawn[R]+1, &readfds, NULL, NULL, &timeout);
+    ret = select(event->pipeSpawn[R]+1, &readfds, NULL, NULL, &timeout);
     if (ret == -1)
     {
         printf("pcanEventEnable: Unable to verify worker thread started; "
                "error at select(): %s\n",
                strerror(errno));
-        return 1;
+        pcanEventDisable(event);
+        return 0;
     }
 
-    // Cleanup
-    free(pcanEventThreadParams);
-
-    return 0;
+    return event;
 }
 
 
 
 
-int pcanEventDisable(TPCANHandle pcan_Channel)
+int pcanEventDisable(pcanEvent_t *event)
 {
     int ret = 0;
 
@@ -265,11 +277,13 @@ int pcanEventDisable(TPCANHandle pcan_Channel)
     
     size_t count = 0;
     int buf = 0;
-    count = write(pcanPipeExit[W], &buf, sizeof(buf));
+    count = write(event->pipeExit[W], &buf, sizeof(buf));
     if (count != sizeof(buf))
     {
-        printf("pcanEventDisable: Error at write(pcanPipeExit)\n");
-        return 1;
+        // The thread cannot be signaled, so cancel it at its next select(),
+        // and still join it and free the event below
+        printf("pcanEventDisable: Error at write(pipeExit)\n");
+        pthread_cancel(event->thread);
     }
 
     // Wait for the worker thread to exit
@@ -278,24 +292,23 @@ int pcanEventDisable(TPCANHandle pcan_Channel)
 #endif
     void *pcanEventThreadExitCode = 0;
 
-    ret = pthread_join(pcanEventThread, &pcanEventThreadExitCode);
+    ret = pthread_join(event->thread, &pcanEventThreadExitCode);
     if (ret != 0)
     {
-        printf("pcanEventDisable: Error at pthread_join\n");
+        // The thread may still be using the pipes, so they and the event are
+        // deliberately leaked instead
+        printf("pcanEventDisable: Error at pthread_join; leaking the event of channel 0x%02X\n",
+               event->channel);
+        return 1;
     }
-    else
-    {
+
 #ifdef PCAN_EVENT_DARWIN_DEBUG
-        printf("pcanEventDisable: Worker thread exited with code %i\n",
-               (int)pcanEventThreadExitCode);
+    printf("pcanEventDisable: Worker thread exited with code %i\n",
+           (int)pcanEventThreadExitCode);
 #endif
-    }
 
     // Close pipes
-    close(pcanPipeSpawn[W]);
-    close(pcanPipeSpawn[R]);
-    close(pcanPipeExit[W]);
-    close(pcanPipeExit[R]);
+    pcanEventFree(event);
 
 #ifdef PCAN_EVENT_DARWIN_DEBUG
     printf("pcanEventDisable: Closed pipes; done.\n");
@@ -307,21 +320,22 @@ int pcanEventDisable(TPCANHandle pcan_Channel)
 
 
 
-void pcanDumpThreadParameters(threadParameters_t *threadParameters)
+void pcanDumpEvent(pcanEvent_t *event)
 {
-    printf("threadParameters {\n"
-           "  canChannel  = 0x%02X\n"
+    printf("pcanEvent {\n"
+           "  channel     = 0x%02X\n"
            "  callback    = %p\n"
+           "  context     = %p\n"
            "  pipeRead    = %i\n"
            "  pipeSpawn   = %i\n"
            "  pipeExit    = %i\n"
            "}\n",
-           threadParameters->canChannel,
-           threadParameters->callback,
-           threadParameters->pipeRead,
-           threadParameters->pipeSpawn,
-           threadParameters->pipeExit);
+           event->channel,
+           event->callback,
+           event->context,
+           event->pipeRead,
+           event->pipeSpawn[W],
+           event->pipeExit[R]);
 
     return;
 }
-
@@ -6,6 +6,10 @@
    function when its state changes to signaled, which presumably calls 
    CAN_Read() to retrieve the newly received data.
 
+   Each channel enabled has its own pipes and worker thread, held in the
+   pcanEvent_t returned by pcanEventEnable, so that channels can be enabled
+   and disabled independently.
+
    Copyright (c) 2020 Control Solutions LLC. All rights reserved.
 */
 
@@ -23,15 +27,31 @@
 // ----------------------------------- // -----------------------------------
 // Definitions
 
-// Structure of parameters passed from main thread to worker thread
-typedef struct threadParameters_s
+// Called on the worker thread each time the receive event is signaled
+typedef void (*pcanEventCallback_t)(void *context);
+
+// Receive event of a channel and the worker thread waiting on it, created by
+// pcanEventEnable. Following convention, the read end of each pipe is first
+// ([0]) and the write end is second ([1]).
+typedef struct pcanEvent_s
 {
-    int canChannel;
-    void (*callback) (int);
+    TPCANHandle channel;
+    pcanEventCallback_t callback;
+    void *context;
+
+    // Pipe fd for CAN bus read event, signaled by the PCAN-Basic API when a
+    // message has been received and waited on by the worker thread
     int pipeRead;
-    int pipeSpawn;
-    int pipeExit;
-} threadParameters_t;
+
+    // Pipe signaled by the worker thread shortly after it starts, and waited
+    // on by pcanEventEnable
+    int pipeSpawn[2];
+
+    // Pipe signaled by pcanEventDisable, and waited on by the worker thread
+    int pipeExit[2];
+
+    pthread_t thread;
+} pcanEvent_t;
 
 
 
@@ -60,22 +80,23 @@ void *pcanEventThreadProc(void *lpParam);
 // ----------------------------------- // -----------------------------------
 // Public functions
 
-// Enable event signaling data is received on CAN bus
-// Accepts callback function that is called when event is signaled:
-// void (*callback) (int)
-// where the int argument is the CAN channel, which is passed to CAN_Initialize
-// and others as TPCANHandle Channel
-int pcanEventEnable(TPCANHandle pcan_Channel, void *callback);
+// Enable event signaling data is received on a channel. callback is called
+// with context on the worker thread each time the event is signaled.
+// Returns the new event, or 0 on failure
+pcanEvent_t *pcanEventEnable(TPCANHandle pcanChannel, pcanEventCallback_t callback,
+                             void *context);
 
-// Disable the previously enabled event
-int pcanEventDisable(TPCANHandle pcan_Channel);
+// Disable an event enabled by pcanEventEnable, wait for its worker thread to
+// exit, and free it. If the thread is not seen to exit, the event is left
+// allocated, since the thread may still use it and call back with its context.
+// Returns 0 on success, or 1 on failure
+int pcanEventDisable(pcanEvent_t *event);
 
-// Print the contents of a threadParameters_t structure to stdout in a
+// Print the contents of a pcanEvent_t structure to stdout in a
 // human-readable format for debugging purposes
-void pcanDumpThreadParameters(threadParameters_t *threadParameters);
+void pcanDumpEvent(pcanEvent_t *event);
 
 
 
 
 #endif /* _PCAN_EVENT_H_ */
-
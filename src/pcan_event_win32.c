@@ -11,10 +11,10 @@
 
 #include <stdio.h>       // provide printf
 #include <stdbool.h>     // provide boolean values
+#include <stdlib.h>      // provide calloc and free
 #include <windows.h>     // provide Win32 API constants and types
 #include <PCANBasic.h>   // provide PCAN-Basic constants and types
 
-#include "pcan.h"        // provide default callback function
 #include "pcan_event_win32.h"
 #include "pcan_helper.h" // provide pcanStatusLookup
 
@@ -22,11 +22,7 @@
 // ----------------------------------- // -----------------------------------
 // Definitions
 
-// Names used both in CreateEvent calls in main thread and OpenEvent calls
-// in worker thread
-const char pcanEventReadName[] = "pcanEventRead";
-const char pcanEventSpawnName[] = "pcanEventSpawn";
-const char pcanEventExitName[] = "pcanEventExit";
+
 
 
 // ----------------------------------- // -----------------------------------
@@ -38,110 +34,80 @@ const char pcanEventExitName[] = "pcanEventExit";
 // ----------------------------------- // -----------------------------------
 // Local variables
 
-// Handle for CAN bus read event, signaled my main thread (PCAN-Basic API) when
-// a message has been received and waited on by worker thread
-HANDLE pcanEventRead = INVALID_HANDLE_VALUE;
 
-// Handle for worker thread spawn event, signaled by worker shortly after thread
-// starts and waited on by main thread
-HANDLE pcanEventSpawn = INVALID_HANDLE_VALUE;
 
-// Handle for worker thread exit event, signaled by main thread during exit
-// routine, and waited on by worker thread
-HANDLE pcanEventExit = INVALID_HANDLE_VALUE;
 
-// Worker thread handle, populated by pcanEventEnable
-HANDLE pcanEventThread = INVALID_HANDLE_VALUE;
+// ----------------------------------- // -----------------------------------
+// Local functions
 
-// Worker thread ID, populated by pcanEventEnable
-DWORD pcanEventThreadID = 0;
 
+// Close the handles of an event that are open, and free it
+static void pcanEventFree(pcanEvent_t *event)
+{
+    HANDLE *handles[] = { &(event->read), &(event->spawn), &(event->exit), &(event->thread) };
+    size_t i;
 
+    for (i = 0; i < sizeof(handles) / sizeof(handles[0]); i++)
+    {
+        if ((*(handles[i]) != 0) && (*(handles[i]) != INVALID_HANDLE_VALUE))
+        {
+            if (CloseHandle(*(handles[i])) == 0)
+            {
+                printf("pcanEventFree: Error at CloseHandle: %i\n", GetLastError());
+            }
+        }
+    }
+
+    free(event);
+
+    return;
+}
 
 
-// ----------------------------------- // -----------------------------------
-// Local functions
 
 
 DWORD WINAPI pcanEventThreadProc(LPVOID lpParam)
 {
     int ret = 0;
 
-    // Copy parameters passed from the main thread
-    threadParameters_t threadParams = { 0 };
-    memcpy(&threadParams, (threadParameters_t*)lpParam, sizeof(threadParams));
+    // The callback and its context are copied before the thread signals that
+    // it is running, and only the handles are used afterwards
+    pcanEvent_t *event = (pcanEvent_t*)lpParam;
+    pcanEventCallback_t callback = event->callback;
+    void *context = event->context;
 
 #ifdef PCAN_EVENT_WIN32_DEBUG
-    pcanDumpThreadParameters(&threadParams);
+    pcanDumpEvent(event);
 #endif
 
-    // Open thread-local handles for events
-    HANDLE pcanEventRead = INVALID_HANDLE_VALUE;
-    HANDLE pcanEventSpawn = INVALID_HANDLE_VALUE;
-    HANDLE pcanEventExit = INVALID_HANDLE_VALUE;
+    // Wait for either event to be signaled
+    int threadExit = 0;
+    HANDLE events[2] = { 0 };
+    int eventIndex = 0;
     
-    pcanEventRead = OpenEvent(EVENT_PERMISSIONS, // dwDesiredAccess
-                              false, // bInheritHandle
-                              pcanEventReadName);
-
-    if (pcanEventRead == 0)
-    {
-        printf("pcanEventThreadProc: Error at OpenEvent(pcanEventRead): %i\n",
-               GetLastError());
-        return 1;
-    }
-
-    pcanEventSpawn = OpenEvent(EVENT_PERMISSIONS, // dwDesiredAccess
-                               false, // bInheritHandle
-                               pcanEventSpawnName);
-
-    if (pcanEventSpawn == 0)
-    {
-        printf("pcanEventThreadProc: Error at OpenEvent(pcanEventSpawn): %i\n",
-               GetLastError());
-        return 1;
-    }
-
-    pcanEventExit = OpenEvent(EVENT_PERMISSIONS, // dwDesiredAccess
-                              false, // bInheritHandle
-                              pcanEventExitName);
-
-    if (pcanEventExit == 0)
-    {
-        printf("pcanEventThreadProc: Error at OpenEvent(pcanEventExit): %i\n",
-               GetLastError());
-        return 1;
-    }
+    events[EVENT_INDEX_READ] = event->read;
+    events[EVENT_INDEX_EXIT] = event->exit;
 
     // Signal the spawn event, indicating that the worker thread is running
-    ret = SetEvent(pcanEventSpawn);
+    ret = SetEvent(event->spawn);
     if (ret == 0)
     {
         printf("pcanEventThreadProc: Error at SetEvent: 0x%02X\n", GetLastError());
         return 1;
     }
-    
-    // Wait for either event to be signaled
-    int threadExit = 0;
-    HANDLE events[2] = { 0 };
-    int eventIndex = 0;
-    
-    events[EVENT_INDEX_READ] = pcanEventRead;
-    events[EVENT_INDEX_EXIT] = pcanEventExit;
 
     while (threadExit == 0) {
 #ifdef PCAN_EVENT_WIN32_DEBUG
-        printf("pcanEventThreadProc: Waiting for pcanEventRead or "
-               "pcanEventExit...\n");
+        printf("pcanEventThreadProc: Waiting for read or exit event...\n");
 #endif
         ret = WaitForMultipleObjects(2, // nCount
                                      events, // lpHandles
                                      false, // bWaitAll
                                      INFINITE); // dwMilliseconds
 
-        if (ret & WAIT_ABANDONED_0)
+        if ((ret >= WAIT_ABANDONED_0) && (ret < WAIT_ABANDONED_0 + 2))
         {
-            eventIndex = (ret ^ WAIT_ABANDONED_0);
+            eventIndex = (ret - WAIT_ABANDONED_0);
             printf("pcanEventThreadProc: WAIT_ABANDONED_0: %i\n", eventIndex);
         }
         else if (ret == WAIT_TIMEOUT)
@@ -160,9 +126,9 @@ DWORD WINAPI pcanEventThreadProc(LPVOID lpParam)
             switch (ret)
             {
             case EVENT_INDEX_READ: // Execute callback
-                (threadParams.callback)(threadParams.canChannel);
+                callback(context);
                 break;
-            case EVENT_INDEX_EXIT: // Clean up and exit thread
+            case EVENT_INDEX_EXIT: // Exit thread
                 threadExit = 1;
             }
         }
@@ -171,9 +137,6 @@ DWORD WINAPI pcanEventThreadProc(LPVOID lpParam)
 #ifdef PCAN_EVENT_WIN32_DEBUG
     printf("pcanEventThreadProc: Exiting thread\n");
 #endif
-    CloseHandle(pcanEventRead);
-    CloseHandle(pcanEventSpawn);
-    CloseHandle(pcanEventExit);
 
     return 0;
 }
@@ -185,161 +148,151 @@ DWORD WINAPI pcanEventThreadProc(LPVOID lpParam)
 // Public functions
 
 
-int pcanEventEnable(TPCANHandle pcanChannel, void *callback)
+pcanEvent_t *pcanEventEnable(TPCANHandle pcanChannel, pcanEventCallback_t callback,
+                             void *context)
 {
     int ret = 0;
 
-    // Create security attributes structure for events and worker thread
-    SECURITY_DESCRIPTOR pcanSecurityDesc = { 0 };
-
-    ret = InitializeSecurityDescriptor(&pcanSecurityDesc,
-                                       SECURITY_DESCRIPTOR_REVISION);
-    if (ret == 0)
+    pcanEvent_t *event = 0;
+    event = calloc(1, sizeof(*event));
+    if (event == 0)
     {
-        printf("pcanEventEnable: Error at InitializeSecurityDescriptor: %i\n",
-               GetLastError());
-        return 1;
-    }
-    
-    ret = SetSecurityDescriptorDacl(&pcanSecurityDesc,
-                                    true,
-                                    0,
-                                    false);
-    if (ret == 0)
-    {
-        printf("pcanEventEnable: Error at SetSecurityDescriptorDacl: %i\n",
-               GetLastError());
-        return 1;
+        printf("pcanEventEnable: Error at calloc.\n");
+        return 0;
     }
 
-    SECURITY_ATTRIBUTES pcanSecurityAttr = { 0 };
-    pcanSecurityAttr.nLength = sizeof(pcanSecurityAttr);
-    pcanSecurityAttr.lpSecurityDescriptor = &pcanSecurityDesc;
-    pcanSecurityAttr.bInheritHandle = true;
+    event->channel = pcanChannel;
+    event->callback = callback;
+    event->context = context;
 
     // Create event object that the PCANBasic API will use to communicate
-    // CAN read events with worker thread
-    pcanEventRead = CreateEvent(&pcanSecurityAttr, // lpEventAttributes
-                                false, // bManualReset
-                                false, // bInitialState
-                                "pcanEventRead");
-
-    if (pcanEventRead == 0)
+    // CAN read events with worker thread. The events are used only within
+    // this process, so they need neither names nor security attributes.
+    event->read = CreateEvent(0, // lpEventAttributes
+                              false, // bManualReset
+                              false, // bInitialState
+                              0); // lpName
+
+    if (event->read == 0)
     {
-        printf("pcanEventEnable: Error at CreateEvent (pcanEventRead): 0x%02X\n",
+        printf("pcanEventEnable: Error at CreateEvent (read): 0x%02X\n",
                GetLastError());
-        return 1;
+        pcanEventFree(event);
+        return 0;
     }
 
     // Create event object that worker thread will use to indicate it has started
-    pcanEventSpawn = CreateEvent(&pcanSecurityAttr, // lpEventAttributes
-                                 false, // bManualReset
-                                 false, // bInitialState
-                                 "pcanEventSpawn");
+    event->spawn = CreateEvent(0, // lpEventAttributes
+                               false, // bManualReset
+                               false, // bInitialState
+                               0); // lpName
 
-    if (pcanEventSpawn == 0)
+    if (event->spawn == 0)
     {
-        printf("pcanEventEnable: Error at CreateEvent (pcanEventSpawn): 0x%02X\n",
+        printf("pcanEventEnable: Error at CreateEvent (spawn): 0x%02X\n",
                GetLastError());
-        return 1;
+        pcanEventFree(event);
+        return 0;
     }
 
-    // Create event object that main thread will use to stop worker thread
-    pcanEventExit = CreateEvent(&pcanSecurityAttr, // lpEventAttributes
-                                false, // bManualReset
-                                false, // bInitialState
-                                "pcanEventExit");
+    // Create event object that pcanEventDisable will use to stop worker thread
+    event->exit = CreateEvent(0, // lpEventAttributes
+                              false, // bManualReset
+                              false, // bInitialState
+                              0); // lpName
 
-    if (pcanEventExit == 0)
+    if (event->exit == 0)
     {
-        printf("pcanEventEnable: Error at CreateEvent (pcanEventExit): 0x%02X\n",
+        printf("pcanEventEnable: Error at CreateEvent (exit): 0x%02X\n",
                GetLastError());
-        return 1;
+        pcanEventFree(event);
+        return 0;
     }
 
-    // Pack parameters into struct to be passed to worker thread
-    threadParameters_t pcanEventThreadParams = {
-        pcanChannel,
-        callback
-    };
-
     // Spawn the worker thread that will monitor the event 
-    pcanEventThread = CreateThread(&pcanSecurityAttr, //lpThreadAttributes
-                                   0, // dwStackSize
-                                   &pcanEventThreadProc, // lpStartAddress
-                                   &pcanEventThreadParams, // lpParameter
-                                   0, // dwCreationFlags
-                                   &pcanEventThreadID); // lpThreadId
-
-    if (pcanEventThread == 0)
+    event->thread = CreateThread(0, //lpThreadAttributes
+                                 0, // dwStackSize
+                                 &pcanEventThreadProc, // lpStartAddress
+                                 event, // lpParameter
+                                 0, // dwCreationFlags
+                                 &(event->threadID)); // lpThreadId
+
+    if (event->thread == 0)
     {
         printf("pcanEventEnable: Error at CreateThread: 0x%02X\n", GetLastError());
-        return 1;
+        pcanEventFree(event);
+        return 0;
     }
 
-    // Wait for pcanEventSpawn to be set, indicating that the thread
+    // Wait for the spawn event to be set, indicating that the thread
     // was successfully started
 #ifdef PCAN_EVENT_WIN32_DEBUG
     printf("pcanEventEnable: Waiting for worker thread to start...\n");
 #endif
 
-    ret = WaitForSingleObject(pcanEventSpawn, 1000);
+    ret = WaitForSingleObject(event->spawn, 1000);
     switch (ret)
     {
     case WAIT_OBJECT_0:
         break;
     case WAIT_ABANDONED:
         printf("pcanEventEnable: Error at WaitForSingleObject: WAIT_ABANDONED\n");
-        return 1;
+        pcanEventDisable(event);
+        return 0;
     case WAIT_TIMEOUT:
         printf("pcanEventEnable: Error at WaitForSingleObject: WAIT_TIMEOUT\n");
-        return 1;
+        pcanEventDisable(event);
+        return 0;
     case WAIT_FAILED:
         printf("pcanEventEnable: Error at WaitForSingleObject: WAIT_FAILED: 0x%02X\n",
                GetLastError());
-        return 1;
+        pcanEventDisable(event);
+        return 0;
     default:
         printf("pcanEventEnable: Error at WaitForSingleObject: ret = 0x%02X\n", ret);
-        return 1;
+        pcanEventDisable(event);
+        return 0;
     }
 
     // Set the PCAN library to use the receive event
     TPCANStatus pcanResult = 0;
 
     pcanResult = CAN_SetValue(pcanChannel, PCAN_RECEIVE_EVENT,
-                              &pcanEventRead, sizeof(pcanEventRead));
+                              &(event->read), sizeof(event->read));
     
     if (pcanResult != PCAN_ERROR_OK)
     {
         printf("pcanEventEnable: Error at CAN_SetValue: 0x%02X (%s)\n",
                pcanResult, pcanStatusLookup(pcanResult));
-        return 1;
+        pcanEventDisable(event);
+        return 0;
     }
 
-    return 0;
+    return event;
 }
 
 
 
 
-int pcanEventDisable(TPCANHandle pcan_Channel)
+int pcanEventDisable(pcanEvent_t *event)
 {
     int ret = 0;
+    int result = 1;
 
     // Disable event in PCAN library
     HANDLE dummy_event = INVALID_HANDLE_VALUE;
     TPCANStatus pcanResult = PCAN_ERROR_UNKNOWN;
 
-    pcanResult = CAN_SetValue(pcan_Channel, PCAN_RECEIVE_EVENT,
+    pcanResult = CAN_SetValue(event->channel, PCAN_RECEIVE_EVENT,
                               &dummy_event, sizeof(dummy_event));
 
     // Stop the worker thread
-    ret = SetEvent(pcanEventExit);
+    ret = SetEvent(event->exit);
     if (ret == 0)
     {
         printf("pcanEventDisable: Error at SetEvent: 0x%02X\n",
                GetLastError());
-        return 1;
+        goto done;
     }
 
     // Wait for the worker thread to exit
@@ -349,24 +302,24 @@ int pcanEventDisable(TPCANHandle pcan_Channel)
     printf("pcanEventDisable: Waiting for worker thread to exit...\n");
 #endif
 
-    ret = WaitForSingleObject(pcanEventThread, INFINITE);
+    ret = WaitForSingleObject(event->thread, INFINITE);
 
     switch (ret)
     {
     case WAIT_OBJECT_0:
-        ret = GetExitCodeThread(pcanEventThread, &pcanEventThreadExitCode);
+        ret = GetExitCodeThread(event->thread, &pcanEventThreadExitCode);
 
         if (ret == 0)
         {
             printf("pcanEventDisable: Error at GetExitCodeThread: 0x%02X\n",
                    GetLastError());
-            return 1;
+            goto done;
         }
 
         if (pcanEventThreadExitCode == STILL_ACTIVE)
         {
             printf("pcanEventDisable: Thread still active.\n");
-            return 1;
+            goto done;
         }
         else
         {
@@ -378,66 +331,51 @@ int pcanEventDisable(TPCANHandle pcan_Channel)
         break;
     case WAIT_ABANDONED:
         printf("pcanEventDisable: Error at WaitForSingleObject: WAIT_ABANDONDED\n");
-        return 1;
+        goto done;
     case WAIT_TIMEOUT:
         printf("pcanEventDisable: Error at WaitForSingleObject: WAIT_TIMEOUT\n");
-        return 1;
+        goto done;
     case WAIT_FAILED:
         printf("pcanEventDisable: Error at WaitForSingleObject: WAIT_FAILED: 0x%02X\n",
                GetLastError());
-        return 1;
+        goto done;
     default:
         printf("pcanEventDisable: Error at WaitForSingleObject: ret = 0x%02X\n", ret);
-        return 1;
+        goto done;
     }
 
-    // Close all thread and event handles
-    ret = CloseHandle(pcanEventRead);
-    if (ret == 0)
-    {
-        printf("pcanEventDisable: Error at CloseHandle(pcanEventRead): %i\n",
-               GetLastError());
-        return 1;
-    }
-
-    ret = CloseHandle(pcanEventSpawn);
-    if (ret == 0)
-    {
-        printf("pcanEventDisable: Error at CloseHandle(pcanEventSpawn): %i\n",
-               GetLastError());
-        return 1;
-    }
+    result = 0;
 
-    ret = CloseHandle(pcanEventExit);
-    if (ret == 0)
+done:
+    // The handles can only be closed once the thread has exited, since it may
+    // still be waiting on them. If it was not seen to exit, they and the event
+    // are deliberately leaked instead.
+    if (result == 0)
     {
-        printf("pcanEventDisable: Error at CloseHandle(pcanEventExit): %i\n",
-               GetLastError());
-        return 1;
+        pcanEventFree(event);
     }
-
-    ret = CloseHandle(pcanEventThread);
-    if (ret == 0)
+    else
     {
-        printf("pcanEventDisable: Error at CloseHandle(pcanEventThread): %i\n",
-               GetLastError());
-        return 1;
+        printf("pcanEventDisable: Worker thread of channel 0x%02X not seen to exit; "
+               "leaking its event\n", event->channel);
     }
 
-    return 0;
+    return result;
 }
 
 
 
 
-void pcanDumpThreadParameters(threadParameters_t *threadParameters)
+void pcanDumpEvent(pcanEvent_t *event)
 {
-    printf("threadParameters {\n"
-           "  canChannel  = 0x%02X\n"
+    printf("pcanEvent {\n"
+           "  channel     = 0x%02X\n"
            "  callback    = 0x%p\n"
+           "  context     = 0x%p\n"
            "}\n",
-           threadParameters->canChannel,
-           threadParameters->callback);
+           event->channel,
+           event->callback,
+           event->context);
 
     return;
 }
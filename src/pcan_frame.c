@@ -0,0 +1,186 @@
+/* Packed CAN frame records
+
+   Fixed-size frame record shared by the native receive path, the batch read
+   interface exposed to JavaScript, and binary capture files, along with
+   functions that convert between records (classic or CAN FD) and PCAN-Basic
+   structures, and that work out how long a frame occupies the bus.
+
+   Copyright (c) 2020 Control Solutions LLC. All rights reserved.
+*/
+
+#include <string.h>      // provide memcpy and memset
+
+#include "pcan_frame.h"
+#include "pcan_helper.h" // provide pcanDLCDecode and pcanDLCEncode
+
+
+// ----------------------------------- // -----------------------------------
+// Definitions
+
+// Bits from the start of frame to the end of the CRC, which are subject to bit
+// stuffing, not counting data: SOF, 11-bit ID, RTR, IDE, r0, DLC, and CRC for
+// a standard frame; and SOF, 11-bit base ID, SRR, IDE, 18-bit ID extension,
+// RTR, r1, r0, DLC, and CRC for an extended one
+#define FRAME_STUFFED_BITS_STD (34)
+#define FRAME_STUFFED_BITS_EXT (54)
+
+// Bits after the CRC, which are never stuffed: CRC delimiter, ACK slot and
+// delimiter, end of frame, and intermission
+#define FRAME_FIXED_BITS (13)
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Global variables
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local variables
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local functions
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Public functions
+
+
+uint64_t pcanTimestampMicros(const TPCANTimestamp *timestamp)
+{
+    // Total Microseconds = micros + 1000 * millis + 0x100000000 * 1000 * millis_overflow
+    return (uint64_t)timestamp->micros +
+        1000ULL * (uint64_t)timestamp->millis +
+        0x100000000ULL * 1000ULL * (uint64_t)timestamp->millis_overflow;
+}
+
+
+
+
+void pcanFrameFromMsg(pcanFrame_t *frame, const TPCANMsg *msg,
+                      const TPCANTimestamp *timestamp)
+{
+    uint8_t len = (msg->LEN <= PCAN_FRAME_DATA_MAX) ? msg->LEN : PCAN_FRAME_DATA_MAX;
+
+    memset(frame, 0, sizeof(*frame));
+
+    frame->timestamp = pcanTimestampMicros(timestamp);
+    frame->id = msg->ID;
+    frame->msgtype = msg->MSGTYPE & ~PCAN_MESSAGE_ECHO;
+    frame->len = len;
+    memcpy(frame->data, msg->DATA, len);
+
+    if (msg->MSGTYPE & PCAN_MESSAGE_ECHO)
+    {
+        frame->flags |= PCAN_FRAME_FLAG_TX;
+    }
+
+    return;
+}
+
+
+
+
+void pcanFrameToMsg(const pcanFrame_t *frame, TPCANMsg *msg)
+{
+    uint8_t len = (frame->len <= PCAN_FRAME_DATA_MAX) ? frame->len : PCAN_FRAME_DATA_MAX;
+
+    memset(msg, 0, sizeof(*msg));
+
+    msg->ID = frame->id;
+    msg->MSGTYPE = frame->msgtype;
+    msg->LEN = len;
+    memcpy(msg->DATA, frame->data, len);
+
+    return;
+}
+
+
+
+
+void pcanFrameFDFromMsg(pcanFrameFD_t *frame, const TPCANMsgFD *msg,
+                        TPCANTimestampFD timestamp)
+{
+    uint8_t len = pcanDLCDecode(msg->DLC);
+
+    // A classic frame's DLC can exceed 8, but it never carries more data
+    if (!(msg->MSGTYPE & PCAN_MESSAGE_FD) && (len > PCAN_FRAME_DATA_MAX))
+    {
+        len = PCAN_FRAME_DATA_MAX;
+    }
+
+    memset(frame, 0, sizeof(*frame));
+
+    frame->timestamp = timestamp;
+    frame->id = msg->ID;
+    frame->msgtype = msg->MSGTYPE & ~PCAN_MESSAGE_ECHO;
+    frame->len = len;
+    memcpy(frame->data, msg->DATA, len);
+
+    if (msg->MSGTYPE & PCAN_MESSAGE_ECHO)
+    {
+        frame->flags |= PCAN_FRAME_FLAG_TX;
+    }
+
+    return;
+}
+
+
+
+
+void pcanFrameFDToMsg(const pcanFrameFD_t *frame, TPCANMsgFD *msg)
+{
+    uint8_t len = (frame->len <= PCAN_FRAME_FD_DATA_MAX) ? frame->len : PCAN_FRAME_FD_DATA_MAX;
+
+    memset(msg, 0, sizeof(*msg));
+
+    msg->ID = frame->id;
+    msg->MSGTYPE = frame->msgtype;
+    msg->DLC = pcanDLCEncode(len);
+    memcpy(msg->DATA, frame->data, len);
+
+    return;
+}
+
+
+
+
+void pcanFrameFromFD(pcanFrame_t *frame, const pcanFrameFD_t *fd)
+{
+    uint8_t len = (fd->len <= PCAN_FRAME_DATA_MAX) ? fd->len : PCAN_FRAME_DATA_MAX;
+
+    memcpy(frame, fd, PCAN_FRAME_SIZE - PCAN_FRAME_DATA_MAX);
+    frame->len = len;
+    memset(frame->data, 0, sizeof(frame->data));
+    memcpy(frame->data, fd->data, len);
+
+    return;
+}
+
+
+
+
+uint32_t pcanFrameBits(const pcanFrame_t *frame)
+{
+    uint32_t len = (frame->len <= PCAN_FRAME_DATA_MAX) ? frame->len : PCAN_FRAME_DATA_MAX;
+    uint32_t stuffed;
+
+    if (frame->msgtype & PCAN_MESSAGE_RTR)
+    {
+        len = 0;
+    }
+
+    stuffed = ((frame->msgtype & PCAN_MESSAGE_EXTENDED) ? FRAME_STUFFED_BITS_EXT :
+               FRAME_STUFFED_BITS_STD) + 8 * len;
+
+    // At worst, a stuff bit follows the first five bits and then every four,
+    // since each stuff bit starts the next run of five
+    return stuffed + (stuffed - 1) / 4 + FRAME_FIXED_BITS;
+}
@@ -0,0 +1,157 @@
+/* Packed CAN frame records
+
+   Fixed-size frame record shared by the native receive path, the batch read
+   interface exposed to JavaScript, and binary capture files, and a larger
+   record for CAN FD frames, along with functions that convert between
+   records and PCAN-Basic structures.
+
+   Copyright (c) 2020 Control Solutions LLC. All rights reserved.
+*/
+
+#ifndef _PCAN_FRAME_H_
+#define _PCAN_FRAME_H_
+
+#include <stdint.h>      // provide uintX_t
+
+#if defined _WIN32
+#include <windows.h>     // provide Win32 types, constants, and functions
+#include <PCANBasic.h>   // provide PCAN-Basic types, constants, and functions
+#elif defined __APPLE__
+#include <PCBUSB.h>      // provide PCAN-Basic types, constants, and functions
+#endif
+
+
+// ----------------------------------- // -----------------------------------
+// Definitions
+
+// Size of a packed frame record, in bytes
+#define PCAN_FRAME_SIZE (24)
+
+// Maximum data length of a frame record, in bytes
+#define PCAN_FRAME_DATA_MAX (8)
+
+// Size of a packed CAN FD frame record, in bytes
+#define PCAN_FRAME_FD_SIZE (80)
+
+// Maximum data length of a CAN FD frame record, in bytes
+#define PCAN_FRAME_FD_DATA_MAX (64)
+
+// Longest classic frame on the bus, in bits, with worst-case bit stuffing
+// (see pcanFrameBits)
+#define PCAN_FRAME_BITS_MAX (160)
+
+// Echo frames, returned by the driver once a frame written on the channel has
+// been sent on the bus, if enabled with PCAN_ALLOW_ECHO_FRAMES. Older
+// PCAN-Basic headers lack these.
+#ifndef PCAN_ALLOW_ECHO_FRAMES
+#define PCAN_ALLOW_ECHO_FRAMES (0x2CU)
+#endif
+#ifndef PCAN_MESSAGE_ECHO
+#define PCAN_MESSAGE_ECHO (0x20U)
+#endif
+
+// Bits of pcanFrame_t.flags
+#define PCAN_FRAME_FLAG_TX (0x01) // Frame was transmitted by this host
+#define PCAN_FRAME_FLAG_COALESCE (0x02) // Queued frame may be replaced by a newer one with its ID
+
+// Frame record. Multi-byte fields are stored in host (little-endian) order,
+// and the layout is identical in memory, in Buffers handed to JavaScript, and
+// in capture files:
+//   offset  0  uint64  timestamp, microseconds (hardware clock)
+//   offset  8  uint32  CAN identifier
+//   offset 12  uint8   TPCANMessageType flags
+//   offset 13  uint8   data length, in bytes
+//   offset 14  uint8   PCAN_FRAME_FLAG_* bits
+//   offset 15  uint8   transmit source of a queued frame, otherwise 0
+//   offset 16  uint8[8] data
+typedef struct pcanFrame_s
+{
+    uint64_t timestamp;
+    uint32_t id;
+    uint8_t msgtype;
+    uint8_t len;
+    uint8_t flags;
+    uint8_t source;
+    uint8_t data[PCAN_FRAME_DATA_MAX];
+} pcanFrame_t;
+
+// Compile-time check that the compiler did not pad the record
+typedef char pcanFrameSizeCheck_t[(sizeof(pcanFrame_t) == PCAN_FRAME_SIZE) ? 1 : -1];
+
+// Frame record of a channel initialized for CAN FD. The first 16 bytes are
+// laid out as in pcanFrame_t, with the length in bytes rather than the DLC
+// code, followed by up to 64 bytes of data:
+//   offset 16  uint8[64] data
+typedef struct pcanFrameFD_s
+{
+    uint64_t timestamp;
+    uint32_t id;
+    uint8_t msgtype;
+    uint8_t len;
+    uint8_t flags;
+    uint8_t source;
+    uint8_t data[PCAN_FRAME_FD_DATA_MAX];
+} pcanFrameFD_t;
+
+// Compile-time check that the compiler did not pad the record
+typedef char pcanFrameFDSizeCheck_t[(sizeof(pcanFrameFD_t) == PCAN_FRAME_FD_SIZE) ? 1 : -1];
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Global variables
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local variables
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local functions
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Public functions
+
+// Return the total number of microseconds represented by a TPCANTimestamp
+uint64_t pcanTimestampMicros(const TPCANTimestamp *timestamp);
+
+// Fill a frame record from a message and timestamp returned by CAN_Read. An
+// echo frame is recorded as a frame with PCAN_FRAME_FLAG_TX set, and without
+// PCAN_MESSAGE_ECHO in its message type.
+void pcanFrameFromMsg(pcanFrame_t *frame, const TPCANMsg *msg,
+                      const TPCANTimestamp *timestamp);
+
+// Fill a TPCANMsg, suitable for CAN_Write, from a frame record
+void pcanFrameToMsg(const pcanFrame_t *frame, TPCANMsg *msg);
+
+// Fill a CAN FD frame record from a message and timestamp returned by
+// CAN_ReadFD, decoding the DLC into a length. Echo frames are recorded as by
+// pcanFrameFromMsg.
+void pcanFrameFDFromMsg(pcanFrameFD_t *frame, const TPCANMsgFD *msg,
+                        TPCANTimestampFD timestamp);
+
+// Fill a TPCANMsgFD, suitable for CAN_WriteFD, from a CAN FD frame record.
+// A length between two DLC codes is rounded up to the next one, and the
+// data padded with zeros.
+void pcanFrameFDToMsg(const pcanFrameFD_t *frame, TPCANMsgFD *msg);
+
+// Fill a frame record from a CAN FD frame record, keeping only the first 8
+// bytes of data, for sinks that handle classic frame records
+void pcanFrameFromFD(pcanFrame_t *frame, const pcanFrameFD_t *fd);
+
+// Return the most bits a frame can occupy on the bus, including the
+// intermission that follows it, assuming worst-case bit stuffing
+uint32_t pcanFrameBits(const pcanFrame_t *frame);
+
+
+
+
+#endif // _PCAN_FRAME_H_
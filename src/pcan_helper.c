@@ -1,7 +1,7 @@
 /* PCAN-Basic helper functions
 
    Collection of functions that print TPCAN structures to stdout, look up 
-   string representations of constants, and decode DLC values.
+   string representations of constants, and encode and decode DLC values.
 
    Copyright (c) 2020 Control Solutions LLC. All rights reserved.
 */
@@ -19,7 +19,7 @@
 #include "common_helper.h" // provide lookupString
 #include "pcan_helper.h"
 #if defined _WIN32
-#include "pcan_event_win32.h"    // provide threadParameters_t
+#include "pcan_event_win32.h"    // provide pcanEvent_t
 #endif
 
 
@@ -168,6 +168,13 @@ const lookup_t pcanDevices [] = {
 const char pcanDeviceUnknown[] = "Device type unknown";
 
 
+// Data length, in bytes, of each DLC code. Codes above 8 only have these
+// meanings in CAN FD frames.
+const uint8_t pcanDLCLengths[16] = {
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64
+};
+
+
 
 
 // ----------------------------------- // -----------------------------------
@@ -315,40 +322,24 @@ const char *pcanParameterLookup(TPCANParameter parameter)
 
 uint8_t pcanDLCDecode(uint8_t dlc)
 {
-    int len;
+    return pcanDLCLengths[dlc & 0x0F];
+}
 
-    if (dlc <= 8)
-    {
-        len = dlc;
-    }
-    else
+
+
+
+uint8_t pcanDLCEncode(uint8_t len)
+{
+    uint8_t dlc = 0;
+
+    // Lengths that fall between two DLC codes round up, so that the data is
+    // padded rather than truncated
+    while ((dlc < 15) && (pcanDLCLengths[dlc] < len))
     {
-        switch (dlc) {
-        case 9:
-            len = 12;
-            break;
-        case 10:
-            len = 16;
-            break;
-        case 11:
-            len = 20;
-            break;
-        case 12:
-            len = 24;
-            break;
-        case 13:
-            len = 32;
-            break;
-        case 14:
-            len = 48;
-            break;
-        case 15:
-            len = 64;
-            break;
-        }
+        dlc++;
     }
 
-    return len;
+    return dlc;
 }
 
 
@@ -1,7 +1,7 @@
 /* PCAN-Basic helper functions
 
    Collection of functions that print TPCAN structures to stdout, look up 
-   string representations of constants, and decode DLC values.
+   string representations of constants, and encode and decode DLC values.
 
    Copyright (c) 2020 Control Solutions LLC. All rights reserved.
 */
@@ -15,11 +15,11 @@
 #if defined _WIN32
 #include <windows.h>     // provide Win32 types, constants, and functions
 #include <PCANBasic.h>   // provide PCAN-Basic types, constants, and functions
-#include "pcan_event_win32.h"   // provide threadParameters_t
+#include "pcan_event_win32.h"   // provide pcanEvent_t
 #elif defined __APPLE__
 #include <PCBUSB.h>      // provide PCAN-Basic types, constants, and functions
 #include "pcan_helper_darwin.h" // provide TPCANChannelInformation
-#include "pcan_event_darwin.h"  // provide threadParameters_t
+#include "pcan_event_darwin.h"  // provide pcanEvent_t
 #endif
 
 
@@ -85,6 +85,10 @@ const char *pcanParameterLookup(TPCANParameter parameter);
 // Return message size, in bytes, given a DLC code
 uint8_t pcanDLCDecode(uint8_t dlc);
 
+// Return the smallest DLC code whose message size, in bytes, holds len bytes
+// (15 if len is more than 64)
+uint8_t pcanDLCEncode(uint8_t len);
+
 // Print the contents of a TPCANChannelInfo structure to stdout
 // in a human-readable format for debugging purposes
 void pcanDumpChannelInfo(TPCANChannelInformation *info);
@@ -0,0 +1,638 @@
+/* ASAM MDF4 (.mf4) bus logging files
+
+   Writes captured frames as an MDF 4.10 bus logging file with a single
+   CAN_DataFrame channel group.
+
+   Copyright (c) 2020 Control Solutions LLC. All rights reserved.
+*/
+
+#include <stdio.h>       // provide printf
+#include <stdlib.h>      // provide malloc, realloc, and free
+#include <string.h>      // provide memcpy, memset, and strlen
+#include <zlib.h>        // provide compress2 and compressBound
+
+#include "pcan_mdf4.h"
+
+
+// ----------------------------------- // -----------------------------------
+// Definitions
+
+// Version of this writer, recorded in the file history
+#define MDF4_TOOL_VERSION "1.0"
+
+// Size of the identification block, and of a block header
+#define MDF4_ID_SIZE     (64)
+#define MDF4_HEADER_SIZE (24)
+
+// Size of the buffer the fixed blocks at the start of the file are built in
+#define MDF4_PROLOGUE_SIZE (4096)
+
+// Identification block fields
+#define MDF4_ID_FINISHED   "MDF     "
+#define MDF4_ID_UNFINISHED "UnFinMF "
+#define MDF4_ID_UNFIN_FLAGS_OFFSET (60)
+
+// id_unfin_flags bits: cycle counters and the data list must be updated
+#define MDF4_UNFIN_CG_CYCLES (0x0001)
+#define MDF4_UNFIN_DL        (0x0010)
+
+// Fixed file offsets
+#define MDF4_HD_OFFSET (MDF4_ID_SIZE)
+#define MDF4_HD_LINKS  (6)
+
+// Channel types, sync types, and data types
+#define MDF4_CN_TYPE_FIXED   (0)
+#define MDF4_CN_TYPE_MASTER  (2)
+#define MDF4_CN_SYNC_NONE    (0)
+#define MDF4_CN_SYNC_TIME    (1)
+#define MDF4_DT_UINT_LE      (0)
+#define MDF4_DT_FLOAT_LE     (4)
+#define MDF4_DT_BYTE_ARRAY   (10)
+
+// Channel and channel group flags
+#define MDF4_CN_FLAG_BUS_EVENT (0x0400)
+#define MDF4_CG_FLAG_BUS_EVENT (0x0002)
+#define MDF4_CG_FLAG_PLAIN_BUS_EVENT (0x0004)
+
+// Source types
+#define MDF4_SI_TYPE_BUS     (2)
+#define MDF4_SI_BUS_CAN      (2)
+
+// Link and data counts of the blocks written
+#define MDF4_CN_LINKS  (8)
+#define MDF4_CN_DATA   (72)
+#define MDF4_CG_LINKS  (6)
+#define MDF4_CG_DATA   (32)
+#define MDF4_DG_LINKS  (4)
+
+// Location of fields that are updated when the file is closed
+#define MDF4_HD_START_TIME (MDF4_HD_OFFSET + MDF4_HEADER_SIZE + 8 * MDF4_HD_LINKS)
+#define MDF4_DG_DATA_LINK  (MDF4_HEADER_SIZE + 8 * 2)
+#define MDF4_CG_CYCLES     (MDF4_HEADER_SIZE + 8 * MDF4_CG_LINKS + 8)
+
+// Location of a data block in the file
+typedef struct mdf4DataBlock_s
+{
+    uint64_t fileOffset;   // Offset of the DT or DZ block
+    uint64_t dataOffset;   // Offset of its first record in the record stream
+} mdf4DataBlock_t;
+
+// Per-file writer state
+typedef struct mdf4WriterState_s
+{
+    uint64_t dgOffset;     // File offset of the data group
+    uint64_t cgOffset;     // File offset of the channel group
+    uint64_t startTime;    // Header start time, microseconds since the epoch
+    int startTimeSet;      // startTime has been set from the first frame
+    uint64_t cycles;       // Records written
+
+    // Data block being collected
+    uint8_t *records;
+    uint32_t recordCount;
+
+    // Deflated data block
+    uint8_t *packed;
+    size_t packedCapacity;
+
+    // Data blocks written so far
+    mdf4DataBlock_t *blocks;
+    uint32_t blockCount;
+    uint32_t blockCapacity;
+
+    int error;
+} mdf4WriterState_t;
+
+// Fixed blocks at the start of the file, built in memory
+typedef struct mdf4Prologue_s
+{
+    uint8_t data[MDF4_PROLOGUE_SIZE];
+    uint32_t fill;
+} mdf4Prologue_t;
+
+// A channel of the CAN_DataFrame composition
+typedef struct mdf4Channel_s
+{
+    const char *name;
+    uint8_t dataType;
+    uint8_t bitOffset;
+    uint32_t byteOffset;
+    uint32_t bitCount;
+} mdf4Channel_t;
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Global variables
+
+
+// MDF4 format functions, defined below
+static int mdf4Begin(pcanCapture_t *capture);
+static int mdf4Write(pcanCapture_t *capture, const pcanFrame_t *frames, uint32_t count);
+static int mdf4End(pcanCapture_t *capture);
+
+const pcanCaptureFormat_t pcanCaptureFormatMdf4 = {
+    "mdf4",
+    mdf4Begin,
+    mdf4Write,
+    mdf4End,
+    0, // flush
+    sizeof(mdf4WriterState_t),
+    1, // seekable
+};
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local variables
+
+
+// Members of the CAN_DataFrame composition, in record order (see pcan_mdf4.h)
+static const mdf4Channel_t mdf4FrameChannels[] = {
+    { "CAN_DataFrame.BusChannel", MDF4_DT_UINT_LE,    0,  8,  8 },
+    { "CAN_DataFrame.ID",         MDF4_DT_UINT_LE,    0,  9, 29 },
+    { "CAN_DataFrame.IDE",        MDF4_DT_UINT_LE,    7, 12,  1 },
+    { "CAN_DataFrame.DLC",        MDF4_DT_UINT_LE,    0, 13,  4 },
+    { "CAN_DataFrame.Dir",        MDF4_DT_UINT_LE,    4, 13,  1 },
+    { "CAN_DataFrame.DataLength", MDF4_DT_UINT_LE,    0, 14,  8 },
+    { "CAN_DataFrame.DataBytes",  MDF4_DT_BYTE_ARRAY, 0, 15, 64 },
+};
+
+#define MDF4_FRAME_CHANNELS (sizeof(mdf4FrameChannels) / sizeof(mdf4FrameChannels[0]))
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local functions
+
+
+// Append a block to the prologue, with all links and data zeroed
+// Returns the file offset of the block
+static uint64_t mdf4AddBlock(mdf4Prologue_t *prologue, const char *id,
+                             uint32_t links, uint32_t dataSize)
+{
+    uint64_t offset = prologue->fill;
+    uint64_t length = MDF4_HEADER_SIZE + 8 * (uint64_t)links + dataSize;
+    uint64_t linkCount = links;
+    uint8_t *block = prologue->data + offset;
+
+    memset(block, 0, (size_t)((length + 7) & ~7ull));
+    memcpy(block, id, 4);
+    memcpy(block + 8, &length, sizeof(length));
+    memcpy(block + 16, &linkCount, sizeof(linkCount));
+
+    prologue->fill += (uint32_t)((length + 7) & ~7ull);
+
+    return offset;
+}
+
+
+
+
+// Set a link of a block in the prologue
+static void mdf4SetLink(mdf4Prologue_t *prologue, uint64_t block, uint32_t index,
+                        uint64_t target)
+{
+    memcpy(prologue->data + block + MDF4_HEADER_SIZE + 8 * index, &target, sizeof(target));
+
+    return;
+}
+
+
+
+
+// Return a pointer to the data section of a block in the prologue
+static uint8_t *mdf4BlockData(mdf4Prologue_t *prologue, uint64_t block, uint32_t links)
+{
+    return prologue->data + block + MDF4_HEADER_SIZE + 8 * links;
+}
+
+
+
+
+// Append a text (TX) or XML metadata (MD) block
+// Returns the file offset of the block
+static uint64_t mdf4AddText(mdf4Prologue_t *prologue, const char *id, const char *text)
+{
+    uint32_t length = (uint32_t)strlen(text) + 1;
+    uint64_t block = mdf4AddBlock(prologue, id, 0, length);
+
+    memcpy(mdf4BlockData(prologue, block, 0), text, length);
+
+    return block;
+}
+
+
+
+
+// Append a channel block
+// Returns the file offset of the block
+static uint64_t mdf4AddChannel(mdf4Prologue_t *prologue, uint64_t next, const char *name,
+                               uint8_t type, uint8_t syncType, uint8_t dataType,
+                               uint8_t bitOffset, uint32_t byteOffset, uint32_t bitCount,
+                               uint32_t flags)
+{
+    uint64_t nameBlock = mdf4AddText(prologue, "##TX", name);
+    uint64_t block = mdf4AddBlock(prologue, "##CN", MDF4_CN_LINKS, MDF4_CN_DATA);
+    uint8_t *data = mdf4BlockData(prologue, block, MDF4_CN_LINKS);
+
+    mdf4SetLink(prologue, block, 0, next);      // cn_cn_next
+    mdf4SetLink(prologue, block, 2, nameBlock); // cn_tx_name
+
+    data[0] = type;
+    data[1] = syncType;
+    data[2] = dataType;
+    data[3] = bitOffset;
+    memcpy(data + 4, &byteOffset, sizeof(byteOffset));
+    memcpy(data + 8, &bitCount, sizeof(bitCount));
+    memcpy(data + 12, &flags, sizeof(flags));
+
+    return block;
+}
+
+
+
+
+// Write the identification block, header, file history, and the data group
+// describing the CAN_DataFrame records. The data group has no data until the
+// file is closed.
+static int mdf4Begin(pcanCapture_t *capture)
+{
+    mdf4WriterState_t *state = (mdf4WriterState_t*)capture->formatState;
+    mdf4Prologue_t *prologue = 0;
+    uint64_t hd, fh, md, dg, cg, si, cnTime, cnFrame, next, block;
+    uint16_t separator = '.';
+    uint16_t unfinished = MDF4_UNFIN_CG_CYCLES | MDF4_UNFIN_DL;
+    uint16_t cgFlags = MDF4_CG_FLAG_BUS_EVENT | MDF4_CG_FLAG_PLAIN_BUS_EVENT;
+    uint16_t version = 410;
+    uint32_t recordSize = PCAN_MDF4_RECORD_SIZE;
+    uint64_t startNs = 0;
+    char comment[512];
+    int i;
+    int ret = 0;
+
+    state->records = malloc((size_t)PCAN_MDF4_BLOCK_RECORDS * PCAN_MDF4_RECORD_SIZE);
+    prologue = calloc(1, sizeof(*prologue));
+    if ((state->records == 0) || (prologue == 0))
+    {
+        free(prologue);
+        state->error = 1;
+        return 1;
+    }
+
+    // Identification block, marked unfinalized until the file is closed
+    memcpy(prologue->data, MDF4_ID_UNFINISHED, 8);
+    memcpy(prologue->data + 8, "4.10    ", 8);
+    memcpy(prologue->data + 16, "CSPCAN  ", 8);
+    memcpy(prologue->data + 28, &version, sizeof(version));
+    memcpy(prologue->data + MDF4_ID_UNFIN_FLAGS_OFFSET, &unfinished, sizeof(unfinished));
+    prologue->fill = MDF4_ID_SIZE;
+
+    // Header, with the start time updated when the first frame arrives
+    state->startTime = capture->fileStartWallUs;
+    startNs = state->startTime * 1000;
+
+    hd = mdf4AddBlock(prologue, "##HD", MDF4_HD_LINKS, 32);
+    memcpy(mdf4BlockData(prologue, hd, MDF4_HD_LINKS), &startNs, sizeof(startNs));
+
+    // File history
+    snprintf(comment, sizeof(comment),
+             "<FHcomment><TX>CAN bus log of PCAN channel 0x%02X at %u bit/s</TX>"
+             "<tool_id>cs-pcan-usb</tool_id><tool_vendor>Control Solutions LLC</tool_vendor>"
+             "<tool_version>" MDF4_TOOL_VERSION "</tool_version></FHcomment>",
+             capture->options.channel, capture->options.bitrate);
+    md = mdf4AddText(prologue, "##MD", comment);
+
+    fh = mdf4AddBlock(prologue, "##FH", 2, 16);
+    mdf4SetLink(prologue, fh, 1, md);
+    memcpy(mdf4BlockData(prologue, fh, 2), &startNs, sizeof(startNs));
+
+    // Bus source
+    block = mdf4AddText(prologue, "##TX", "CAN1");
+    si = mdf4AddBlock(prologue, "##SI", 3, 8);
+    mdf4SetLink(prologue, si, 0, block);
+    mdf4BlockData(prologue, si, 3)[0] = MDF4_SI_TYPE_BUS;
+    mdf4BlockData(prologue, si, 3)[1] = MDF4_SI_BUS_CAN;
+
+    // Members of the CAN_DataFrame composition, added last to first so that
+    // each can link to the next
+    next = 0;
+    for (i = (int)MDF4_FRAME_CHANNELS - 1; i >= 0; i--)
+    {
+        next = mdf4AddChannel(prologue, next, mdf4FrameChannels[i].name,
+                              MDF4_CN_TYPE_FIXED, MDF4_CN_SYNC_NONE,
+                              mdf4FrameChannels[i].dataType, mdf4FrameChannels[i].bitOffset,
+                              mdf4FrameChannels[i].byteOffset, mdf4FrameChannels[i].bitCount,
+                              0);
+    }
+
+    cnFrame = mdf4AddChannel(prologue, 0, "CAN_DataFrame",
+                             MDF4_CN_TYPE_FIXED, MDF4_CN_SYNC_NONE, MDF4_DT_BYTE_ARRAY,
+                             0, 8, 15 * 8, MDF4_CN_FLAG_BUS_EVENT);
+    mdf4SetLink(prologue, cnFrame, 1, next); // cn_composition
+
+    cnTime = mdf4AddChannel(prologue, cnFrame, "Timestamp",
+                            MDF4_CN_TYPE_MASTER, MDF4_CN_SYNC_TIME, MDF4_DT_FLOAT_LE,
+                            0, 0, 64, 0);
+    block = mdf4AddText(prologue, "##TX", "s");
+    mdf4SetLink(prologue, cnTime, 6, block); // cn_md_unit
+
+    // Channel group
+    block = mdf4AddText(prologue, "##TX", "CAN_DataFrame");
+    cg = mdf4AddBlock(prologue, "##CG", MDF4_CG_LINKS, MDF4_CG_DATA);
+    mdf4SetLink(prologue, cg, 1, cnTime); // cg_cn_first
+    mdf4SetLink(prologue, cg, 2, block);  // cg_tx_acq_name
+    mdf4SetLink(prologue, cg, 3, si);     // cg_si_acq_source
+    memcpy(mdf4BlockData(prologue, cg, MDF4_CG_LINKS) + 16, &cgFlags, sizeof(cgFlags));
+    memcpy(mdf4BlockData(prologue, cg, MDF4_CG_LINKS) + 18, &separator, sizeof(separator));
+    memcpy(mdf4BlockData(prologue, cg, MDF4_CG_LINKS) + 24, &recordSize, sizeof(recordSize));
+
+    // Data group, with sorted records and no record IDs
+    dg = mdf4AddBlock(prologue, "##DG", MDF4_DG_LINKS, 8);
+    mdf4SetLink(prologue, dg, 1, cg); // dg_cg_first
+
+    mdf4SetLink(prologue, hd, 0, dg); // hd_dg_first
+    mdf4SetLink(prologue, hd, 1, fh); // hd_fh_first
+
+    state->dgOffset = dg;
+    state->cgOffset = cg;
+
+    ret = pcanCaptureOutput(capture, prologue->data, prologue->fill);
+
+    free(prologue);
+
+    return ret;
+}
+
+
+
+
+// Write the collected records as a DT block, or as a DZ block if compression
+// is enabled
+static int mdf4FlushBlock(pcanCapture_t *capture)
+{
+    mdf4WriterState_t *state = (mdf4WriterState_t*)capture->formatState;
+    mdf4DataBlock_t *blocks = 0;
+    uint8_t header[MDF4_HEADER_SIZE + 24];
+    uint64_t size = (uint64_t)state->recordCount * PCAN_MDF4_RECORD_SIZE;
+    uint64_t length = 0;
+    uint64_t zero = 0;
+    uLongf packedSize = 0;
+    int level = capture->options.compress;
+    int ret = 0;
+
+    if (state->recordCount == 0)
+    {
+        return 0;
+    }
+
+    if (state->blockCount == state->blockCapacity)
+    {
+        state->blockCapacity = (state->blockCapacity == 0) ? 64 : 2 * state->blockCapacity;
+        blocks = realloc(state->blocks, state->blockCapacity * sizeof(*blocks));
+        if (blocks == 0)
+        {
+            state->error = 1;
+            return 1;
+        }
+        state->blocks = blocks;
+    }
+
+    state->blocks[state->blockCount].fileOffset = pcanCaptureOutputOffset(capture);
+    state->blocks[state->blockCount].dataOffset = state->cycles * PCAN_MDF4_RECORD_SIZE -
+                                                  size;
+    state->blockCount++;
+
+    memset(header, 0, sizeof(header));
+
+    if (level > 0)
+    {
+        // Deflate into a DZ block, keeping the buffer for the next block
+        if (state->packed == 0)
+        {
+            state->packedCapacity = compressBound((uLong)((size_t)PCAN_MDF4_BLOCK_RECORDS *
+                                                          PCAN_MDF4_RECORD_SIZE));
+            state->packed = malloc(state->packedCapacity);
+        }
+
+        packedSize = (uLongf)state->packedCapacity;
+        if ((state->packed == 0) ||
+            (compress2(state->packed, &packedSize, state->records, (uLong)size,
+                       (level > 9) ? 9 : level) != Z_OK))
+        {
+            // An uncompressed block is just as valid in the data list
+            printf("pcanCaptureThreadProc: Error compressing MDF4 data block\n");
+            level = 0;
+        }
+    }
+
+    if (level > 0)
+    {
+        length = MDF4_HEADER_SIZE + 24 + packedSize;
+        memcpy(header, "##DZ", 4);
+        memcpy(header + 8, &length, sizeof(length));
+        memcpy(header + MDF4_HEADER_SIZE, "DT", 2); // dz_org_block_type, deflate
+        memcpy(header + MDF4_HEADER_SIZE + 8, &size, sizeof(size));
+        length = packedSize;
+        memcpy(header + MDF4_HEADER_SIZE + 16, &length, sizeof(length));
+
+        ret |= pcanCaptureOutput(capture, header, sizeof(header));
+        ret |= pcanCaptureOutput(capture, state->packed, packedSize);
+
+        // Keep the next block 8-byte aligned
+        if (packedSize % 8)
+        {
+            ret |= pcanCaptureOutput(capture, &zero, 8 - (packedSize % 8));
+        }
+    }
+    else
+    {
+        length = MDF4_HEADER_SIZE + size;
+        memcpy(header, "##DT", 4);
+        memcpy(header + 8, &length, sizeof(length));
+
+        ret |= pcanCaptureOutput(capture, header, MDF4_HEADER_SIZE);
+        ret |= pcanCaptureOutput(capture, state->records, (size_t)size);
+    }
+
+    state->recordCount = 0;
+
+    return ret;
+}
+
+
+
+
+static int mdf4Write(pcanCapture_t *capture, const pcanFrame_t *frames, uint32_t count)
+{
+    mdf4WriterState_t *state = (mdf4WriterState_t*)capture->formatState;
+    uint64_t startNs = 0;
+    uint8_t *record = 0;
+    uint8_t len = 0;
+    uint32_t id = 0;
+    double seconds = 0;
+    uint32_t i;
+    int ret = 0;
+
+    if (state->records == 0)
+    {
+        return 1;
+    }
+
+    // Times are relative to the header start time, which is moved to the
+    // first frame
+    if (!state->startTimeSet)
+    {
+        state->startTime = pcanCaptureWallTime(capture, capture->fileFirstTimestamp);
+        state->startTimeSet = 1;
+        startNs = state->startTime * 1000;
+        ret |= pcanCapturePatch(capture, MDF4_HD_START_TIME, &startNs, sizeof(startNs));
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        // Only data frames belong in CAN_DataFrame
+        if (frames[i].msgtype & (PCAN_MESSAGE_STATUS | PCAN_MESSAGE_ERRFRAME |
+                                 PCAN_MESSAGE_RTR))
+        {
+            continue;
+        }
+
+        record = state->records + (size_t)state->recordCount * PCAN_MDF4_RECORD_SIZE;
+        len = (frames[i].len > PCAN_FRAME_DATA_MAX) ? PCAN_FRAME_DATA_MAX : frames[i].len;
+        seconds = (double)(int64_t)(pcanCaptureWallTime(capture, frames[i].timestamp) -
+                                    state->startTime) / 1000000.0;
+        id = frames[i].id & 0x1FFFFFFF;
+        if (frames[i].msgtype & PCAN_MESSAGE_EXTENDED)
+        {
+            id |= 0x80000000;
+        }
+
+        memcpy(record, &seconds, sizeof(seconds));
+        record[8] = 1;
+        memcpy(record + 9, &id, sizeof(id));
+        record[13] = (uint8_t)(len | ((frames[i].flags & PCAN_FRAME_FLAG_TX) ? 0x10 : 0));
+        record[14] = len;
+        memcpy(record + 15, frames[i].data, PCAN_FRAME_DATA_MAX);
+        record[23] = 0;
+
+        state->cycles++;
+
+        if (++state->recordCount == PCAN_MDF4_BLOCK_RECORDS)
+        {
+            ret |= mdf4FlushBlock(capture);
+        }
+    }
+
+    return ret;
+}
+
+
+
+
+// Write the last data block and the list of data blocks, and finalize the
+// file
+static int mdf4End(pcanCapture_t *capture)
+{
+    mdf4WriterState_t *state = (mdf4WriterState_t*)capture->formatState;
+    uint8_t header[MDF4_HEADER_SIZE + 16];
+    uint64_t dataLink = 0;
+    uint64_t length = 0;
+    uint64_t linkCount = 0;
+    uint32_t blockCount = 0;
+    uint16_t finished = 0;
+    uint32_t i;
+    int compressed = (capture->options.compress > 0);
+    int ret = 0;
+
+    if (state->records != 0)
+    {
+        ret |= mdf4FlushBlock(capture);
+    }
+
+    // A single uncompressed block is linked directly. Otherwise the data
+    // group links to a data list, which for DZ blocks must be wrapped in a
+    // header list.
+    if ((state->blockCount == 1) && !compressed)
+    {
+        dataLink = state->blocks[0].fileOffset;
+    }
+    else if (state->blockCount > 0)
+    {
+        blockCount = state->blockCount;
+
+        if (compressed)
+        {
+            dataLink = pcanCaptureOutputOffset(capture);
+
+            memset(header, 0, sizeof(header));
+            memcpy(header, "##HL", 4);
+            length = MDF4_HEADER_SIZE + 8 + 8;
+            linkCount = 1;
+            memcpy(header + 8, &length, sizeof(length));
+            memcpy(header + 16, &linkCount, sizeof(linkCount));
+            length = dataLink + sizeof(header);
+            memcpy(header + MDF4_HEADER_SIZE, &length, sizeof(length)); // hl_dl_first
+            // hl_flags 0, hl_zip_type 0 (deflate)
+
+            ret |= pcanCaptureOutput(capture, header, sizeof(header));
+        }
+        else
+        {
+            dataLink = pcanCaptureOutputOffset(capture);
+        }
+
+        // dl_dl_next and dl_data links, then dl_flags (0, so offsets follow),
+        // dl_count, and dl_offset values
+        memset(header, 0, sizeof(header));
+        memcpy(header, "##DL", 4);
+        length = MDF4_HEADER_SIZE + 8 * (1 + (uint64_t)blockCount) + 8 + 8 * (uint64_t)blockCount;
+        linkCount = 1 + (uint64_t)blockCount;
+        memcpy(header + 8, &length, sizeof(length));
+        memcpy(header + 16, &linkCount, sizeof(linkCount));
+        ret |= pcanCaptureOutput(capture, header, MDF4_HEADER_SIZE + 8);
+
+        for (i = 0; i < blockCount; i++)
+        {
+            ret |= pcanCaptureOutput(capture, &(state->blocks[i].fileOffset), 8);
+        }
+
+        memset(header, 0, 8);
+        memcpy(header + 4, &blockCount, sizeof(blockCount));
+        ret |= pcanCaptureOutput(capture, header, 8);
+
+        for (i = 0; i < blockCount; i++)
+        {
+            ret |= pcanCaptureOutput(capture, &(state->blocks[i].dataOffset), 8);
+        }
+    }
+
+    // Link the data, record the number of records, and mark the file finished
+    ret |= pcanCapturePatch(capture, state->dgOffset + MDF4_DG_DATA_LINK,
+                            &dataLink, sizeof(dataLink));
+    ret |= pcanCapturePatch(capture, state->cgOffset + MDF4_CG_CYCLES,
+                            &(state->cycles), sizeof(state->cycles));
+
+    if (!state->error)
+    {
+        ret |= pcanCapturePatch(capture, 0, MDF4_ID_FINISHED, 8);
+        ret |= pcanCapturePatch(capture, MDF4_ID_UNFIN_FLAGS_OFFSET, &finished, sizeof(finished));
+    }
+
+    free(state->records);
+    free(state->packed);
+    free(state->blocks);
+    state->records = 0;
+    state->packed = 0;
+    state->blocks = 0;
+
+    return ret | state->error;
+}
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Public functions
@@ -0,0 +1,75 @@
+/* ASAM MDF4 (.mf4) bus logging files
+
+   Writes captured frames as an MDF 4.10 file laid out as described by the
+   ASAM MDF bus logging standard for CAN: one sorted data group holding a
+   single CAN_DataFrame channel group, with a master Timestamp channel and a
+   CAN_DataFrame composition of BusChannel, ID, IDE, DLC, Dir, DataLength,
+   and DataBytes.
+
+   Records are collected into data blocks of PCAN_MDF4_BLOCK_RECORDS, which
+   are written as DT blocks or, when compression is enabled, deflated into DZ
+   blocks on the capture writer thread. The file is marked unfinalized until
+   it is closed, when the list of data blocks and the record count are
+   written and the identification block is updated.
+
+   Record layout (PCAN_MDF4_RECORD_SIZE bytes, little-endian):
+     offset  0  float64  Timestamp, seconds since the header start time
+     offset  8  uint8    BusChannel (1)
+     offset  9  uint32   ID (bits 0-28) and IDE (bit 31)
+     offset 13  uint8    DLC (bits 0-3) and Dir (bit 4, 1 = transmitted)
+     offset 14  uint8    DataLength
+     offset 15  uint8[8] DataBytes
+     offset 23  uint8    padding
+
+   Copyright (c) 2020 Control Solutions LLC. All rights reserved.
+*/
+
+#ifndef _PCAN_MDF4_H_
+#define _PCAN_MDF4_H_
+
+#include "pcan_capture.h" // provide pcanCaptureFormat_t
+
+
+// ----------------------------------- // -----------------------------------
+// Definitions
+
+// Size of a record in the CAN_DataFrame channel group
+#define PCAN_MDF4_RECORD_SIZE (24)
+
+// Number of records in each data block (1.5 MiB uncompressed)
+#define PCAN_MDF4_BLOCK_RECORDS (65536)
+
+// Compression level used when compression is requested without one
+#define PCAN_MDF4_COMPRESS_DEFAULT (6)
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Global variables
+
+// MDF4 capture format
+extern const pcanCaptureFormat_t pcanCaptureFormatMdf4;
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local variables
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local functions
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Public functions
+
+
+
+
+#endif // _PCAN_MDF4_H_
@@ -0,0 +1,292 @@
+/* pcapng capture files
+
+   Writes captured frames as a pcapng file with a single SocketCAN interface,
+   for Wireshark and other packet tools.
+
+   Copyright (c) 2020 Control Solutions LLC. All rights reserved.
+*/
+
+#include <stdio.h>       // provide snprintf
+#include <string.h>      // provide memcpy, memset, and strlen
+
+#include "pcan_pcapng.h"
+
+
+// ----------------------------------- // -----------------------------------
+// Definitions
+
+// Block types
+#define PCAPNG_BLOCK_SHB (0x0A0D0D0A) // Section Header Block
+#define PCAPNG_BLOCK_IDB (0x00000001) // Interface Description Block
+#define PCAPNG_BLOCK_EPB (0x00000006) // Enhanced Packet Block
+
+#define PCAPNG_BYTE_ORDER_MAGIC (0x1A2B3C4D)
+
+// Option codes
+#define PCAPNG_OPT_ENDOFOPT  (0)
+#define PCAPNG_OPT_SHB_USERAPPL (4)
+#define PCAPNG_OPT_IF_NAME   (2)
+#define PCAPNG_OPT_IF_SPEED  (8)
+#define PCAPNG_OPT_IF_TSRESOL (9)
+#define PCAPNG_OPT_EPB_FLAGS (2)
+
+// epb_flags direction values
+#define PCAPNG_EPB_INBOUND   (0x00000001)
+#define PCAPNG_EPB_OUTBOUND  (0x00000002)
+
+// SocketCAN identifier flags and FD flags
+#define SOCKETCAN_EFF_FLAG   (0x80000000)
+#define SOCKETCAN_RTR_FLAG   (0x40000000)
+#define SOCKETCAN_FD_BRS     (0x01)
+#define SOCKETCAN_FD_ESI     (0x02)
+#define SOCKETCAN_FD_FDF     (0x04)
+
+// Size of a SocketCAN frame header, before the data, and of whole classic
+// and FD frames. Packets always hold whole frames, since older dissectors tell
+// the two apart by length.
+#define SOCKETCAN_HEADER_SIZE (8)
+#define SOCKETCAN_CAN_MTU     (16)
+#define SOCKETCAN_CANFD_MTU   (72)
+
+// Size of an Enhanced Packet Block holding an FD frame: block header (28),
+// SocketCAN frame, epb_flags and end of options (12), and trailing length
+#define PCAPNG_EPB_MAX (28 + SOCKETCAN_CANFD_MTU + 12 + 4)
+
+// Number of blocks formatted before handing them to the capture
+#define PCAPNG_WRITE_BLOCKS (256)
+
+// Per-file writer state
+typedef struct pcapngWriterState_s
+{
+    uint8_t blocks[PCAPNG_WRITE_BLOCKS * PCAPNG_EPB_MAX];
+} pcapngWriterState_t;
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Global variables
+
+
+// pcapng format functions, defined below
+static int pcapngBegin(pcanCapture_t *capture);
+static int pcapngWrite(pcanCapture_t *capture, const pcanFrame_t *frames, uint32_t count);
+
+const pcanCaptureFormat_t pcanCaptureFormatPcapng = {
+    "pcapng",
+    pcapngBegin,
+    pcapngWrite,
+    0, // end
+    0, // flush
+    sizeof(pcapngWriterState_t),
+    0, // seekable
+};
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local variables
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local functions
+
+
+static uint8_t *pcapngPut16(uint8_t *p, uint16_t value)
+{
+    memcpy(p, &value, sizeof(value));
+    return p + sizeof(value);
+}
+
+
+
+
+static uint8_t *pcapngPut32(uint8_t *p, uint32_t value)
+{
+    memcpy(p, &value, sizeof(value));
+    return p + sizeof(value);
+}
+
+
+
+
+// Write an option, padded to a multiple of four bytes
+static uint8_t *pcapngPutOption(uint8_t *p, uint16_t code, const void *value, uint16_t length)
+{
+    uint16_t padded = (uint16_t)((length + 3) & ~3);
+
+    p = pcapngPut16(p, code);
+    p = pcapngPut16(p, length);
+    memcpy(p, value, length);
+    memset(p + length, 0, padded - length);
+
+    return p + padded;
+}
+
+
+
+
+// Fill in the total length at both ends of a block that starts at block and
+// ends (before its trailing length) at p
+// Returns a pointer past the block
+static uint8_t *pcapngEndBlock(uint8_t *block, uint8_t *p)
+{
+    uint32_t length = (uint32_t)(p - block) + 4;
+
+    pcapngPut32(block + 4, length);
+
+    return pcapngPut32(p, length);
+}
+
+
+
+
+// Write the section header and the interface description
+static int pcapngBegin(pcanCapture_t *capture)
+{
+    pcapngWriterState_t *state = (pcapngWriterState_t*)capture->formatState;
+    uint8_t *block = state->blocks;
+    uint8_t *p = 0;
+    const char *application = "cs-pcan-usb";
+    char name[32];
+    uint8_t tsresol = 6; // 10^-6 seconds
+    uint64_t speed = capture->options.bitrate;
+
+    // Section Header Block, of unknown length
+    p = pcapngPut32(block, PCAPNG_BLOCK_SHB);
+    p = pcapngPut32(p, 0);
+    p = pcapngPut32(p, PCAPNG_BYTE_ORDER_MAGIC);
+    p = pcapngPut16(p, 1);
+    p = pcapngPut16(p, 0);
+    p = pcapngPut32(p, 0xFFFFFFFF);
+    p = pcapngPut32(p, 0xFFFFFFFF);
+    p = pcapngPutOption(p, PCAPNG_OPT_SHB_USERAPPL, application, (uint16_t)strlen(application));
+    p = pcapngPut32(p, PCAPNG_OPT_ENDOFOPT);
+    p = pcapngEndBlock(block, p);
+
+    // Interface Description Block
+    block = p;
+    snprintf(name, sizeof(name), "pcan0x%02X", capture->options.channel);
+
+    p = pcapngPut32(block, PCAPNG_BLOCK_IDB);
+    p = pcapngPut32(p, 0);
+    p = pcapngPut16(p, PCAN_PCAPNG_LINKTYPE_CAN_SOCKETCAN);
+    p = pcapngPut16(p, 0);
+    p = pcapngPut32(p, 0); // no snapshot length limit
+    p = pcapngPutOption(p, PCAPNG_OPT_IF_NAME, name, (uint16_t)strlen(name));
+    p = pcapngPutOption(p, PCAPNG_OPT_IF_TSRESOL, &tsresol, sizeof(tsresol));
+    if (speed != 0)
+    {
+        p = pcapngPutOption(p, PCAPNG_OPT_IF_SPEED, &speed, sizeof(speed));
+    }
+    p = pcapngPut32(p, PCAPNG_OPT_ENDOFOPT);
+    p = pcapngEndBlock(block, p);
+
+    return pcanCaptureOutput(capture, state->blocks, (size_t)(p - state->blocks));
+}
+
+
+
+
+// Format one Enhanced Packet Block
+// Returns a pointer past the block
+static uint8_t *pcapngFormatPacket(pcanCapture_t *capture, uint8_t *block,
+                                   const pcanFrame_t *frame)
+{
+    uint8_t *p = 0;
+    uint64_t timestamp = pcanCaptureWallTime(capture, frame->timestamp);
+    uint8_t len = (frame->len > PCAN_FRAME_DATA_MAX) ? PCAN_FRAME_DATA_MAX : frame->len;
+    uint32_t id = frame->id;
+    uint32_t captured = (frame->msgtype & PCAN_MESSAGE_FD) ?
+                        SOCKETCAN_CANFD_MTU : SOCKETCAN_CAN_MTU;
+    uint32_t direction = (frame->flags & PCAN_FRAME_FLAG_TX) ?
+                         PCAPNG_EPB_OUTBOUND : PCAPNG_EPB_INBOUND;
+    uint8_t fdFlags = 0;
+
+    if (frame->msgtype & PCAN_MESSAGE_EXTENDED)
+    {
+        id |= SOCKETCAN_EFF_FLAG;
+    }
+    if (frame->msgtype & PCAN_MESSAGE_RTR)
+    {
+        id |= SOCKETCAN_RTR_FLAG;
+    }
+    if (frame->msgtype & PCAN_MESSAGE_FD)
+    {
+        fdFlags = SOCKETCAN_FD_FDF;
+        fdFlags |= (frame->msgtype & PCAN_MESSAGE_BRS) ? SOCKETCAN_FD_BRS : 0;
+        fdFlags |= (frame->msgtype & PCAN_MESSAGE_ESI) ? SOCKETCAN_FD_ESI : 0;
+    }
+
+    p = pcapngPut32(block, PCAPNG_BLOCK_EPB);
+    p = pcapngPut32(p, 0);
+    p = pcapngPut32(p, 0); // interface
+    p = pcapngPut32(p, (uint32_t)(timestamp >> 32));
+    p = pcapngPut32(p, (uint32_t)timestamp);
+    p = pcapngPut32(p, captured);
+    p = pcapngPut32(p, captured);
+
+    // SocketCAN frame, with the identifier in network byte order
+    *p++ = (uint8_t)(id >> 24);
+    *p++ = (uint8_t)(id >> 16);
+    *p++ = (uint8_t)(id >> 8);
+    *p++ = (uint8_t)id;
+    *p++ = len;
+    *p++ = fdFlags;
+    *p++ = 0;
+    *p++ = 0;
+    memcpy(p, frame->data, len);
+    memset(p + len, 0, captured - SOCKETCAN_HEADER_SIZE - len);
+    p += captured - SOCKETCAN_HEADER_SIZE;
+
+    p = pcapngPutOption(p, PCAPNG_OPT_EPB_FLAGS, &direction, sizeof(direction));
+    p = pcapngPut32(p, PCAPNG_OPT_ENDOFOPT);
+
+    return pcapngEndBlock(block, p);
+}
+
+
+
+
+static int pcapngWrite(pcanCapture_t *capture, const pcanFrame_t *frames, uint32_t count)
+{
+    pcapngWriterState_t *state = (pcapngWriterState_t*)capture->formatState;
+    uint8_t *p = state->blocks;
+    uint32_t blocks = 0;
+    uint32_t i;
+    int ret = 0;
+
+    for (i = 0; i < count; i++)
+    {
+        // Status and error frames have no SocketCAN equivalent
+        if (frames[i].msgtype & (PCAN_MESSAGE_STATUS | PCAN_MESSAGE_ERRFRAME))
+        {
+            continue;
+        }
+
+        p = pcapngFormatPacket(capture, p, &frames[i]);
+
+        if (++blocks == PCAPNG_WRITE_BLOCKS)
+        {
+            ret |= pcanCaptureOutput(capture, state->blocks, (size_t)(p - state->blocks));
+            p = state->blocks;
+            blocks = 0;
+        }
+    }
+
+    if (p != state->blocks)
+    {
+        ret |= pcanCaptureOutput(capture, state->blocks, (size_t)(p - state->blocks));
+    }
+
+    return ret;
+}
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Public functions
@@ -0,0 +1,64 @@
+/* pcapng capture files
+
+   Writes captured frames as a pcapng file with a single SocketCAN interface
+   (LINKTYPE_CAN_SOCKETCAN), which Wireshark and other packet tools decode as
+   CAN. Timestamps keep the microsecond resolution of the hardware clock,
+   offset to wall clock time, and the interface declares that resolution with
+   an if_tsresol option.
+
+   The file is written strictly in order, so the format can also be streamed
+   to a named pipe for live capture.
+
+   Each frame is one Enhanced Packet Block holding a whole SocketCAN frame
+   (struct can_frame, or struct canfd_frame for FD frames):
+     uint32 CAN ID and flags (big-endian), uint8 length, uint8 FD flags,
+     uint16 reserved, then the data, zero-padded
+   with an epb_flags option giving the direction. Status and error frames are
+   not written.
+
+   Copyright (c) 2020 Control Solutions LLC. All rights reserved.
+*/
+
+#ifndef _PCAN_PCAPNG_H_
+#define _PCAN_PCAPNG_H_
+
+#include "pcan_capture.h" // provide pcanCaptureFormat_t
+
+
+// ----------------------------------- // -----------------------------------
+// Definitions
+
+// Link type of the interface
+#define PCAN_PCAPNG_LINKTYPE_CAN_SOCKETCAN (227)
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Global variables
+
+// pcapng capture format
+extern const pcanCaptureFormat_t pcanCaptureFormatPcapng;
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local variables
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local functions
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Public functions
+
+
+
+
+#endif // _PCAN_PCAPNG_H_
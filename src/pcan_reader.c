@@ -0,0 +1,883 @@
+/* Memory-mapped reader for binary capture files
+
+   Maps a capture file written by pcan_capture.c into memory and builds a
+   sparse index over it, so that frames for a set of IDs within a time window
+   can be found without parsing the whole file. Records are grouped into
+   fixed-size blocks; the index holds the time range of each block, and for
+   every CAN ID, a bitmap of the blocks in which it appears. A query only
+   visits the blocks selected by the index.
+
+   Copyright (c) 2020 Control Solutions LLC. All rights reserved.
+*/
+
+#include <stdio.h>       // provide printf, fopen, fread, and fwrite
+#include <stdlib.h>      // provide calloc, malloc, free, qsort, and bsearch
+#include <string.h>      // provide memcpy, memcmp, and strlen
+
+#if defined _WIN32
+#include <windows.h>     // provide Win32 file mapping functions
+#elif defined __APPLE__
+#include <fcntl.h>       // provide open
+#include <sys/mman.h>    // provide mmap and munmap
+#include <sys/stat.h>    // provide fstat
+#include <unistd.h>      // provide close
+#endif
+
+#include "pcan_reader.h"
+
+
+// ----------------------------------- // -----------------------------------
+// Definitions
+
+// Offsets of the fields used by the index, which are common to every record
+// layout (see pcan_frame.h)
+#define RECORD_TIMESTAMP (0)
+#define RECORD_ID        (8)
+
+// Smallest record that contains the fields above
+#define RECORD_SIZE_MIN  (16)
+
+// Initial size of the ID hash table
+#define ID_CAPACITY_INITIAL (64)
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Global variables
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local variables
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local functions
+
+
+static uint64_t readerRecordTimestamp(const uint8_t *record)
+{
+    uint64_t timestamp;
+    memcpy(&timestamp, record + RECORD_TIMESTAMP, sizeof(timestamp));
+    return timestamp;
+}
+
+
+
+
+static uint32_t readerRecordId(const uint8_t *record)
+{
+    uint32_t id;
+    memcpy(&id, record + RECORD_ID, sizeof(id));
+    return id;
+}
+
+
+
+
+static uint32_t readerHashId(uint32_t id, uint32_t capacity)
+{
+    return (id * 2654435761U) & (capacity - 1);
+}
+
+
+
+
+// Map the whole file read-only
+// Returns 0 on success, or 1 on failure
+static int readerMap(pcanReader_t *reader, const char *path)
+{
+#if defined _WIN32
+    LARGE_INTEGER size;
+
+    reader->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                               0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+    if (reader->file == INVALID_HANDLE_VALUE)
+    {
+        reader->file = 0;
+        return 1;
+    }
+
+    if (!GetFileSizeEx(reader->file, &size) || (size.QuadPart == 0))
+    {
+        return 1;
+    }
+    reader->size = (uint64_t)size.QuadPart;
+
+    reader->mapping = CreateFileMappingA(reader->file, 0, PAGE_READONLY, 0, 0, 0);
+    if (reader->mapping == 0)
+    {
+        return 1;
+    }
+
+    reader->data = MapViewOfFile(reader->mapping, FILE_MAP_READ, 0, 0, 0);
+    if (reader->data == 0)
+    {
+        return 1;
+    }
+#elif defined __APPLE__
+    struct stat st;
+    void *data = 0;
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0)
+    {
+        return 1;
+    }
+
+    if ((fstat(fd, &st) != 0) || (st.st_size == 0))
+    {
+        close(fd);
+        return 1;
+    }
+    reader->size = (uint64_t)st.st_size;
+
+    data = mmap(0, (size_t)reader->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED)
+    {
+        return 1;
+    }
+    reader->data = data;
+
+    // Queries mostly walk forward through the file
+    madvise(data, (size_t)reader->size, MADV_SEQUENTIAL);
+#endif
+
+    return 0;
+}
+
+
+
+
+static void readerUnmap(pcanReader_t *reader)
+{
+#if defined _WIN32
+    if (reader->data != 0)
+    {
+        UnmapViewOfFile(reader->data);
+    }
+    if (reader->mapping != 0)
+    {
+        CloseHandle(reader->mapping);
+    }
+    if (reader->file != 0)
+    {
+        CloseHandle(reader->file);
+    }
+#elif defined __APPLE__
+    if (reader->data != 0)
+    {
+        munmap((void*)reader->data, (size_t)reader->size);
+    }
+#endif
+
+    reader->data = 0;
+
+    return;
+}
+
+
+
+
+static void readerFreeIndex(pcanReader_t *reader)
+{
+    uint32_t i;
+
+    if (reader->ids != 0)
+    {
+        for (i = 0; i < reader->idCapacity; i++)
+        {
+            free(reader->ids[i].blocks);
+        }
+    }
+
+    free(reader->ids);
+    free(reader->blockFirst);
+    free(reader->blockLast);
+
+    reader->ids = 0;
+    reader->blockFirst = 0;
+    reader->blockLast = 0;
+    reader->idCapacity = 0;
+    reader->idCount = 0;
+
+    return;
+}
+
+
+
+
+// Allocate an empty index sized for the file
+// Returns 0 on success, or 1 if out of memory
+static int readerAllocIndex(pcanReader_t *reader, uint32_t idCapacity)
+{
+    reader->blockCount = (uint32_t)((reader->recordCount + PCAN_READER_BLOCK_RECORDS - 1) /
+                                    PCAN_READER_BLOCK_RECORDS);
+    reader->blockWords = (reader->blockCount + 63) / 64;
+    if (reader->blockWords == 0)
+    {
+        reader->blockWords = 1;
+    }
+
+    reader->blockFirst = calloc(reader->blockWords * 64, sizeof(uint64_t));
+    reader->blockLast = calloc(reader->blockWords * 64, sizeof(uint64_t));
+    reader->ids = calloc(idCapacity, sizeof(pcanReaderId_t));
+    reader->idCapacity = idCapacity;
+    reader->idCount = 0;
+
+    if ((reader->blockFirst == 0) || (reader->blockLast == 0) || (reader->ids == 0))
+    {
+        readerFreeIndex(reader);
+        return 1;
+    }
+
+    return 0;
+}
+
+
+
+
+// Return the hash table entry for an ID, inserting an empty one (with a block
+// bitmap) if needed and growing the table to keep it at most half full
+// Returns the entry, or 0 if out of memory
+static pcanReaderId_t *readerInsertId(pcanReader_t *reader, uint32_t id)
+{
+    pcanReaderId_t *entry = 0;
+    pcanReaderId_t *grown = 0;
+    uint32_t capacity = 0;
+    uint32_t slot = 0;
+    uint32_t i;
+
+    slot = readerHashId(id, reader->idCapacity);
+    while (reader->ids[slot].used)
+    {
+        if (reader->ids[slot].id == id)
+        {
+            return &(reader->ids[slot]);
+        }
+        slot = (slot + 1) & (reader->idCapacity - 1);
+    }
+
+    if ((reader->idCount + 1) * 2 > reader->idCapacity)
+    {
+        capacity = reader->idCapacity * 2;
+        grown = calloc(capacity, sizeof(pcanReaderId_t));
+        if (grown == 0)
+        {
+            return 0;
+        }
+
+        for (i = 0; i < reader->idCapacity; i++)
+        {
+            if (reader->ids[i].used)
+            {
+                slot = readerHashId(reader->ids[i].id, capacity);
+                while (grown[slot].used)
+                {
+                    slot = (slot + 1) & (capacity - 1);
+                }
+                grown[slot] = reader->ids[i];
+            }
+        }
+
+        free(reader->ids);
+        reader->ids = grown;
+        reader->idCapacity = capacity;
+
+        slot = readerHashId(id, capacity);
+        while (reader->ids[slot].used)
+        {
+            slot = (slot + 1) & (capacity - 1);
+        }
+    }
+
+    entry = &(reader->ids[slot]);
+    entry->blocks = calloc(reader->blockWords, sizeof(uint64_t));
+    if (entry->blocks == 0)
+    {
+        return 0;
+    }
+
+    entry->id = id;
+    entry->frames = 0;
+    entry->used = 1;
+    reader->idCount++;
+
+    return entry;
+}
+
+
+
+
+// Build the index with one pass over every record
+// Returns 0 on success, or 1 if out of memory
+static int readerBuildIndex(pcanReader_t *reader)
+{
+    const uint8_t *record = reader->records;
+    pcanReaderId_t *entry = 0;
+    uint64_t timestamp = 0;
+    uint64_t r;
+    uint32_t block = 0;
+
+    if (readerAllocIndex(reader, ID_CAPACITY_INITIAL) != 0)
+    {
+        return 1;
+    }
+
+    for (r = 0; r < reader->recordCount; r++, record += reader->recordSize)
+    {
+        timestamp = readerRecordTimestamp(record);
+        block = (uint32_t)(r / PCAN_READER_BLOCK_RECORDS);
+
+        if ((r % PCAN_READER_BLOCK_RECORDS) == 0)
+        {
+            reader->blockFirst[block] = timestamp;
+            reader->blockLast[block] = timestamp;
+        }
+        else if (timestamp < reader->blockFirst[block])
+        {
+            reader->blockFirst[block] = timestamp;
+        }
+        else if (timestamp > reader->blockLast[block])
+        {
+            reader->blockLast[block] = timestamp;
+        }
+
+        entry = readerInsertId(reader, readerRecordId(record));
+        if (entry == 0)
+        {
+            readerFreeIndex(reader);
+            return 1;
+        }
+
+        entry->frames++;
+        entry->blocks[block / 64] |= (1ULL << (block % 64));
+    }
+
+    reader->indexLoaded = 0;
+
+    return 0;
+}
+
+
+
+
+// Load the index from a sidecar file, if it exists and matches the capture
+// Returns 0 on success, or 1 if the sidecar is missing, stale, or invalid
+static int readerLoadIndex(pcanReader_t *reader, const char *indexPath)
+{
+    pcanReaderIndexHeader_t header;
+    pcanReaderId_t *entry = 0;
+    uint32_t *idPairs = 0;
+    uint32_t capacity = ID_CAPACITY_INITIAL;
+    uint32_t i;
+    int ret = 1;
+    FILE *file = fopen(indexPath, "rb");
+
+    if (file == 0)
+    {
+        return 1;
+    }
+
+    if ((fread(&header, sizeof(header), 1, file) != 1) ||
+        (memcmp(header.magic, PCAN_READER_INDEX_MAGIC, sizeof(PCAN_READER_INDEX_MAGIC)) != 0) ||
+        (header.version != PCAN_READER_INDEX_VERSION) ||
+        (header.blockRecords != PCAN_READER_BLOCK_RECORDS) ||
+        (header.fileSize != reader->size) ||
+        (header.startTime != reader->header.startTime))
+    {
+        fclose(file);
+        return 1;
+    }
+
+    while (capacity < header.idCount * 2)
+    {
+        capacity *= 2;
+    }
+
+    if (readerAllocIndex(reader, capacity) != 0)
+    {
+        fclose(file);
+        return 1;
+    }
+
+    if (header.blockCount != reader->blockCount)
+    {
+        goto done;
+    }
+
+    for (i = 0; i < header.blockCount; i++)
+    {
+        if ((fread(&(reader->blockFirst[i]), sizeof(uint64_t), 1, file) != 1) ||
+            (fread(&(reader->blockLast[i]), sizeof(uint64_t), 1, file) != 1))
+        {
+            goto done;
+        }
+    }
+
+    idPairs = malloc(2 * sizeof(uint32_t) * (header.idCount + 1));
+    if ((idPairs == 0) ||
+        (fread(idPairs, 2 * sizeof(uint32_t), header.idCount, file) != header.idCount))
+    {
+        goto done;
+    }
+
+    for (i = 0; i < header.idCount; i++)
+    {
+        entry = readerInsertId(reader, idPairs[2 * i]);
+        if ((entry == 0) ||
+            (fread(entry->blocks, sizeof(uint64_t), reader->blockWords, file) !=
+             reader->blockWords))
+        {
+            goto done;
+        }
+        entry->frames = idPairs[2 * i + 1];
+    }
+
+    reader->indexLoaded = 1;
+    ret = 0;
+
+done:
+    free(idPairs);
+    fclose(file);
+
+    if (ret != 0)
+    {
+        readerFreeIndex(reader);
+    }
+
+    return ret;
+}
+
+
+
+
+// Save the index to a sidecar file. Failure is not fatal; the index will
+// simply be built again next time.
+static void readerSaveIndex(pcanReader_t *reader, const char *indexPath)
+{
+    pcanReaderIndexHeader_t header;
+    pcanReaderId_t *entry = 0;
+    uint32_t pair[2];
+    uint32_t i;
+    int ok = 1;
+    FILE *file = fopen(indexPath, "wb");
+
+    if (file == 0)
+    {
+#ifdef PCAN_READER_DEBUG
+        printf("pcanReaderOpen: Unable to write index \"%s\"\n", indexPath);
+#endif
+        return;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, PCAN_READER_INDEX_MAGIC, sizeof(PCAN_READER_INDEX_MAGIC));
+    header.version = PCAN_READER_INDEX_VERSION;
+    header.blockRecords = PCAN_READER_BLOCK_RECORDS;
+    header.fileSize = reader->size;
+    header.startTime = reader->header.startTime;
+    header.blockCount = reader->blockCount;
+    header.idCount = reader->idCount;
+
+    ok &= (fwrite(&header, sizeof(header), 1, file) == 1);
+
+    for (i = 0; i < reader->blockCount; i++)
+    {
+        ok &= (fwrite(&(reader->blockFirst[i]), sizeof(uint64_t), 1, file) == 1);
+        ok &= (fwrite(&(reader->blockLast[i]), sizeof(uint64_t), 1, file) == 1);
+    }
+
+    // IDs are written in hash table order, followed by their bitmaps in the
+    // same order
+    for (i = 0; i < reader->idCapacity; i++)
+    {
+        entry = &(reader->ids[i]);
+        if (entry->used)
+        {
+            pair[0] = entry->id;
+            pair[1] = entry->frames;
+            ok &= (fwrite(pair, sizeof(pair), 1, file) == 1);
+        }
+    }
+
+    for (i = 0; i < reader->idCapacity; i++)
+    {
+        entry = &(reader->ids[i]);
+        if (entry->used)
+        {
+            ok &= (fwrite(entry->blocks, sizeof(uint64_t), reader->blockWords, file) ==
+                   reader->blockWords);
+        }
+    }
+
+    fclose(file);
+
+    // Do not leave a truncated sidecar behind
+    if (!ok)
+    {
+        remove(indexPath);
+    }
+
+    return;
+}
+
+
+
+
+static int readerCompareIds(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+
+    return (x < y) ? -1 : ((x > y) ? 1 : 0);
+}
+
+
+
+
+// Return the first block at or after block that is set in the query bitmap,
+// or blockCount if there is none
+static uint32_t readerNextBlock(const pcanReaderQuery_t *query, uint32_t block)
+{
+    const pcanReader_t *reader = query->reader;
+    uint32_t word = block / 64;
+    uint64_t bits = 0;
+
+    if (block >= reader->blockCount)
+    {
+        return reader->blockCount;
+    }
+
+    bits = query->blocks[word] & (~0ULL << (block % 64));
+
+    while (bits == 0)
+    {
+        word++;
+        if (word >= reader->blockWords)
+        {
+            return reader->blockCount;
+        }
+        bits = query->blocks[word];
+    }
+
+    // Find the lowest set bit
+    block = word * 64;
+    while ((bits & 1) == 0)
+    {
+        bits >>= 1;
+        block++;
+    }
+
+    return (block < reader->blockCount) ? block : reader->blockCount;
+}
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Public functions
+
+
+pcanReader_t *pcanReaderOpen(const char *path, pcanReaderIndexMode_t mode,
+                             const char **error)
+{
+    pcanReader_t *reader = 0;
+    char *indexPath = 0;
+
+    reader = calloc(1, sizeof(*reader));
+    if (reader == 0)
+    {
+        *error = "Error allocating memory for reader.";
+        return 0;
+    }
+    reader->refs = 1;
+
+    if (readerMap(reader, path) != 0)
+    {
+        pcanReaderRelease(reader);
+        *error = "Unable to map capture file.";
+        return 0;
+    }
+
+    // Validate the file header
+    if (reader->size < sizeof(pcanCaptureHeader_t))
+    {
+        pcanReaderRelease(reader);
+        *error = "Capture file is too short.";
+        return 0;
+    }
+
+    memcpy(&(reader->header), reader->data, sizeof(reader->header));
+
+    if ((memcmp(reader->header.magic, PCAN_CAPTURE_MAGIC, sizeof(PCAN_CAPTURE_MAGIC)) != 0) ||
+        (reader->header.headerSize < sizeof(pcanCaptureHeader_t)) ||
+        (reader->header.headerSize > reader->size) ||
+        (reader->header.recordSize < RECORD_SIZE_MIN))
+    {
+        pcanReaderRelease(reader);
+        *error = "Not a capture file.";
+        return 0;
+    }
+
+    // A trailing partial record (for example, from a capture still being
+    // written) is ignored
+    reader->records = reader->data + reader->header.headerSize;
+    reader->recordSize = reader->header.recordSize;
+    reader->recordCount = (reader->size - reader->header.headerSize) / reader->recordSize;
+
+    if (reader->recordCount > (uint64_t)PCAN_READER_BLOCK_RECORDS * 0xFFFFFFFFULL)
+    {
+        pcanReaderRelease(reader);
+        *error = "Capture file is too large.";
+        return 0;
+    }
+
+    // Obtain the index
+    indexPath = malloc(strlen(path) + sizeof(PCAN_READER_INDEX_SUFFIX));
+    if (indexPath == 0)
+    {
+        pcanReaderRelease(reader);
+        *error = "Error allocating memory for reader.";
+        return 0;
+    }
+    strcpy(indexPath, path);
+    strcat(indexPath, PCAN_READER_INDEX_SUFFIX);
+
+    if ((mode == PCAN_READER_INDEX_BUILD) || (readerLoadIndex(reader, indexPath) != 0))
+    {
+        if (readerBuildIndex(reader) != 0)
+        {
+            free(indexPath);
+            pcanReaderRelease(reader);
+            *error = "Error allocating memory for index.";
+            return 0;
+        }
+
+        if (mode != PCAN_READER_INDEX_MEMORY)
+        {
+            readerSaveIndex(reader, indexPath);
+        }
+    }
+
+    free(indexPath);
+
+    if (reader->blockCount > 0)
+    {
+        uint32_t i;
+
+        reader->firstTimestamp = reader->blockFirst[0];
+        reader->lastTimestamp = reader->blockLast[0];
+        for (i = 1; i < reader->blockCount; i++)
+        {
+            if (reader->blockFirst[i] < reader->firstTimestamp)
+            {
+                reader->firstTimestamp = reader->blockFirst[i];
+            }
+            if (reader->blockLast[i] > reader->lastTimestamp)
+            {
+                reader->lastTimestamp = reader->blockLast[i];
+            }
+        }
+    }
+
+#ifdef PCAN_READER_DEBUG
+    printf("pcanReaderOpen: \"%s\", %llu records, %u blocks, %u IDs, index %s\n",
+           path, (unsigned long long)reader->recordCount, reader->blockCount,
+           reader->idCount, reader->indexLoaded ? "loaded" : "built");
+#endif
+
+    return reader;
+}
+
+
+
+
+void pcanReaderRelease(pcanReader_t *reader)
+{
+    reader->refs--;
+    if (reader->refs > 0)
+    {
+        return;
+    }
+
+    readerFreeIndex(reader);
+    readerUnmap(reader);
+    free(reader);
+
+    return;
+}
+
+
+
+
+const pcanReaderId_t *pcanReaderFindId(const pcanReader_t *reader, uint32_t id)
+{
+    uint32_t slot = 0;
+
+    if (reader->idCapacity == 0)
+    {
+        return 0;
+    }
+
+    slot = readerHashId(id, reader->idCapacity);
+    while (reader->ids[slot].used)
+    {
+        if (reader->ids[slot].id == id)
+        {
+            return &(reader->ids[slot]);
+        }
+        slot = (slot + 1) & (reader->idCapacity - 1);
+    }
+
+    return 0;
+}
+
+
+
+
+pcanReaderQuery_t *pcanReaderQueryStart(pcanReader_t *reader, const uint32_t *ids,
+                                        uint32_t idCount, uint64_t from, uint64_t to)
+{
+    pcanReaderQuery_t *query = 0;
+    const pcanReaderId_t *entry = 0;
+    uint32_t b;
+    uint32_t i;
+    uint32_t w;
+
+    query = calloc(1, sizeof(*query));
+    if (query == 0)
+    {
+        return 0;
+    }
+
+    query->blocks = calloc(reader->blockWords, sizeof(uint64_t));
+    if ((idCount > 0) && (query->blocks != 0))
+    {
+        query->ids = malloc(idCount * sizeof(uint32_t));
+    }
+    if ((query->blocks == 0) || ((idCount > 0) && (query->ids == 0)))
+    {
+        free(query->blocks);
+        free(query);
+        return 0;
+    }
+
+    reader->refs++;
+    query->reader = reader;
+    query->from = from;
+    query->to = to;
+
+    // Select the blocks that contain any of the requested IDs
+    if (idCount > 0)
+    {
+        memcpy(query->ids, ids, idCount * sizeof(uint32_t));
+        qsort(query->ids, idCount, sizeof(uint32_t), readerCompareIds);
+        query->idCount = idCount;
+
+        for (i = 0; i < idCount; i++)
+        {
+            entry = pcanReaderFindId(reader, ids[i]);
+            if (entry != 0)
+            {
+                for (w = 0; w < reader->blockWords; w++)
+                {
+                    query->blocks[w] |= entry->blocks[w];
+                }
+            }
+        }
+    }
+    else
+    {
+        for (b = 0; b < reader->blockCount; b++)
+        {
+            query->blocks[b / 64] |= (1ULL << (b % 64));
+        }
+    }
+
+    // Of those, keep the blocks that overlap the time window
+    for (b = 0; b < reader->blockCount; b++)
+    {
+        if ((reader->blockLast[b] < from) || (reader->blockFirst[b] > to))
+        {
+            query->blocks[b / 64] &= ~(1ULL << (b % 64));
+        }
+    }
+
+    query->block = readerNextBlock(query, 0);
+    query->record = (uint64_t)query->block * PCAN_READER_BLOCK_RECORDS;
+    query->done = (query->block >= reader->blockCount);
+
+    return query;
+}
+
+
+
+
+uint32_t pcanReaderQueryNext(pcanReaderQuery_t *query, uint8_t *out, uint32_t max)
+{
+    const pcanReader_t *reader = query->reader;
+    const uint8_t *record = 0;
+    uint64_t blockEnd = 0;
+    uint64_t timestamp = 0;
+    uint32_t id = 0;
+    uint32_t count = 0;
+
+    while (!query->done && (count < max))
+    {
+        blockEnd = (uint64_t)(query->block + 1) * PCAN_READER_BLOCK_RECORDS;
+        if (blockEnd > reader->recordCount)
+        {
+            blockEnd = reader->recordCount;
+        }
+
+        // Scan the rest of the current block
+        record = reader->records + query->record * reader->recordSize;
+        while ((query->record < blockEnd) && (count < max))
+        {
+            timestamp = readerRecordTimestamp(record);
+            id = readerRecordId(record);
+
+            if ((timestamp >= query->from) && (timestamp <= query->to) &&
+                ((query->idCount == 0) ||
+                 (bsearch(&id, query->ids, query->idCount, sizeof(uint32_t),
+                          readerCompareIds) != 0)))
+            {
+                memcpy(out + (size_t)count * reader->recordSize, record, reader->recordSize);
+                count++;
+            }
+
+            query->record++;
+            record += reader->recordSize;
+        }
+
+        // Move on to the next selected block
+        if (query->record >= blockEnd)
+        {
+            query->block = readerNextBlock(query, query->block + 1);
+            query->record = (uint64_t)query->block * PCAN_READER_BLOCK_RECORDS;
+            query->done = (query->block >= reader->blockCount);
+        }
+    }
+
+    return count;
+}
+
+
+
+
+void pcanReaderQueryFree(pcanReaderQuery_t *query)
+{
+    pcanReaderRelease(query->reader);
+    free(query->ids);
+    free(query->blocks);
+    free(query);
+
+    return;
+}
@@ -0,0 +1,178 @@
+/* Memory-mapped reader for binary capture files
+
+   Maps a capture file written by pcan_capture.c into memory and builds a
+   sparse index over it, so that frames for a set of IDs within a time window
+   can be found without parsing the whole file. Records are grouped into
+   fixed-size blocks; the index holds the time range of each block, and for
+   every CAN ID, a bitmap of the blocks in which it appears. A query only
+   visits the blocks selected by the index.
+
+   Building the index takes one sequential pass over the file. It can be saved
+   to a sidecar file (capture path + PCAN_READER_INDEX_SUFFIX) and loaded on
+   later opens, as long as the capture file has not changed size.
+
+   Sidecar layout (all fields little-endian):
+     pcanReaderIndexHeader_t
+     blockCount x { uint64 first timestamp, uint64 last timestamp }
+     idCount x { uint32 id, uint32 frames }
+     idCount x blockWords x uint64 block bitmap
+
+   Copyright (c) 2020 Control Solutions LLC. All rights reserved.
+*/
+
+#ifndef _PCAN_READER_H_
+#define _PCAN_READER_H_
+
+#include <stddef.h>      // provide size_t
+#include <stdint.h>      // provide uintX_t
+
+#include "pcan_capture.h" // provide pcanCaptureHeader_t
+
+
+//#define PCAN_READER_DEBUG
+// Uncomment to enable debugging messages, which may affect timing or
+// performance
+
+// ----------------------------------- // -----------------------------------
+// Definitions
+
+// Sidecar index identification
+#define PCAN_READER_INDEX_MAGIC   "PCANIDX"
+#define PCAN_READER_INDEX_VERSION (1)
+#define PCAN_READER_INDEX_SUFFIX  ".idx"
+
+// Number of records in each index block
+#define PCAN_READER_BLOCK_RECORDS (4096)
+
+// How the index is obtained when a file is opened
+typedef enum pcanReaderIndexMode_e
+{
+    PCAN_READER_INDEX_AUTO = 0, // Load the sidecar if valid, else build and save it
+    PCAN_READER_INDEX_BUILD,    // Always build, and save the sidecar
+    PCAN_READER_INDEX_MEMORY,   // Load the sidecar if valid, else build without saving
+} pcanReaderIndexMode_t;
+
+// Header of a sidecar index file
+typedef struct pcanReaderIndexHeader_s
+{
+    char magic[8];         // PCAN_READER_INDEX_MAGIC, NUL-terminated
+    uint16_t version;      // PCAN_READER_INDEX_VERSION
+    uint16_t reserved;
+    uint32_t blockRecords; // Records per block
+    uint64_t fileSize;     // Size of the capture file that was indexed
+    uint64_t startTime;    // startTime from the capture file header
+    uint32_t blockCount;
+    uint32_t idCount;
+} pcanReaderIndexHeader_t;
+
+typedef char pcanReaderIndexHeaderSizeCheck_t[
+    (sizeof(pcanReaderIndexHeader_t) == 40) ? 1 : -1];
+
+// Index entry for one CAN ID
+typedef struct pcanReaderId_s
+{
+    uint32_t id;
+    uint32_t frames;       // Number of records with this ID
+    uint64_t *blocks;      // Bitmap of blocks containing this ID
+    int used;              // Hash table slot is occupied
+} pcanReaderId_t;
+
+// Open capture file
+typedef struct pcanReader_s
+{
+    int refs;              // Owners (the opener plus each live query)
+
+    // File mapping
+    const uint8_t *data;
+    uint64_t size;
+#if defined _WIN32
+    void *file;
+    void *mapping;
+#endif
+
+    pcanCaptureHeader_t header;
+    const uint8_t *records; // First record
+    uint64_t recordCount;
+    uint32_t recordSize;
+
+    // Index
+    int indexLoaded;       // Index came from the sidecar rather than a scan
+    uint32_t blockCount;
+    uint32_t blockWords;   // uint64 words in each block bitmap
+    uint64_t *blockFirst;  // Earliest timestamp in each block
+    uint64_t *blockLast;   // Latest timestamp in each block
+    pcanReaderId_t *ids;   // Open-addressed hash table of IDs
+    uint32_t idCapacity;   // Always a power of two
+    uint32_t idCount;
+    uint64_t firstTimestamp;
+    uint64_t lastTimestamp;
+} pcanReader_t;
+
+// Query state, created by pcanReaderQueryStart
+typedef struct pcanReaderQuery_s
+{
+    pcanReader_t *reader;
+    uint32_t *ids;         // Sorted IDs to match, or 0 to match all
+    uint32_t idCount;
+    uint64_t from;         // Inclusive timestamp range
+    uint64_t to;
+    uint64_t *blocks;      // Bitmap of blocks that may contain matches
+    uint32_t block;        // Block being visited
+    uint64_t record;       // Next record to examine
+    int done;
+} pcanReaderQuery_t;
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Global variables
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local variables
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local functions
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Public functions
+
+// Map a capture file and obtain its index
+// Returns the new reader, or 0 on failure (with a reason in *error)
+pcanReader_t *pcanReaderOpen(const char *path, pcanReaderIndexMode_t mode,
+                             const char **error);
+
+// Drop one reference to a reader, unmapping and freeing it with the last one
+void pcanReaderRelease(pcanReader_t *reader);
+
+// Return the index entry for an ID, or 0 if the ID does not appear in the file
+const pcanReaderId_t *pcanReaderFindId(const pcanReader_t *reader, uint32_t id);
+
+// Start a query for records whose ID is one of ids (all IDs if idCount is 0)
+// and whose timestamp is within [from, to]. The query holds a reference to the
+// reader until it is freed.
+// Returns the new query, or 0 if out of memory
+pcanReaderQuery_t *pcanReaderQueryStart(pcanReader_t *reader, const uint32_t *ids,
+                                        uint32_t idCount, uint64_t from, uint64_t to);
+
+// Copy up to max matching records, in file order, into out, which must hold
+// max * reader->recordSize bytes
+// Returns the number of records copied, which is 0 once the query is done
+uint32_t pcanReaderQueryNext(pcanReaderQuery_t *query, uint8_t *out, uint32_t max);
+
+// Free a query and release its reference to the reader
+void pcanReaderQueryFree(pcanReaderQuery_t *query);
+
+
+
+
+#endif // _PCAN_READER_H_
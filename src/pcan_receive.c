@@ -0,0 +1,448 @@
+/* Native receive path
+
+   Drains received messages from the PCAN-Basic receive queue on the event
+   worker thread, in batches. Under the sink lock, each batch is handed to the
+   transmit queue to confirm its echoes of sent frames, and to the capture, if
+   any; then the frames that pass the filters, with echoes only if they are
+   looped back, are set aside for the ring, and the received frames (not the
+   echoes) go to the timed-message triggers and the request matcher. The ring
+   buffers packed frame records until JavaScript collects them in batches.
+   JavaScript is only notified when the ring goes from empty to non-empty, so
+   a burst of frames costs a single callback.
+
+   Copyright (c) 2020 Control Solutions LLC. All rights reserved.
+*/
+
+#include <stdio.h>       // provide printf
+#include <stdlib.h>      // provide calloc and free
+#include <string.h>      // provide memcpy and memset
+
+#include "pcan_receive.h"
+#include "pcan_helper.h" // provide pcanStatusLookup
+
+
+// ----------------------------------- // -----------------------------------
+// Definitions
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Global variables
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local variables
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local functions
+
+
+// Append frames to the ring, discarding those that do not fit. If force is
+// nonzero, JavaScript is notified even if no frames were added.
+// Returns nonzero if JavaScript should be notified
+static int receivePush(pcanReceive_t *rx, const uint8_t *records, uint32_t count,
+                       int force)
+{
+    uint32_t i;
+    uint32_t tail;
+    int notify = 0;
+
+    pcanMutexLock(&(rx->ringLock));
+
+    for (i = 0; i < count; i++)
+    {
+        if (rx->ringCount == rx->ringCapacity)
+        {
+            rx->ringOverruns += (count - i);
+            break;
+        }
+
+        tail = (rx->ringHead + rx->ringCount) % rx->ringCapacity;
+        memcpy(rx->ring + (size_t)tail * rx->recordSize,
+               records + (size_t)i * rx->recordSize, rx->recordSize);
+        rx->ringCount++;
+    }
+
+    if (((rx->ringCount > 0) || force) && !rx->notifyPending)
+    {
+        rx->notifyPending = 1;
+        notify = 1;
+    }
+
+    pcanMutexUnlock(&(rx->ringLock));
+
+    return notify;
+}
+
+
+
+
+// Return nonzero if a frame passes the filters. The sink lock must be held.
+static int receiveAccept(const pcanReceive_t *rx, const pcanFrame_t *frame)
+{
+    const pcanReceiveFilter_t *filter;
+    uint32_t i;
+    int ext;
+
+    // Status and error frames are not subject to filtering
+    if ((rx->filterCount == 0) ||
+        (frame->msgtype & (PCAN_MESSAGE_STATUS | PCAN_MESSAGE_ERRFRAME)))
+    {
+        return 1;
+    }
+
+    ext = (frame->msgtype & PCAN_MESSAGE_EXTENDED) ? 1 : 0;
+
+    for (i = 0; i < rx->filterCount; i++)
+    {
+        filter = &(rx->filters[i]);
+        if ((filter->ext == ext) && (frame->id >= filter->fromId) && (frame->id <= filter->toId) &&
+            (((frame->id ^ filter->code) & ~filter->mask) == 0))
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Public functions
+
+
+int pcanReceiveInit(pcanReceive_t *rx, TPCANHandle channel, uint32_t capacity, int fd)
+{
+    memset(rx, 0, sizeof(*rx));
+
+    if (capacity == 0)
+    {
+        capacity = PCAN_RECEIVE_RING_DEFAULT;
+    }
+
+    rx->fd = fd;
+    rx->recordSize = fd ? PCAN_FRAME_FD_SIZE : PCAN_FRAME_SIZE;
+
+    rx->ring = calloc(capacity, rx->recordSize);
+    if (rx->ring == 0)
+    {
+        printf("pcanReceiveInit: Error at calloc.\n");
+        return 1;
+    }
+
+    rx->channel = channel;
+    rx->ringCapacity = capacity;
+    rx->passthrough = 1;
+    rx->lastStatus = PCAN_ERROR_OK;
+
+    pcanMutexInit(&(rx->ringLock));
+    pcanMutexInit(&(rx->sinkLock));
+
+    rx->initialized = 1;
+
+    return 0;
+}
+
+
+
+
+void pcanReceiveFree(pcanReceive_t *rx)
+{
+    if (!rx->initialized)
+    {
+        return;
+    }
+
+    pcanMutexDestroy(&(rx->ringLock));
+    pcanMutexDestroy(&(rx->sinkLock));
+    free(rx->ring);
+
+    memset(rx, 0, sizeof(*rx));
+
+    return;
+}
+
+
+
+
+int pcanReceiveDrain(pcanReceive_t *rx)
+{
+    pcanFrame_t frames[PCAN_RECEIVE_DRAIN_BATCH];
+    pcanFrameFD_t fdFrames[PCAN_RECEIVE_DRAIN_BATCH];
+    uint8_t delivered[PCAN_RECEIVE_DRAIN_BATCH * PCAN_FRAME_FD_SIZE];
+    uint64_t hostTimes[PCAN_RECEIVE_DRAIN_BATCH];
+    TPCANMsg msg;
+    TPCANTimestamp timestamp;
+    TPCANMsgFD msgFD;
+    TPCANTimestampFD timestampFD;
+    TPCANStatus pcanStatus = PCAN_ERROR_OK;
+    uint32_t count = 0;
+    uint32_t received = 0;
+    uint32_t echoes = 0;
+    uint32_t accepted = 0;
+    uint32_t i;
+    int deliver = 1;
+    int notify = 0;
+
+    while (pcanStatus == PCAN_ERROR_OK)
+    {
+        // Read a batch of messages from the driver queue
+        count = 0;
+        echoes = 0;
+        while (count < PCAN_RECEIVE_DRAIN_BATCH)
+        {
+            if (rx->fd)
+            {
+                pcanStatus = CAN_ReadFD(rx->channel, &msgFD, &timestampFD);
+            }
+            else
+            {
+                pcanStatus = CAN_Read(rx->channel, &msg, &timestamp);
+            }
+            if (pcanStatus != PCAN_ERROR_OK)
+            {
+                break;
+            }
+
+            // Triggers count from when a frame reached the host
+            hostTimes[count] = pcanTimeMicros();
+            if (rx->fd)
+            {
+                pcanFrameFDFromMsg(&(fdFrames[count]), &msgFD, timestampFD);
+                pcanFrameFromFD(&(frames[count]), &(fdFrames[count]));
+            }
+            else
+            {
+                pcanFrameFromMsg(&(frames[count]), &msg, &timestamp);
+            }
+            if (frames[count].flags & PCAN_FRAME_FLAG_TX)
+            {
+                echoes++;
+            }
+            count++;
+        }
+
+        if (count == 0)
+        {
+            break;
+        }
+
+        // Hand the batch to the transmit queue and the capture, if any
+        pcanMutexLock(&(rx->sinkLock));
+        if ((rx->transmit != 0) && (echoes > 0))
+        {
+            pcanTransmitConfirm(rx->transmit, frames, hostTimes, count);
+        }
+        if (rx->capture != 0)
+        {
+            pcanCaptureWrite(rx->capture, frames, count);
+            deliver = rx->passthrough;
+        }
+        else
+        {
+            deliver = 1;
+        }
+
+        // The ring gets what passes the filters, with echoes kept in place
+        // among received frames if they are looped back
+        accepted = 0;
+        for (i = 0; i < count; i++)
+        {
+            if ((rx->loopback || !(frames[i].flags & PCAN_FRAME_FLAG_TX)) &&
+                receiveAccept(rx, &(frames[i])))
+            {
+                memcpy(delivered + (size_t)accepted * rx->recordSize,
+                       rx->fd ? (void*)&(fdFrames[i]) : (void*)&(frames[i]), rx->recordSize);
+                accepted++;
+            }
+        }
+
+        // Echoes are not received frames, so the rest see only what is left
+        received = count;
+        if (echoes > 0)
+        {
+            received = 0;
+            for (i = 0; i < count; i++)
+            {
+                if (!(frames[i].flags & PCAN_FRAME_FLAG_TX))
+                {
+                    frames[received] = frames[i];
+                    hostTimes[received] = hostTimes[i];
+                    received++;
+                }
+            }
+        }
+
+        if ((rx->timed != 0) && (received > 0))
+        {
+            pcanTimedTrigger(rx->timed, frames, hostTimes, received);
+        }
+        if ((rx->request != 0) && (received > 0))
+        {
+            pcanRequestMatch(rx->request, frames, hostTimes, received);
+        }
+        pcanMutexUnlock(&(rx->sinkLock));
+
+        if (deliver && (accepted > 0))
+        {
+            notify |= receivePush(rx, delivered, accepted, 0);
+        }
+    }
+
+    if ((pcanStatus != PCAN_ERROR_QRCVEMPTY) && (pcanStatus != rx->lastStatus))
+    {
+#ifdef PCAN_RECEIVE_DEBUG
+        printf("pcanReceiveDrain: 0x%02X (%s)\n", pcanStatus, pcanStatusLookup(pcanStatus));
+#endif
+        // Make sure JavaScript gets a chance to check the bus status
+        notify |= receivePush(rx, delivered, 0, 1);
+    }
+    rx->lastStatus = pcanStatus;
+
+    return notify;
+}
+
+
+
+
+uint32_t pcanReceivePop(pcanReceive_t *rx, void *records, uint32_t max)
+{
+    uint32_t count = 0;
+    uint32_t first = 0;
+
+    pcanMutexLock(&(rx->ringLock));
+
+    count = (rx->ringCount < max) ? rx->ringCount : max;
+
+    // Copy in at most two pieces, either side of the end of the ring
+    first = rx->ringCapacity - rx->ringHead;
+    if (first > count)
+    {
+        first = count;
+    }
+
+    memcpy(records, rx->ring + (size_t)rx->ringHead * rx->recordSize,
+           (size_t)first * rx->recordSize);
+    memcpy((uint8_t*)records + (size_t)first * rx->recordSize, rx->ring,
+           (size_t)(count - first) * rx->recordSize);
+
+    rx->ringHead = (rx->ringHead + count) % rx->ringCapacity;
+    rx->ringCount -= count;
+
+    // Once JavaScript has emptied the ring, the next frame notifies it again
+    if (rx->ringCount == 0)
+    {
+        rx->notifyPending = 0;
+    }
+
+    pcanMutexUnlock(&(rx->ringLock));
+
+    return count;
+}
+
+
+
+
+uint32_t pcanReceivePending(pcanReceive_t *rx)
+{
+    uint32_t count = 0;
+
+    pcanMutexLock(&(rx->ringLock));
+    count = rx->ringCount;
+    pcanMutexUnlock(&(rx->ringLock));
+
+    return count;
+}
+
+
+
+
+void pcanReceiveAttachCapture(pcanReceive_t *rx, pcanCapture_t *capture, int passthrough)
+{
+    pcanMutexLock(&(rx->sinkLock));
+    rx->capture = capture;
+    rx->passthrough = passthrough;
+    pcanMutexUnlock(&(rx->sinkLock));
+
+    return;
+}
+
+
+
+
+pcanCapture_t *pcanReceiveDetachCapture(pcanReceive_t *rx)
+{
+    pcanCapture_t *capture = 0;
+
+    pcanMutexLock(&(rx->sinkLock));
+    capture = rx->capture;
+    rx->capture = 0;
+    rx->passthrough = 1;
+    pcanMutexUnlock(&(rx->sinkLock));
+
+    return capture;
+}
+
+
+
+
+void pcanReceiveAttachTimed(pcanReceive_t *rx, pcanTimed_t *timed)
+{
+    pcanMutexLock(&(rx->sinkLock));
+    rx->timed = timed;
+    pcanMutexUnlock(&(rx->sinkLock));
+
+    return;
+}
+
+
+
+
+void pcanReceiveAttachTransmit(pcanReceive_t *rx, pcanTransmit_t *transmit)
+{
+    pcanMutexLock(&(rx->sinkLock));
+    rx->transmit = transmit;
+    pcanMutexUnlock(&(rx->sinkLock));
+
+    return;
+}
+
+
+
+
+void pcanReceiveAttachRequest(pcanReceive_t *rx, pcanRequest_t *request)
+{
+    pcanMutexLock(&(rx->sinkLock));
+    rx->request = request;
+    pcanMutexUnlock(&(rx->sinkLock));
+
+    return;
+}
+
+
+
+
+void pcanReceiveConfigure(pcanReceive_t *rx, const pcanReceiveFilter_t *filters,
+                          uint32_t count, int loopback)
+{
+    if (count > PCAN_RECEIVE_FILTERS_MAX)
+    {
+        count = PCAN_RECEIVE_FILTERS_MAX;
+    }
+
+    pcanMutexLock(&(rx->sinkLock));
+    memcpy(rx->filters, filters, count * sizeof(pcanReceiveFilter_t));
+    rx->filterCount = count;
+    rx->loopback = loopback;
+    pcanMutexUnlock(&(rx->sinkLock));
+
+    return;
+}
@@ -0,0 +1,184 @@
+/* Native receive path
+
+   Drains received messages from the PCAN-Basic receive queue on the event
+   worker thread, hands them to any attached sinks (such as a binary capture,
+   the triggers of timed transmission, the confirmation of queued writes, or
+   the matching of replies to requests), and buffers them in a ring of packed
+   frame records until JavaScript collects them in batches. JavaScript is only
+   notified when the ring goes from empty to non-empty, so a burst of frames
+   costs a single callback.
+
+   Copyright (c) 2020 Control Solutions LLC. All rights reserved.
+*/
+
+#ifndef _PCAN_RECEIVE_H_
+#define _PCAN_RECEIVE_H_
+
+#include <stdint.h>      // provide uintX_t
+
+#if defined _WIN32
+#include <windows.h>     // provide Win32 types, constants, and functions
+#include <PCANBasic.h>   // provide PCAN-Basic types, constants, and functions
+#elif defined __APPLE__
+#include <PCBUSB.h>      // provide PCAN-Basic types, constants, and functions
+#endif
+
+#include "pcan_capture.h" // provide pcanCapture_t
+#include "pcan_frame.h"  // provide pcanFrame_t
+#include "pcan_request.h" // provide pcanRequest_t
+#include "pcan_timed.h"  // provide pcanTimed_t
+#include "pcan_transmit.h" // provide pcanTransmit_t
+#include "pcan_thread.h" // provide pcanMutex_t
+
+
+//#define PCAN_RECEIVE_DEBUG
+// Uncomment to enable debugging messages, which may affect timing or
+// performance
+
+// ----------------------------------- // -----------------------------------
+// Definitions
+
+// Default number of frames held in the receive ring
+#define PCAN_RECEIVE_RING_DEFAULT (16384)
+
+// Number of messages read from PCAN-Basic before they are handed to sinks
+#define PCAN_RECEIVE_DRAIN_BATCH (64)
+
+// Maximum number of receive filters on a channel
+#define PCAN_RECEIVE_FILTERS_MAX (32)
+
+// Acceptance filter applied to frames on their way to the ring. A data frame
+// passes if it is extended when ext is set (standard otherwise), its
+// identifier is within fromId to toId, and it equals code in the bits clear
+// in mask. As with the adapter's acceptance mask, a set bit means "don't
+// care", so a mask of all ones accepts any code.
+typedef struct pcanReceiveFilter_s
+{
+    uint32_t fromId;
+    uint32_t toId;
+    uint32_t code;
+    uint32_t mask;
+    int ext;
+} pcanReceiveFilter_t;
+
+// Receive path state for one channel
+typedef struct pcanReceive_s
+{
+    TPCANHandle channel;
+    int initialized;
+
+    // Nonzero if the channel was initialized for CAN FD, in which case
+    // messages are read with CAN_ReadFD and the ring holds pcanFrameFD_t
+    // records, while sinks are given the first 8 bytes of each as a
+    // pcanFrame_t
+    int fd;
+    uint32_t recordSize;   // PCAN_FRAME_SIZE or PCAN_FRAME_FD_SIZE
+
+    // Frames waiting to be collected by JavaScript
+    pcanMutex_t ringLock;
+    uint8_t *ring;
+    uint32_t ringCapacity;
+    uint32_t ringHead;     // Index of the oldest frame
+    uint32_t ringCount;
+    uint64_t ringOverruns; // Frames discarded because the ring was full
+    int notifyPending;     // JavaScript has been notified but not emptied the ring
+
+    // Sinks that see every frame, regardless of the ring
+    pcanMutex_t sinkLock;
+    pcanCapture_t *capture;
+    int passthrough;       // Nonzero to also deliver captured frames to the ring
+    pcanTimed_t *timed;    // Checks frames against transmit triggers
+    pcanTransmit_t *transmit; // Confirms queued writes by their echoes
+    pcanRequest_t *request; // Matches frames against replies to requests
+
+    // Stage between the driver and the ring: frames that pass none of the
+    // filters (if there are any) are not delivered, and echoes of frames
+    // sent by this host are delivered only if they are looped back
+    pcanReceiveFilter_t filters[PCAN_RECEIVE_FILTERS_MAX];
+    uint32_t filterCount;
+    int loopback;
+
+    TPCANStatus lastStatus; // Last status returned by CAN_Read
+} pcanReceive_t;
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Global variables
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local variables
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local functions
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Public functions
+
+// Prepare the receive path for a channel, with a ring of the given number of
+// frames (0 for the default). If fd is nonzero, the channel was initialized
+// for CAN FD.
+// Returns 0 on success, or 1 on failure
+int pcanReceiveInit(pcanReceive_t *rx, TPCANHandle channel, uint32_t capacity, int fd);
+
+// Release the receive ring. Any attached capture must already be detached.
+void pcanReceiveFree(pcanReceive_t *rx);
+
+// Read all messages waiting in the PCAN-Basic receive queue. Called from the
+// event worker thread. Echo frames go to the capture, but not to the triggers
+// or the requests, and only go to the ring if loopback is set. Only frames
+// that pass the filters go to the ring.
+// Returns nonzero if JavaScript should be notified that frames are available
+int pcanReceiveDrain(pcanReceive_t *rx);
+
+// Move up to max of the oldest frames out of the ring, as records of
+// rx->recordSize bytes
+// Returns the number of frames copied
+uint32_t pcanReceivePop(pcanReceive_t *rx, void *records, uint32_t max);
+
+// Return the number of frames waiting in the ring
+uint32_t pcanReceivePending(pcanReceive_t *rx);
+
+// Attach a capture that will be given every drained frame. If passthrough is
+// zero, frames are no longer delivered to the ring while it is attached.
+void pcanReceiveAttachCapture(pcanReceive_t *rx, pcanCapture_t *capture, int passthrough);
+
+// Detach the capture, if any
+// Returns the capture that was attached, or 0
+pcanCapture_t *pcanReceiveDetachCapture(pcanReceive_t *rx);
+
+// Attach timed transmission, whose triggers are checked against every
+// drained frame, or detach it if timed is 0. Once this returns, a detached
+// timed transmission is no longer used.
+void pcanReceiveAttachTimed(pcanReceive_t *rx, pcanTimed_t *timed);
+
+// Attach a transmit queue, which is given every drained frame so that it can
+// confirm its writes by their echoes, or detach it if transmit is 0. Once
+// this returns, a detached queue is no longer used.
+void pcanReceiveAttachTransmit(pcanReceive_t *rx, pcanTransmit_t *transmit);
+
+// Attach request/response matching, which is given every drained frame that
+// was not transmitted by this host, or detach it if request is 0. Once this
+// returns, detached matching is no longer used.
+void pcanReceiveAttachRequest(pcanReceive_t *rx, pcanRequest_t *request);
+
+// Set the filters applied to frames on their way to the ring (none to
+// deliver every frame), and whether echoes of frames sent by this host are
+// delivered to the ring, in order with received frames
+void pcanReceiveConfigure(pcanReceive_t *rx, const pcanReceiveFilter_t *filters,
+                          uint32_t count, int loopback);
+
+
+
+
+#endif // _PCAN_RECEIVE_H_
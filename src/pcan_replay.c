@@ -0,0 +1,558 @@
+/* Timing-accurate replay of captured traffic
+
+   Writes frames from a native capture or PEAK trace file to a channel on a
+   dedicated thread, at absolute deadlines derived from their recorded
+   timestamps.
+
+   Copyright (c) 2020 Control Solutions LLC. All rights reserved.
+*/
+
+#include <stdio.h>       // provide printf
+#include <stdlib.h>      // provide calloc, malloc, free, qsort, and bsearch
+#include <string.h>      // provide memcpy, memset, and strlen
+
+#include "pcan_replay.h"
+
+
+// ----------------------------------- // -----------------------------------
+// Definitions
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Global variables
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local variables
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local functions
+
+
+static int replayCompareIds(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+
+    return (x < y) ? -1 : (x > y) ? 1 : 0;
+}
+
+
+
+
+// Close the file and free a replay that has no thread running
+static void replayFree(pcanReplay_t *replay)
+{
+    if (replay->query != 0)
+    {
+        pcanReaderQueryFree(replay->query);
+    }
+    if (replay->reader != 0)
+    {
+        pcanReaderRelease(replay->reader);
+    }
+    if (replay->trc != 0)
+    {
+        pcanTrcClose(replay->trc);
+    }
+
+    free(replay->records);
+    free(replay->frames);
+    free(replay->ids);
+    free(replay);
+
+    return;
+}
+
+
+
+
+// Start reading the file from the beginning
+// Returns 0 on success, or 1 on failure (with a reason in *error)
+static int replayOpen(pcanReplay_t *replay, const char **error)
+{
+    if (replay->options.source == PCAN_REPLAY_SOURCE_TRC)
+    {
+        if (replay->trc != 0)
+        {
+            pcanTrcClose(replay->trc);
+        }
+        replay->trc = pcanTrcOpen(replay->path, error);
+
+        return (replay->trc == 0) ? 1 : 0;
+    }
+
+    // The index selects the blocks holding the requested IDs, so the query
+    // does the filtering for native captures
+    if (replay->reader == 0)
+    {
+        replay->reader = pcanReaderOpen(replay->path, PCAN_READER_INDEX_MEMORY, error);
+        if (replay->reader == 0)
+        {
+            return 1;
+        }
+
+        replay->records = malloc((size_t)PCAN_REPLAY_BATCH * replay->reader->recordSize);
+        if (replay->records == 0)
+        {
+            *error = "Error allocating memory for replay.";
+            return 1;
+        }
+    }
+
+    if (replay->query != 0)
+    {
+        pcanReaderQueryFree(replay->query);
+    }
+    replay->query = pcanReaderQueryStart(replay->reader, replay->ids,
+                                         replay->options.idCount, 0, UINT64_MAX);
+    if (replay->query == 0)
+    {
+        *error = "Error allocating memory for replay.";
+        return 1;
+    }
+
+    return 0;
+}
+
+
+
+
+// Return nonzero if a frame read from the file should be written
+static int replayWanted(const pcanReplay_t *replay, const pcanFrame_t *frame)
+{
+    if (frame->msgtype & (PCAN_MESSAGE_STATUS | PCAN_MESSAGE_ERRFRAME))
+    {
+        return 0;
+    }
+
+    if ((replay->options.source == PCAN_REPLAY_SOURCE_TRC) && (replay->ids != 0) &&
+        (bsearch(&(frame->id), replay->ids, replay->options.idCount,
+                 sizeof(uint32_t), replayCompareIds) == 0))
+    {
+        return 0;
+    }
+
+    return 1;
+}
+
+
+
+
+// Read the next batch of frames to write
+// Returns the number of frames, which is 0 at the end of the file
+static uint32_t replayFill(pcanReplay_t *replay)
+{
+    uint32_t recordSize = 0;
+    uint32_t count = 0;
+    uint32_t kept = 0;
+    uint32_t i;
+
+    do
+    {
+        if (replay->options.source == PCAN_REPLAY_SOURCE_TRC)
+        {
+            count = pcanTrcRead(replay->trc, replay->frames, PCAN_REPLAY_BATCH);
+        }
+        else
+        {
+            recordSize = replay->reader->recordSize;
+            if (recordSize > sizeof(pcanFrame_t))
+            {
+                recordSize = sizeof(pcanFrame_t);
+            }
+
+            count = pcanReaderQueryNext(replay->query, replay->records, PCAN_REPLAY_BATCH);
+            for (i = 0; i < count; i++)
+            {
+                memset(&(replay->frames[i]), 0, sizeof(pcanFrame_t));
+                memcpy(&(replay->frames[i]),
+                       replay->records + (size_t)i * replay->reader->recordSize, recordSize);
+            }
+        }
+
+        kept = 0;
+        for (i = 0; i < count; i++)
+        {
+            if (replayWanted(replay, &(replay->frames[i])))
+            {
+                replay->frames[kept++] = replay->frames[i];
+            }
+        }
+    } while ((count > 0) && (kept == 0));
+
+    replay->frameCount = kept;
+    replay->frameNext = 0;
+
+    return kept;
+}
+
+
+
+
+// Wait until a deadline, on the monotonic clock
+// Returns 0 at the deadline, or 1 if the replay was stopped first
+static int replayWait(pcanReplay_t *replay, uint64_t deadline)
+{
+    uint64_t now = pcanTimeMicros();
+    int stopping = 0;
+
+    // Long gaps are spent on the condition variable, which stop can signal
+    while (deadline > now + PCAN_REPLAY_COARSE_US)
+    {
+        pcanMutexLock(&(replay->lock));
+        if (!replay->stop)
+        {
+            pcanCondTimedWait(&(replay->wake), &(replay->lock),
+                              deadline - now - PCAN_REPLAY_COARSE_US);
+        }
+        stopping = replay->stop;
+        pcanMutexUnlock(&(replay->lock));
+
+        if (stopping)
+        {
+            return 1;
+        }
+
+        now = pcanTimeMicros();
+    }
+
+    // Then the high-resolution timer, waking early enough to spin the rest
+    if (deadline > now + replay->options.spinUs)
+    {
+        pcanTimerSleepUntil(&(replay->timer), deadline - replay->options.spinUs);
+    }
+
+    while (pcanTimeMicros() < deadline)
+    {
+    }
+
+    return 0;
+}
+
+
+
+
+// Write a frame, retrying for a while if the transmit queue is full, with a
+// short sleep between attempts so that the thread does not spin on the driver
+// Returns the final status, with the time of the last attempt in *attempt
+static TPCANStatus replayWrite(pcanReplay_t *replay, const pcanFrame_t *frame,
+                               uint64_t *attempt)
+{
+    TPCANMsg msg;
+    TPCANStatus status = PCAN_ERROR_UNKNOWN;
+    uint64_t start = pcanTimeMicros();
+
+    pcanFrameToMsg(frame, &msg);
+
+    while (1)
+    {
+        *attempt = pcanTimeMicros();
+        status = CAN_Write(replay->channel, &msg);
+
+        if ((status != PCAN_ERROR_QXMTFULL) || (*attempt - start >= PCAN_REPLAY_RETRY_US))
+        {
+            return status;
+        }
+
+        pcanTimerSleepUntil(&(replay->timer), *attempt + PCAN_REPLAY_RETRY_PAUSE_US);
+    }
+}
+
+
+
+
+// Return the lateness below which perMille of the frames were written
+static uint64_t replayPercentile(const pcanReplay_t *replay, uint32_t perMille)
+{
+    uint64_t target = (replay->stats.frames * perMille + 999) / 1000;
+    uint64_t seen = 0;
+    uint32_t i;
+
+    for (i = 0; i < PCAN_REPLAY_HISTOGRAM_US; i++)
+    {
+        seen += replay->histogram[i];
+        if (seen >= target)
+        {
+            return i;
+        }
+    }
+
+    return replay->stats.maxLateUs;
+}
+
+
+
+
+// Copy the statistics, with the lateness summary. The lock must be held.
+static void replayCopyStats(const pcanReplay_t *replay, pcanReplayStats_t *stats)
+{
+    *stats = replay->stats;
+
+    if (replay->stats.frames > 0)
+    {
+        stats->meanLateUs = replay->lateSumUs / replay->stats.frames;
+        stats->p50LateUs = replayPercentile(replay, 500);
+        stats->p99LateUs = replayPercentile(replay, 990);
+        stats->p999LateUs = replayPercentile(replay, 999);
+    }
+
+    return;
+}
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Public functions
+
+
+void pcanReplayThreadProc(void *arg)
+{
+    pcanReplay_t *replay = (pcanReplay_t*)arg;
+    const pcanFrame_t *frame = 0;
+    const char *error = 0;
+    uint64_t passBase = 0;
+    uint64_t passFirst = 0;
+    uint64_t deadline = 0;
+    uint64_t target = 0;
+    uint64_t attempt = 0;
+    uint64_t late = 0;
+    int passStarted = 0;
+    int stopping = 0;
+    int readError = 0;
+    TPCANStatus status = PCAN_ERROR_UNKNOWN;
+
+#ifdef PCAN_REPLAY_DEBUG
+    printf("pcanReplayThreadProc: Starting thread\n");
+#endif
+
+    while (!stopping)
+    {
+        if ((replay->frameNext == replay->frameCount) && (replayFill(replay) == 0))
+        {
+            // End of a pass. Stop after the last one, or if the file has
+            // nothing to replay at all.
+            pcanMutexLock(&(replay->lock));
+            if (passStarted)
+            {
+                replay->stats.loops++;
+            }
+            stopping = !passStarted || ((replay->options.loops != 0) &&
+                                        (replay->stats.loops >= replay->options.loops));
+            pcanMutexUnlock(&(replay->lock));
+
+            if (!stopping && (replayOpen(replay, &error) != 0))
+            {
+                printf("pcanReplayThreadProc: Error reopening \"%s\": %s\n", replay->path, error);
+                readError = 1;
+                stopping = 1;
+            }
+
+            // The next pass starts where the last one ended
+            passStarted = 0;
+            continue;
+        }
+
+        frame = &(replay->frames[replay->frameNext++]);
+
+        if (!passStarted)
+        {
+            passFirst = frame->timestamp;
+            passBase = (deadline != 0) ? deadline : pcanTimeMicros();
+            passStarted = 1;
+        }
+
+        // Deadlines never go backwards, even if the file's timestamps do
+        if (frame->timestamp > passFirst)
+        {
+            target = passBase + (uint64_t)((double)(frame->timestamp - passFirst) /
+                                           replay->options.speed);
+            deadline = (target > deadline) ? target : deadline;
+        }
+        else if (deadline < passBase)
+        {
+            deadline = passBase;
+        }
+
+        if (replayWait(replay, deadline) != 0)
+        {
+            break;
+        }
+
+        status = replayWrite(replay, frame, &attempt);
+        late = (attempt > deadline) ? (attempt - deadline) : 0;
+
+        pcanMutexLock(&(replay->lock));
+        if (status == PCAN_ERROR_OK)
+        {
+            replay->stats.frames++;
+            replay->lateSumUs += late;
+            replay->histogram[(late < PCAN_REPLAY_HISTOGRAM_US) ? late : PCAN_REPLAY_HISTOGRAM_US]++;
+            if (late > replay->stats.maxLateUs)
+            {
+                replay->stats.maxLateUs = late;
+            }
+            if (late > replay->options.lateUs)
+            {
+                replay->stats.late++;
+            }
+        }
+        else
+        {
+            replay->stats.errors++;
+            replay->stats.lastError = status;
+        }
+        stopping = replay->stop;
+        pcanMutexUnlock(&(replay->lock));
+    }
+
+    // Report a replay that ended by itself, rather than by pcanReplayStop
+    pcanMutexLock(&(replay->lock));
+    stopping = replay->stop;
+    replay->stats.error = readError;
+    replay->stats.finished = !stopping && !readError;
+    pcanMutexUnlock(&(replay->lock));
+
+    if (!stopping && (replay->done != 0))
+    {
+        replay->done(replay->doneContext);
+    }
+
+#ifdef PCAN_REPLAY_DEBUG
+    printf("pcanReplayThreadProc: Exiting thread\n");
+#endif
+
+    return;
+}
+
+
+
+
+pcanReplay_t *pcanReplayStart(TPCANHandle channel, const char *path,
+                              const pcanReplayOptions_t *options,
+                              pcanReplayDone_t done, void *context, const char **error)
+{
+    pcanReplay_t *replay = 0;
+
+    if (strlen(path) >= PCAN_CAPTURE_PATH_MAX)
+    {
+        *error = "Replay file path is too long.";
+        return 0;
+    }
+
+    replay = calloc(1, sizeof(*replay));
+    if (replay == 0)
+    {
+        *error = "Error allocating memory for replay.";
+        return 0;
+    }
+
+    replay->channel = channel;
+    replay->options = *options;
+    replay->done = done;
+    replay->doneContext = context;
+    strcpy(replay->path, path);
+
+    if (!(replay->options.speed > 0))
+    {
+        replay->options.speed = 1.0;
+    }
+
+    replay->frames = malloc((size_t)PCAN_REPLAY_BATCH * sizeof(pcanFrame_t));
+    if (options->idCount > 0)
+    {
+        replay->ids = malloc(options->idCount * sizeof(uint32_t));
+    }
+    if ((replay->frames == 0) || ((options->idCount > 0) && (replay->ids == 0)))
+    {
+        replayFree(replay);
+        *error = "Error allocating memory for replay.";
+        return 0;
+    }
+
+    if (options->idCount > 0)
+    {
+        memcpy(replay->ids, options->ids, options->idCount * sizeof(uint32_t));
+        qsort(replay->ids, options->idCount, sizeof(uint32_t), replayCompareIds);
+    }
+    replay->options.ids = replay->ids;
+
+    // Open the file here, so that a bad path is reported to the caller
+    if (replayOpen(replay, error) != 0)
+    {
+        replayFree(replay);
+        return 0;
+    }
+
+    if (pcanTimerInit(&(replay->timer)) != 0)
+    {
+        replayFree(replay);
+        *error = "Unable to create replay timer.";
+        return 0;
+    }
+
+    pcanMutexInit(&(replay->lock));
+    pcanCondInit(&(replay->wake));
+
+    if (pcanThreadCreate(&(replay->thread), pcanReplayThreadProc, replay) != 0)
+    {
+        pcanCondDestroy(&(replay->wake));
+        pcanMutexDestroy(&(replay->lock));
+        pcanTimerDestroy(&(replay->timer));
+        replayFree(replay);
+        *error = "Unable to start replay thread.";
+        return 0;
+    }
+
+#ifdef PCAN_REPLAY_DEBUG
+    printf("pcanReplayStart: \"%s\", speed = %f, loops = %u\n",
+           path, replay->options.speed, replay->options.loops);
+#endif
+
+    return replay;
+}
+
+
+
+
+void pcanReplayGetStats(pcanReplay_t *replay, pcanReplayStats_t *stats)
+{
+    pcanMutexLock(&(replay->lock));
+    replayCopyStats(replay, stats);
+    pcanMutexUnlock(&(replay->lock));
+
+    return;
+}
+
+
+
+
+void pcanReplayStop(pcanReplay_t *replay, pcanReplayStats_t *stats)
+{
+    pcanMutexLock(&(replay->lock));
+    replay->stop = 1;
+    pcanCondSignal(&(replay->wake));
+    pcanMutexUnlock(&(replay->lock));
+
+    pcanThreadJoin(replay->thread);
+
+    if (stats != 0)
+    {
+        replayCopyStats(replay, stats);
+    }
+
+    pcanCondDestroy(&(replay->wake));
+    pcanMutexDestroy(&(replay->lock));
+    pcanTimerDestroy(&(replay->timer));
+    replayFree(replay);
+
+    return;
+}
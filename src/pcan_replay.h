@@ -0,0 +1,180 @@
+/* Timing-accurate replay of captured traffic
+
+   Reads frames from a native capture or PEAK trace file and writes them to a
+   channel on a dedicated thread, reproducing the recorded inter-frame timing.
+   Every frame has an absolute deadline, computed from the start of the replay
+   and its recorded offset (divided by the speed factor), so that errors never
+   accumulate from frame to frame. The thread waits on a condition variable
+   for most of a long gap, sleeps on a high-resolution timer for the rest, and
+   spins for the last spinUs before writing. How late each frame was written
+   is collected into a histogram, from which the lateness statistics are
+   reported.
+
+   Copyright (c) 2020 Control Solutions LLC. All rights reserved.
+*/
+
+#ifndef _PCAN_REPLAY_H_
+#define _PCAN_REPLAY_H_
+
+#include <stdint.h>      // provide uintX_t
+
+#if defined _WIN32
+#include <windows.h>     // provide Win32 types, constants, and functions
+#include <PCANBasic.h>   // provide PCAN-Basic types, constants, and functions
+#elif defined __APPLE__
+#include <PCBUSB.h>      // provide PCAN-Basic types, constants, and functions
+#endif
+
+#include "pcan_frame.h"  // provide pcanFrame_t
+#include "pcan_reader.h" // provide pcanReader_t and pcanReaderQuery_t
+#include "pcan_thread.h" // provide pcanThread_t, pcanMutex_t, pcanCond_t, and pcanTimer_t
+#include "pcan_trc.h"    // provide pcanTrcReader_t
+
+
+//#define PCAN_REPLAY_DEBUG
+// Uncomment to enable debugging messages, which may affect timing or
+// performance
+
+// ----------------------------------- // -----------------------------------
+// Definitions
+
+// Number of frames read from the file at a time
+#define PCAN_REPLAY_BATCH (4096)
+
+// Default time spent spinning before each deadline
+#define PCAN_REPLAY_SPIN_DEFAULT_US (200)
+
+// Default lateness above which a frame is counted as late
+#define PCAN_REPLAY_LATE_DEFAULT_US (1000)
+
+// Gaps longer than this are mostly spent waiting on the condition variable,
+// so that the replay can be stopped; it must exceed the scheduler tick
+#define PCAN_REPLAY_COARSE_US (20000)
+
+// How long a frame is retried while the transmit queue is full, and the pause
+// between attempts, about the time a classic frame takes on a fast bus
+#define PCAN_REPLAY_RETRY_US (20000)
+#define PCAN_REPLAY_RETRY_PAUSE_US (100)
+
+// Lateness histogram resolution (1 us buckets) and range; later frames share
+// the last bucket
+#define PCAN_REPLAY_HISTOGRAM_US (10000)
+
+// Files that can be replayed
+typedef enum pcanReplaySource_e
+{
+    PCAN_REPLAY_SOURCE_NATIVE = 0, // Binary capture, through pcan_reader.c
+    PCAN_REPLAY_SOURCE_TRC,        // PEAK trace file, through pcan_trc.c
+} pcanReplaySource_t;
+
+// Replay configuration
+typedef struct pcanReplayOptions_s
+{
+    pcanReplaySource_t source;
+    double speed;          // Playback speed factor (1 = recorded timing)
+    uint32_t loops;        // Passes over the file (0 = until stopped)
+    uint64_t spinUs;       // Time spent spinning before each deadline
+    uint64_t lateUs;       // Lateness above which a frame is counted as late
+    const uint32_t *ids;   // IDs to replay, or 0 to replay all
+    uint32_t idCount;
+} pcanReplayOptions_t;
+
+// Replay statistics. Lateness is the time from a frame's deadline until it
+// was accepted by CAN_Write.
+typedef struct pcanReplayStats_s
+{
+    uint64_t frames;       // Frames written
+    uint64_t errors;       // Frames CAN_Write did not accept
+    uint64_t late;         // Frames written more than lateUs late
+    uint32_t loops;        // Passes completed
+    uint64_t meanLateUs;
+    uint64_t maxLateUs;
+    uint64_t p50LateUs;    // Percentiles, up to PCAN_REPLAY_HISTOGRAM_US
+    uint64_t p99LateUs;
+    uint64_t p999LateUs;
+    TPCANStatus lastError; // Last status other than PCAN_ERROR_OK
+    int finished;          // The replay ran to its end, rather than being stopped
+    int error;             // The file could not be read
+} pcanReplayStats_t;
+
+// Called on the replay thread when the replay runs to its end
+typedef void (*pcanReplayDone_t)(void *context);
+
+// Replay state, created by pcanReplayStart
+typedef struct pcanReplay_s
+{
+    pcanMutex_t lock;
+    pcanCond_t wake;
+    pcanThread_t thread;
+    pcanTimer_t timer;
+
+    TPCANHandle channel;
+    pcanReplayOptions_t options;
+    uint32_t *ids;         // Sorted copy of options.ids
+    char path[PCAN_CAPTURE_PATH_MAX];
+    pcanReplayDone_t done;
+    void *doneContext;
+
+    // File, used only by the replay thread once started
+    pcanReader_t *reader;
+    pcanReaderQuery_t *query;
+    uint8_t *records;
+    pcanTrcReader_t *trc;
+
+    // Batch of frames being replayed, used only by the replay thread
+    pcanFrame_t *frames;
+    uint32_t frameCount;
+    uint32_t frameNext;
+
+    // Shared with the calling thread under lock
+    int stop;
+    pcanReplayStats_t stats;
+    uint64_t lateSumUs;
+    uint32_t histogram[PCAN_REPLAY_HISTOGRAM_US + 1];
+} pcanReplay_t;
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Global variables
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local variables
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local functions
+
+// Replay thread process, started by pcanReplayStart
+void pcanReplayThreadProc(void *arg);
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Public functions
+
+// Open a file and start replaying it to a channel. done(context) is called on
+// the replay thread if the replay runs to its end; it may be 0.
+// Returns the new replay, or 0 on failure (with a reason in *error)
+pcanReplay_t *pcanReplayStart(TPCANHandle channel, const char *path,
+                              const pcanReplayOptions_t *options,
+                              pcanReplayDone_t done, void *context, const char **error);
+
+// Copy the current statistics
+void pcanReplayGetStats(pcanReplay_t *replay, pcanReplayStats_t *stats);
+
+// Stop the replay if it is still running, wait for the thread to exit, and
+// free the replay. The final statistics are copied to stats if it is not 0.
+void pcanReplayStop(pcanReplay_t *replay, pcanReplayStats_t *stats);
+
+
+
+
+#endif // _PCAN_REPLAY_H_
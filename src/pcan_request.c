@@ -0,0 +1,328 @@
+/* Native request/response matching
+
+   Writes request frames and matches received frames against the replies they
+   are waiting for, on the receive worker thread, recording each reply with
+   its round-trip time.
+
+   Copyright (c) 2020 Control Solutions LLC. All rights reserved.
+*/
+
+#include <stdio.h>       // provide printf
+#include <stdlib.h>      // provide calloc and free
+#include <string.h>      // provide memcmp, memcpy and memset
+
+#include "pcan_request.h"
+
+
+// ----------------------------------- // -----------------------------------
+// Definitions
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Global variables
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local variables
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local functions
+
+
+// Return the entry for a handle, or 0 if there is none. The lock must be held.
+static pcanRequestEntry_t *requestFind(pcanRequest_t *request, uint32_t id)
+{
+    uint32_t i;
+
+    if (id == 0)
+    {
+        return 0;
+    }
+
+    for (i = 0; i < PCAN_REQUEST_MAX; i++)
+    {
+        if (request->entries[i].id == id)
+        {
+            return &(request->entries[i]);
+        }
+    }
+
+    return 0;
+}
+
+
+
+
+// Return nonzero if a frame answers a request
+static int requestMatches(const pcanRequestEntry_t *entry, const pcanFrame_t *frame, int ext)
+{
+    if ((entry->id == 0) || (entry->matchExt != ext) ||
+        ((frame->id & entry->matchMask) != entry->matchId))
+    {
+        return 0;
+    }
+
+    if ((entry->prefixLen > frame->len) ||
+        (memcmp(entry->prefix, frame->data, entry->prefixLen) != 0))
+    {
+        return 0;
+    }
+
+    return 1;
+}
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Public functions
+
+
+pcanRequest_t *pcanRequestStart(TPCANHandle channel, pcanRequestNotify_t notify, void *context,
+                                const char **error)
+{
+    pcanRequest_t *request = 0;
+
+    request = calloc(1, sizeof(*request));
+    if (request == 0)
+    {
+        *error = "Error allocating memory for requests.";
+        return 0;
+    }
+
+    request->channel = channel;
+    request->notify = notify;
+    request->notifyContext = context;
+    request->nextId = 1;
+
+    pcanMutexInit(&(request->lock));
+
+#ifdef PCAN_REQUEST_DEBUG
+    printf("pcanRequestStart: Channel 0x%02X\n", channel);
+#endif
+
+    return request;
+}
+
+
+
+
+uint32_t pcanRequestSend(pcanRequest_t *request, const pcanFrame_t *frame, uint32_t matchId,
+                         uint32_t matchMask, int matchExt, const uint8_t *prefix,
+                         uint8_t prefixLen, TPCANStatus *status)
+{
+    pcanRequestEntry_t *entry = 0;
+    TPCANMsg msg;
+    uint32_t id = 0;
+    uint32_t i;
+
+    *status = PCAN_ERROR_OK;
+
+    if (prefixLen > PCAN_FRAME_DATA_MAX)
+    {
+        prefixLen = PCAN_FRAME_DATA_MAX;
+    }
+
+    pcanMutexLock(&(request->lock));
+
+    if (request->resultCount + request->pending < PCAN_REQUEST_MAX)
+    {
+        for (i = 0; (i < PCAN_REQUEST_MAX) && (entry == 0); i++)
+        {
+            if (request->entries[i].id == 0)
+            {
+                entry = &(request->entries[i]);
+            }
+        }
+    }
+
+    if (entry == 0)
+    {
+        pcanMutexUnlock(&(request->lock));
+        return 0;
+    }
+
+    // The matcher goes in before the request is written, since the reply can
+    // be drained by the receive worker before CAN_Write returns
+    memset(entry, 0, sizeof(*entry));
+    entry->matchId = matchId & matchMask;
+    entry->matchMask = matchMask;
+    entry->matchExt = matchExt;
+    memcpy(entry->prefix, prefix, prefixLen);
+    entry->prefixLen = prefixLen;
+    entry->sentAt = pcanTimeMicros();
+
+    entry->id = request->nextId++;
+    if (request->nextId == 0)
+    {
+        request->nextId = 1;
+    }
+    id = entry->id;
+    request->pending++;
+
+    pcanMutexUnlock(&(request->lock));
+
+    pcanFrameToMsg(frame, &msg);
+    *status = CAN_Write(request->channel, &msg);
+
+    if (*status != PCAN_ERROR_OK)
+    {
+        // Withdraw the matcher. If a frame matched it in the meantime, the
+        // result carries a handle JavaScript never saw, and is ignored.
+        pcanRequestCancel(request, id);
+        id = 0;
+    }
+
+#ifdef PCAN_REQUEST_DEBUG
+    printf("pcanRequestSend: %u: 0x%03X awaiting 0x%X/0x%X, 0x%02X\n", id, frame->id,
+           matchId, matchMask, *status);
+#endif
+
+    return id;
+}
+
+
+
+
+int pcanRequestCancel(pcanRequest_t *request, uint32_t id)
+{
+    pcanRequestEntry_t *entry;
+
+    pcanMutexLock(&(request->lock));
+
+    entry = requestFind(request, id);
+    if (entry != 0)
+    {
+        entry->id = 0;
+        request->pending--;
+    }
+
+    pcanMutexUnlock(&(request->lock));
+
+    return (entry == 0) ? 1 : 0;
+}
+
+
+
+
+void pcanRequestMatch(pcanRequest_t *request, const pcanFrame_t *frames,
+                      const uint64_t *hostTimes, uint32_t count)
+{
+    pcanRequestEntry_t *entry;
+    pcanRequestEntry_t *oldest;
+    pcanRequestResult_t *result;
+    uint32_t i;
+    uint32_t j;
+    int ext;
+    int notify = 0;
+
+    pcanMutexLock(&(request->lock));
+
+    for (i = 0; (i < count) && (request->pending > 0); i++)
+    {
+        if (frames[i].msgtype & (PCAN_MESSAGE_STATUS | PCAN_MESSAGE_ERRFRAME))
+        {
+            continue;
+        }
+
+        ext = (frames[i].msgtype & PCAN_MESSAGE_EXTENDED) ? 1 : 0;
+
+        // Replies come back in order, so the oldest matching request wins
+        oldest = 0;
+        for (j = 0; j < PCAN_REQUEST_MAX; j++)
+        {
+            entry = &(request->entries[j]);
+            if (requestMatches(entry, &(frames[i]), ext) &&
+                ((oldest == 0) || (entry->sentAt < oldest->sentAt)))
+            {
+                oldest = entry;
+            }
+        }
+
+        if (oldest == 0)
+        {
+            continue;
+        }
+
+        result = &(request->results[(request->resultHead + request->resultCount) % PCAN_REQUEST_MAX]);
+        result->id = oldest->id;
+        result->reserved = 0;
+        result->rttUs = (hostTimes[i] > oldest->sentAt) ? hostTimes[i] - oldest->sentAt : 0;
+        memcpy(&(result->reply), &(frames[i]), sizeof(pcanFrame_t));
+        request->resultCount++;
+
+#ifdef PCAN_REQUEST_DEBUG
+        printf("pcanRequestMatch: %u: 0x%03X after %llu us\n", oldest->id, frames[i].id,
+               (unsigned long long)result->rttUs);
+#endif
+
+        oldest->id = 0;
+        request->pending--;
+
+        if (!request->notifyPending)
+        {
+            request->notifyPending = 1;
+            notify = 1;
+        }
+    }
+
+    pcanMutexUnlock(&(request->lock));
+
+    if (notify && (request->notify != 0))
+    {
+        request->notify(request->notifyContext);
+    }
+
+    return;
+}
+
+
+
+
+uint32_t pcanRequestResults(pcanRequest_t *request, pcanRequestResult_t *results, uint32_t max)
+{
+    uint32_t count = 0;
+
+    pcanMutexLock(&(request->lock));
+
+    while ((count < max) && (request->resultCount > 0))
+    {
+        memcpy(&(results[count]), &(request->results[request->resultHead]),
+               sizeof(pcanRequestResult_t));
+        request->resultHead = (request->resultHead + 1) % PCAN_REQUEST_MAX;
+        request->resultCount--;
+        count++;
+    }
+
+    // Once the ring is empty, the next reply notifies JavaScript again
+    if (request->resultCount == 0)
+    {
+        request->notifyPending = 0;
+    }
+
+    pcanMutexUnlock(&(request->lock));
+
+    return count;
+}
+
+
+
+
+void pcanRequestStop(pcanRequest_t *request)
+{
+#ifdef PCAN_REQUEST_DEBUG
+    printf("pcanRequestStop: %u pending discarded\n", request->pending);
+#endif
+
+    pcanMutexDestroy(&(request->lock));
+    free(request);
+
+    return;
+}
@@ -0,0 +1,161 @@
+/* Native request/response matching
+
+   Writes a request frame and waits for the frame that answers it, without a
+   JavaScript listener per transaction. A matcher for the reply is registered
+   before the request is written, so that a fast reply cannot be missed, and
+   received frames are checked against the matchers on the receive worker
+   thread as they are drained from the driver. Each reply is recorded, along
+   with the round-trip time measured on the host's monotonic clock, in a ring
+   of results that JavaScript collects in batches.
+
+   Copyright (c) 2020 Control Solutions LLC. All rights reserved.
+*/
+
+#ifndef _PCAN_REQUEST_H_
+#define _PCAN_REQUEST_H_
+
+#include <stdint.h>      // provide uintX_t
+
+#if defined _WIN32
+#include <windows.h>     // provide Win32 types, constants, and functions
+#include <PCANBasic.h>   // provide PCAN-Basic types, constants, and functions
+#elif defined __APPLE__
+#include <PCBUSB.h>      // provide PCAN-Basic types, constants, and functions
+#endif
+
+#include "pcan_frame.h"  // provide pcanFrame_t
+#include "pcan_thread.h" // provide pcanMutex_t and pcanTimeMicros
+
+
+//#define PCAN_REQUEST_DEBUG
+// Uncomment to enable debugging messages, which may affect timing or
+// performance
+
+// ----------------------------------- // -----------------------------------
+// Definitions
+
+// Maximum number of requests waiting for replies on a channel
+#define PCAN_REQUEST_MAX (64)
+
+// Size of a packed result record, in bytes
+#define PCAN_REQUEST_RESULT_SIZE (40)
+
+// Reply to a request. The layout is identical in memory and in Buffers handed
+// to JavaScript:
+//   offset  0  uint32  handle returned by pcanRequestSend
+//   offset  4  uint32  reserved (0)
+//   offset  8  uint64  microseconds from just before the request was written
+//                      to the reply being read from the driver
+//   offset 16  pcanFrame_t  the reply
+typedef struct pcanRequestResult_s
+{
+    uint32_t id;
+    uint32_t reserved;
+    uint64_t rttUs;
+    pcanFrame_t reply;
+} pcanRequestResult_t;
+
+// Compile-time check that the compiler did not pad the record
+typedef char pcanRequestResultSizeCheck_t[(sizeof(pcanRequestResult_t) == PCAN_REQUEST_RESULT_SIZE) ? 1 : -1];
+
+// Request waiting for its reply: the first received frame whose identifier
+// matches matchId in the bits set in matchMask, whose format is extended if
+// matchExt is set, and whose data starts with the prefix
+typedef struct pcanRequestEntry_s
+{
+    uint32_t id;           // Handle, or 0 if the entry is free
+    uint32_t matchId;
+    uint32_t matchMask;
+    int matchExt;
+    uint8_t prefix[PCAN_FRAME_DATA_MAX];
+    uint8_t prefixLen;
+    uint64_t sentAt;       // pcanTimeMicros time just before the request was written
+} pcanRequestEntry_t;
+
+// Called on the receive worker thread when results become available
+typedef void (*pcanRequestNotify_t)(void *context);
+
+// Request/response state for one channel
+typedef struct pcanRequest_s
+{
+    pcanMutex_t lock;
+
+    TPCANHandle channel;
+    pcanRequestNotify_t notify;
+    void *notifyContext;
+    uint32_t nextId;
+
+    pcanRequestEntry_t entries[PCAN_REQUEST_MAX];
+    uint32_t pending;      // Entries waiting for replies
+
+    // Results waiting to be collected by JavaScript. An entry is only taken
+    // while there is room for its result as well as those of every entry in
+    // use.
+    pcanRequestResult_t results[PCAN_REQUEST_MAX];
+    uint32_t resultHead;
+    uint32_t resultCount;
+    int notifyPending;     // JavaScript has been notified but not emptied the ring
+} pcanRequest_t;
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Global variables
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local variables
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local functions
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Public functions
+
+// Create the request/response state for a channel. notify(context) is called
+// on the receive worker thread when replies become available.
+// Returns the new state, or 0 on failure (with a reason in *error)
+pcanRequest_t *pcanRequestStart(TPCANHandle channel, pcanRequestNotify_t notify, void *context,
+                                const char **error);
+
+// Register a matcher for the reply (see pcanRequestEntry_t), then write the
+// request frame with CAN_Write, whose status is put in *status. If the write
+// fails, the matcher is removed again.
+// Returns a handle for the request, or 0 if too many are waiting or the write
+// failed
+uint32_t pcanRequestSend(pcanRequest_t *request, const pcanFrame_t *frame, uint32_t matchId,
+                         uint32_t matchMask, int matchExt, const uint8_t *prefix,
+                         uint8_t prefixLen, TPCANStatus *status);
+
+// Stop waiting for the reply to a request
+// Returns 0 on success, or 1 if there is no such request, or its reply has
+// already been recorded
+int pcanRequestCancel(pcanRequest_t *request, uint32_t id);
+
+// Check received frames against the requests waiting for replies; each frame
+// answers at most one request, the oldest it matches. hostTimes holds the
+// pcanTimeMicros time each frame was read from the driver. Called from the
+// receive worker thread.
+void pcanRequestMatch(pcanRequest_t *request, const pcanFrame_t *frames,
+                      const uint64_t *hostTimes, uint32_t count);
+
+// Move up to max of the oldest results out of the ring
+// Returns the number of results copied
+uint32_t pcanRequestResults(pcanRequest_t *request, pcanRequestResult_t *results, uint32_t max);
+
+// Free the state, discarding any requests still waiting
+void pcanRequestStop(pcanRequest_t *request);
+
+
+
+
+#endif // _PCAN_REQUEST_H_
@@ -0,0 +1,403 @@
+/* Portable threading and timing primitives
+
+   Thin wrappers around the Win32 and POSIX thread, mutex, condition variable,
+   and monotonic clock APIs, so that native worker threads (capture writers,
+   transmit schedulers, etc.) can be written once for both platforms.
+
+   Copyright (c) 2020 Control Solutions LLC. All rights reserved.
+*/
+
+#include <stdio.h>       // provide printf
+#include <stdlib.h>      // provide malloc and free
+
+#if defined _WIN32
+#include <windows.h>     // provide Win32 types, constants, and functions
+#elif defined __APPLE__
+#include <errno.h>       // provide ETIMEDOUT and EINTR
+#include <pthread.h>     // provide pthread functions
+#include <sys/time.h>    // provide gettimeofday
+#include <time.h>        // provide clock_gettime and nanosleep
+#endif
+
+#include "pcan_thread.h"
+
+
+// ----------------------------------- // -----------------------------------
+// Definitions
+
+// Function and argument pair handed to the platform thread entry point
+typedef struct threadStart_s
+{
+    pcanThreadFunc_t func;
+    void *arg;
+} threadStart_t;
+
+#if defined _WIN32
+// Offset between the FILETIME epoch (1601) and the Unix epoch (1970), in
+// 100 ns units
+#define FILETIME_UNIX_EPOCH (116444736000000000ULL)
+
+// Missing from older SDKs; supported from Windows 10, version 1803
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION (0x00000002)
+#endif
+#endif
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Global variables
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local variables
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local functions
+
+
+#if defined _WIN32
+static DWORD WINAPI threadStartProc(LPVOID lpParam)
+{
+    threadStart_t start = *(threadStart_t*)lpParam;
+    free(lpParam);
+
+    (start.func)(start.arg);
+
+    return 0;
+}
+
+
+#elif defined __APPLE__
+static void *threadStartProc(void *lpParam)
+{
+    threadStart_t start = *(threadStart_t*)lpParam;
+    free(lpParam);
+
+    (start.func)(start.arg);
+
+    return 0;
+}
+
+
+#endif
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Public functions
+
+
+int pcanThreadCreate(pcanThread_t *thread, pcanThreadFunc_t func, void *arg)
+{
+    threadStart_t *start = malloc(sizeof(*start));
+    if (start == 0)
+    {
+        printf("pcanThreadCreate: Error at malloc.\n");
+        return 1;
+    }
+
+    start->func = func;
+    start->arg = arg;
+
+#if defined _WIN32
+    *thread = CreateThread(0, // lpThreadAttributes
+                           0, // dwStackSize
+                           &threadStartProc, // lpStartAddress
+                           start, // lpParameter
+                           0, // dwCreationFlags
+                           0); // lpThreadId
+    if (*thread == 0)
+    {
+        printf("pcanThreadCreate: Error at CreateThread: 0x%02X\n", GetLastError());
+        free(start);
+        return 1;
+    }
+#elif defined __APPLE__
+    int ret = pthread_create(thread, NULL, &threadStartProc, start);
+    if (ret != 0)
+    {
+        printf("pcanThreadCreate: Error at pthread_create: 0x%02X\n", ret);
+        free(start);
+        return 1;
+    }
+#endif
+
+    return 0;
+}
+
+
+
+
+void pcanThreadJoin(pcanThread_t thread)
+{
+#if defined _WIN32
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+#elif defined __APPLE__
+    pthread_join(thread, NULL);
+#endif
+}
+
+
+
+
+void pcanMutexInit(pcanMutex_t *mutex)
+{
+#if defined _WIN32
+    InitializeCriticalSection(mutex);
+#elif defined __APPLE__
+    pthread_mutex_init(mutex, NULL);
+#endif
+}
+
+
+
+
+void pcanMutexDestroy(pcanMutex_t *mutex)
+{
+#if defined _WIN32
+    DeleteCriticalSection(mutex);
+#elif defined __APPLE__
+    pthread_mutex_destroy(mutex);
+#endif
+}
+
+
+
+
+void pcanMutexLock(pcanMutex_t *mutex)
+{
+#if defined _WIN32
+    EnterCriticalSection(mutex);
+#elif defined __APPLE__
+    pthread_mutex_lock(mutex);
+#endif
+}
+
+
+
+
+void pcanMutexUnlock(pcanMutex_t *mutex)
+{
+#if defined _WIN32
+    LeaveCriticalSection(mutex);
+#elif defined __APPLE__
+    pthread_mutex_unlock(mutex);
+#endif
+}
+
+
+
+
+void pcanCondInit(pcanCond_t *cond)
+{
+#if defined _WIN32
+    InitializeConditionVariable(cond);
+#elif defined __APPLE__
+    pthread_cond_init(cond, NULL);
+#endif
+}
+
+
+
+
+void pcanCondDestroy(pcanCond_t *cond)
+{
+#if defined _WIN32
+    // Win32 condition variables do not need to be destroyed
+    (void)cond;
+#elif defined __APPLE__
+    pthread_cond_destroy(cond);
+#endif
+}
+
+
+
+
+void pcanCondWait(pcanCond_t *cond, pcanMutex_t *mutex)
+{
+#if defined _WIN32
+    SleepConditionVariableCS(cond, mutex, INFINITE);
+#elif defined __APPLE__
+    pthread_cond_wait(cond, mutex);
+#endif
+}
+
+
+
+
+int pcanCondTimedWait(pcanCond_t *cond, pcanMutex_t *mutex, uint64_t timeoutUs)
+{
+#if defined _WIN32
+    // Round up, so that short waits do not turn into busy loops
+    DWORD timeoutMs = (DWORD)((timeoutUs + 999) / 1000);
+
+    if (!SleepConditionVariableCS(cond, mutex, timeoutMs))
+    {
+        return (GetLastError() == ERROR_TIMEOUT) ? 1 : 0;
+    }
+
+    return 0;
+#elif defined __APPLE__
+    // pthread_condattr_setclock is not available on macOS, so the deadline
+    // is expressed in wall clock time
+    struct timeval now;
+    gettimeofday(&now, NULL);
+
+    uint64_t deadlineUs = (uint64_t)now.tv_sec * 1000000ULL + now.tv_usec + timeoutUs;
+    struct timespec deadline;
+    deadline.tv_sec = (time_t)(deadlineUs / 1000000ULL);
+    deadline.tv_nsec = (long)((deadlineUs % 1000000ULL) * 1000);
+
+    return (pthread_cond_timedwait(cond, mutex, &deadline) == ETIMEDOUT) ? 1 : 0;
+#endif
+}
+
+
+
+
+void pcanCondSignal(pcanCond_t *cond)
+{
+#if defined _WIN32
+    WakeConditionVariable(cond);
+#elif defined __APPLE__
+    pthread_cond_signal(cond);
+#endif
+}
+
+
+
+
+void pcanCondBroadcast(pcanCond_t *cond)
+{
+#if defined _WIN32
+    WakeAllConditionVariable(cond);
+#elif defined __APPLE__
+    pthread_cond_broadcast(cond);
+#endif
+}
+
+
+
+
+int pcanTimerInit(pcanTimer_t *timer)
+{
+#if defined _WIN32
+    // Fall back to an ordinary waitable timer, which still beats Sleep
+    *timer = CreateWaitableTimerExW(0, 0, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION,
+                                    TIMER_ALL_ACCESS);
+    if (*timer == 0)
+    {
+        *timer = CreateWaitableTimerW(0, TRUE, 0);
+    }
+    if (*timer == 0)
+    {
+        printf("pcanTimerInit: Error at CreateWaitableTimer: 0x%02X\n", GetLastError());
+        return 1;
+    }
+#elif defined __APPLE__
+    *timer = 0;
+#endif
+
+    return 0;
+}
+
+
+
+
+void pcanTimerDestroy(pcanTimer_t *timer)
+{
+#if defined _WIN32
+    CloseHandle(*timer);
+#elif defined __APPLE__
+    (void)timer;
+#endif
+}
+
+
+
+
+void pcanTimerSleepUntil(pcanTimer_t *timer, uint64_t deadlineUs)
+{
+    uint64_t now = pcanTimeMicros();
+
+    if (deadlineUs <= now)
+    {
+        return;
+    }
+
+#if defined _WIN32
+    // Negative due times are relative, in 100 ns units
+    LARGE_INTEGER due;
+    due.QuadPart = -(LONGLONG)((deadlineUs - now) * 10);
+    if (SetWaitableTimer(*timer, &due, 0, 0, 0, FALSE))
+    {
+        WaitForSingleObject(*timer, INFINITE);
+    }
+#elif defined __APPLE__
+    (void)timer;
+    struct timespec remaining;
+    remaining.tv_sec = (time_t)((deadlineUs - now) / 1000000ULL);
+    remaining.tv_nsec = (long)(((deadlineUs - now) % 1000000ULL) * 1000);
+    while ((nanosleep(&remaining, &remaining) != 0) && (errno == EINTR))
+    {
+    }
+#endif
+}
+
+
+
+
+uint64_t pcanTimeMicros(void)
+{
+#if defined _WIN32
+    static LARGE_INTEGER frequency = { 0 };
+    LARGE_INTEGER counter;
+
+    if (frequency.QuadPart == 0)
+    {
+        QueryPerformanceFrequency(&frequency);
+    }
+
+    QueryPerformanceCounter(&counter);
+
+    // Split the conversion to avoid overflowing 64 bits at high frequencies
+    return (uint64_t)(counter.QuadPart / frequency.QuadPart) * 1000000ULL +
+        (uint64_t)(counter.QuadPart % frequency.QuadPart) * 1000000ULL / frequency.QuadPart;
+#elif defined __APPLE__
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000000ULL + (uint64_t)now.tv_nsec / 1000ULL;
+#endif
+}
+
+
+
+
+uint64_t pcanWallTimeMicros(void)
+{
+#if defined _WIN32
+    FILETIME now;
+    ULARGE_INTEGER ticks;
+
+    GetSystemTimeAsFileTime(&now);
+    ticks.LowPart = now.dwLowDateTime;
+    ticks.HighPart = now.dwHighDateTime;
+
+    return (ticks.QuadPart - FILETIME_UNIX_EPOCH) / 10ULL;
+#elif defined __APPLE__
+    struct timeval now;
+    gettimeofday(&now, NULL);
+
+    return (uint64_t)now.tv_sec * 1000000ULL + (uint64_t)now.tv_usec;
+#endif
+}
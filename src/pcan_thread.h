@@ -0,0 +1,107 @@
+/* Portable threading and timing primitives
+
+   Thin wrappers around the Win32 and POSIX thread, mutex, condition variable,
+   and monotonic clock APIs, so that native worker threads (capture writers,
+   transmit schedulers, etc.) can be written once for both platforms.
+
+   Copyright (c) 2020 Control Solutions LLC. All rights reserved.
+*/
+
+#ifndef _PCAN_THREAD_H_
+#define _PCAN_THREAD_H_
+
+#include <stdint.h>      // provide uintX_t
+
+#if defined _WIN32
+#include <windows.h>     // provide Win32 types, constants, and functions
+#elif defined __APPLE__
+#include <pthread.h>     // provide pthread types
+#endif
+
+
+// ----------------------------------- // -----------------------------------
+// Definitions
+
+#if defined _WIN32
+typedef HANDLE pcanThread_t;
+typedef CRITICAL_SECTION pcanMutex_t;
+typedef CONDITION_VARIABLE pcanCond_t;
+typedef HANDLE pcanTimer_t;
+#elif defined __APPLE__
+typedef pthread_t pcanThread_t;
+typedef pthread_mutex_t pcanMutex_t;
+typedef pthread_cond_t pcanCond_t;
+typedef int pcanTimer_t; // nanosleep needs no state
+#endif
+
+// Function run by a thread created with pcanThreadCreate
+typedef void (*pcanThreadFunc_t)(void *arg);
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Global variables
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local variables
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local functions
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Public functions
+
+// Start a thread that runs func(arg). Returns 0 on success, 1 on failure.
+int pcanThreadCreate(pcanThread_t *thread, pcanThreadFunc_t func, void *arg);
+
+// Wait for a thread started by pcanThreadCreate to return, and release it
+void pcanThreadJoin(pcanThread_t thread);
+
+// Mutex operations
+void pcanMutexInit(pcanMutex_t *mutex);
+void pcanMutexDestroy(pcanMutex_t *mutex);
+void pcanMutexLock(pcanMutex_t *mutex);
+void pcanMutexUnlock(pcanMutex_t *mutex);
+
+// Condition variable operations. The mutex must be held when waiting.
+void pcanCondInit(pcanCond_t *cond);
+void pcanCondDestroy(pcanCond_t *cond);
+void pcanCondWait(pcanCond_t *cond, pcanMutex_t *mutex);
+void pcanCondSignal(pcanCond_t *cond);
+void pcanCondBroadcast(pcanCond_t *cond);
+
+// Wait on a condition variable for at most timeoutUs microseconds
+// Returns 0 if signaled (or spuriously woken) and 1 on timeout
+int pcanCondTimedWait(pcanCond_t *cond, pcanMutex_t *mutex, uint64_t timeoutUs);
+
+// High-resolution timer operations, for threads that must wake close to a
+// deadline. Init returns 0 on success, 1 on failure.
+int pcanTimerInit(pcanTimer_t *timer);
+void pcanTimerDestroy(pcanTimer_t *timer);
+
+// Sleep until pcanTimeMicros() reaches deadlineUs. The sleep may end somewhat
+// late, by the timer resolution of the platform, so callers needing better
+// precision should wake early and spin.
+void pcanTimerSleepUntil(pcanTimer_t *timer, uint64_t deadlineUs);
+
+// Return a monotonic clock reading in microseconds. The epoch is arbitrary, so
+// the value is only useful for measuring intervals.
+uint64_t pcanTimeMicros(void);
+
+// Return the wall clock time in microseconds since the Unix epoch
+uint64_t pcanWallTimeMicros(void);
+
+
+
+
+#endif // _PCAN_THREAD_H_
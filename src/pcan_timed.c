@@ -0,0 +1,531 @@
+/* Native one-shot timed transmission
+
+   Writes single frames at given times, or after matching received frames,
+   from a dedicated thread, so that their timing does not depend on the
+   JavaScript event loop.
+
+   Copyright (c) 2020 Control Solutions LLC. All rights reserved.
+*/
+
+#include <stdio.h>       // provide printf
+#include <stdlib.h>      // provide calloc and free
+#include <string.h>      // provide memcpy and memset
+
+#include "pcan_timed.h"
+
+
+// ----------------------------------- // -----------------------------------
+// Definitions
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Global variables
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local variables
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local functions
+
+
+// Return the entry for a handle, or 0 if there is none. The lock must be held.
+static pcanTimedEntry_t *timedFind(pcanTimed_t *timed, uint32_t id)
+{
+    uint32_t i;
+
+    if (id == 0)
+    {
+        return 0;
+    }
+
+    for (i = 0; i < PCAN_TIMED_MAX; i++)
+    {
+        if (timed->entries[i].id == id)
+        {
+            return &(timed->entries[i]);
+        }
+    }
+
+    return 0;
+}
+
+
+
+
+// Take a free entry for a frame, if there is one and room for its result. The
+// lock must be held.
+// Returns the entry, or 0 if there is none
+static pcanTimedEntry_t *timedTake(pcanTimed_t *timed, const pcanFrame_t *frame)
+{
+    pcanTimedEntry_t *entry = 0;
+    uint32_t i;
+
+    if (timed->resultCount + timed->scheduled + timed->armed >= PCAN_TIMED_MAX * 2)
+    {
+        return 0;
+    }
+
+    for (i = 0; (i < PCAN_TIMED_MAX) && (entry == 0); i++)
+    {
+        if (timed->entries[i].id == 0)
+        {
+            entry = &(timed->entries[i]);
+        }
+    }
+
+    if (entry == 0)
+    {
+        return 0;
+    }
+
+    memset(entry, 0, sizeof(*entry));
+    memcpy(&(entry->frame), frame, sizeof(pcanFrame_t));
+
+    entry->id = timed->nextId++;
+    if (timed->nextId == 0)
+    {
+        timed->nextId = 1;
+    }
+
+    return entry;
+}
+
+
+
+
+// Give an entry a deadline, and let the thread know. The lock must be held.
+static void timedSchedule(pcanTimed_t *timed, pcanTimedEntry_t *entry, uint64_t deadline)
+{
+    entry->deadline = deadline;
+    entry->scheduled = 1;
+    timed->scheduled++;
+
+    timed->changed = 1;
+    pcanCondSignal(&(timed->wake));
+
+    return;
+}
+
+
+
+
+// Record the result of an entry, and free it. The lock must be held.
+// Returns nonzero if JavaScript should be notified
+static int timedRecord(pcanTimed_t *timed, pcanTimedEntry_t *entry, TPCANStatus status,
+                       uint64_t written)
+{
+    pcanTimedResult_t *result;
+
+    result = &(timed->results[(timed->resultHead + timed->resultCount) % (PCAN_TIMED_MAX * 2)]);
+    result->id = entry->id;
+    result->status = status;
+    result->deadline = entry->scheduled ? entry->deadline : 0;
+    result->written = written;
+    timed->resultCount++;
+
+    if (entry->scheduled)
+    {
+        timed->scheduled--;
+    }
+    else
+    {
+        timed->armed--;
+    }
+    entry->id = 0;
+    entry->scheduled = 0;
+    entry->sending = 0;
+
+    if (!timed->notifyPending)
+    {
+        timed->notifyPending = 1;
+        return 1;
+    }
+
+    return 0;
+}
+
+
+
+
+// Return the scheduled entry with the earliest deadline. There must be one,
+// and the lock must be held.
+static pcanTimedEntry_t *timedNext(pcanTimed_t *timed)
+{
+    pcanTimedEntry_t *next = 0;
+    uint32_t i;
+
+    for (i = 0; i < PCAN_TIMED_MAX; i++)
+    {
+        if ((timed->entries[i].id != 0) && timed->entries[i].scheduled &&
+            ((next == 0) || (timed->entries[i].deadline < next->deadline)))
+        {
+            next = &(timed->entries[i]);
+        }
+    }
+
+    return next;
+}
+
+
+
+
+// Wait until a deadline, on the monotonic clock. The lock must be held; it is
+// released while waiting.
+// Returns 0 at the deadline, or 1 if the schedule changed or the thread is
+// stopping first
+static int timedWait(pcanTimed_t *timed, uint64_t deadline)
+{
+    uint64_t now;
+    uint64_t wake;
+
+    while (!timed->stop && !timed->changed)
+    {
+        now = pcanTimeMicros();
+        if (now >= deadline)
+        {
+            return 0;
+        }
+
+        // Long gaps are spent on the condition variable, which changes signal
+        if (deadline > now + PCAN_TIMED_COARSE_US)
+        {
+            pcanCondTimedWait(&(timed->wake), &(timed->lock), deadline - now - PCAN_TIMED_COARSE_US);
+            continue;
+        }
+
+        // Then the high-resolution timer, in steps short enough to notice
+        // changes, waking early enough to spin the rest
+        pcanMutexUnlock(&(timed->lock));
+
+        if (deadline > now + PCAN_TIMED_SPIN_US)
+        {
+            wake = deadline - PCAN_TIMED_SPIN_US;
+            pcanTimerSleepUntil(&(timed->timer), (wake < now + PCAN_TIMED_POLL_US) ?
+                                                 wake : now + PCAN_TIMED_POLL_US);
+        }
+        else
+        {
+            while (pcanTimeMicros() < deadline)
+            {
+            }
+        }
+
+        pcanMutexLock(&(timed->lock));
+    }
+
+    return 1;
+}
+
+
+
+
+void pcanTimedThreadProc(void *arg)
+{
+    pcanTimed_t *timed = (pcanTimed_t*)arg;
+    pcanTimedEntry_t *entry;
+    pcanFrame_t frame;
+    TPCANMsg msg;
+    TPCANStatus status;
+    uint64_t attempt;
+    int notify;
+
+#ifdef PCAN_TIMED_DEBUG
+    printf("pcanTimedThreadProc: Starting thread\n");
+#endif
+
+    pcanMutexLock(&(timed->lock));
+
+    while (!timed->stop)
+    {
+        if (timed->scheduled == 0)
+        {
+            pcanCondWait(&(timed->wake), &(timed->lock));
+            continue;
+        }
+
+        timed->changed = 0;
+
+        entry = timedNext(timed);
+        if (timedWait(timed, entry->deadline) != 0)
+        {
+            continue;
+        }
+
+        // Write the frame without holding the lock; it can no longer be
+        // cancelled
+        entry->sending = 1;
+        memcpy(&frame, &(entry->frame), sizeof(frame));
+        pcanMutexUnlock(&(timed->lock));
+
+        pcanFrameToMsg(&frame, &msg);
+        attempt = pcanTimeMicros();
+        status = CAN_Write(timed->channel, &msg);
+
+        pcanMutexLock(&(timed->lock));
+
+#ifdef PCAN_TIMED_DEBUG
+        printf("pcanTimedThreadProc: 0x%03X, %lld us late, 0x%02X\n", frame.id,
+               (long long)(attempt - entry->deadline), status);
+#endif
+
+        notify = timedRecord(timed, entry, status, attempt);
+
+        if (notify && (timed->notify != 0))
+        {
+            pcanMutexUnlock(&(timed->lock));
+            timed->notify(timed->notifyContext);
+            pcanMutexLock(&(timed->lock));
+        }
+    }
+
+    pcanMutexUnlock(&(timed->lock));
+
+#ifdef PCAN_TIMED_DEBUG
+    printf("pcanTimedThreadProc: Exiting thread\n");
+#endif
+
+    return;
+}
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Public functions
+
+
+pcanTimed_t *pcanTimedStart(TPCANHandle channel, pcanTimedNotify_t notify, void *context,
+                            const char **error)
+{
+    pcanTimed_t *timed = 0;
+
+    timed = calloc(1, sizeof(*timed));
+    if (timed == 0)
+    {
+        *error = "Error allocating memory for timed transmission.";
+        return 0;
+    }
+
+    timed->channel = channel;
+    timed->notify = notify;
+    timed->notifyContext = context;
+    timed->nextId = 1;
+
+    if (pcanTimerInit(&(timed->timer)) != 0)
+    {
+        free(timed);
+        *error = "Unable to create timed transmission timer.";
+        return 0;
+    }
+
+    pcanMutexInit(&(timed->lock));
+    pcanCondInit(&(timed->wake));
+
+    if (pcanThreadCreate(&(timed->thread), pcanTimedThreadProc, timed) != 0)
+    {
+        pcanCondDestroy(&(timed->wake));
+        pcanMutexDestroy(&(timed->lock));
+        pcanTimerDestroy(&(timed->timer));
+        free(timed);
+        *error = "Unable to start timed transmission thread.";
+        return 0;
+    }
+
+#ifdef PCAN_TIMED_DEBUG
+    printf("pcanTimedStart: Channel 0x%02X\n", channel);
+#endif
+
+    return timed;
+}
+
+
+
+
+uint32_t pcanTimedAt(pcanTimed_t *timed, const pcanFrame_t *frame, uint64_t deadlineUs)
+{
+    pcanTimedEntry_t *entry;
+    uint32_t id = 0;
+
+    pcanMutexLock(&(timed->lock));
+
+    entry = timedTake(timed, frame);
+    if (entry != 0)
+    {
+        id = entry->id;
+        timedSchedule(timed, entry, deadlineUs);
+    }
+
+    pcanMutexUnlock(&(timed->lock));
+
+#ifdef PCAN_TIMED_DEBUG
+    printf("pcanTimedAt: %u: 0x%03X at %llu us\n", id, frame->id,
+           (unsigned long long)deadlineUs);
+#endif
+
+    return id;
+}
+
+
+
+
+uint32_t pcanTimedAfter(pcanTimed_t *timed, const pcanFrame_t *frame, uint32_t matchId,
+                        uint32_t matchMask, int matchExt, uint64_t delayUs)
+{
+    pcanTimedEntry_t *entry;
+    uint32_t id = 0;
+
+    pcanMutexLock(&(timed->lock));
+
+    entry = timedTake(timed, frame);
+    if (entry != 0)
+    {
+        id = entry->id;
+        entry->matchId = matchId & matchMask;
+        entry->matchMask = matchMask;
+        entry->matchExt = matchExt;
+        entry->delayUs = delayUs;
+        timed->armed++;
+    }
+
+    pcanMutexUnlock(&(timed->lock));
+
+#ifdef PCAN_TIMED_DEBUG
+    printf("pcanTimedAfter: %u: 0x%03X %llu us after 0x%X/0x%X\n", id, frame->id,
+           (unsigned long long)delayUs, matchId, matchMask);
+#endif
+
+    return id;
+}
+
+
+
+
+int pcanTimedCancel(pcanTimed_t *timed, uint32_t id)
+{
+    pcanTimedEntry_t *entry;
+    int notify = 0;
+
+    pcanMutexLock(&(timed->lock));
+
+    entry = timedFind(timed, id);
+    if ((entry != 0) && !entry->sending)
+    {
+        notify = timedRecord(timed, entry, PCAN_TIMED_STATUS_CANCELLED, 0);
+        timed->changed = 1;
+        pcanCondSignal(&(timed->wake));
+    }
+    else
+    {
+        entry = 0;
+    }
+
+    pcanMutexUnlock(&(timed->lock));
+
+    if (notify && (timed->notify != 0))
+    {
+        timed->notify(timed->notifyContext);
+    }
+
+    return (entry == 0) ? 1 : 0;
+}
+
+
+
+
+void pcanTimedTrigger(pcanTimed_t *timed, const pcanFrame_t *frames,
+                      const uint64_t *hostTimes, uint32_t count)
+{
+    pcanTimedEntry_t *entry;
+    uint32_t i;
+    uint32_t j;
+    int ext;
+
+    pcanMutexLock(&(timed->lock));
+
+    for (i = 0; (i < count) && (timed->armed > 0); i++)
+    {
+        ext = (frames[i].msgtype & PCAN_MESSAGE_EXTENDED) ? 1 : 0;
+
+        for (j = 0; j < PCAN_TIMED_MAX; j++)
+        {
+            entry = &(timed->entries[j]);
+            if ((entry->id == 0) || entry->scheduled || (entry->matchExt != ext) ||
+                ((frames[i].id & entry->matchMask) != entry->matchId))
+            {
+                continue;
+            }
+
+            timed->armed--;
+            timedSchedule(timed, entry, hostTimes[i] + entry->delayUs);
+
+#ifdef PCAN_TIMED_DEBUG
+            printf("pcanTimedTrigger: %u: 0x%03X at %llu us\n", entry->id, frames[i].id,
+                   (unsigned long long)hostTimes[i]);
+#endif
+        }
+    }
+
+    pcanMutexUnlock(&(timed->lock));
+
+    return;
+}
+
+
+
+
+uint32_t pcanTimedResults(pcanTimed_t *timed, pcanTimedResult_t *results, uint32_t max)
+{
+    uint32_t count = 0;
+
+    pcanMutexLock(&(timed->lock));
+
+    while ((count < max) && (timed->resultCount > 0))
+    {
+        memcpy(&(results[count]), &(timed->results[timed->resultHead]), sizeof(pcanTimedResult_t));
+        timed->resultHead = (timed->resultHead + 1) % (PCAN_TIMED_MAX * 2);
+        timed->resultCount--;
+        count++;
+    }
+
+    // Once the ring is empty, the next result notifies JavaScript again
+    if (timed->resultCount == 0)
+    {
+        timed->notifyPending = 0;
+    }
+
+    pcanMutexUnlock(&(timed->lock));
+
+    return count;
+}
+
+
+
+
+void pcanTimedStop(pcanTimed_t *timed)
+{
+    pcanMutexLock(&(timed->lock));
+    timed->stop = 1;
+    pcanCondSignal(&(timed->wake));
+    pcanMutexUnlock(&(timed->lock));
+
+    pcanThreadJoin(timed->thread);
+
+#ifdef PCAN_TIMED_DEBUG
+    printf("pcanTimedStop: %u scheduled, %u armed discarded\n", timed->scheduled, timed->armed);
+#endif
+
+    pcanCondDestroy(&(timed->wake));
+    pcanMutexDestroy(&(timed->lock));
+    pcanTimerDestroy(&(timed->timer));
+    free(timed);
+
+    return;
+}
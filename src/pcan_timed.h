@@ -0,0 +1,196 @@
+/* Native one-shot timed transmission
+
+   Writes single frames at given times on the host's monotonic clock, or a
+   given delay after a matching frame is received, from a dedicated thread so
+   that the timing does not depend on the JavaScript event loop. The thread
+   sleeps on a high-resolution timer until shortly before each deadline and
+   spins for the rest. Triggers are matched on the receive worker thread as
+   frames are drained from the driver, and a frame written in response never
+   passes through JavaScript. The outcome of each frame is recorded in a ring
+   of results that JavaScript collects in batches.
+
+   Copyright (c) 2020 Control Solutions LLC. All rights reserved.
+*/
+
+#ifndef _PCAN_TIMED_H_
+#define _PCAN_TIMED_H_
+
+#include <stdint.h>      // provide uintX_t
+
+#if defined _WIN32
+#include <windows.h>     // provide Win32 types, constants, and functions
+#include <PCANBasic.h>   // provide PCAN-Basic types, constants, and functions
+#elif defined __APPLE__
+#include <PCBUSB.h>      // provide PCAN-Basic types, constants, and functions
+#endif
+
+#include "pcan_frame.h"  // provide pcanFrame_t
+#include "pcan_thread.h" // provide pcanThread_t, pcanMutex_t, pcanCond_t, and pcanTimer_t
+
+
+//#define PCAN_TIMED_DEBUG
+// Uncomment to enable debugging messages, which may affect timing or
+// performance
+
+// ----------------------------------- // -----------------------------------
+// Definitions
+
+// Maximum number of frames scheduled or waiting for a trigger on a channel
+#define PCAN_TIMED_MAX (256)
+
+// Time spent spinning before each deadline
+#define PCAN_TIMED_SPIN_US (100)
+
+// Waits longer than this are spent on the condition variable, so that new
+// frames are seen at once
+#define PCAN_TIMED_COARSE_US (20000)
+
+// Shorter waits sleep in steps of at most this long, so that an earlier frame
+// added meanwhile is still seen promptly
+#define PCAN_TIMED_POLL_US (1000)
+
+// Size of a packed result record, in bytes
+#define PCAN_TIMED_RESULT_SIZE (24)
+
+// Result status of a frame cancelled before it was written; it lies outside
+// the range of TPCANStatus values
+#define PCAN_TIMED_STATUS_CANCELLED (0x80000000U)
+
+// Outcome of a timed frame. The layout is identical in memory and in Buffers
+// handed to JavaScript:
+//   offset  0  uint32  handle returned by pcanTimedAt or pcanTimedAfter
+//   offset  4  uint32  TPCANStatus returned by CAN_Write, or
+//                      PCAN_TIMED_STATUS_CANCELLED
+//   offset  8  uint64  pcanTimeMicros time the frame was due, or 0 if it was
+//                      cancelled while waiting for its trigger
+//   offset 16  uint64  pcanTimeMicros time CAN_Write was called, or 0 if the
+//                      frame was cancelled
+typedef struct pcanTimedResult_s
+{
+    uint32_t id;
+    uint32_t status;
+    uint64_t deadline;
+    uint64_t written;
+} pcanTimedResult_t;
+
+// Compile-time check that the compiler did not pad the record
+typedef char pcanTimedResultSizeCheck_t[(sizeof(pcanTimedResult_t) == PCAN_TIMED_RESULT_SIZE) ? 1 : -1];
+
+// Frame to be written once, at a deadline or after a trigger
+typedef struct pcanTimedEntry_s
+{
+    uint32_t id;           // Handle, or 0 if the entry is free
+    pcanFrame_t frame;
+    uint64_t deadline;     // pcanTimeMicros time to write it, once scheduled
+    int scheduled;         // Has a deadline, rather than waiting for a trigger
+    int sending;           // Being written by the thread
+
+    // Trigger: the first received frame whose identifier matches matchId in
+    // the bits set in matchMask, and whose format is extended if matchExt is
+    // set, schedules the entry delayUs after it was received
+    uint32_t matchId;
+    uint32_t matchMask;
+    int matchExt;
+    uint64_t delayUs;
+} pcanTimedEntry_t;
+
+// Called on the timing thread when results become available
+typedef void (*pcanTimedNotify_t)(void *context);
+
+// Timed transmission state for one channel
+typedef struct pcanTimed_s
+{
+    pcanMutex_t lock;
+    pcanCond_t wake;
+    pcanThread_t thread;
+    pcanTimer_t timer;
+
+    TPCANHandle channel;
+    pcanTimedNotify_t notify;
+    void *notifyContext;
+    uint32_t nextId;
+
+    pcanTimedEntry_t entries[PCAN_TIMED_MAX];
+    uint32_t scheduled;    // Entries with a deadline
+    uint32_t armed;        // Entries waiting for a trigger
+
+    // Results waiting to be collected by JavaScript. An entry is only taken
+    // while there is room for its result as well as those of every entry in
+    // use.
+    pcanTimedResult_t results[PCAN_TIMED_MAX * 2];
+    uint32_t resultHead;
+    uint32_t resultCount;
+    int notifyPending;     // JavaScript has been notified but not emptied the ring
+
+    int changed;           // An entry was scheduled since the thread looked
+    int stop;
+} pcanTimed_t;
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Global variables
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local variables
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local functions
+
+// Timing thread process, started by pcanTimedStart
+void pcanTimedThreadProc(void *arg);
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Public functions
+
+// Create the timed transmission state for a channel, and start its thread.
+// notify(context) is called on the timing thread, or on the thread calling
+// pcanTimedCancel, when results become available.
+// Returns the new state, or 0 on failure (with a reason in *error)
+pcanTimed_t *pcanTimedStart(TPCANHandle channel, pcanTimedNotify_t notify, void *context,
+                            const char **error);
+
+// Write a frame when pcanTimeMicros() reaches deadlineUs, or at once if it
+// already has
+// Returns a handle for the frame, or 0 if too many are waiting
+uint32_t pcanTimedAt(pcanTimed_t *timed, const pcanFrame_t *frame, uint64_t deadlineUs);
+
+// Write a frame delayUs after the next received frame that matches a trigger
+// (see pcanTimedEntry_t)
+// Returns a handle for the frame, or 0 if too many are waiting
+uint32_t pcanTimedAfter(pcanTimed_t *timed, const pcanFrame_t *frame, uint32_t matchId,
+                        uint32_t matchMask, int matchExt, uint64_t delayUs);
+
+// Cancel a frame not yet being written, recording PCAN_TIMED_STATUS_CANCELLED
+// as its result
+// Returns 0 on success, or 1 if there is no such frame or it is being written
+int pcanTimedCancel(pcanTimed_t *timed, uint32_t id);
+
+// Check received frames against the armed triggers. hostTimes holds the
+// pcanTimeMicros time each frame was read from the driver. Called from the
+// receive worker thread.
+void pcanTimedTrigger(pcanTimed_t *timed, const pcanFrame_t *frames,
+                      const uint64_t *hostTimes, uint32_t count);
+
+// Move up to max of the oldest results out of the ring
+// Returns the number of results copied
+uint32_t pcanTimedResults(pcanTimed_t *timed, pcanTimedResult_t *results, uint32_t max);
+
+// Stop the timing thread, discarding any frames still waiting, and free the
+// state
+void pcanTimedStop(pcanTimed_t *timed);
+
+
+
+
+#endif // _PCAN_TIMED_H_
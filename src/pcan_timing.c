@@ -0,0 +1,336 @@
+/* Bit timing solver
+
+   Searches the prescaler and segment lengths a CAN controller supports for
+   those that come closest to a bit rate and sample point, and formats them
+   for CAN_Initialize and CAN_InitializeFD.
+
+   Copyright (c) 2020 Control Solutions LLC. All rights reserved.
+*/
+
+#include <stdio.h>       // provide snprintf
+#include <string.h>      // provide memmove and memset
+
+#include "pcan_timing.h"
+
+
+// ----------------------------------- // -----------------------------------
+// Definitions
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Global variables
+
+// SJA1000 bus timing registers: BRP and SJW in BTR0, TSEG1 and TSEG2 in BTR1.
+// A phase segment 2 shorter than 2 time quanta leaves no time to process the
+// sampled bit.
+const pcanTimingLimits_t pcanTimingLimitsBtr = {
+    1, 64,   // brp
+    1, 16,   // tseg1
+    2, 8,    // tseg2
+    4,       // sjw
+};
+
+const pcanTimingLimits_t pcanTimingLimitsFDNominal = {
+    1, 1024, // brp
+    1, 256,  // tseg1
+    1, 128,  // tseg2
+    128,     // sjw
+};
+
+const pcanTimingLimits_t pcanTimingLimitsFDData = {
+    1, 1024, // brp
+    1, 32,   // tseg1
+    1, 16,   // tseg2
+    16,      // sjw
+};
+
+const uint32_t pcanTimingFDClocks[PCAN_TIMING_FD_CLOCKS] = {
+    80000000, 60000000, 40000000, 30000000, 24000000, 20000000
+};
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local variables
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local functions
+
+
+// Return the distance of a timing's sample point from the one asked for
+static uint32_t timingSampleDistance(const pcanTiming_t *timing, uint32_t samplePoint)
+{
+    return (timing->samplePoint > samplePoint) ? timing->samplePoint - samplePoint :
+        samplePoint - timing->samplePoint;
+}
+
+
+
+
+// Return nonzero if timing a ranks before timing b (see pcanTimingSolve)
+static int timingBetter(const pcanTiming_t *a, const pcanTiming_t *b, uint32_t samplePoint)
+{
+    uint32_t distanceA = timingSampleDistance(a, samplePoint);
+    uint32_t distanceB = timingSampleDistance(b, samplePoint);
+
+    if (a->errorPpm != b->errorPpm)
+    {
+        return a->errorPpm < b->errorPpm;
+    }
+    if (distanceA != distanceB)
+    {
+        return distanceA < distanceB;
+    }
+
+    return (a->tseg1 + a->tseg2) > (b->tseg1 + b->tseg2);
+}
+
+
+
+
+// Insert a timing into the ranked results, dropping the last one if there are
+// already max of them
+static void timingInsert(pcanTiming_t *results, uint32_t *count, uint32_t max,
+                         const pcanTiming_t *timing, uint32_t samplePoint)
+{
+    uint32_t i = *count;
+
+    while ((i > 0) && timingBetter(timing, &(results[i - 1]), samplePoint))
+    {
+        i--;
+    }
+
+    if (i >= max)
+    {
+        return;
+    }
+
+    if (*count == max)
+    {
+        (*count)--;
+    }
+    memmove(&(results[i + 1]), &(results[i]), (*count - i) * sizeof(pcanTiming_t));
+    results[i] = *timing;
+    (*count)++;
+
+    return;
+}
+
+
+
+
+// Split a bit of quanta time quanta into segments placing the sample point as
+// close as the limits allow to the one asked for
+// Returns 0 on success, or 1 if the limits allow no split
+static int timingSplit(const pcanTimingLimits_t *limits, uint32_t quanta, uint32_t samplePoint,
+                       pcanTiming_t *timing)
+{
+    uint32_t tseg1;
+    uint32_t tseg2;
+
+    // The sample point falls at the end of tseg1
+    tseg1 = (quanta * samplePoint + 500) / 1000;
+    tseg1 = (tseg1 > 1) ? tseg1 - 1 : 1;
+
+    if (tseg1 < limits->tseg1Min)
+    {
+        tseg1 = limits->tseg1Min;
+    }
+    if (tseg1 > limits->tseg1Max)
+    {
+        tseg1 = limits->tseg1Max;
+    }
+    if (tseg1 + limits->tseg2Min + 1 > quanta)
+    {
+        tseg1 = quanta - limits->tseg2Min - 1;
+    }
+
+    tseg2 = quanta - 1 - tseg1;
+    if (tseg2 > limits->tseg2Max)
+    {
+        tseg2 = limits->tseg2Max;
+        tseg1 = quanta - 1 - tseg2;
+    }
+
+    if ((tseg1 < limits->tseg1Min) || (tseg1 > limits->tseg1Max) ||
+        (tseg2 < limits->tseg2Min) || (tseg2 > limits->tseg2Max))
+    {
+        return 1;
+    }
+
+    timing->tseg1 = tseg1;
+    timing->tseg2 = tseg2;
+    timing->sjw = (tseg2 < limits->sjwMax) ? tseg2 : limits->sjwMax;
+    timing->samplePoint = ((1 + tseg1) * 1000 + quanta / 2) / quanta;
+
+    return 0;
+}
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Public functions
+
+
+uint32_t pcanTimingSolve(uint32_t clock, const pcanTimingLimits_t *limits, uint32_t bitrate,
+                         uint32_t samplePoint, pcanTiming_t *results, uint32_t max)
+{
+    pcanTiming_t timing;
+    uint32_t count = 0;
+    uint32_t quantaMin = 1 + limits->tseg1Min + limits->tseg2Min;
+    uint32_t quantaMax = 1 + limits->tseg1Max + limits->tseg2Max;
+    uint32_t brp;
+    uint32_t exact;
+    uint32_t quanta;
+    uint64_t period;
+    uint64_t deviation;
+
+    if (max > PCAN_TIMING_RESULTS_MAX)
+    {
+        max = PCAN_TIMING_RESULTS_MAX;
+    }
+    if ((bitrate == 0) || (max == 0))
+    {
+        return 0;
+    }
+
+    for (brp = limits->brpMin; brp <= limits->brpMax; brp++)
+    {
+        // Only the bit lengths either side of the exact one can be closest.
+        // Bits only get shorter as the prescaler grows.
+        exact = (uint32_t)(clock / ((uint64_t)brp * bitrate));
+        if (exact + 1 < quantaMin)
+        {
+            break;
+        }
+
+        for (quanta = exact; quanta <= exact + 1; quanta++)
+        {
+            if ((quanta < quantaMin) || (quanta > quantaMax))
+            {
+                continue;
+            }
+
+            memset(&timing, 0, sizeof(timing));
+            if (timingSplit(limits, quanta, samplePoint, &timing) != 0)
+            {
+                continue;
+            }
+
+            // Compare clock periods per bit, exactly
+            period = (uint64_t)brp * quanta * bitrate;
+            deviation = (period > clock) ? period - clock : clock - period;
+
+            timing.clock = clock;
+            timing.brp = brp;
+            timing.bitrate = (double)clock / ((double)brp * quanta);
+            timing.errorPpm = (uint32_t)((deviation * 1000000ULL + period / 2) / period);
+
+            timingInsert(results, &count, max, &timing, samplePoint);
+        }
+    }
+
+    return count;
+}
+
+
+
+
+uint32_t pcanTimingSolveFD(uint32_t clock, uint32_t nominalRate, uint32_t nominalSample,
+                           uint32_t dataRate, uint32_t dataSample, pcanTimingFD_t *results,
+                           uint32_t max)
+{
+    pcanTimingFD_t timing;
+    uint32_t count = 0;
+    uint32_t distance;
+    uint32_t i;
+    uint32_t j;
+
+    if (max > PCAN_TIMING_FD_CLOCKS)
+    {
+        max = PCAN_TIMING_FD_CLOCKS;
+    }
+
+    for (i = 0; i < PCAN_TIMING_FD_CLOCKS; i++)
+    {
+        if ((clock != 0) && (clock != pcanTimingFDClocks[i]))
+        {
+            continue;
+        }
+
+        if ((pcanTimingSolve(pcanTimingFDClocks[i], &pcanTimingLimitsFDNominal, nominalRate,
+                             nominalSample, &(timing.nominal), 1) == 0) ||
+            (pcanTimingSolve(pcanTimingFDClocks[i], &pcanTimingLimitsFDData, dataRate,
+                             dataSample, &(timing.data), 1) == 0))
+        {
+            continue;
+        }
+
+        timing.errorPpm = (timing.nominal.errorPpm > timing.data.errorPpm) ?
+            timing.nominal.errorPpm : timing.data.errorPpm;
+        distance = timingSampleDistance(&(timing.nominal), nominalSample) +
+            timingSampleDistance(&(timing.data), dataSample);
+
+        // Clocks are tried fastest first, so among equals the finest wins
+        for (j = count; j > 0; j--)
+        {
+            if ((timing.errorPpm > results[j - 1].errorPpm) ||
+                ((timing.errorPpm == results[j - 1].errorPpm) &&
+                 (distance >= timingSampleDistance(&(results[j - 1].nominal), nominalSample) +
+                  timingSampleDistance(&(results[j - 1].data), dataSample))))
+            {
+                break;
+            }
+        }
+
+        if (j >= max)
+        {
+            continue;
+        }
+        if (count == max)
+        {
+            count--;
+        }
+        memmove(&(results[j + 1]), &(results[j]), (count - j) * sizeof(pcanTimingFD_t));
+        results[j] = timing;
+        count++;
+    }
+
+    return count;
+}
+
+
+
+
+uint16_t pcanTimingBtr0Btr1(const pcanTiming_t *timing)
+{
+    // BTR0: SJW - 1 in bits 7-6, BRP - 1 in bits 5-0
+    // BTR1: single sampling in bit 7, TSEG2 - 1 in bits 6-4, TSEG1 - 1 in bits 3-0
+    uint8_t btr0 = (uint8_t)(((timing->sjw - 1) << 6) | (timing->brp - 1));
+    uint8_t btr1 = (uint8_t)(((timing->tseg2 - 1) << 4) | (timing->tseg1 - 1));
+
+    return (uint16_t)((btr0 << 8) | btr1);
+}
+
+
+
+
+int pcanTimingFDString(const pcanTimingFD_t *timing, char *buffer, size_t size)
+{
+    return snprintf(buffer, size,
+                    "f_clock_mhz=%u,"
+                    "nom_brp=%u,nom_tseg1=%u,nom_tseg2=%u,nom_sjw=%u,"
+                    "data_brp=%u,data_tseg1=%u,data_tseg2=%u,data_sjw=%u",
+                    timing->nominal.clock / 1000000,
+                    timing->nominal.brp, timing->nominal.tseg1, timing->nominal.tseg2,
+                    timing->nominal.sjw,
+                    timing->data.brp, timing->data.tseg1, timing->data.tseg2,
+                    timing->data.sjw);
+}
@@ -0,0 +1,126 @@
+/* Bit timing solver
+
+   Searches the prescaler and segment lengths a CAN controller supports for
+   those that come closest to a bit rate and sample point, ranks them, and
+   formats them as the BTR0BTR1 value taken by CAN_Initialize or the bit rate
+   string taken by CAN_InitializeFD.
+
+   Copyright (c) 2020 Control Solutions LLC. All rights reserved.
+*/
+
+#ifndef _PCAN_TIMING_H_
+#define _PCAN_TIMING_H_
+
+#include <stddef.h>      // provide size_t
+#include <stdint.h>      // provide uintX_t
+
+
+// ----------------------------------- // -----------------------------------
+// Definitions
+
+// Clock of the SJA1000-compatible bit timing registers that BTR0BTR1 values
+// program: the 16 MHz oscillator of PCAN adapters, divided by two
+#define PCAN_TIMING_BTR_CLOCK (8000000)
+
+// Number of clock frequencies CAN_InitializeFD accepts
+#define PCAN_TIMING_FD_CLOCKS (6)
+
+// Maximum number of results returned by a single search
+#define PCAN_TIMING_RESULTS_MAX (32)
+
+// Ranges of the prescaler (in clock periods per time quantum), and of the
+// segments and synchronization jump width (in time quanta) of a controller.
+// A bit is one time quantum of synchronization, then tseg1, then tseg2.
+typedef struct pcanTimingLimits_s
+{
+    uint32_t brpMin;
+    uint32_t brpMax;
+    uint32_t tseg1Min;
+    uint32_t tseg1Max;
+    uint32_t tseg2Min;
+    uint32_t tseg2Max;
+    uint32_t sjwMax;
+} pcanTimingLimits_t;
+
+// Bit timing found for a bit rate
+typedef struct pcanTiming_s
+{
+    uint32_t clock;        // Controller clock, in Hz
+    uint32_t brp;
+    uint32_t tseg1;
+    uint32_t tseg2;
+    uint32_t sjw;
+    double bitrate;        // Bit rate achieved, in bit/s
+    uint32_t samplePoint;  // Sample point achieved, in tenths of a percent
+    uint32_t errorPpm;     // Deviation from the bit rate asked for, in ppm
+} pcanTiming_t;
+
+// Bit timing found for the two phases of CAN FD frames, sharing a clock
+typedef struct pcanTimingFD_s
+{
+    pcanTiming_t nominal;
+    pcanTiming_t data;
+    uint32_t errorPpm;     // The larger of the two deviations
+} pcanTimingFD_t;
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Global variables
+
+// Limits of the BTR0BTR1 registers, and of the nominal and data phases of a
+// CAN FD bit rate string
+extern const pcanTimingLimits_t pcanTimingLimitsBtr;
+extern const pcanTimingLimits_t pcanTimingLimitsFDNominal;
+extern const pcanTimingLimits_t pcanTimingLimitsFDData;
+
+// Clock frequencies, in Hz, that CAN_InitializeFD accepts
+extern const uint32_t pcanTimingFDClocks[PCAN_TIMING_FD_CLOCKS];
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local variables
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local functions
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Public functions
+
+// Find up to max timings of a controller with the given clock and limits for
+// a bit rate and a sample point (in tenths of a percent), best first: by
+// deviation from the bit rate, then by distance from the sample point, then
+// by the most time quanta per bit, for the finest resynchronization
+// Returns the number of timings found
+uint32_t pcanTimingSolve(uint32_t clock, const pcanTimingLimits_t *limits, uint32_t bitrate,
+                         uint32_t samplePoint, pcanTiming_t *results, uint32_t max);
+
+// Find up to max CAN FD timings, the best for each clock CAN_InitializeFD
+// accepts (or only for clock, if it is not 0), best first: by the larger
+// deviation of the two phases, then by the distance from the sample points
+// Returns the number of timings found
+uint32_t pcanTimingSolveFD(uint32_t clock, uint32_t nominalRate, uint32_t nominalSample,
+                           uint32_t dataRate, uint32_t dataSample, pcanTimingFD_t *results,
+                           uint32_t max);
+
+// Return the BTR0BTR1 value, as taken by CAN_Initialize, of a timing found
+// with pcanTimingLimitsBtr
+uint16_t pcanTimingBtr0Btr1(const pcanTiming_t *timing);
+
+// Format the bit rate string, as taken by CAN_InitializeFD, of a CAN FD timing
+// Returns the length of the string, which is truncated if it is size or more
+int pcanTimingFDString(const pcanTimingFD_t *timing, char *buffer, size_t size);
+
+
+
+
+#endif // _PCAN_TIMING_H_
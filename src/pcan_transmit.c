@@ -0,0 +1,1411 @@
+/* Native transmit queue
+
+   Frames written from JavaScript are queued here and handed to CAN_Write by a
+   dedicated writer thread, so that the main thread never waits on, or retries
+   against, the driver. While the driver's transmit queue is full the writer
+   backs off and retries the same frame, and while the controller is bus-off it
+   holds the queue until the bus recovers. The outcome of each frame is
+   recorded in a ring of results that JavaScript collects in batches, being
+   notified only when the ring goes from empty to non-empty. Frames may be
+   written in arbitration order rather than queued order, and frames carrying
+   only a latest value replace their pending predecessors. Frames whose time
+   to live has run out are discarded rather than written. Frames come from
+   one or more sources, each with its own queue, which share the bus by
+   deficit round-robin in proportion to their weights, subject to optional
+   rate limits. A pacer can hold the load the channel puts on the bus under a
+   limit, delaying frames rather than refusing them. Writes may be confirmed
+   by the driver's echo frames, so that results reflect frames sent on the
+   bus rather than handed to the driver.
+
+   Copyright (c) 2020 Control Solutions LLC. All rights reserved.
+*/
+
+#include <stdio.h>       // provide printf
+#include <stdlib.h>      // provide calloc, malloc, and free
+#include <string.h>      // provide memcpy
+
+#if defined _WIN32
+#include <intrin.h>      // provide _BitScanForward64
+#endif
+
+#include "pcan_transmit.h"
+#include "pcan_helper.h" // provide pcanStatusLookup
+
+
+// ----------------------------------- // -----------------------------------
+// Definitions
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Global variables
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local variables
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local functions
+
+
+// Free a transmit queue that has no thread running
+static void transmitFree(pcanTransmit_t *tx)
+{
+    uint32_t i;
+
+    for (i = 0; i < PCAN_TRANSMIT_SOURCES_MAX; i++)
+    {
+        free(tx->sources[i]);
+    }
+    free(tx->queue);
+    free(tx->results);
+    free(tx->hashHead);
+    free(tx);
+
+    return;
+}
+
+
+
+
+// Return the index of the lowest set bit in a nonzero word
+static uint32_t transmitLowestBit(uint64_t word)
+{
+#if defined _WIN32
+    unsigned long index;
+    _BitScanForward64(&index, word);
+    return (uint32_t)index;
+#else
+    return (uint32_t)__builtin_ctzll(word);
+#endif
+}
+
+
+
+
+// Return the sort key for a frame. In arbitration order, this follows the
+// bits a controller sends: the 11-bit base identifier; the RTR bit of a
+// standard frame, or the SRR bit of an extended one (always recessive); the
+// IDE bit; and for extended frames, the rest of the identifier and the RTR
+// bit. The base identifier is the bucket.
+static uint32_t transmitKey(const pcanTransmit_t *tx, const pcanFrame_t *frame)
+{
+    uint32_t rtr = (frame->msgtype & PCAN_MESSAGE_RTR) ? 1 : 0;
+
+    if (!tx->options.priority)
+    {
+        return 0;
+    }
+
+    if (frame->msgtype & PCAN_MESSAGE_EXTENDED)
+    {
+        return (((frame->id >> 18) & 0x7FF) << 21) | (1U << 20) | (1U << 19) |
+               ((frame->id & 0x3FFFF) << 1) | rtr;
+    }
+
+    return ((frame->id & 0x7FF) << 21) | (rtr << 20);
+}
+
+
+
+
+// Allocate a source with a weight of 1 and no rate limit. The lock must be
+// held, if the writer thread is running.
+// Returns the source, or 0 if there is no memory for it
+static pcanTransmitSource_t *transmitSourceCreate(pcanTransmit_t *tx, uint32_t index)
+{
+    pcanTransmitSource_t *source;
+    uint32_t i;
+
+    source = calloc(1, sizeof(*source));
+    if (source == 0)
+    {
+        return 0;
+    }
+
+    for (i = 0; i < PCAN_TRANSMIT_BUCKETS; i++)
+    {
+        source->bucketHead[i] = -1;
+        source->bucketTail[i] = -1;
+    }
+    source->options.weight = 1;
+    tx->sources[index] = source;
+
+    return source;
+}
+
+
+
+
+// Return the hash chain for a frame's identifier
+static uint32_t transmitHash(const pcanTransmit_t *tx, const pcanFrame_t *frame)
+{
+    return ((frame->id * 2654435761U) ^ frame->msgtype) & tx->hashMask;
+}
+
+
+
+
+// Return the pending coalescing entry with the same identifier and message
+// type as a frame, other than skip and any entry being written. The lock must
+// be held.
+// Returns the entry's index, or -1 if there is none
+static int32_t transmitFindLatest(const pcanTransmit_t *tx, const pcanFrame_t *frame,
+                                  int32_t skip)
+{
+    int32_t index;
+
+    for (index = tx->hashHead[transmitHash(tx, frame)]; index >= 0;
+         index = tx->queue[index].hashNext)
+    {
+        if ((tx->queue[index].frame.id == frame->id) &&
+            (tx->queue[index].frame.msgtype == frame->msgtype) &&
+            (index != skip) && (index != tx->inFlight))
+        {
+            return index;
+        }
+    }
+
+    return -1;
+}
+
+
+
+
+// Return nonzero if a result can be recorded other than by the writer thread,
+// which needs the last place for the frame it is writing. The lock must be
+// held.
+static int transmitResultRoom(const pcanTransmit_t *tx)
+{
+    return (tx->resultCount + tx->wireCount + 1 < tx->resultCapacity);
+}
+
+
+
+
+// Link an entry into its bucket, after any entries with the same key. The
+// lock must be held.
+static void transmitInsert(pcanTransmit_t *tx, int32_t index)
+{
+    pcanTransmitEntry_t *entry = &(tx->queue[index]);
+    pcanTransmitSource_t *source = tx->sources[entry->frame.source];
+    uint32_t bucket = entry->key >> 21;
+    int32_t *link;
+
+    if ((source->bucketHead[bucket] < 0) ||
+        (tx->queue[source->bucketTail[bucket]].key <= entry->key))
+    {
+        // Usually the entry goes last, which needs no search
+        entry->next = -1;
+        if (source->bucketHead[bucket] < 0)
+        {
+            source->bucketHead[bucket] = index;
+        }
+        else
+        {
+            tx->queue[source->bucketTail[bucket]].next = index;
+        }
+        source->bucketTail[bucket] = index;
+    }
+    else
+    {
+        link = &(source->bucketHead[bucket]);
+        while (tx->queue[*link].key <= entry->key)
+        {
+            link = &(tx->queue[*link].next);
+        }
+        entry->next = *link;
+        *link = index;
+    }
+
+    source->bucketMap[bucket / 64] |= (uint64_t)1 << (bucket % 64);
+    source->bucketSummary |= 1U << (bucket / 64);
+    source->count++;
+    tx->queueCount++;
+
+    if (entry->frame.flags & PCAN_FRAME_FLAG_COALESCE)
+    {
+        link = &(tx->hashHead[transmitHash(tx, &(entry->frame))]);
+        entry->hashNext = *link;
+        *link = index;
+    }
+
+    return;
+}
+
+
+
+
+// Unlink an entry from its bucket, and return it to the free list. The lock
+// must be held.
+static void transmitRemove(pcanTransmit_t *tx, int32_t index)
+{
+    pcanTransmitSource_t *source = tx->sources[tx->queue[index].frame.source];
+    uint32_t bucket = tx->queue[index].key >> 21;
+    int32_t *link = &(source->bucketHead[bucket]);
+    int32_t previous = -1;
+
+    while (*link != index)
+    {
+        previous = *link;
+        link = &(tx->queue[*link].next);
+    }
+    *link = tx->queue[index].next;
+
+    if (source->bucketTail[bucket] == index)
+    {
+        source->bucketTail[bucket] = previous;
+    }
+    if (source->bucketHead[bucket] < 0)
+    {
+        source->bucketMap[bucket / 64] &= ~((uint64_t)1 << (bucket % 64));
+        if (source->bucketMap[bucket / 64] == 0)
+        {
+            source->bucketSummary &= ~(1U << (bucket / 64));
+        }
+    }
+
+    if (tx->queue[index].frame.flags & PCAN_FRAME_FLAG_COALESCE)
+    {
+        link = &(tx->hashHead[transmitHash(tx, &(tx->queue[index].frame))]);
+        while (*link != index)
+        {
+            link = &(tx->queue[*link].hashNext);
+        }
+        *link = tx->queue[index].hashNext;
+    }
+
+    tx->queue[index].next = tx->queueFree;
+    tx->queueFree = index;
+    source->count--;
+    tx->queueCount--;
+
+    return;
+}
+
+
+
+
+// Return the entry a source would write next: the first in its lowest
+// non-empty bucket. The source must not be empty, and the lock must be held.
+static int32_t transmitPeek(const pcanTransmitSource_t *source)
+{
+    uint32_t word = transmitLowestBit(source->bucketSummary);
+    uint32_t bucket = word * 64 + transmitLowestBit(source->bucketMap[word]);
+
+    return source->bucketHead[bucket];
+}
+
+
+
+
+// Add the tokens a rate-limited source has earned since it was last
+// refilled. The lock must be held.
+// Returns nonzero if the source may send a frame now; otherwise, lowers
+// *waitUs to the time until it may, if that is sooner
+static int transmitRefill(pcanTransmitSource_t *source, uint64_t now, uint64_t *waitUs)
+{
+    uint64_t untilUs;
+
+    if (source->options.rate <= 0)
+    {
+        return 1;
+    }
+
+    source->tokens += (double)(now - source->refilled) * source->options.rate / 1e6;
+    if (source->tokens > source->options.burst)
+    {
+        source->tokens = source->options.burst;
+    }
+    source->refilled = now;
+
+    if (source->tokens >= 1)
+    {
+        return 1;
+    }
+
+    untilUs = (uint64_t)((1 - source->tokens) * 1e6 / source->options.rate) + 1;
+    if (untilUs < *waitUs)
+    {
+        *waitUs = untilUs;
+    }
+
+    return 0;
+}
+
+
+
+
+// Choose the entry to write next by deficit round-robin. Each visit to a
+// source with frames waiting adds its quantum to its deficit, and it is
+// served until its next frame costs more than the deficit left; a source
+// found empty loses its deficit, so that idle time does not bank credit. A
+// source at its rate limit is passed over, keeping its deficit. The queue
+// must not be empty, and the lock must be held.
+// Returns the entry's index, or -1 if every source with frames waiting is at
+// its rate limit, with the time until one may send in *waitUs
+static int32_t transmitSelect(pcanTransmit_t *tx, uint64_t now, uint64_t *waitUs)
+{
+    pcanTransmitSource_t *source;
+    int32_t index;
+    uint32_t n;
+
+    *waitUs = UINT64_MAX;
+
+    // Every source is visited at most once, and the first to be visited
+    // twice, having had its quantum again
+    for (n = 0; n <= PCAN_TRANSMIT_SOURCES_MAX; n++)
+    {
+        source = tx->sources[tx->current];
+
+        if ((source != 0) && (source->count == 0))
+        {
+            source->deficit = 0;
+        }
+        else if ((source != 0) && transmitRefill(source, now, waitUs))
+        {
+            source->throttled = 0;
+
+            if (!tx->granted)
+            {
+                source->deficit += (int64_t)source->options.weight * PCAN_TRANSMIT_QUANTUM_BITS;
+                tx->granted = 1;
+            }
+
+            index = transmitPeek(source);
+            if ((int64_t)pcanFrameBits(&(tx->queue[index].frame)) <= source->deficit)
+            {
+                return index;
+            }
+        }
+        else if ((source != 0) && !source->throttled)
+        {
+            // Counted once each time the source reaches its rate limit, however
+            // often it is passed over until it may send again
+            source->throttled = 1;
+            source->stats.throttled++;
+        }
+
+        tx->current = (tx->current + 1) % PCAN_TRANSMIT_SOURCES_MAX;
+        tx->granted = 0;
+    }
+
+    return -1;
+}
+
+
+
+
+// Add the tokens the pacer has earned since it was last refilled. The lock
+// must be held.
+// Returns 0 if a frame of so many bits may be written now, or otherwise the
+// time until it may
+static uint64_t transmitPace(pcanTransmit_t *tx, uint64_t now, uint32_t bits)
+{
+    double rate = (double)tx->options.bitrate * tx->options.maxLoad / 100;
+
+    if (tx->options.maxLoad <= 0)
+    {
+        return 0;
+    }
+
+    tx->paceTokens += (double)(now - tx->paceRefilled) * rate / 1e6;
+    if (tx->paceTokens > tx->paceBurst)
+    {
+        tx->paceTokens = tx->paceBurst;
+    }
+    tx->paceRefilled = now;
+
+    if (tx->paceTokens >= bits)
+    {
+        return 0;
+    }
+
+    return (uint64_t)((bits - tx->paceTokens) * 1e6 / rate) + 1;
+}
+
+
+
+
+// Start a new load measurement window if the current one is over. The lock
+// must be held.
+static void transmitMeasure(pcanTransmit_t *tx, uint64_t now)
+{
+    uint64_t elapsed = now - tx->loadStart;
+
+    if (elapsed < PCAN_TRANSMIT_LOAD_WINDOW_US)
+    {
+        return;
+    }
+
+    // A window with no writes in it leaves nothing to report
+    tx->stats.load = ((tx->options.bitrate > 0) && (elapsed < 2 * PCAN_TRANSMIT_LOAD_WINDOW_US)) ?
+                     (double)tx->loadBits * 1e8 / ((double)tx->options.bitrate * elapsed) : 0;
+    tx->loadStart = now;
+    tx->loadBits = 0;
+
+    return;
+}
+
+
+
+
+// Charge an entry that is about to be removed, having been written, to its
+// source and to the pacer. The lock must be held.
+static void transmitCharge(pcanTransmit_t *tx, int32_t index, uint64_t now)
+{
+    pcanTransmitEntry_t *entry = &(tx->queue[index]);
+    pcanTransmitSource_t *source = tx->sources[entry->frame.source];
+    uint64_t latencyUs = now - entry->queuedAt;
+
+    source->deficit -= pcanFrameBits(&(entry->frame));
+    if (source->options.rate > 0)
+    {
+        source->tokens -= 1;
+    }
+
+    tx->paceTokens -= pcanFrameBits(&(entry->frame));
+    transmitMeasure(tx, now);
+    tx->loadBits += pcanFrameBits(&(entry->frame));
+
+    source->stats.sent++;
+    source->latencySumUs += latencyUs;
+    if (latencyUs > source->stats.maxLatencyUs)
+    {
+        source->stats.maxLatencyUs = latencyUs;
+    }
+
+    return;
+}
+
+
+
+
+// Add a result to the ring. The lock must be held.
+// Returns nonzero if JavaScript should be notified
+static int transmitAppend(pcanTransmit_t *tx, uint64_t seq, TPCANStatus status,
+                          uint32_t latencyUs, uint64_t timestamp)
+{
+    pcanTransmitResult_t *result;
+
+    result = &(tx->results[(tx->resultHead + tx->resultCount) % tx->resultCapacity]);
+    result->seq = seq;
+    result->status = status;
+    result->latencyUs = latencyUs;
+    result->timestamp = timestamp;
+    tx->resultCount++;
+
+    if (!tx->notifyPending)
+    {
+        tx->notifyPending = 1;
+        return 1;
+    }
+
+    return 0;
+}
+
+
+
+
+// Record the result of a frame. The lock must be held.
+// Returns nonzero if JavaScript should be notified
+static int transmitRecord(pcanTransmit_t *tx, uint64_t seq, TPCANStatus status)
+{
+    if (status == PCAN_ERROR_OK)
+    {
+        tx->stats.sent++;
+    }
+    else if (status == PCAN_TRANSMIT_STATUS_CANCELLED)
+    {
+        tx->stats.cancelled++;
+    }
+    else if (status == PCAN_TRANSMIT_STATUS_REPLACED)
+    {
+        tx->stats.replaced++;
+    }
+    else if (status == PCAN_TRANSMIT_STATUS_EXPIRED)
+    {
+        tx->stats.expired++;
+    }
+    else if (status == PCAN_TRANSMIT_STATUS_UNCONFIRMED)
+    {
+        tx->stats.unconfirmed++;
+    }
+    else
+    {
+        tx->stats.errors++;
+        tx->stats.lastError = status;
+    }
+
+    return transmitAppend(tx, seq, status, 0, 0);
+}
+
+
+
+
+// Record the result of a frame whose echo has arrived, and add the time it
+// took to reach the bus to the histogram. The lock must be held.
+// Returns nonzero if JavaScript should be notified
+static int transmitConfirmed(pcanTransmit_t *tx, const pcanTransmitWire_t *wire)
+{
+    uint64_t latencyUs = (wire->echoedAt > wire->queuedAt) ? wire->echoedAt - wire->queuedAt : 0;
+    uint64_t value = latencyUs;
+    uint32_t bucket = 0;
+
+    while ((value > 0) && (bucket + 1 < PCAN_TRANSMIT_LATENCY_BUCKETS))
+    {
+        value >>= 1;
+        bucket++;
+    }
+
+    tx->latency.buckets[bucket]++;
+    tx->latency.count++;
+    tx->latency.sumUs += latencyUs;
+    if (latencyUs > tx->latency.maxUs)
+    {
+        tx->latency.maxUs = latencyUs;
+    }
+
+    tx->stats.confirmed++;
+
+    return transmitAppend(tx, wire->seq, PCAN_ERROR_OK,
+                          (latencyUs < UINT32_MAX) ? (uint32_t)latencyUs : UINT32_MAX,
+                          wire->timestamp);
+}
+
+
+
+
+// Drop frames from the front of the list of those waiting for echoes once
+// their results are recorded, and record PCAN_TRANSMIT_STATUS_UNCONFIRMED for
+// those that have waited too long. The lock must be held.
+// Returns nonzero if JavaScript should be notified; the time until the next
+// frame times out is put in *waitUs, or UINT64_MAX if none is waiting
+static int transmitUnconfirm(pcanTransmit_t *tx, uint64_t now, uint64_t *waitUs)
+{
+    pcanTransmitWire_t *wire;
+    uint64_t timeoutUs = tx->options.confirmTimeoutUs;
+    int notify = 0;
+
+    *waitUs = UINT64_MAX;
+
+    while (tx->wireCount > 0)
+    {
+        wire = &(tx->wire[tx->wireHead]);
+
+        // The frame being written is always the last one
+        if (wire->writing)
+        {
+            break;
+        }
+
+        if (wire->echoedAt == 0)
+        {
+            if (now - wire->writtenAt < timeoutUs)
+            {
+                *waitUs = wire->writtenAt + timeoutUs - now;
+                break;
+            }
+
+#ifdef PCAN_TRANSMIT_DEBUG
+            printf("transmitUnconfirm: 0x%03X unconfirmed\n", wire->id);
+#endif
+            notify |= transmitRecord(tx, wire->seq, PCAN_TRANSMIT_STATUS_UNCONFIRMED);
+        }
+
+        tx->wireHead = (tx->wireHead + 1) % PCAN_TRANSMIT_CONFIRM_MAX;
+        tx->wireCount--;
+    }
+
+    return notify;
+}
+
+
+
+
+// Fold a newer coalescing frame, queued while an entry was being written, into
+// that entry, which keeps its place in the queue. The lock must be held.
+// Returns nonzero if JavaScript should be notified
+static int transmitMerge(pcanTransmit_t *tx, int32_t index)
+{
+    pcanTransmitEntry_t *entry = &(tx->queue[index]);
+    int32_t newer;
+    int notify;
+
+    if (!(entry->frame.flags & PCAN_FRAME_FLAG_COALESCE) || !transmitResultRoom(tx))
+    {
+        return 0;
+    }
+
+    newer = transmitFindLatest(tx, &(entry->frame), index);
+    if (newer < 0)
+    {
+        return 0;
+    }
+
+    notify = transmitRecord(tx, entry->seq, PCAN_TRANSMIT_STATUS_REPLACED);
+    entry->seq = tx->queue[newer].seq;
+    entry->expiry = tx->queue[newer].expiry;
+    memcpy(&(entry->frame.data), &(tx->queue[newer].frame.data), sizeof(entry->frame.data));
+    entry->frame.len = tx->queue[newer].frame.len;
+    transmitRemove(tx, newer);
+
+    return notify;
+}
+
+
+
+
+void pcanTransmitThreadProc(void *arg)
+{
+    pcanTransmit_t *tx = (pcanTransmit_t*)arg;
+    pcanTransmitWire_t *wire = 0;
+    pcanFrame_t frame;
+    TPCANMsg msg;
+    TPCANStatus status = PCAN_ERROR_UNKNOWN;
+    uint64_t backoffUs = PCAN_TRANSMIT_BACKOFF_MIN_US;
+    uint64_t waitUs;
+    uint64_t confirmUs;
+    uint64_t now;
+    int32_t index;
+    int notify = 0;
+
+#ifdef PCAN_TRANSMIT_DEBUG
+    printf("pcanTransmitThreadProc: Starting thread\n");
+#endif
+
+    pcanMutexLock(&(tx->lock));
+
+    while (!tx->stop)
+    {
+        // Give up on echoes that are overdue
+        now = pcanTimeMicros();
+        if (transmitUnconfirm(tx, now, &confirmUs) && (tx->notify != 0))
+        {
+            pcanMutexUnlock(&(tx->lock));
+            tx->notify(tx->notifyContext);
+            pcanMutexLock(&(tx->lock));
+            continue;
+        }
+
+        // Wait for a frame, and for room to record its result, waking in
+        // time to check for the next overdue echo
+        if ((tx->queueCount == 0) ||
+            (tx->resultCount + tx->wireCount == tx->resultCapacity) ||
+            (tx->wireCount == PCAN_TRANSMIT_CONFIRM_MAX))
+        {
+            if (confirmUs != UINT64_MAX)
+            {
+                pcanCondTimedWait(&(tx->wake), &(tx->lock), confirmUs);
+            }
+            else
+            {
+                pcanCondWait(&(tx->wake), &(tx->lock));
+            }
+            continue;
+        }
+
+        // Write the next frame without holding the lock, so that more can
+        // be queued meanwhile. It stays queued, and cannot be cancelled,
+        // until the driver takes it; after a retry, a higher priority frame
+        // from the same source queued in the meantime goes first.
+        index = transmitSelect(tx, now, &waitUs);
+        if (index < 0)
+        {
+            // Every source with frames waiting is at its rate limit
+            tx->throttled = 1;
+            pcanCondTimedWait(&(tx->wake), &(tx->lock), waitUs);
+            tx->throttled = 0;
+            continue;
+        }
+
+        // Discard the frame instead if it has outlived its time to live
+        if ((tx->queue[index].expiry != 0) && (now >= tx->queue[index].expiry))
+        {
+#ifdef PCAN_TRANSMIT_DEBUG
+            printf("pcanTransmitThreadProc: 0x%03X expired\n", tx->queue[index].frame.id);
+#endif
+            notify = transmitRecord(tx, tx->queue[index].seq, PCAN_TRANSMIT_STATUS_EXPIRED);
+            transmitRemove(tx, index);
+
+            if (notify && (tx->notify != 0))
+            {
+                pcanMutexUnlock(&(tx->lock));
+                tx->notify(tx->notifyContext);
+                pcanMutexLock(&(tx->lock));
+            }
+            continue;
+        }
+
+        // Hold the frame until writing it keeps the bus load under the limit
+        waitUs = transmitPace(tx, now, pcanFrameBits(&(tx->queue[index].frame)));
+        if (waitUs > 0)
+        {
+            tx->stats.paced++;
+            pcanCondTimedWait(&(tx->wake), &(tx->lock), waitUs);
+            continue;
+        }
+
+        tx->inFlight = index;
+        memcpy(&frame, &(tx->queue[index].frame), sizeof(frame));
+
+        // Its echo may be drained before CAN_Write returns, so the frame
+        // waits for it from now on
+        if (tx->options.confirm)
+        {
+            wire = &(tx->wire[(tx->wireHead + tx->wireCount) % PCAN_TRANSMIT_CONFIRM_MAX]);
+            memset(wire, 0, sizeof(*wire));
+            wire->seq = tx->queue[index].seq;
+            wire->queuedAt = tx->queue[index].queuedAt;
+            wire->id = frame.id;
+            wire->msgtype = frame.msgtype;
+            wire->len = frame.len;
+            memcpy(wire->data, frame.data, sizeof(wire->data));
+            wire->writing = 1;
+            tx->wireCount++;
+        }
+
+        pcanMutexUnlock(&(tx->lock));
+
+        pcanFrameToMsg(&frame, &msg);
+        status = CAN_Write(tx->channel, &msg);
+
+        pcanMutexLock(&(tx->lock));
+        tx->inFlight = -1;
+
+        if (tx->options.confirm)
+        {
+            // Only the writer adds frames, so this one is still the last
+            wire = &(tx->wire[(tx->wireHead + tx->wireCount - 1) % PCAN_TRANSMIT_CONFIRM_MAX]);
+            wire->writing = 0;
+            wire->writtenAt = pcanTimeMicros();
+            if (status != PCAN_ERROR_OK)
+            {
+                tx->wireCount--;
+            }
+        }
+
+        // A frame that is to be retried is now out of date if a newer value
+        // for it was queued meanwhile
+        if (((status == PCAN_ERROR_QXMTFULL) || (status & PCAN_ERROR_BUSOFF)) &&
+            transmitMerge(tx, index) && (tx->notify != 0))
+        {
+            pcanMutexUnlock(&(tx->lock));
+            tx->notify(tx->notifyContext);
+            pcanMutexLock(&(tx->lock));
+        }
+
+        if (status == PCAN_ERROR_QXMTFULL)
+        {
+            // Retry once the driver has had time to send some
+            tx->stats.retries++;
+            pcanCondTimedWait(&(tx->wake), &(tx->lock), backoffUs);
+            backoffUs = (backoffUs * 2 < PCAN_TRANSMIT_BACKOFF_MAX_US) ?
+                        backoffUs * 2 : PCAN_TRANSMIT_BACKOFF_MAX_US;
+            continue;
+        }
+
+        if (status & PCAN_ERROR_BUSOFF)
+        {
+            // Hold the queue, and poll until the controller recovers
+            if (!tx->stats.busOff)
+            {
+                tx->stats.busOff = 1;
+                tx->stats.busOffs++;
+                tx->stats.lastError = status;
+#ifdef PCAN_TRANSMIT_DEBUG
+                printf("pcanTransmitThreadProc: Bus-off; holding %u frames\n", tx->queueCount);
+#endif
+            }
+            pcanCondTimedWait(&(tx->wake), &(tx->lock), PCAN_TRANSMIT_BUSOFF_POLL_US);
+            continue;
+        }
+
+        tx->stats.busOff = 0;
+        backoffUs = PCAN_TRANSMIT_BACKOFF_MIN_US;
+
+#ifdef PCAN_TRANSMIT_DEBUG
+        if (status != PCAN_ERROR_OK)
+        {
+            printf("pcanTransmitThreadProc: 0x%02X (%s)\n", status, pcanStatusLookup(status));
+        }
+#endif
+
+        if (status == PCAN_ERROR_OK)
+        {
+            transmitCharge(tx, index, pcanTimeMicros());
+        }
+
+        if ((status == PCAN_ERROR_OK) && tx->options.confirm)
+        {
+            // The result waits for the echo, unless it is already here
+            tx->stats.sent++;
+            notify = (wire->echoedAt != 0) ? transmitConfirmed(tx, wire) : 0;
+        }
+        else
+        {
+            notify = transmitRecord(tx, tx->queue[index].seq, status);
+        }
+        transmitRemove(tx, index);
+
+        if (notify && (tx->notify != 0))
+        {
+            pcanMutexUnlock(&(tx->lock));
+            tx->notify(tx->notifyContext);
+            pcanMutexLock(&(tx->lock));
+        }
+    }
+
+    pcanMutexUnlock(&(tx->lock));
+
+#ifdef PCAN_TRANSMIT_DEBUG
+    printf("pcanTransmitThreadProc: Exiting thread\n");
+#endif
+
+    return;
+}
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Public functions
+
+
+pcanTransmit_t *pcanTransmitStart(TPCANHandle channel, const pcanTransmitOptions_t *options,
+                                  pcanTransmitNotify_t notify, void *context,
+                                  const char **error)
+{
+    pcanTransmit_t *tx = 0;
+    uint32_t capacity = options->capacity;
+    uint32_t i;
+
+    if (capacity == 0)
+    {
+        capacity = PCAN_TRANSMIT_QUEUE_DEFAULT;
+    }
+
+    tx = calloc(1, sizeof(*tx));
+    if (tx == 0)
+    {
+        *error = "Error allocating memory for transmit queue.";
+        return 0;
+    }
+
+    // Size the hash table to the power of two at or above the capacity
+    tx->hashMask = 1;
+    while (tx->hashMask < capacity)
+    {
+        tx->hashMask <<= 1;
+    }
+
+    tx->queue = calloc(capacity, sizeof(pcanTransmitEntry_t));
+    tx->results = calloc((size_t)capacity * 2, sizeof(pcanTransmitResult_t));
+    tx->hashHead = malloc(tx->hashMask * sizeof(int32_t));
+    if ((tx->queue == 0) || (tx->results == 0) || (tx->hashHead == 0) ||
+        (transmitSourceCreate(tx, 0) == 0))
+    {
+        transmitFree(tx);
+        *error = "Error allocating memory for transmit queue.";
+        return 0;
+    }
+
+    tx->channel = channel;
+    tx->options = *options;
+    tx->options.capacity = capacity;
+    tx->notify = notify;
+    tx->notifyContext = context;
+    tx->queueCapacity = capacity;
+    tx->resultCapacity = capacity * 2;
+    tx->inFlight = -1;
+    tx->stats.lastError = PCAN_ERROR_OK;
+
+    if (tx->options.confirmTimeoutUs == 0)
+    {
+        tx->options.confirmTimeoutUs = PCAN_TRANSMIT_CONFIRM_TIMEOUT_US;
+    }
+
+    // The pacer starts with a full burst
+    if (tx->options.bitrate == 0)
+    {
+        tx->options.maxLoad = 0;
+    }
+    tx->paceBurst = (double)tx->options.bitrate * tx->options.maxLoad / 100 *
+                    PCAN_TRANSMIT_PACER_BURST_US / 1e6;
+    if (tx->paceBurst < PCAN_FRAME_BITS_MAX)
+    {
+        tx->paceBurst = PCAN_FRAME_BITS_MAX;
+    }
+    tx->paceTokens = tx->paceBurst;
+    tx->paceRefilled = pcanTimeMicros();
+    tx->loadStart = tx->paceRefilled;
+
+    for (i = 0; i < capacity; i++)
+    {
+        tx->queue[i].next = (i + 1 < capacity) ? (int32_t)(i + 1) : -1;
+        tx->queue[i].hashNext = -1;
+    }
+    tx->queueFree = 0;
+
+    for (i = 0; i < tx->hashMask; i++)
+    {
+        tx->hashHead[i] = -1;
+    }
+    tx->hashMask--;
+
+    pcanMutexInit(&(tx->lock));
+    pcanCondInit(&(tx->wake));
+
+    if (pcanThreadCreate(&(tx->thread), pcanTransmitThreadProc, tx) != 0)
+    {
+        pcanCondDestroy(&(tx->wake));
+        pcanMutexDestroy(&(tx->lock));
+        transmitFree(tx);
+        *error = "Unable to start transmit thread.";
+        return 0;
+    }
+
+#ifdef PCAN_TRANSMIT_DEBUG
+    printf("pcanTransmitStart: Channel 0x%02X, %u frames, %s order, %.1f%% load%s\n", channel,
+           capacity, options->priority ? "priority" : "queued", tx->options.maxLoad,
+           options->confirm ? ", confirmed" : "");
+#endif
+
+    return tx;
+}
+
+
+
+
+uint32_t pcanTransmitPush(pcanTransmit_t *tx, const pcanFrame_t *frames, uint32_t count)
+{
+    pcanTransmitEntry_t *entry;
+    int32_t index;
+    uint32_t source;
+    uint32_t i;
+    uint64_t now = pcanTimeMicros();
+    uint64_t expiry;
+    int wasEmpty;
+    int notify = 0;
+
+    pcanMutexLock(&(tx->lock));
+
+    wasEmpty = (tx->queueCount == 0);
+
+    for (i = 0; i < count; i++)
+    {
+        expiry = (frames[i].timestamp != 0) ? now + frames[i].timestamp : 0;
+
+        source = frames[i].source;
+        if ((source >= PCAN_TRANSMIT_SOURCES_MAX) ||
+            ((tx->sources[source] == 0) && (transmitSourceCreate(tx, source) == 0)))
+        {
+            source = 0;
+        }
+
+        // Replace a pending frame with the same identifier in place. It stays
+        // in the queue of the source that queued it, which is credited with
+        // the new frame, and is timed from now.
+        if ((frames[i].flags & PCAN_FRAME_FLAG_COALESCE) && transmitResultRoom(tx))
+        {
+            index = transmitFindLatest(tx, &(frames[i]), -1);
+            if (index >= 0)
+            {
+                entry = &(tx->queue[index]);
+                notify |= transmitRecord(tx, entry->seq, PCAN_TRANSMIT_STATUS_REPLACED);
+                source = entry->frame.source;
+                entry->seq = tx->nextSeq++;
+                memcpy(&(entry->frame), &(frames[i]), sizeof(pcanFrame_t));
+                entry->frame.source = (uint8_t)source;
+                entry->expiry = expiry;
+                entry->queuedAt = now;
+                tx->sources[source]->stats.queued++;
+                continue;
+            }
+        }
+
+        if (tx->queueFree < 0)
+        {
+            break;
+        }
+
+        index = tx->queueFree;
+        entry = &(tx->queue[index]);
+        tx->queueFree = entry->next;
+
+        entry->seq = tx->nextSeq++;
+        memcpy(&(entry->frame), &(frames[i]), sizeof(pcanFrame_t));
+        entry->frame.source = (uint8_t)source;
+        entry->key = transmitKey(tx, &(entry->frame));
+        entry->expiry = expiry;
+        entry->queuedAt = now;
+        transmitInsert(tx, index);
+        tx->sources[source]->stats.queued++;
+    }
+
+    tx->stats.queued += i;
+
+    // The writer only sleeps untimed on an empty queue, or timed for a rate
+    // limit that a frame from another source may not be subject to; waking it
+    // otherwise would cut short a backoff
+    if ((wasEmpty || tx->throttled) && (tx->queueCount > 0))
+    {
+        pcanCondSignal(&(tx->wake));
+    }
+
+    pcanMutexUnlock(&(tx->lock));
+
+    if (notify && (tx->notify != 0))
+    {
+        tx->notify(tx->notifyContext);
+    }
+
+    return i;
+}
+
+
+
+
+uint32_t pcanTransmitCancel(pcanTransmit_t *tx, uint32_t id, int ext)
+{
+    pcanTransmitEntry_t *entry;
+    pcanTransmitSource_t *source;
+    uint32_t bucket;
+    uint32_t count = 0;
+    uint32_t i;
+    int32_t index;
+    int32_t next;
+    int notify = 0;
+
+    // In arbitration order, only the identifier's own bucket can hold it
+    bucket = tx->options.priority ? ((ext ? (id >> 18) : id) & 0x7FF) : 0;
+
+    pcanMutexLock(&(tx->lock));
+
+    for (i = 0; i < PCAN_TRANSMIT_SOURCES_MAX; i++)
+    {
+        source = tx->sources[i];
+        if ((source == 0) || (source->count == 0))
+        {
+            continue;
+        }
+
+        for (index = source->bucketHead[bucket]; index >= 0; index = next)
+        {
+            entry = &(tx->queue[index]);
+            next = entry->next;
+
+            if ((entry->frame.id != id) ||
+                (((entry->frame.msgtype & PCAN_MESSAGE_EXTENDED) != 0) != (ext != 0)) ||
+                (index == tx->inFlight))
+            {
+                continue;
+            }
+
+            if (!transmitResultRoom(tx))
+            {
+                break;
+            }
+
+            notify |= transmitRecord(tx, entry->seq, PCAN_TRANSMIT_STATUS_CANCELLED);
+            transmitRemove(tx, index);
+            count++;
+        }
+    }
+
+    pcanMutexUnlock(&(tx->lock));
+
+#ifdef PCAN_TRANSMIT_DEBUG
+    printf("pcanTransmitCancel: 0x%X, %u frames\n", id, count);
+#endif
+
+    if (notify && (tx->notify != 0))
+    {
+        tx->notify(tx->notifyContext);
+    }
+
+    return count;
+}
+
+
+
+
+int pcanTransmitSetSource(pcanTransmit_t *tx, uint32_t source,
+                          const pcanTransmitSourceOptions_t *options)
+{
+    pcanTransmitSource_t *s;
+
+    if (source >= PCAN_TRANSMIT_SOURCES_MAX)
+    {
+        return 1;
+    }
+
+    pcanMutexLock(&(tx->lock));
+
+    s = tx->sources[source];
+    if (s == 0)
+    {
+        s = transmitSourceCreate(tx, source);
+        if (s == 0)
+        {
+            pcanMutexUnlock(&(tx->lock));
+            return 1;
+        }
+    }
+
+    s->options = *options;
+    if (s->options.weight == 0)
+    {
+        s->options.weight = 1;
+    }
+    if (s->options.rate < 0)
+    {
+        s->options.rate = 0;
+    }
+    if (s->options.burst < 1)
+    {
+        s->options.burst = 1;
+    }
+
+    // A rate-limited source starts with a full burst
+    s->tokens = s->options.burst;
+    s->refilled = pcanTimeMicros();
+
+    // The writer may be waiting for a rate limit that no longer applies
+    pcanCondSignal(&(tx->wake));
+
+    pcanMutexUnlock(&(tx->lock));
+
+#ifdef PCAN_TRANSMIT_DEBUG
+    printf("pcanTransmitSetSource: %u, weight %u, %.1f/s, burst %.1f\n", source,
+           s->options.weight, s->options.rate, s->options.burst);
+#endif
+
+    return 0;
+}
+
+
+
+
+int pcanTransmitGetSourceStats(pcanTransmit_t *tx, uint32_t source,
+                               pcanTransmitSourceStats_t *stats)
+{
+    pcanTransmitSource_t *s;
+
+    if (source >= PCAN_TRANSMIT_SOURCES_MAX)
+    {
+        return 1;
+    }
+
+    pcanMutexLock(&(tx->lock));
+
+    s = tx->sources[source];
+    if (s == 0)
+    {
+        pcanMutexUnlock(&(tx->lock));
+        return 1;
+    }
+
+    *stats = s->stats;
+    stats->pending = s->count;
+    stats->meanLatencyUs = (s->stats.sent > 0) ? s->latencySumUs / s->stats.sent : 0;
+
+    pcanMutexUnlock(&(tx->lock));
+
+    return 0;
+}
+
+
+
+
+void pcanTransmitConfirm(pcanTransmit_t *tx, const pcanFrame_t *frames,
+                         const uint64_t *hostTimes, uint32_t count)
+{
+    pcanTransmitWire_t *wire;
+    uint32_t i;
+    uint32_t k;
+    int wasFull;
+    int notify = 0;
+
+    if (!tx->options.confirm)
+    {
+        return;
+    }
+
+    pcanMutexLock(&(tx->lock));
+
+    wasFull = (tx->wireCount == PCAN_TRANSMIT_CONFIRM_MAX);
+
+    for (i = 0; i < count; i++)
+    {
+        if (!(frames[i].flags & PCAN_FRAME_FLAG_TX))
+        {
+            continue;
+        }
+
+        // Echoes arrive in the order the frames were written, so this is
+        // almost always the oldest frame waiting. Frames written other than
+        // through the queue have echoes too, which match nothing.
+        for (k = 0; k < tx->wireCount; k++)
+        {
+            wire = &(tx->wire[(tx->wireHead + k) % PCAN_TRANSMIT_CONFIRM_MAX]);
+            if ((wire->echoedAt == 0) && (wire->id == frames[i].id) &&
+                (wire->msgtype == frames[i].msgtype) && (wire->len == frames[i].len) &&
+                (memcmp(wire->data, frames[i].data, wire->len) == 0))
+            {
+                break;
+            }
+        }
+        if (k == tx->wireCount)
+        {
+            continue;
+        }
+
+        wire->echoedAt = hostTimes[i];
+        wire->timestamp = frames[i].timestamp;
+
+        // The writer records the result of a frame it is still writing
+        if (!wire->writing)
+        {
+            notify |= transmitConfirmed(tx, wire);
+        }
+    }
+
+    // Drop the frames at the front whose results are now recorded
+    while ((tx->wireCount > 0) && (tx->wire[tx->wireHead].echoedAt != 0) &&
+           !tx->wire[tx->wireHead].writing)
+    {
+        tx->wireHead = (tx->wireHead + 1) % PCAN_TRANSMIT_CONFIRM_MAX;
+        tx->wireCount--;
+    }
+
+    if (wasFull && (tx->wireCount < PCAN_TRANSMIT_CONFIRM_MAX))
+    {
+        pcanCondSignal(&(tx->wake));
+    }
+
+    pcanMutexUnlock(&(tx->lock));
+
+    if (notify && (tx->notify != 0))
+    {
+        tx->notify(tx->notifyContext);
+    }
+
+    return;
+}
+
+
+
+
+void pcanTransmitGetLatency(pcanTransmit_t *tx, pcanTransmitLatency_t *latency)
+{
+    pcanMutexLock(&(tx->lock));
+    *latency = tx->latency;
+    pcanMutexUnlock(&(tx->lock));
+
+    return;
+}
+
+
+
+
+uint32_t pcanTransmitResults(pcanTransmit_t *tx, pcanTransmitResult_t *results, uint32_t max)
+{
+    uint32_t count = 0;
+    int wasFull;
+
+    pcanMutexLock(&(tx->lock));
+
+    wasFull = (tx->resultCount + tx->wireCount == tx->resultCapacity);
+
+    while ((count < max) && (tx->resultCount > 0))
+    {
+        memcpy(&(results[count]), &(tx->results[tx->resultHead]), sizeof(pcanTransmitResult_t));
+        tx->resultHead = (tx->resultHead + 1) % tx->resultCapacity;
+        tx->resultCount--;
+        count++;
+    }
+
+    // Once the ring is empty, the next result notifies JavaScript again
+    if (tx->resultCount == 0)
+    {
+        tx->notifyPending = 0;
+    }
+
+    if (wasFull && (count > 0))
+    {
+        pcanCondSignal(&(tx->wake));
+    }
+
+    pcanMutexUnlock(&(tx->lock));
+
+    return count;
+}
+
+
+
+
+uint32_t pcanTransmitResultsPending(pcanTransmit_t *tx)
+{
+    uint32_t count;
+
+    pcanMutexLock(&(tx->lock));
+    count = tx->resultCount;
+    pcanMutexUnlock(&(tx->lock));
+
+    return count;
+}
+
+
+
+
+void pcanTransmitGetStats(pcanTransmit_t *tx, pcanTransmitStats_t *stats)
+{
+    pcanMutexLock(&(tx->lock));
+    transmitMeasure(tx, pcanTimeMicros());
+    *stats = tx->stats;
+    stats->pending = tx->queueCount;
+    stats->unsent = tx->wireCount;
+    pcanMutexUnlock(&(tx->lock));
+
+    return;
+}
+
+
+
+
+void pcanTransmitStop(pcanTransmit_t *tx, pcanTransmitStats_t *stats)
+{
+    pcanMutexLock(&(tx->lock));
+    tx->stop = 1;
+    pcanCondSignal(&(tx->wake));
+    pcanMutexUnlock(&(tx->lock));
+
+    pcanThreadJoin(tx->thread);
+
+    tx->stats.discarded = tx->queueCount;
+    tx->stats.pending = 0;
+    tx->stats.unsent = 0;
+
+#ifdef PCAN_TRANSMIT_DEBUG
+    printf("pcanTransmitStop: %llu sent, %llu discarded\n",
+           (unsigned long long)tx->stats.sent, (unsigned long long)tx->stats.discarded);
+#endif
+
+    if (stats != 0)
+    {
+        *stats = tx->stats;
+    }
+
+    pcanCondDestroy(&(tx->wake));
+    pcanMutexDestroy(&(tx->lock));
+    transmitFree(tx);
+
+    return;
+}
@@ -0,0 +1,416 @@
+/* Native transmit queue
+
+   Frames written from JavaScript are queued here and handed to CAN_Write by a
+   dedicated writer thread, so that the main thread never waits on, or retries
+   against, the driver. While the driver's transmit queue is full the writer
+   backs off and retries the same frame, and while the controller is bus-off it
+   holds the queue until the bus recovers. The outcome of each frame is
+   recorded in a ring of results that JavaScript collects in batches, being
+   notified only when the ring goes from empty to non-empty.
+
+   Frames can be kept in arbitration order instead of the order they were
+   queued, so that a backlog of bulk data does not hold up higher priority
+   frames: pending frames sit in a bucket for their 11-bit base identifier,
+   kept sorted within the bucket, and a two-level bitmap finds the lowest
+   non-empty bucket. Frames of equal priority keep their queued order.
+
+   Frames flagged PCAN_FRAME_FLAG_COALESCE carry values where only the latest
+   matters: such a frame replaces a pending frame with the same identifier,
+   taking over its place in the queue, rather than queuing behind it. These
+   frames are also kept in a hash table by identifier, so that the pending one
+   is found without searching the queue.
+
+   A frame may also carry a time to live. One that has expired by the time it
+   reaches the front of the queue is discarded instead of being written, so
+   that under overload the bus carries only current data.
+
+   Writes can also be confirmed: with the driver's echo frames enabled, a
+   frame written to the driver waits in a first-in, first-out list until the
+   receive path drains its echo, showing that it was sent on the bus, and only
+   then is its result recorded, with the hardware timestamp of the echo. The
+   time from being queued to being sent feeds a histogram.
+
+   Copyright (c) 2020 Control Solutions LLC. All rights reserved.
+*/
+
+#ifndef _PCAN_TRANSMIT_H_
+#define _PCAN_TRANSMIT_H_
+
+#include <stdint.h>      // provide uintX_t
+
+#if defined _WIN32
+#include <windows.h>     // provide Win32 types, constants, and functions
+#include <PCANBasic.h>   // provide PCAN-Basic types, constants, and functions
+#elif defined __APPLE__
+#include <PCBUSB.h>      // provide PCAN-Basic types, constants, and functions
+#endif
+
+#include "pcan_frame.h"  // provide pcanFrame_t
+#include "pcan_thread.h" // provide pcanThread_t, pcanMutex_t, and pcanCond_t
+
+
+//#define PCAN_TRANSMIT_DEBUG
+// Uncomment to enable debugging messages, which may affect timing or
+// performance
+
+// ----------------------------------- // -----------------------------------
+// Definitions
+
+// Default number of frames held in the transmit queue
+#define PCAN_TRANSMIT_QUEUE_DEFAULT (4096)
+
+// Backoff between retries while the driver's transmit queue is full; it
+// doubles from the minimum up to the maximum, and resets once a frame is sent
+#define PCAN_TRANSMIT_BACKOFF_MIN_US (100)
+#define PCAN_TRANSMIT_BACKOFF_MAX_US (10000)
+
+// Interval at which a bus-off controller is polled for recovery
+#define PCAN_TRANSMIT_BUSOFF_POLL_US (50000)
+
+// Size of a packed result record, in bytes
+#define PCAN_TRANSMIT_RESULT_SIZE (24)
+
+// Result status of a frame cancelled before it was written; it lies outside
+// the range of TPCANStatus values
+#define PCAN_TRANSMIT_STATUS_CANCELLED (0x80000000U)
+
+// Result status of a frame replaced by a newer one with the same identifier
+// before it was written
+#define PCAN_TRANSMIT_STATUS_REPLACED (0x80000001U)
+
+// Result status of a frame discarded because its time to live ran out before
+// it could be written
+#define PCAN_TRANSMIT_STATUS_EXPIRED (0x80000002U)
+
+// Result status of a frame written to the driver whose echo was not received
+// within the confirmation timeout
+#define PCAN_TRANSMIT_STATUS_UNCONFIRMED (0x80000003U)
+
+// Most frames written to the driver and waiting for their echoes; the driver
+// holds fewer than this in its own transmit queue
+#define PCAN_TRANSMIT_CONFIRM_MAX (256)
+
+// Default time to wait for the echo of a written frame
+#define PCAN_TRANSMIT_CONFIRM_TIMEOUT_US (1000000)
+
+// Buckets of the latency histogram: bucket 0 counts latencies under 1 us, and
+// bucket n counts those from 2^(n-1) up to 2^n us, the last bucket taking
+// anything longer
+#define PCAN_TRANSMIT_LATENCY_BUCKETS (32)
+
+// Priority buckets, one for each 11-bit base identifier
+#define PCAN_TRANSMIT_BUCKETS (2048)
+#define PCAN_TRANSMIT_BUCKET_WORDS (PCAN_TRANSMIT_BUCKETS / 64)
+
+// Sources of frames, each with its own queue; a frame's source is given by
+// its reserved byte, and source 0 takes frames that name no other
+#define PCAN_TRANSMIT_SOURCES_MAX (16)
+
+// Bits of bus time a source is granted per round of deficit round-robin, for
+// each unit of its weight. It is the longest classic frame, so that every
+// source with a weight of 1 can send a frame per round.
+#define PCAN_TRANSMIT_QUANTUM_BITS (PCAN_FRAME_BITS_MAX)
+
+// Bus time the pacer lets frames be written back to back for, at the most
+// load allowed, before spacing them out
+#define PCAN_TRANSMIT_PACER_BURST_US (5000)
+
+// Interval over which the load this channel puts on the bus is measured
+#define PCAN_TRANSMIT_LOAD_WINDOW_US (100000)
+
+// Outcome of a queued frame. The layout is identical in memory and in Buffers
+// handed to JavaScript:
+//   offset  0  uint64  sequence number of the frame (see pcanTransmitPush)
+//   offset  8  uint32  TPCANStatus returned by CAN_Write, or
+//                      PCAN_TRANSMIT_STATUS_CANCELLED, _REPLACED, _EXPIRED, or
+//                      PCAN_TRANSMIT_STATUS_UNCONFIRMED
+//   offset 12  uint32  microseconds from being queued to being sent on the
+//                      bus, for a confirmed frame, otherwise 0
+//   offset 16  uint64  hardware timestamp of a confirmed frame's echo, in
+//                      microseconds, otherwise 0
+typedef struct pcanTransmitResult_s
+{
+    uint64_t seq;
+    uint32_t status;
+    uint32_t latencyUs;
+    uint64_t timestamp;
+} pcanTransmitResult_t;
+
+// Compile-time check that the compiler did not pad the record
+typedef char pcanTransmitResultSizeCheck_t[(sizeof(pcanTransmitResult_t) == PCAN_TRANSMIT_RESULT_SIZE) ? 1 : -1];
+
+// Frame waiting in the transmit queue
+typedef struct pcanTransmitEntry_s
+{
+    uint64_t seq;
+    pcanFrame_t frame;
+    uint64_t expiry;       // pcanTimeMicros time after which it is discarded, or 0
+    uint64_t queuedAt;     // pcanTimeMicros time it was queued
+    uint32_t key;          // Sort key; lower keys are written first
+    int32_t next;          // Next entry in the same bucket or free list, or -1
+    int32_t hashNext;      // Next coalescing entry in the same hash chain, or -1
+} pcanTransmitEntry_t;
+
+// Frame written to the driver, waiting for its echo
+typedef struct pcanTransmitWire_s
+{
+    uint64_t seq;
+    uint64_t queuedAt;     // pcanTimeMicros time it was queued
+    uint64_t writtenAt;    // pcanTimeMicros time CAN_Write accepted it
+    uint32_t id;
+    uint8_t msgtype;
+    uint8_t len;
+    uint8_t data[PCAN_FRAME_DATA_MAX];
+    int writing;           // CAN_Write has not yet returned
+    uint64_t echoedAt;     // pcanTimeMicros time its echo was read, or 0
+    uint64_t timestamp;    // Hardware timestamp of its echo
+} pcanTransmitWire_t;
+
+// Transmit queue options
+typedef struct pcanTransmitOptions_s
+{
+    uint32_t capacity;     // Frames held in the queue, or 0 for the default
+    int priority;          // Write in arbitration order rather than queued order
+    uint32_t bitrate;      // Nominal bit rate of the bus, in bits per second
+    double maxLoad;        // Most bus load to cause, in percent, or 0 for no limit
+    int confirm;           // Record results when echoes arrive, not when written
+    uint32_t confirmTimeoutUs; // Time to wait for an echo, or 0 for the default
+} pcanTransmitOptions_t;
+
+// Called on the writer thread when results become available
+typedef void (*pcanTransmitNotify_t)(void *context);
+
+// Transmit statistics
+typedef struct pcanTransmitStats_s
+{
+    uint64_t queued;       // Frames accepted by pcanTransmitPush
+    uint64_t sent;         // Frames accepted by CAN_Write
+    uint64_t errors;       // Frames CAN_Write rejected
+    uint64_t cancelled;    // Frames removed by pcanTransmitCancel
+    uint64_t replaced;     // Frames replaced by newer ones with the same ID
+    uint64_t expired;      // Frames discarded when their time to live ran out
+    uint64_t retries;      // Writes retried because the driver queue was full
+    uint64_t busOffs;      // Times the queue was held for bus-off
+    uint64_t paced;        // Times a frame was held back to stay under maxLoad
+    uint64_t confirmed;    // Frames whose echoes were received
+    uint64_t unconfirmed;  // Frames whose echoes were not received in time
+    uint64_t discarded;    // Frames still queued when the queue was stopped
+    uint32_t pending;      // Frames in the queue now
+    uint32_t unsent;       // Frames written and waiting for their echoes now
+    int busOff;            // The queue is being held for bus-off
+    double load;           // Percent of bus time taken by frames written over
+                           // the last PCAN_TRANSMIT_LOAD_WINDOW_US
+    TPCANStatus lastError; // Last status other than PCAN_ERROR_OK
+} pcanTransmitStats_t;
+
+// Histogram of the time confirmed frames took from being queued to being sent
+// on the bus, as seen when their echoes were read from the driver
+typedef struct pcanTransmitLatency_s
+{
+    uint64_t count;
+    uint64_t sumUs;
+    uint64_t maxUs;
+    uint64_t buckets[PCAN_TRANSMIT_LATENCY_BUCKETS];
+} pcanTransmitLatency_t;
+
+// Transmit source settings
+typedef struct pcanTransmitSourceOptions_s
+{
+    uint32_t weight;       // Share of the bus relative to other sources, at least 1
+    double rate;           // Frames per second at most, or 0 for no limit
+    double burst;          // Frames that may be sent back to back within the rate
+} pcanTransmitSourceOptions_t;
+
+// Transmit source statistics
+typedef struct pcanTransmitSourceStats_s
+{
+    uint64_t queued;       // Frames queued from the source
+    uint64_t sent;         // Frames accepted by CAN_Write
+    uint64_t throttled;    // Times the source reached its rate limit
+    uint64_t meanLatencyUs; // Time from being queued to being written
+    uint64_t maxLatencyUs;
+    uint32_t pending;      // Frames in the source's queue now
+} pcanTransmitSourceStats_t;
+
+// Queue of frames from one source, linked into buckets by key; in queued
+// order, every frame has key 0 and shares the first bucket
+typedef struct pcanTransmitSource_s
+{
+    pcanTransmitSourceOptions_t options;
+
+    int32_t bucketHead[PCAN_TRANSMIT_BUCKETS];
+    int32_t bucketTail[PCAN_TRANSMIT_BUCKETS];
+    uint64_t bucketMap[PCAN_TRANSMIT_BUCKET_WORDS]; // Non-empty buckets
+    uint32_t bucketSummary; // Non-zero words of bucketMap
+    uint32_t count;
+
+    int64_t deficit;       // Bits the source may still send this round
+    double tokens;         // Frames the source may send now under its rate limit
+    uint64_t refilled;     // pcanTimeMicros time tokens were last added
+    int throttled;         // At its rate limit since it last could send
+
+    uint64_t latencySumUs;
+    pcanTransmitSourceStats_t stats;
+} pcanTransmitSource_t;
+
+// Transmit queue state for one channel
+typedef struct pcanTransmit_s
+{
+    pcanMutex_t lock;
+    pcanCond_t wake;
+    pcanThread_t thread;
+
+    TPCANHandle channel;
+    pcanTransmitOptions_t options;
+    pcanTransmitNotify_t notify;
+    void *notifyContext;
+
+    // Frames waiting to be written, in the queues of their sources
+    pcanTransmitEntry_t *queue;
+    uint32_t queueCapacity;
+    uint32_t queueCount;
+    int32_t queueFree;     // First unused entry
+    int32_t inFlight;      // Entry being written by the writer thread, or -1
+    uint64_t nextSeq;
+
+    // Sources, created when first configured or used, and the round-robin
+    // position among them
+    pcanTransmitSource_t *sources[PCAN_TRANSMIT_SOURCES_MAX];
+    uint32_t current;      // Source being served
+    int granted;           // The current source has had its quantum this visit
+    int throttled;         // The writer is waiting for a rate limit
+
+    // Token bucket, in bits, that holds writes to options.maxLoad of the bus
+    double paceTokens;
+    double paceBurst;
+    uint64_t paceRefilled; // pcanTimeMicros time tokens were last added
+
+    // Bits written in the current load measurement window
+    uint64_t loadStart;    // pcanTimeMicros time the window started
+    uint64_t loadBits;
+
+    // Frames written and waiting for their echoes, oldest first
+    pcanTransmitWire_t wire[PCAN_TRANSMIT_CONFIRM_MAX];
+    uint32_t wireHead;
+    uint32_t wireCount;
+    pcanTransmitLatency_t latency;
+
+    // Chains of pending coalescing entries, by identifier
+    int32_t *hashHead;
+    uint32_t hashMask;
+
+    // Results waiting to be collected by JavaScript. There is room for a
+    // result for every queued frame and as many again, after which the writer
+    // waits for JavaScript to catch up. Results recorded other than by the
+    // writer leave the last place free, so the writer always has room for
+    // the frame it is writing, and a place is kept for every frame waiting
+    // for its echo.
+    pcanTransmitResult_t *results;
+    uint32_t resultCapacity;
+    uint32_t resultHead;
+    uint32_t resultCount;
+    int notifyPending;     // JavaScript has been notified but not emptied the ring
+
+    int stop;
+    pcanTransmitStats_t stats;
+} pcanTransmit_t;
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Global variables
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local variables
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local functions
+
+// Writer thread process, started by pcanTransmitStart
+void pcanTransmitThreadProc(void *arg);
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Public functions
+
+// Create a transmit queue for a channel, and start its writer thread. If
+// options->maxLoad is set, frames are spaced out so that, by their longest
+// possible length on the wire, they take at most that share of the bus. If
+// options->confirm is set, the driver must have echo frames enabled, and the
+// echoes must be passed to pcanTransmitConfirm.
+// notify(context) is called on the writer thread, or on the thread calling
+// pcanTransmitCancel, when results become available.
+// Returns the new queue, or 0 on failure (with a reason in *error)
+pcanTransmit_t *pcanTransmitStart(TPCANHandle channel, const pcanTransmitOptions_t *options,
+                                  pcanTransmitNotify_t notify, void *context,
+                                  const char **error);
+
+// Queue frames in order, as many as there is room for. Frames are numbered
+// consecutively from 0, in the order they are queued, and their results
+// carry the same numbers. A frame flagged PCAN_FRAME_FLAG_COALESCE replaces
+// a pending coalescing frame with the same identifier and message type, whose
+// result is PCAN_TRANSMIT_STATUS_REPLACED. A frame's timestamp, if nonzero,
+// is its time to live in microseconds from now, after which it is discarded
+// with the result PCAN_TRANSMIT_STATUS_EXPIRED.
+// Frames from different sources are written by deficit round-robin, each
+// source having a share of the bus in proportion to its weight; a frame whose
+// source does not exist is created with a weight of 1, or if it cannot be,
+// queued as from source 0.
+// Returns the number of frames queued
+uint32_t pcanTransmitPush(pcanTransmit_t *tx, const pcanFrame_t *frames, uint32_t count);
+
+// Remove the pending frames with an identifier, other than one being written
+// at the moment, recording PCAN_TRANSMIT_STATUS_CANCELLED as their result.
+// ext selects extended rather than standard frames.
+// Returns the number of frames cancelled, which stops short if the result
+// ring fills
+uint32_t pcanTransmitCancel(pcanTransmit_t *tx, uint32_t id, int ext);
+
+// Create a source, or change the settings of an existing one
+// Returns 0 on success, or nonzero if the source is out of range or there is
+// no memory for it
+int pcanTransmitSetSource(pcanTransmit_t *tx, uint32_t source,
+                          const pcanTransmitSourceOptions_t *options);
+
+// Copy the current statistics of a source
+// Returns 0 on success, or nonzero if the source does not exist
+int pcanTransmitGetSourceStats(pcanTransmit_t *tx, uint32_t source,
+                               pcanTransmitSourceStats_t *stats);
+
+// Match echo frames, those with PCAN_FRAME_FLAG_TX set, to the frames
+// waiting for them, recording their results; other frames are ignored.
+// hostTimes holds the pcanTimeMicros time each frame was read from the
+// driver. Called from the receive worker thread.
+void pcanTransmitConfirm(pcanTransmit_t *tx, const pcanFrame_t *frames,
+                         const uint64_t *hostTimes, uint32_t count);
+
+// Copy the latency histogram of confirmed frames
+void pcanTransmitGetLatency(pcanTransmit_t *tx, pcanTransmitLatency_t *latency);
+
+// Move up to max of the oldest results out of the ring
+// Returns the number of results copied
+uint32_t pcanTransmitResults(pcanTransmit_t *tx, pcanTransmitResult_t *results, uint32_t max);
+
+// Return the number of results waiting in the ring
+uint32_t pcanTransmitResultsPending(pcanTransmit_t *tx);
+
+// Copy the current statistics
+void pcanTransmitGetStats(pcanTransmit_t *tx, pcanTransmitStats_t *stats);
+
+// Stop the writer thread, discarding any frames still queued, and free the
+// queue. The final statistics are copied to stats if it is not 0.
+void pcanTransmitStop(pcanTransmit_t *tx, pcanTransmitStats_t *stats);
+
+
+
+
+#endif // _PCAN_TRANSMIT_H_
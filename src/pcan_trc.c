@@ -0,0 +1,919 @@
+/* PEAK trace (.trc) files
+
+   Writes captured frames as PEAK trace files, version 2.1, in the layout
+   produced by PCAN-View, and reads version 2.0 and 2.1 trace files back as
+   batches of frame records.
+
+   Copyright (c) 2020 Control Solutions LLC. All rights reserved.
+*/
+
+#include <stdio.h>       // provide fopen, fread, and snprintf
+#include <stdlib.h>      // provide calloc, malloc, free, and strtod
+#include <string.h>      // provide memchr, memcpy, memmove, and strncmp
+
+#include "pcan_trc.h"
+
+
+// ----------------------------------- // -----------------------------------
+// Definitions
+
+// Longest line the writer produces: "%7u %13.3f TT %2u %8X Rx -  %-4u " plus
+// eight data bytes and a newline, with room for message numbers beyond seven
+// digits
+#define TRC_LINE_MAX (96)
+
+// Number of lines the writer formats before handing them to the capture
+#define TRC_WRITE_LINES (256)
+
+// OLE automation date of the Unix epoch, in days since 1899-12-30
+#define TRC_UNIX_EPOCH_DAYS (25569.0)
+
+#define TRC_MICROS_PER_DAY (86400000000.0)
+
+// Per-file writer state
+typedef struct trcWriterState_s
+{
+    uint32_t number;       // Message number of the last line written
+    int headerWritten;
+    char text[TRC_WRITE_LINES * TRC_LINE_MAX];
+} trcWriterState_t;
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Global variables
+
+
+// Trace format functions, defined below
+static int trcWrite(pcanCapture_t *capture, const pcanFrame_t *frames, uint32_t count);
+static int trcEnd(pcanCapture_t *capture);
+
+const pcanCaptureFormat_t pcanCaptureFormatTrc = {
+    "trc",
+    0, // begin; the header is written with the first frame
+    trcWrite,
+    trcEnd,
+    0, // flush
+    sizeof(trcWriterState_t),
+    0, // seekable
+};
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local variables
+
+
+static const char trcHexDigits[] = "0123456789ABCDEF";
+
+// Columns assumed for a version 2.0 file with no $COLUMNS line
+static const char trcDefaultColumns[] = "NOTIdlD";
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local functions
+
+
+// Write value right-aligned in a field of at least width characters
+// Returns a pointer past the field
+static char *trcPutDecimal(char *p, uint64_t value, int width)
+{
+    char digits[20];
+    int n = 0;
+
+    do
+    {
+        digits[n++] = (char)('0' + (value % 10));
+        value /= 10;
+    } while (value != 0);
+
+    while (width-- > n)
+    {
+        *p++ = ' ';
+    }
+
+    while (n > 0)
+    {
+        *p++ = digits[--n];
+    }
+
+    return p;
+}
+
+
+
+
+// Write the low (digits * 4) bits of value as uppercase hexadecimal
+// Returns a pointer past the digits
+static char *trcPutHex(char *p, uint32_t value, int digits)
+{
+    int i;
+
+    for (i = digits - 1; i >= 0; i--)
+    {
+        p[i] = trcHexDigits[value & 0x0F];
+        value >>= 4;
+    }
+
+    return p + digits;
+}
+
+
+
+
+// Return the TRC message type for a frame, or 0 if the frame is not written
+static const char *trcMessageType(const pcanFrame_t *frame)
+{
+    if (frame->msgtype & (PCAN_MESSAGE_STATUS | PCAN_MESSAGE_ERRFRAME))
+    {
+        return 0;
+    }
+
+    if (frame->msgtype & PCAN_MESSAGE_FD)
+    {
+        switch (frame->msgtype & (PCAN_MESSAGE_BRS | PCAN_MESSAGE_ESI))
+        {
+        case PCAN_MESSAGE_BRS:
+            return "FB";
+        case PCAN_MESSAGE_ESI:
+            return "FE";
+        case PCAN_MESSAGE_BRS | PCAN_MESSAGE_ESI:
+            return "BI";
+        default:
+            return "FD";
+        }
+    }
+
+    return (frame->msgtype & PCAN_MESSAGE_RTR) ? "RR" : "DT";
+}
+
+
+
+
+// Format one message line
+// Returns a pointer past the newline
+static char *trcFormatLine(char *p, uint32_t number, uint64_t offsetUs,
+                           const char *type, const pcanFrame_t *frame)
+{
+    uint8_t len = (frame->len > PCAN_FRAME_DATA_MAX) ? PCAN_FRAME_DATA_MAX : frame->len;
+    int i;
+
+    // Message number and time offset in milliseconds
+    p = trcPutDecimal(p, number, 7);
+    *p++ = ' ';
+    p = trcPutDecimal(p, offsetUs / 1000, 9);
+    *p++ = '.';
+    *p++ = (char)('0' + (offsetUs % 1000) / 100);
+    *p++ = (char)('0' + (offsetUs % 100) / 10);
+    *p++ = (char)('0' + (offsetUs % 10));
+
+    // Type and bus
+    *p++ = ' ';
+    *p++ = type[0];
+    *p++ = type[1];
+    memcpy(p, "  1 ", 4);
+    p += 4;
+
+    // Identifier, right-aligned in eight columns
+    if (frame->msgtype & PCAN_MESSAGE_EXTENDED)
+    {
+        p = trcPutHex(p, frame->id, 8);
+    }
+    else
+    {
+        memset(p, ' ', 4);
+        p = trcPutHex(p + 4, frame->id, 4);
+    }
+
+    // Direction, reserved, and DLC
+    memcpy(p, (frame->flags & PCAN_FRAME_FLAG_TX) ? " Tx -  " : " Rx -  ", 7);
+    p += 7;
+    p = trcPutDecimal(p, len, 1);
+
+    // Data, which remote frames do not have
+    if (!(frame->msgtype & PCAN_MESSAGE_RTR))
+    {
+        *p++ = ' ';
+        *p++ = ' ';
+        *p++ = ' ';
+        for (i = 0; i < len; i++)
+        {
+            *p++ = ' ';
+            *p++ = trcHexDigits[frame->data[i] >> 4];
+            *p++ = trcHexDigits[frame->data[i] & 0x0F];
+        }
+    }
+
+    *p++ = '\n';
+
+    return p;
+}
+
+
+
+
+// Convert days since 1970-01-01 to a civil date
+static void trcCivilDate(int64_t days, int *year, int *month, int *day)
+{
+    int64_t era, dayOfEra, yearOfEra, dayOfYear, mp;
+
+    days += 719468;
+    era = (days >= 0 ? days : days - 146096) / 146097;
+    dayOfEra = days - era * 146097;
+    yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    mp = (5 * dayOfYear + 2) / 153;
+
+    *day = (int)(dayOfYear - (153 * mp + 2) / 5 + 1);
+    *month = (int)(mp < 10 ? mp + 3 : mp - 9);
+    *year = (int)(yearOfEra + era * 400 + (*month <= 2));
+
+    return;
+}
+
+
+
+
+// Write the file header, for a file starting at a wall clock time in
+// microseconds since the Unix epoch
+static int trcWriteHeader(pcanCapture_t *capture, uint64_t startTime)
+{
+    trcWriterState_t *state = (trcWriterState_t*)capture->formatState;
+    uint64_t seconds = startTime / 1000000;
+    uint64_t micros = startTime % 1000000;
+    int year, month, day;
+    int length = 0;
+
+    trcCivilDate((int64_t)(seconds / 86400), &year, &month, &day);
+
+    length = snprintf(state->text, sizeof(state->text),
+        ";$FILEVERSION=2.1\n"
+        ";$STARTTIME=%.10f\n"
+        ";$COLUMNS=N,O,T,B,I,d,R,L,D\n"
+        ";\n"
+        ";   %s\n"
+        ";   Start time: %02d.%02d.%04d %02u:%02u:%02u.%03u.%u (UTC)\n"
+        ";   Generated by cs-pcan-usb\n"
+        ";-------------------------------------------------------------------------------\n"
+        ";   Bus   Name   Connection               Protocol  Bit rate\n"
+        ";   1     PCAN   0x%02X                     CAN       %u\n"
+        ";-------------------------------------------------------------------------------\n"
+        ";   Message   Time    Type    ID     Rx/Tx\n"
+        ";   Number    Offset  |  Bus  [hex]  |  Reserved\n"
+        ";   |         [ms]    |  |    |      |  |  Data Length Code\n"
+        ";   |         |       |  |    |      |  |  |    Data [hex] ...\n"
+        ";   |         |       |  |    |      |  |  |    |\n"
+        ";-------------------------------------------------------------------------------\n",
+        (double)startTime / TRC_MICROS_PER_DAY + TRC_UNIX_EPOCH_DAYS,
+        capture->fileName,
+        day, month, year,
+        (unsigned)((seconds / 3600) % 24), (unsigned)((seconds / 60) % 60),
+        (unsigned)(seconds % 60), (unsigned)(micros / 1000), (unsigned)((micros % 1000) / 100),
+        capture->options.channel, capture->options.bitrate);
+
+    if ((length < 0) || ((size_t)length >= sizeof(state->text)))
+    {
+        length = (int)strlen(state->text);
+    }
+
+    state->headerWritten = 1;
+
+    return pcanCaptureOutput(capture, state->text, (size_t)length);
+}
+
+
+
+
+static int trcWrite(pcanCapture_t *capture, const pcanFrame_t *frames, uint32_t count)
+{
+    trcWriterState_t *state = (trcWriterState_t*)capture->formatState;
+    const char *type = 0;
+    char *p = 0;
+    uint32_t lines = 0;
+    uint64_t offset = 0;
+    uint32_t i;
+    int ret = 0;
+
+    // Times in the file are offsets from the first frame, so the header is
+    // only written once that frame is known
+    if (!state->headerWritten)
+    {
+        ret |= trcWriteHeader(capture, pcanCaptureWallTime(capture, capture->fileFirstTimestamp));
+    }
+
+    p = state->text;
+
+    for (i = 0; i < count; i++)
+    {
+        type = trcMessageType(&frames[i]);
+        if (type == 0)
+        {
+            continue;
+        }
+
+        offset = (frames[i].timestamp > capture->fileFirstTimestamp) ?
+                 frames[i].timestamp - capture->fileFirstTimestamp : 0;
+
+        p = trcFormatLine(p, ++state->number, offset, type, &frames[i]);
+
+        if (++lines == TRC_WRITE_LINES)
+        {
+            ret |= pcanCaptureOutput(capture, state->text, (size_t)(p - state->text));
+            p = state->text;
+            lines = 0;
+        }
+    }
+
+    if (p != state->text)
+    {
+        ret |= pcanCaptureOutput(capture, state->text, (size_t)(p - state->text));
+    }
+
+    return ret;
+}
+
+
+
+
+static int trcEnd(pcanCapture_t *capture)
+{
+    trcWriterState_t *state = (trcWriterState_t*)capture->formatState;
+
+    // A file with no frames still gets a header
+    if (!state->headerWritten)
+    {
+        return trcWriteHeader(capture, capture->fileStartWallUs);
+    }
+
+    return 0;
+}
+
+
+
+
+// Return the value of a hexadecimal digit, or -1
+static int trcHexValue(char c)
+{
+    if ((c >= '0') && (c <= '9'))
+    {
+        return c - '0';
+    }
+    if ((c >= 'A') && (c <= 'F'))
+    {
+        return c - 'A' + 10;
+    }
+    if ((c >= 'a') && (c <= 'f'))
+    {
+        return c - 'a' + 10;
+    }
+
+    return -1;
+}
+
+
+
+
+// Parse an unsigned hexadecimal field
+// Returns 0 on success, or 1 if the field is empty or not hexadecimal
+static int trcParseHex(const char *p, size_t length, uint32_t *value)
+{
+    uint32_t result = 0;
+    int digit = 0;
+    size_t i;
+
+    if ((length == 0) || (length > 8))
+    {
+        return 1;
+    }
+
+    for (i = 0; i < length; i++)
+    {
+        digit = trcHexValue(p[i]);
+        if (digit < 0)
+        {
+            return 1;
+        }
+        result = (result << 4) | (uint32_t)digit;
+    }
+
+    *value = result;
+
+    return 0;
+}
+
+
+
+
+// Parse an unsigned decimal field
+// Returns 0 on success, or 1 if the field is empty or not decimal
+static int trcParseDecimal(const char *p, size_t length, uint32_t *value)
+{
+    uint32_t result = 0;
+    size_t i;
+
+    if (length == 0)
+    {
+        return 1;
+    }
+
+    for (i = 0; i < length; i++)
+    {
+        if ((p[i] < '0') || (p[i] > '9'))
+        {
+            return 1;
+        }
+        result = result * 10 + (uint32_t)(p[i] - '0');
+    }
+
+    *value = result;
+
+    return 0;
+}
+
+
+
+
+// Parse a time offset in milliseconds, with up to three decimal places kept,
+// into microseconds
+// Returns 0 on success, or 1 if the field is not a number
+static int trcParseOffset(const char *p, size_t length, uint64_t *micros)
+{
+    uint64_t whole = 0;
+    uint64_t fraction = 0;
+    int places = 0;
+    int digits = 0;
+    size_t i = 0;
+
+    for (; (i < length) && (p[i] >= '0') && (p[i] <= '9'); i++, digits++)
+    {
+        whole = whole * 10 + (uint64_t)(p[i] - '0');
+    }
+
+    if ((i < length) && (p[i] == '.'))
+    {
+        for (i++; (i < length) && (p[i] >= '0') && (p[i] <= '9'); i++, digits++)
+        {
+            if (places < 3)
+            {
+                fraction = fraction * 10 + (uint64_t)(p[i] - '0');
+                places++;
+            }
+        }
+    }
+
+    if ((digits == 0) || (i != length))
+    {
+        return 1;
+    }
+
+    for (; places < 3; places++)
+    {
+        fraction *= 10;
+    }
+
+    *micros = whole * 1000 + fraction;
+
+    return 0;
+}
+
+
+
+
+// Handle a comment line, which may hold a header keyword
+static void trcParseComment(pcanTrcReader_t *reader, const char *line, size_t length)
+{
+    char text[128];
+    const char *value = 0;
+    double days = 0;
+    uint32_t i;
+
+    if (length >= sizeof(text))
+    {
+        return;
+    }
+
+    memcpy(text, line, length);
+    text[length] = 0;
+
+    if (strncmp(text, ";$FILEVERSION=", 14) == 0)
+    {
+        value = text + 14;
+        reader->version = (uint32_t)(strtod(value, 0) * 10.0 + 0.5);
+    }
+    else if (strncmp(text, ";$STARTTIME=", 12) == 0)
+    {
+        days = strtod(text + 12, 0);
+        reader->startTime = (days > TRC_UNIX_EPOCH_DAYS) ?
+            (uint64_t)((days - TRC_UNIX_EPOCH_DAYS) * TRC_MICROS_PER_DAY + 0.5) : 0;
+    }
+    else if (strncmp(text, ";$COLUMNS=", 10) == 0)
+    {
+        reader->columnCount = 0;
+        for (value = text + 10; *value != 0; value++)
+        {
+            if ((*value == ',') || (*value == ' ') || (*value == '\r'))
+            {
+                continue;
+            }
+            if (reader->columnCount < PCAN_TRC_COLUMNS_MAX)
+            {
+                reader->columns[reader->columnCount++] = *value;
+            }
+        }
+        for (i = reader->columnCount; i < PCAN_TRC_COLUMNS_MAX; i++)
+        {
+            reader->columns[i] = 0;
+        }
+    }
+
+    return;
+}
+
+
+
+
+// Parse a message line into a frame
+// Returns 1 if the line was a data frame, or 0 if it was skipped
+static int trcParseMessage(pcanTrcReader_t *reader, const char *line, size_t length,
+                           pcanFrame_t *frame)
+{
+    const char *field[PCAN_TRC_COLUMNS_MAX];
+    size_t fieldLength[PCAN_TRC_COLUMNS_MAX];
+    const char *type = 0;
+    uint32_t value = 0;
+    size_t pos = 0;
+    size_t start = 0;
+    uint32_t n = 0;
+    uint32_t i = 0;
+    int high = -1;
+    int digit = 0;
+    int haveId = 0;
+    int haveTime = 0;
+    int haveType = 0;
+
+    // Split into whitespace-separated fields; the data column takes the rest
+    // of the line
+    while (n < reader->columnCount)
+    {
+        while ((pos < length) && ((line[pos] == ' ') || (line[pos] == '\t')))
+        {
+            pos++;
+        }
+        if (pos == length)
+        {
+            break;
+        }
+
+        start = pos;
+        if (reader->columns[n] == 'D')
+        {
+            pos = length;
+        }
+        else
+        {
+            while ((pos < length) && (line[pos] != ' ') && (line[pos] != '\t'))
+            {
+                pos++;
+            }
+        }
+
+        field[n] = line + start;
+        fieldLength[n] = pos - start;
+        n++;
+    }
+
+    memset(frame, 0, sizeof(*frame));
+
+    for (i = 0; i < n; i++)
+    {
+        switch (reader->columns[i])
+        {
+        case 'O':
+            if (trcParseOffset(field[i], fieldLength[i], &(frame->timestamp)) != 0)
+            {
+                return 0;
+            }
+            haveTime = 1;
+            break;
+
+        case 'T':
+            if (fieldLength[i] != 2)
+            {
+                return 0;
+            }
+            type = field[i];
+            if ((type[0] == 'D') && (type[1] == 'T'))
+            {
+                frame->msgtype = PCAN_MESSAGE_STANDARD;
+            }
+            else if ((type[0] == 'R') && (type[1] == 'R'))
+            {
+                frame->msgtype = PCAN_MESSAGE_RTR;
+            }
+            else if ((type[0] == 'F') && (type[1] == 'D'))
+            {
+                frame->msgtype = PCAN_MESSAGE_FD;
+            }
+            else if ((type[0] == 'F') && (type[1] == 'B'))
+            {
+                frame->msgtype = PCAN_MESSAGE_FD | PCAN_MESSAGE_BRS;
+            }
+            else if ((type[0] == 'F') && (type[1] == 'E'))
+            {
+                frame->msgtype = PCAN_MESSAGE_FD | PCAN_MESSAGE_ESI;
+            }
+            else if ((type[0] == 'B') && (type[1] == 'I'))
+            {
+                frame->msgtype = PCAN_MESSAGE_FD | PCAN_MESSAGE_BRS | PCAN_MESSAGE_ESI;
+            }
+            else
+            {
+                // Error, status, and other event lines
+                return 0;
+            }
+            haveType = 1;
+            break;
+
+        case 'I':
+            if (trcParseHex(field[i], fieldLength[i], &(frame->id)) != 0)
+            {
+                return 0;
+            }
+            haveId = (fieldLength[i] > 4) ? 2 : 1;
+            break;
+
+        case 'd':
+            if ((fieldLength[i] == 2) && (field[i][0] == 'T'))
+            {
+                frame->flags |= PCAN_FRAME_FLAG_TX;
+            }
+            break;
+
+        case 'L':
+        case 'l':
+            // DLC and length are the same for every frame that fits a record
+            if ((trcParseDecimal(field[i], fieldLength[i], &value) != 0) ||
+                (value > PCAN_FRAME_DATA_MAX))
+            {
+                return 0;
+            }
+            frame->len = (uint8_t)value;
+            break;
+
+        case 'D':
+            // Hexadecimal bytes separated by spaces
+            value = 0;
+            for (pos = 0; pos < fieldLength[i]; pos++)
+            {
+                digit = trcHexValue(field[i][pos]);
+                if (digit < 0)
+                {
+                    high = -1;
+                    continue;
+                }
+                if (high < 0)
+                {
+                    high = digit;
+                }
+                else if (value < PCAN_FRAME_DATA_MAX)
+                {
+                    frame->data[value++] = (uint8_t)((high << 4) | digit);
+                    high = -1;
+                }
+            }
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    if (!haveTime || !haveType || !haveId)
+    {
+        return 0;
+    }
+
+    if (haveId == 2)
+    {
+        frame->msgtype |= PCAN_MESSAGE_EXTENDED;
+    }
+
+    if (frame->msgtype & PCAN_MESSAGE_RTR)
+    {
+        memset(frame->data, 0, sizeof(frame->data));
+    }
+
+    return 1;
+}
+
+
+
+
+// Find the next line in the file, refilling the buffer as needed
+// Returns 1 with the line in *line and *length (without the line ending), or
+// 0 at the end of the file
+static int trcNextLine(pcanTrcReader_t *reader, const char **line, size_t *length)
+{
+    char *start = 0;
+    char *end = 0;
+    size_t n = 0;
+    int overlong = 0;
+
+    while (1)
+    {
+        start = reader->buffer + reader->pos;
+        end = memchr(start, '\n', reader->fill - reader->pos);
+
+        if (end != 0)
+        {
+            reader->pos += (size_t)(end - start) + 1;
+
+            // The tail of a line too long for the buffer
+            if (overlong)
+            {
+                overlong = 0;
+                continue;
+            }
+
+            *line = start;
+            *length = (size_t)(end - start);
+            break;
+        }
+
+        if (reader->eof)
+        {
+            if ((reader->pos == reader->fill) || overlong)
+            {
+                reader->pos = reader->fill;
+                return 0;
+            }
+
+            *line = start;
+            *length = reader->fill - reader->pos;
+            reader->pos = reader->fill;
+            break;
+        }
+
+        // Discard a line that fills the whole buffer
+        if ((reader->pos == 0) && (reader->fill == PCAN_TRC_READ_BUFFER_SIZE))
+        {
+            reader->lines++;
+            reader->skipped++;
+            reader->fill = 0;
+            overlong = 1;
+        }
+
+        // Move the partial line to the front and read more after it
+        memmove(reader->buffer, start, reader->fill - reader->pos);
+        reader->fill -= reader->pos;
+        reader->pos = 0;
+
+        n = fread(reader->buffer + reader->fill, 1,
+                  PCAN_TRC_READ_BUFFER_SIZE - reader->fill, reader->file);
+        reader->fill += n;
+        if (n == 0)
+        {
+            reader->eof = 1;
+        }
+    }
+
+    if ((*length > 0) && ((*line)[*length - 1] == '\r'))
+    {
+        (*length)--;
+    }
+
+    return 1;
+}
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Public functions
+
+
+pcanTrcReader_t *pcanTrcOpen(const char *path, const char **error)
+{
+    pcanTrcReader_t *reader = 0;
+    const char *line = 0;
+    size_t length = 0;
+    size_t skip = 0;
+
+    reader = calloc(1, sizeof(*reader));
+    if (reader != 0)
+    {
+        reader->buffer = malloc(PCAN_TRC_READ_BUFFER_SIZE);
+    }
+    if ((reader == 0) || (reader->buffer == 0))
+    {
+        free(reader);
+        *error = "Error allocating memory for trace reader.";
+        return 0;
+    }
+
+    reader->file = fopen(path, "rb");
+    if (reader->file == 0)
+    {
+        pcanTrcClose(reader);
+        *error = "Unable to open trace file.";
+        return 0;
+    }
+
+    // Read the header, which is every comment line before the first message
+    while (trcNextLine(reader, &line, &length))
+    {
+        for (skip = 0; (skip < length) && (line[skip] == ' '); skip++)
+            ;
+
+        if ((skip < length) && (line[skip] != ';'))
+        {
+            // Leave the first message to be read by pcanTrcRead. The line is
+            // still in the buffer, since nothing has been read since.
+            reader->pos = (size_t)(line - reader->buffer);
+            break;
+        }
+
+        trcParseComment(reader, line + skip, length - skip);
+    }
+
+    if ((reader->version != 20) && (reader->version != 21))
+    {
+        pcanTrcClose(reader);
+        *error = "Only version 2.0 and 2.1 trace files are supported.";
+        return 0;
+    }
+
+    if (reader->columnCount == 0)
+    {
+        memcpy(reader->columns, trcDefaultColumns, sizeof(trcDefaultColumns) - 1);
+        reader->columnCount = sizeof(trcDefaultColumns) - 1;
+    }
+
+#ifdef PCAN_DEBUG
+    printf("pcanTrcOpen: \"%s\", version = %u, columns = %u\n",
+           path, reader->version, reader->columnCount);
+#endif
+
+    return reader;
+}
+
+
+
+
+uint32_t pcanTrcRead(pcanTrcReader_t *reader, pcanFrame_t *frames, uint32_t max)
+{
+    const char *line = 0;
+    size_t length = 0;
+    size_t skip = 0;
+    uint32_t count = 0;
+
+    while ((count < max) && trcNextLine(reader, &line, &length))
+    {
+        for (skip = 0; (skip < length) && (line[skip] == ' '); skip++)
+            ;
+
+        if (skip == length)
+        {
+            continue;
+        }
+
+        if (line[skip] == ';')
+        {
+            trcParseComment(reader, line + skip, length - skip);
+            continue;
+        }
+
+        reader->lines++;
+
+        if (trcParseMessage(reader, line + skip, length - skip, &frames[count]))
+        {
+            count++;
+        }
+        else
+        {
+            reader->skipped++;
+        }
+    }
+
+    return count;
+}
+
+
+
+
+void pcanTrcClose(pcanTrcReader_t *reader)
+{
+    if (reader->file != 0)
+    {
+        fclose(reader->file);
+    }
+
+    free(reader->buffer);
+    free(reader);
+
+    return;
+}
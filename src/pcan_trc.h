@@ -0,0 +1,104 @@
+/* PEAK trace (.trc) files
+
+   Writes captured frames as PEAK trace files, version 2.1, in the layout
+   produced by PCAN-View, and reads version 2.0 and 2.1 trace files back as
+   batches of frame records.
+
+   The writer is a capture format (see pcan_capture.h), so formatting happens
+   on the capture writer thread. Lines are built with table-driven decimal
+   and hexadecimal conversion rather than printf, since a busy bus produces
+   tens of thousands of lines per second.
+
+   The reader streams the file through a fixed-size buffer, so files of any
+   size can be read. Frame timestamps are the message time offsets, in
+   microseconds; the wall clock start time of the file is available
+   separately.
+
+   Copyright (c) 2020 Control Solutions LLC. All rights reserved.
+*/
+
+#ifndef _PCAN_TRC_H_
+#define _PCAN_TRC_H_
+
+#include <stddef.h>      // provide size_t
+#include <stdint.h>      // provide uintX_t
+#include <stdio.h>       // provide FILE
+
+#include "pcan_capture.h" // provide pcanCaptureFormat_t
+#include "pcan_frame.h"  // provide pcanFrame_t
+
+
+// ----------------------------------- // -----------------------------------
+// Definitions
+
+// Size of the buffer the reader streams the file through. Longer lines are
+// skipped.
+#define PCAN_TRC_READ_BUFFER_SIZE (256 * 1024)
+
+// Maximum number of columns in a $COLUMNS header
+#define PCAN_TRC_COLUMNS_MAX (16)
+
+// Open trace file being read
+typedef struct pcanTrcReader_s
+{
+    FILE *file;
+    char *buffer;
+    size_t fill;           // Bytes in the buffer
+    size_t pos;            // Start of the next unparsed line
+    int eof;               // The whole file has been read into the buffer
+
+    uint32_t version;      // File version * 10 (20 or 21)
+    uint64_t startTime;    // $STARTTIME, microseconds since the Unix epoch
+                           // (0 if not present)
+    uint64_t lines;        // Message lines read
+    uint64_t skipped;      // Message lines that were not data frames, or
+                           // could not be parsed
+
+    // Column letters from $COLUMNS, in order
+    char columns[PCAN_TRC_COLUMNS_MAX];
+    uint32_t columnCount;
+} pcanTrcReader_t;
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Global variables
+
+// Trace file capture format
+extern const pcanCaptureFormat_t pcanCaptureFormatTrc;
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local variables
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Local functions
+
+
+
+
+// ----------------------------------- // -----------------------------------
+// Public functions
+
+// Open a trace file and read its header
+// Returns the reader, or 0 on failure (with a reason in *error)
+pcanTrcReader_t *pcanTrcOpen(const char *path, const char **error);
+
+// Read up to max data frames into frames. Status, error, and other non-data
+// lines, and frames longer than PCAN_FRAME_DATA_MAX, are counted as skipped.
+// Returns the number of frames read, which is 0 at the end of the file.
+uint32_t pcanTrcRead(pcanTrcReader_t *reader, pcanFrame_t *frames, uint32_t max);
+
+// Close the file and free the reader
+void pcanTrcClose(pcanTrcReader_t *reader);
+
+
+
+
+#endif // _PCAN_TRC_H_
@@ -9,7 +9,7 @@ const expect = chai.expect;
 const should = chai.should();
 chai.use(require('chai-events'));
 
-const { Duplex } = require('stream');
+const { Duplex, Readable } = require('stream');
 
 const CAN_OPTIONS = {
   canRate: 250000,
@@ -175,6 +175,220 @@ describe('Send a Message', () => {
     return p;
   });
 
+  it('should write a batch of messages', async () => {
+
+    let msgs = [];
+    for (let i = 0; i < 8; i++) {
+      msgs.push({ id: 0x200 + i, ext: (i % 2 == 1), buf: [i, 1, 2, 3].slice(0, i % 5) });
+    }
+
+    let written = await can.writeBatch(msgs);
+
+    expect(written).to.be.eq(msgs.length);
+
+  });
+
+  it('should resolve queued writes in order', async () => {
+
+    let order = [];
+    let writes = [];
+
+    for (let i = 0; i < 100; i++) {
+      writes.push(can.send({ id: 0x300, ext: false, buf: [i] }).then(() => order.push(i)));
+    }
+
+    await Promise.all(writes);
+
+    expect(order).to.deep.eq([...Array(100).keys()]);
+    expect(can.transmitStats().pending).to.be.eq(0);
+
+  });
+
+  it('should write a piped stream', async () => {
+
+    let msgs = [];
+    for (let i = 0; i < 200; i++) {
+      msgs.push({ id: 0x400, ext: false, buf: [i] });
+    }
+
+    let sent = can.transmitStats().queued;
+    let source = Readable.from(msgs);
+    let p = source.should.emit('end');
+
+    source.pipe(can, { end: false });
+    await p;
+
+    // Queued behind the piped messages
+    await can.send({ id: 0x401, ext: false, buf: [] });
+
+    expect(can.transmitStats().queued - sent).to.be.eq(msgs.length + 1);
+
+  });
+
+  it('should return a boolean from write() and a promise from send()', async () => {
+
+    let source = new Readable({ objectMode: true, read() {} });
+    source.pipe(can, { end: false });
+
+    expect(can.write({ id: 0x402, ext: false, buf: [] })).to.be.a('boolean');
+
+    let result = can.send({ id: 0x402, ext: false, buf: [] });
+    expect(result).to.be.instanceof(Promise);
+    await result;
+
+    source.unpipe(can);
+
+  });
+
+  it('should keep writing after an invalid piped message', async () => {
+
+    let source = Readable.from([{ id: 0x403, ext: false, buf: [1, 2, 3, 4, 5, 6, 7, 8, 9] }]);
+    let p = can.should.emit('error');
+
+    source.pipe(can, { end: false });
+    await p;
+
+    // Queued behind the invalid message, so it resolves only if the stream
+    // was released after it
+    await can.send({ id: 0x404, ext: false, buf: [] });
+
+  });
+
+  it('should cancel queued writes', async () => {
+
+    let writes = [];
+    for (let i = 0; i < 200; i++) {
+      writes.push(can.send({ id: 0x3FF, ext: false, buf: [i] }).then(() => 0, () => 1));
+    }
+
+    let cancelled = can.cancel(0x3FF);
+    let rejected = (await Promise.all(writes)).reduce((a, b) => a + b, 0);
+
+    expect(rejected).to.be.eq(cancelled);
+    expect(can.transmitStats().pending).to.be.eq(0);
+
+  });
+
+  it('should coalesce queued writes', async () => {
+
+    let before = can.transmitStats();
+    let writes = [];
+    for (let i = 0; i < 200; i++) {
+      writes.push(can.send({ id: 0x3FE, ext: false, buf: [i], coalesce: true }));
+    }
+
+    await Promise.all(writes);
+
+    let after = can.transmitStats();
+    expect((after.sent - before.sent) + (after.replaced - before.replaced)).to.be.eq(200);
+
+  });
+
+  it('should discard an expired write', async () => {
+
+    let p = can.should.emit('expired');
+    let expired = can.transmitStats().expired;
+
+    let err = await can.send({ id: 0x3FD, ext: false, buf: [], deadline: Date.now() - 1 })
+      .then(() => null, (e) => e);
+
+    expect(err).to.be.instanceof(Error);
+    expect(can.transmitStats().expired).to.be.eq(expired + 1);
+
+    return p;
+  });
+
+  it('should write from weighted sources', async () => {
+
+    can.setSource('bulk', { weight: 1 });
+    can.setSource('status', { weight: 4 });
+
+    let writes = [];
+    for (let i = 0; i < 100; i++) {
+      writes.push(can.send({ id: 0x500, ext: false, buf: [i], source: 'bulk' }));
+      writes.push(can.send({ id: 0x501, ext: false, buf: [i], source: 'status' }));
+    }
+
+    await Promise.all(writes);
+
+    let stats = can.sourceStats();
+    expect(stats.bulk.sent).to.be.eq(100);
+    expect(stats.status.sent).to.be.eq(100);
+    expect(stats.status.pending).to.be.eq(0);
+    expect(stats.default.queued).to.be.gt(0);
+
+  });
+
+  it('should report the bus load it causes', async () => {
+
+    let writes = [];
+    for (let i = 0; i < 50; i++) {
+      writes.push(can.send({ id: 0x502, ext: false, buf: [1, 2, 3, 4, 5, 6, 7, 8] }));
+    }
+
+    await Promise.all(writes);
+
+    let stats = can.transmitStats();
+    expect(stats.load).to.be.a('number');
+    expect(stats.load).to.be.within(0, 100);
+    expect(stats.paced).to.be.eq(0);
+
+  });
+
+  it('should send a cyclic message', async () => {
+
+    let handle = can.cyclic.add({ id: 0x700, ext: false, buf: [0] }, 2000, { count: 5 });
+
+    can.cyclic.update(handle, { id: 0x700, ext: false, buf: [1] });
+
+    await new Promise((resolve) => setTimeout(resolve, 100));
+
+    let stats = can.cyclic.stats(handle);
+    expect(stats.sent).to.be.eq(5);
+    expect(stats.active).to.be.eq(false);
+
+    can.cyclic.remove(handle);
+    expect(() => can.cyclic.stats(handle)).to.throw();
+
+  });
+
+  it('should write a message at a host time', async () => {
+
+    let deadline = can.hostTime() + 2000;
+    let result = await can.writeAt({ id: 0x702, ext: false, buf: [1] }, deadline);
+
+    expect(result.deadlineUs).to.be.eq(deadline);
+    expect(result.writtenUs).to.be.gte(deadline);
+    expect(result.lateUs).to.be.gte(0);
+
+  });
+
+  it('should cancel a timed message', async () => {
+
+    let p = can.writeAt({ id: 0x703, ext: false, buf: [] }, can.hostTime() + 10000000)
+      .then(() => null, (e) => e);
+
+    expect(can.cancelTimed()).to.be.eq(1);
+    expect(await p).to.be.instanceof(Error);
+
+  });
+
+  it('should time out a request without a reply', async () => {
+
+    // Like any other rejection, the timeout is also emitted as an error
+    let emitted = null;
+    can.once('error', (e) => { emitted = e; });
+
+    let err = await can.request({ id: 0x704, ext: false, buf: [1] },
+      { matchId: 0x705, dataPrefix: [0xA5, 0x5A], timeoutMs: 50 })
+      .then(() => null, (e) => e);
+
+    expect(err).to.be.instanceof(Error);
+    expect(err.code).to.be.eq('ETIMEDOUT');
+    expect(emitted).to.be.eq(err);
+
+  });
+
 
   // after all tests in this block
   after(async () => {
@@ -263,6 +477,105 @@ describe('Receive a Message', () => {
 
 
 
+describe('Detect the Bit Rate', () => {
+
+  let can = null;
+  let path = null;
+
+  before(async () => {
+    can = new CsPcanUsb(CAN_OPTIONS);
+    can.on('error', () => {});
+
+    let result = await can.list();
+    path = result[0].path;
+  })
+
+  it('should score every candidate rate', async () => {
+    let candidates = [500000, 250000, 125000];
+    let result;
+
+    try {
+      result = await can.detectBitrate(path, { candidates, timeoutMs: 200 });
+      expect(candidates.indexOf(result.canRate)).to.be.at.least(0);
+      expect(can.options.canRate).to.be.eq(result.canRate);
+    } catch(err) {
+      // Nothing to detect on a quiet bus
+      result = err;
+    }
+
+    expect(result.candidates.map((c) => c.canRate)).to.deep.equal(candidates);
+  });
+
+  it('should not detect the bit rate of an open port', async () => {
+    await can.open(path);
+
+    let failed = false;
+    try {
+      await can.detectBitrate(path);
+    } catch(err) {
+      failed = true;
+    }
+    expect(failed).to.be.eq(true);
+  });
+
+  after(async () => {
+
+    await can.close();
+
+  })
+});
+
+
+
+describe('Multiple Channels', () => {
+
+  let a = null;
+  let b = null;
+  let ports = null;
+
+  before(async () => {
+    a = new CsPcanUsb(CAN_OPTIONS);
+    b = new CsPcanUsb({ canRate: 500000 });
+
+    ports = await a.list();
+  })
+
+  it('should keep options separate for each port', () => {
+    b.setOptions({ loopback: true });
+
+    expect(a.options.canRate).to.be.eq(250000);
+    expect(a.options.loopback).to.not.be.eq(true);
+    expect(b.options.canRate).to.be.eq(500000);
+    expect(b.options.loopback).to.be.eq(true);
+  });
+
+  it('should keep receiving on one channel when another closes', async function() {
+    if (ports.length < 2) {
+      this.skip();
+    }
+
+    a.setOptions({ loopback: true });
+    b.setOptions({ canRate: 250000, loopback: false });
+
+    await a.open(ports[0].path);
+    await b.open(ports[1].path);
+    await b.close();
+
+    let p = a.should.emit('data');
+    a.write({ id: 0x123, ext: false, buf: [1, 2, 3] });
+
+    return p;
+  });
+
+  after(async () => {
+
+    await a.close();
+
+  })
+});
+
+
+
 describe('Loopback Mode', () => {
 
   let can = null;
@@ -319,6 +632,56 @@ describe('Loopback Mode', () => {
 });
 
 
+describe('Confirm Transmission', () => {
+
+  let can = null;
+
+  // before all tests in this block, get an open port
+  before(async () => {
+
+    can = new CsPcanUsb(Object.assign({}, CAN_OPTIONS, { txConfirm: true }));
+
+    let result = await can.list();
+
+    let p = can.should.emit('open');
+
+    can.open(result[0].path);
+
+    return p;
+  })
+
+
+  it('should resolve once a message is sent on the bus', async () => {
+
+    let writes = [];
+    for (let i = 0; i < 20; i++) {
+      writes.push(can.send({ id: 0x600, ext: false, buf: [i] }));
+    }
+
+    let results = await Promise.all(writes);
+
+    results.forEach((result, i) => {
+      expect(result.timestamp).to.be.a('number');
+      expect(result.latencyUs).to.be.a('number');
+      if (i > 0) {
+        expect(result.timestamp).to.be.gte(results[i - 1].timestamp);
+      }
+    });
+
+    expect(can.transmitStats().confirmed).to.be.eq(20);
+    expect(can.transmitLatency().count).to.be.eq(20);
+
+  });
+
+  // after all tests in this block
+  after(async () => {
+
+    await can.close();
+
+  })
+});
+
+
 describe('Implement a standard stream interface', () => {
 
   let can = null;
@@ -380,3 +743,51 @@ describe('Implement a standard stream interface', () => {
   })
 });
 
+
+
+describe('CAN FD Frames', () => {
+
+  const tpcan = require('../lib/tpcan');
+
+  it('should round DLC codes up to the next data length', () => {
+    expect([0, 8, 9, 12, 13, 33, 64].map(tpcan.lengthToDlc)).to.deep.equal([0, 8, 9, 9, 10, 14, 15]);
+    expect(tpcan.dlcToLength(13)).to.equal(32);
+  });
+
+  it('should pack and unpack CAN FD frame records', () => {
+    let frames = tpcan.toFramesFD([
+      { id: 0x123, ext: true, buf: Buffer.alloc(64, 0xAB) },
+      { id: 0x456, buf: Buffer.from([1, 2, 3]), fd: false },
+    ]);
+
+    expect(frames.length).to.equal(2 * tpcan.FRAME_FD_SIZE);
+
+    let msgs = tpcan.fromFramesFD(frames);
+    expect([msgs[0].id, msgs[0].ext, msgs[0].fd, msgs[0].brs, msgs[0].esi]).to.deep.equal(
+      [0x123, true, true, true, false]);
+    expect(msgs[0].buf.length).to.equal(64);
+    expect([msgs[1].id, msgs[1].ext, msgs[1].fd, msgs[1].brs]).to.deep.equal(
+      [0x456, false, false, false]);
+    expect([...msgs[1].buf]).to.deep.equal([1, 2, 3]);
+  });
+
+  it('should build a bit rate string for InitializeFD', () => {
+    expect(tpcan.fdBitrate({ nominal: { brp: 2, tseg1: 63, tseg2: 16 },
+                             data: { brp: 2, tseg1: 15, tseg2: 4 } })).to.equal(
+      'f_clock_mhz=80,nom_brp=2,nom_tseg1=63,nom_tseg2=16,nom_sjw=16,' +
+      'data_brp=2,data_tseg1=15,data_tseg2=4,data_sjw=4');
+    expect(() => tpcan.fdBitrate({ nominal: { brp: 1, tseg1: 300, tseg2: 1 },
+                                   data: { brp: 1, tseg1: 1, tseg2: 1 } })).to.throw(RangeError);
+  });
+
+  it('should find bit timings for classic and CAN FD rates', () => {
+    let [classic] = CsPcanUsb.bitTiming({ bitrate: 500000 });
+    expect([classic.brp, classic.tseg1, classic.tseg2, classic.error]).to.deep.equal([1, 13, 2, 0]);
+    expect(classic.btr0btr1 & 0x3FFF).to.equal(0x001C);
+
+    let [fd] = CsPcanUsb.bitTiming({ bitrate: 500000, dataBitrate: 2000000 });
+    expect(fd.error).to.equal(0);
+    expect(fd.data.samplePoint).to.equal(0.75);
+    expect(fd.bitrateFD.startsWith('f_clock_mhz=80,')).to.equal(true);
+  });
+});
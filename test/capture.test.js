@@ -0,0 +1,434 @@
+/**
+ * Tests native capture of received frames to disk
+ *
+ */
+const CsPcanUsb = require('..');
+const chai = require('chai');
+const expect = chai.expect;
+const should = chai.should();
+chai.use(require('chai-events'));
+
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+const zlib = require('zlib');
+
+const CAN_OPTIONS = {
+  canRate: 250000,
+  loopback: true,
+};
+
+const CAPTURE_PATH = path.join(os.tmpdir(), 'cs-pcan-usb-test.pcancap');
+const TRC_PATH = path.join(os.tmpdir(), 'cs-pcan-usb-test.trc');
+const PCAPNG_PATH = path.join(os.tmpdir(), 'cs-pcan-usb-test.pcapng');
+const MDF4_PATH = path.join(os.tmpdir(), 'cs-pcan-usb-test.mf4');
+const ARROW_PATH = path.join(os.tmpdir(), 'cs-pcan-usb-test.arrow');
+
+// Frames written during each capture, and looped back into it
+const FRAMES = [
+  { id: 0x123, ext: false, buf: Buffer.from([1, 2, 3]) },
+  { id: 0x18FF0001, ext: true, buf: Buffer.from([1, 2, 3, 4, 5, 6, 7, 8]) },
+  { id: 0x7FF, ext: false, buf: Buffer.alloc(0) },
+];
+
+const FRAME_IDS = FRAMES.map((frame) => frame.id);
+
+
+// Captures to a file while FRAMES are written, and resolves with the capture
+// statistics once every frame has come back, so it has been captured
+async function captureFrames(can, path, opts) {
+
+  let left = new Set(FRAME_IDS);
+  let echoed = new Promise((resolve) => {
+    function onData(msg) {
+      if (msg.tx && left.delete(msg.id) && (left.size == 0)) {
+        can.removeListener('data', onData);
+        resolve();
+      }
+    }
+    can.on('data', onData);
+  });
+
+  await can.startCapture(path, Object.assign({ flushMs: 10 }, opts));
+
+  expect(await can.writeBatch(FRAMES)).to.be.eq(FRAMES.length);
+  await echoed;
+
+  return can.stopCapture();
+}
+
+// Checks that the frames with the IDs of FRAMES are FRAMES, in order
+function expectFrames(frames) {
+  let found = frames.filter((frame) => FRAME_IDS.includes(frame.id));
+
+  expect(found.length).to.be.eq(FRAMES.length);
+  found.forEach((frame, i) => {
+    expect(frame.id).to.be.eq(FRAMES[i].id);
+    expect(frame.ext).to.be.eq(FRAMES[i].ext);
+    expect(Buffer.from(frame.buf)).to.deep.eq(FRAMES[i].buf);
+  });
+}
+
+// Returns the frames in a pcapng file, from the SocketCAN header of each
+// enhanced packet block
+function pcapngFrames(file) {
+  let frames = [];
+
+  for (let offset = 0; offset < file.length; offset += file.readUInt32LE(offset + 4)) {
+    if (file.readUInt32LE(offset) == 6) {
+      let packet = offset + 28;
+      let id = file.readUInt32BE(packet);
+      let len = file[packet + 4];
+
+      frames.push({
+        id: id & 0x1FFFFFFF,
+        ext: (id & 0x80000000) ? true : false,
+        buf: file.subarray(packet + 8, packet + 8 + len),
+      });
+    }
+  }
+
+  return frames;
+}
+
+// Returns the frames in an MDF4 file with a single CAN data group, following
+// the first data group to its data blocks
+function mdf4Frames(file) {
+  function block(offset) {
+    let links = Number(file.readBigUInt64LE(offset + 16));
+    let link = (i) => Number(file.readBigUInt64LE(offset + 24 + 8 * i));
+
+    return {
+      id: file.toString('latin1', offset + 2, offset + 4),
+      links: [...Array(links).keys()].map(link),
+      data: file.subarray(offset + 24 + 8 * links, offset + Number(file.readBigUInt64LE(offset + 8))),
+    };
+  }
+
+  function records(offset) {
+    let b = block(offset);
+
+    if (b.id == 'DT') {
+      return [b.data];
+    } else if (b.id == 'DZ') {
+      return [zlib.inflateSync(b.data.subarray(24, 24 + Number(b.data.readBigUInt64LE(16))))];
+    } else if (b.id == 'HL') {
+      return records(b.links[0]);
+    } else if (b.id == 'DL') {
+      return b.links.slice(1).map(records).flat().concat(b.links[0] ? records(b.links[0]) : []);
+    }
+    throw new Error("Unexpected MDF4 block " + b.id);
+  }
+
+  let dg = block(block(64).links[0]);
+  let cg = block(dg.links[1]);
+  let cycles = Number(cg.data.readBigUInt64LE(8));
+  let size = cg.data.readUInt32LE(24);
+  let data = dg.links[2] ? Buffer.concat(records(dg.links[2])) : Buffer.alloc(0);
+  let frames = [];
+
+  expect(data.length).to.be.eq(cycles * size);
+
+  for (let offset = 0; offset < data.length; offset += size) {
+    let id = data.readUInt32LE(offset + 9);
+
+    frames.push({
+      id: id & 0x1FFFFFFF,
+      ext: (id & 0x80000000) ? true : false,
+      buf: data.subarray(offset + 15, offset + 15 + data[offset + 14]),
+    });
+  }
+
+  return frames;
+}
+
+// Returns the frames in the record batches of an Arrow IPC file, reading just
+// enough of each message's flatbuffer to find its column buffers
+function arrowFrames(file) {
+  function table(pos) {
+    let vtable = pos - file.readInt32LE(pos);
+    let field = (i) => ((4 + 2 * i < file.readUInt16LE(vtable)) ? file.readUInt16LE(vtable + 4 + 2 * i) : 0);
+
+    return {
+      u8: (i) => (field(i) ? file[pos + field(i)] : 0),
+      u64: (i) => (field(i) ? Number(file.readBigUInt64LE(pos + field(i))) : 0),
+      ref: (i) => (pos + field(i) + file.readUInt32LE(pos + field(i))),
+    };
+  }
+
+  let frames = [];
+  let offset = 8;
+
+  while ((file.readUInt32LE(offset) == 0xFFFFFFFF) && (file.readUInt32LE(offset + 4) > 0)) {
+    let start = offset + 8;
+    let message = table(start + file.readUInt32LE(start));
+    let body = start + file.readUInt32LE(offset + 4);
+
+    // A record batch header has the row count, field nodes and buffers
+    if (message.u8(1) == 3) {
+      let batch = table(message.ref(2));
+      let rows = batch.u64(0);
+      let buffers = batch.ref(2) + 4;
+      let column = (i) => body + Number(file.readBigUInt64LE(buffers + 16 * (2 * i + 1)));
+
+      for (let row = 0; row < rows; row++) {
+        let data = column(4) + 8 * row;
+
+        frames.push({
+          id: file.readUInt32LE(column(1) + 4 * row),
+          ext: (file.readUInt16LE(column(2) + 2 * row) & 0x02) ? true : false,
+          tx: (file.readUInt16LE(column(2) + 2 * row) & 0x100) ? true : false,
+          buf: file.subarray(data, data + file[column(3) + row]),
+        });
+      }
+    }
+
+    offset = body + message.u64(3);
+  }
+
+  return frames;
+}
+
+
+describe('Capture to Disk', () => {
+
+  let can = null;
+
+  // before all tests in this block, get an open port
+  before(async () => {
+
+    // set and keep for later tests
+    can = new CsPcanUsb(CAN_OPTIONS);
+
+    let result = await can.list();
+
+    let p = can.should.emit('open');
+
+    can.open(result[0].path);
+
+    return p;
+  })
+
+  it('should write a capture file with a header', async () => {
+
+    let stats = await captureFrames(can, CAPTURE_PATH);
+
+    expect(stats).to.be.an('object');
+    expect(stats.files).to.be.eq(1);
+    expect(stats.dropped).to.be.eq(0);
+    expect(stats.error).to.be.eq(false);
+    expect(stats.frames).to.be.at.least(FRAMES.length);
+
+    let file = fs.readFileSync(CAPTURE_PATH);
+
+    expect(file.length).to.be.eq(stats.bytes);
+    expect(file.length).to.be.eq(48 + 24 * stats.frames);
+    expect(file.toString('latin1', 0, 7)).to.be.eq('PCANCAP');
+    expect(file.readUInt16LE(12)).to.be.eq(24);
+    expect(file.readUInt32LE(20)).to.be.eq(CAN_OPTIONS.canRate);
+
+  });
+
+  it('should reject a second capture on the same port', async () => {
+
+    await can.startCapture(CAPTURE_PATH);
+
+    can.on('error', () => {});
+
+    let err = await can.startCapture(CAPTURE_PATH).catch((e) => e);
+    expect(err).to.be.instanceof(Error);
+
+    can.removeAllListeners('error');
+
+    await can.stopCapture();
+
+  });
+
+  it('should read back captured frames by ID', async () => {
+
+    let stats = await captureFrames(can, CAPTURE_PATH);
+
+    let reader = new CsPcanUsb.CaptureReader(CAPTURE_PATH, { index: 'memory' });
+
+    expect(reader.info.frames).to.be.eq(stats.frames);
+    expect(reader.info.recordSize).to.be.eq(24);
+    expect(reader.info.bitrate).to.be.eq(CAN_OPTIONS.canRate);
+
+    let all = [];
+    for (let batch of reader.query()) {
+      all.push(...reader.frames(batch));
+    }
+
+    expect(all.length).to.be.eq(stats.frames);
+    expectFrames(all);
+
+    // A query by ID returns only that ID's frames
+    let found = [];
+    for (let batch of reader.query({ ids: [FRAMES[1].id] })) {
+      found.push(...reader.frames(batch));
+    }
+
+    expect(found.length).to.be.eq(1);
+    expect(found[0].id).to.be.eq(FRAMES[1].id);
+    expect(found[0].ext).to.be.eq(true);
+    expect(Buffer.from(found[0].buf)).to.deep.eq(FRAMES[1].buf);
+
+    reader.close();
+
+  });
+
+  it('should write and read back a trace file', async () => {
+
+    let stats = await captureFrames(can, TRC_PATH);
+
+    expect(stats.files).to.be.eq(1);
+    expect(fs.statSync(TRC_PATH).size).to.be.eq(stats.bytes);
+    expect(fs.readFileSync(TRC_PATH, 'latin1')).to.match(/^;\$FILEVERSION=2\.1\r?\n/);
+
+    let trc = new CsPcanUsb.TrcReader(TRC_PATH);
+    let frames = [];
+
+    for (let batch of trc.batches()) {
+      frames.push(...trc.frames(batch));
+    }
+
+    expect(trc.info.version).to.be.eq(2.1);
+    expect(frames.length).to.be.eq(stats.frames);
+    expectFrames(frames);
+
+    trc.close();
+
+  });
+
+  it('should write a pcapng file with a SocketCAN interface', async () => {
+
+    let stats = await captureFrames(can, PCAPNG_PATH);
+
+    let file = fs.readFileSync(PCAPNG_PATH);
+
+    expect(file.length).to.be.eq(stats.bytes);
+
+    // Section header block, then an interface description block
+    expect(file.readUInt32LE(0)).to.be.eq(0x0A0D0D0A);
+    expect(file.readUInt32LE(8)).to.be.eq(0x1A2B3C4D);
+
+    let idb = file.readUInt32LE(4);
+    expect(file.readUInt32LE(idb)).to.be.eq(1);
+    expect(file.readUInt16LE(idb + 8)).to.be.eq(227);
+
+    // One enhanced packet block per frame
+    let frames = pcapngFrames(file);
+
+    expect(frames.length).to.be.eq(stats.frames);
+    expectFrames(frames);
+
+  });
+
+  it('should write a finalized MDF4 file', async () => {
+
+    let stats = await captureFrames(can, MDF4_PATH, { compress: true });
+
+    let file = fs.readFileSync(MDF4_PATH);
+
+    expect(file.length).to.be.eq(stats.bytes);
+    expect(file.toString('latin1', 0, 16)).to.be.eq('MDF     4.10    ');
+
+    // No unfinalized flags, and a header block after the identification
+    expect(file.readUInt16LE(60)).to.be.eq(0);
+    expect(file.toString('latin1', 64, 68)).to.be.eq('##HD');
+
+    let frames = mdf4Frames(file);
+
+    expect(frames.length).to.be.eq(stats.frames);
+    expectFrames(frames);
+
+  });
+
+  it('should write an Arrow IPC file', async () => {
+
+    let stats = await captureFrames(can, ARROW_PATH);
+
+    let file = fs.readFileSync(ARROW_PATH);
+
+    expect(file.length).to.be.eq(stats.bytes);
+    expect(file.toString('latin1', 0, 6)).to.be.eq('ARROW1');
+    expect(file.toString('latin1', file.length - 6)).to.be.eq('ARROW1');
+
+    // The schema message follows the magic, and the footer ends the file
+    expect(file.readUInt32LE(8)).to.be.eq(0xFFFFFFFF);
+    expect(file.readUInt32LE(12) % 8).to.be.eq(0);
+    expect(file.readUInt32LE(file.length - 10)).to.be.below(file.length);
+
+    let frames = arrowFrames(file);
+
+    expect(frames.length).to.be.eq(stats.frames);
+    expectFrames(frames);
+    expect(frames.filter((frame) => FRAME_IDS.includes(frame.id)).every((frame) => frame.tx))
+      .to.be.eq(true);
+
+  });
+
+  it('should replay a capture file', async () => {
+
+    let captured = await captureFrames(can, CAPTURE_PATH);
+
+    // Replayed frames are looped back like any other
+    let replayed = [];
+    function onData(msg) {
+      if (msg.tx) {
+        replayed.push(msg);
+      }
+    }
+    can.on('data', onData);
+
+    let stats = await can.replay(CAPTURE_PATH, { speed: 10 });
+
+    // Wait for the last echoes to be read
+    await new Promise((resolve) => setTimeout(resolve, 50));
+    can.removeListener('data', onData);
+
+    expect(stats.finished).to.be.eq(true);
+    expect(stats.error).to.be.eq(false);
+    expect(stats.errors).to.be.eq(0);
+    expect(stats.frames).to.be.eq(captured.frames);
+    expect(stats.maxLateUs).to.be.at.least(stats.p50LateUs);
+    expectFrames(replayed);
+
+  });
+
+  it('should open a capture file in place of a port', async () => {
+
+    let captured = await captureFrames(can, CAPTURE_PATH);
+
+    let offline = new CsPcanUsb(CAN_OPTIONS);
+    let msgs = [];
+
+    offline.on('data', (msg) => msgs.push(msg));
+    let p = offline.should.emit('end');
+
+    await offline.open(CAPTURE_PATH);
+    await p;
+
+    expect(msgs.length).to.be.eq(captured.frames);
+    for (let i = 1; i < msgs.length; i++) {
+      expect(msgs[i].timestamp).to.be.at.least(msgs[i - 1].timestamp);
+    }
+    expectFrames(msgs);
+
+    await offline.close();
+
+  });
+
+  // after all tests in this block
+  after(async () => {
+
+    await can.close();
+
+    fs.unlinkSync(CAPTURE_PATH);
+    fs.unlinkSync(TRC_PATH);
+    fs.unlinkSync(PCAPNG_PATH);
+    fs.unlinkSync(MDF4_PATH);
+    fs.unlinkSync(ARROW_PATH);
+
+  })
+});
@@ -44,6 +44,13 @@ const MSG5 = {
   buf: Buffer.from([5, 4, 3])
 };
 
+// Messages are looped back, so each one received is the echo of one written,
+// flagged as transmitted
+function expectLoopedBack(msg, expected) {
+  expect({ id: msg.id, ext: msg.ext, buf: msg.buf }).to.deep.eq(expected);
+  expect(msg.tx).to.be.eq(true);
+}
+
 describe('No Filters', () => {
 
   let can = null;
@@ -67,7 +74,7 @@ describe('No Filters', () => {
 
     can.once('data', (msg) => {
 
-      expect(msg).to.deep.eq(MSG1);
+      expectLoopedBack(msg, MSG1);
 
       done();
 
@@ -80,7 +87,7 @@ describe('No Filters', () => {
 
     can.once('data', (msg) => {
 
-      expect(msg).to.deep.eq(MSG2);
+      expectLoopedBack(msg, MSG2);
 
       done();
 
@@ -93,7 +100,7 @@ describe('No Filters', () => {
 
     can.once('data', (msg) => {
 
-      expect(msg).to.deep.eq(MSG3);
+      expectLoopedBack(msg, MSG3);
 
       done();
 
@@ -106,7 +113,7 @@ describe('No Filters', () => {
 
     can.once('data', (msg) => {
 
-      expect(msg).to.deep.eq(MSG4);
+      expectLoopedBack(msg, MSG4);
 
       done();
 
@@ -152,7 +159,7 @@ describe('Only Standard IDs', () => {
 
     can.once('data', (msg) => {
 
-      expect(msg).to.deep.eq(MSG1);
+      expectLoopedBack(msg, MSG1);
 
       done();
 
@@ -174,7 +181,7 @@ describe('Only Standard IDs', () => {
 
     can.once('data', (msg) => {
 
-      expect(msg).to.deep.eq(MSG3);
+      expectLoopedBack(msg, MSG3);
 
       done();
 
@@ -239,7 +246,7 @@ describe('Only Extended IDs', () => {
 
     can.once('data', (msg) => {
 
-      expect(msg).to.deep.eq(MSG2);
+      expectLoopedBack(msg, MSG2);
 
       done();
 
@@ -262,7 +269,7 @@ describe('Only Extended IDs', () => {
 
     can.once('data', (msg) => {
 
-      expect(msg).to.deep.eq(MSG4);
+      expectLoopedBack(msg, MSG4);
 
       done();
 
@@ -346,7 +353,7 @@ describe('Only a single ID', () => {
 
     can.once('data', (msg) => {
 
-      expect(msg).to.deep.eq(MSG5);
+      expectLoopedBack(msg, MSG5);
 
       done();
 
@@ -356,6 +363,71 @@ describe('Only a single ID', () => {
   });
 
 
+  // after all tests in this block
+  after(async () => {
+
+    await can.close();
+
+  })
+});
+
+describe('Code and Mask', () => {
+
+  let can = null;
+
+  // before all tests in this block, get an open port
+  before(async () => {
+
+    // set bits of the mask are "don't care", so this passes 0x7F0 to 0x7FF
+    can = new CsPcanUsb(Object.assign(CAN_OPTIONS, {
+      filters: [{
+        ext: false,
+        code: 0x7F0,
+        mask: 0x00F
+      }]
+    }));
+
+    let result = await can.list();
+
+    let p = can.should.emit('open');
+
+    can.open(result[0].path);
+
+    return p;
+  })
+
+  it('should not receive MSG1', async () => {
+
+    let p = can.should.not.emit('data');
+
+    can.write(MSG1);
+
+    return p;
+  });
+
+  it('should not receive MSG2', async () => {
+
+    let p = can.should.not.emit('data');
+
+    can.write(MSG2);
+
+    return p;
+  });
+
+  it('should receive MSG3', (done) => {
+
+    can.once('data', (msg) => {
+
+      expectLoopedBack(msg, MSG3);
+
+      done();
+
+    });
+
+    can.write(MSG3);
+  });
+
+
   // after all tests in this block
   after(async () => {
 